@@ -465,6 +465,8 @@ main(int argc, char **argv) {
 			inputformat = dns_masterformat_raw;
 			fprintf(stderr, "WARNING: input format raw, version "
 					"ignored\n");
+		} else if (strcasecmp(inputformatstr, "map") == 0) {
+			inputformat = dns_masterformat_map;
 		} else {
 			fprintf(stderr, "unknown file format: %s\n",
 				inputformatstr);
@@ -488,6 +490,8 @@ main(int argc, char **argv) {
 				fprintf(stderr, "unknown raw format version\n");
 				exit(1);
 			}
+		} else if (strcasecmp(outputformatstr, "map") == 0) {
+			outputformat = dns_masterformat_map;
 		} else {
 			fprintf(stderr, "unknown file format: %s\n",
 				outputformatstr);
@@ -513,6 +517,14 @@ main(int argc, char **argv) {
 	 * If we are printing to stdout then send the informational
 	 * output to stderr.
 	 */
+	if (dumpzone && outputformat == dns_masterformat_map &&
+	    (output_filename == NULL || strcmp(output_filename, "-") == 0))
+	{
+		fprintf(stderr, "the map format cannot be written to standard "
+				"output\n");
+		exit(1);
+	}
+
 	if (dumpzone &&
 	    (output_filename == NULL || strcmp(output_filename, "-") == 0 ||
 	     strcmp(output_filename, "/dev/fd/1") == 0 ||
@@ -543,6 +555,12 @@ main(int argc, char **argv) {
 		filename = argv[isc_commandline_index];
 	}
 
+	if (inputformat == dns_masterformat_map && strcmp(filename, "-") == 0) {
+		fprintf(stderr, "the map format cannot be read from standard "
+				"input\n");
+		exit(1);
+	}
+
 	isc_commandline_index++;
 
 	result = load_zone(mctx, origin, filename, inputformat, classname,
@@ -15,7 +15,7 @@
   <xsl:output method="html" indent="yes" version="4.0"/>
   <!-- the version number **below** must match version in bin/named/statschannel.c -->
   <!-- don't forget to update "/xml/v<STATS_XML_VERSION_MAJOR>" in the HTTP endpoints listed below -->
-  <xsl:template match="statistics[@version=&quot;3.12&quot;]">
+  <xsl:template match="statistics[@version=&quot;3.13&quot;]">
     <html>
       <head>
         <script type="text/javascript" src="https://ajax.googleapis.com/ajax/libs/jquery/3.4.1/jquery.min.js"></script>
@@ -1046,6 +1046,8 @@
               <th>MaxMalloced</th>
               <th>BlockSize</th>
               <th>Pools</th>
+              <th>CacheGets</th>
+              <th>CacheHits</th>
               <th>HiWater</th>
               <th>LoWater</th>
             </tr>
@@ -1088,6 +1090,12 @@
                 <td>
                   <xsl:value-of select="pools"/>
                 </td>
+                <td>
+                  <xsl:value-of select="cachegets"/>
+                </td>
+                <td>
+                  <xsl:value-of select="cachehits"/>
+                </td>
                 <td>
                   <xsl:value-of select="hiwater"/>
                 </td>
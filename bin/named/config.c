@@ -66,6 +66,7 @@ options {\n\
 			    "\
 	heartbeat-interval 60;\n\
 	interface-interval 60;\n\
+	io-uring no;\n\
 	listen-on {any;};\n\
 	listen-on-v6 {any;};\n\
 #	lock-file \"" NAMED_LOCALSTATEDIR "/run/named/named.lock\";\n\
@@ -140,7 +141,9 @@ options {\n\
 	allow-recursion { localnets; localhost; };\n\
 	allow-recursion-on { any; };\n\
 	allow-update-forwarding {none;};\n\
+	answer-cache-size 0;\n\
 	auth-nxdomain false;\n\
+	cache-shards 1;\n\
 	check-dup-records warn;\n\
 	check-mx warn;\n\
 	check-names primary fail;\n\
@@ -166,6 +169,7 @@ options {\n\
 	max-cache-ttl 604800; /* 1 week */\n\
 	max-clients-per-query 100;\n\
 	max-ncache-ttl 10800; /* 3 hours */\n\
+	max-query-races 0;\n\
 	max-recursion-depth 7;\n\
 	max-recursion-queries 100;\n\
 	max-stale-ttl 86400; /* 1 day */\n\
@@ -252,6 +252,14 @@ named_server_setdebuglevel(named_server_t *server, isc_lex_t *lex);
 isc_result_t
 named_server_flushcache(named_server_t *server, isc_lex_t *lex);
 
+/*%
+ * Start writing the snapshots of the server's cache(s) that have a
+ * cache-snapshot-file, in the background.
+ */
+isc_result_t
+named_server_savecache(named_server_t *server, isc_lex_t *lex,
+		       isc_buffer_t **text);
+
 /*%
  * Flush a particular name from the server's cache.  If 'tree' is false,
  * also flush the name from the ADB and badcache.  If 'tree' is true, also
@@ -62,6 +62,7 @@
 #include <isc/task.h>
 #include <isc/timer.h>
 #include <isc/util.h>
+#include <isc/work.h>
 
 #include <dns/adb.h>
 #include <dns/badcache.h>
@@ -88,6 +89,7 @@
 #include <dns/nsec3.h>
 #include <dns/nta.h>
 #include <dns/order.h>
+#include <dns/pcache.h>
 #include <dns/peer.h>
 #include <dns/private.h>
 #include <dns/rbt.h>
@@ -246,6 +248,7 @@ struct named_cache {
 	bool needflush;
 	bool adbsizeadjusted;
 	dns_rdataclass_t rdclass;
+	char *snapshotfile;
 	ISC_LINK(named_cache_t) link;
 };
 
@@ -1836,6 +1839,147 @@ setquerystats(dns_zone_t *zone, isc_mem_t *mctx, dns_zonestat_level_t level) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Warm up a newly created cache from its snapshot file, if there is one.
+ * The snapshot is loaded on a worker thread, so that a large one does not
+ * hold up the configuration; the cache is used as it fills up.
+ */
+typedef struct loadcache {
+	isc_mem_t *mctx;
+	dns_cache_t *cache;
+	char *filename;
+	dns_ttl_t maxttl;
+	unsigned int count;
+	isc_result_t result;
+	isc_time_t start;
+} loadcache_t;
+
+static void
+loadcache_work(void *arg) {
+	loadcache_t *lc = arg;
+
+	lc->result = dns_cache_loadsnapshot(lc->cache, lc->filename,
+					    lc->maxttl, &lc->count);
+}
+
+static void
+loadcache_done(void *arg) {
+	loadcache_t *lc = arg;
+	isc_time_t finish;
+
+	isc_time_now(&finish);
+
+	if (lc->result == ISC_R_SUCCESS) {
+		isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+			      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO,
+			      "loaded %u RRsets into cache '%s' from '%s' in "
+			      "%" PRIu64 " ms",
+			      lc->count, dns_cache_getname(lc->cache),
+			      lc->filename,
+			      isc_time_microdiff(&finish, &lc->start) / 1000);
+	} else if (lc->result != ISC_R_FILENOTFOUND) {
+		isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+			      NAMED_LOGMODULE_SERVER, ISC_LOG_WARNING,
+			      "loading cache '%s' from '%s' failed: %s",
+			      dns_cache_getname(lc->cache), lc->filename,
+			      isc_result_totext(lc->result));
+	}
+
+	dns_cache_detach(&lc->cache);
+	isc_mem_free(lc->mctx, lc->filename);
+	isc_mem_putanddetach(&lc->mctx, lc, sizeof(*lc));
+}
+
+static void
+loadcache(isc_mem_t *mctx, dns_cache_t *cache, const char *filename,
+	  dns_ttl_t maxttl) {
+	loadcache_t *lc = isc_mem_get(mctx, sizeof(*lc));
+
+	*lc = (loadcache_t){
+		.filename = isc_mem_strdup(mctx, filename),
+		.maxttl = maxttl,
+		.result = ISC_R_UNSET,
+	};
+	isc_mem_attach(mctx, &lc->mctx);
+	dns_cache_attach(cache, &lc->cache);
+	isc_time_now(&lc->start);
+
+	isc_work_enqueue(named_g_mainloop, loadcache_work, loadcache_done, lc);
+}
+
+/*
+ * Write the snapshot of a cache; this is used on shutdown, when there is
+ * nothing to wait for the snapshot but the server itself.
+ */
+static isc_result_t
+savecache(named_cache_t *nsc) {
+	isc_result_t result;
+
+	REQUIRE(nsc->snapshotfile != NULL);
+
+	result = dns_cache_savesnapshot(nsc->cache, nsc->snapshotfile);
+	isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+		      NAMED_LOGMODULE_SERVER,
+		      result == ISC_R_SUCCESS ? ISC_LOG_INFO : ISC_LOG_ERROR,
+		      "saving cache '%s' to '%s': %s",
+		      dns_cache_getname(nsc->cache), nsc->snapshotfile,
+		      isc_result_totext(result));
+	return (result);
+}
+
+/*
+ * Start writing the snapshot of a cache in the background, for
+ * "rndc savecache".
+ */
+typedef struct savecache {
+	isc_mem_t *mctx;
+	dns_cache_t *cache;
+	char *filename;
+	dns_dumpctx_t *mdctx;
+} savecache_t;
+
+static void
+savecache_done(void *arg, isc_result_t result) {
+	savecache_t *sc = arg;
+
+	isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+		      NAMED_LOGMODULE_SERVER,
+		      result == ISC_R_SUCCESS ? ISC_LOG_INFO : ISC_LOG_ERROR,
+		      "saving cache '%s' to '%s': %s",
+		      dns_cache_getname(sc->cache), sc->filename,
+		      isc_result_totext(result));
+
+	if (sc->mdctx != NULL) {
+		dns_dumpctx_detach(&sc->mdctx);
+	}
+	dns_cache_detach(&sc->cache);
+	isc_mem_free(sc->mctx, sc->filename);
+	isc_mem_putanddetach(&sc->mctx, sc, sizeof(*sc));
+}
+
+static isc_result_t
+savecache_start(isc_mem_t *mctx, named_cache_t *nsc) {
+	isc_result_t result;
+	savecache_t *sc = NULL;
+
+	REQUIRE(nsc->snapshotfile != NULL);
+
+	sc = isc_mem_get(mctx, sizeof(*sc));
+	*sc = (savecache_t){
+		.filename = isc_mem_strdup(mctx, nsc->snapshotfile),
+	};
+	isc_mem_attach(mctx, &sc->mctx);
+	dns_cache_attach(nsc->cache, &sc->cache);
+
+	result = dns_cache_savesnapshotasync(sc->cache, sc->filename,
+					     named_g_mainloop, savecache_done,
+					     sc, &sc->mdctx);
+	if (result != ISC_R_SUCCESS) {
+		savecache_done(sc, result);
+	}
+	return (result);
+}
+
 static named_cache_t *
 cachelist_find(named_cachelist_t *cachelist, const char *cachename,
 	       dns_rdataclass_t rdclass) {
@@ -1856,8 +2000,10 @@ cachelist_find(named_cachelist_t *cachelist, const char *cachename,
 
 static bool
 cache_reusable(dns_view_t *originview, dns_view_t *view,
-	       bool new_zero_no_soattl) {
+	       bool new_zero_no_soattl, uint32_t new_cache_shards) {
 	if (originview->rdclass != view->rdclass ||
+	    dns_cache_getshards(originview->cache) !=
+		    ISC_MAX(new_cache_shards, 1) ||
 	    originview->checknames != view->checknames ||
 	    dns_resolver_getzeronosoattl(originview->resolver) !=
 		    new_zero_no_soattl ||
@@ -1874,13 +2020,16 @@ cache_reusable(dns_view_t *originview, dns_view_t *view,
 
 static bool
 cache_sharable(dns_view_t *originview, dns_view_t *view,
-	       bool new_zero_no_soattl, uint64_t new_max_cache_size,
-	       uint32_t new_stale_ttl, uint32_t new_stale_refresh_time) {
+	       bool new_zero_no_soattl, uint32_t new_cache_shards,
+	       uint64_t new_max_cache_size, uint32_t new_stale_ttl,
+	       uint32_t new_stale_refresh_time) {
 	/*
 	 * If the cache cannot even reused for the same view, it cannot be
 	 * shared with other views.
 	 */
-	if (!cache_reusable(originview, view, new_zero_no_soattl)) {
+	if (!cache_reusable(originview, view, new_zero_no_soattl,
+			    new_cache_shards))
+	{
 		return (false);
 	}
 
@@ -4104,6 +4253,7 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	isc_result_t result;
 	size_t max_cache_size;
 	uint32_t max_cache_size_percent = 0;
+	uint32_t cache_shards;
 	size_t max_adb_size;
 	uint32_t lame_ttl, fail_ttl;
 	uint32_t max_stale_ttl = 0;
@@ -4120,6 +4270,7 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	int i = 0, j = 0, k = 0;
 	const char *str;
 	const char *cachename = NULL;
+	const char *snapshotfile = NULL;
 	dns_order_t *order = NULL;
 	uint32_t udpsize;
 	uint32_t maxbits;
@@ -4419,6 +4570,19 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	INSIST(result == ISC_R_SUCCESS);
 	zero_no_soattl = cfg_obj_asboolean(obj);
 
+	obj = NULL;
+	result = named_config_get(maps, "cache-shards", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	cache_shards = cfg_obj_asuint32(obj);
+
+	obj = NULL;
+	result = named_config_get(maps, "cache-snapshot-file", &obj);
+	if (result == ISC_R_SUCCESS && strcmp(view->name, "_bind") &&
+	    strcmp(view->name, "_meta"))
+	{
+		snapshotfile = cfg_obj_asstring(obj);
+	}
+
 	obj = NULL;
 	result = named_config_get(maps, "dns64", &obj);
 	if (result == ISC_R_SUCCESS && strcmp(view->name, "_bind") &&
@@ -4679,7 +4843,7 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	nsc = cachelist_find(cachelist, cachename, view->rdclass);
 	if (nsc != NULL) {
 		if (!cache_sharable(nsc->primaryview, view, zero_no_soattl,
-				    max_cache_size, max_stale_ttl,
+				    cache_shards, max_cache_size, max_stale_ttl,
 				    stale_refresh_time))
 		{
 			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
@@ -4703,7 +4867,8 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 			}
 			if (pview != NULL) {
 				if (!cache_reusable(pview, view,
-						    zero_no_soattl))
+						    zero_no_soattl,
+						    cache_shards))
 				{
 					isc_log_write(named_g_lctx,
 						      NAMED_LOGCATEGORY_GENERAL,
@@ -4740,7 +4905,12 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 			 * is simply a named cache that is not shared.
 			 */
 			CHECK(dns_cache_create(named_g_loopmgr, view->rdclass,
-					       cachename, &cache));
+					       cachename, cache_shards,
+					       &cache));
+			if (snapshotfile != NULL) {
+				loadcache(mctx, cache, snapshotfile,
+					  view->maxcachettl);
+			}
 		}
 		nsc = isc_mem_get(mctx, sizeof(*nsc));
 		nsc->cache = NULL;
@@ -4749,6 +4919,10 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		nsc->needflush = false;
 		nsc->adbsizeadjusted = false;
 		nsc->rdclass = view->rdclass;
+		nsc->snapshotfile = NULL;
+		if (snapshotfile != NULL) {
+			nsc->snapshotfile = isc_mem_strdup(mctx, snapshotfile);
+		}
 		ISC_LINK_INIT(nsc, link);
 		ISC_LIST_APPEND(*cachelist, nsc, link);
 	}
@@ -5231,6 +5405,16 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	INSIST(result == ISC_R_SUCCESS);
 	view->minimal_any = cfg_obj_asboolean(obj);
 
+	/*
+	 * The answer cache is only used in views without recursion.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "answer-cache-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (cfg_obj_asuint32(obj) > 0 && !view->recursion) {
+		dns_pcache_create(mctx, cfg_obj_asuint32(obj), &view->pcache);
+	}
+
 	obj = NULL;
 	result = named_config_get(maps, "minimal-responses", &obj);
 	INSIST(result == ISC_R_SUCCESS);
@@ -5558,6 +5742,11 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	INSIST(result == ISC_R_SUCCESS);
 	dns_resolver_setmaxqueries(view->resolver, cfg_obj_asuint32(obj));
 
+	obj = NULL;
+	result = named_config_get(maps, "max-query-races", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	dns_resolver_setmaxraces(view->resolver, cfg_obj_asuint32(obj));
+
 	obj = NULL;
 	result = named_config_get(maps, "fetches-per-zone", &obj);
 	INSIST(result == ISC_R_SUCCESS);
@@ -8932,6 +9121,25 @@ load_configuration(const char *filename, named_server_t *server,
 	}
 #endif
 
+	obj = NULL;
+	result = named_config_get(maps, "io-uring", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (first_time) {
+		isc_nm_backend_t backend = cfg_obj_asboolean(obj)
+						   ? isc_nm_backend_uring
+						   : isc_nm_backend_libuv;
+		result = isc_nm_setbackend(named_g_netmgr, backend);
+		if (result != ISC_R_SUCCESS) {
+			cfg_obj_log(obj, named_g_lctx, ISC_LOG_WARNING,
+				    "io-uring has no effect on this system");
+		}
+	} else if (cfg_obj_asboolean(obj) !=
+		   (isc_nm_getbackend(named_g_netmgr) == isc_nm_backend_uring))
+	{
+		cfg_obj_log(obj, named_g_lctx, ISC_LOG_WARNING,
+			    "changing io-uring value requires server restart");
+	}
+
 	/*
 	 * Configure the interface manager according to the "listen-on"
 	 * statement.
@@ -9783,6 +9991,9 @@ cleanup_cachelist:
 	while ((nsc = ISC_LIST_HEAD(cachelist)) != NULL) {
 		ISC_LIST_UNLINK(cachelist, nsc, link);
 		dns_cache_detach(&nsc->cache);
+		if (nsc->snapshotfile != NULL) {
+			isc_mem_free(server->mctx, nsc->snapshotfile);
+		}
 		isc_mem_put(server->mctx, nsc, sizeof(*nsc));
 	}
 
@@ -10108,6 +10319,14 @@ shutdown_server(isc_task_t *task, isc_event_t *event) {
 
 	(void)named_server_saventa(server);
 
+	for (nsc = ISC_LIST_HEAD(server->cachelist); nsc != NULL;
+	     nsc = ISC_LIST_NEXT(nsc, link))
+	{
+		if (nsc->snapshotfile != NULL) {
+			(void)savecache(nsc);
+		}
+	}
+
 	for (kasp = ISC_LIST_HEAD(server->kasplist); kasp != NULL;
 	     kasp = kasp_next)
 	{
@@ -10133,6 +10352,9 @@ shutdown_server(isc_task_t *task, isc_event_t *event) {
 	while ((nsc = ISC_LIST_HEAD(server->cachelist)) != NULL) {
 		ISC_LIST_UNLINK(server->cachelist, nsc, link);
 		dns_cache_detach(&nsc->cache);
+		if (nsc->snapshotfile != NULL) {
+			isc_mem_free(server->mctx, nsc->snapshotfile);
+		}
 		isc_mem_put(server->mctx, nsc, sizeof(*nsc));
 	}
 
@@ -12229,6 +12451,84 @@ named_server_flushcache(named_server_t *server, isc_lex_t *lex) {
 	return (result);
 }
 
+isc_result_t
+named_server_savecache(named_server_t *server, isc_lex_t *lex,
+		       isc_buffer_t **text) {
+	char *ptr;
+	dns_view_t *view;
+	named_cache_t *nsc;
+	bool found = false;
+	isc_result_t result = ISC_R_SUCCESS, tresult;
+
+	/* Skip the command name. */
+	ptr = next_token(lex, NULL);
+	if (ptr == NULL) {
+		return (ISC_R_UNEXPECTEDEND);
+	}
+
+	/* Look for the view name. */
+	ptr = next_token(lex, NULL);
+
+	/*
+	 * The snapshots are written in the background, like "rndc dumpdb"
+	 * writes its dump; only a failure to start is reported here.
+	 */
+	for (nsc = ISC_LIST_HEAD(server->cachelist); nsc != NULL;
+	     nsc = ISC_LIST_NEXT(nsc, link))
+	{
+		if (ptr != NULL) {
+			for (view = ISC_LIST_HEAD(server->viewlist);
+			     view != NULL; view = ISC_LIST_NEXT(view, link))
+			{
+				if (strcasecmp(ptr, view->name) == 0 &&
+				    view->cache == nsc->cache)
+				{
+					break;
+				}
+			}
+			if (view == NULL) {
+				continue;
+			}
+		}
+		found = true;
+
+		if (nsc->snapshotfile == NULL) {
+			if (ptr != NULL) {
+				(void)putstr(text, "no cache-snapshot-file "
+						   "for view '");
+				(void)putstr(text, ptr);
+				(void)putstr(text, "'");
+				result = ISC_R_FAILURE;
+			}
+			continue;
+		}
+
+		tresult = savecache_start(server->mctx, nsc);
+		if (tresult != ISC_R_SUCCESS) {
+			if (isc_buffer_usedlength(*text) > 0) {
+				(void)putstr(text, "\n");
+			}
+			(void)putstr(text, "saving cache '");
+			(void)putstr(text, dns_cache_getname(nsc->cache));
+			(void)putstr(text, "' failed: ");
+			(void)putstr(text, isc_result_totext(tresult));
+			result = tresult;
+		}
+	}
+
+	if (!found && ptr != NULL) {
+		(void)putstr(text, "view '");
+		(void)putstr(text, ptr);
+		(void)putstr(text, "' not found");
+		result = ISC_R_NOTFOUND;
+	}
+	if (isc_buffer_usedlength(*text) > 0) {
+		(void)putnull(text);
+	}
+
+	return (result);
+}
+
 isc_result_t
 named_server_flushnode(named_server_t *server, isc_lex_t *lex, bool tree) {
 	char *ptr, *viewname;
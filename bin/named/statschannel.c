@@ -56,11 +56,11 @@
 #include "xsl_p.h"
 
 #define STATS_XML_VERSION_MAJOR "3"
-#define STATS_XML_VERSION_MINOR "12"
+#define STATS_XML_VERSION_MINOR "13"
 #define STATS_XML_VERSION	STATS_XML_VERSION_MAJOR "." STATS_XML_VERSION_MINOR
 
 #define STATS_JSON_VERSION_MAJOR "1"
-#define STATS_JSON_VERSION_MINOR "6"
+#define STATS_JSON_VERSION_MINOR "7"
 #define STATS_JSON_VERSION	 STATS_JSON_VERSION_MAJOR "." STATS_JSON_VERSION_MINOR
 
 #define CHECK(m)                               \
@@ -352,6 +352,11 @@ init_desc(void) {
 	SET_NSSTATDESC(reclimitdropped,
 		       "queries dropped due to recursive client limit",
 		       "RecLimitDropped");
+	SET_NSSTATDESC(answercachehit, "queries answered from the answer cache",
+		       "AnswerCacheHit");
+	SET_NSSTATDESC(answercachemiss,
+		       "answer cache lookups that found no response",
+		       "AnswerCacheMiss");
 
 	INSIST(i == ns_statscounter_max);
 
@@ -443,6 +448,9 @@ init_desc(void) {
 			"ServerQuota");
 	SET_RESSTATDESC(nextitem, "waited for next item", "NextItem");
 	SET_RESSTATDESC(priming, "priming queries", "Priming");
+	SET_RESSTATDESC(racesent, "queries raced against a slow server",
+			"QueryRace");
+	SET_RESSTATDESC(racewon, "raced queries answered first", "QueryRaceWon");
 
 	INSIST(i == dns_resstatscounter_max);
 
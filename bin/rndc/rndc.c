@@ -179,6 +179,8 @@ command is one of the following:\n\
 		Reload a single zone.\n\
   retransfer zone [class [view]]\n\
 		Retransfer a single zone without checking serial number.\n\
+  savecache [view]\n\
+		Save cache snapshot(s) to the cache-snapshot-file(s).\n\
   scan		Scan available network interfaces for changes.\n\
   secroots [view ...]\n\
 		Write security roots to the secroots file.\n\
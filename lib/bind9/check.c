@@ -46,6 +46,7 @@
 #include <isc/util.h>
 
 #include <dns/acl.h>
+#include <dns/cache.h>
 #include <dns/dnstap.h>
 #include <dns/fixedname.h>
 #include <dns/kasp.h>
@@ -1849,6 +1850,19 @@ check_options(const cfg_obj_t *options, const cfg_obj_t *config,
 		}
 	}
 
+	obj = NULL;
+	(void)cfg_map_get(options, "cache-shards", &obj);
+	if (obj != NULL && (cfg_obj_asuint32(obj) == 0U ||
+			    cfg_obj_asuint32(obj) > DNS_CACHE_MAXSHARDS))
+	{
+		cfg_obj_log(obj, logctx, ISC_LOG_ERROR,
+			    "'cache-shards' must be between 1 and %u",
+			    DNS_CACHE_MAXSHARDS);
+		if (result == ISC_R_SUCCESS) {
+			result = ISC_R_RANGE;
+		}
+	}
+
 	obj = NULL;
 	(void)cfg_map_get(options, "max-ixfr-ratio", &obj);
 	if (obj != NULL && cfg_obj_ispercentage(obj)) {
@@ -3819,7 +3833,8 @@ check_zoneconf(const cfg_obj_t *zconfig, const cfg_obj_t *voptions,
 		result = ISC_R_FAILURE;
 	} else if (!dlz && (tresult == ISC_R_NOTFOUND ||
 			    (tresult == ISC_R_SUCCESS &&
-			     strcmp("rbt", cfg_obj_asstring(obj)) == 0)))
+			     (strcmp("rbt", cfg_obj_asstring(obj)) == 0 ||
+			      strcmp("qp", cfg_obj_asstring(obj)) == 0))))
 	{
 		isc_result_t res1;
 		const cfg_obj_t *fileobj = NULL;
@@ -79,6 +79,20 @@
 #define ADB_HASH_BITS 12
 #endif /* ifndef ADB_HASH_BITS */
 
+/*%
+ * The names and entries tables are split into 2^ADB_HASH_BUCKET_BITS
+ * buckets, each with its own lock, hash table and LRU list, so that
+ * lookups for unrelated names and addresses don't contend on a single
+ * lock.  The total initial capacity is still 2^ADB_HASH_BITS.
+ */
+#ifndef ADB_HASH_BUCKET_BITS
+#define ADB_HASH_BUCKET_BITS 4
+#endif /* ifndef ADB_HASH_BUCKET_BITS */
+#define ADB_HASH_BUCKETS (1 << ADB_HASH_BUCKET_BITS)
+
+STATIC_ASSERT(ADB_HASH_BITS > ADB_HASH_BUCKET_BITS,
+	      "ADB_HASH_BUCKET_BITS must be smaller than ADB_HASH_BITS");
+
 /*%
  * The period in seconds after which an ADB name entry is regarded as stale
  * and forced to be cleaned up.
@@ -98,6 +112,20 @@ typedef ISC_LIST(dns_adbentry_t) dns_adbentrylist_t;
 typedef struct dns_adbfetch dns_adbfetch_t;
 typedef struct dns_adbfetch6 dns_adbfetch6_t;
 
+typedef struct adbnamebucket {
+	isc_mutex_t lock;
+	isc_hashmap_t *table;
+	dns_adbnamelist_t lru;
+	isc_stdtime_t last_update;
+} adbnamebucket_t;
+
+typedef struct adbentrybucket {
+	isc_mutex_t lock;
+	isc_hashmap_t *table;
+	dns_adbentrylist_t lru;
+	isc_stdtime_t last_update;
+} adbentrybucket_t;
+
 /*% dns adb structure */
 struct dns_adb {
 	unsigned int magic;
@@ -114,15 +142,8 @@ struct dns_adb {
 
 	isc_refcount_t references;
 
-	dns_adbnamelist_t names_lru;
-	isc_stdtime_t names_last_update;
-	isc_hashmap_t *names;
-	isc_mutex_t names_lock;
-
-	dns_adbentrylist_t entries_lru;
-	isc_stdtime_t entries_last_update;
-	isc_hashmap_t *entries;
-	isc_mutex_t entries_lock;
+	adbnamebucket_t names[ADB_HASH_BUCKETS];
+	adbentrybucket_t entries[ADB_HASH_BUCKETS];
 
 	isc_stats_t *stats;
 
@@ -163,6 +184,7 @@ struct dns_adbname {
 	dns_adb_t *adb;
 	isc_buffer_t buffer;
 	adbnamekey_t key;
+	uint32_t hashval;
 	dns_name_t name;
 	unsigned int partial_result;
 	unsigned int flags;
@@ -257,6 +279,7 @@ struct dns_adbentry {
 
 	isc_mutex_t lock;
 	isc_stdtime_t last_used;
+	uint32_t hashval;
 
 	isc_refcount_t references;
 	dns_adbnamehooklist_t nhs;
@@ -340,12 +363,14 @@ new_adbfetch(dns_adb_t *);
 static void
 free_adbfetch(dns_adb_t *, dns_adbfetch_t **);
 static void
-purge_stale_names(dns_adb_t *adb, isc_stdtime_t now);
+purge_stale_names(dns_adb_t *adb, adbnamebucket_t *bucket,
+		  isc_stdtime_t now);
 static dns_adbname_t *
 get_attached_and_locked_name(dns_adb_t *, const dns_name_t *,
 			     bool start_at_zone, isc_stdtime_t now);
 static void
-purge_stale_entries(dns_adb_t *adb, isc_stdtime_t now);
+purge_stale_entries(dns_adb_t *adb, adbentrybucket_t *bucket,
+		    isc_stdtime_t now);
 static dns_adbentry_t *
 get_attached_and_locked_entry(dns_adb_t *adb, isc_stdtime_t now,
 			      const isc_sockaddr_t *addr);
@@ -668,7 +693,33 @@ import_rdataset(dns_adbname_t *adbname, dns_rdataset_t *rdataset,
 }
 
 /*
- * Requires the name to be locked.
+ * Names and entries are hashed with the key of the first bucket's
+ * table; the low bits of the result pick the bucket.  The value is
+ * kept in the name or entry, as the other tables use different keys.
+ */
+static uint32_t
+name_hash(dns_adb_t *adb, const void *key, uint32_t keysize) {
+	return (isc_hashmap_hash(adb->names[0].table, key, keysize));
+}
+
+static adbnamebucket_t *
+name_bucket(dns_adb_t *adb, uint32_t hashval) {
+	return (&adb->names[hashval & (ADB_HASH_BUCKETS - 1)]);
+}
+
+static uint32_t
+entry_hash(dns_adb_t *adb, const isc_sockaddr_t *addr) {
+	return (isc_hashmap_hash(adb->entries[0].table,
+				 (const unsigned char *)addr, sizeof(*addr)));
+}
+
+static adbentrybucket_t *
+entry_bucket(dns_adb_t *adb, uint32_t hashval) {
+	return (&adb->entries[hashval & (ADB_HASH_BUCKETS - 1)]);
+}
+
+/*
+ * Requires the name and its bucket to be locked.
  */
 static void
 expire_name(dns_adbname_t *adbname, isc_eventtype_t evtype, isc_stdtime_t now) {
@@ -677,6 +728,7 @@ expire_name(dns_adbname_t *adbname, isc_eventtype_t evtype, isc_stdtime_t now) {
 
 	isc_result_t result;
 	dns_adb_t *adb = adbname->adb;
+	adbnamebucket_t *bucket = name_bucket(adb, adbname->hashval);
 
 	DP(DEF_LEVEL, "killing name %p", adbname);
 
@@ -703,11 +755,11 @@ expire_name(dns_adbname_t *adbname, isc_eventtype_t evtype, isc_stdtime_t now) {
 	/*
 	 * Remove the adbname from the hashtable...
 	 */
-	result = isc_hashmap_delete(adb->names, NULL, &adbname->key.key,
-				    adbname->key.size);
+	result = isc_hashmap_delete(bucket->table, &adbname->hashval,
+				    &adbname->key.key, adbname->key.size);
 	RUNTIME_CHECK(result == ISC_R_SUCCESS);
 	/* ... and LRU list */
-	ISC_LIST_UNLINK(adb->names_lru, adbname, link);
+	ISC_LIST_UNLINK(bucket->lru, adbname, link);
 
 	dns_adbname_detach(&adbname);
 }
@@ -759,39 +811,46 @@ maybe_expire_namehooks(dns_adbname_t *adbname, isc_stdtime_t now) {
 
 static void
 shutdown_names(dns_adb_t *adb) {
-	dns_adbname_t *next = NULL;
+	for (size_t i = 0; i < ADB_HASH_BUCKETS; i++) {
+		adbnamebucket_t *bucket = &adb->names[i];
+		dns_adbname_t *next = NULL;
 
-	LOCK(&adb->names_lock);
-	for (dns_adbname_t *name = ISC_LIST_HEAD(adb->names_lru); name != NULL;
-	     name = next)
-	{
-		next = ISC_LIST_NEXT(name, link);
-		dns_adbname_ref(name);
-		LOCK(&name->lock);
-		/*
-		 * Run through the list.  For each name, clean up finds
-		 * found there, and cancel any fetches running.  When
-		 * all the fetches are canceled, the name will destroy
-		 * itself.
-		 */
-		expire_name(name, DNS_EVENT_ADBSHUTDOWN, INT_MAX);
-		UNLOCK(&name->lock);
-		dns_adbname_detach(&name);
+		LOCK(&bucket->lock);
+		for (dns_adbname_t *name = ISC_LIST_HEAD(bucket->lru);
+		     name != NULL; name = next)
+		{
+			next = ISC_LIST_NEXT(name, link);
+			dns_adbname_ref(name);
+			LOCK(&name->lock);
+			/*
+			 * Run through the list.  For each name, clean up
+			 * finds found there, and cancel any fetches
+			 * running.  When all the fetches are canceled,
+			 * the name will destroy itself.
+			 */
+			expire_name(name, DNS_EVENT_ADBSHUTDOWN, INT_MAX);
+			UNLOCK(&name->lock);
+			dns_adbname_detach(&name);
+		}
+		UNLOCK(&bucket->lock);
 	}
-	UNLOCK(&adb->names_lock);
 }
 
 static void
 shutdown_entries(dns_adb_t *adb) {
-	dns_adbentry_t *next = NULL;
-	LOCK(&adb->entries_lock);
-	for (dns_adbentry_t *adbentry = ISC_LIST_HEAD(adb->entries_lru);
-	     adbentry != NULL; adbentry = next)
-	{
-		next = ISC_LIST_NEXT(adbentry, link);
-		expire_entry(adbentry);
+	for (size_t i = 0; i < ADB_HASH_BUCKETS; i++) {
+		adbentrybucket_t *bucket = &adb->entries[i];
+		dns_adbentry_t *next = NULL;
+
+		LOCK(&bucket->lock);
+		for (dns_adbentry_t *adbentry = ISC_LIST_HEAD(bucket->lru);
+		     adbentry != NULL; adbentry = next)
+		{
+			next = ISC_LIST_NEXT(adbentry, link);
+			expire_entry(adbentry);
+		}
+		UNLOCK(&bucket->lock);
 	}
-	UNLOCK(&adb->entries_lock);
 }
 
 /*
@@ -1333,6 +1392,7 @@ get_attached_and_locked_name(dns_adb_t *adb, const dns_name_t *name,
 			     bool start_at_zone, isc_stdtime_t now) {
 	isc_result_t result;
 	dns_adbname_t *adbname = NULL;
+	adbnamebucket_t *bucket = NULL;
 	uint32_t hashval;
 	isc_time_t timenow;
 	isc_stdtime_t last_update;
@@ -1344,26 +1404,28 @@ get_attached_and_locked_name(dns_adb_t *adb, const dns_name_t *name,
 	memmove(&key.name, name->ndata, name->length);
 	key.size = name->length + sizeof(bool);
 
-	hashval = isc_hashmap_hash(adb->names, &key.key, key.size);
+	hashval = name_hash(adb, &key.key, key.size);
+	bucket = name_bucket(adb, hashval);
 
-	LOCK(&adb->names_lock);
-	last_update = adb->names_last_update;
+	LOCK(&bucket->lock);
+	last_update = bucket->last_update;
 	if (last_update + ADB_STALE_MARGIN < now ||
 	    atomic_load_relaxed(&adb->is_overmem))
 	{
-		last_update = adb->names_last_update = now;
+		last_update = bucket->last_update = now;
 
-		purge_stale_names(adb, now);
+		purge_stale_names(adb, bucket, now);
 	}
 
-	result = isc_hashmap_find(adb->names, &hashval, key.key, key.size,
+	result = isc_hashmap_find(bucket->table, &hashval, key.key, key.size,
 				  (void **)&adbname);
 	switch (result) {
 	case ISC_R_NOTFOUND:
 		/* Allocate a new name and add it to the hash table. */
 		adbname = new_adbname(adb, name, start_at_zone);
+		adbname->hashval = hashval;
 
-		result = isc_hashmap_add(adb->names, &hashval,
+		result = isc_hashmap_add(bucket->table, &hashval,
 					 &adbname->key.key, adbname->key.size,
 					 adbname);
 		INSIST(result == ISC_R_SUCCESS);
@@ -1372,7 +1434,7 @@ get_attached_and_locked_name(dns_adb_t *adb, const dns_name_t *name,
 		LOCK(&adbname->lock); /* Must be unlocked by the caller */
 		adbname->last_used = now;
 
-		ISC_LIST_PREPEND(adb->names_lru, adbname, link);
+		ISC_LIST_PREPEND(bucket->lru, adbname, link);
 		break;
 	case ISC_R_SUCCESS:
 		dns_adbname_ref(adbname);
@@ -1380,8 +1442,8 @@ get_attached_and_locked_name(dns_adb_t *adb, const dns_name_t *name,
 		if (adbname->last_used + ADB_CACHE_MINIMUM <= last_update) {
 			adbname->last_used = now;
 
-			ISC_LIST_UNLINK(adb->names_lru, adbname, link);
-			ISC_LIST_PREPEND(adb->names_lru, adbname, link);
+			ISC_LIST_UNLINK(bucket->lru, adbname, link);
+			ISC_LIST_PREPEND(bucket->lru, adbname, link);
 		}
 		break;
 	default:
@@ -1393,7 +1455,7 @@ get_attached_and_locked_name(dns_adb_t *adb, const dns_name_t *name,
 	 * expire_name() - the unused adbname stored in the hashtable and lru
 	 * has always refcount == 1
 	 */
-	UNLOCK(&adb->names_lock);
+	UNLOCK(&bucket->lock);
 
 	return (adbname);
 }
@@ -1408,22 +1470,22 @@ get_attached_and_locked_entry(dns_adb_t *adb, isc_stdtime_t now,
 	dns_adbentry_t *adbentry = NULL;
 	isc_time_t timenow;
 	isc_stdtime_t last_update;
-	uint32_t hashval = isc_hashmap_hash(
-		adb->entries, (const unsigned char *)addr, sizeof(*addr));
+	uint32_t hashval = entry_hash(adb, addr);
+	adbentrybucket_t *bucket = entry_bucket(adb, hashval);
 
 	isc_time_set(&timenow, now, 0);
 
-	LOCK(&adb->entries_lock);
-	last_update = adb->entries_last_update;
+	LOCK(&bucket->lock);
+	last_update = bucket->last_update;
 	if (now - last_update > ADB_STALE_MARGIN ||
 	    atomic_load_relaxed(&adb->is_overmem))
 	{
-		last_update = adb->entries_last_update = now;
+		last_update = bucket->last_update = now;
 
-		purge_stale_entries(adb, now);
+		purge_stale_entries(adb, bucket, now);
 	}
 
-	result = isc_hashmap_find(adb->entries, &hashval,
+	result = isc_hashmap_find(bucket->table, &hashval,
 				  (const unsigned char *)addr, sizeof(*addr),
 				  (void **)&adbentry);
 	switch (result) {
@@ -1431,8 +1493,9 @@ get_attached_and_locked_entry(dns_adb_t *adb, isc_stdtime_t now,
 	create:
 		/* Allocate a new entry and add it to the hash table. */
 		adbentry = new_adbentry(adb, addr);
+		adbentry->hashval = hashval;
 
-		result = isc_hashmap_add(adb->entries, &hashval,
+		result = isc_hashmap_add(bucket->table, &hashval,
 					 &adbentry->sockaddr,
 					 sizeof(adbentry->sockaddr), adbentry);
 		INSIST(result == ISC_R_SUCCESS);
@@ -1441,7 +1504,7 @@ get_attached_and_locked_entry(dns_adb_t *adb, isc_stdtime_t now,
 		LOCK(&adbentry->lock); /* Must be unlocked by the caller */
 		adbentry->last_used = now;
 
-		ISC_LIST_PREPEND(adb->entries_lru, adbentry, link);
+		ISC_LIST_PREPEND(bucket->lru, adbentry, link);
 		break;
 	}
 	case ISC_R_SUCCESS:
@@ -1459,15 +1522,15 @@ get_attached_and_locked_entry(dns_adb_t *adb, isc_stdtime_t now,
 		if (adbentry->last_used + ADB_CACHE_MINIMUM <= last_update) {
 			adbentry->last_used = now;
 
-			ISC_LIST_UNLINK(adb->entries_lru, adbentry, link);
-			ISC_LIST_PREPEND(adb->entries_lru, adbentry, link);
+			ISC_LIST_UNLINK(bucket->lru, adbentry, link);
+			ISC_LIST_PREPEND(bucket->lru, adbentry, link);
 		}
 		break;
 	default:
 		UNREACHABLE();
 	}
 
-	UNLOCK(&adb->entries_lock);
+	UNLOCK(&bucket->lock);
 
 	return (adbentry);
 }
@@ -1607,7 +1670,7 @@ copy_namehook_lists(dns_adb_t *adb, dns_adbfind_t *find,
 }
 
 /*
- * The name must be locked and write lock on adb->names_lock must be held.
+ * The name and its bucket must be locked.
  */
 static bool
 maybe_expire_name(dns_adbname_t *adbname, isc_stdtime_t now) {
@@ -1640,13 +1703,15 @@ static void
 expire_entry(dns_adbentry_t *adbentry) {
 	isc_result_t result;
 	dns_adb_t *adb = adbentry->adb;
+	adbentrybucket_t *bucket = entry_bucket(adb, adbentry->hashval);
 
 	adbentry->flags |= ENTRY_IS_DEAD;
 
-	result = isc_hashmap_delete(adb->entries, NULL, &adbentry->sockaddr,
+	result = isc_hashmap_delete(bucket->table, &adbentry->hashval,
+				    &adbentry->sockaddr,
 				    sizeof(adbentry->sockaddr));
 	RUNTIME_CHECK(result == ISC_R_SUCCESS);
-	ISC_LIST_UNLINK(adb->entries_lru, adbentry, link);
+	ISC_LIST_UNLINK(bucket->lru, adbentry, link);
 
 	dns_adbentry_detach(&adbentry);
 }
@@ -1676,10 +1741,11 @@ maybe_expire_entry(dns_adbentry_t *adbentry, isc_stdtime_t now) {
  * We don't care about a race on 'overmem' at the risk of causing some
  * collateral damage or a small delay in starting cleanup.
  *
- * adb->names_lock MUST be write locked
+ * The bucket MUST be locked.
  */
 static void
-purge_stale_names(dns_adb_t *adb, isc_stdtime_t now) {
+purge_stale_names(dns_adb_t *adb, adbnamebucket_t *bucket,
+		  isc_stdtime_t now) {
 	bool overmem = atomic_load_relaxed(&adb->is_overmem);
 	int max_removed = overmem ? 2 : 1;
 	int scans = 0, removed = 0;
@@ -1692,7 +1758,7 @@ purge_stale_names(dns_adb_t *adb, isc_stdtime_t now) {
 	 * happen).
 	 */
 
-	for (dns_adbname_t *adbname = ISC_LIST_TAIL(adb->names_lru);
+	for (dns_adbname_t *adbname = ISC_LIST_TAIL(bucket->lru);
 	     adbname != NULL && removed < max_removed && scans < 10;
 	     adbname = prev)
 	{
@@ -1749,28 +1815,32 @@ purge_stale_names(dns_adb_t *adb, isc_stdtime_t now) {
 
 static void
 cleanup_names(dns_adb_t *adb, isc_stdtime_t now) {
-	dns_adbname_t *next = NULL;
+	for (size_t i = 0; i < ADB_HASH_BUCKETS; i++) {
+		adbnamebucket_t *bucket = &adb->names[i];
+		dns_adbname_t *next = NULL;
 
-	LOCK(&adb->names_lock);
-	for (dns_adbname_t *adbname = ISC_LIST_HEAD(adb->names_lru);
-	     adbname != NULL; adbname = next)
-	{
-		next = ISC_LIST_NEXT(adbname, link);
+		LOCK(&bucket->lock);
+		for (dns_adbname_t *adbname = ISC_LIST_HEAD(bucket->lru);
+		     adbname != NULL; adbname = next)
+		{
+			next = ISC_LIST_NEXT(adbname, link);
 
-		dns_adbname_ref(adbname);
-		LOCK(&adbname->lock);
-		/*
-		 * Name hooks expire after the address record's TTL
-		 * or 30 minutes, whichever is shorter. If after cleaning
-		 * those up there are no name hooks left, and no active
-		 * fetches, we can remove this name from the bucket.
-		 */
-		maybe_expire_namehooks(adbname, now);
-		(void)maybe_expire_name(adbname, now);
-		UNLOCK(&adbname->lock);
-		dns_adbname_detach(&adbname);
+			dns_adbname_ref(adbname);
+			LOCK(&adbname->lock);
+			/*
+			 * Name hooks expire after the address record's TTL
+			 * or 30 minutes, whichever is shorter. If after
+			 * cleaning those up there are no name hooks left,
+			 * and no active fetches, we can remove this name
+			 * from the bucket.
+			 */
+			maybe_expire_namehooks(adbname, now);
+			(void)maybe_expire_name(adbname, now);
+			UNLOCK(&adbname->lock);
+			dns_adbname_detach(&adbname);
+		}
+		UNLOCK(&bucket->lock);
 	}
-	UNLOCK(&adb->names_lock);
 }
 
 /*%
@@ -1781,10 +1851,11 @@ cleanup_names(dns_adb_t *adb, isc_stdtime_t now) {
  * We don't care about a race on 'overmem' at the risk of causing some
  * collateral damage or a small delay in starting cleanup.
  *
- * adb->names_lock MUST be write locked
+ * The bucket MUST be locked.
  */
 static void
-purge_stale_entries(dns_adb_t *adb, isc_stdtime_t now) {
+purge_stale_entries(dns_adb_t *adb, adbentrybucket_t *bucket,
+		    isc_stdtime_t now) {
 	bool overmem = atomic_load_relaxed(&adb->is_overmem);
 	int max_removed = overmem ? 2 : 1;
 	int scans = 0, removed = 0;
@@ -1797,7 +1868,7 @@ purge_stale_entries(dns_adb_t *adb, isc_stdtime_t now) {
 	 * happen).
 	 */
 
-	for (dns_adbentry_t *adbentry = ISC_LIST_TAIL(adb->entries_lru);
+	for (dns_adbentry_t *adbentry = ISC_LIST_TAIL(bucket->lru);
 	     adbentry != NULL && removed < max_removed && scans < 10;
 	     adbentry = prev)
 	{
@@ -1852,21 +1923,43 @@ purge_stale_entries(dns_adb_t *adb, isc_stdtime_t now) {
 
 static void
 cleanup_entries(dns_adb_t *adb, isc_stdtime_t now) {
-	dns_adbentry_t *next = NULL;
+	for (size_t i = 0; i < ADB_HASH_BUCKETS; i++) {
+		adbentrybucket_t *bucket = &adb->entries[i];
+		dns_adbentry_t *next = NULL;
 
-	LOCK(&adb->entries_lock);
-	for (dns_adbentry_t *adbentry = ISC_LIST_HEAD(adb->entries_lru);
-	     adbentry != NULL; adbentry = next)
-	{
-		next = ISC_LIST_NEXT(adbentry, link);
+		LOCK(&bucket->lock);
+		for (dns_adbentry_t *adbentry = ISC_LIST_HEAD(bucket->lru);
+		     adbentry != NULL; adbentry = next)
+		{
+			next = ISC_LIST_NEXT(adbentry, link);
 
-		dns_adbentry_ref(adbentry);
-		LOCK(&adbentry->lock);
-		maybe_expire_entry(adbentry, now);
-		UNLOCK(&adbentry->lock);
-		dns_adbentry_detach(&adbentry);
+			dns_adbentry_ref(adbentry);
+			LOCK(&adbentry->lock);
+			maybe_expire_entry(adbentry, now);
+			UNLOCK(&adbentry->lock);
+			dns_adbentry_detach(&adbentry);
+		}
+		UNLOCK(&bucket->lock);
+	}
+}
+
+static void
+destroy_buckets(dns_adb_t *adb) {
+	for (size_t i = 0; i < ADB_HASH_BUCKETS; i++) {
+		adbnamebucket_t *nbucket = &adb->names[i];
+		adbentrybucket_t *ebucket = &adb->entries[i];
+
+		INSIST(isc_hashmap_count(nbucket->table) == 0);
+		INSIST(ISC_LIST_EMPTY(nbucket->lru));
+		isc_hashmap_destroy(&nbucket->table);
+		isc_mutex_destroy(&nbucket->lock);
+
+		/* There are no unassociated entries */
+		INSIST(isc_hashmap_count(ebucket->table) == 0);
+		INSIST(ISC_LIST_EMPTY(ebucket->lru));
+		isc_hashmap_destroy(&ebucket->table);
+		isc_mutex_destroy(&ebucket->lock);
 	}
-	UNLOCK(&adb->entries_lock);
 }
 
 static void
@@ -1875,18 +1968,7 @@ destroy(dns_adb_t *adb) {
 
 	adb->magic = 0;
 
-	LOCK(&adb->names_lock);
-	INSIST(isc_hashmap_count(adb->names) == 0);
-	isc_hashmap_destroy(&adb->names);
-	UNLOCK(&adb->names_lock);
-	isc_mutex_destroy(&adb->names_lock);
-
-	LOCK(&adb->entries_lock);
-	/* There are no unassociated entries */
-	INSIST(isc_hashmap_count(adb->entries) == 0);
-	isc_hashmap_destroy(&adb->entries);
-	UNLOCK(&adb->entries_lock);
-	isc_mutex_destroy(&adb->entries_lock);
+	destroy_buckets(adb);
 
 	isc_mem_destroy(&adb->hmctx);
 
@@ -1929,8 +2011,6 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_loopmgr_t *loopmgr,
 	*adb = (dns_adb_t){
 		.taskmgr = taskmgr,
 		.nloops = isc_loopmgr_nloops(loopmgr),
-		.names_lru = ISC_LIST_INITIALIZER,
-		.entries_lru = ISC_LIST_INITIALIZER,
 	};
 
 	/*
@@ -1948,13 +2028,25 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_loopmgr_t *loopmgr,
 
 	isc_mem_create(&adb->hmctx);
 
-	isc_hashmap_create(adb->hmctx, ADB_HASH_BITS,
-			   ISC_HASHMAP_CASE_INSENSITIVE, &adb->names);
-	isc_mutex_init(&adb->names_lock);
-
-	isc_hashmap_create(adb->hmctx, ADB_HASH_BITS,
-			   ISC_HASHMAP_CASE_SENSITIVE, &adb->entries);
-	isc_mutex_init(&adb->entries_lock);
+	for (size_t i = 0; i < ADB_HASH_BUCKETS; i++) {
+		adb->names[i] = (adbnamebucket_t){
+			.lru = ISC_LIST_INITIALIZER,
+		};
+		isc_hashmap_create(adb->hmctx,
+				   ADB_HASH_BITS - ADB_HASH_BUCKET_BITS,
+				   ISC_HASHMAP_CASE_INSENSITIVE,
+				   &adb->names[i].table);
+		isc_mutex_init(&adb->names[i].lock);
+
+		adb->entries[i] = (adbentrybucket_t){
+			.lru = ISC_LIST_INITIALIZER,
+		};
+		isc_hashmap_create(adb->hmctx,
+				   ADB_HASH_BITS - ADB_HASH_BUCKET_BITS,
+				   ISC_HASHMAP_CASE_SENSITIVE,
+				   &adb->entries[i].table);
+		isc_mutex_init(&adb->entries[i].lock);
+	}
 
 	isc_mutex_init(&adb->lock);
 
@@ -1996,13 +2088,7 @@ free_tasks:
 
 	isc_mutex_destroy(&adb->lock);
 
-	isc_mutex_destroy(&adb->entries_lock);
-	isc_hashmap_destroy(&adb->entries);
-	INSIST(ISC_LIST_EMPTY(adb->entries_lru));
-
-	isc_mutex_destroy(&adb->names_lock);
-	isc_hashmap_destroy(&adb->names);
-	INSIST(ISC_LIST_EMPTY(adb->names_lru));
+	destroy_buckets(adb);
 
 	isc_mem_destroy(&adb->hmctx);
 
@@ -2486,7 +2572,7 @@ dump_ttl(FILE *f, const char *legend, isc_stdtime_t value, isc_stdtime_t now) {
 }
 
 /*
- * Both rwlocks for the hash tables need to be held by the caller.
+ * Locks all the buckets of both hash tables.
  */
 static void
 dump_adb(dns_adb_t *adb, FILE *f, bool debug, isc_stdtime_t now) {
@@ -2501,59 +2587,76 @@ dump_adb(dns_adb_t *adb, FILE *f, bool debug, isc_stdtime_t now) {
 	/*
 	 * Ensure this operation is applied to both hash tables at once.
 	 */
-	LOCK(&adb->names_lock);
+	for (size_t i = 0; i < ADB_HASH_BUCKETS; i++) {
+		LOCK(&adb->names[i].lock);
+	}
 
-	for (dns_adbname_t *name = ISC_LIST_HEAD(adb->names_lru); name != NULL;
-	     name = ISC_LIST_NEXT(name, link))
-	{
-		LOCK(&name->lock);
-		/*
-		 * Dump the names
-		 */
-		if (debug) {
-			fprintf(f, "; name %p (flags %08x)\n", name,
-				name->flags);
-		}
-		fprintf(f, "; ");
-		dns_name_print(&name->name, f);
-		if (dns_name_countlabels(&name->target) > 0) {
-			fprintf(f, " alias ");
-			dns_name_print(&name->target, f);
-		}
+	for (size_t i = 0; i < ADB_HASH_BUCKETS; i++) {
+		for (dns_adbname_t *name = ISC_LIST_HEAD(adb->names[i].lru);
+		     name != NULL; name = ISC_LIST_NEXT(name, link))
+		{
+			LOCK(&name->lock);
+			/*
+			 * Dump the names
+			 */
+			if (debug) {
+				fprintf(f, "; name %p (flags %08x)\n", name,
+					name->flags);
+			}
+			fprintf(f, "; ");
+			dns_name_print(&name->name, f);
+			if (dns_name_countlabels(&name->target) > 0) {
+				fprintf(f, " alias ");
+				dns_name_print(&name->target, f);
+			}
 
-		dump_ttl(f, "v4", name->expire_v4, now);
-		dump_ttl(f, "v6", name->expire_v6, now);
-		dump_ttl(f, "target", name->expire_target, now);
+			dump_ttl(f, "v4", name->expire_v4, now);
+			dump_ttl(f, "v6", name->expire_v6, now);
+			dump_ttl(f, "target", name->expire_target, now);
 
-		fprintf(f, " [v4 %s] [v6 %s]", errnames[name->fetch_err],
-			errnames[name->fetch6_err]);
+			fprintf(f, " [v4 %s] [v6 %s]",
+				errnames[name->fetch_err],
+				errnames[name->fetch6_err]);
 
-		fprintf(f, "\n");
+			fprintf(f, "\n");
 
-		print_namehook_list(f, "v4", adb, &name->v4, debug, now);
-		print_namehook_list(f, "v6", adb, &name->v6, debug, now);
+			print_namehook_list(f, "v4", adb, &name->v4, debug,
+					    now);
+			print_namehook_list(f, "v6", adb, &name->v6, debug,
+					    now);
 
-		if (debug) {
-			print_fetch_list(f, name);
-			print_find_list(f, name);
+			if (debug) {
+				print_fetch_list(f, name);
+				print_find_list(f, name);
+			}
+			UNLOCK(&name->lock);
 		}
-		UNLOCK(&name->lock);
 	}
 
-	LOCK(&adb->entries_lock);
+	for (size_t i = 0; i < ADB_HASH_BUCKETS; i++) {
+		LOCK(&adb->entries[i].lock);
+	}
+
 	fprintf(f, ";\n; Unassociated entries\n;\n");
-	for (dns_adbentry_t *adbentry = ISC_LIST_HEAD(adb->entries_lru);
-	     adbentry != NULL; adbentry = ISC_LIST_NEXT(adbentry, link))
-	{
-		LOCK(&adbentry->lock);
-		if (ISC_LIST_EMPTY(adbentry->nhs)) {
-			dump_entry(f, adb, adbentry, debug, now);
+	for (size_t i = 0; i < ADB_HASH_BUCKETS; i++) {
+		for (dns_adbentry_t *adbentry =
+			     ISC_LIST_HEAD(adb->entries[i].lru);
+		     adbentry != NULL; adbentry = ISC_LIST_NEXT(adbentry, link))
+		{
+			LOCK(&adbentry->lock);
+			if (ISC_LIST_EMPTY(adbentry->nhs)) {
+				dump_entry(f, adb, adbentry, debug, now);
+			}
+			UNLOCK(&adbentry->lock);
 		}
-		UNLOCK(&adbentry->lock);
 	}
 
-	UNLOCK(&adb->entries_lock);
-	UNLOCK(&adb->names_lock);
+	for (size_t i = ADB_HASH_BUCKETS; i > 0; i--) {
+		UNLOCK(&adb->entries[i - 1].lock);
+	}
+	for (size_t i = ADB_HASH_BUCKETS; i > 0; i--) {
+		UNLOCK(&adb->names[i - 1].lock);
+	}
 }
 
 static void
@@ -2726,39 +2829,43 @@ isc_result_t
 dns_adb_dumpquota(dns_adb_t *adb, isc_buffer_t **buf) {
 	REQUIRE(DNS_ADB_VALID(adb));
 
-	isc_hashmap_iter_t *it = NULL;
-	isc_result_t result;
+	for (size_t i = 0; i < ADB_HASH_BUCKETS; i++) {
+		adbentrybucket_t *bucket = &adb->entries[i];
+		isc_hashmap_iter_t *it = NULL;
+		isc_result_t result;
 
-	LOCK(&adb->entries_lock);
-	isc_hashmap_iter_create(adb->entries, &it);
-	for (result = isc_hashmap_iter_first(it); result == ISC_R_SUCCESS;
-	     result = isc_hashmap_iter_next(it))
-	{
-		dns_adbentry_t *entry = NULL;
-		isc_hashmap_iter_current(it, (void **)&entry);
+		LOCK(&bucket->lock);
+		isc_hashmap_iter_create(bucket->table, &it);
+		for (result = isc_hashmap_iter_first(it);
+		     result == ISC_R_SUCCESS;
+		     result = isc_hashmap_iter_next(it))
+		{
+			dns_adbentry_t *entry = NULL;
+			isc_hashmap_iter_current(it, (void **)&entry);
 
-		LOCK(&entry->lock);
-		char addrbuf[ISC_NETADDR_FORMATSIZE];
-		char text[ISC_NETADDR_FORMATSIZE + BUFSIZ];
-		isc_netaddr_t netaddr;
+			LOCK(&entry->lock);
+			char addrbuf[ISC_NETADDR_FORMATSIZE];
+			char text[ISC_NETADDR_FORMATSIZE + BUFSIZ];
+			isc_netaddr_t netaddr;
 
-		if (entry->atr == 0.0 && entry->quota == adb->quota) {
-			goto unlock;
-		}
+			if (entry->atr == 0.0 && entry->quota == adb->quota) {
+				goto unlock;
+			}
 
-		isc_netaddr_fromsockaddr(&netaddr, &entry->sockaddr);
-		isc_netaddr_format(&netaddr, addrbuf, sizeof(addrbuf));
+			isc_netaddr_fromsockaddr(&netaddr, &entry->sockaddr);
+			isc_netaddr_format(&netaddr, addrbuf, sizeof(addrbuf));
 
-		snprintf(text, sizeof(text),
-			 "\n- quota %s (%" PRIuFAST32 "/%d) atr %0.2f", addrbuf,
-			 atomic_load_relaxed(&entry->quota), adb->quota,
-			 entry->atr);
-		putstr(buf, text);
-	unlock:
-		UNLOCK(&entry->lock);
+			snprintf(text, sizeof(text),
+				 "\n- quota %s (%" PRIuFAST32 "/%d) atr %0.2f",
+				 addrbuf, atomic_load_relaxed(&entry->quota),
+				 adb->quota, entry->atr);
+			putstr(buf, text);
+		unlock:
+			UNLOCK(&entry->lock);
+		}
+		isc_hashmap_iter_destroy(&it);
+		UNLOCK(&bucket->lock);
 	}
-	isc_hashmap_iter_destroy(&it);
-	UNLOCK(&adb->entries_lock);
 
 	return (ISC_R_SUCCESS);
 }
@@ -3595,9 +3702,11 @@ dns_adb_flush(dns_adb_t *adb) {
 void
 dns_adb_flushname(dns_adb_t *adb, const dns_name_t *name) {
 	dns_adbname_t *adbname = NULL;
+	adbnamebucket_t *bucket = NULL;
 	isc_result_t result;
 	bool start_at_zone = false;
 	adbnamekey_t key;
+	uint32_t hashval;
 
 	REQUIRE(DNS_ADB_VALID(adb));
 	REQUIRE(name != NULL);
@@ -3606,7 +3715,6 @@ dns_adb_flushname(dns_adb_t *adb, const dns_name_t *name) {
 		return;
 	}
 
-	LOCK(&adb->names_lock);
 again:
 	/*
 	 * Delete both entries - without and with NAME_STARTATZONE set.
@@ -3615,7 +3723,11 @@ again:
 	memmove(&key.name, name->ndata, name->length);
 	key.size = name->length + sizeof(bool);
 
-	result = isc_hashmap_find(adb->names, NULL, key.key, key.size,
+	hashval = name_hash(adb, &key.key, key.size);
+	bucket = name_bucket(adb, hashval);
+
+	LOCK(&bucket->lock);
+	result = isc_hashmap_find(bucket->table, &hashval, key.key, key.size,
 				  (void **)&adbname);
 	if (result == ISC_R_SUCCESS) {
 		dns_adbname_ref(adbname);
@@ -3626,11 +3738,12 @@ again:
 		UNLOCK(&adbname->lock);
 		dns_adbname_detach(&adbname);
 	}
+	UNLOCK(&bucket->lock);
+
 	if (!start_at_zone) {
 		start_at_zone = true;
 		goto again;
 	}
-	UNLOCK(&adb->names_lock);
 }
 
 void
@@ -3644,20 +3757,25 @@ dns_adb_flushnames(dns_adb_t *adb, const dns_name_t *name) {
 		return;
 	}
 
-	LOCK(&adb->names_lock);
-	for (dns_adbname_t *adbname = ISC_LIST_HEAD(adb->names_lru);
-	     adbname != NULL; adbname = next)
-	{
-		next = ISC_LIST_NEXT(adbname, link);
-		dns_adbname_ref(adbname);
-		LOCK(&adbname->lock);
-		if (dns_name_issubdomain(&adbname->name, name)) {
-			expire_name(adbname, DNS_EVENT_ADBCANCELED, INT_MAX);
+	for (size_t i = 0; i < ADB_HASH_BUCKETS; i++) {
+		adbnamebucket_t *bucket = &adb->names[i];
+
+		LOCK(&bucket->lock);
+		for (dns_adbname_t *adbname = ISC_LIST_HEAD(bucket->lru);
+		     adbname != NULL; adbname = next)
+		{
+			next = ISC_LIST_NEXT(adbname, link);
+			dns_adbname_ref(adbname);
+			LOCK(&adbname->lock);
+			if (dns_name_issubdomain(&adbname->name, name)) {
+				expire_name(adbname, DNS_EVENT_ADBCANCELED,
+					    INT_MAX);
+			}
+			UNLOCK(&adbname->lock);
+			dns_adbname_detach(&adbname);
 		}
-		UNLOCK(&adbname->lock);
-		dns_adbname_detach(&adbname);
+		UNLOCK(&bucket->lock);
 	}
-	UNLOCK(&adb->names_lock);
 }
 
 static void
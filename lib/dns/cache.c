@@ -22,16 +22,20 @@
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/stats.h>
+#include <isc/stdtime.h>
 #include <isc/string.h>
 #include <isc/time.h>
 #include <isc/timer.h>
 #include <isc/util.h>
 
 #include <dns/cache.h>
+#include <dns/callbacks.h>
 #include <dns/db.h>
 #include <dns/dbiterator.h>
 #include <dns/log.h>
+#include <dns/master.h>
 #include <dns/masterdump.h>
+#include <dns/rbt.h>
 #include <dns/rdata.h>
 #include <dns/rdataset.h>
 #include <dns/rdatasetiter.h>
@@ -76,6 +80,7 @@ struct dns_cache {
 
 	/* Locked by 'lock'. */
 	dns_rdataclass_t rdclass;
+	unsigned int nshards;
 	dns_db_t *db;
 	size_t size;
 	dns_ttl_t serve_stale_ttl;
@@ -84,12 +89,922 @@ struct dns_cache {
 	bool overmem;
 };
 
+/*%
+ * A sharded cache database.  The names are spread over several "rbt"
+ * cache databases by a hash of their last two labels (three, counting
+ * the root), so that a name and all of its ancestors below the top-level
+ * domain are in the same shard; the root and the top-level names are in
+ * shard 0.  Every shard has its own tree lock, node locks, LRU lists and
+ * TTL wheels, so adding and looking up names in different shards doesn't
+ * contend on them.
+ *
+ * The nodes of a shard are tagged with its number (see
+ * dns__rbtdb_setshard()), so the methods that take a node go straight
+ * to its shard.  A lookup that finds neither the name nor a zone cut
+ * above it in its shard is repeated in shard 0, which holds the
+ * delegations from the root and the top-level domains.
+ */
+#define CACHEDB_MAGIC	   ISC_MAGIC('C', 'D', 'B', 'S')
+#define VALID_CACHEDB(db) \
+	((db) != NULL && (db)->common.impmagic == CACHEDB_MAGIC)
+
+#define CACHEDB_KEYLABELS 3
+
+typedef struct cachedb {
+	dns_db_t common;
+	isc_refcount_t references;
+	dns_stats_t *rrsetstats;
+	unsigned int nshards;
+	dns_db_t **shards;
+	dns_dbnode_t **roots; /* keep every shard's tree rooted at '.' */
+} cachedb_t;
+
+/*%
+ * An iterator over a sharded cache database merges the iterators over
+ * the shards.  Between calls, every shard iterator is paused, and the
+ * ones other than 'current' are on the first node after the current
+ * one in the direction of iteration (nodes with the same name in
+ * different shards are ordered by shard number).  The names are always
+ * absolute.
+ */
+typedef struct cachedb_iterpos {
+	dns_dbiterator_t *iter;
+	isc_result_t result;
+	dns_fixedname_t name;
+} cachedb_iterpos_t;
+
+typedef struct cachedb_iter {
+	dns_dbiterator_t common;
+	isc_result_t result;
+	bool forward;
+	unsigned int current;
+	unsigned int npos;
+	cachedb_iterpos_t pos[];
+} cachedb_iter_t;
+
 /***
  ***	Functions
  ***/
 
+/*
+ * Sharded cache database.
+ */
+
+static dns_dbmethods_t cachedb_methods;
+static dns_dbiteratormethods_t cachedb_itermethods;
+
+static unsigned int
+nameshard(cachedb_t *cachedb, const dns_name_t *name) {
+	unsigned int labels = dns_name_countlabels(name);
+	dns_name_t suffix;
+
+	if (labels < CACHEDB_KEYLABELS) {
+		return (0);
+	}
+
+	dns_name_init(&suffix, NULL);
+	dns_name_getlabelsequence(name, labels - CACHEDB_KEYLABELS,
+				  CACHEDB_KEYLABELS, &suffix);
+	return (dns_name_fullhash(&suffix, false) % cachedb->nshards);
+}
+
+static dns_db_t *
+nodeshard(cachedb_t *cachedb, dns_dbnode_t *node) {
+	unsigned int shard = ((dns_rbtnode_t *)node)->shard;
+
+	INSIST(shard < cachedb->nshards);
+	return (cachedb->shards[shard]);
+}
+
+static void
+cachedb_free(cachedb_t *cachedb) {
+	isc_mem_t *mctx = cachedb->common.mctx;
+
+	for (unsigned int i = 0; i < cachedb->nshards; i++) {
+		if (cachedb->roots[i] != NULL) {
+			dns_db_detachnode(cachedb->shards[i],
+					  &cachedb->roots[i]);
+		}
+		if (cachedb->shards[i] != NULL) {
+			dns_db_detach(&cachedb->shards[i]);
+		}
+	}
+	isc_mem_put(mctx, cachedb->roots,
+		    cachedb->nshards * sizeof(cachedb->roots[0]));
+	isc_mem_put(mctx, cachedb->shards,
+		    cachedb->nshards * sizeof(cachedb->shards[0]));
+	if (cachedb->rrsetstats != NULL) {
+		dns_stats_detach(&cachedb->rrsetstats);
+	}
+
+	cachedb->common.magic = 0;
+	cachedb->common.impmagic = 0;
+	isc_mem_putanddetach(&cachedb->common.mctx, cachedb, sizeof(*cachedb));
+}
+
+static void
+cachedb_attach(dns_db_t *source, dns_db_t **targetp) {
+	cachedb_t *cachedb = (cachedb_t *)source;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	isc_refcount_increment(&cachedb->references);
+	*targetp = source;
+}
+
+static void
+cachedb_detach(dns_db_t **dbp) {
+	cachedb_t *cachedb = (cachedb_t *)*dbp;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	*dbp = NULL;
+	if (isc_refcount_decrement(&cachedb->references) == 1) {
+		isc_refcount_destroy(&cachedb->references);
+		cachedb_free(cachedb);
+	}
+}
+
+static isc_result_t
+cachedb_beginload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
+	UNUSED(db);
+	UNUSED(callbacks);
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+static isc_result_t
+cachedb_endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
+	UNUSED(db);
+	UNUSED(callbacks);
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+static isc_result_t
+cachedb_dump(dns_db_t *db, dns_dbversion_t *version, const char *filename,
+	     dns_masterformat_t masterformat) {
+	REQUIRE(VALID_CACHEDB((cachedb_t *)db));
+
+	return (dns_master_dump(db->mctx, db, version,
+				&dns_master_style_default, filename,
+				masterformat, NULL));
+}
+
+/*
+ * Cache databases have a single version, which they ignore; use the
+ * one of shard 0.
+ */
+static void
+cachedb_currentversion(dns_db_t *db, dns_dbversion_t **versionp) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	dns_db_currentversion(cachedb->shards[0], versionp);
+}
+
+static isc_result_t
+cachedb_newversion(dns_db_t *db, dns_dbversion_t **versionp) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	return (dns_db_newversion(cachedb->shards[0], versionp));
+}
+
+static void
+cachedb_attachversion(dns_db_t *db, dns_dbversion_t *source,
+		      dns_dbversion_t **targetp) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	dns_db_attachversion(cachedb->shards[0], source, targetp);
+}
+
+static void
+cachedb_closeversion(dns_db_t *db, dns_dbversion_t **versionp, bool commit) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	dns_db_closeversion(cachedb->shards[0], versionp, commit);
+}
+
+static isc_result_t
+cachedb_findnode(dns_db_t *db, const dns_name_t *name, bool create,
+		 dns_dbnode_t **nodep) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	return (dns_db_findnode(cachedb->shards[nameshard(cachedb, name)],
+				name, create, nodep));
+}
+
+static isc_result_t
+cachedb_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
+	     dns_rdatatype_t type, unsigned int options, isc_stdtime_t now,
+	     dns_dbnode_t **nodep, dns_name_t *foundname,
+	     dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+	unsigned int shard;
+	isc_result_t result;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	shard = nameshard(cachedb, name);
+	result = dns_db_find(cachedb->shards[shard], name, version, type,
+			     options, now, nodep, foundname, rdataset,
+			     sigrdataset);
+	if (result == ISC_R_NOTFOUND && shard != 0) {
+		result = dns_db_find(cachedb->shards[0], name, version, type,
+				     options, now, nodep, foundname, rdataset,
+				     sigrdataset);
+	}
+
+	return (result);
+}
+
+static isc_result_t
+cachedb_findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
+		    isc_stdtime_t now, dns_dbnode_t **nodep,
+		    dns_name_t *foundname, dns_name_t *dcname,
+		    dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+	unsigned int shard;
+	isc_result_t result;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	shard = nameshard(cachedb, name);
+	result = dns_db_findzonecut(cachedb->shards[shard], name, options, now,
+				    nodep, foundname, dcname, rdataset,
+				    sigrdataset);
+	if (result == ISC_R_NOTFOUND && shard != 0) {
+		result = dns_db_findzonecut(cachedb->shards[0], name, options,
+					    now, nodep, foundname, dcname,
+					    rdataset, sigrdataset);
+	}
+
+	return (result);
+}
+
+static void
+cachedb_attachnode(dns_db_t *db, dns_dbnode_t *source,
+		   dns_dbnode_t **targetp) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	dns_db_attachnode(nodeshard(cachedb, source), source, targetp);
+}
+
+static void
+cachedb_detachnode(dns_db_t *db, dns_dbnode_t **targetp) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	dns_db_detachnode(nodeshard(cachedb, *targetp), targetp);
+}
+
+static isc_result_t
+cachedb_expirenode(dns_db_t *db, dns_dbnode_t *node, isc_stdtime_t now) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	return (dns_db_expirenode(nodeshard(cachedb, node), node, now));
+}
+
+static void
+cachedb_printnode(dns_db_t *db, dns_dbnode_t *node, FILE *out) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	dns_db_printnode(nodeshard(cachedb, node), node, out);
+}
+
+static isc_result_t
+cachedb_createiterator(dns_db_t *db, unsigned int options,
+		       dns_dbiterator_t **iteratorp) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+	cachedb_iter_t *it = NULL;
+	size_t size;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	size = sizeof(*it) + cachedb->nshards * sizeof(it->pos[0]);
+	it = isc_mem_getx(db->mctx, size, ISC_MEM_ZERO);
+	it->common.methods = &cachedb_itermethods;
+	it->common.relative_names = false;
+	it->result = ISC_R_NOMORE;
+	it->npos = cachedb->nshards;
+	dns_db_attach(db, &it->common.db);
+
+	options &= ~DNS_DB_RELATIVENAMES;
+	for (unsigned int i = 0; i < it->npos; i++) {
+		dns_fixedname_init(&it->pos[i].name);
+		it->pos[i].result = ISC_R_NOMORE;
+		if (result == ISC_R_SUCCESS) {
+			result = dns_db_createiterator(cachedb->shards[i],
+						       options,
+						       &it->pos[i].iter);
+		}
+	}
+
+	it->common.magic = DNS_DBITERATOR_MAGIC;
+	if (result != ISC_R_SUCCESS) {
+		dns_dbiterator_t *iter = &it->common;
+		dns_dbiterator_destroy(&iter);
+		return (result);
+	}
+
+	*iteratorp = &it->common;
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+cachedb_findrdataset(dns_db_t *db, dns_dbnode_t *node,
+		     dns_dbversion_t *version, dns_rdatatype_t type,
+		     dns_rdatatype_t covers, isc_stdtime_t now,
+		     dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	return (dns_db_findrdataset(nodeshard(cachedb, node), node, version,
+				    type, covers, now, rdataset, sigrdataset));
+}
+
+static isc_result_t
+cachedb_allrdatasets(dns_db_t *db, dns_dbnode_t *node,
+		     dns_dbversion_t *version, unsigned int options,
+		     isc_stdtime_t now, dns_rdatasetiter_t **iteratorp) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	return (dns_db_allrdatasets(nodeshard(cachedb, node), node, version,
+				    options, now, iteratorp));
+}
+
+static isc_result_t
+cachedb_addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
+		    isc_stdtime_t now, dns_rdataset_t *rdataset,
+		    unsigned int options, dns_rdataset_t *addedrdataset) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	return (dns_db_addrdataset(nodeshard(cachedb, node), node, version, now,
+				   rdataset, options, addedrdataset));
+}
+
+static isc_result_t
+cachedb_subtractrdataset(dns_db_t *db, dns_dbnode_t *node,
+			 dns_dbversion_t *version, dns_rdataset_t *rdataset,
+			 unsigned int options, dns_rdataset_t *newrdataset) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	return (dns_db_subtractrdataset(nodeshard(cachedb, node), node, version,
+					rdataset, options, newrdataset));
+}
+
+static isc_result_t
+cachedb_deleterdataset(dns_db_t *db, dns_dbnode_t *node,
+		       dns_dbversion_t *version, dns_rdatatype_t type,
+		       dns_rdatatype_t covers) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	return (dns_db_deleterdataset(nodeshard(cachedb, node), node, version,
+				      type, covers));
+}
+
+static bool
+cachedb_issecure(dns_db_t *db) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	return (dns_db_issecure(cachedb->shards[0]));
+}
+
+static unsigned int
+cachedb_nodecount(dns_db_t *db, dns_dbtree_t tree) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+	unsigned int count = 0;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	for (unsigned int i = 0; i < cachedb->nshards; i++) {
+		count += dns_db_nodecount(cachedb->shards[i], tree);
+	}
+
+	return (count);
+}
+
+static bool
+cachedb_ispersistent(dns_db_t *db) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	return (dns_db_ispersistent(cachedb->shards[0]));
+}
+
+static void
+cachedb_overmem(dns_db_t *db, bool overmem) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	for (unsigned int i = 0; i < cachedb->nshards; i++) {
+		dns_db_overmem(cachedb->shards[i], overmem);
+	}
+}
+
+static void
+cachedb_setloop(dns_db_t *db, isc_loop_t *loop) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	for (unsigned int i = 0; i < cachedb->nshards; i++) {
+		dns_db_setloop(cachedb->shards[i], loop);
+	}
+}
+
+static isc_result_t
+cachedb_getoriginnode(dns_db_t *db, dns_dbnode_t **nodep) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	return (dns_db_getoriginnode(cachedb->shards[0], nodep));
+}
+
+static bool
+cachedb_isdnssec(dns_db_t *db) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	return (dns_db_isdnssec(cachedb->shards[0]));
+}
+
+static dns_stats_t *
+cachedb_getrrsetstats(dns_db_t *db) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	return (cachedb->rrsetstats);
+}
+
+static isc_result_t
+cachedb_setcachestats(dns_db_t *db, isc_stats_t *stats) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	for (unsigned int i = 0; i < cachedb->nshards; i++) {
+		result = dns_db_setcachestats(cachedb->shards[i], stats);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+
+	return (result);
+}
+
+static size_t
+cachedb_hashsize(dns_db_t *db) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+	size_t size = 0;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	for (unsigned int i = 0; i < cachedb->nshards; i++) {
+		size += dns_db_hashsize(cachedb->shards[i]);
+	}
+
+	return (size);
+}
+
+static isc_result_t
+cachedb_nodefullname(dns_db_t *db, dns_dbnode_t *node, dns_name_t *name) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	return (dns_db_nodefullname(nodeshard(cachedb, node), node, name));
+}
+
+static isc_result_t
+cachedb_setservestalettl(dns_db_t *db, dns_ttl_t ttl) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	for (unsigned int i = 0; i < cachedb->nshards; i++) {
+		result = dns_db_setservestalettl(cachedb->shards[i], ttl);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+
+	return (result);
+}
+
+static isc_result_t
+cachedb_getservestalettl(dns_db_t *db, dns_ttl_t *ttl) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	return (dns_db_getservestalettl(cachedb->shards[0], ttl));
+}
+
+static isc_result_t
+cachedb_setservestalerefresh(dns_db_t *db, uint32_t interval) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	for (unsigned int i = 0; i < cachedb->nshards; i++) {
+		result = dns_db_setservestalerefresh(cachedb->shards[i],
+						     interval);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+
+	return (result);
+}
+
+static isc_result_t
+cachedb_getservestalerefresh(dns_db_t *db, uint32_t *interval) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+
+	REQUIRE(VALID_CACHEDB(cachedb));
+
+	return (dns_db_getservestalerefresh(cachedb->shards[0], interval));
+}
+
+static dns_dbmethods_t cachedb_methods = {
+	cachedb_attach,
+	cachedb_detach,
+	cachedb_beginload,
+	cachedb_endload,
+	cachedb_dump,
+	cachedb_currentversion,
+	cachedb_newversion,
+	cachedb_attachversion,
+	cachedb_closeversion,
+	cachedb_findnode,
+	cachedb_find,
+	cachedb_findzonecut,
+	cachedb_attachnode,
+	cachedb_detachnode,
+	cachedb_expirenode,
+	cachedb_printnode,
+	cachedb_createiterator,
+	cachedb_findrdataset,
+	cachedb_allrdatasets,
+	cachedb_addrdataset,
+	cachedb_subtractrdataset,
+	cachedb_deleterdataset,
+	cachedb_issecure,
+	cachedb_nodecount,
+	cachedb_ispersistent,
+	cachedb_overmem,
+	cachedb_setloop,
+	cachedb_getoriginnode,
+	NULL, /* transfernode */
+	NULL, /* getnsec3parameters */
+	NULL, /* findnsec3node */
+	NULL, /* setsigningtime */
+	NULL, /* getsigningtime */
+	NULL, /* resigned */
+	cachedb_isdnssec,
+	cachedb_getrrsetstats,
+	NULL, /* rpz_attach */
+	NULL, /* rpz_ready */
+	NULL, /* findnodeext */
+	NULL, /* findext */
+	cachedb_setcachestats,
+	cachedb_hashsize,
+	cachedb_nodefullname,
+	NULL, /* getsize */
+	cachedb_setservestalettl,
+	cachedb_getservestalettl,
+	cachedb_setservestalerefresh,
+	cachedb_getservestalerefresh,
+	NULL, /* setgluecachestats */
+};
+
+/*
+ * Iterator over a sharded cache database.
+ */
+
+static int
+iter_compare(cachedb_iter_t *it, unsigned int a, unsigned int b) {
+	int order = dns_name_compare(dns_fixedname_name(&it->pos[a].name),
+				     dns_fixedname_name(&it->pos[b].name));
+
+	if (order == 0) {
+		order = (a < b) ? -1 : (a > b) ? 1 : 0;
+	}
+	return (order);
+}
+
+/*
+ * Record the outcome of moving the iterator over shard 'i', and the
+ * name it has moved to.
+ */
+static void
+iter_load(cachedb_iter_t *it, unsigned int i, isc_result_t result) {
+	cachedb_iterpos_t *pos = &it->pos[i];
+
+	if (result == ISC_R_SUCCESS) {
+		dns_dbnode_t *node = NULL;
+
+		result = dns_dbiterator_current(
+			pos->iter, &node, dns_fixedname_name(&pos->name));
+		if (result == DNS_R_NEWORIGIN) {
+			result = ISC_R_SUCCESS;
+		}
+		if (node != NULL) {
+			dns_db_detachnode(pos->iter->db, &node);
+		}
+	}
+	(void)dns_dbiterator_pause(pos->iter);
+
+	pos->result = result;
+}
+
+/*
+ * Make the nearest node in the direction of iteration current.
+ */
 static isc_result_t
-cache_create_db(dns_cache_t *cache, dns_db_t **db) {
+iter_pick(cachedb_iter_t *it) {
+	int dir = it->forward ? 1 : -1;
+
+	it->result = ISC_R_NOMORE;
+	for (unsigned int i = 0; i < it->npos; i++) {
+		isc_result_t result = it->pos[i].result;
+
+		if (result != ISC_R_SUCCESS && result != ISC_R_NOMORE) {
+			it->result = result;
+			return (result);
+		}
+		if (result == ISC_R_SUCCESS &&
+		    (it->result != ISC_R_SUCCESS ||
+		     dir * iter_compare(it, i, it->current) < 0))
+		{
+			it->result = ISC_R_SUCCESS;
+			it->current = i;
+		}
+	}
+
+	return (it->result);
+}
+
+/*
+ * Move the iterator over shard 'i' to its first node after 'name' in
+ * shard 'shard', or to its last node before it.  These need a search in
+ * the shard, so they are only used when the direction of iteration
+ * changes.
+ */
+static void
+iter_after(cachedb_iter_t *it, unsigned int i, const dns_name_t *name,
+	   unsigned int shard) {
+	dns_dbiterator_t *iter = it->pos[i].iter;
+	isc_result_t result;
+
+	/*
+	 * After a partial match the shard iterator is on the DNSSEC
+	 * predecessor of 'name', so the next node follows it.
+	 */
+	result = dns_dbiterator_seek(iter, name);
+	if (result == DNS_R_PARTIALMATCH ||
+	    (result == ISC_R_SUCCESS && i < shard))
+	{
+		result = dns_dbiterator_next(iter);
+	}
+	iter_load(it, i, result);
+}
+
+static void
+iter_before(cachedb_iter_t *it, unsigned int i, const dns_name_t *name,
+	    unsigned int shard) {
+	dns_dbiterator_t *iter = it->pos[i].iter;
+	isc_result_t result;
+
+	result = dns_dbiterator_seek(iter, name);
+	if (result == ISC_R_SUCCESS && i > shard) {
+		result = dns_dbiterator_prev(iter);
+	} else if (result == DNS_R_PARTIALMATCH) {
+		result = dns_dbiterator_next(iter);
+		if (result == ISC_R_SUCCESS) {
+			result = dns_dbiterator_prev(iter);
+		} else if (result == ISC_R_NOMORE) {
+			result = dns_dbiterator_last(iter);
+		}
+	}
+	iter_load(it, i, result);
+}
+
+static void
+cachedb_iter_destroy(dns_dbiterator_t **iteratorp) {
+	cachedb_iter_t *it = (cachedb_iter_t *)*iteratorp;
+	dns_db_t *db = it->common.db;
+
+	*iteratorp = NULL;
+
+	for (unsigned int i = 0; i < it->npos; i++) {
+		if (it->pos[i].iter != NULL) {
+			dns_dbiterator_destroy(&it->pos[i].iter);
+		}
+	}
+
+	it->common.magic = 0;
+	isc_mem_put(db->mctx, it, sizeof(*it) + it->npos * sizeof(it->pos[0]));
+	dns_db_detach(&db);
+}
+
+static isc_result_t
+cachedb_iter_first(dns_dbiterator_t *iterator) {
+	cachedb_iter_t *it = (cachedb_iter_t *)iterator;
+
+	for (unsigned int i = 0; i < it->npos; i++) {
+		iter_load(it, i, dns_dbiterator_first(it->pos[i].iter));
+	}
+	it->forward = true;
+
+	return (iter_pick(it));
+}
+
+static isc_result_t
+cachedb_iter_last(dns_dbiterator_t *iterator) {
+	cachedb_iter_t *it = (cachedb_iter_t *)iterator;
+
+	for (unsigned int i = 0; i < it->npos; i++) {
+		iter_load(it, i, dns_dbiterator_last(it->pos[i].iter));
+	}
+	it->forward = false;
+
+	return (iter_pick(it));
+}
+
+/*
+ * If no shard has a node for 'name', the iterator is left on the DNSSEC
+ * predecessor of 'name' and DNS_R_PARTIALMATCH is returned, so that the
+ * next node is the first one after 'name'.
+ */
+static isc_result_t
+cachedb_iter_seek(dns_dbiterator_t *iterator, const dns_name_t *name) {
+	cachedb_iter_t *it = (cachedb_iter_t *)iterator;
+	unsigned int found = it->npos;
+	isc_result_t result;
+
+	for (unsigned int i = 0; i < it->npos; i++) {
+		result = dns_dbiterator_seek(it->pos[i].iter, name);
+		(void)dns_dbiterator_pause(it->pos[i].iter);
+		if (result == ISC_R_SUCCESS) {
+			found = i;
+			break;
+		} else if (result != DNS_R_PARTIALMATCH) {
+			it->result = result;
+			return (result);
+		}
+	}
+
+	if (found < it->npos) {
+		for (unsigned int i = 0; i < it->npos; i++) {
+			if (i == found) {
+				iter_load(it, i, ISC_R_SUCCESS);
+			} else {
+				iter_after(it, i, name, found);
+			}
+		}
+		it->forward = true;
+		return (iter_pick(it));
+	}
+
+	for (unsigned int i = 0; i < it->npos; i++) {
+		iter_before(it, i, name, it->npos);
+	}
+	it->forward = false;
+	result = iter_pick(it);
+
+	return ((result == ISC_R_SUCCESS) ? DNS_R_PARTIALMATCH : result);
+}
+
+static isc_result_t
+cachedb_iter_prev(dns_dbiterator_t *iterator) {
+	cachedb_iter_t *it = (cachedb_iter_t *)iterator;
+	unsigned int current = it->current;
+
+	if (it->result != ISC_R_SUCCESS) {
+		return (it->result);
+	}
+
+	if (it->forward) {
+		const dns_name_t *name =
+			dns_fixedname_name(&it->pos[current].name);
+
+		for (unsigned int i = 0; i < it->npos; i++) {
+			if (i != current) {
+				iter_before(it, i, name, current);
+			}
+		}
+		it->forward = false;
+	}
+
+	iter_load(it, current, dns_dbiterator_prev(it->pos[current].iter));
+
+	return (iter_pick(it));
+}
+
+static isc_result_t
+cachedb_iter_next(dns_dbiterator_t *iterator) {
+	cachedb_iter_t *it = (cachedb_iter_t *)iterator;
+	unsigned int current = it->current;
+
+	if (it->result != ISC_R_SUCCESS) {
+		return (it->result);
+	}
+
+	if (!it->forward) {
+		const dns_name_t *name =
+			dns_fixedname_name(&it->pos[current].name);
+
+		for (unsigned int i = 0; i < it->npos; i++) {
+			if (i != current) {
+				iter_after(it, i, name, current);
+			}
+		}
+		it->forward = true;
+	}
+
+	iter_load(it, current, dns_dbiterator_next(it->pos[current].iter));
+
+	return (iter_pick(it));
+}
+
+static isc_result_t
+cachedb_iter_current(dns_dbiterator_t *iterator, dns_dbnode_t **nodep,
+		     dns_name_t *name) {
+	cachedb_iter_t *it = (cachedb_iter_t *)iterator;
+	dns_dbiterator_t *iter = NULL;
+	isc_result_t result;
+
+	REQUIRE(it->result == ISC_R_SUCCESS);
+
+	iter = it->pos[it->current].iter;
+	result = dns_dbiterator_current(iter, nodep, name);
+	(void)dns_dbiterator_pause(iter);
+
+	return ((result == DNS_R_NEWORIGIN) ? ISC_R_SUCCESS : result);
+}
+
+static isc_result_t
+cachedb_iter_pause(dns_dbiterator_t *iterator) {
+	UNUSED(iterator);
+
+	/* The shard iterators are always paused */
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+cachedb_iter_origin(dns_dbiterator_t *iterator, dns_name_t *name) {
+	UNUSED(iterator);
+
+	dns_name_copy(dns_rootname, name);
+	return (ISC_R_SUCCESS);
+}
+
+static dns_dbiteratormethods_t cachedb_itermethods = {
+	cachedb_iter_destroy, cachedb_iter_first, cachedb_iter_last,
+	cachedb_iter_seek,    cachedb_iter_prev,  cachedb_iter_next,
+	cachedb_iter_current, cachedb_iter_pause, cachedb_iter_origin
+};
+
+static isc_result_t
+cache_create_rbtdb(dns_cache_t *cache, dns_db_t **db) {
 	isc_result_t result;
 	char *argv[1] = { 0 };
 
@@ -107,15 +1022,88 @@ cache_create_db(dns_cache_t *cache, dns_db_t **db) {
 	return (result);
 }
 
+static isc_result_t
+cachedb_create(dns_cache_t *cache, dns_db_t **dbp) {
+	cachedb_t *cachedb = NULL;
+	isc_result_t result;
+
+	cachedb = isc_mem_get(cache->mctx, sizeof(*cachedb));
+	*cachedb = (cachedb_t){
+		.common.methods = &cachedb_methods,
+		.common.attributes = DNS_DBATTR_CACHE,
+		.common.rdclass = cache->rdclass,
+		.common.magic = DNS_DB_MAGIC,
+		.common.impmagic = CACHEDB_MAGIC,
+		.nshards = cache->nshards,
+	};
+	dns_name_init(&cachedb->common.origin, NULL);
+	dns_name_clone(dns_rootname, &cachedb->common.origin);
+	ISC_LIST_INIT(cachedb->common.update_listeners);
+	isc_mem_attach(cache->mctx, &cachedb->common.mctx);
+	isc_refcount_init(&cachedb->references, 1);
+
+	cachedb->shards = isc_mem_getx(cache->mctx,
+				       cachedb->nshards *
+					       sizeof(cachedb->shards[0]),
+				       ISC_MEM_ZERO);
+	cachedb->roots = isc_mem_getx(cache->mctx,
+				      cachedb->nshards *
+					      sizeof(cachedb->roots[0]),
+				      ISC_MEM_ZERO);
+
+	result = dns_rdatasetstats_create(cache->mctx, &cachedb->rrsetstats);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	for (unsigned int i = 0; i < cachedb->nshards; i++) {
+		result = cache_create_rbtdb(cache, &cachedb->shards[i]);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+		dns__rbtdb_setshard(cachedb->shards[i], i, cachedb->rrsetstats);
+
+		/*
+		 * Keep a node for the root name in every shard, so that
+		 * seeking an iterator over any shard always finds at
+		 * least an ancestor of the name.
+		 */
+		result = dns_db_findnode(cachedb->shards[i], dns_rootname,
+					 true, &cachedb->roots[i]);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+	}
+
+	*dbp = &cachedb->common;
+	return (ISC_R_SUCCESS);
+
+cleanup:
+	isc_refcount_decrementz(&cachedb->references);
+	isc_refcount_destroy(&cachedb->references);
+	cachedb_free(cachedb);
+	return (result);
+}
+
+static isc_result_t
+cache_create_db(dns_cache_t *cache, dns_db_t **db) {
+	if (cache->nshards > 1) {
+		return (cachedb_create(cache, db));
+	}
+	return (cache_create_rbtdb(cache, db));
+}
+
 isc_result_t
 dns_cache_create(isc_loopmgr_t *loopmgr, dns_rdataclass_t rdclass,
-		 const char *cachename, dns_cache_t **cachep) {
+		 const char *cachename, unsigned int nshards,
+		 dns_cache_t **cachep) {
 	isc_result_t result;
 	dns_cache_t *cache = NULL;
 	isc_mem_t *mctx = NULL, *hmctx = NULL;
 
 	REQUIRE(loopmgr != NULL);
 	REQUIRE(cachename != NULL);
+	REQUIRE(nshards <= DNS_CACHE_MAXSHARDS);
 	REQUIRE(cachep != NULL && *cachep == NULL);
 
 	/*
@@ -126,7 +1114,7 @@ dns_cache_create(isc_loopmgr_t *loopmgr, dns_rdataclass_t rdclass,
 	isc_mem_setname(mctx, "cache");
 
 	/*
-	 * This will be passed to RBTDB to use for heaps. This is separate
+	 * This will be passed to RBTDB to use for TTL wheels. This is separate
 	 * from the main cache memory because it can grow quite large under
 	 * heavy load and could otherwise cause the cache to be cleaned too
 	 * aggressively.
@@ -139,6 +1127,7 @@ dns_cache_create(isc_loopmgr_t *loopmgr, dns_rdataclass_t rdclass,
 		.mctx = mctx,
 		.hmctx = hmctx,
 		.rdclass = rdclass,
+		.nshards = nshards,
 		.name = isc_mem_strdup(mctx, cachename),
 	};
 
@@ -247,6 +1236,13 @@ dns_cache_getname(dns_cache_t *cache) {
 	return (cache->name);
 }
 
+unsigned int
+dns_cache_getshards(dns_cache_t *cache) {
+	REQUIRE(VALID_CACHE(cache));
+
+	return (ISC_MAX(cache->nshards, 1));
+}
+
 static void
 water(void *arg, int mark) {
 	dns_cache_t *cache = arg;
@@ -496,6 +1492,34 @@ cleanup:
 	return (answer);
 }
 
+static isc_result_t
+flushtree(dns_db_t *db, const dns_name_t *name) {
+	cachedb_t *cachedb = (cachedb_t *)db;
+	isc_result_t result, answer = ISC_R_SUCCESS;
+
+	if (db->methods != &cachedb_methods) {
+		return (cleartree(db, name));
+	}
+
+	/*
+	 * The names below a second-level name are all in its shard; the
+	 * names below the root or a top-level name may be in any of them.
+	 */
+	if (dns_name_countlabels(name) >= CACHEDB_KEYLABELS) {
+		return (cleartree(cachedb->shards[nameshard(cachedb, name)],
+				  name));
+	}
+
+	for (unsigned int i = 0; i < cachedb->nshards; i++) {
+		result = cleartree(cachedb->shards[i], name);
+		if (result != ISC_R_SUCCESS && answer == ISC_R_SUCCESS) {
+			answer = result;
+		}
+	}
+
+	return (answer);
+}
+
 isc_result_t
 dns_cache_flushname(dns_cache_t *cache, const dns_name_t *name) {
 	return (dns_cache_flushnode(cache, name, false));
@@ -521,7 +1545,7 @@ dns_cache_flushnode(dns_cache_t *cache, const dns_name_t *name, bool tree) {
 	}
 
 	if (tree) {
-		result = cleartree(cache->db, name);
+		result = flushtree(cache->db, name);
 	} else {
 		result = dns_db_findnode(cache->db, name, false, &node);
 		if (result == ISC_R_NOTFOUND) {
@@ -540,6 +1564,112 @@ cleanup_db:
 	return (result);
 }
 
+isc_result_t
+dns_cache_savesnapshot(dns_cache_t *cache, const char *filename) {
+	isc_result_t result;
+	dns_masterrawheader_t header;
+	dns_db_t *db = NULL;
+
+	REQUIRE(VALID_CACHE(cache));
+	REQUIRE(filename != NULL);
+
+	dns_cache_attachdb(cache, &db);
+
+	dns_master_initrawheader(&header);
+	header.flags = DNS_MASTERRAW_CACHE;
+	result = dns_master_dump(cache->mctx, db, NULL,
+				 &dns_master_style_default, filename,
+				 dns_masterformat_raw, &header);
+
+	dns_db_detach(&db);
+	return (result);
+}
+
+isc_result_t
+dns_cache_savesnapshotasync(dns_cache_t *cache, const char *filename,
+			    isc_loop_t *loop, dns_dumpdonefunc_t done,
+			    void *done_arg, dns_dumpctx_t **dctxp) {
+	isc_result_t result;
+	dns_masterrawheader_t header;
+	dns_db_t *db = NULL;
+
+	REQUIRE(VALID_CACHE(cache));
+	REQUIRE(filename != NULL);
+
+	dns_cache_attachdb(cache, &db);
+
+	dns_master_initrawheader(&header);
+	header.flags = DNS_MASTERRAW_CACHE;
+	result = dns_master_dumpasync(cache->mctx, db, NULL,
+				      &dns_master_style_default, filename,
+				      loop, done, done_arg, dctxp,
+				      dns_masterformat_raw, &header);
+
+	dns_db_detach(&db);
+	return (result);
+}
+
+typedef struct {
+	dns_db_t *db;
+	unsigned int count;
+} snapshot_t;
+
+static isc_result_t
+snapshot_add(void *arg, const dns_name_t *name, dns_rdataset_t *rdataset) {
+	snapshot_t *snapshot = arg;
+	isc_result_t result;
+	dns_dbnode_t *node = NULL;
+
+	result = dns_db_findnode(snapshot->db, name, true, &node);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	result = dns_db_addrdataset(snapshot->db, node, NULL, 0, rdataset, 0,
+				    NULL);
+	dns_db_detachnode(snapshot->db, &node);
+
+	switch (result) {
+	case ISC_R_SUCCESS:
+		snapshot->count++;
+		break;
+	case DNS_R_UNCHANGED:
+		/* There is something better in the cache already */
+		result = ISC_R_SUCCESS;
+		break;
+	default:
+		break;
+	}
+	return (result);
+}
+
+isc_result_t
+dns_cache_loadsnapshot(dns_cache_t *cache, const char *filename,
+		       dns_ttl_t maxttl, unsigned int *countp) {
+	isc_result_t result;
+	dns_rdatacallbacks_t callbacks;
+	snapshot_t snapshot = { 0 };
+	isc_stdtime_t now;
+
+	REQUIRE(VALID_CACHE(cache));
+	REQUIRE(filename != NULL);
+
+	dns_cache_attachdb(cache, &snapshot.db);
+
+	dns_rdatacallbacks_init(&callbacks);
+	callbacks.add = snapshot_add;
+	callbacks.add_private = &snapshot;
+
+	isc_stdtime_get(&now);
+	result = dns_master_loadcache(filename, cache->rdclass, now, maxttl,
+				      &callbacks, cache->mctx);
+
+	dns_db_detach(&snapshot.db);
+	if (countp != NULL) {
+		*countp = snapshot.count;
+	}
+	return (result);
+}
+
 isc_stats_t *
 dns_cache_getstats(dns_cache_t *cache) {
 	REQUIRE(VALID_CACHE(cache));
@@ -637,6 +1767,15 @@ dns_cache_dumpstats(dns_cache_t *cache, FILE *fp) {
 	fprintf(fp, "%20" PRIu64 " %s\n",
 		values[dns_cachestatscounter_coveringnsec],
 		"covering nsec returned");
+	fprintf(fp, "%20" PRIu64 " %s\n",
+		values[dns_cachestatscounter_cleanersweeps],
+		"cache cleaner sweeps");
+	fprintf(fp, "%20" PRIu64 " %s\n",
+		values[dns_cachestatscounter_cleaneryields],
+		"cache cleaner sweeps cut short by the time budget");
+	fprintf(fp, "%20" PRIu64 " %s\n",
+		values[dns_cachestatscounter_cleanermaxtime],
+		"cache cleaner longest sweep (microseconds)");
 	fprintf(fp, "%20u %s\n", dns_db_nodecount(cache->db, dns_dbtree_main),
 		"cache database nodes");
 	fprintf(fp, "%20u %s\n", dns_db_nodecount(cache->db, dns_dbtree_nsec),
@@ -707,6 +1846,12 @@ dns_cache_renderxml(dns_cache_t *cache, void *writer0) {
 			writer));
 	TRY0(renderstat("CoveringNSEC",
 			values[dns_cachestatscounter_coveringnsec], writer));
+	TRY0(renderstat("CleanerSweeps",
+			values[dns_cachestatscounter_cleanersweeps], writer));
+	TRY0(renderstat("CleanerYields",
+			values[dns_cachestatscounter_cleaneryields], writer));
+	TRY0(renderstat("CleanerMaxTime",
+			values[dns_cachestatscounter_cleanermaxtime], writer));
 
 	TRY0(renderstat("CacheNodes",
 			dns_db_nodecount(cache->db, dns_dbtree_main), writer));
@@ -776,6 +1921,19 @@ dns_cache_renderjson(dns_cache_t *cache, void *cstats0) {
 	CHECKMEM(obj);
 	json_object_object_add(cstats, "CoveringNSEC", obj);
 
+	obj = json_object_new_int64(values[dns_cachestatscounter_cleanersweeps]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "CleanerSweeps", obj);
+
+	obj = json_object_new_int64(values[dns_cachestatscounter_cleaneryields]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "CleanerYields", obj);
+
+	obj = json_object_new_int64(
+		values[dns_cachestatscounter_cleanermaxtime]);
+	CHECKMEM(obj);
+	json_object_object_add(cstats, "CleanerMaxTime", obj);
+
 	obj = json_object_new_int64(
 		dns_db_nodecount(cache->db, dns_dbtree_main));
 	CHECKMEM(obj);
@@ -83,6 +83,8 @@ dns_rdatacallbacks_initcommon(dns_rdatacallbacks_t *callbacks) {
 	callbacks->add = NULL;
 	callbacks->rawdata = NULL;
 	callbacks->zone = NULL;
+	callbacks->deserialize = NULL;
+	callbacks->deserialize_private = NULL;
 	callbacks->add_private = NULL;
 	callbacks->error_private = NULL;
 	callbacks->warn_private = NULL;
@@ -20,6 +20,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/atomic.h>
 #include <isc/buffer.h>
 #include <isc/mem.h>
 #include <isc/once.h>
@@ -58,6 +59,7 @@ struct dns_dbimplementation {
  * Built in database implementations are registered here.
  */
 
+#include "qpdb.h"
 #include "rbtdb.h"
 
 unsigned int dns_pps = 0U;
@@ -66,7 +68,13 @@ static ISC_LIST(dns_dbimplementation_t) implementations;
 static isc_rwlock_t implock;
 static isc_once_t once = ISC_ONCE_INIT;
 
+/*
+ * Source of dns_db_generation() values; 0 is never handed out.
+ */
+static atomic_uint_fast64_t dbgen = 1;
+
 static dns_dbimplementation_t rbtimp;
+static dns_dbimplementation_t qpimp;
 
 static void
 initialize(void) {
@@ -78,8 +86,15 @@ initialize(void) {
 	rbtimp.driverarg = NULL;
 	ISC_LINK_INIT(&rbtimp, link);
 
+	qpimp.name = "qp";
+	qpimp.create = dns_qpdb_create;
+	qpimp.mctx = NULL;
+	qpimp.driverarg = NULL;
+	ISC_LINK_INIT(&qpimp, link);
+
 	ISC_LIST_INIT(implementations);
 	ISC_LIST_APPEND(implementations, &rbtimp, link);
+	ISC_LIST_APPEND(implementations, &qpimp, link);
 }
 
 static dns_dbimplementation_t *
@@ -122,6 +137,9 @@ dns_db_create(isc_mem_t *mctx, const char *db_type, const dns_name_t *origin,
 		result = ((impinfo->create)(mctx, origin, type, rdclass, argc,
 					    argv, impinfo->driverarg, dbp));
 		RWUNLOCK(&implock, isc_rwlocktype_read);
+		if (result == ISC_R_SUCCESS) {
+			(*dbp)->generation = atomic_fetch_add(&dbgen, 1);
+		}
 		return (result);
 	}
 
@@ -266,6 +284,13 @@ dns_db_class(dns_db_t *db) {
 	return (db->rdclass);
 }
 
+uint64_t
+dns_db_generation(dns_db_t *db) {
+	REQUIRE(DNS_DB_VALID(db));
+
+	return (db->generation);
+}
+
 isc_result_t
 dns_db_beginload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 	/*
@@ -344,6 +369,19 @@ dns_db_dump(dns_db_t *db, dns_dbversion_t *version, const char *filename) {
 				    dns_masterformat_text));
 }
 
+isc_result_t
+dns_db_serialize(dns_db_t *db, dns_dbversion_t *version, FILE *file) {
+	REQUIRE(!dns_db_iscache(db));
+	REQUIRE(version != NULL);
+	REQUIRE(file != NULL);
+
+	if (db->methods->serialize != NULL) {
+		return ((db->methods->serialize)(db, version, file));
+	}
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
 /***
  *** Version Methods
  ***/
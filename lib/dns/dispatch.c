@@ -43,12 +43,32 @@
 
 typedef ISC_LIST(dns_dispentry_t) dns_displist_t;
 
+/*%
+ * Number of mutexes guarding the QID hash table.  Each bucket is
+ * protected by the lock at (bucket % DNS_QID_LOCKS), so queries to
+ * different servers or with different IDs rarely serialize on the
+ * same lock.
+ */
+#ifndef DNS_QID_LOCKS
+#define DNS_QID_LOCKS 64
+#endif /* ifndef DNS_QID_LOCKS */
+
+/*%
+ * Number of UDP sockets each loop keeps bound to random ports from the
+ * portset for a dispatch's local address, so that setup_socket() does
+ * not have to wait for a socket to be opened and bound; the pool is
+ * refilled once it falls to half of that.
+ */
+#ifndef DNS_DISPATCH_UDPPOOL
+#define DNS_DISPATCH_UDPPOOL 16
+#endif /* ifndef DNS_DISPATCH_UDPPOOL */
+
 typedef struct dns_qid {
 	unsigned int magic;
-	isc_mutex_t lock;
-	unsigned int qid_nbuckets;  /*%< hash table size */
-	unsigned int qid_increment; /*%< id increment on collision */
-	dns_displist_t *qid_table;  /*%< the table itself */
+	isc_mutex_t locks[DNS_QID_LOCKS]; /*%< striped bucket locks */
+	unsigned int qid_nbuckets;	  /*%< hash table size */
+	unsigned int qid_increment;	  /*%< id increment on collision */
+	dns_displist_t *qid_table;	  /*%< the table itself */
 } dns_qid_t;
 
 struct dns_dispatchmgr {
@@ -202,6 +222,8 @@ dispentry_cancel(dns_dispentry_t *resp, isc_result_t result);
 static isc_result_t
 dispatch_createudp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *localaddr,
 		   dns_dispatch_t **dispp);
+static isc_mutex_t *
+qid_lock(dns_qid_t *qid, unsigned int bucket);
 static void
 qid_allocate(dns_dispatchmgr_t *mgr, dns_qid_t **qidp);
 static void
@@ -373,8 +395,39 @@ dns_hash(dns_qid_t *qid, const isc_sockaddr_t *dest, dns_messageid_t id,
 	return (ret);
 }
 
+static int
+port_cmp(const void *a, const void *b) {
+	in_port_t pa = *(const in_port_t *)a;
+	in_port_t pb = *(const in_port_t *)b;
+
+	return ((pa > pb) - (pa < pb));
+}
+
 /*%
- * Choose a random port number for a dispatch entry.
+ * Top up the current loop's pool of sockets pre-bound to 'local' with
+ * random ports from 'ports'.  The netmgr opens them in the next loop
+ * iteration, off the path of the queries being sent in this one.
+ */
+static void
+udppool_refill(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *local,
+	       const in_port_t *ports, unsigned int nports) {
+	unsigned int count = isc_nm_udpprebound(mgr->nm, local);
+
+	if (count > DNS_DISPATCH_UDPPOOL / 2) {
+		return;
+	}
+
+	for (; count < DNS_DISPATCH_UDPPOOL; count++) {
+		isc_sockaddr_t sa = *local;
+
+		isc_sockaddr_setport(&sa, ports[isc_random_uniform(nports)]);
+		isc_nm_udpprebind(mgr->nm, &sa);
+	}
+}
+
+/*%
+ * Choose a random port number for a dispatch entry, taking a socket
+ * already bound to one from the current loop's pool if there is one.
  * The caller must hold the disp->lock
  */
 static isc_result_t
@@ -384,6 +437,7 @@ setup_socket(dns_dispatch_t *disp, dns_dispentry_t *resp,
 	unsigned int nports;
 	in_port_t *ports = NULL;
 	in_port_t port;
+	bool pooled = false;
 
 	if (resp->retries++ > 5) {
 		return (ISC_R_FAILURE);
@@ -403,10 +457,24 @@ setup_socket(dns_dispatch_t *disp, dns_dispentry_t *resp,
 	resp->local = disp->local;
 	resp->peer = *dest;
 
-	port = ports[isc_random_uniform(nports)];
-	isc_sockaddr_setport(&resp->local, port);
+	/*
+	 * The ports array is sorted; a pooled socket whose port has been
+	 * removed from the portset since it was bound is not used, and
+	 * the netmgr closes it.
+	 */
+	if (isc_nm_udptakeprebound(mgr->nm, &resp->local) == ISC_R_SUCCESS) {
+		port = isc_sockaddr_getport(&resp->local);
+		pooled = (bsearch(&port, ports, nports, sizeof(ports[0]),
+				  port_cmp) != NULL);
+	}
+	if (!pooled) {
+		port = ports[isc_random_uniform(nports)];
+		isc_sockaddr_setport(&resp->local, port);
+	}
 	resp->port = port;
 
+	udppool_refill(mgr, &disp->local, ports, nports);
+
 	*portp = port;
 
 	return (ISC_R_SUCCESS);
@@ -721,7 +789,7 @@ tcp_recv_success(dns_dispatch_t *disp, isc_region_t *region, dns_qid_t *qid,
 	 * and call the caller back.
 	 */
 	bucket = dns_hash(qid, peer, id, disp->localport);
-	LOCK(&qid->lock);
+	LOCK(qid_lock(qid, bucket));
 	resp = entry_search(qid, peer, id, disp->localport, bucket);
 	if (resp != NULL) {
 		if (resp->reading) {
@@ -736,7 +804,7 @@ tcp_recv_success(dns_dispatch_t *disp, isc_region_t *region, dns_qid_t *qid,
 	}
 	dispatch_log(disp, LVL(90), "search for response in bucket %d: %s",
 		     bucket, isc_result_totext(result));
-	UNLOCK(&qid->lock);
+	UNLOCK(qid_lock(qid, bucket));
 
 	return (result);
 }
@@ -1099,6 +1167,13 @@ dns_dispatchmgr_setstats(dns_dispatchmgr_t *mgr, isc_stats_t *stats) {
 	isc_stats_attach(stats, &mgr->stats);
 }
 
+static isc_mutex_t *
+qid_lock(dns_qid_t *qid, unsigned int bucket) {
+	REQUIRE(bucket < qid->qid_nbuckets);
+
+	return (&qid->locks[bucket % DNS_QID_LOCKS]);
+}
+
 static void
 qid_allocate(dns_dispatchmgr_t *mgr, dns_qid_t **qidp) {
 	dns_qid_t *qid = NULL;
@@ -1116,7 +1191,9 @@ qid_allocate(dns_dispatchmgr_t *mgr, dns_qid_t **qidp) {
 		ISC_LIST_INIT(qid->qid_table[i]);
 	}
 
-	isc_mutex_init(&qid->lock);
+	for (i = 0; i < DNS_QID_LOCKS; i++) {
+		isc_mutex_init(&qid->locks[i]);
+	}
 	qid->magic = QID_MAGIC;
 	*qidp = qid;
 }
@@ -1134,7 +1211,9 @@ qid_destroy(isc_mem_t *mctx, dns_qid_t **qidp) {
 	qid->magic = 0;
 	isc_mem_put(mctx, qid->qid_table,
 		    qid->qid_nbuckets * sizeof(dns_displist_t));
-	isc_mutex_destroy(&qid->lock);
+	for (size_t i = 0; i < DNS_QID_LOCKS; i++) {
+		isc_mutex_destroy(&qid->locks[i]);
+	}
 	isc_mem_put(mctx, qid, sizeof(*qid));
 }
 
@@ -1514,13 +1593,24 @@ dns_dispatch_add(dns_dispatch_t *disp, unsigned int options,
 		id = (dns_messageid_t)isc_random16();
 	}
 
-	LOCK(&qid->lock);
+	/*
+	 * Each candidate ID hashes to its own bucket, so only the lock
+	 * covering that bucket is held while checking for a collision
+	 * and, if there is none, linking the new entry in.
+	 */
 	do {
 		dns_dispentry_t *entry = NULL;
 		bucket = dns_hash(qid, dest, id, localport);
+		LOCK(qid_lock(qid, bucket));
 		entry = entry_search(qid, dest, id, localport, bucket);
 		if (entry == NULL) {
+			resp->id = id;
+			resp->bucket = bucket;
+			ISC_LIST_APPEND(qid->qid_table[bucket], resp, link);
 			ok = true;
+		}
+		UNLOCK(qid_lock(qid, bucket));
+		if (ok) {
 			break;
 		}
 		if ((options & DNS_DISPATCHOPT_FIXEDID) != 0) {
@@ -1531,13 +1621,6 @@ dns_dispatch_add(dns_dispatch_t *disp, unsigned int options,
 		id &= 0x0000ffff;
 	} while (i++ < 64);
 
-	if (ok) {
-		resp->id = id;
-		resp->bucket = bucket;
-		ISC_LIST_APPEND(qid->qid_table[bucket], resp, link);
-	}
-	UNLOCK(&qid->lock);
-
 	if (!ok) {
 		isc_mem_put(disp->mgr->mctx, resp, sizeof(*resp));
 		UNLOCK(&disp->lock);
@@ -1652,9 +1735,9 @@ udp_dispentry_cancel(dns_dispentry_t *resp, isc_result_t result) {
 
 	dec_stats(disp->mgr, dns_resstatscounter_disprequdp);
 
-	LOCK(&qid->lock);
+	LOCK(qid_lock(qid, resp->bucket));
 	ISC_LIST_UNLINK(qid->qid_table[resp->bucket], resp, link);
-	UNLOCK(&qid->lock);
+	UNLOCK(qid_lock(qid, resp->bucket));
 	resp->state = DNS_DISPATCHSTATE_CANCELED;
 
 unlock:
@@ -1752,9 +1835,9 @@ tcp_dispentry_cancel(dns_dispentry_t *resp, isc_result_t result) {
 
 	dec_stats(disp->mgr, dns_resstatscounter_dispreqtcp);
 
-	LOCK(&qid->lock);
+	LOCK(qid_lock(qid, resp->bucket));
 	ISC_LIST_UNLINK(qid->qid_table[resp->bucket], resp, link);
-	UNLOCK(&qid->lock);
+	UNLOCK(qid_lock(qid, resp->bucket));
 	resp->state = DNS_DISPATCHSTATE_CANCELED;
 
 unlock:
@@ -2216,6 +2299,10 @@ dns_dispatch_send(dns_dispentry_t *resp, isc_region_t *r, isc_dscp_t dscp) {
 	dispentry_log(resp, LVL(90), "sending");
 	switch (disp->socktype) {
 	case isc_socktype_udp:
+		/*
+		 * With the io_uring backend, the netmgr submits the UDP
+		 * queries sent during one loop iteration together.
+		 */
 		isc_nmhandle_attach(resp->handle, &sendhandle);
 		break;
 	case isc_socktype_tcp:
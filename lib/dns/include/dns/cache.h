@@ -52,23 +52,37 @@
 
 ISC_LANG_BEGINDECLS
 
+/*%
+ * The largest number of shards a cache database can be split into.
+ */
+#define DNS_CACHE_MAXSHARDS 64
+
 /***
  ***	Functions
  ***/
 isc_result_t
 dns_cache_create(isc_loopmgr_t *loopmgr, dns_rdataclass_t rdclass,
-		 const char *cachename, dns_cache_t **cachep);
+		 const char *cachename, unsigned int nshards,
+		 dns_cache_t **cachep);
 /*%<
  * Create a new DNS cache.
  *
  * dns_cache_create() will create a named cache (based on dns_rbtdb).
  *
+ * If 'nshards' is greater than 1, the cache database is split into that
+ * many "rbt" databases, each holding the names whose last two labels
+ * hash to it, so that threads adding or looking up unrelated names
+ * rarely contend on the same locks.  The database is still accessed
+ * with the dns_db API as a single database.
+ *
  * Requires:
  *
  *\li	'loopmgr' is a valid loop manager.
  *
  *\li	'cachename' is a valid string.  This must not be NULL.
  *
+ *\li	'nshards' <= #DNS_CACHE_MAXSHARDS.
+ *
  *\li	'cachep' is a valid pointer, and *cachep == NULL
  *
  * Ensures:
@@ -146,6 +160,13 @@ dns_cache_getname(dns_cache_t *cache);
  * Get the cache name.
  */
 
+unsigned int
+dns_cache_getshards(dns_cache_t *cache);
+/*%<
+ * Get the number of shards the cache database is split into (1 if it
+ * isn't sharded).
+ */
+
 void
 dns_cache_setcachesize(dns_cache_t *cache, size_t size);
 /*%<
@@ -243,6 +264,62 @@ dns_cache_flushname(dns_cache_t *cache, const dns_name_t *name);
  *\li	other error returns.
  */
 
+isc_result_t
+dns_cache_savesnapshot(dns_cache_t *cache, const char *filename);
+/*%<
+ * Write a snapshot of the cache to 'filename', in the raw master file
+ * format with the DNS_MASTERRAW_CACHE flag set.  Each active RRset is
+ * written with its absolute expiry time, trust level and attributes, so
+ * that it can be reloaded as it was by dns_cache_loadsnapshot().
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ *\li	'filename' to be valid.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	any dns_master_dump() error code.
+ */
+
+isc_result_t
+dns_cache_savesnapshotasync(dns_cache_t *cache, const char *filename,
+			    isc_loop_t *loop, dns_dumpdonefunc_t done,
+			    void *done_arg, dns_dumpctx_t **dctxp);
+/*%<
+ * Like dns_cache_savesnapshot(), but write the snapshot on a worker
+ * thread with dns_master_dumpasync(), and call 'done' with 'done_arg'
+ * on 'loop' when it has been written.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ *\li	'filename' to be valid.
+ *\li	'dctxp' != NULL && *dctxp == NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	any dns_master_dumpasync() error code.
+ */
+
+isc_result_t
+dns_cache_loadsnapshot(dns_cache_t *cache, const char *filename,
+		       dns_ttl_t maxttl, unsigned int *countp);
+/*%<
+ * Load a snapshot written by dns_cache_savesnapshot() into the cache.
+ * RRsets that have expired since the snapshot was written are dropped,
+ * and the others keep the time they had left, but no more than 'maxttl'
+ * unless that is zero.  If 'countp' is not NULL, the number of RRsets
+ * added to the cache is stored there.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ *\li	'filename' to be valid.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_FILENOTFOUND if there is no snapshot.
+ *\li	any dns_master_loadcache() error code.
+ */
+
 isc_stats_t *
 dns_cache_getstats(dns_cache_t *cache);
 /*
@@ -48,6 +48,14 @@ struct dns_rdatacallbacks {
 	dns_rawdatafunc_t rawdata;
 	dns_zone_t	 *zone;
 
+	/*%
+	 * dns_master_load*() call this when loading a map zonefile, to
+	 * hand the open file to the database, which maps it into memory
+	 * instead of adding rdatasets one by one.
+	 */
+	dns_deserializefunc_t deserialize;
+	void		     *deserialize_private;
+
 	/*%
 	 * dns_load_master / dns_rdata_fromtext call this to issue a error.
 	 */
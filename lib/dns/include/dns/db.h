@@ -185,6 +185,8 @@ typedef struct dns_dbmethods {
 	isc_result_t (*setservestalerefresh)(dns_db_t *db, uint32_t interval);
 	isc_result_t (*getservestalerefresh)(dns_db_t *db, uint32_t *interval);
 	isc_result_t (*setgluecachestats)(dns_db_t *db, isc_stats_t *stats);
+	isc_result_t (*serialize)(dns_db_t *db, dns_dbversion_t *version,
+				  FILE *file);
 } dns_dbmethods_t;
 
 typedef isc_result_t (*dns_dbcreatefunc_t)(isc_mem_t	    *mctx,
@@ -216,6 +218,7 @@ struct dns_db {
 	dns_rdataclass_t rdclass;
 	dns_name_t	 origin;
 	isc_mem_t	*mctx;
+	uint64_t	 generation;
 	ISC_LIST(dns_dbonupdatelistener_t) update_listeners;
 };
 
@@ -485,6 +488,25 @@ dns_db_class(dns_db_t *db);
  * \li	The class of the database.
  */
 
+uint64_t
+dns_db_generation(dns_db_t *db);
+/*%<
+ * Return a number identifying 'db' among all the databases created by
+ * dns_db_create() during the lifetime of the process.  Unlike the
+ * address of the database, the number is never reused, so it can be
+ * used to tag data derived from the database without holding a
+ * reference to it.
+ *
+ * Requires:
+ *
+ * \li	'db' is a valid database.
+ *
+ * Returns:
+ *
+ * \li	The generation of the database, or 0 if the database wasn't
+ *	created by dns_db_create().
+ */
+
 isc_result_t
 dns_db_beginload(dns_db_t *db, dns_rdatacallbacks_t *callbacks);
 /*%<
@@ -591,6 +613,30 @@ dns_db_dump(dns_db_t *db, dns_dbversion_t *version, const char *filename);
  *	implementation used, OS file errors, etc.
  */
 
+isc_result_t
+dns_db_serialize(dns_db_t *db, dns_dbversion_t *version, FILE *file);
+/*%<
+ * Write version 'version' of 'db' to 'file', at the current position, as
+ * an image that the database can map back into memory and use in place
+ * (the body of a file in the "map" master file format).
+ *
+ * Requires:
+ *
+ * \li	'db' is a valid database, which is not a cache.
+ *
+ * \li	'version' is a valid version.
+ *
+ * \li	'file' is open for writing, and seekable.
+ *
+ * Returns:
+ *
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTIMPLEMENTED if the database implementation cannot be
+ *	serialized.
+ *
+ * \li	Other results are possible, depending upon OS file errors.
+ */
+
 /***
  *** Version Methods
  ***/
@@ -23,6 +23,7 @@
 #include <stdio.h>
 
 #include <isc/lang.h>
+#include <isc/stdtime.h>
 
 #include <dns/types.h>
 
@@ -71,17 +72,41 @@ ISC_LANG_BEGINDECLS
  */
 #define DNS_RAWFORMAT_VERSION 1
 
+/*
+ * Version of the raw format used for cache snapshots, which extends each
+ * RRset with its trust level and cache attributes and stores its absolute
+ * expiry time in place of the TTL.
+ */
+#define DNS_RAWFORMAT_CACHEVERSION 2
+
 /*
  * Flags to indicate the status of the data in the raw file header
  */
 #define DNS_MASTERRAW_COMPAT	      0x01
 #define DNS_MASTERRAW_SOURCESERIALSET 0x02
 #define DNS_MASTERRAW_LASTXFRINSET    0x04
+#define DNS_MASTERRAW_CACHE	      0x08 /*%< Cache snapshot */
+
+/*
+ * Cache attributes of an RRset in a cache snapshot
+ */
+#define DNS_MASTERRAW_ATTR_NEGATIVE 0x0001
+#define DNS_MASTERRAW_ATTR_NXDOMAIN 0x0002
+#define DNS_MASTERRAW_ATTR_OPTOUT   0x0004
+#define DNS_MASTERRAW_ATTR_PREFETCH 0x0008
+
+/*
+ * A file in the "map" format starts with the same header, with the format
+ * set to dns_masterformat_map and the version to DNS_RAWFORMAT_VERSION.
+ * It is followed by an image of the database, which is not parsed but
+ * mapped into memory by the database (see dns_db_serialize()).
+ */
 
 /* Common header */
 struct dns_masterrawheader {
 	uint32_t format;       /* must be
-				* dns_masterformat_raw */
+				* dns_masterformat_raw
+				* or dns_masterformat_map */
 	uint32_t version;      /* compatibility for future
 				* extensions */
 	uint32_t dumptime;     /* timestamp on creation
@@ -106,6 +131,21 @@ typedef struct {
 	/* followed by encoded owner name, and then rdata */
 } dns_masterrawrdataset_t;
 
+/* The structure for each RRset in a cache snapshot */
+typedef struct {
+	uint32_t totallen;	  /* length of the data for this
+				   * RRset, including the
+				   * "header" part */
+	dns_rdataclass_t rdclass; /* 16-bit class */
+	dns_rdatatype_t	 type;	  /* 16-bit type */
+	dns_rdatatype_t	 covers;  /* same as type */
+	uint32_t	 expire;  /* absolute expiry time */
+	uint32_t	 nrdata;  /* number of RRs in this set */
+	uint16_t	 trust;	  /* dns_trust_t */
+	uint16_t	 attributes; /* DNS_MASTERRAW_ATTR_* */
+	/* followed by encoded owner name, and then rdata */
+} dns_mastercacherdataset_t;
+
 /*
  * Method prototype: a callback to register each include file as
  * it is encountered.
@@ -223,6 +263,55 @@ dns_loadctx_cancel(dns_loadctx_t *ctx);
  *\li	'ctx' to be valid
  */
 
+void
+dns_master_setparallel(unsigned int nthreads, size_t chunksize);
+/*%<
+ * Set how text and raw master files are loaded by dns_master_loadfile()
+ * and dns_master_loadfileasync().  A file that is at least twice
+ * 'chunksize' bytes long is split into chunks of about 'chunksize' bytes,
+ * which are parsed by up to 'nthreads' threads.  The RRsets are still
+ * passed to 'callbacks->add' one at a time and in the order they appear
+ * in the file, and errors are reported with the line they were found at.
+ *
+ * 'nthreads' of 0 selects the number of CPUs (the default), and 1
+ * turns parallel loading off.  'chunksize' of 0 selects the default
+ * of 4 MB.
+ *
+ * Requires:
+ *\li	'chunksize' is no more than UINT_MAX.
+ */
+
+isc_result_t
+dns_master_loadcache(const char *master_file, dns_rdataclass_t zclass,
+		     isc_stdtime_t now, dns_ttl_t maxttl,
+		     dns_rdatacallbacks_t *callbacks, isc_mem_t *mctx);
+/*%<
+ * Loads a cache snapshot, a raw master file written with the
+ * DNS_MASTERRAW_CACHE flag set in its header.  The file is mapped into
+ * memory and read in one pass, calling 'callbacks->add' for each RRset
+ * that has not expired by 'now'.  The TTL of the rdataset passed to
+ * 'callbacks->add' is the time it has left, but no more than 'maxttl'
+ * unless that is zero, and its trust level and attributes are those it
+ * had in the cache.
+ *
+ * Requires:
+ *\li	'master_file' points to a valid string.
+ *\li	'callbacks->add' points to a valid function.
+ *\li	'callbacks->error' points to a valid function.
+ *\li	'mctx' points to a valid memory context.
+ *
+ * Returns:
+ *\li	ISC_R_SUCCESS upon successfully loading the snapshot.
+ *\li	ISC_R_FILENOTFOUND if there is no snapshot.
+ *\li	ISC_R_NOTIMPLEMENTED if the file is not a cache snapshot.
+ *\li	ISC_R_RANGE, ISC_R_UNEXPECTEDEND, DNS_R_FORMERR if the file is
+ *	malformed, or an RRset has a TTL longer than 2^31 - 1 seconds, or
+ *	a trust level that no cache entry can have.
+ *\li	DNS_R_BADCLASS if an RRset's class is not 'zclass'.
+ *\li	Any dns_rdata_fromwire() error code.
+ *\li	Any error code from callbacks->add().
+ */
+
 void
 dns_master_initrawheader(dns_masterrawheader_t *header);
 /*%<
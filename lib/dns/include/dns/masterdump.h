@@ -261,6 +261,9 @@ dns_master_dumptostream(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
  * If 'format' is dns_masterformat_raw, then 'header' can contain
  * information to be written to the file header.
  *
+ * If 'format' is dns_masterformat_map, the database is written out with
+ * dns_db_serialize() after the header, and 'f' must be seekable.
+ *
  * Temporary dynamic memory may be allocated from 'mctx'.
  *
  * Require:
@@ -275,6 +278,23 @@ dns_master_dumptostream(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
  */
 /*@}*/
 
+void
+dns_master_setdumpparallel(unsigned int nthreads, unsigned int nodes);
+/*%<
+ * Set how the functions above and below dump large databases.  A database
+ * with at least twice 'nodes' nodes is divided into parts of about 'nodes'
+ * nodes each, which are dumped by up to 'nthreads' threads into memory
+ * and written to the file in order.  Map files are always written by one
+ * thread.
+ *
+ * In text files, each part starts with a $ORIGIN directive, and with
+ * the TTL and class given in full, so the file is equivalent to, but not
+ * always identical with, the one written by a single thread.
+ *
+ * 'nthreads' of 0 selects the number of CPUs (the default), and 1
+ * turns parallel dumping off.  'nodes' of 0 selects the default of 4096.
+ */
+
 /*@{*/
 
 isc_result_t
@@ -294,8 +314,8 @@ dns_master_dump(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
  * 'format'.  If the format is dns_masterformat_text (the RFC1035 format),
  * 'style' specifies the file style (e.g., &dns_master_style_default).
  *
- * If 'format' is dns_masterformat_raw, then 'header' can contain
- * information to be written to the file header.
+ * If 'format' is dns_masterformat_raw or dns_masterformat_map, then
+ * 'header' can contain information to be written to the file header.
  *
  * Temporary dynamic memory may be allocated from 'mctx'.
  *
@@ -219,6 +219,10 @@ typedef int dns_messagetextflag_t;
 #define DNS_MESSAGEPARSE_IGNORETRUNCATION \
 	0x0008 /*%< truncation errors are \
 		* not fatal. */
+#define DNS_MESSAGEPARSE_LAZY          \
+	0x0010 /*%< defer parsing of the \
+		* answer, authority and \
+		* additional records */
 
 /*
  * Control behavior of rendering
@@ -277,11 +281,14 @@ struct dns_message {
 	unsigned int verify_attempted : 1;
 	unsigned int free_query	      : 1;
 	unsigned int free_saved	      : 1;
+	unsigned int clone_query      : 1;
+	unsigned int clone_saved      : 1;
 	unsigned int cc_ok	      : 1;
 	unsigned int cc_bad	      : 1;
 	unsigned int tkey	      : 1;
 	unsigned int rdclass_set      : 1;
 	unsigned int fuzzing	      : 1;
+	unsigned int deferred	      : 1;
 
 	unsigned int opt_reserved;
 	unsigned int sig_reserved;
@@ -323,6 +330,17 @@ struct dns_message {
 	dns_rcode_t  sig0status;
 	isc_region_t query;
 	isc_region_t saved;
+	isc_buffer_t *clonebuf; /* Storage for cloned query/saved,
+				 * kept across resets */
+
+	/*
+	 * Records skipped by a lazy parse, as offsets into 'saved'.
+	 */
+	struct {
+		unsigned int offset;
+		unsigned int count;
+	} deferred_sections[DNS_SECTION_MAX];
+	unsigned int deferred_options;
 
 	/*
 	 * Time to be used when fuzzing.
@@ -555,9 +573,25 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
  * If #DNS_MESSAGEPARSE_IGNORETRUNCATION is set then return as many complete
  * RR's as possible, DNS_R_RECOVERABLE will be returned.
  *
+ * If #DNS_MESSAGEPARSE_LAZY is set and the message is a QUERY request
+ * with a question, only the header, the question, and the OPT, TSIG and
+ * SIG(0) records are parsed.  The remaining answer, authority and
+ * additional records are validated but not stored; they are parsed the
+ * first time one of these sections is accessed with
+ * dns_message_firstname(), dns_message_findname() or
+ * dns_message_sectiontotext().  The source data must therefore stay
+ * valid until the message is reset or replied to, or until
+ * dns_message_clonebuffer() is called.  If any of the records could
+ * cause an error or a #DNS_R_RECOVERABLE result, the message is parsed
+ * in full, so the result is always the same as without the flag.
+ *
  * OPT and TSIG records are always handled specially, regardless of the
  * 'preserve_order' setting.
  *
+ * The owner names and rdata of the parsed records are copied into
+ * scratch buffers owned by the message; they do not point into
+ * 'source'.
+ *
  * Requires:
  *\li	"msg" be valid.
  *
@@ -754,6 +788,7 @@ dns_message_firstname(dns_message_t *msg, dns_section_t section);
  * Returns:
  *\li	#ISC_R_SUCCESS		-- All is well.
  *\li	#ISC_R_NOMORE		-- No names on given section.
+ *\li	Any error from parsing the records deferred by a lazy parse.
  */
 
 isc_result_t
@@ -833,6 +868,7 @@ dns_message_findname(dns_message_t *msg, dns_section_t section,
  *\li	#DNS_R_NXDOMAIN		-- name does not exist in that section.
  *\li	#DNS_R_NXRRSET		-- The name does exist, but the desired
  *				   type does not.
+ *\li	Any error from parsing the records deferred by a lazy parse.
  */
 
 isc_result_t
@@ -1518,6 +1554,11 @@ dns_message_clonebuffer(dns_message_t *msg);
  * Clone the query or saved buffers if they where not cloned
  * when parsing.
  *
+ * The copies are made into storage owned by the message which is
+ * kept across dns_message_reset(), so a message that is reused for
+ * many requests (as ns_client does) does not allocate memory here
+ * unless the buffers are larger than the storage.
+ *
  * Requires:
  * \li   msg be a valid message.
  */
@@ -689,6 +689,10 @@ dns_name_fromwire(dns_name_t *name, isc_buffer_t *source, dns_decompress_t dctx,
  * Notes:
  * \li	Decompression policy is controlled by 'dctx'.
  *
+ * \li	If DNS_NAME_DOWNCASE is set in 'options', any uppercase letters
+ *	in the name are converted to lowercase as the name is copied into
+ *	'target'; 'source' is not modified.
+ *
  * Security:
  *
  * \li	*** WARNING ***
@@ -709,8 +713,6 @@ dns_name_fromwire(dns_name_t *name, isc_buffer_t *source, dns_decompress_t dctx,
  *
  * \li	'dctx' is a valid decompression context.
  *
- * \li	DNS_NAME_DOWNCASE is not set.
- *
  * Ensures:
  *
  *	If result is success:
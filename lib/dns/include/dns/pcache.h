@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*****
+***** Module Info
+*****/
+
+/*! \file dns/pcache.h
+ * \brief
+ * Defines dns_pcache_t, the "answer cache" object.
+ *
+ * Notes:
+ *\li	An answer cache is a fixed-size, direct-mapped table of fully
+ *	rendered responses, keyed by the question and by the properties
+ *	of the request that influence the content of the response.  It
+ *	is used by the server to answer repeated authoritative queries
+ *	without going through the database lookup and rendering code.
+ *
+ *\li	Every entry is tagged with the generation of the database it was
+ *	built from (see dns_db_generation()) and the SOA serial of the
+ *	database version that was current at the time.  Lookups supply
+ *	the current generation and serial, and entries that don't match
+ *	are discarded, so a zone reload or update invalidates the cached
+ *	responses implicitly.  Generations are never reused, so a new
+ *	database allocated at the address of a freed one can't match
+ *	entries built from the old one.
+ *	Entries are also discarded a fixed time after they were added,
+ *	which bounds the lifetime of responses cached from databases
+ *	that changed without a serial change.
+ *
+ *\li	The cache doesn't interpret the cached data in any way; it is
+ *	up to the caller to patch the message ID and to add any
+ *	per-request data (such as the OPT record) to the response.
+ *
+ * MP:
+ *\li	The table is protected by a set of striped locks and may be used
+ *	from multiple threads concurrently.
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/buffer.h>
+#include <isc/stdtime.h>
+
+#include <dns/types.h>
+
+ISC_LANG_BEGINDECLS
+
+typedef struct dns_pcachekey {
+	const dns_name_t *qname;
+	dns_rdatatype_t	  qtype;
+	dns_rdataclass_t  qclass;
+	uint16_t	  udpsize;
+	uint32_t	  attributes; /*%< Opaque to the cache */
+} dns_pcachekey_t;
+/*%<
+ * An answer cache key.  The question name is compared byte for byte,
+ * so names differing only in case are cached separately; this
+ * preserves the case of the question in the cached responses.
+ * 'udpsize' and 'attributes' describe the request: any property of
+ * the request that can change the cached part of the response must
+ * be reflected in one of them.
+ */
+
+#define DNS_PCACHE_LIFETIME 60 /*%< Seconds before an entry expires */
+
+/***
+ ***	Functions
+ ***/
+
+void
+dns_pcache_create(isc_mem_t *mctx, unsigned int size, dns_pcache_t **pcachep);
+/*%<
+ * Create an answer cache with room for at least 'size' entries (the
+ * size is rounded up to the next power of two) and store it in
+ * '*pcachep'.
+ *
+ * Requires:
+ * \li	'mctx' is a valid memory context.
+ * \li	'size' > 0
+ * \li	pcachep != NULL && *pcachep == NULL
+ */
+
+void
+dns_pcache_destroy(dns_pcache_t **pcachep);
+/*%<
+ * Free all entries and then the answer cache itself.  '*pcachep' is
+ * set to NULL on return.
+ *
+ * Requires:
+ * \li	'*pcachep' is a valid answer cache.
+ */
+
+void
+dns_pcache_add(dns_pcache_t *pcache, const dns_pcachekey_t *key,
+	       uint64_t generation, uint32_t serial, uint32_t aux,
+	       const isc_region_t *wire, isc_stdtime_t now);
+/*%<
+ * Add the response in 'wire' to the cache, replacing any entry that
+ * occupied the same slot.  'generation' and 'serial' identify the
+ * database version the response was built from.  'aux' is stored along
+ * with the response and returned by dns_pcache_find().
+ *
+ * Responses longer than 65535 octets are silently ignored.
+ *
+ * Requires:
+ * \li	'pcache' is a valid answer cache.
+ * \li	'key' and 'wire' are not NULL.
+ * \li	'generation' is not zero.
+ */
+
+isc_result_t
+dns_pcache_find(dns_pcache_t *pcache, const dns_pcachekey_t *key,
+		uint64_t generation, uint32_t serial, isc_stdtime_t now,
+		isc_buffer_t *target, uint32_t *auxp);
+/*%<
+ * Look up 'key' and, if a response built from the version 'serial' of
+ * the database with generation 'generation' is cached, copy it to
+ * 'target'.
+ *
+ * Entries built from another database or version, and entries that
+ * have expired, are removed.
+ *
+ * Requires:
+ * \li	'pcache' is a valid answer cache.
+ * \li	'key' and 'target' are not NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS		the response was copied to 'target';
+ *				if 'auxp' is not NULL, '*auxp' is set to
+ *				the value passed to dns_pcache_add()
+ * \li	#ISC_R_NOTFOUND		no usable response was found
+ * \li	#ISC_R_NOSPACE		a response was found, but it doesn't fit
+ *				in 'target'
+ */
+
+void
+dns_pcache_flush(dns_pcache_t *pcache);
+/*%<
+ * Remove all entries from the cache.
+ *
+ * Requires:
+ * \li	'pcache' is a valid answer cache.
+ */
+
+ISC_LANG_ENDDECLS
@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*****
+***** Module Info
+*****/
+
+/*! \file dns/qp.h
+ * \brief
+ * Defines dns_qp_t, a qp-trie ("quadbit popcount trie") of domain names.
+ *
+ * Notes:
+ *\li	A qp-trie is a radix tree whose branch nodes contain a bitmap of
+ *	the twigs that are present and a pointer to a dense array of
+ *	those twigs; the position of a twig in the array is found by
+ *	counting the bits below it in the bitmap.  Every node is two
+ *	words long, there are no parent or sibling pointers, and there
+ *	is no separate hash table, so a trie uses a small fraction of the
+ *	memory of a red-black tree of the same names and a lookup touches
+ *	one cache line per branch on the way down.
+ *
+ *\li	The trie is keyed by the lookup form of the name: the labels are
+ *	taken from the root outwards and every octet is converted to one
+ *	or two symbols that sort in the same order as the lower-cased
+ *	octet.  The order of the keys is therefore the DNSSEC canonical
+ *	order of the names, and names differing only in case are equal.
+ *
+ *\li	The trie doesn't store names.  The leaves hold a pointer value
+ *	and an integer value supplied by the caller, and the trie uses
+ *	the caller's methods to get the key of a leaf from those values
+ *	(to compare it against a search key) and to maintain reference
+ *	counts on the objects they refer to.  The pointer value must be
+ *	at least 2-byte aligned.
+ *
+ * MP:
+ *\li	The trie is not locked internally; the caller must ensure that
+ *	it is not modified while it is being read or iterated over.
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <isc/lang.h>
+#include <isc/magic.h>
+
+#include <dns/types.h>
+
+ISC_LANG_BEGINDECLS
+
+/*%
+ * The longest possible key.  Every octet of a name takes at most two
+ * symbols, and the length octets are replaced by a label separator.
+ */
+#define DNS_QP_MAXKEY 512
+
+typedef uint8_t dns_qpkey_t[DNS_QP_MAXKEY];
+
+typedef struct dns_qpnode dns_qpnode_t;
+
+typedef struct dns_qpmethods {
+	void (*attach)(void *uctx, void *pval, uint32_t ival);
+	void (*detach)(void *uctx, void *pval, uint32_t ival);
+	size_t (*makekey)(dns_qpkey_t key, void *uctx, void *pval,
+			  uint32_t ival);
+} dns_qpmethods_t;
+/*%<
+ * The methods used by a trie to manage the values stored in its leaves.
+ *
+ * 'attach' is called when a leaf is added to the trie and 'detach' when
+ * it is removed, either by dns_qp_delete*() or dns_qp_destroy().  Either
+ * may be NULL.
+ *
+ * 'makekey' must store the key of the leaf in 'key' (normally with
+ * dns_qpkey_fromname()) and return its length.
+ *
+ * 'uctx' is the context pointer given to dns_qp_create().
+ */
+
+typedef struct dns_qpiter {
+	unsigned int  magic;
+	dns_qp_t     *qp;
+	unsigned int  sp;
+	bool	      done;
+	dns_qpnode_t *stack[DNS_QP_MAXKEY + 1];
+} dns_qpiter_t;
+/*%<
+ * An iterator over the leaves of a trie, in key order.  It must not be
+ * used after the trie has been modified.
+ */
+
+/***
+ ***	Functions
+ ***/
+
+size_t
+dns_qpkey_fromname(dns_qpkey_t key, const dns_name_t *name);
+/*%<
+ * Convert 'name' to a trie key and return the length of the key.
+ *
+ * Requires:
+ * \li	'name' is a valid absolute name.
+ */
+
+void
+dns_qp_create(isc_mem_t *mctx, const dns_qpmethods_t *methods, void *uctx,
+	      dns_qp_t **qpp);
+/*%<
+ * Create an empty trie that uses 'methods' with the context 'uctx' to
+ * manage its leaves.
+ *
+ * Requires:
+ * \li	'mctx' is a valid memory context.
+ * \li	'methods' is not NULL and 'methods->makekey' is not NULL.
+ * \li	qpp != NULL && *qpp == NULL
+ */
+
+void
+dns_qp_destroy(dns_qp_t **qpp);
+/*%<
+ * Detach all the leaves and free the trie.  '*qpp' is set to NULL on
+ * return.
+ *
+ * Requires:
+ * \li	'*qpp' is a valid trie.
+ */
+
+isc_result_t
+dns_qp_insert(dns_qp_t *qp, void *pval, uint32_t ival);
+/*%<
+ * Add a leaf holding 'pval' and 'ival' to the trie, using the 'makekey'
+ * method to find its key.  The 'attach' method is called on success.
+ *
+ * Requires:
+ * \li	'qp' is a valid trie.
+ * \li	'pval' is at least 2-byte aligned.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_EXISTS		a leaf with the same key is already
+ *				present; the trie is not changed
+ */
+
+isc_result_t
+dns_qp_getkey(dns_qp_t *qp, const dns_qpkey_t key, size_t keylen,
+	      void **pvalp, uint32_t *ivalp);
+isc_result_t
+dns_qp_getname(dns_qp_t *qp, const dns_name_t *name, void **pvalp,
+	       uint32_t *ivalp);
+/*%<
+ * Find the leaf whose key is exactly 'key', or the key of 'name', and
+ * store its values in '*pvalp' and '*ivalp' (either may be NULL).
+ *
+ * Requires:
+ * \li	'qp' is a valid trie.
+ * \li	'keylen' <= DNS_QP_MAXKEY, or 'name' is a valid absolute name.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTFOUND
+ */
+
+isc_result_t
+dns_qp_findname_ancestor(dns_qp_t *qp, const dns_name_t *name, void **pvalp,
+			 uint32_t *ivalp);
+/*%<
+ * Find the leaf for 'name' or, failing that, for its closest ancestor
+ * that is in the trie, and store its values in '*pvalp' and '*ivalp'
+ * (either may be NULL).  This takes a single pass down the trie
+ * regardless of the number of labels in 'name'.
+ *
+ * Requires:
+ * \li	'qp' is a valid trie.
+ * \li	'name' is a valid absolute name.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS		an exact match was found
+ * \li	#DNS_R_PARTIALMATCH	an ancestor of 'name' was found
+ * \li	#ISC_R_NOTFOUND		neither 'name' nor any of its ancestors
+ *				are in the trie
+ */
+
+isc_result_t
+dns_qp_deletekey(dns_qp_t *qp, const dns_qpkey_t key, size_t keylen);
+isc_result_t
+dns_qp_deletename(dns_qp_t *qp, const dns_name_t *name);
+/*%<
+ * Remove the leaf whose key is exactly 'key', or the key of 'name', and
+ * call the 'detach' method on it.
+ *
+ * Requires:
+ * \li	'qp' is a valid trie.
+ * \li	'keylen' <= DNS_QP_MAXKEY, or 'name' is a valid absolute name.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTFOUND
+ */
+
+isc_result_t
+dns_qp_getname_prev(dns_qp_t *qp, const dns_name_t *name, void **pvalp,
+		    uint32_t *ivalp);
+isc_result_t
+dns_qp_getname_next(dns_qp_t *qp, const dns_name_t *name, void **pvalp,
+		    uint32_t *ivalp);
+/*%<
+ * Find the leaf whose key is the closest one before (or after) the key
+ * of 'name' in the order of the trie, i.e. the DNSSEC predecessor (or
+ * successor) of 'name', which need not be in the trie itself, and store
+ * its values in '*pvalp' and '*ivalp' (either may be NULL).
+ *
+ * Requires:
+ * \li	'qp' is a valid trie.
+ * \li	'name' is a valid absolute name.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTFOUND		there is no leaf before (or after)
+ *				'name'
+ */
+
+isc_result_t
+dns_qp_getfirst(dns_qp_t *qp, void **pvalp, uint32_t *ivalp);
+isc_result_t
+dns_qp_getlast(dns_qp_t *qp, void **pvalp, uint32_t *ivalp);
+/*%<
+ * Find the leaf with the smallest (or largest) key and store its values
+ * in '*pvalp' and '*ivalp' (either may be NULL).
+ *
+ * Requires:
+ * \li	'qp' is a valid trie.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTFOUND		the trie is empty
+ */
+
+size_t
+dns_qp_count(dns_qp_t *qp);
+/*%<
+ * Return the number of leaves in the trie.
+ *
+ * Requires:
+ * \li	'qp' is a valid trie.
+ */
+
+void
+dns_qpiter_init(dns_qp_t *qp, dns_qpiter_t *qpi);
+/*%<
+ * Initialize 'qpi' to iterate over the leaves of 'qp'.
+ *
+ * Requires:
+ * \li	'qp' is a valid trie.
+ * \li	'qpi' is not NULL.
+ */
+
+isc_result_t
+dns_qpiter_next(dns_qpiter_t *qpi, void **pvalp, uint32_t *ivalp);
+/*%<
+ * Store the values of the next leaf in '*pvalp' and '*ivalp' (either
+ * may be NULL).  The first call returns the leaf with the smallest key.
+ *
+ * Requires:
+ * \li	'qpi' is a valid iterator and the trie has not been modified
+ *	since it was initialized.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOMORE		there are no more leaves
+ */
+
+ISC_LANG_ENDDECLS
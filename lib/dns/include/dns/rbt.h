@@ -17,9 +17,10 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include <sys/types.h>
 
 #include <isc/assertions.h>
-#include <isc/crc64.h>
 #include <isc/lang.h>
 #include <isc/magic.h>
 #include <isc/refcount.h>
@@ -142,6 +143,7 @@ struct dns_rbtnode {
 	uint8_t dirty : 1;
 	uint8_t wild  : 1;
 	uint8_t	      : 0;	/* end of bitfields c/o node lock */
+	uint8_t	       shard;	/* see dns_rbt_setshard(); read-only */
 	uint16_t       locknum; /* note that this is not in the bitfield */
 	isc_refcount_t references;
 	/*@}*/
@@ -151,12 +153,12 @@ typedef isc_result_t (*dns_rbtfindcallback_t)(dns_rbtnode_t *node,
 					      dns_name_t    *name,
 					      void	    *callback_arg);
 
-typedef isc_result_t (*dns_rbtdatawriter_t)(FILE *file, unsigned char *data,
-					    void *arg, uint64_t *crc);
+typedef isc_result_t (*dns_rbtdatawriter_t)(FILE *file, dns_rbtnode_t *node,
+					    uintptr_t nodeaddr, void *arg,
+					    uintptr_t *datap);
 
-typedef isc_result_t (*dns_rbtdatafixer_t)(dns_rbtnode_t *rbtnode, void *base,
-					   size_t offset, void *arg,
-					   uint64_t *crc);
+typedef isc_result_t (*dns_rbtdatafixer_t)(dns_rbtnode_t *node,
+					   intptr_t delta, void *arg);
 
 typedef void (*dns_rbtdeleter_t)(void *, void *);
 
@@ -666,6 +668,79 @@ dns_rbt_hashsize(dns_rbt_t *rbt);
  * \li  rbt is a valid rbt manager.
  */
 
+void
+dns_rbt_setshard(dns_rbt_t *rbt, uint8_t shard);
+/*%<
+ * Set the 'shard' field of every node subsequently created in 'rbt',
+ * including the nodes created when an existing node is split.  This
+ * lets a caller that spreads names over several trees find the tree a
+ * node belongs to from the node alone.
+ *
+ * Requires:
+ * \li  rbt is a valid rbt manager.
+ * \li  rbt is empty.
+ */
+
+isc_result_t
+dns_rbt_serialize_tree(FILE *file, dns_rbt_t *rbt, uintptr_t base,
+		       dns_rbtdatawriter_t datawriter, void *writer_arg,
+		       off_t *offset);
+/*%<
+ * Write the tree of trees, and its hash table, to 'file' at the current
+ * position, laid out so that the image can be used in place once the
+ * file is mapped into memory at address 'base' (file offset 0 at
+ * 'base'): every pointer in the image is the address the object it
+ * points to will have in the mapping.
+ *
+ * The data of each node is written by 'datawriter', which is passed the
+ * address the node will have, and returns the address of the data it
+ * wrote in '*datap' (or 0 if it wrote none).  It must leave the file
+ * positioned at an 8 byte boundary.
+ *
+ * On success, '*offset' is the file offset of the tree's header, to be
+ * passed to dns_rbt_deserialize_tree().
+ *
+ * Requires:
+ * \li  file is seekable, and positioned at an 8 byte boundary.
+ * \li  rbt is a valid rbt manager, which is not modified until the
+ *      function returns.
+ * \li  datawriter is not NULL.
+ */
+
+isc_result_t
+dns_rbt_deserialize_tree(void *map, size_t mapsize, off_t offset,
+			 intptr_t delta, isc_mem_t *mctx,
+			 dns_rbtdeleter_t deleter, void *deleter_arg,
+			 dns_rbtdatafixer_t datafixer, void *fixer_arg,
+			 dns_rbt_t **rbtp);
+/*%<
+ * Create a tree of trees from the image written by
+ * dns_rbt_serialize_tree() at 'offset' in a file that is mapped at
+ * 'map'.  The nodes and the hash table are used in place: they are not
+ * copied, and no page of the mapping is touched until a lookup reaches
+ * it, unless the file could not be mapped at the address it was written
+ * for.  In that case 'delta' is the difference between the actual and
+ * the intended addresses, every pointer in the image is adjusted by it,
+ * and 'datafixer' is called for each node that has data so that the
+ * data can be adjusted too; it returns #ISC_R_INVALIDFILE if the data
+ * is damaged.
+ *
+ * The mapping must be private and writable, so that changes to the tree
+ * are copied on write; it must stay in place until the tree has been
+ * destroyed.  Nodes in the mapping are never freed, and nodes added later
+ * are allocated from 'mctx' as usual.
+ *
+ * Requires:
+ * \li  'map' is not NULL and 'offset' is within the first 'mapsize' bytes.
+ * \li  mctx is a valid memory context.
+ * \li  rbtp != NULL && *rbtp == NULL.
+ *
+ * Returns:
+ * \li  #ISC_R_SUCCESS
+ * \li  #ISC_R_INVALIDFILE	the image is damaged or was not written by
+ *				this build.
+ */
+
 void
 dns_rbt_destroy(dns_rbt_t **rbtp);
 isc_result_t
@@ -579,6 +579,22 @@ dns_resolver_setnonbackofftries(dns_resolver_t *resolver, unsigned int tries);
  * \li  tries > 0.
  */
 
+unsigned int
+dns_resolver_getmaxraces(dns_resolver_t *resolver);
+
+void
+dns_resolver_setmaxraces(dns_resolver_t *resolver, unsigned int races);
+/*%<
+ * Sets the number of times a single fetch may race a query that a
+ * server is slow to answer (twice its smoothed RTT) by sending the same
+ * query to the next best server too; the first usable response wins.
+ * The raced queries count against the maximum number of queries per
+ * fetch.  Defaults to 0, which disables racing.
+ *
+ * Requires:
+ * \li	resolver to be valid.
+ */
+
 unsigned int
 dns_resolver_getoptions(dns_resolver_t *resolver);
 /*%<
@@ -71,7 +71,9 @@ enum {
 	dns_resstatscounter_serverquota = 42,
 	dns_resstatscounter_nextitem = 43,
 	dns_resstatscounter_priming = 44,
-	dns_resstatscounter_max = 45,
+	dns_resstatscounter_racesent = 45,
+	dns_resstatscounter_racewon = 46,
+	dns_resstatscounter_max = 47,
 
 	/*
 	 * DNSSEC stats.
@@ -122,8 +124,11 @@ enum {
 	dns_cachestatscounter_deletelru = 5,
 	dns_cachestatscounter_deletettl = 6,
 	dns_cachestatscounter_coveringnsec = 7,
+	dns_cachestatscounter_cleanersweeps = 8,
+	dns_cachestatscounter_cleaneryields = 9,
+	dns_cachestatscounter_cleanermaxtime = 10,
 
-	dns_cachestatscounter_max = 8,
+	dns_cachestatscounter_max = 11,
 
 	/*%
 	 * Query statistics counters (obsolete).
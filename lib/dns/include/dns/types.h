@@ -25,6 +25,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <sys/types.h>
 
 #include <isc/types.h>
 
@@ -116,8 +117,10 @@ typedef struct dns_ntatable	  dns_ntatable_t;
 typedef uint16_t		  dns_opcode_t;
 typedef unsigned char		  dns_offsets_t[128];
 typedef struct dns_order	  dns_order_t;
+typedef struct dns_pcache	  dns_pcache_t;
 typedef struct dns_peer		  dns_peer_t;
 typedef struct dns_peerlist	  dns_peerlist_t;
+typedef struct dns_qp		  dns_qp_t;
 typedef struct dns_rbt		  dns_rbt_t;
 typedef uint16_t		  dns_rcode_t;
 typedef struct dns_rdata	  dns_rdata_t;
@@ -216,6 +219,7 @@ typedef enum {
 	dns_masterformat_none = 0,
 	dns_masterformat_text = 1,
 	dns_masterformat_raw = 2,
+	dns_masterformat_map = 3,
 } dns_masterformat_t;
 
 /*
@@ -402,6 +406,8 @@ typedef void (*dns_rawdatafunc_t)(dns_zone_t *, dns_masterrawheader_t *);
 typedef isc_result_t (*dns_addrdatasetfunc_t)(void *, const dns_name_t *,
 					      dns_rdataset_t *);
 
+typedef isc_result_t (*dns_deserializefunc_t)(void *, FILE *, off_t);
+
 typedef isc_result_t (*dns_additionaldatafunc_t)(void *, const dns_name_t *,
 						 dns_rdatatype_t,
 						 dns_rdataset_t *);
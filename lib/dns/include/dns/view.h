@@ -185,6 +185,7 @@ struct dns_view {
 	dns_dlzdblist_t	  dlz_unsearched;
 	uint32_t	  fail_ttl;
 	dns_badcache_t	 *failcache;
+	dns_pcache_t	 *pcache;
 	unsigned int	  udpsize;
 
 	/*
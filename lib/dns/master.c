@@ -13,16 +13,26 @@
 
 /*! \file */
 
+#include <fcntl.h>
 #include <inttypes.h>
+#include <stdarg.h>
 #include <stdbool.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <isc/async.h>
 #include <isc/atomic.h>
+#include <isc/condition.h>
+#include <isc/endian.h>
+#include <isc/errno.h>
 #include <isc/event.h>
 #include <isc/lex.h>
 #include <isc/loop.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/os.h>
 #include <isc/print.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
@@ -30,6 +40,7 @@
 #include <isc/stdio.h>
 #include <isc/stdtime.h>
 #include <isc/string.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 #include <isc/work.h>
 
@@ -95,6 +106,7 @@
 typedef ISC_LIST(dns_rdatalist_t) rdatalist_head_t;
 
 typedef struct dns_incctx dns_incctx_t;
+typedef struct parallel parallel_t;
 
 /*%
  * Master file load state.
@@ -151,6 +163,13 @@ struct dns_loadctx {
 
 	dns_masterincludecb_t include_cb;
 	void *include_arg;
+
+	/* Members used by the parallel text loader: */
+	unsigned char *map;
+	size_t mapsize;
+	char *filename;
+	parallel_t *parallel; /*%< set in the context of each chunk */
+	size_t chunk;
 };
 
 struct dns_incctx {
@@ -180,12 +199,33 @@ openfile_text(dns_loadctx_t *lctx, const char *master_file);
 static isc_result_t
 load_text(dns_loadctx_t *lctx);
 
+static bool
+map_text(dns_loadctx_t *lctx, const char *master_file);
+
+static isc_result_t
+load_text_parallel(dns_loadctx_t *lctx);
+
+static bool
+chunk_canceled(dns_loadctx_t *lctx);
+
 static isc_result_t
 openfile_raw(dns_loadctx_t *lctx, const char *master_file);
 
 static isc_result_t
 load_raw(dns_loadctx_t *lctx);
 
+static bool
+map_file(dns_loadctx_t *lctx, int fd);
+
+static bool
+load_raw_parallel(dns_loadctx_t *lctx, isc_result_t *resultp);
+
+static isc_result_t
+openfile_map(dns_loadctx_t *lctx, const char *master_file);
+
+static isc_result_t
+load_map(dns_loadctx_t *lctx);
+
 static isc_result_t
 pushfile(const char *master_file, dns_name_t *origin, dns_loadctx_t *lctx);
 
@@ -261,7 +301,7 @@ loadctx_destroy(dns_loadctx_t *lctx);
 
 #define WARNUNEXPECTEDEOF(lexer)                                         \
 	do {                                                             \
-		if (isc_lex_isfile(lexer))                               \
+		if (isc_lex_isfile(lexer) || lctx->parallel != NULL)     \
 			(*callbacks->warn)(callbacks,                    \
 					   "%s: file does not end with " \
 					   "newline",                    \
@@ -448,6 +488,13 @@ loadctx_destroy(dns_loadctx_t *lctx) {
 		isc_lex_destroy(&lctx->lex);
 	}
 
+	if (lctx->map != NULL) {
+		munmap(lctx->map, lctx->mapsize);
+	}
+	if (lctx->filename != NULL) {
+		isc_mem_free(lctx->mctx, lctx->filename);
+	}
+
 	isc_mem_putanddetach(&lctx->mctx, lctx, sizeof(*lctx));
 }
 
@@ -532,6 +579,10 @@ loadctx_create(dns_masterformat_t format, isc_mem_t *mctx, unsigned int options,
 		lctx->openfile = openfile_raw;
 		lctx->load = load_raw;
 		break;
+	case dns_masterformat_map:
+		lctx->openfile = openfile_map;
+		lctx->load = load_map;
+		break;
 	default:
 		UNREACHABLE();
 	}
@@ -989,6 +1040,15 @@ check_wildcard(dns_incctx_t *ictx, const char *source, unsigned long line,
 
 static isc_result_t
 openfile_text(dns_loadctx_t *lctx, const char *master_file) {
+	/*
+	 * A large master file is mapped and loaded in parallel; included
+	 * files, which are opened once the lexer has a source, are not.
+	 */
+	if (isc_lex_getsourcename(lctx->lex) == NULL && lctx->map == NULL &&
+	    map_text(lctx, master_file))
+	{
+		return (ISC_R_SUCCESS);
+	}
 	return (isc_lex_openfile(lctx->lex, master_file));
 }
 
@@ -1087,6 +1147,10 @@ load_text(dns_loadctx_t *lctx) {
 			result = ISC_R_CANCELED;
 			goto log_and_cleanup;
 		}
+		if (lctx->parallel != NULL && chunk_canceled(lctx)) {
+			result = ISC_R_CANCELED;
+			goto insist_and_cleanup;
+		}
 
 		initialws = false;
 		line = isc_lex_getsourceline(lctx->lex);
@@ -2245,7 +2309,9 @@ load_header(dns_loadctx_t *lctx) {
 
 	REQUIRE(DNS_LCTX_VALID(lctx));
 
-	if (lctx->format != dns_masterformat_raw) {
+	if (lctx->format != dns_masterformat_raw &&
+	    lctx->format != dns_masterformat_map)
+	{
 		return (ISC_R_NOTIMPLEMENTED);
 	}
 
@@ -2267,7 +2333,9 @@ load_header(dns_loadctx_t *lctx) {
 	if (header.format != lctx->format) {
 		(*callbacks->error)(callbacks,
 				    "dns_master_load: "
-				    "file format mismatch (not raw)");
+				    "file format mismatch (not %s)",
+				    lctx->format == dns_masterformat_map ? "map"
+									 : "raw");
 		return (ISC_R_NOTIMPLEMENTED);
 	}
 
@@ -2275,6 +2343,12 @@ load_header(dns_loadctx_t *lctx) {
 
 	switch (header.version) {
 	case 0:
+		if (lctx->format == dns_masterformat_map) {
+			(*callbacks->error)(callbacks, "dns_master_load: "
+						       "unsupported file "
+						       "format version");
+			return (ISC_R_NOTIMPLEMENTED);
+		}
 		remainder = sizeof(header.dumptime);
 		break;
 	case DNS_RAWFORMAT_VERSION:
@@ -2348,6 +2422,15 @@ load_raw(dns_loadctx_t *lctx) {
 		}
 	}
 
+	/*
+	 * A large file is mapped and its RRsets are decoded in parallel.
+	 */
+	if (lctx->map == NULL && map_file(lctx, fileno(lctx->f)) &&
+	    load_raw_parallel(lctx, &result))
+	{
+		return (result);
+	}
+
 	ISC_LIST_INIT(head);
 	ISC_LIST_INIT(dummy);
 
@@ -2615,6 +2698,54 @@ cleanup:
 	return (result);
 }
 
+static isc_result_t
+openfile_map(dns_loadctx_t *lctx, const char *master_file) {
+	return (openfile_raw(lctx, master_file));
+}
+
+/*
+ * A map file is not parsed: once its header has been checked, the file
+ * is handed to the database, which maps the image that follows.
+ */
+static isc_result_t
+load_map(dns_loadctx_t *lctx) {
+	isc_result_t result = ISC_R_SUCCESS;
+	dns_rdatacallbacks_t *callbacks = lctx->callbacks;
+	off_t offset;
+
+	if (lctx->first) {
+		result = load_header(lctx);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+
+	if (callbacks->deserialize == NULL) {
+		(*callbacks->error)(callbacks, "dns_master_load: "
+					       "the database does not support "
+					       "the map format");
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	result = isc_stdio_tell(lctx->f, &offset);
+	if (result == ISC_R_SUCCESS) {
+		offset = (offset + 7) & ~(off_t)7;
+		result = (callbacks->deserialize)(
+			callbacks->deserialize_private, lctx->f, offset);
+	}
+
+	if (result == ISC_R_SUCCESS && callbacks->rawdata != NULL) {
+		(*callbacks->rawdata)(callbacks->zone, &lctx->header);
+	}
+
+	if (result != ISC_R_SUCCESS) {
+		(*callbacks->error)(callbacks, "dns_master_load: %s",
+				    isc_result_totext(result));
+	}
+
+	return (result);
+}
+
 isc_result_t
 dns_master_loadfile(const char *master_file, dns_name_t *top,
 		    dns_name_t *origin, dns_rdataclass_t zclass,
@@ -2892,6 +3023,30 @@ resign_fromlist(dns_rdatalist_t *this, dns_loadctx_t *lctx) {
  * Unlink each element as we go.
  */
 
+static void
+add_error(dns_rdatacallbacks_t *callbacks, const dns_name_t *owner,
+	  const char *source, unsigned int line, isc_result_t result) {
+	char namebuf[DNS_NAME_FORMATSIZE];
+	void (*error)(struct dns_rdatacallbacks *, const char *, ...);
+
+	error = callbacks->error;
+
+	if (result == ISC_R_NOMEMORY) {
+		(*error)(callbacks, "dns_master_load: %s",
+			 isc_result_totext(result));
+	} else {
+		dns_name_format(owner, namebuf, sizeof(namebuf));
+		if (source != NULL) {
+			(*error)(callbacks, "%s: %s:%lu: %s: %s",
+				 "dns_master_load", source, line, namebuf,
+				 isc_result_totext(result));
+		} else {
+			(*error)(callbacks, "%s: %s: %s", "dns_master_load",
+				 namebuf, isc_result_totext(result));
+		}
+	}
+}
+
 static isc_result_t
 commit(dns_rdatacallbacks_t *callbacks, dns_loadctx_t *lctx,
        rdatalist_head_t *head, dns_name_t *owner, const char *source,
@@ -2899,11 +3054,8 @@ commit(dns_rdatacallbacks_t *callbacks, dns_loadctx_t *lctx,
 	dns_rdatalist_t *this;
 	dns_rdataset_t dataset;
 	isc_result_t result;
-	char namebuf[DNS_NAME_FORMATSIZE];
-	void (*error)(struct dns_rdatacallbacks *, const char *, ...);
 
 	this = ISC_LIST_HEAD(*head);
-	error = callbacks->error;
 
 	if (this == NULL) {
 		return (ISC_R_SUCCESS);
@@ -2923,20 +3075,8 @@ commit(dns_rdatacallbacks_t *callbacks, dns_loadctx_t *lctx,
 		}
 		result = ((*callbacks->add)(callbacks->add_private, owner,
 					    &dataset));
-		if (result == ISC_R_NOMEMORY) {
-			(*error)(callbacks, "dns_master_load: %s",
-				 isc_result_totext(result));
-		} else if (result != ISC_R_SUCCESS) {
-			dns_name_format(owner, namebuf, sizeof(namebuf));
-			if (source != NULL) {
-				(*error)(callbacks, "%s: %s:%lu: %s: %s",
-					 "dns_master_load", source, line,
-					 namebuf, isc_result_totext(result));
-			} else {
-				(*error)(callbacks, "%s: %s: %s",
-					 "dns_master_load", namebuf,
-					 isc_result_totext(result));
-			}
+		if (result != ISC_R_SUCCESS) {
+			add_error(callbacks, owner, source, line, result);
 		}
 		if (MANYERRS(lctx, result)) {
 			SETRESULT(lctx, result);
@@ -2987,11 +3127,1428 @@ is_glue(rdatalist_head_t *head, dns_name_t *owner) {
 	return (false);
 }
 
-void
-dns_loadctx_cancel(dns_loadctx_t *lctx) {
-	REQUIRE(DNS_LCTX_VALID(lctx));
+/*
+ * Parallel loading of large text master files.
+ *
+ * A master file that is at least two chunks long is mapped into memory and
+ * split into chunks by a quick scan that only follows lines, comments,
+ * quotes and parentheses, and the $ORIGIN and $TTL directives.  A chunk
+ * starts at a line that begins with an owner name, so it can be parsed by
+ * load_text() on its own, given the origin and default TTL in effect there.
+ * The chunks are parsed by a pool of threads, each with a load context of
+ * its own whose 'callbacks->add' encodes the RRsets into a batch.  The
+ * batches are passed on to the real 'callbacks->add' one chunk at a time, in
+ * file order, so the database sees the RRsets in the same order as it would
+ * if the file were loaded by a single thread.
+ */
 
-	atomic_store_release(&lctx->canceled, true);
+#define PARALLEL_CHUNKSIZE (4 * 1024 * 1024)
+
+/*%
+ * The number of chunks, per thread, that can be parsed ahead of the first
+ * chunk whose batch has not been added yet.  This bounds the memory held by
+ * the batches when a chunk takes longer than the others to parse.
+ */
+#define PARALLEL_WINDOW 4
+
+static atomic_uint_fast32_t parallel_threads = 0;
+static atomic_size_t parallel_chunksize = PARALLEL_CHUNKSIZE;
+
+typedef struct chunk {
+	size_t start;
+	size_t end;
+	unsigned long line;
+	dns_fixedname_t origin;
+	uint32_t ttl;
+
+	isc_buffer_t input;
+	dns_rdatacallbacks_t callbacks;
+	dns_loadctx_t *lctx;
+	isc_result_t result;
+	bool done;
+
+	/* Encoded RRsets waiting to be added */
+	isc_buffer_t *batch;
+	char **sources;
+	unsigned int nsources;
+
+	/* Errors and warnings waiting to be logged */
+	isc_buffer_t *messages;
+} chunk_t;
+
+struct parallel {
+	dns_loadctx_t *lctx;
+	chunk_t *chunks;
+	size_t nchunks;
+	size_t maxchunks;
+	size_t window;
+
+	isc_mutex_t lock;
+	isc_condition_t ready;
+	size_t next;  /*%< the next chunk to be parsed */
+	size_t added; /*%< the chunks before this have been added */
+	bool adding;
+	atomic_size_t failed; /*%< the first chunk that failed */
+
+	/* Used while adding a batch */
+	dns_rdata_t *rdata;
+	unsigned int rdata_size;
+
+	void (*parse)(parallel_t *p, chunk_t *chunk);
+	void (*finish)(parallel_t *p, chunk_t *chunk);
+};
+
+static unsigned int
+parallel_nthreads(void) {
+	unsigned int nthreads = atomic_load_relaxed(&parallel_threads);
+
+	return (nthreads != 0 ? nthreads : isc_os_ncpus());
+}
+
+/*
+ * Map the file open on 'fd' if it is large enough to be split into chunks
+ * and there is more than one thread to parse them.
+ */
+static bool
+map_file(dns_loadctx_t *lctx, int fd) {
+	size_t chunksize = atomic_load_relaxed(&parallel_chunksize);
+	struct stat sb;
+	void *map;
+
+	if (parallel_nthreads() < 2 || fstat(fd, &sb) == -1 ||
+	    !S_ISREG(sb.st_mode) || (uintmax_t)sb.st_size > SIZE_MAX ||
+	    (size_t)sb.st_size / 2 < chunksize)
+	{
+		return (false);
+	}
+
+	map = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		return (false);
+	}
+#if defined(MADV_SEQUENTIAL)
+	(void)madvise(map, (size_t)sb.st_size, MADV_SEQUENTIAL);
+#endif /* if defined(MADV_SEQUENTIAL) */
+
+	lctx->map = map;
+	lctx->mapsize = (size_t)sb.st_size;
+
+	return (true);
+}
+
+/*
+ * Map 'master_file' for load_text_parallel() if it is large enough.
+ * Otherwise, or if it cannot be mapped, it is left to the lexer.
+ */
+static bool
+map_text(dns_loadctx_t *lctx, const char *master_file) {
+	bool mapped;
+	int fd;
+
+	if (parallel_nthreads() < 2) {
+		return (false);
+	}
+
+	fd = open(master_file, O_RDONLY);
+	if (fd == -1) {
+		return (false);
+	}
+	mapped = map_file(lctx, fd);
+	close(fd);
+	if (!mapped) {
+		return (false);
+	}
+
+	lctx->filename = isc_mem_strdup(lctx->mctx, master_file);
+	lctx->load = load_text_parallel;
+
+	return (true);
+}
+
+static bool
+isblank_char(unsigned char c) {
+	return (c == ' ' || c == '\t' || c == '\r');
+}
+
+/*
+ * Copy the token at '*posp' to 'buf', delimited as the lexer would, and
+ * skip the blanks that follow it.  Returns false if there is no token, or
+ * if it does not fit.
+ */
+static bool
+scan_token(const unsigned char *map, size_t size, size_t *posp, char *buf,
+	   size_t buflen) {
+	size_t pos = *posp, len = 0;
+
+	while (pos < size) {
+		unsigned char c = map[pos];
+
+		if (isblank_char(c) || c == '\n' || c == ';' || c == '(' ||
+		    c == ')' || c == '"')
+		{
+			break;
+		}
+		if (c == '\\' && pos + 1 < size) {
+			if (len + 2 >= buflen) {
+				return (false);
+			}
+			buf[len++] = c;
+			c = map[++pos];
+		}
+		if (len + 1 >= buflen) {
+			return (false);
+		}
+		buf[len++] = c;
+		pos++;
+	}
+	buf[len] = '\0';
+
+	while (pos < size && isblank_char(map[pos])) {
+		pos++;
+	}
+	*posp = pos;
+
+	return (len > 0);
+}
+
+static void
+add_chunk(parallel_t *p, size_t start, unsigned long line,
+	  const dns_name_t *origin, uint32_t ttl) {
+	chunk_t *chunk = &p->chunks[p->nchunks++];
+
+	if (p->nchunks > 1) {
+		chunk[-1].end = start;
+	}
+
+	*chunk = (chunk_t){
+		.start = start,
+		.end = start,
+		.line = line,
+		.ttl = ttl,
+		.result = ISC_R_SUCCESS,
+	};
+	dns_name_copy(origin, dns_fixedname_initname(&chunk->origin));
+}
+
+/*
+ * Split the mapped file into chunks of at least 'chunksize' bytes.  A
+ * chunk can start at a line that begins with an owner name, once the
+ * default TTL is known from a $TTL directive: that is the only TTL state
+ * that carries over from one record to the next.  An included file can
+ * have a $TTL of its own, so the file is not split again after $INCLUDE
+ * until the next $TTL, nor at all after $DATE.
+ */
+static void
+split_text(parallel_t *p, size_t chunksize) {
+	dns_loadctx_t *lctx = p->lctx;
+	const unsigned char *map = lctx->map;
+	size_t size = lctx->mapsize, pos = 0, next = chunksize;
+	unsigned long line = 1;
+	bool ttl_known = lctx->default_ttl_known;
+	uint32_t ttl = lctx->default_ttl;
+	dns_fixedname_t forigin, fname;
+	dns_name_t *origin = dns_fixedname_initname(&forigin);
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	char buf[DNS_NAME_MAXTEXT + 1];
+
+	p->maxchunks = size / chunksize + 1;
+	p->chunks = isc_mem_get(lctx->mctx,
+				p->maxchunks * sizeof(p->chunks[0]));
+
+	dns_name_copy(lctx->inc->origin, origin);
+	add_chunk(p, 0, line, origin, ttl);
+
+	while (pos < size) {
+		unsigned char c = map[pos];
+		unsigned int depth = 0;
+		bool quoted = false;
+
+		if (c == '$') {
+			isc_result_t result = ISC_R_FAILURE;
+			isc_textregion_t tr;
+			isc_buffer_t b;
+
+			if (!scan_token(map, size, &pos, buf, sizeof(buf))) {
+				break;
+			} else if (strcasecmp(buf, "$ORIGIN") == 0) {
+				if (scan_token(map, size, &pos, buf,
+					       sizeof(buf)))
+				{
+					isc_buffer_constinit(&b, buf,
+							     strlen(buf));
+					isc_buffer_add(&b, strlen(buf));
+					result = dns_name_fromtext(
+						name, &b, origin, 0, NULL);
+				}
+				if (result != ISC_R_SUCCESS) {
+					break;
+				}
+				dns_name_copy(name, origin);
+			} else if (strcasecmp(buf, "$TTL") == 0) {
+				if (scan_token(map, size, &pos, buf,
+					       sizeof(buf)))
+				{
+					tr.base = buf;
+					tr.length = strlen(buf);
+					result = dns_ttl_fromtext(&tr, &ttl);
+				}
+				ttl_known = (result == ISC_R_SUCCESS);
+				if (ttl > 0x7fffffffUL) {
+					ttl = 0;
+				}
+			} else if (strcasecmp(buf, "$INCLUDE") == 0) {
+				ttl_known = false;
+			} else if (strcasecmp(buf, "$DATE") == 0) {
+				break;
+			}
+		} else if (pos >= next && ttl_known && !isblank_char(c) &&
+			   c != '\n' && c != ';' && c != '(' && c != ')')
+		{
+			add_chunk(p, pos, line, origin, ttl);
+			next = pos + chunksize;
+		}
+
+		/*
+		 * Skip to the start of the next line, which may be several
+		 * lines down if there are parentheses.
+		 */
+		while (pos < size) {
+			c = map[pos++];
+			if (c == '\n') {
+				line++;
+				quoted = false;
+				if (depth == 0) {
+					break;
+				}
+			} else if (c == '\\') {
+				if (pos < size && map[pos] != '\n') {
+					pos++;
+				}
+			} else if (quoted) {
+				if (c == '"') {
+					quoted = false;
+				}
+			} else if (c == '"') {
+				quoted = true;
+			} else if (c == '(') {
+				depth++;
+			} else if (c == ')') {
+				if (depth > 0) {
+					depth--;
+				}
+			} else if (c == ';') {
+				while (pos < size && map[pos] != '\n') {
+					pos++;
+				}
+			}
+		}
+	}
+
+	p->chunks[p->nchunks - 1].end = size;
+}
+
+/*
+ * A chunk stops being parsed when the load is canceled, or when an earlier
+ * chunk has failed.
+ */
+static bool
+parallel_canceled(parallel_t *p, size_t i) {
+	return (atomic_load_acquire(&p->lctx->canceled) ||
+		atomic_load_acquire(&p->failed) < i);
+}
+
+static bool
+chunk_canceled(dns_loadctx_t *lctx) {
+	return (parallel_canceled(lctx->parallel, lctx->chunk));
+}
+
+/*
+ * Whether 'result' stops the load.  Errors in a text file do not when
+ * DNS_MASTER_MANYERRORS is set, but errors in a raw file always do.
+ */
+static bool
+chunk_failed(parallel_t *p, isc_result_t result) {
+	return (result != ISC_R_SUCCESS && result != DNS_R_SEENINCLUDE &&
+		(p->lctx->format != dns_masterformat_text ||
+		 (p->lctx->options & DNS_MASTER_MANYERRORS) == 0));
+}
+
+static void
+chunk_fail(parallel_t *p, chunk_t *chunk) {
+	size_t i = chunk - p->chunks;
+	size_t failed = atomic_load_acquire(&p->failed);
+
+	while (i < failed &&
+	       !atomic_compare_exchange_weak_acq_rel(&p->failed, &failed, i))
+	{
+	}
+}
+
+static void
+parallel_include(const char *filename, void *arg) {
+	parallel_t *p = arg;
+
+	LOCK(&p->lock);
+	(p->lctx->include_cb)(filename, p->lctx->include_arg);
+	UNLOCK(&p->lock);
+}
+
+/*
+ * The errors and warnings of a chunk are kept until the chunk is added, so
+ * that they are logged in file order.
+ */
+static void
+chunk_message(dns_rdatacallbacks_t *callbacks, bool error, const char *fmt,
+	      va_list ap) {
+	chunk_t *chunk = callbacks->add_private;
+	char buf[4096];
+	int n;
+
+	n = vsnprintf(buf, sizeof(buf), fmt, ap);
+	n = ISC_MIN(n, (int)sizeof(buf) - 1);
+	isc_buffer_putuint8(chunk->messages, error);
+	isc_buffer_putmem(chunk->messages, (unsigned char *)buf, n + 1);
+}
+
+static void
+chunk_error(dns_rdatacallbacks_t *callbacks, const char *fmt, ...) {
+	va_list ap;
+
+	va_start(ap, fmt);
+	chunk_message(callbacks, true, fmt, ap);
+	va_end(ap);
+}
+
+static void
+chunk_warn(dns_rdatacallbacks_t *callbacks, const char *fmt, ...) {
+	va_list ap;
+
+	va_start(ap, fmt);
+	chunk_message(callbacks, false, fmt, ap);
+	va_end(ap);
+}
+
+static void
+log_messages(parallel_t *p, chunk_t *chunk) {
+	dns_rdatacallbacks_t *callbacks = p->lctx->callbacks;
+	isc_buffer_t *messages = chunk->messages;
+
+	while (isc_buffer_remaininglength(messages) > 0) {
+		bool error = isc_buffer_getuint8(messages);
+		const char *message = isc_buffer_current(messages);
+
+		if (error) {
+			(*callbacks->error)(callbacks, "%s", message);
+		} else {
+			(*callbacks->warn)(callbacks, "%s", message);
+		}
+		isc_buffer_forward(messages, strlen(message) + 1);
+	}
+}
+
+/*
+ * The 'callbacks->add' of a chunk: append the RRset to the chunk's batch,
+ * with the file and line that commit() would report an error at.
+ */
+static isc_result_t
+batch_add(void *arg, const dns_name_t *owner, dns_rdataset_t *dataset) {
+	chunk_t *chunk = arg;
+	dns_loadctx_t *lctx = chunk->lctx;
+	dns_incctx_t *ictx = lctx->inc;
+	isc_buffer_t *batch = chunk->batch;
+	const char *source = isc_lex_getsourcename(lctx->lex);
+	isc_result_t result;
+	isc_region_t r;
+
+	if (chunk->nsources == 0 ||
+	    strcmp(chunk->sources[chunk->nsources - 1], source) != 0)
+	{
+		chunk->sources = isc_mem_reget(
+			lctx->mctx, chunk->sources,
+			chunk->nsources * sizeof(chunk->sources[0]),
+			(chunk->nsources + 1) * sizeof(chunk->sources[0]));
+		chunk->sources[chunk->nsources++] =
+			isc_mem_strdup(lctx->mctx, source);
+	}
+
+	isc_buffer_putuint32(batch, chunk->nsources - 1);
+	isc_buffer_putuint32(batch, (owner == ictx->glue) ? ictx->glue_line
+							  : ictx->current_line);
+	dns_name_toregion(owner, &r);
+	isc_buffer_putuint8(batch, r.length);
+	isc_buffer_putmem(batch, r.base, r.length);
+	isc_buffer_putuint16(batch, dataset->type);
+	isc_buffer_putuint16(batch, dataset->covers);
+	isc_buffer_putuint32(batch, dataset->ttl);
+	isc_buffer_putuint8(batch, (dataset->attributes &
+				    DNS_RDATASETATTR_RESIGN) != 0);
+	isc_buffer_putuint32(batch, dataset->resign);
+	isc_buffer_putuint32(batch, dns_rdataset_count(dataset));
+
+	for (result = dns_rdataset_first(dataset); result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(dataset))
+	{
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+
+		dns_rdataset_current(dataset, &rdata);
+		isc_buffer_putuint16(batch, rdata.length);
+		isc_buffer_putmem(batch, rdata.data, rdata.length);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Pass the RRsets in the batch of 'chunk' on to the real 'callbacks->add'.
+ */
+static isc_result_t
+add_batch(parallel_t *p, chunk_t *chunk) {
+	dns_loadctx_t *lctx = chunk->lctx;
+	dns_rdatacallbacks_t *callbacks = p->lctx->callbacks;
+	isc_buffer_t *batch = chunk->batch;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	while (isc_buffer_remaininglength(batch) > 0) {
+		dns_rdatalist_t rdatalist;
+		dns_rdataset_t dataset;
+		dns_rdata_t *rdata = NULL;
+		dns_name_t owner;
+		const char *source;
+		unsigned int line, count;
+		bool resign;
+		isc_region_t r;
+
+		source = chunk->sources[isc_buffer_getuint32(batch)];
+		line = isc_buffer_getuint32(batch);
+		dns_name_init(&owner, NULL);
+		r.length = isc_buffer_getuint8(batch);
+		r.base = isc_buffer_current(batch);
+		dns_name_fromregion(&owner, &r);
+		isc_buffer_forward(batch, r.length);
+
+		dns_rdatalist_init(&rdatalist);
+		rdatalist.rdclass = lctx->zclass;
+		rdatalist.type = isc_buffer_getuint16(batch);
+		rdatalist.covers = isc_buffer_getuint16(batch);
+		rdatalist.ttl = isc_buffer_getuint32(batch);
+		resign = isc_buffer_getuint8(batch);
+		dns_rdataset_init(&dataset);
+		dataset.resign = isc_buffer_getuint32(batch);
+		count = isc_buffer_getuint32(batch);
+
+		if (count > p->rdata_size) {
+			p->rdata = isc_mem_reget(
+				lctx->mctx, p->rdata,
+				p->rdata_size * sizeof(p->rdata[0]),
+				count * sizeof(p->rdata[0]));
+			p->rdata_size = count;
+		}
+		for (unsigned int i = 0; i < count; i++) {
+			rdata = &p->rdata[i];
+			dns_rdata_init(rdata);
+			r.length = isc_buffer_getuint16(batch);
+			r.base = isc_buffer_current(batch);
+			dns_rdata_fromregion(rdata, rdatalist.rdclass,
+					     rdatalist.type, &r);
+			isc_buffer_forward(batch, r.length);
+			ISC_LIST_APPEND(rdatalist.rdata, rdata, link);
+		}
+
+		dns_rdatalist_tordataset(&rdatalist, &dataset);
+		dataset.trust = dns_trust_ultimate;
+		if (resign) {
+			dataset.attributes |= DNS_RDATASETATTR_RESIGN;
+		}
+		result = (*callbacks->add)(callbacks->add_private, &owner,
+					   &dataset);
+		dns_rdataset_disassociate(&dataset);
+		if (result != ISC_R_SUCCESS) {
+			add_error(callbacks, &owner, source, line, result);
+		}
+		if (MANYERRS(lctx, result)) {
+			SETRESULT(lctx, result);
+		} else if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+
+	return (result);
+}
+
+static void
+parse_chunk(parallel_t *p, chunk_t *chunk) {
+	dns_loadctx_t *parent = p->lctx;
+	dns_loadctx_t *lctx = NULL;
+	size_t length = chunk->end - chunk->start;
+
+	chunk->callbacks = *parent->callbacks;
+	chunk->callbacks.add = batch_add;
+	chunk->callbacks.add_private = chunk;
+	chunk->callbacks.error = chunk_error;
+	chunk->callbacks.warn = chunk_warn;
+
+	loadctx_create(dns_masterformat_text, parent->mctx, parent->options,
+		       parent->resign, parent->top, parent->zclass,
+		       dns_fixedname_name(&chunk->origin), &chunk->callbacks,
+		       NULL, NULL,
+		       parent->include_cb != NULL ? parallel_include : NULL, p,
+		       NULL, &lctx);
+	lctx->maxttl = parent->maxttl;
+	lctx->now = parent->now;
+	lctx->parallel = p;
+	lctx->chunk = chunk - p->chunks;
+	if (chunk->start != 0) {
+		lctx->ttl_known = true;
+		lctx->default_ttl_known = true;
+		lctx->ttl = chunk->ttl;
+		lctx->default_ttl = chunk->ttl;
+	}
+	chunk->lctx = lctx;
+
+	isc_buffer_allocate(parent->mctx, &chunk->batch,
+			    ISC_MIN(length, PARALLEL_CHUNKSIZE));
+	isc_buffer_allocate(parent->mctx, &chunk->messages, 1024);
+
+	isc_buffer_constinit(&chunk->input, parent->map + chunk->start, length);
+	isc_buffer_add(&chunk->input, length);
+	RUNTIME_CHECK(isc_lex_openbuffer(lctx->lex, &chunk->input) ==
+		      ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_lex_setsourcename(lctx->lex, parent->filename) ==
+		      ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_lex_setsourceline(lctx->lex, chunk->line) ==
+		      ISC_R_SUCCESS);
+
+	chunk->result = load_text(lctx);
+}
+
+/*
+ * Add the batch of 'chunk' unless the load has failed or been canceled,
+ * then free the chunk's resources.
+ */
+static void
+finish_chunk(parallel_t *p, chunk_t *chunk) {
+	dns_loadctx_t *lctx = chunk->lctx;
+	isc_mem_t *mctx = p->lctx->mctx;
+
+	if (!chunk_canceled(lctx)) {
+		log_messages(p, chunk);
+	}
+
+	if (chunk_failed(p, chunk->result)) {
+		/* Nothing to add */
+	} else if (chunk_canceled(lctx)) {
+		chunk->result = ISC_R_CANCELED;
+	} else {
+		isc_result_t result = add_batch(p, chunk);
+		if (chunk_failed(p, result)) {
+			chunk->result = result;
+			chunk_fail(p, chunk);
+		} else if (lctx->result != ISC_R_SUCCESS &&
+			   (chunk->result == ISC_R_SUCCESS ||
+			    chunk->result == DNS_R_SEENINCLUDE))
+		{
+			chunk->result = lctx->result;
+		}
+	}
+
+	isc_buffer_free(&chunk->batch);
+	isc_buffer_free(&chunk->messages);
+	for (unsigned int j = 0; j < chunk->nsources; j++) {
+		isc_mem_free(mctx, chunk->sources[j]);
+	}
+	if (chunk->sources != NULL) {
+		isc_mem_put(mctx, chunk->sources,
+			    chunk->nsources * sizeof(chunk->sources[0]));
+	}
+	dns_loadctx_detach(&chunk->lctx);
+}
+
+static isc_threadresult_t
+parallel_worker(isc_threadarg_t arg) {
+	parallel_t *p = arg;
+
+	LOCK(&p->lock);
+	while (p->next < p->nchunks &&
+	       atomic_load_acquire(&p->failed) == SIZE_MAX &&
+	       !atomic_load_acquire(&p->lctx->canceled))
+	{
+		chunk_t *chunk = NULL;
+
+		if (p->next >= p->added + p->window) {
+			WAIT(&p->ready, &p->lock);
+			continue;
+		}
+
+		chunk = &p->chunks[p->next++];
+		UNLOCK(&p->lock);
+
+		(p->parse)(p, chunk);
+
+		LOCK(&p->lock);
+		chunk->done = true;
+		if (chunk_failed(p, chunk->result)) {
+			chunk_fail(p, chunk);
+			BROADCAST(&p->ready);
+		}
+
+		/*
+		 * Whoever completes the chunks that are next in line adds
+		 * them, in order, without holding the lock.
+		 */
+		if (p->adding) {
+			continue;
+		}
+		p->adding = true;
+		while (p->added < p->nchunks && p->chunks[p->added].done) {
+			chunk = &p->chunks[p->added];
+			UNLOCK(&p->lock);
+			(p->finish)(p, chunk);
+			LOCK(&p->lock);
+			p->added++;
+			BROADCAST(&p->ready);
+		}
+		p->adding = false;
+	}
+	UNLOCK(&p->lock);
+
+	return ((isc_threadresult_t)0);
+}
+
+/*
+ * Parse the chunks of 'p' with up to 'parallel_nthreads()' threads, and
+ * free them.  The result is that of the first chunk that did not load
+ * successfully, as if the file had been loaded in one piece.
+ */
+static isc_result_t
+run_parallel(parallel_t *p) {
+	isc_mem_t *mctx = p->lctx->mctx;
+	unsigned int nthreads = ISC_MIN(parallel_nthreads(), p->nchunks);
+	isc_thread_t *threads = NULL;
+	isc_result_t result = ISC_R_SUCCESS;
+	size_t i;
+
+	p->window = nthreads * PARALLEL_WINDOW;
+	isc_mutex_init(&p->lock);
+	isc_condition_init(&p->ready);
+
+	/* The calling thread is one of the workers. */
+	threads = isc_mem_get(mctx, nthreads * sizeof(threads[0]));
+	for (i = 1; i < nthreads; i++) {
+		isc_thread_create(parallel_worker, p, &threads[i]);
+	}
+	parallel_worker(p);
+	for (i = 1; i < nthreads; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+	isc_mem_put(mctx, threads, nthreads * sizeof(threads[0]));
+
+	for (i = 0; i < p->nchunks; i++) {
+		if (p->chunks[i].result == DNS_R_SEENINCLUDE) {
+			result = DNS_R_SEENINCLUDE;
+		} else if (p->chunks[i].result != ISC_R_SUCCESS) {
+			result = p->chunks[i].result;
+			break;
+		}
+	}
+	if (i == p->nchunks && p->added < p->nchunks) {
+		result = ISC_R_CANCELED;
+	}
+
+	isc_condition_destroy(&p->ready);
+	isc_mutex_destroy(&p->lock);
+	if (p->rdata != NULL) {
+		isc_mem_put(mctx, p->rdata, p->rdata_size * sizeof(p->rdata[0]));
+	}
+	isc_mem_put(mctx, p->chunks, p->maxchunks * sizeof(p->chunks[0]));
+
+	return (result);
+}
+
+static isc_result_t
+load_text_parallel(dns_loadctx_t *lctx) {
+	dns_rdatacallbacks_t *callbacks = lctx->callbacks;
+	size_t chunksize = atomic_load_relaxed(&parallel_chunksize);
+	isc_result_t result = ISC_R_SUCCESS;
+	parallel_t p = { .lctx = lctx };
+	size_t i;
+
+	REQUIRE(DNS_LCTX_VALID(lctx));
+
+	atomic_init(&p.failed, SIZE_MAX);
+	split_text(&p, chunksize);
+
+	for (i = 0; i < p.nchunks; i++) {
+		if (p.chunks[i].end - p.chunks[i].start > UINT_MAX) {
+			break;
+		}
+	}
+	if (p.nchunks == 1 || i < p.nchunks) {
+		/*
+		 * The file could not be split usefully, so load it with
+		 * the lexer after all.
+		 */
+		isc_mem_put(lctx->mctx, p.chunks,
+			    p.maxchunks * sizeof(p.chunks[0]));
+		munmap(lctx->map, lctx->mapsize);
+		lctx->map = NULL;
+		lctx->load = load_text;
+
+		result = isc_lex_openfile(lctx->lex, lctx->filename);
+		if (result != ISC_R_SUCCESS) {
+			(*callbacks->error)(callbacks, "dns_master_load: %s: %s",
+					    lctx->filename,
+					    isc_result_totext(result));
+			return (result);
+		}
+		return (load_text(lctx));
+	}
+
+	p.parse = parse_chunk;
+	p.finish = finish_chunk;
+	result = run_parallel(&p);
+	if (result == ISC_R_CANCELED) {
+		(*callbacks->error)(callbacks, "dns_master_load: %s: %s",
+				    lctx->filename, isc_result_totext(result));
+	}
+
+	return (result);
+}
+
+/*
+ * Parallel loading of large raw master files.
+ *
+ * Every RRset in a raw file starts with its total length, so the file can
+ * be split into chunks at RRset boundaries by hopping from one length to
+ * the next.  The threads validate and decode the RRsets of the chunks, the
+ * same way load_raw() does; the RRsets are then committed from the mapped
+ * file, one chunk at a time and in file order.
+ */
+
+#define RAW_MINLEN                                                     \
+	(sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint16_t) +      \
+	 sizeof(uint16_t) + sizeof(uint32_t) + sizeof(uint32_t))
+
+/*
+ * Split the records that follow the header at 'offset' into chunks of at
+ * least 'chunksize' bytes.  Splitting stops at a malformed length, which
+ * is then left to the last chunk to report.
+ */
+static void
+split_raw(parallel_t *p, size_t offset, size_t chunksize) {
+	dns_loadctx_t *lctx = p->lctx;
+	const unsigned char *map = lctx->map;
+	size_t size = lctx->mapsize, pos = offset;
+
+	p->maxchunks = (size - offset) / chunksize + 1;
+	p->chunks = isc_mem_get(lctx->mctx,
+				p->maxchunks * sizeof(p->chunks[0]));
+
+	add_chunk(p, pos, 0, dns_rootname, 0);
+
+	while (size - pos >= sizeof(uint32_t)) {
+		uint32_t totallen = ISC_U8TO32_BE(map + pos);
+
+		if (totallen < RAW_MINLEN || totallen > size - pos) {
+			break;
+		}
+		pos += totallen;
+		if (pos - p->chunks[p->nchunks - 1].start >= chunksize &&
+		    pos < size)
+		{
+			add_chunk(p, pos, 0, dns_rootname, 0);
+		}
+	}
+
+	p->chunks[p->nchunks - 1].end = size;
+}
+
+/*
+ * Check the RRset in 'source' as load_raw() would, decoding its rdata
+ * into 'scratch'.
+ */
+static isc_result_t
+check_raw_rrset(chunk_t *chunk, isc_buffer_t *source, unsigned char *scratch) {
+	dns_loadctx_t *lctx = chunk->lctx;
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_rdataclass_t rdclass;
+	dns_rdatatype_t type;
+	unsigned int rdcount;
+	uint32_t ttl;
+	uint16_t namelen;
+	isc_result_t result;
+
+	rdclass = isc_buffer_getuint16(source);
+	if (lctx->zclass != rdclass) {
+		return (DNS_R_BADCLASS);
+	}
+	type = isc_buffer_getuint16(source);
+	(void)isc_buffer_getuint16(source);
+	ttl = isc_buffer_getuint32(source);
+	rdcount = isc_buffer_getuint32(source);
+	if (rdcount == 0 || rdcount > 0xffff) {
+		return (ISC_R_RANGE);
+	}
+
+	if (isc_buffer_remaininglength(source) < sizeof(namelen)) {
+		return (ISC_R_RANGE);
+	}
+	namelen = isc_buffer_getuint16(source);
+	if (namelen > DNS_NAME_MAXWIRE ||
+	    isc_buffer_remaininglength(source) < namelen)
+	{
+		return (ISC_R_RANGE);
+	}
+	isc_buffer_setactive(source, (unsigned int)namelen);
+	result = dns_name_fromwire(name, source, DNS_DECOMPRESS_NEVER, 0, NULL);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	if ((lctx->options & DNS_MASTER_CHECKTTL) != 0 && ttl > lctx->maxttl) {
+		(*chunk->callbacks.error)(&chunk->callbacks,
+					  "dns_master_load: "
+					  "TTL %d exceeds configured "
+					  "max-zone-ttl %d",
+					  ttl, lctx->maxttl);
+		return (ISC_R_RANGE);
+	}
+
+	for (unsigned int i = 0; i < rdcount; i++) {
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		isc_buffer_t target;
+		uint16_t rdlen;
+
+		if (isc_buffer_remaininglength(source) < sizeof(rdlen)) {
+			return (ISC_R_RANGE);
+		}
+		rdlen = isc_buffer_getuint16(source);
+		if (isc_buffer_remaininglength(source) < rdlen) {
+			return (ISC_R_RANGE);
+		}
+		isc_buffer_setactive(source, (unsigned int)rdlen);
+		isc_buffer_init(&target, scratch, (unsigned int)rdlen);
+		result = dns_rdata_fromwire(&rdata, rdclass, type, source,
+					    DNS_DECOMPRESS_NEVER, 0, &target);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+
+	if (isc_buffer_remaininglength(source) != 0) {
+		return (ISC_R_RANGE);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+parse_raw_chunk(parallel_t *p, chunk_t *chunk) {
+	dns_loadctx_t *lctx = p->lctx;
+	const unsigned char *map = lctx->map;
+	size_t pos = chunk->start;
+	unsigned char *scratch = NULL;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	chunk->callbacks = *lctx->callbacks;
+	chunk->callbacks.add_private = chunk;
+	chunk->callbacks.error = chunk_error;
+	chunk->callbacks.warn = chunk_warn;
+	chunk->lctx = lctx;
+
+	isc_buffer_allocate(lctx->mctx, &chunk->messages, 256);
+	scratch = isc_mem_get(lctx->mctx, UINT16_MAX);
+
+	while (chunk->end - pos >= sizeof(uint32_t)) {
+		uint32_t totallen = ISC_U8TO32_BE(map + pos);
+		isc_buffer_t source;
+
+		if (parallel_canceled(p, chunk - p->chunks)) {
+			result = ISC_R_CANCELED;
+			break;
+		}
+		if (totallen < RAW_MINLEN) {
+			result = ISC_R_RANGE;
+			break;
+		}
+		if (totallen > chunk->end - pos) {
+			result = ISC_R_EOF;
+			break;
+		}
+
+		isc_buffer_constinit(&source, map + pos + sizeof(totallen),
+				     totallen - sizeof(totallen));
+		isc_buffer_add(&source, totallen - sizeof(totallen));
+		result = check_raw_rrset(chunk, &source, scratch);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+		pos += totallen;
+	}
+
+	isc_mem_put(lctx->mctx, scratch, UINT16_MAX);
+	chunk->result = result;
+}
+
+/*
+ * Commit the RRsets of 'chunk', which have been checked already, straight
+ * from the mapped file.
+ */
+static isc_result_t
+commit_raw_chunk(parallel_t *p, chunk_t *chunk) {
+	dns_loadctx_t *lctx = p->lctx;
+	const unsigned char *map = lctx->map;
+	size_t pos = chunk->start;
+	rdatalist_head_t head;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	ISC_LIST_INIT(head);
+
+	while (chunk->end - pos >= sizeof(uint32_t)) {
+		uint32_t totallen = ISC_U8TO32_BE(map + pos);
+		dns_fixedname_t fixed;
+		dns_name_t *name = dns_fixedname_initname(&fixed);
+		dns_rdatalist_t rdatalist;
+		unsigned int rdcount;
+		isc_buffer_t source;
+
+		isc_buffer_constinit(&source, map + pos + sizeof(totallen),
+				     totallen - sizeof(totallen));
+		isc_buffer_add(&source, totallen - sizeof(totallen));
+		pos += totallen;
+
+		dns_rdatalist_init(&rdatalist);
+		rdatalist.rdclass = isc_buffer_getuint16(&source);
+		rdatalist.type = isc_buffer_getuint16(&source);
+		rdatalist.covers = isc_buffer_getuint16(&source);
+		rdatalist.ttl = isc_buffer_getuint32(&source);
+		rdcount = isc_buffer_getuint32(&source);
+
+		isc_buffer_setactive(&source, isc_buffer_getuint16(&source));
+		RUNTIME_CHECK(dns_name_fromwire(name, &source,
+						DNS_DECOMPRESS_NEVER, 0,
+						NULL) == ISC_R_SUCCESS);
+
+		if (rdcount > p->rdata_size) {
+			p->rdata = isc_mem_reget(
+				lctx->mctx, p->rdata,
+				p->rdata_size * sizeof(p->rdata[0]),
+				rdcount * sizeof(p->rdata[0]));
+			p->rdata_size = rdcount;
+		}
+		for (unsigned int i = 0; i < rdcount; i++) {
+			dns_rdata_t *rdata = &p->rdata[i];
+			isc_region_t r;
+
+			dns_rdata_init(rdata);
+			r.length = isc_buffer_getuint16(&source);
+			r.base = isc_buffer_current(&source);
+			dns_rdata_fromregion(rdata, rdatalist.rdclass,
+					     rdatalist.type, &r);
+			isc_buffer_forward(&source, r.length);
+			ISC_LIST_APPEND(rdatalist.rdata, rdata, link);
+		}
+
+		ISC_LIST_APPEND(head, &rdatalist, link);
+		result = commit(lctx->callbacks, lctx, &head, name, NULL, 0);
+		for (unsigned int i = 0; i < rdcount; i++) {
+			ISC_LIST_UNLINK(rdatalist.rdata, &p->rdata[i], link);
+		}
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+
+	return (result);
+}
+
+static void
+finish_raw_chunk(parallel_t *p, chunk_t *chunk) {
+	size_t i = chunk - p->chunks;
+
+	if (!parallel_canceled(p, i)) {
+		log_messages(p, chunk);
+	}
+
+	if (chunk_failed(p, chunk->result)) {
+		/* Nothing to commit */
+	} else if (parallel_canceled(p, i)) {
+		chunk->result = ISC_R_CANCELED;
+	} else {
+		isc_result_t result = commit_raw_chunk(p, chunk);
+		if (result != ISC_R_SUCCESS) {
+			chunk->result = result;
+			chunk_fail(p, chunk);
+		}
+	}
+
+	isc_buffer_free(&chunk->messages);
+	chunk->lctx = NULL;
+}
+
+/*
+ * Load the mapped raw file in parallel.  Returns false, having unmapped the
+ * file, if it cannot be split usefully.
+ */
+static bool
+load_raw_parallel(dns_loadctx_t *lctx, isc_result_t *resultp) {
+	dns_rdatacallbacks_t *callbacks = lctx->callbacks;
+	size_t chunksize = atomic_load_relaxed(&parallel_chunksize);
+	isc_result_t result;
+	parallel_t p = { .lctx = lctx };
+	off_t offset;
+
+	REQUIRE(DNS_LCTX_VALID(lctx));
+
+	result = isc_stdio_tell(lctx->f, &offset);
+	if (result != ISC_R_SUCCESS || (uintmax_t)offset > lctx->mapsize) {
+		goto fallback;
+	}
+
+	atomic_init(&p.failed, SIZE_MAX);
+	split_raw(&p, (size_t)offset, chunksize);
+	if (p.nchunks == 1) {
+		isc_mem_put(lctx->mctx, p.chunks,
+			    p.maxchunks * sizeof(p.chunks[0]));
+		goto fallback;
+	}
+
+	p.parse = parse_raw_chunk;
+	p.finish = finish_raw_chunk;
+	result = run_parallel(&p);
+
+	if (result == ISC_R_SUCCESS && lctx->result != ISC_R_SUCCESS) {
+		result = lctx->result;
+	}
+	if (result == ISC_R_SUCCESS && callbacks->rawdata != NULL) {
+		(*callbacks->rawdata)(callbacks->zone, &lctx->header);
+	}
+	if (result != ISC_R_SUCCESS) {
+		(*callbacks->error)(callbacks, "dns_master_load: %s",
+				    isc_result_totext(result));
+	}
+
+	*resultp = result;
+	return (true);
+
+fallback:
+	munmap(lctx->map, lctx->mapsize);
+	lctx->map = NULL;
+	return (false);
+}
+
+void
+dns_master_setparallel(unsigned int nthreads, size_t chunksize) {
+	REQUIRE(chunksize <= UINT_MAX);
+
+	atomic_store_relaxed(&parallel_threads, nthreads);
+	atomic_store_relaxed(&parallel_chunksize,
+			     chunksize != 0 ? chunksize : PARALLEL_CHUNKSIZE);
+}
+
+void
+dns_loadctx_cancel(dns_loadctx_t *lctx) {
+	REQUIRE(DNS_LCTX_VALID(lctx));
+
+	atomic_store_release(&lctx->canceled, true);
+}
+
+/*
+ * Read one RRset of a cache snapshot from 'source', and pass it on to
+ * 'callbacks->add' unless it has expired.
+ */
+static isc_result_t
+load_cache_rdataset(isc_buffer_t *source, dns_rdataclass_t zclass,
+		    isc_stdtime_t now, dns_ttl_t maxttl,
+		    dns_rdatacallbacks_t *callbacks, isc_mem_t *mctx,
+		    isc_buffer_t *target, dns_rdata_t **rdatap,
+		    unsigned int *rdata_sizep) {
+	isc_result_t result;
+	isc_buffer_t rrset;
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_rdata_t *rdata = NULL;
+	uint32_t totallen, expire, rdcount;
+	uint16_t trust, attributes, namelen;
+	unsigned int i;
+
+	/*
+	 * The input data must at least contain the common header.
+	 */
+	if (isc_buffer_remaininglength(source) < sizeof(totallen)) {
+		return (ISC_R_UNEXPECTEDEND);
+	}
+	totallen = isc_buffer_getuint32(source);
+	if (totallen < sizeof(totallen) + 3 * sizeof(uint16_t) +
+			       2 * sizeof(uint32_t) + 2 * sizeof(uint16_t))
+	{
+		return (ISC_R_RANGE);
+	}
+	totallen -= sizeof(totallen);
+	if (totallen > isc_buffer_remaininglength(source)) {
+		return (ISC_R_UNEXPECTEDEND);
+	}
+	isc_buffer_constinit(&rrset, isc_buffer_current(source), totallen);
+	isc_buffer_add(&rrset, totallen);
+	isc_buffer_forward(source, totallen);
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = isc_buffer_getuint16(&rrset);
+	if (rdatalist.rdclass != zclass) {
+		return (DNS_R_BADCLASS);
+	}
+	rdatalist.type = isc_buffer_getuint16(&rrset);
+	rdatalist.covers = isc_buffer_getuint16(&rrset);
+	expire = isc_buffer_getuint32(&rrset);
+	rdcount = isc_buffer_getuint32(&rrset);
+	trust = isc_buffer_getuint16(&rrset);
+	attributes = isc_buffer_getuint16(&rrset);
+	if (rdcount == 0 || rdcount > 0xffff) {
+		return (ISC_R_RANGE);
+	}
+
+	/*
+	 * Nothing in a cache is trusted like zone data, and a negative
+	 * cache entry, and only such an entry, has type 0.
+	 */
+	if (trust == dns_trust_none || trust > dns_trust_secure) {
+		return (ISC_R_RANGE);
+	}
+	if ((attributes &
+	     ~(DNS_MASTERRAW_ATTR_NEGATIVE | DNS_MASTERRAW_ATTR_NXDOMAIN |
+	       DNS_MASTERRAW_ATTR_OPTOUT | DNS_MASTERRAW_ATTR_PREFETCH)) != 0)
+	{
+		return (ISC_R_RANGE);
+	}
+	if ((rdatalist.type == 0) !=
+	    ((attributes & DNS_MASTERRAW_ATTR_NEGATIVE) != 0))
+	{
+		return (DNS_R_FORMERR);
+	}
+
+	/* Drop it if it has expired */
+	if (expire <= now) {
+		return (ISC_R_SUCCESS);
+	}
+
+	/*
+	 * A TTL can't be longer than RFC 2181 allows, and is capped at
+	 * 'maxttl' like one received from an authoritative server.
+	 */
+	if (expire - now > 0x7fffffffU) {
+		return (ISC_R_RANGE);
+	}
+	rdatalist.ttl = expire - now;
+	if (maxttl != 0 && rdatalist.ttl > maxttl) {
+		rdatalist.ttl = maxttl;
+	}
+
+	/* Owner name: length followed by name */
+	if (isc_buffer_remaininglength(&rrset) < sizeof(namelen)) {
+		return (ISC_R_RANGE);
+	}
+	namelen = isc_buffer_getuint16(&rrset);
+	if (namelen > isc_buffer_remaininglength(&rrset)) {
+		return (ISC_R_RANGE);
+	}
+	isc_buffer_setactive(&rrset, namelen);
+	result = dns_name_fromwire(name, &rrset, DNS_DECOMPRESS_NEVER, 0, NULL);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	/*
+	 * The rdata can take no more room in the target buffer than they
+	 * do in the file.
+	 */
+	if (rdcount > *rdata_sizep) {
+		if (*rdatap != NULL) {
+			isc_mem_put(mctx, *rdatap,
+				    *rdata_sizep * sizeof(**rdatap));
+		}
+		*rdata_sizep = rdcount + RDSZ;
+		*rdatap = isc_mem_get(mctx, *rdata_sizep * sizeof(**rdatap));
+	}
+	rdata = *rdatap;
+	if (isc_buffer_remaininglength(&rrset) > target->length) {
+		unsigned int length = isc_buffer_remaininglength(&rrset);
+
+		isc_mem_put(mctx, target->base, target->length);
+		isc_buffer_init(target, isc_mem_get(mctx, length), length);
+	}
+	isc_buffer_clear(target);
+
+	for (i = 0; i < rdcount; i++) {
+		uint16_t rdlen;
+
+		dns_rdata_init(&rdata[i]);
+
+		if (isc_buffer_remaininglength(&rrset) < sizeof(rdlen)) {
+			result = ISC_R_RANGE;
+			goto cleanup;
+		}
+		rdlen = isc_buffer_getuint16(&rrset);
+		if (rdlen > isc_buffer_remaininglength(&rrset)) {
+			result = ISC_R_RANGE;
+			goto cleanup;
+		}
+		if (rdatalist.type == 0) {
+			/*
+			 * Negative cache entries hold the proof of
+			 * nonexistence in the ncache format, which has no
+			 * wire form to check it against; copy it as is.
+			 */
+			isc_region_t r;
+
+			isc_buffer_availableregion(target, &r);
+			INSIST(r.length >= rdlen);
+			memmove(r.base, isc_buffer_current(&rrset), rdlen);
+			r.length = rdlen;
+			isc_buffer_add(target, rdlen);
+			isc_buffer_forward(&rrset, rdlen);
+			dns_rdata_fromregion(&rdata[i], rdatalist.rdclass, 0,
+					     &r);
+		} else {
+			isc_buffer_setactive(&rrset, rdlen);
+			result = dns_rdata_fromwire(
+				&rdata[i], rdatalist.rdclass, rdatalist.type,
+				&rrset, DNS_DECOMPRESS_NEVER, 0, target);
+			if (result != ISC_R_SUCCESS) {
+				goto cleanup;
+			}
+		}
+		ISC_LIST_APPEND(rdatalist.rdata, &rdata[i], link);
+	}
+
+	/*
+	 * Sanity check.  Still having remaining space very likely indicates
+	 * broken or malformed data.
+	 */
+	if (isc_buffer_remaininglength(&rrset) != 0) {
+		result = ISC_R_RANGE;
+		goto cleanup;
+	}
+
+	dns_rdataset_init(&rdataset);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	rdataset.trust = trust;
+	if ((attributes & DNS_MASTERRAW_ATTR_NEGATIVE) != 0) {
+		rdataset.attributes |= DNS_RDATASETATTR_NEGATIVE;
+	}
+	if ((attributes & DNS_MASTERRAW_ATTR_NXDOMAIN) != 0) {
+		rdataset.attributes |= DNS_RDATASETATTR_NXDOMAIN;
+	}
+	if ((attributes & DNS_MASTERRAW_ATTR_OPTOUT) != 0) {
+		rdataset.attributes |= DNS_RDATASETATTR_OPTOUT;
+	}
+	if ((attributes & DNS_MASTERRAW_ATTR_PREFETCH) != 0) {
+		rdataset.attributes |= DNS_RDATASETATTR_PREFETCH;
+	}
+	result = (*callbacks->add)(callbacks->add_private, name, &rdataset);
+	dns_rdataset_disassociate(&rdataset);
+
+cleanup:
+	while ((rdata = ISC_LIST_HEAD(rdatalist.rdata)) != NULL) {
+		ISC_LIST_UNLINK(rdatalist.rdata, rdata, link);
+	}
+	return (result);
+}
+
+isc_result_t
+dns_master_loadcache(const char *master_file, dns_rdataclass_t zclass,
+		     isc_stdtime_t now, dns_ttl_t maxttl,
+		     dns_rdatacallbacks_t *callbacks, isc_mem_t *mctx) {
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_buffer_t source, target;
+	dns_rdata_t *rdata = NULL;
+	unsigned int rdata_size = 0;
+	unsigned char *base = NULL;
+	size_t size = 0;
+	struct stat sb;
+	uint32_t format, version, flags;
+	int fd;
+
+	REQUIRE(master_file != NULL);
+	REQUIRE(DNS_CALLBACK_VALID(callbacks));
+	REQUIRE(callbacks->add != NULL);
+
+	fd = open(master_file, O_RDONLY);
+	if (fd == -1) {
+		result = isc_errno_toresult(errno);
+		if (result == ISC_R_FILENOTFOUND) {
+			return (result);
+		}
+		goto cleanup;
+	}
+	if (fstat(fd, &sb) == -1) {
+		result = isc_errno_toresult(errno);
+		close(fd);
+		goto cleanup;
+	}
+	size = (size_t)sb.st_size;
+	if (size < sizeof(dns_masterrawheader_t)) {
+		close(fd);
+		result = ISC_R_UNEXPECTEDEND;
+		goto cleanup;
+	}
+
+	base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED) {
+		base = NULL;
+		result = isc_errno_toresult(errno);
+		goto cleanup;
+	}
+#if defined(MADV_SEQUENTIAL)
+	(void)madvise(base, size, MADV_SEQUENTIAL);
+#endif /* if defined(MADV_SEQUENTIAL) */
+
+	isc_buffer_constinit(&source, base, size);
+	isc_buffer_add(&source, size);
+
+	format = isc_buffer_getuint32(&source);
+	version = isc_buffer_getuint32(&source);
+	(void)isc_buffer_getuint32(&source); /* dumptime */
+	flags = isc_buffer_getuint32(&source);
+	(void)isc_buffer_getuint32(&source); /* sourceserial */
+	(void)isc_buffer_getuint32(&source); /* lastxfrin */
+	if (format != dns_masterformat_raw ||
+	    version != DNS_RAWFORMAT_CACHEVERSION ||
+	    (flags & DNS_MASTERRAW_CACHE) == 0)
+	{
+		(*callbacks->error)(callbacks, "dns_master_loadcache: "
+					       "not a cache snapshot");
+		result = ISC_R_NOTIMPLEMENTED;
+		goto cleanup;
+	}
+
+	isc_buffer_init(&target, isc_mem_get(mctx, TSIZ), TSIZ);
+
+	while (result == ISC_R_SUCCESS &&
+	       isc_buffer_remaininglength(&source) > 0)
+	{
+		result = load_cache_rdataset(&source, zclass, now, maxttl,
+					     callbacks, mctx, &target, &rdata,
+					     &rdata_size);
+	}
+
+	isc_mem_put(mctx, target.base, target.length);
+	if (rdata != NULL) {
+		isc_mem_put(mctx, rdata, rdata_size * sizeof(*rdata));
+	}
+
+cleanup:
+	if (base != NULL) {
+		munmap(base, size);
+	}
+	if (result != ISC_R_SUCCESS) {
+		(*callbacks->error)(callbacks, "dns_master_loadcache: %s: %s",
+				    master_file, isc_result_totext(result));
+	}
+
+	return (result);
 }
 
 void
@@ -14,22 +14,27 @@
 /*! \file */
 
 #include <inttypes.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdlib.h>
 
 #include <isc/async.h>
 #include <isc/atomic.h>
 #include <isc/buffer.h>
+#include <isc/condition.h>
 #include <isc/event.h>
 #include <isc/file.h>
 #include <isc/loop.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/os.h>
 #include <isc/print.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/stdio.h>
 #include <isc/string.h>
+#include <isc/thread.h>
 #include <isc/time.h>
 #include <isc/types.h>
 #include <isc/util.h>
@@ -106,6 +111,7 @@ typedef struct dns_totext_ctx {
 	bool current_ttl_valid;
 	dns_ttl_t serve_stale_ttl;
 	dns_indent_t indent;
+	isc_stdtime_t now;
 } dns_totext_ctx_t;
 
 const dns_master_style_t dns_master_style_keyzone = {
@@ -249,6 +255,15 @@ static char spaces[N_SPACES + 1] = "          ";
 #define N_TABS 10
 static char tabs[N_TABS + 1] = "\t\t\t\t\t\t\t\t\t\t";
 
+/*%
+ * Where dumped data goes: the file 'f', or, if 'text' is not NULL, that
+ * buffer, which grows as needed.
+ */
+typedef struct dumpout {
+	FILE *f;
+	isc_buffer_t *text;
+} dumpout_t;
+
 struct dns_dumpctx {
 	unsigned int magic;
 	isc_mem_t *mctx;
@@ -273,7 +288,7 @@ struct dns_dumpctx {
 	isc_result_t (*dumpsets)(isc_mem_t *mctx, const dns_name_t *name,
 				 dns_rdatasetiter_t *rdsiter,
 				 dns_totext_ctx_t *ctx, isc_buffer_t *buffer,
-				 FILE *f);
+				 dumpout_t *out);
 };
 
 #define NXDOMAIN(x) (((x)->attributes & DNS_RDATASETATTR_NXDOMAIN) != 0)
@@ -442,6 +457,7 @@ totext_ctx_init(const dns_master_style_t *style, const dns_indent_t *indentctx,
 	ctx->current_ttl = 0;
 	ctx->current_ttl_valid = false;
 	ctx->serve_stale_ttl = 0;
+	ctx->now = 0;
 	ctx->indent = *indentctx;
 
 	return (ISC_R_SUCCESS);
@@ -915,6 +931,49 @@ dns_master_questiontotext(const dns_name_t *owner_name,
 	return (question_totext(rdataset, owner_name, &ctx, false, target));
 }
 
+static isc_result_t
+dumpout_write(dumpout_t *out, const void *data, size_t length) {
+	if (out->text == NULL) {
+		return (isc_stdio_write(data, 1, length, out->f, NULL));
+	}
+
+	/* Grow the buffer at least twofold, so that appending is cheap */
+	if (isc_buffer_availablelength(out->text) < length) {
+		RUNTIME_CHECK(isc_buffer_reserve(
+				      out->text,
+				      ISC_MAX(length, out->text->length)) ==
+			      ISC_R_SUCCESS);
+	}
+	isc_buffer_putmem(out->text, data, length);
+	return (ISC_R_SUCCESS);
+}
+
+static void
+dumpout_printf(dumpout_t *out, const char *format, ...)
+	ISC_FORMAT_PRINTF(2, 3);
+
+static void
+dumpout_printf(dumpout_t *out, const char *format, ...) {
+	char buf[1024];
+	va_list ap;
+	int n;
+
+	if (out->text == NULL) {
+		va_start(ap, format);
+		vfprintf(out->f, format, ap);
+		va_end(ap);
+		return;
+	}
+
+	/* Nothing longer than a domain name and a little more is printed */
+	va_start(ap, format);
+	n = vsnprintf(buf, sizeof(buf), format, ap);
+	va_end(ap);
+	RUNTIME_CHECK(n >= 0 && (size_t)n < sizeof(buf));
+
+	(void)dumpout_write(out, buf, n);
+}
+
 /*
  * Print an rdataset.  'buffer' is a scratch buffer, which must have been
  * dynamically allocated by the caller.  It must be large enough to
@@ -924,7 +983,7 @@ dns_master_questiontotext(const dns_name_t *owner_name,
 
 static isc_result_t
 dump_rdataset(isc_mem_t *mctx, const dns_name_t *name, dns_rdataset_t *rdataset,
-	      dns_totext_ctx_t *ctx, isc_buffer_t *buffer, FILE *f) {
+	      dns_totext_ctx_t *ctx, isc_buffer_t *buffer, dumpout_t *out) {
 	isc_region_t r;
 	isc_result_t result;
 
@@ -944,10 +1003,12 @@ dump_rdataset(isc_mem_t *mctx, const dns_name_t *name, dns_rdataset_t *rdataset,
 							true, buffer);
 				INSIST(result == ISC_R_SUCCESS);
 				isc_buffer_usedregion(buffer, &r);
-				fprintf(f, "$TTL %u\t; %.*s\n", rdataset->ttl,
-					(int)r.length, (char *)r.base);
+				dumpout_printf(out, "$TTL %u\t; %.*s\n",
+					       rdataset->ttl, (int)r.length,
+					       (char *)r.base);
 			} else {
-				fprintf(f, "$TTL %u\n", rdataset->ttl);
+				dumpout_printf(out, "$TTL %u\n",
+					       rdataset->ttl);
 			}
 			ctx->current_ttl = rdataset->ttl;
 			ctx->current_ttl_valid = true;
@@ -981,7 +1042,7 @@ dump_rdataset(isc_mem_t *mctx, const dns_name_t *name, dns_rdataset_t *rdataset,
 	 * Write the buffer contents to the master file.
 	 */
 	isc_buffer_usedregion(buffer, &r);
-	result = isc_stdio_write(r.base, 1, (size_t)r.length, f, NULL);
+	result = dumpout_write(out, r.base, r.length);
 
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR("master file write failed: %s",
@@ -1047,7 +1108,7 @@ dump_order_compare(const void *a, const void *b) {
 static isc_result_t
 dump_rdatasets_text(isc_mem_t *mctx, const dns_name_t *name,
 		    dns_rdatasetiter_t *rdsiter, dns_totext_ctx_t *ctx,
-		    isc_buffer_t *buffer, FILE *f) {
+		    isc_buffer_t *buffer, dumpout_t *out) {
 	isc_result_t itresult, dumpresult;
 	isc_region_t r;
 	dns_rdataset_t rdatasets[MAXSORT];
@@ -1062,7 +1123,8 @@ dump_rdatasets_text(isc_mem_t *mctx, const dns_name_t *name,
 		itresult = dns_name_totext(ctx->neworigin, false, buffer);
 		RUNTIME_CHECK(itresult == ISC_R_SUCCESS);
 		isc_buffer_usedregion(buffer, &r);
-		fprintf(f, "$ORIGIN %.*s\n", (int)r.length, (char *)r.base);
+		dumpout_printf(out, "$ORIGIN %.*s\n", (int)r.length,
+			       (char *)r.base);
 		ctx->neworigin = NULL;
 	}
 
@@ -1095,10 +1157,12 @@ again:
 			{
 				unsigned int j;
 				for (j = 0; j < ctx->indent.count; j++) {
-					fprintf(f, "%s", ctx->indent.string);
+					dumpout_printf(out, "%s",
+						       ctx->indent.string);
 				}
 			}
-			fprintf(f, "; %s\n", dns_trust_totext(rds->trust));
+			dumpout_printf(out, "; %s\n",
+				       dns_trust_totext(rds->trust));
 		}
 		if (((rds->attributes & DNS_RDATASETATTR_NEGATIVE) != 0) &&
 		    (ctx->style.flags & DNS_STYLEFLAG_NCACHE) == 0)
@@ -1107,19 +1171,20 @@ again:
 		} else {
 			isc_result_t result;
 			if (STALE(rds)) {
-				fprintf(f, "; stale\n");
+				dumpout_printf(out, "; stale\n");
 			} else if (ANCIENT(rds)) {
 				isc_buffer_t b;
 				char buf[sizeof("YYYYMMDDHHMMSS")];
 				memset(buf, 0, sizeof(buf));
 				isc_buffer_init(&b, buf, sizeof(buf) - 1);
 				dns_time64_totext((uint64_t)rds->ttl, &b);
-				fprintf(f,
-					"; expired since %s "
-					"(awaiting cleanup)\n",
-					buf);
+				dumpout_printf(out,
+					       "; expired since %s "
+					       "(awaiting cleanup)\n",
+					       buf);
 			}
-			result = dump_rdataset(mctx, name, rds, ctx, buffer, f);
+			result = dump_rdataset(mctx, name, rds, ctx, buffer,
+					       out);
 			if (result != ISC_R_SUCCESS) {
 				dumpresult = result;
 			}
@@ -1141,10 +1206,11 @@ again:
 			{
 				unsigned int j;
 				for (j = 0; j < ctx->indent.count; j++) {
-					fprintf(f, "%s", ctx->indent.string);
+					dumpout_printf(out, "%s",
+						       ctx->indent.string);
 				}
 			}
-			fprintf(f, "; resign=%s\n", buf);
+			dumpout_printf(out, "; resign=%s\n", buf);
 		}
 		dns_rdataset_disassociate(rds);
 	}
@@ -1169,11 +1235,14 @@ again:
 }
 
 /*
- * Dump given RRsets in the "raw" format.
+ * Dump given RRsets in the "raw" format.  In a cache snapshot, the TTL is
+ * replaced by the absolute expiry time, and is followed by the trust level
+ * and attributes of the RRset.
  */
 static isc_result_t
 dump_rdataset_raw(isc_mem_t *mctx, const dns_name_t *name,
-		  dns_rdataset_t *rdataset, isc_buffer_t *buffer, FILE *f) {
+		  dns_rdataset_t *rdataset, const dns_totext_ctx_t *ctx,
+		  bool cache, isc_buffer_t *buffer, dumpout_t *out) {
 	isc_result_t result;
 	uint32_t totallen;
 	uint16_t dlen;
@@ -1196,15 +1265,38 @@ restart:
 	 * can store all of them in the initial buffer.
 	 */
 	isc_buffer_availableregion(buffer, &r_hdr);
-	INSIST(r_hdr.length >= sizeof(dns_masterrawrdataset_t));
+	INSIST(r_hdr.length >= sizeof(dns_mastercacherdataset_t));
 	isc_buffer_putuint32(buffer, totallen);		 /* XXX: leave space */
 	isc_buffer_putuint16(buffer, rdataset->rdclass); /* 16-bit class */
 	isc_buffer_putuint16(buffer, rdataset->type);	 /* 16-bit type */
 	isc_buffer_putuint16(buffer, rdataset->covers);	 /* same as type */
-	isc_buffer_putuint32(buffer, rdataset->ttl);	 /* 32-bit TTL */
+	if (cache) {
+		/* 32-bit expiry time */
+		isc_buffer_putuint32(buffer, ctx->now + rdataset->ttl);
+	} else {
+		isc_buffer_putuint32(buffer, rdataset->ttl); /* 32-bit TTL */
+	}
 	isc_buffer_putuint32(buffer, dns_rdataset_count(rdataset));
+	if (cache) {
+		uint16_t attributes = 0;
+
+		if ((rdataset->attributes & DNS_RDATASETATTR_NEGATIVE) != 0) {
+			attributes |= DNS_MASTERRAW_ATTR_NEGATIVE;
+		}
+		if ((rdataset->attributes & DNS_RDATASETATTR_NXDOMAIN) != 0) {
+			attributes |= DNS_MASTERRAW_ATTR_NXDOMAIN;
+		}
+		if ((rdataset->attributes & DNS_RDATASETATTR_OPTOUT) != 0) {
+			attributes |= DNS_MASTERRAW_ATTR_OPTOUT;
+		}
+		if ((rdataset->attributes & DNS_RDATASETATTR_PREFETCH) != 0) {
+			attributes |= DNS_MASTERRAW_ATTR_PREFETCH;
+		}
+		isc_buffer_putuint16(buffer, rdataset->trust);
+		isc_buffer_putuint16(buffer, attributes);
+	}
 	totallen = isc_buffer_usedlength(buffer);
-	INSIST(totallen <= sizeof(dns_masterrawrdataset_t));
+	INSIST(totallen <= sizeof(dns_mastercacherdataset_t));
 
 	dns_name_toregion(name, &r);
 	INSIST(isc_buffer_availablelength(buffer) >= (sizeof(dlen) + r.length));
@@ -1264,7 +1356,7 @@ restart:
 	/*
 	 * Write the buffer contents to the raw master file.
 	 */
-	result = isc_stdio_write(r.base, 1, (size_t)r.length, f, NULL);
+	result = dumpout_write(out, r.base, r.length);
 
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR("raw master file write failed: %s",
@@ -1278,7 +1370,7 @@ restart:
 static isc_result_t
 dump_rdatasets_raw(isc_mem_t *mctx, const dns_name_t *owner_name,
 		   dns_rdatasetiter_t *rdsiter, dns_totext_ctx_t *ctx,
-		   isc_buffer_t *buffer, FILE *f) {
+		   isc_buffer_t *buffer, dumpout_t *out) {
 	isc_result_t result;
 	dns_rdataset_t rdataset;
 	dns_fixedname_t fixed;
@@ -1299,8 +1391,55 @@ dump_rdatasets_raw(isc_mem_t *mctx, const dns_name_t *owner_name,
 		{
 			/* Omit negative cache entries */
 		} else {
-			result = dump_rdataset_raw(mctx, name, &rdataset,
-						   buffer, f);
+			result = dump_rdataset_raw(mctx, name, &rdataset, ctx,
+						   false, buffer, out);
+		}
+		dns_rdataset_disassociate(&rdataset);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+
+	if (result == ISC_R_NOMORE) {
+		result = ISC_R_SUCCESS;
+	}
+
+	return (result);
+}
+
+/*
+ * Dump given RRsets of a cache into a cache snapshot.  Only the RRsets
+ * that are still active are written; RRsets with a "noqname" or
+ * "closest encloser" proof are left out, as the proof is not written.
+ */
+static isc_result_t
+dump_rdatasets_cache(isc_mem_t *mctx, const dns_name_t *owner_name,
+		     dns_rdatasetiter_t *rdsiter, dns_totext_ctx_t *ctx,
+		     isc_buffer_t *buffer, dumpout_t *out) {
+	isc_result_t result;
+	dns_rdataset_t rdataset;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+
+	name = dns_fixedname_initname(&fixed);
+	dns_name_copy(owner_name, name);
+	for (result = dns_rdatasetiter_first(rdsiter); result == ISC_R_SUCCESS;
+	     result = dns_rdatasetiter_next(rdsiter))
+	{
+		dns_rdataset_init(&rdataset);
+		dns_rdatasetiter_current(rdsiter, &rdataset);
+
+		dns_rdataset_getownercase(&rdataset, name);
+
+		if (STALE(&rdataset) || ANCIENT(&rdataset) ||
+		    rdataset.ttl == 0 ||
+		    (rdataset.attributes & (DNS_RDATASETATTR_NOQNAME |
+					    DNS_RDATASETATTR_CLOSEST)) != 0)
+		{
+			/* Omit */
+		} else {
+			result = dump_rdataset_raw(mctx, name, &rdataset, ctx,
+						   true, buffer, out);
 		}
 		dns_rdataset_disassociate(&rdataset);
 		if (result != ISC_R_SUCCESS) {
@@ -1533,7 +1672,17 @@ dumpctx_create(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 		dctx->dumpsets = dump_rdatasets_text;
 		break;
 	case dns_masterformat_raw:
-		dctx->dumpsets = dump_rdatasets_raw;
+		if ((dctx->header.flags & DNS_MASTERRAW_CACHE) != 0) {
+			REQUIRE(dns_db_iscache(db));
+			dctx->dumpsets = dump_rdatasets_cache;
+		} else {
+			dctx->dumpsets = dump_rdatasets_raw;
+		}
+		break;
+	case dns_masterformat_map:
+		/* The database writes its own image: see dumptostream() */
+		REQUIRE(!dns_db_iscache(db));
+		dctx->dumpsets = NULL;
 		break;
 	default:
 		UNREACHABLE();
@@ -1546,6 +1695,7 @@ dumpctx_create(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 	}
 
 	isc_stdtime_get(&dctx->now);
+	dctx->tctx.now = dctx->now;
 	dns_db_attach(db, &dctx->db);
 
 	dctx->do_date = dns_db_iscache(dctx->db);
@@ -1625,20 +1775,25 @@ writeheader(dns_dumpctx_t *dctx) {
 		}
 		break;
 	case dns_masterformat_raw:
+	case dns_masterformat_map:
 		r.base = (unsigned char *)&rawheader;
 		r.length = sizeof(rawheader);
 		isc_buffer_region(&buffer, &r);
 		now32 = dctx->now;
 		rawversion = 1;
-		if ((dctx->header.flags & DNS_MASTERRAW_COMPAT) != 0) {
+		if (dctx->format == dns_masterformat_map) {
+			/* Map files have no older versions */
+		} else if ((dctx->header.flags & DNS_MASTERRAW_COMPAT) != 0) {
 			rawversion = 0;
+		} else if ((dctx->header.flags & DNS_MASTERRAW_CACHE) != 0) {
+			rawversion = DNS_RAWFORMAT_CACHEVERSION;
 		}
 
 		isc_buffer_putuint32(&buffer, dctx->format);
 		isc_buffer_putuint32(&buffer, rawversion);
 		isc_buffer_putuint32(&buffer, now32);
 
-		if (rawversion == 1) {
+		if (rawversion != 0) {
 			isc_buffer_putuint32(&buffer, dctx->header.flags);
 			isc_buffer_putuint32(&buffer,
 					     dctx->header.sourceserial);
@@ -1662,6 +1817,435 @@ writeheader(dns_dumpctx_t *dctx) {
 	return (result);
 }
 
+/*
+ * Dump the RRsets at 'node' to 'out'.
+ */
+static isc_result_t
+dumpnode(dns_dumpctx_t *dctx, dns_dbnode_t *node, const dns_name_t *name,
+	 unsigned int options, dns_totext_ctx_t *tctx, isc_buffer_t *buffer,
+	 dumpout_t *out) {
+	dns_rdatasetiter_t *rdsiter = NULL;
+	isc_result_t result;
+
+	result = dns_db_allrdatasets(dctx->db, node, dctx->version, options,
+				     dctx->now, &rdsiter);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	result = (dctx->dumpsets)(dctx->mctx, name, rdsiter, tctx, buffer, out);
+	dns_rdatasetiter_destroy(&rdsiter);
+
+	return (result);
+}
+
+/*
+ * Parallel dumping of large databases.
+ *
+ * The database is divided into parts of about 'dump_partnodes' nodes by a
+ * splitting iterator, which the threads advance in turn.  Each part is
+ * dumped by one thread, with an iterator of its own, into a buffer from
+ * the dump's memory context; the buffers are written to the file one part
+ * at a time, in database order.  A part starts with a new $ORIGIN if owner
+ * names are relative, and with the $TTL and class not yet known, so its
+ * text does not depend on the part before it.  The main tree and the
+ * NSEC3 tree are split separately, so that seeking to the first name of a
+ * part cannot land in the wrong tree.
+ */
+
+#define DUMP_PARTNODES 4096
+
+/*%
+ * The number of parts, per thread, that can be dumped ahead of the first
+ * part that has not been written yet.
+ */
+#define DUMP_WINDOW 4
+
+/*%
+ * The initial size of the text buffer of a part.
+ */
+#define DUMP_PARTLENGTH (64 * 1024)
+
+static atomic_uint_fast32_t dump_threads = 0;
+static atomic_uint_fast32_t dump_partnodes = DUMP_PARTNODES;
+
+typedef struct dumppart {
+	dns_fixedname_t name; /*%< the name of 'start' */
+	dns_dbnode_t *start;
+	dns_dbnode_t *end; /*%< the first node of the next part, if any */
+	unsigned int options;
+	isc_buffer_t *text;
+	isc_result_t result;
+	bool done;
+} dumppart_t;
+
+typedef struct dumpparallel {
+	dns_dumpctx_t *dctx;
+	unsigned int options;	  /*%< for dns_db_allrdatasets() */
+	unsigned int iteroptions; /*%< for dns_db_createiterator() */
+
+	isc_mutex_t lock;
+	isc_condition_t ready;
+
+	/* The splitting iterator, on the first node of the next part */
+	dns_dbiterator_t *splitter;
+	unsigned int splitoptions;
+	isc_result_t splitresult;
+	dns_dbnode_t *splitnode;
+	dns_fixedname_t splitname;
+
+	dumppart_t *parts;
+	size_t window;
+	size_t next;	/*%< the parts before this have been split */
+	size_t written; /*%< the parts before this have been written */
+	bool writing;
+	bool failed;
+	bool finished; /*%< every part has been split */
+	isc_result_t result;
+} dumpparallel_t;
+
+static unsigned int
+dump_nthreads(void) {
+	unsigned int nthreads = atomic_load_relaxed(&dump_threads);
+
+	return (nthreads != 0 ? nthreads : isc_os_ncpus());
+}
+
+/*
+ * Start splitting the tree that 'options' selects.
+ */
+static void
+split_first(dumpparallel_t *p, unsigned int options) {
+	dns_db_t *db = p->dctx->db;
+	isc_result_t result;
+
+	if (p->splitter != NULL) {
+		dns_dbiterator_destroy(&p->splitter);
+	}
+	p->splitoptions = options;
+
+	result = dns_db_createiterator(db, options, &p->splitter);
+	if (result == ISC_R_SUCCESS) {
+		result = dns_dbiterator_first(p->splitter);
+	}
+	if (result == ISC_R_SUCCESS) {
+		result = dns_dbiterator_current(
+			p->splitter, &p->splitnode,
+			dns_fixedname_initname(&p->splitname));
+	}
+	if (p->splitter != NULL) {
+		(void)dns_dbiterator_pause(p->splitter);
+	}
+	p->splitresult = result;
+}
+
+/*
+ * Split off the next part: it runs from the splitting iterator's node to
+ * the node 'dump_partnodes' nodes on, or to the end of the tree.  Returns
+ * NULL if there is nothing left to dump.  Called with the lock held.
+ */
+static dumppart_t *
+split_part(dumpparallel_t *p) {
+	dns_db_t *db = p->dctx->db;
+	unsigned int nodes = atomic_load_relaxed(&dump_partnodes);
+	dumppart_t *part = NULL;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	if (p->splitresult == ISC_R_NOMORE &&
+	    p->splitoptions == DNS_DB_NONSEC3)
+	{
+		split_first(p, DNS_DB_NSEC3ONLY);
+	}
+	if (p->splitresult == ISC_R_NOMORE) {
+		return (NULL);
+	}
+
+	part = &p->parts[p->next++ % p->window];
+	*part = (dumppart_t){
+		.options = p->splitoptions,
+		.result = p->splitresult,
+	};
+	if (p->splitresult != ISC_R_SUCCESS) {
+		/* The part carries the error to where it is written */
+		p->splitresult = ISC_R_NOMORE;
+		p->splitoptions = DNS_DB_NSEC3ONLY;
+		return (part);
+	}
+
+	part->start = p->splitnode;
+	p->splitnode = NULL;
+	dns_name_copy(dns_fixedname_name(&p->splitname),
+		      dns_fixedname_initname(&part->name));
+
+	for (unsigned int i = 0; i < nodes && result == ISC_R_SUCCESS; i++) {
+		result = dns_dbiterator_next(p->splitter);
+		(void)dns_dbiterator_pause(p->splitter);
+	}
+	if (result == ISC_R_SUCCESS) {
+		result = dns_dbiterator_current(
+			p->splitter, &p->splitnode,
+			dns_fixedname_name(&p->splitname));
+		(void)dns_dbiterator_pause(p->splitter);
+	}
+	if (result == ISC_R_SUCCESS) {
+		dns_db_attachnode(db, p->splitnode, &part->end);
+	}
+	p->splitresult = result;
+
+	return (part);
+}
+
+/*
+ * Dump the nodes of 'part' into its text buffer.
+ */
+static isc_result_t
+dump_part(dumpparallel_t *p, dumppart_t *part) {
+	dns_dumpctx_t *dctx = p->dctx;
+	dns_dbiterator_t *dbiter = NULL;
+	dns_totext_ctx_t tctx = dctx->tctx;
+	dns_fixedname_t fixname;
+	dns_name_t *name = dns_fixedname_initname(&fixname);
+	isc_buffer_t buffer;
+	bool started = false;
+	isc_result_t result;
+	dumpout_t out = { 0 };
+
+	dns_fixedname_init(&tctx.origin_fixname);
+	tctx.origin = NULL;
+	tctx.neworigin = NULL;
+	if (tctx.linebreak != NULL) {
+		tctx.linebreak = tctx.linebreak_buf;
+	}
+
+	isc_buffer_allocate(dctx->mctx, &part->text, DUMP_PARTLENGTH);
+	out.text = part->text;
+	isc_buffer_init(&buffer, isc_mem_get(dctx->mctx, initial_buffer_length),
+			initial_buffer_length);
+
+	result = dns_db_createiterator(dctx->db, p->iteroptions | part->options,
+				       &dbiter);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+	result = dns_dbiterator_seek(dbiter, dns_fixedname_name(&part->name));
+
+	while (result == ISC_R_SUCCESS) {
+		dns_dbnode_t *node = NULL;
+
+		if (atomic_load_acquire(&dctx->canceled)) {
+			result = ISC_R_CANCELED;
+			break;
+		}
+
+		result = dns_dbiterator_current(dbiter, &node, name);
+		if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN) {
+			break;
+		}
+		if (node == part->end) {
+			dns_db_detachnode(dctx->db, &node);
+			break;
+		}
+		if (result == DNS_R_NEWORIGIN) {
+			dns_name_t *origin =
+				dns_fixedname_name(&tctx.origin_fixname);
+			result = dns_dbiterator_origin(dbiter, origin);
+			RUNTIME_CHECK(result == ISC_R_SUCCESS);
+			if ((tctx.style.flags & DNS_STYLEFLAG_REL_DATA) != 0) {
+				tctx.origin = origin;
+			}
+			tctx.neworigin = origin;
+		}
+
+		result = dns_dbiterator_pause(dbiter);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+		/*
+		 * Nodes with the same name can come before the first node of
+		 * the part, in a database that is made of several trees.
+		 */
+		if (started || node == part->start) {
+			started = true;
+			result = dumpnode(dctx, node, name, p->options, &tctx,
+					  &buffer, &out);
+		}
+		dns_db_detachnode(dctx->db, &node);
+		if (result == ISC_R_SUCCESS) {
+			result = dns_dbiterator_next(dbiter);
+		}
+	}
+	if (result == ISC_R_NOMORE) {
+		result = ISC_R_SUCCESS;
+	}
+
+cleanup:
+	if (dbiter != NULL) {
+		dns_dbiterator_destroy(&dbiter);
+	}
+	isc_mem_put(dctx->mctx, buffer.base, buffer.length);
+
+	return (result);
+}
+
+/*
+ * Write 'part' to the file, unless an earlier part has failed, and free it.
+ */
+static void
+write_part(dumpparallel_t *p, dumppart_t *part) {
+	dns_dumpctx_t *dctx = p->dctx;
+
+	if (p->result != ISC_R_SUCCESS) {
+		/* Nothing to write */
+	} else if (part->result != ISC_R_SUCCESS) {
+		p->result = part->result;
+	} else if (isc_buffer_usedlength(part->text) > 0) {
+		p->result = isc_stdio_write(isc_buffer_base(part->text), 1,
+					    isc_buffer_usedlength(part->text),
+					    dctx->f, NULL);
+		if (p->result != ISC_R_SUCCESS) {
+			UNEXPECTED_ERROR("master file write failed: %s",
+					 isc_result_totext(p->result));
+		}
+	}
+
+	if (part->text != NULL) {
+		isc_buffer_free(&part->text);
+	}
+	if (part->start != NULL) {
+		dns_db_detachnode(dctx->db, &part->start);
+	}
+	if (part->end != NULL) {
+		dns_db_detachnode(dctx->db, &part->end);
+	}
+}
+
+static isc_threadresult_t
+dump_worker(isc_threadarg_t arg) {
+	dumpparallel_t *p = arg;
+
+	LOCK(&p->lock);
+	while (!p->failed && !atomic_load_acquire(&p->dctx->canceled)) {
+		dumppart_t *part = NULL;
+
+		if (p->next >= p->written + p->window) {
+			WAIT(&p->ready, &p->lock);
+			continue;
+		}
+
+		part = split_part(p);
+		if (part == NULL) {
+			p->finished = true;
+			break;
+		}
+		UNLOCK(&p->lock);
+
+		if (part->result == ISC_R_SUCCESS) {
+			part->result = dump_part(p, part);
+		}
+
+		LOCK(&p->lock);
+		part->done = true;
+		if (part->result != ISC_R_SUCCESS) {
+			p->failed = true;
+			BROADCAST(&p->ready);
+		}
+
+		/*
+		 * Whoever completes the parts that are next in line writes
+		 * them, in order, without holding the lock.
+		 */
+		if (p->writing) {
+			continue;
+		}
+		p->writing = true;
+		while (p->written < p->next &&
+		       p->parts[p->written % p->window].done)
+		{
+			part = &p->parts[p->written % p->window];
+			UNLOCK(&p->lock);
+			write_part(p, part);
+			LOCK(&p->lock);
+			p->written++;
+			BROADCAST(&p->ready);
+		}
+		p->writing = false;
+	}
+	UNLOCK(&p->lock);
+
+	return ((isc_threadresult_t)0);
+}
+
+/*
+ * Dump the nodes of a large database with up to 'dump_nthreads()' threads.
+ * Returns false if the database is better dumped by one.
+ */
+static bool
+dumptostream_parallel(dns_dumpctx_t *dctx, unsigned int options,
+		      isc_result_t *resultp) {
+	unsigned int nthreads = dump_nthreads();
+	unsigned int nodes = atomic_load_relaxed(&dump_partnodes);
+	isc_thread_t *threads = NULL;
+	dumpparallel_t p = {
+		.dctx = dctx,
+		.options = options,
+		.result = ISC_R_SUCCESS,
+	};
+
+	if (nthreads < 2 ||
+	    (size_t)dns_db_nodecount(dctx->db, dns_dbtree_main) +
+			    dns_db_nodecount(dctx->db, dns_dbtree_nsec3) <
+		    2 * (size_t)nodes)
+	{
+		return (false);
+	}
+
+	split_first(&p, DNS_DB_NONSEC3);
+	if (p.splitresult == ISC_R_NOTIMPLEMENTED) {
+		if (p.splitter != NULL) {
+			dns_dbiterator_destroy(&p.splitter);
+		}
+		return (false);
+	}
+
+	if (dctx->format == dns_masterformat_text &&
+	    (dctx->tctx.style.flags & DNS_STYLEFLAG_REL_OWNER) != 0)
+	{
+		p.iteroptions = DNS_DB_RELATIVENAMES;
+	}
+	p.window = nthreads * DUMP_WINDOW;
+	p.parts = isc_mem_get(dctx->mctx, p.window * sizeof(p.parts[0]));
+	isc_mutex_init(&p.lock);
+	isc_condition_init(&p.ready);
+
+	/* The calling thread is one of the workers. */
+	threads = isc_mem_get(dctx->mctx, nthreads * sizeof(threads[0]));
+	for (unsigned int i = 1; i < nthreads; i++) {
+		isc_thread_create(dump_worker, &p, &threads[i]);
+	}
+	dump_worker(&p);
+	for (unsigned int i = 1; i < nthreads; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+	isc_mem_put(dctx->mctx, threads, nthreads * sizeof(threads[0]));
+	INSIST(p.written == p.next);
+
+	if (p.result == ISC_R_SUCCESS && !p.finished) {
+		/* Stopped before the end, without a failure */
+		p.result = ISC_R_CANCELED;
+	}
+
+	if (p.splitnode != NULL) {
+		dns_db_detachnode(dctx->db, &p.splitnode);
+	}
+	if (p.splitter != NULL) {
+		dns_dbiterator_destroy(&p.splitter);
+	}
+	isc_condition_destroy(&p.ready);
+	isc_mutex_destroy(&p.lock);
+	isc_mem_put(dctx->mctx, p.parts, p.window * sizeof(p.parts[0]));
+
+	*resultp = p.result;
+	return (true);
+}
+
 static isc_result_t
 dumptostream(dns_dumpctx_t *dctx) {
 	isc_result_t result = ISC_R_SUCCESS;
@@ -1683,13 +2267,21 @@ dumptostream(dns_dumpctx_t *dctx) {
 
 	CHECK(writeheader(dctx));
 
+	if (dctx->format == dns_masterformat_map) {
+		result = dns_db_serialize(dctx->db, dctx->version, dctx->f);
+		goto cleanup;
+	}
+
+	if (dumptostream_parallel(dctx, options, &result)) {
+		goto cleanup;
+	}
+
 	result = dns_dbiterator_first(dctx->dbiter);
 	if (result != ISC_R_SUCCESS && result != ISC_R_NOMORE) {
 		goto cleanup;
 	}
 
 	while (result == ISC_R_SUCCESS) {
-		dns_rdatasetiter_t *rdsiter = NULL;
 		dns_dbnode_t *node = NULL;
 
 		result = dns_dbiterator_current(dctx->dbiter, &node, name);
@@ -1712,20 +2304,12 @@ dumptostream(dns_dumpctx_t *dctx) {
 		result = dns_dbiterator_pause(dctx->dbiter);
 		RUNTIME_CHECK(result == ISC_R_SUCCESS);
 
-		result = dns_db_allrdatasets(dctx->db, node, dctx->version,
-					     options, dctx->now, &rdsiter);
-		if (result != ISC_R_SUCCESS) {
-			dns_db_detachnode(dctx->db, &node);
-			goto cleanup;
-		}
-		result = (dctx->dumpsets)(dctx->mctx, name, rdsiter,
-					  &dctx->tctx, &buffer, dctx->f);
-		dns_rdatasetiter_destroy(&rdsiter);
+		result = dumpnode(dctx, node, name, options, &dctx->tctx,
+				  &buffer, &(dumpout_t){ .f = dctx->f });
+		dns_db_detachnode(dctx->db, &node);
 		if (result != ISC_R_SUCCESS) {
-			dns_db_detachnode(dctx->db, &node);
 			goto cleanup;
 		}
-		dns_db_detachnode(dctx->db, &node);
 		result = dns_dbiterator_next(dctx->dbiter);
 	}
 
@@ -1738,6 +2322,13 @@ cleanup:
 	return (result);
 }
 
+void
+dns_master_setdumpparallel(unsigned int nthreads, unsigned int nodes) {
+	atomic_store_relaxed(&dump_threads, nthreads);
+	atomic_store_relaxed(&dump_partnodes,
+			     nodes != 0 ? nodes : DUMP_PARTNODES);
+}
+
 isc_result_t
 dns_master_dumptostreamasync(isc_mem_t *mctx, dns_db_t *db,
 			     dns_dbversion_t *version,
@@ -1943,7 +2534,8 @@ dns_master_dumpnodetostream(isc_mem_t *mctx, dns_db_t *db,
 	if (result != ISC_R_SUCCESS) {
 		goto failure;
 	}
-	result = dump_rdatasets_text(mctx, name, rdsiter, &ctx, &buffer, f);
+	result = dump_rdatasets_text(mctx, name, rdsiter, &ctx, &buffer,
+				     &(dumpout_t){ .f = f });
 	if (result != ISC_R_SUCCESS) {
 		goto failure;
 	}
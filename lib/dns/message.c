@@ -30,6 +30,7 @@
 #include <isc/util.h>
 
 #include <dns/dnssec.h>
+#include <dns/fixedname.h>
 #include <dns/keyvalues.h>
 #include <dns/log.h>
 #include <dns/masterdump.h>
@@ -280,6 +281,31 @@ currentbuffer(dns_message_t *msg) {
 	return (dynbuf);
 }
 
+/*
+ * Copy 'region' into the message's clone buffer and point it at the copy.
+ * The clone buffer is allocated on first use and is only cleared, not
+ * freed, when the message is reset, so requests which have to outlive the
+ * receive buffer (recursion, updates) don't cost an allocation each.
+ * Returns false if there is not enough room left.
+ */
+static bool
+clonetobuffer(dns_message_t *msg, isc_region_t *region) {
+	if (msg->clonebuf == NULL) {
+		isc_buffer_allocate(msg->mctx, &msg->clonebuf,
+				    SCRATCHPAD_SIZE);
+	}
+
+	if (isc_buffer_availablelength(msg->clonebuf) < region->length) {
+		return (false);
+	}
+
+	region->base = memmove(isc_buffer_used(msg->clonebuf), region->base,
+			       region->length);
+	isc_buffer_add(msg->clonebuf, region->length);
+
+	return (true);
+}
+
 static void
 releaserdata(dns_message_t *msg, dns_rdata_t *rdata) {
 	ISC_LIST_PREPEND(msg->freerdata, rdata, link);
@@ -374,7 +400,11 @@ msginitprivate(dns_message_t *m) {
 	for (i = 0; i < DNS_SECTION_MAX; i++) {
 		m->cursors[i] = NULL;
 		m->counts[i] = 0;
+		m->deferred_sections[i].offset = 0;
+		m->deferred_sections[i].count = 0;
 	}
+	m->deferred = 0;
+	m->deferred_options = 0;
 	m->opt = NULL;
 	m->sig0 = NULL;
 	m->sig0name = NULL;
@@ -425,6 +455,8 @@ msginit(dns_message_t *m) {
 	m->saved.base = NULL;
 	m->saved.length = 0;
 	m->free_saved = 0;
+	m->clone_query = 0;
+	m->clone_saved = 0;
 	m->cc_ok = 0;
 	m->cc_bad = 0;
 	m->tkey = 0;
@@ -634,6 +666,14 @@ msgreset(dns_message_t *msg, bool everything) {
 		msg->saved.length = 0;
 	}
 
+	if (msg->clonebuf != NULL) {
+		if (everything) {
+			isc_buffer_free(&msg->clonebuf);
+		} else {
+			isc_buffer_clear(msg->clonebuf);
+		}
+	}
+
 	/*
 	 * cleanup the buffer cleanup list
 	 */
@@ -1173,9 +1213,13 @@ auth_signed(dns_namelist_t *section) {
 	return (true);
 }
 
+/*
+ * Parse records 'from' to 'to' - 1 of section 'sectionid'.
+ */
 static isc_result_t
 getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
-	   dns_section_t sectionid, unsigned int options) {
+	   dns_section_t sectionid, unsigned int options, unsigned int from,
+	   unsigned int to) {
 	isc_region_t r;
 	unsigned int count, rdatalen;
 	dns_name_t *name = NULL;
@@ -1193,7 +1237,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
 	bool best_effort = ((options & DNS_MESSAGEPARSE_BESTEFFORT) != 0);
 	bool isedns, issigzero, istsig;
 
-	for (count = 0; count < msg->counts[sectionid]; count++) {
+	for (count = from; count < to; count++) {
 		int recstart = source->current;
 		bool skip_name_search, skip_type_search;
 
@@ -1632,6 +1676,209 @@ cleanup:
 	return (result);
 }
 
+static bool
+metatype(dns_rdatatype_t type) {
+	return (type == dns_rdatatype_opt || type == dns_rdatatype_tsig ||
+		type == dns_rdatatype_sig || type == dns_rdatatype_tkey);
+}
+
+/*
+ * Move 'source' past the resource record at its current position and
+ * return its type.  Return false if getsection() could fail or report a
+ * problem when parsing the record, so that deferring it could change the
+ * result of dns_message_parse().  This errs on the side of caution:
+ * singleton types are refused because whether they are acceptable
+ * depends on the other records in the section, and so is any rdata
+ * that doesn't fit in a small buffer.  The rdata of OPT, TSIG, SIG and
+ * TKEY records is only skipped; these are never deferred.
+ */
+static bool
+checkrecord(isc_buffer_t *source, dns_message_t *msg,
+	    dns_rdatatype_t *typep) {
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	unsigned char data[SCRATCHPAD_SIZE];
+	isc_buffer_t target;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatatype_t rdtype;
+	dns_rdataclass_t rdclass;
+	unsigned int rdatalen;
+	isc_region_t r;
+
+	isc_buffer_remainingregion(source, &r);
+	isc_buffer_setactive(source, r.length);
+	if (dns_name_fromwire(name, source, DNS_DECOMPRESS_ALWAYS, 0, NULL) !=
+	    ISC_R_SUCCESS)
+	{
+		return (false);
+	}
+
+	isc_buffer_remainingregion(source, &r);
+	if (r.length < 2 + 2 + 4 + 2) {
+		return (false);
+	}
+	rdtype = isc_buffer_getuint16(source);
+	rdclass = isc_buffer_getuint16(source);
+	isc_buffer_forward(source, 4);
+	rdatalen = isc_buffer_getuint16(source);
+	if (r.length - (2 + 2 + 4 + 2) < rdatalen) {
+		return (false);
+	}
+
+	*typep = rdtype;
+	if (metatype(rdtype)) {
+		isc_buffer_forward(source, rdatalen);
+		return (true);
+	}
+
+	/*
+	 * The same checks as in getsection(), for a QUERY.
+	 */
+	if (msg->rdclass != dns_rdataclass_any && msg->rdclass != rdclass &&
+	    (rdtype != dns_rdatatype_key || !msg->tkey))
+	{
+		return (false);
+	}
+	if (dns_rdatatype_issingleton(rdtype) ||
+	    dns_rdatatype_questiononly(rdtype))
+	{
+		return (false);
+	}
+
+	isc_buffer_init(&target, data, sizeof(data));
+	isc_buffer_setactive(source, rdatalen);
+	if (dns_rdata_fromwire(&rdata, rdclass, rdtype, source,
+			       DNS_DECOMPRESS_ALWAYS, 0,
+			       &target) != ISC_R_SUCCESS)
+	{
+		return (false);
+	}
+	if (rdtype == dns_rdatatype_rrsig && dns_rdata_covers(&rdata) == 0) {
+		return (false);
+	}
+	if (rdtype == dns_rdatatype_nsec3 &&
+	    !dns_rdata_checkowner(name, msg->rdclass, rdtype, false))
+	{
+		return (false);
+	}
+
+	return (true);
+}
+
+/*
+ * Skip the answer and authority sections, and the leading records of
+ * the additional section up to the first OPT, TSIG, SIG or TKEY record,
+ * remembering where they were so that they can be parsed on demand.
+ * 'source' is left at the first record that must be parsed now.
+ *
+ * Return false, leaving 'source' unchanged, if the records can't be
+ * deferred without changing the result of the parse: when a record
+ * fails checkrecord(), when a meta-record appears outside of the
+ * additional section, or when an ordinary record follows one in the
+ * additional section.  The message must then be parsed in full, which
+ * reports any error exactly as if the message had never been deferred.
+ */
+static bool
+defersections(isc_buffer_t *source, dns_message_t *msg) {
+	isc_buffer_t b = *source;
+	unsigned int additional = msg->counts[DNS_SECTION_ADDITIONAL];
+	unsigned int count, start, deferred = 0;
+	dns_rdatatype_t type;
+	bool seenmeta = false;
+	dns_section_t section;
+
+	for (section = DNS_SECTION_ANSWER; section < DNS_SECTION_ADDITIONAL;
+	     section++)
+	{
+		msg->deferred_sections[section].offset = b.current;
+		msg->deferred_sections[section].count = msg->counts[section];
+		for (count = 0; count < msg->counts[section]; count++) {
+			if (!checkrecord(&b, msg, &type) || metatype(type))
+			{
+				goto fail;
+			}
+		}
+		deferred += msg->counts[section];
+	}
+
+	msg->deferred_sections[DNS_SECTION_ADDITIONAL].offset = b.current;
+	msg->deferred_sections[DNS_SECTION_ADDITIONAL].count = additional;
+	start = b.current;
+	for (count = 0; count < additional; count++) {
+		unsigned int current = b.current;
+
+		if (!checkrecord(&b, msg, &type)) {
+			goto fail;
+		}
+		if (metatype(type)) {
+			if (!seenmeta) {
+				seenmeta = true;
+				start = current;
+				msg->deferred_sections[DNS_SECTION_ADDITIONAL]
+					.count = count;
+			}
+		} else if (seenmeta) {
+			goto fail;
+		}
+	}
+	if (!seenmeta) {
+		start = b.current;
+	}
+	deferred += msg->deferred_sections[DNS_SECTION_ADDITIONAL].count;
+
+	msg->deferred = (deferred != 0);
+	source->current = start;
+	return (true);
+
+fail:
+	for (section = DNS_SECTION_ANSWER; section < DNS_SECTION_MAX;
+	     section++)
+	{
+		msg->deferred_sections[section].offset = 0;
+		msg->deferred_sections[section].count = 0;
+	}
+	return (false);
+}
+
+/*
+ * Parse the records skipped by defersections(), if 'wanted' is one of
+ * the sections they belong to.  These passed checkrecord(), so this
+ * can only fail for lack of resources.
+ */
+static isc_result_t
+parsedeferred(dns_message_t *msg, dns_section_t wanted) {
+	isc_buffer_t source;
+	isc_result_t result = ISC_R_SUCCESS;
+	dns_section_t section;
+
+	if (!msg->deferred || wanted == DNS_SECTION_QUESTION) {
+		return (ISC_R_SUCCESS);
+	}
+	msg->deferred = 0;
+
+	isc_buffer_init(&source, msg->saved.base, msg->saved.length);
+	isc_buffer_add(&source, msg->saved.length);
+
+	for (section = DNS_SECTION_ANSWER; section < DNS_SECTION_MAX;
+	     section++)
+	{
+		unsigned int count = msg->deferred_sections[section].count;
+
+		if (count == 0) {
+			continue;
+		}
+
+		source.current = msg->deferred_sections[section].offset;
+		result = getsection(&source, msg, DNS_DECOMPRESS_ALWAYS,
+				    section, msg->deferred_options, 0, count);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+
+	return (result);
+}
+
 isc_result_t
 dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 		  unsigned int options) {
@@ -1658,11 +1905,15 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 	if ((options & DNS_MESSAGEPARSE_CLONEBUFFER) == 0) {
 		isc_buffer_usedregion(&origsource, &msg->saved);
 	} else {
-		msg->saved.length = isc_buffer_usedlength(&origsource);
-		msg->saved.base = isc_mem_get(msg->mctx, msg->saved.length);
-		memmove(msg->saved.base, isc_buffer_base(&origsource),
-			msg->saved.length);
-		msg->free_saved = 1;
+		isc_buffer_usedregion(&origsource, &msg->saved);
+		if (clonetobuffer(msg, &msg->saved)) {
+			msg->clone_saved = 1;
+		} else {
+			msg->saved.base = memmove(
+				isc_mem_get(msg->mctx, msg->saved.length),
+				msg->saved.base, msg->saved.length);
+			msg->free_saved = 1;
+		}
 	}
 
 	isc_buffer_remainingregion(source, &r);
@@ -1699,7 +1950,22 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 	}
 	msg->question_ok = 1;
 
-	ret = getsection(source, msg, dctx, DNS_SECTION_ANSWER, options);
+	/*
+	 * In lazy mode, leave everything but the meta-records in the
+	 * additional section for later if we can.
+	 */
+	if ((options & DNS_MESSAGEPARSE_LAZY) != 0 &&
+	    (options & DNS_MESSAGEPARSE_PRESERVEORDER) == 0 &&
+	    msg->opcode == dns_opcode_query &&
+	    (msg->flags & DNS_MESSAGEFLAG_QR) == 0 && msg->rdclass_set &&
+	    defersections(source, msg))
+	{
+		msg->deferred_options = options;
+		goto additional;
+	}
+
+	ret = getsection(source, msg, dctx, DNS_SECTION_ANSWER, options, 0,
+			 msg->counts[DNS_SECTION_ANSWER]);
 	if (ret == ISC_R_UNEXPECTEDEND && ignore_tc) {
 		goto truncated;
 	}
@@ -1711,7 +1977,8 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 		return (ret);
 	}
 
-	ret = getsection(source, msg, dctx, DNS_SECTION_AUTHORITY, options);
+	ret = getsection(source, msg, dctx, DNS_SECTION_AUTHORITY, options, 0,
+			 msg->counts[DNS_SECTION_AUTHORITY]);
 	if (ret == ISC_R_UNEXPECTEDEND && ignore_tc) {
 		goto truncated;
 	}
@@ -1723,7 +1990,10 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
 		return (ret);
 	}
 
-	ret = getsection(source, msg, dctx, DNS_SECTION_ADDITIONAL, options);
+additional:
+	ret = getsection(source, msg, dctx, DNS_SECTION_ADDITIONAL, options,
+			 msg->deferred_sections[DNS_SECTION_ADDITIONAL].count,
+			 msg->counts[DNS_SECTION_ADDITIONAL]);
 	if (ret == ISC_R_UNEXPECTEDEND && ignore_tc) {
 		goto truncated;
 	}
@@ -2393,9 +2663,16 @@ dns_message_renderreset(dns_message_t *msg) {
 
 isc_result_t
 dns_message_firstname(dns_message_t *msg, dns_section_t section) {
+	isc_result_t result;
+
 	REQUIRE(DNS_MESSAGE_VALID(msg));
 	REQUIRE(VALID_NAMED_SECTION(section));
 
+	result = parsedeferred(msg, section);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
 	msg->cursors[section] = ISC_LIST_HEAD(msg->sections[section]);
 
 	if (msg->cursors[section] == NULL) {
@@ -2456,6 +2733,11 @@ dns_message_findname(dns_message_t *msg, dns_section_t section,
 		REQUIRE(rdataset == NULL || *rdataset == NULL);
 	}
 
+	result = parsedeferred(msg, section);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
 	result = findname(&foundname, target, &msg->sections[section]);
 
 	if (result == ISC_R_NOTFOUND) {
@@ -2707,9 +2989,11 @@ dns_message_reply(dns_message_t *msg, bool want_question_section) {
 		msg->query.base = msg->saved.base;
 		msg->query.length = msg->saved.length;
 		msg->free_query = msg->free_saved;
+		msg->clone_query = msg->clone_saved;
 		msg->saved.base = NULL;
 		msg->saved.length = 0;
 		msg->free_saved = 0;
+		msg->clone_saved = 0;
 	}
 
 	return (ISC_R_SUCCESS);
@@ -3271,6 +3555,11 @@ dns_message_sectiontotext(dns_message_t *msg, dns_section_t section,
 
 	saved_count = msg->indent.count;
 
+	result = parsedeferred(msg, section);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
 	if (ISC_LIST_EMPTY(msg->sections[section])) {
 		goto cleanup;
 	}
@@ -4665,17 +4954,29 @@ void
 dns_message_clonebuffer(dns_message_t *msg) {
 	REQUIRE(DNS_MESSAGE_VALID(msg));
 
-	if (msg->free_saved == 0 && msg->saved.base != NULL) {
-		msg->saved.base =
-			memmove(isc_mem_get(msg->mctx, msg->saved.length),
+	if (msg->free_saved == 0 && msg->clone_saved == 0 &&
+	    msg->saved.base != NULL)
+	{
+		if (clonetobuffer(msg, &msg->saved)) {
+			msg->clone_saved = 1;
+		} else {
+			msg->saved.base = memmove(
+				isc_mem_get(msg->mctx, msg->saved.length),
 				msg->saved.base, msg->saved.length);
-		msg->free_saved = 1;
+			msg->free_saved = 1;
+		}
 	}
-	if (msg->free_query == 0 && msg->query.base != NULL) {
-		msg->query.base =
-			memmove(isc_mem_get(msg->mctx, msg->query.length),
+	if (msg->free_query == 0 && msg->clone_query == 0 &&
+	    msg->query.base != NULL)
+	{
+		if (clonetobuffer(msg, &msg->query)) {
+			msg->clone_query = 1;
+		} else {
+			msg->query.base = memmove(
+				isc_mem_get(msg->mctx, msg->query.length),
 				msg->query.base, msg->query.length);
-		msg->free_query = 1;
+			msg->free_query = 1;
+		}
 	}
 }
 
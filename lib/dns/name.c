@@ -1519,6 +1519,34 @@ set_offsets(const dns_name_t *name, unsigned char *offsets,
 	INSIST(offset == name->length);
 }
 
+/*
+ * Copy a run of labels for dns_name_fromwire(). The runs between
+ * compression pointers are usually short, so small copies are done
+ * inline with possibly overlapping word-sized moves (all loads before
+ * any stores, so this is as safe as memmove()) instead of calling
+ * memmove(). Label lengths are < 64 so tolower() does not affect them.
+ */
+static void
+copy_labels(uint8_t *dest, const uint8_t *src, uint32_t len, bool downcase) {
+	if (downcase) {
+		isc_ascii_lowercopy(dest, src, len);
+	} else if (len >= 8 && len <= 16) {
+		uint64_t head, tail;
+		memmove(&head, src, sizeof(head));
+		memmove(&tail, src + len - 8, sizeof(tail));
+		memmove(dest, &head, sizeof(head));
+		memmove(dest + len - 8, &tail, sizeof(tail));
+	} else if (len >= 4 && len < 8) {
+		uint32_t head, tail;
+		memmove(&head, src, sizeof(head));
+		memmove(&tail, src + len - 4, sizeof(tail));
+		memmove(dest, &head, sizeof(head));
+		memmove(dest + len - 4, &tail, sizeof(tail));
+	} else {
+		memmove(dest, src, len);
+	}
+}
+
 isc_result_t
 dns_name_fromwire(dns_name_t *const name, isc_buffer_t *const source,
 		  const dns_decompress_t dctx, unsigned int options,
@@ -1574,12 +1602,13 @@ dns_name_fromwire(dns_name_t *const name, isc_buffer_t *const source,
 	 * correct way to set our "consumed" variable.
 	 */
 
-	REQUIRE((options & DNS_NAME_DOWNCASE) == 0);
 	REQUIRE(VALID_NAME(name));
 	REQUIRE(BINDABLE(name));
 	REQUIRE((target != NULL && ISC_BUFFER_VALID(target)) ||
 		(target == NULL && ISC_BUFFER_VALID(name->buffer)));
 
+	const bool downcase = (options & DNS_NAME_DOWNCASE) != 0;
+
 	if (target == NULL && name->buffer != NULL) {
 		target = name->buffer;
 		isc_buffer_clear(target);
@@ -1664,7 +1693,7 @@ dns_name_fromwire(dns_name_t *const name, isc_buffer_t *const source,
 			}
 			const uint32_t copy_len = (cursor - 2) - marker;
 			uint8_t *const dest = name_buf + name_len - copy_len;
-			memmove(dest, marker, copy_len);
+			copy_labels(dest, marker, copy_len, downcase);
 			consumed = consumed != NULL ? consumed : cursor;
 			/* it's just a jump to the left */
 			cursor = marker = pointer;
@@ -1677,7 +1706,7 @@ root_label:;
 	 * from the marker up to and including the root label.
 	 */
 	const uint32_t copy_len = cursor - marker;
-	memmove(name_buf + name_len - copy_len, marker, copy_len);
+	copy_labels(name_buf + name_len - copy_len, marker, copy_len, downcase);
 	consumed = consumed != NULL ? consumed : cursor;
 	isc_buffer_forward(source, consumed - start);
 
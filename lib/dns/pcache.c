@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <isc/buffer.h>
+#include <isc/hash.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/util.h>
+
+#include <dns/name.h>
+#include <dns/pcache.h>
+#include <dns/types.h>
+
+#define PCACHE_MAGIC	ISC_MAGIC('P', 'c', 'h', 'e')
+#define VALID_PCACHE(p) ISC_MAGIC_VALID(p, PCACHE_MAGIC)
+
+/*
+ * Number of locks protecting the table; slot 'i' is protected by
+ * lock 'i & (nlocks - 1)'.
+ */
+#define PCACHE_NLOCKS 64
+
+typedef struct dns_pcentry dns_pcentry_t;
+
+struct dns_pcentry {
+	uint64_t	 generation;
+	uint32_t	 serial;
+	uint32_t	 aux;
+	isc_stdtime_t	 expire;
+	uint32_t	 hashval;
+	uint32_t	 attributes;
+	dns_rdatatype_t	 qtype;
+	dns_rdataclass_t qclass;
+	uint16_t	 udpsize;
+	uint16_t	 namelen;
+	uint16_t	 wirelen;
+	unsigned char	 data[]; /* question name followed by the response */
+};
+
+struct dns_pcache {
+	unsigned int	magic;
+	isc_mem_t      *mctx;
+	unsigned int	size;
+	unsigned int	nlocks;
+	isc_mutex_t    *locks;
+	dns_pcentry_t **table;
+};
+
+static uint32_t
+pcache_hash(const dns_pcachekey_t *key) {
+	unsigned char buf[DNS_NAME_MAXWIRE + 10];
+	isc_buffer_t b;
+
+	isc_buffer_init(&b, buf, sizeof(buf));
+	isc_buffer_putmem(&b, key->qname->ndata, key->qname->length);
+	isc_buffer_putuint16(&b, key->qtype);
+	isc_buffer_putuint16(&b, key->qclass);
+	isc_buffer_putuint16(&b, key->udpsize);
+	isc_buffer_putuint32(&b, key->attributes);
+
+	return (isc_hash32(buf, isc_buffer_usedlength(&b), true));
+}
+
+static bool
+pcache_match(const dns_pcentry_t *entry, const dns_pcachekey_t *key,
+	     uint32_t hashval) {
+	return (entry->hashval == hashval && entry->qtype == key->qtype &&
+		entry->qclass == key->qclass &&
+		entry->udpsize == key->udpsize &&
+		entry->attributes == key->attributes &&
+		entry->namelen == key->qname->length &&
+		memcmp(entry->data, key->qname->ndata, entry->namelen) == 0);
+}
+
+static void
+pcache_free(dns_pcache_t *pcache, dns_pcentry_t **entryp) {
+	dns_pcentry_t *entry = *entryp;
+
+	*entryp = NULL;
+	isc_mem_put(pcache->mctx, entry,
+		    sizeof(*entry) + entry->namelen + entry->wirelen);
+}
+
+void
+dns_pcache_create(isc_mem_t *mctx, unsigned int size, dns_pcache_t **pcachep) {
+	dns_pcache_t *pcache = NULL;
+	unsigned int tablesize = 1;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(size > 0);
+	REQUIRE(pcachep != NULL && *pcachep == NULL);
+
+	while (tablesize < size && tablesize < (1U << 24)) {
+		tablesize <<= 1;
+	}
+
+	pcache = isc_mem_get(mctx, sizeof(*pcache));
+	*pcache = (dns_pcache_t){
+		.size = tablesize,
+		.nlocks = ISC_MIN(tablesize, PCACHE_NLOCKS),
+	};
+
+	isc_mem_attach(mctx, &pcache->mctx);
+
+	pcache->table = isc_mem_getx(pcache->mctx,
+				     sizeof(pcache->table[0]) * pcache->size,
+				     ISC_MEM_ZERO);
+	pcache->locks = isc_mem_get(pcache->mctx,
+				    sizeof(pcache->locks[0]) * pcache->nlocks);
+	for (unsigned int i = 0; i < pcache->nlocks; i++) {
+		isc_mutex_init(&pcache->locks[i]);
+	}
+
+	pcache->magic = PCACHE_MAGIC;
+
+	*pcachep = pcache;
+}
+
+void
+dns_pcache_destroy(dns_pcache_t **pcachep) {
+	dns_pcache_t *pcache = NULL;
+
+	REQUIRE(pcachep != NULL && VALID_PCACHE(*pcachep));
+
+	pcache = *pcachep;
+	*pcachep = NULL;
+
+	dns_pcache_flush(pcache);
+
+	pcache->magic = 0;
+	for (unsigned int i = 0; i < pcache->nlocks; i++) {
+		isc_mutex_destroy(&pcache->locks[i]);
+	}
+	isc_mem_put(pcache->mctx, pcache->locks,
+		    sizeof(pcache->locks[0]) * pcache->nlocks);
+	isc_mem_put(pcache->mctx, pcache->table,
+		    sizeof(pcache->table[0]) * pcache->size);
+	isc_mem_putanddetach(&pcache->mctx, pcache, sizeof(*pcache));
+}
+
+void
+dns_pcache_add(dns_pcache_t *pcache, const dns_pcachekey_t *key,
+	       uint64_t generation, uint32_t serial, uint32_t aux,
+	       const isc_region_t *wire, isc_stdtime_t now) {
+	dns_pcentry_t *entry = NULL, *old = NULL;
+	unsigned int slot;
+	isc_mutex_t *lock = NULL;
+
+	REQUIRE(VALID_PCACHE(pcache));
+	REQUIRE(key != NULL && key->qname != NULL);
+	REQUIRE(wire != NULL);
+	REQUIRE(generation != 0);
+
+	if (wire->length > UINT16_MAX) {
+		return;
+	}
+
+	/*
+	 * Build the new entry before taking the lock.
+	 */
+	entry = isc_mem_get(pcache->mctx,
+			    sizeof(*entry) + key->qname->length + wire->length);
+	*entry = (dns_pcentry_t){
+		.generation = generation,
+		.serial = serial,
+		.aux = aux,
+		.expire = now + DNS_PCACHE_LIFETIME,
+		.hashval = pcache_hash(key),
+		.attributes = key->attributes,
+		.qtype = key->qtype,
+		.qclass = key->qclass,
+		.udpsize = key->udpsize,
+		.namelen = key->qname->length,
+		.wirelen = wire->length,
+	};
+	memmove(entry->data, key->qname->ndata, entry->namelen);
+	memmove(entry->data + entry->namelen, wire->base, entry->wirelen);
+
+	slot = entry->hashval & (pcache->size - 1);
+	lock = &pcache->locks[slot & (pcache->nlocks - 1)];
+
+	LOCK(lock);
+	old = pcache->table[slot];
+	pcache->table[slot] = entry;
+	UNLOCK(lock);
+
+	if (old != NULL) {
+		pcache_free(pcache, &old);
+	}
+}
+
+isc_result_t
+dns_pcache_find(dns_pcache_t *pcache, const dns_pcachekey_t *key,
+		uint64_t generation, uint32_t serial, isc_stdtime_t now,
+		isc_buffer_t *target, uint32_t *auxp) {
+	isc_result_t result = ISC_R_NOTFOUND;
+	dns_pcentry_t *entry = NULL, *stale = NULL;
+	uint32_t hashval;
+	unsigned int slot;
+	isc_mutex_t *lock = NULL;
+
+	REQUIRE(VALID_PCACHE(pcache));
+	REQUIRE(key != NULL && key->qname != NULL);
+	REQUIRE(target != NULL);
+
+	hashval = pcache_hash(key);
+	slot = hashval & (pcache->size - 1);
+	lock = &pcache->locks[slot & (pcache->nlocks - 1)];
+
+	LOCK(lock);
+	entry = pcache->table[slot];
+	if (entry == NULL || !pcache_match(entry, key, hashval)) {
+		goto unlock;
+	}
+
+	if (entry->generation != generation || entry->serial != serial ||
+	    entry->expire < now)
+	{
+		stale = entry;
+		pcache->table[slot] = NULL;
+		goto unlock;
+	}
+
+	if (entry->wirelen > isc_buffer_availablelength(target)) {
+		result = ISC_R_NOSPACE;
+		goto unlock;
+	}
+
+	isc_buffer_putmem(target, entry->data + entry->namelen,
+			  entry->wirelen);
+	if (auxp != NULL) {
+		*auxp = entry->aux;
+	}
+	result = ISC_R_SUCCESS;
+
+unlock:
+	UNLOCK(lock);
+
+	if (stale != NULL) {
+		pcache_free(pcache, &stale);
+	}
+
+	return (result);
+}
+
+void
+dns_pcache_flush(dns_pcache_t *pcache) {
+	REQUIRE(VALID_PCACHE(pcache));
+
+	for (unsigned int i = 0; i < pcache->size; i++) {
+		isc_mutex_t *lock = &pcache->locks[i & (pcache->nlocks - 1)];
+		dns_pcentry_t *entry = NULL;
+
+		LOCK(lock);
+		entry = pcache->table[i];
+		pcache->table[i] = NULL;
+		UNLOCK(lock);
+
+		if (entry != NULL) {
+			pcache_free(pcache, &entry);
+		}
+	}
+}
@@ -0,0 +1,838 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/result.h>
+#include <isc/util.h>
+
+#include <dns/name.h>
+#include <dns/qp.h>
+#include <dns/types.h>
+
+#define QP_MAGIC     ISC_MAGIC('t', 'r', 'i', 'e')
+#define VALID_QP(qp) ISC_MAGIC_VALID(qp, QP_MAGIC)
+
+#define QPITER_MAGIC	ISC_MAGIC('q', 'p', 'i', 't')
+#define VALID_QPITER(i) ISC_MAGIC_VALID(i, QPITER_MAGIC)
+
+/*
+ * A node is two words.  In a leaf, the first word is the pointer value
+ * and the second is the integer value.  In a branch, the first word
+ * holds the branch tag in bit 0, the bitmap of the twigs that are
+ * present in bits 1 to 46, and the offset of the key symbol that the
+ * branch tests in bits 48 to 63; the second word points to the twigs.
+ */
+struct dns_qpnode {
+	uint64_t index;
+	union {
+		dns_qpnode_t *twigs;
+		uint32_t ival;
+	};
+};
+
+#define BRANCH_TAG   1ULL
+#define BITMAP_MASK  (((1ULL << SHIFT_COUNT) - 1) << 1)
+#define OFFSET_SHIFT 48
+
+/*
+ * Key symbols.  SHIFT_NOBYTE ends a label, and is also the value of
+ * every position past the end of a key, so that a name sorts before
+ * its descendants.  The commonest hostname characters get a symbol of
+ * their own; every other octet is converted to an escape symbol
+ * followed by a second symbol.  Upper case letters are converted to
+ * the same symbols as lower case letters.  The symbols are allocated
+ * in octet order, so keys sort in the DNSSEC canonical order.
+ */
+#define SHIFT_NOBYTE 0
+#define SHIFT_COUNT  46
+
+/*
+ * The symbols for each octet: the first in the low byte and the second,
+ * if any, in the high byte.
+ */
+static const uint16_t symbols_for_byte[256] = {
+	0x0101, 0x0201, 0x0301, 0x0401, 0x0501, 0x0601, 0x0701, 0x0801,
+	0x0901, 0x0a01, 0x0b01, 0x0c01, 0x0d01, 0x0e01, 0x0f01, 0x1001,
+	0x1101, 0x1201, 0x1301, 0x1401, 0x1501, 0x1601, 0x1701, 0x1801,
+	0x1901, 0x1a01, 0x1b01, 0x1c01, 0x1d01, 0x1e01, 0x1f01, 0x2001,
+	0x2101, 0x2201, 0x2301, 0x2401, 0x2501, 0x2601, 0x2701, 0x2801,
+	0x2901, 0x2a01, 0x2b01, 0x2c01, 0x2d01, 0x0002, 0x0103, 0x0203,
+	0x0004, 0x0005, 0x0006, 0x0007, 0x0008, 0x0009, 0x000a, 0x000b,
+	0x000c, 0x000d, 0x010e, 0x020e, 0x030e, 0x040e, 0x050e, 0x060e,
+	0x070e, 0x0011, 0x0012, 0x0013, 0x0014, 0x0015, 0x0016, 0x0017,
+	0x0018, 0x0019, 0x001a, 0x001b, 0x001c, 0x001d, 0x001e, 0x001f,
+	0x0020, 0x0021, 0x0022, 0x0023, 0x0024, 0x0025, 0x0026, 0x0027,
+	0x0028, 0x0029, 0x002a, 0x080e, 0x090e, 0x0a0e, 0x0b0e, 0x000f,
+	0x0110, 0x0011, 0x0012, 0x0013, 0x0014, 0x0015, 0x0016, 0x0017,
+	0x0018, 0x0019, 0x001a, 0x001b, 0x001c, 0x001d, 0x001e, 0x001f,
+	0x0020, 0x0021, 0x0022, 0x0023, 0x0024, 0x0025, 0x0026, 0x0027,
+	0x0028, 0x0029, 0x002a, 0x012b, 0x022b, 0x032b, 0x042b, 0x052b,
+	0x062b, 0x072b, 0x082b, 0x092b, 0x0a2b, 0x0b2b, 0x0c2b, 0x0d2b,
+	0x0e2b, 0x0f2b, 0x102b, 0x112b, 0x122b, 0x132b, 0x142b, 0x152b,
+	0x162b, 0x172b, 0x182b, 0x192b, 0x1a2b, 0x1b2b, 0x1c2b, 0x1d2b,
+	0x1e2b, 0x1f2b, 0x202b, 0x212b, 0x222b, 0x232b, 0x242b, 0x252b,
+	0x262b, 0x272b, 0x282b, 0x292b, 0x2a2b, 0x2b2b, 0x2c2b, 0x2d2b,
+	0x2e2b, 0x012c, 0x022c, 0x032c, 0x042c, 0x052c, 0x062c, 0x072c,
+	0x082c, 0x092c, 0x0a2c, 0x0b2c, 0x0c2c, 0x0d2c, 0x0e2c, 0x0f2c,
+	0x102c, 0x112c, 0x122c, 0x132c, 0x142c, 0x152c, 0x162c, 0x172c,
+	0x182c, 0x192c, 0x1a2c, 0x1b2c, 0x1c2c, 0x1d2c, 0x1e2c, 0x1f2c,
+	0x202c, 0x212c, 0x222c, 0x232c, 0x242c, 0x252c, 0x262c, 0x272c,
+	0x282c, 0x292c, 0x2a2c, 0x2b2c, 0x2c2c, 0x2d2c, 0x2e2c, 0x012d,
+	0x022d, 0x032d, 0x042d, 0x052d, 0x062d, 0x072d, 0x082d, 0x092d,
+	0x0a2d, 0x0b2d, 0x0c2d, 0x0d2d, 0x0e2d, 0x0f2d, 0x102d, 0x112d,
+	0x122d, 0x132d, 0x142d, 0x152d, 0x162d, 0x172d, 0x182d, 0x192d,
+	0x1a2d, 0x1b2d, 0x1c2d, 0x1d2d, 0x1e2d, 0x1f2d, 0x202d, 0x212d,
+	0x222d, 0x232d, 0x242d, 0x252d, 0x262d, 0x272d, 0x282d, 0x292d,
+};
+
+struct dns_qp {
+	unsigned int	       magic;
+	isc_mem_t	      *mctx;
+	const dns_qpmethods_t *methods;
+	void		      *uctx;
+	size_t		       leaves;
+	dns_qpnode_t	       root;
+};
+
+/*
+ * Node accessors.
+ */
+
+static bool
+is_branch(const dns_qpnode_t *n) {
+	return ((n->index & BRANCH_TAG) != 0);
+}
+
+static void *
+leaf_pval(const dns_qpnode_t *n) {
+	return ((void *)(uintptr_t)n->index);
+}
+
+static size_t
+branch_offset(const dns_qpnode_t *n) {
+	return ((size_t)(n->index >> OFFSET_SHIFT));
+}
+
+static uint64_t
+symbol_bit(uint8_t symbol) {
+	return (1ULL << (symbol + 1));
+}
+
+static uint64_t
+key_bit(const uint8_t *key, size_t keylen, size_t offset) {
+	return (symbol_bit(offset < keylen ? key[offset] : SHIFT_NOBYTE));
+}
+
+static unsigned int
+branch_twigs_size(const dns_qpnode_t *n) {
+	return (__builtin_popcountll(n->index & BITMAP_MASK));
+}
+
+static unsigned int
+branch_twig_pos(const dns_qpnode_t *n, uint64_t bit) {
+	return (__builtin_popcountll(n->index & BITMAP_MASK & (bit - 1)));
+}
+
+static bool
+branch_has_twig(const dns_qpnode_t *n, uint64_t bit) {
+	return ((n->index & bit) != 0);
+}
+
+static dns_qpnode_t *
+branch_twig(const dns_qpnode_t *n, uint64_t bit) {
+	return (&n->twigs[branch_twig_pos(n, bit)]);
+}
+
+static dns_qpnode_t
+make_leaf(void *pval, uint32_t ival) {
+	return ((dns_qpnode_t){ .index = (uint64_t)(uintptr_t)pval,
+				.ival = ival });
+}
+
+static dns_qpnode_t
+make_branch(uint64_t bitmap, size_t offset, dns_qpnode_t *twigs) {
+	return ((dns_qpnode_t){ .index = BRANCH_TAG | bitmap |
+					 ((uint64_t)offset << OFFSET_SHIFT),
+				.twigs = twigs });
+}
+
+/*
+ * Keys.
+ */
+
+size_t
+dns_qpkey_fromname(dns_qpkey_t key, const dns_name_t *name) {
+	dns_offsets_t offsets;
+	unsigned int labels = 0;
+	size_t len = 0;
+
+	REQUIRE(dns_name_isabsolute(name));
+
+	for (unsigned int off = 0; name->ndata[off] != 0;
+	     off += name->ndata[off] + 1)
+	{
+		offsets[labels++] = off;
+	}
+
+	while (labels-- > 0) {
+		const unsigned char *label = &name->ndata[offsets[labels]];
+		unsigned int count = *label++;
+
+		while (count-- > 0) {
+			uint16_t symbols = symbols_for_byte[*label++];
+			key[len++] = symbols & 0xff;
+			if (symbols > 0xff) {
+				key[len++] = symbols >> 8;
+			}
+		}
+		key[len++] = SHIFT_NOBYTE;
+	}
+
+	INSIST(len <= DNS_QP_MAXKEY);
+	return (len);
+}
+
+/*
+ * Return the offset of the first symbol that differs between two keys,
+ * or the length of the longer key if they are equal.
+ */
+static size_t
+key_compare(const uint8_t *key1, size_t len1, const uint8_t *key2,
+	    size_t len2) {
+	size_t len = ISC_MIN(len1, len2);
+	size_t max = ISC_MAX(len1, len2);
+	size_t i = 0;
+
+	while (i < len && key1[i] == key2[i]) {
+		i++;
+	}
+	if (i < len) {
+		return (i);
+	}
+	while (i < max && (i < len1 ? key1[i] : key2[i]) == SHIFT_NOBYTE) {
+		i++;
+	}
+	return (i);
+}
+
+static size_t
+leaf_key(dns_qp_t *qp, const dns_qpnode_t *n, dns_qpkey_t key) {
+	size_t len = qp->methods->makekey(key, qp->uctx, leaf_pval(n), n->ival);
+	INSIST(len <= DNS_QP_MAXKEY);
+	return (len);
+}
+
+static void
+attach_leaf(dns_qp_t *qp, const dns_qpnode_t *n) {
+	if (qp->methods->attach != NULL) {
+		qp->methods->attach(qp->uctx, leaf_pval(n), n->ival);
+	}
+}
+
+static void
+detach_leaf(dns_qp_t *qp, const dns_qpnode_t *n) {
+	if (qp->methods->detach != NULL) {
+		qp->methods->detach(qp->uctx, leaf_pval(n), n->ival);
+	}
+}
+
+static dns_qpnode_t *
+twigs_get(dns_qp_t *qp, unsigned int size) {
+	return (isc_mem_get(qp->mctx, size * sizeof(dns_qpnode_t)));
+}
+
+static void
+twigs_put(dns_qp_t *qp, dns_qpnode_t *twigs, unsigned int size) {
+	isc_mem_put(qp->mctx, twigs, size * sizeof(dns_qpnode_t));
+}
+
+/*
+ * Creation and destruction.
+ */
+
+void
+dns_qp_create(isc_mem_t *mctx, const dns_qpmethods_t *methods, void *uctx,
+	      dns_qp_t **qpp) {
+	dns_qp_t *qp = NULL;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(methods != NULL && methods->makekey != NULL);
+	REQUIRE(qpp != NULL && *qpp == NULL);
+
+	qp = isc_mem_get(mctx, sizeof(*qp));
+	*qp = (dns_qp_t){
+		.methods = methods,
+		.uctx = uctx,
+	};
+	isc_mem_attach(mctx, &qp->mctx);
+	qp->magic = QP_MAGIC;
+
+	*qpp = qp;
+}
+
+static void
+destroy_node(dns_qp_t *qp, dns_qpnode_t *n) {
+	if (is_branch(n)) {
+		unsigned int size = branch_twigs_size(n);
+		for (unsigned int i = 0; i < size; i++) {
+			destroy_node(qp, &n->twigs[i]);
+		}
+		twigs_put(qp, n->twigs, size);
+	} else {
+		detach_leaf(qp, n);
+	}
+}
+
+void
+dns_qp_destroy(dns_qp_t **qpp) {
+	dns_qp_t *qp = NULL;
+
+	REQUIRE(qpp != NULL && VALID_QP(*qpp));
+
+	qp = *qpp;
+	*qpp = NULL;
+
+	if (qp->leaves > 0) {
+		destroy_node(qp, &qp->root);
+	}
+	qp->magic = 0;
+	isc_mem_putanddetach(&qp->mctx, qp, sizeof(*qp));
+}
+
+/*
+ * Modification.
+ */
+
+isc_result_t
+dns_qp_insert(dns_qp_t *qp, void *pval, uint32_t ival) {
+	dns_qpkey_t newkey, oldkey;
+	size_t newlen, oldlen, offset;
+	dns_qpnode_t newleaf, *n = NULL, *twigs = NULL;
+	uint64_t newbit, oldbit;
+
+	REQUIRE(VALID_QP(qp));
+	REQUIRE(((uintptr_t)pval & BRANCH_TAG) == 0);
+
+	newleaf = make_leaf(pval, ival);
+	newlen = leaf_key(qp, &newleaf, newkey);
+
+	if (qp->leaves == 0) {
+		qp->root = newleaf;
+		goto added;
+	}
+
+	/*
+	 * Find any leaf that shares the longest possible prefix with
+	 * the new key: where the new key's twig is missing, any twig
+	 * will do, because all the leaves below a branch share the
+	 * prefix up to the branch's offset.
+	 */
+	n = &qp->root;
+	while (is_branch(n)) {
+		uint64_t bit = key_bit(newkey, newlen, branch_offset(n));
+		n = branch_has_twig(n, bit) ? branch_twig(n, bit)
+					    : &n->twigs[0];
+	}
+	oldlen = leaf_key(qp, n, oldkey);
+	offset = key_compare(newkey, newlen, oldkey, oldlen);
+	if (offset == ISC_MAX(newlen, oldlen)) {
+		return (ISC_R_EXISTS);
+	}
+	newbit = key_bit(newkey, newlen, offset);
+	oldbit = key_bit(oldkey, oldlen, offset);
+
+	/*
+	 * Find where the new leaf belongs: either in an existing branch
+	 * at the offset of the difference, or in a new branch above the
+	 * first node whose offset is beyond it.
+	 */
+	n = &qp->root;
+	while (is_branch(n)) {
+		size_t boff = branch_offset(n);
+		if (boff == offset) {
+			unsigned int size = branch_twigs_size(n);
+			unsigned int pos = branch_twig_pos(n, newbit);
+
+			INSIST(!branch_has_twig(n, newbit));
+			twigs = twigs_get(qp, size + 1);
+			memmove(twigs, n->twigs, pos * sizeof(twigs[0]));
+			twigs[pos] = newleaf;
+			memmove(twigs + pos + 1, n->twigs + pos,
+				(size - pos) * sizeof(twigs[0]));
+			twigs_put(qp, n->twigs, size);
+			*n = make_branch((n->index & BITMAP_MASK) | newbit, boff,
+					 twigs);
+			goto added;
+		}
+		if (boff > offset) {
+			break;
+		}
+		n = branch_twig(n, key_bit(newkey, newlen, boff));
+	}
+
+	twigs = twigs_get(qp, 2);
+	if (newbit < oldbit) {
+		twigs[0] = newleaf;
+		twigs[1] = *n;
+	} else {
+		twigs[0] = *n;
+		twigs[1] = newleaf;
+	}
+	*n = make_branch(newbit | oldbit, offset, twigs);
+
+added:
+	qp->leaves++;
+	attach_leaf(qp, &newleaf);
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_qp_deletekey(dns_qp_t *qp, const dns_qpkey_t key, size_t keylen) {
+	dns_qpkey_t found;
+	size_t foundlen;
+	dns_qpnode_t *n = NULL, *parent = NULL, leaf;
+	uint64_t bit = 0;
+
+	REQUIRE(VALID_QP(qp));
+	REQUIRE(keylen <= DNS_QP_MAXKEY);
+
+	if (qp->leaves == 0) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	n = &qp->root;
+	while (is_branch(n)) {
+		bit = key_bit(key, keylen, branch_offset(n));
+		if (!branch_has_twig(n, bit)) {
+			return (ISC_R_NOTFOUND);
+		}
+		parent = n;
+		n = branch_twig(n, bit);
+	}
+
+	foundlen = leaf_key(qp, n, found);
+	if (key_compare(key, keylen, found, foundlen) !=
+	    ISC_MAX(keylen, foundlen))
+	{
+		return (ISC_R_NOTFOUND);
+	}
+
+	leaf = *n;
+	if (parent == NULL) {
+		qp->root = (dns_qpnode_t){ 0 };
+	} else {
+		dns_qpnode_t *twigs = parent->twigs;
+		unsigned int size = branch_twigs_size(parent);
+		unsigned int pos = branch_twig_pos(parent, bit);
+
+		if (size == 2) {
+			/* The remaining twig replaces its parent */
+			*parent = twigs[1 - pos];
+			twigs_put(qp, twigs, 2);
+		} else {
+			dns_qpnode_t *newtwigs = twigs_get(qp, size - 1);
+			memmove(newtwigs, twigs, pos * sizeof(twigs[0]));
+			memmove(newtwigs + pos, twigs + pos + 1,
+				(size - pos - 1) * sizeof(twigs[0]));
+			twigs_put(qp, twigs, size);
+			*parent = make_branch((parent->index & BITMAP_MASK) &
+						      ~bit,
+					      branch_offset(parent), newtwigs);
+		}
+	}
+
+	qp->leaves--;
+	detach_leaf(qp, &leaf);
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_qp_deletename(dns_qp_t *qp, const dns_name_t *name) {
+	dns_qpkey_t key;
+	size_t keylen = dns_qpkey_fromname(key, name);
+	return (dns_qp_deletekey(qp, key, keylen));
+}
+
+/*
+ * Lookups.
+ */
+
+static void
+found_leaf(const dns_qpnode_t *n, void **pvalp, uint32_t *ivalp) {
+	if (pvalp != NULL) {
+		*pvalp = leaf_pval(n);
+	}
+	if (ivalp != NULL) {
+		*ivalp = n->ival;
+	}
+}
+
+isc_result_t
+dns_qp_getkey(dns_qp_t *qp, const dns_qpkey_t key, size_t keylen,
+	      void **pvalp, uint32_t *ivalp) {
+	dns_qpkey_t found;
+	size_t foundlen;
+	dns_qpnode_t *n = NULL;
+
+	REQUIRE(VALID_QP(qp));
+	REQUIRE(keylen <= DNS_QP_MAXKEY);
+
+	if (qp->leaves == 0) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	n = &qp->root;
+	while (is_branch(n)) {
+		uint64_t bit = key_bit(key, keylen, branch_offset(n));
+		if (!branch_has_twig(n, bit)) {
+			return (ISC_R_NOTFOUND);
+		}
+		n = branch_twig(n, bit);
+	}
+
+	foundlen = leaf_key(qp, n, found);
+	if (key_compare(key, keylen, found, foundlen) !=
+	    ISC_MAX(keylen, foundlen))
+	{
+		return (ISC_R_NOTFOUND);
+	}
+
+	found_leaf(n, pvalp, ivalp);
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_qp_getname(dns_qp_t *qp, const dns_name_t *name, void **pvalp,
+	       uint32_t *ivalp) {
+	dns_qpkey_t key;
+	size_t keylen = dns_qpkey_fromname(key, name);
+	return (dns_qp_getkey(qp, key, keylen, pvalp, ivalp));
+}
+
+isc_result_t
+dns_qp_findname_ancestor(dns_qp_t *qp, const dns_name_t *name, void **pvalp,
+			 uint32_t *ivalp) {
+	dns_qpkey_t key, found;
+	size_t keylen, foundlen, match;
+	dns_qpnode_t *n = NULL;
+	struct {
+		dns_qpnode_t *leaf;
+		size_t offset;
+	} candidates[129];
+	unsigned int ncandidates = 0;
+
+	REQUIRE(VALID_QP(qp));
+
+	keylen = dns_qpkey_fromname(key, name);
+
+	if (qp->leaves == 0) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	/*
+	 * On the way down, a branch that tests the symbol after the end
+	 * of a label of the search key and has a SHIFT_NOBYTE twig can
+	 * only lead to the ancestor with that many labels.  Remember
+	 * those leaves: they are checked once the length of the prefix
+	 * shared with the search key is known.
+	 */
+	n = &qp->root;
+	while (is_branch(n)) {
+		size_t offset = branch_offset(n);
+		uint64_t bit;
+
+		if (offset <= keylen &&
+		    (offset == 0 || key[offset - 1] == SHIFT_NOBYTE))
+		{
+			bit = symbol_bit(SHIFT_NOBYTE);
+			if (branch_has_twig(n, bit) &&
+			    !is_branch(branch_twig(n, bit)))
+			{
+				INSIST(ncandidates < ARRAY_SIZE(candidates));
+				candidates[ncandidates].leaf =
+					branch_twig(n, bit);
+				candidates[ncandidates].offset = offset;
+				ncandidates++;
+			}
+		}
+
+		bit = key_bit(key, keylen, offset);
+		if (!branch_has_twig(n, bit)) {
+			break;
+		}
+		n = branch_twig(n, bit);
+	}
+
+	/*
+	 * All the leaves below the node we stopped at share their prefix
+	 * with the leaves below every branch we passed through.
+	 */
+	while (is_branch(n)) {
+		n = &n->twigs[0];
+	}
+	foundlen = leaf_key(qp, n, found);
+	match = key_compare(key, keylen, found, foundlen);
+
+	if (foundlen <= keylen && match >= foundlen) {
+		found_leaf(n, pvalp, ivalp);
+		return (foundlen == keylen ? ISC_R_SUCCESS
+					   : DNS_R_PARTIALMATCH);
+	}
+
+	while (ncandidates-- > 0) {
+		if (candidates[ncandidates].offset <= match) {
+			found_leaf(candidates[ncandidates].leaf, pvalp, ivalp);
+			return (candidates[ncandidates].offset == keylen
+					? ISC_R_SUCCESS
+					: DNS_R_PARTIALMATCH);
+		}
+	}
+
+	return (ISC_R_NOTFOUND);
+}
+
+/*
+ * Find the leaf with the smallest key of the subtrie 'n', or the largest
+ * one if 'last' is true.
+ */
+static dns_qpnode_t *
+edge_leaf(dns_qpnode_t *n, bool last) {
+	while (is_branch(n)) {
+		n = last ? &n->twigs[branch_twigs_size(n) - 1] : &n->twigs[0];
+	}
+	return (n);
+}
+
+/*
+ * Find the leaf with the largest key that is smaller than 'key' or, if
+ * 'after' is true, the smallest key that is larger.
+ */
+static isc_result_t
+find_neighbour(dns_qp_t *qp, const dns_qpkey_t key, size_t keylen,
+	       bool after, void **pvalp, uint32_t *ivalp) {
+	dns_qpkey_t found;
+	size_t foundlen, offset;
+	dns_qpnode_t *n = NULL;
+	dns_qpnode_t *stack[DNS_QP_MAXKEY + 1];
+	unsigned int sp = 0;
+	uint64_t keybit;
+	bool exact;
+
+	if (qp->leaves == 0) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	/*
+	 * As in dns_qp_insert(), find a leaf that shares the longest
+	 * possible prefix with the key, and the offset where they differ.
+	 */
+	n = &qp->root;
+	while (is_branch(n)) {
+		uint64_t bit = key_bit(key, keylen, branch_offset(n));
+		n = branch_has_twig(n, bit) ? branch_twig(n, bit)
+					    : &n->twigs[0];
+	}
+	foundlen = leaf_key(qp, n, found);
+	offset = key_compare(key, keylen, found, foundlen);
+	keybit = key_bit(key, keylen, offset);
+
+	/*
+	 * Go down again along the key as far as the offset where it
+	 * differs from the leaf, or all the way if they are equal: the
+	 * twigs on the way are all present.
+	 */
+	exact = (offset == ISC_MAX(keylen, foundlen));
+	n = &qp->root;
+	stack[sp++] = n;
+	while (is_branch(n) && (exact || branch_offset(n) < offset)) {
+		n = branch_twig(n, key_bit(key, keylen, branch_offset(n)));
+		INSIST(sp < ARRAY_SIZE(stack));
+		stack[sp++] = n;
+	}
+
+	if (exact) {
+		/*
+		 * The key is in the trie and 'n' is its leaf, so the
+		 * neighbour is further up.
+		 */
+	} else if (is_branch(n) && branch_offset(n) == offset) {
+		/*
+		 * The key's twig is missing from this branch; the
+		 * neighbour is in the closest twig on the wanted side,
+		 * if there is one.
+		 */
+		unsigned int pos = branch_twig_pos(n, keybit);
+		if (after && pos < branch_twigs_size(n)) {
+			n = edge_leaf(&n->twigs[pos], false);
+			goto found;
+		} else if (!after && pos > 0) {
+			n = edge_leaf(&n->twigs[pos - 1], true);
+			goto found;
+		}
+	} else if ((key_bit(found, foundlen, offset) > keybit) == after) {
+		/*
+		 * All the leaves below 'n' share their prefix with the
+		 * leaf we found, so they are all on the wanted side of
+		 * the key, and the neighbour is the closest of them.
+		 */
+		n = edge_leaf(n, !after);
+		goto found;
+	}
+
+	/*
+	 * The neighbour is not below 'n': go up until there is a twig
+	 * on the wanted side of the one we came from.
+	 */
+	for (;;) {
+		dns_qpnode_t *parent = NULL;
+
+		if (sp == 1) {
+			return (ISC_R_NOTFOUND);
+		}
+		n = stack[--sp];
+		parent = stack[sp - 1];
+		if (after && n + 1 < parent->twigs + branch_twigs_size(parent))
+		{
+			n = edge_leaf(n + 1, false);
+			break;
+		} else if (!after && n > parent->twigs) {
+			n = edge_leaf(n - 1, true);
+			break;
+		}
+	}
+
+found:
+	found_leaf(n, pvalp, ivalp);
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_qp_getname_prev(dns_qp_t *qp, const dns_name_t *name, void **pvalp,
+		    uint32_t *ivalp) {
+	dns_qpkey_t key;
+	size_t keylen;
+
+	REQUIRE(VALID_QP(qp));
+
+	keylen = dns_qpkey_fromname(key, name);
+	return (find_neighbour(qp, key, keylen, false, pvalp, ivalp));
+}
+
+isc_result_t
+dns_qp_getname_next(dns_qp_t *qp, const dns_name_t *name, void **pvalp,
+		    uint32_t *ivalp) {
+	dns_qpkey_t key;
+	size_t keylen;
+
+	REQUIRE(VALID_QP(qp));
+
+	keylen = dns_qpkey_fromname(key, name);
+	return (find_neighbour(qp, key, keylen, true, pvalp, ivalp));
+}
+
+isc_result_t
+dns_qp_getfirst(dns_qp_t *qp, void **pvalp, uint32_t *ivalp) {
+	REQUIRE(VALID_QP(qp));
+
+	if (qp->leaves == 0) {
+		return (ISC_R_NOTFOUND);
+	}
+	found_leaf(edge_leaf(&qp->root, false), pvalp, ivalp);
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_qp_getlast(dns_qp_t *qp, void **pvalp, uint32_t *ivalp) {
+	REQUIRE(VALID_QP(qp));
+
+	if (qp->leaves == 0) {
+		return (ISC_R_NOTFOUND);
+	}
+	found_leaf(edge_leaf(&qp->root, true), pvalp, ivalp);
+	return (ISC_R_SUCCESS);
+}
+
+size_t
+dns_qp_count(dns_qp_t *qp) {
+	REQUIRE(VALID_QP(qp));
+
+	return (qp->leaves);
+}
+
+/*
+ * Iteration.
+ */
+
+void
+dns_qpiter_init(dns_qp_t *qp, dns_qpiter_t *qpi) {
+	REQUIRE(VALID_QP(qp));
+	REQUIRE(qpi != NULL);
+
+	qpi->qp = qp;
+	qpi->sp = 0;
+	qpi->done = (qp->leaves == 0);
+	qpi->magic = QPITER_MAGIC;
+}
+
+isc_result_t
+dns_qpiter_next(dns_qpiter_t *qpi, void **pvalp, uint32_t *ivalp) {
+	dns_qpnode_t *n = NULL;
+
+	REQUIRE(VALID_QPITER(qpi));
+	REQUIRE(VALID_QP(qpi->qp));
+
+	if (qpi->done) {
+		return (ISC_R_NOMORE);
+	}
+
+	if (qpi->sp == 0) {
+		n = &qpi->qp->root;
+	} else {
+		/*
+		 * Go up until there is a twig to the right of the one we
+		 * came from.
+		 */
+		for (;;) {
+			dns_qpnode_t *parent = NULL;
+
+			if (qpi->sp == 1) {
+				qpi->done = true;
+				return (ISC_R_NOMORE);
+			}
+			n = qpi->stack[--qpi->sp];
+			parent = qpi->stack[qpi->sp - 1];
+			if (n + 1 < parent->twigs + branch_twigs_size(parent)) {
+				n++;
+				break;
+			}
+		}
+	}
+
+	/* Go down to the leftmost leaf */
+	qpi->stack[qpi->sp++] = n;
+	while (is_branch(n)) {
+		n = &n->twigs[0];
+		INSIST(qpi->sp < ARRAY_SIZE(qpi->stack));
+		qpi->stack[qpi->sp++] = n;
+	}
+
+	found_leaf(n, pvalp, ivalp);
+	return (ISC_R_SUCCESS);
+}
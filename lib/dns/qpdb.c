@@ -0,0 +1,4291 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+/*
+ * A zone database whose names are kept in a pair of qp-tries: one for
+ * the zone's data and one for its NSEC3 records.
+ *
+ * Unlike the red-black tree database, the tries hold absolute names,
+ * and every ancestor of a name in the zone down from the origin is
+ * present in the main trie (as an empty node if need be).  A lookup is
+ * then a single pass down the trie for the closest enclosing name,
+ * followed by an exact match for each of the few proper ancestors of
+ * the query name that may hold a zone cut or a wildcard.
+ *
+ * A single reader-writer lock protects the tries, the nodes and the
+ * versions; readers only hold it while looking at the data.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/atomic.h>
+#include <isc/heap.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/refcount.h>
+#include <isc/result.h>
+#include <isc/rwlock.h>
+#include <isc/stdtime.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/callbacks.h>
+#include <dns/db.h>
+#include <dns/dbiterator.h>
+#include <dns/fixedname.h>
+#include <dns/masterdump.h>
+#include <dns/nsec3.h>
+#include <dns/qp.h>
+#include <dns/rdata.h>
+#include <dns/rdataset.h>
+#include <dns/rdatasetiter.h>
+#include <dns/rdataslab.h>
+#include <dns/rdatastruct.h>
+#include <dns/time.h>
+#include <dns/zonekey.h>
+
+#include "qpdb.h"
+#include "rdataslab_p.h"
+
+#define QPDB_MAGIC ISC_MAGIC('Q', 'P', 'D', 'B')
+
+/*%
+ * Note that "impmagic" is not the first four bytes of the struct, so
+ * ISC_MAGIC_VALID cannot be used.
+ */
+#define VALID_QPDB(qpdb) \
+	((qpdb) != NULL && (qpdb)->common.impmagic == QPDB_MAGIC)
+
+typedef uint32_t qpdb_serial_t;
+typedef uint32_t qpdb_rdatatype_t;
+
+#define QPDB_RDATATYPE_BASE(type) ((dns_rdatatype_t)((type)&0xFFFF))
+#define QPDB_RDATATYPE_EXT(type)  ((dns_rdatatype_t)((type) >> 16))
+#define QPDB_RDATATYPE_VALUE(base, ext)              \
+	((qpdb_rdatatype_t)(((uint32_t)ext) << 16) | \
+	 (((uint32_t)base) & 0xffff))
+
+#define QPDB_RDATATYPE_SIGNSEC \
+	QPDB_RDATATYPE_VALUE(dns_rdatatype_rrsig, dns_rdatatype_nsec)
+#define QPDB_RDATATYPE_SIGNSEC3 \
+	QPDB_RDATATYPE_VALUE(dns_rdatatype_rrsig, dns_rdatatype_nsec3)
+#define QPDB_RDATATYPE_SIGCNAME \
+	QPDB_RDATATYPE_VALUE(dns_rdatatype_rrsig, dns_rdatatype_cname)
+#define QPDB_RDATATYPE_SIGDNAME \
+	QPDB_RDATATYPE_VALUE(dns_rdatatype_rrsig, dns_rdatatype_dname)
+#define QPDB_RDATATYPE_SIGSOA \
+	QPDB_RDATATYPE_VALUE(dns_rdatatype_rrsig, dns_rdatatype_soa)
+
+/* Fixed RRSet helper macros */
+
+#define DNS_RDATASET_LENGTH 2
+
+#if DNS_RDATASET_FIXED
+#define DNS_RDATASET_ORDER 2
+#define DNS_RDATASET_COUNT (count * 4)
+#else /* !DNS_RDATASET_FIXED */
+#define DNS_RDATASET_ORDER 0
+#define DNS_RDATASET_COUNT 0
+#endif /* DNS_RDATASET_FIXED */
+
+typedef struct qpdb_node qpdb_node_t;
+typedef struct qpdb_header qpdb_header_t;
+
+/*%
+ * The header of an rdataset, followed in memory by its rdataslab.
+ * Everything here is protected by the database lock.
+ */
+struct qpdb_header {
+	qpdb_serial_t serial;
+	dns_ttl_t ttl;
+	qpdb_rdatatype_t type;
+	uint_least16_t attributes;
+	dns_trust_t trust;
+	unsigned int resign_lsb : 1;
+	isc_stdtime_t resign;
+	unsigned int heap_index;
+	/*%<
+	 * Index in the resigning heap, or 0.
+	 */
+
+	qpdb_header_t *next;
+	/*%<
+	 * If this is the top header for an rdataset, 'next' points
+	 * to the top header for the next rdataset (i.e., the next type).
+	 * Otherwise, it points up to the header whose down pointer points
+	 * at this header.
+	 */
+
+	qpdb_header_t *down;
+	/*%<
+	 * Points to the header for the next older version of
+	 * this rdataset.
+	 */
+
+	atomic_uint_fast32_t count;
+	/*%<
+	 * Monotonously increased every time this rdataset is bound so that
+	 * it is used as the base of the starting point in DNS responses
+	 * when the "cyclic" rrset-order is required.
+	 */
+
+	qpdb_node_t *node;
+	ISC_LINK(qpdb_header_t) link;
+	/*%<
+	 * Used to put the header on the list of re-signed headers of a
+	 * version.
+	 */
+};
+
+typedef ISC_LIST(qpdb_header_t) qpdb_headerlist_t;
+
+#define RDATASET_ATTR_NONEXISTENT 0x0001
+#define RDATASET_ATTR_IGNORE	  0x0002
+#define RDATASET_ATTR_RESIGN	  0x0004
+
+#define EXISTS(header) (((header)->attributes & RDATASET_ATTR_NONEXISTENT) == 0)
+#define NONEXISTENT(header) \
+	(((header)->attributes & RDATASET_ATTR_NONEXISTENT) != 0)
+#define IGNORE(header) (((header)->attributes & RDATASET_ATTR_IGNORE) != 0)
+#define RESIGN(header) (((header)->attributes & RDATASET_ATTR_RESIGN) != 0)
+
+/*%
+ * A name in one of the tries.  The node is the value of its leaf, and
+ * is freed when the leaf is deleted.
+ */
+struct qpdb_node {
+	dns_name_t name;
+	isc_refcount_t references;
+	qpdb_header_t *data;
+	bool dirty;	 /*%< There are old versions to clean up */
+	bool nsec3;	 /*%< The node is in the NSEC3 trie */
+	bool delegating; /*%< An NS or DNAME was added to the node */
+	bool wild;	 /*%< A wildcard child was added to the node */
+};
+
+typedef struct qpdb_changed {
+	qpdb_node_t *node;
+	bool dirty;
+	ISC_LINK(struct qpdb_changed) link;
+} qpdb_changed_t;
+
+typedef ISC_LIST(qpdb_changed_t) qpdb_changedlist_t;
+
+typedef enum { dns_db_insecure, dns_db_partial, dns_db_secure } dns_db_secure_t;
+
+typedef struct qpdb qpdb_t;
+
+typedef struct qpdb_version {
+	/* Not locked */
+	qpdb_serial_t serial;
+	qpdb_t *qpdb;
+	/*
+	 * Protected in the refcount routines.
+	 * XXXJT: should we change the lock policy based on the refcount
+	 * performance?
+	 */
+	isc_refcount_t references;
+	/* Locked by database lock. */
+	bool writer;
+	bool commit_ok;
+	qpdb_changedlist_t changed_list;
+	qpdb_headerlist_t resigned_list;
+	ISC_LINK(struct qpdb_version) link;
+	dns_db_secure_t secure;
+	bool havensec3;
+	/* NSEC3 parameters */
+	dns_hash_t hash;
+	uint8_t flags;
+	uint16_t iterations;
+	uint8_t salt_length;
+	unsigned char salt[DNS_NSEC3_SALTSIZE];
+	/*
+	 * records and xfrsize are covered by the database lock.
+	 */
+	uint64_t records;
+	uint64_t xfrsize;
+} qpdb_version_t;
+
+typedef ISC_LIST(qpdb_version_t) qpdb_versionlist_t;
+
+#define QPDB_ATTR_LOADED  0x01
+#define QPDB_ATTR_LOADING 0x02
+
+struct qpdb {
+	/* Unlocked. */
+	dns_db_t common;
+	/* Locks the tries, the nodes and the data below. */
+	isc_rwlock_t lock;
+	/*
+	 * Counts the external references to the database, and one more
+	 * for all the nodes which are referenced.
+	 */
+	isc_refcount_t references;
+	qpdb_node_t *origin_node;
+	qpdb_node_t *nsec3_origin_node;
+	unsigned int attributes;
+	qpdb_serial_t current_serial;
+	qpdb_serial_t least_serial;
+	qpdb_serial_t next_serial;
+	qpdb_version_t *current_version;
+	qpdb_version_t *future_version;
+	qpdb_versionlist_t open_versions;
+	isc_heap_t *heap; /*%< Headers due for re-signing */
+	dns_qp_t *tree;
+	dns_qp_t *nsec3;
+};
+
+#define IS_STUB(qpdb) (((qpdb)->common.attributes & DNS_DBATTR_STUB) != 0)
+
+/*%
+ * Search Context
+ */
+typedef struct {
+	qpdb_t *qpdb;
+	qpdb_version_t *version;
+	qpdb_serial_t serial;
+	unsigned int options;
+	bool need_cleanup;
+	bool wild;
+	qpdb_node_t *zonecut;
+	qpdb_header_t *zonecut_header;
+	qpdb_header_t *zonecut_sigheader;
+} qpdb_search_t;
+
+static void
+rdataset_settrust(dns_rdataset_t *rdataset, dns_trust_t trust);
+
+static dns_rdatasetmethods_t rdataset_methods = {
+	dns__rdataslab_disassociate,
+	dns__rdataslab_first,
+	dns__rdataslab_next,
+	dns__rdataslab_current,
+	dns__rdataslab_clone,
+	dns__rdataslab_count,
+	NULL, /* addnoqname */
+	NULL, /* getnoqname */
+	NULL, /* addclosest */
+	NULL, /* getclosest */
+	rdataset_settrust,
+	NULL, /* expire */
+	NULL, /* clearprefetch */
+	NULL, /* setownercase */
+	NULL, /* getownercase */
+	NULL  /* addglue */
+};
+
+static void
+rdatasetiter_destroy(dns_rdatasetiter_t **iteratorp);
+static isc_result_t
+rdatasetiter_first(dns_rdatasetiter_t *iterator);
+static isc_result_t
+rdatasetiter_next(dns_rdatasetiter_t *iterator);
+static void
+rdatasetiter_current(dns_rdatasetiter_t *iterator, dns_rdataset_t *rdataset);
+
+static dns_rdatasetitermethods_t rdatasetiter_methods = {
+	rdatasetiter_destroy, rdatasetiter_first, rdatasetiter_next,
+	rdatasetiter_current
+};
+
+typedef struct qpdb_rdatasetiter {
+	dns_rdatasetiter_t common;
+	qpdb_header_t *current;
+} qpdb_rdatasetiter_t;
+
+static void
+dbiterator_destroy(dns_dbiterator_t **iteratorp);
+static isc_result_t
+dbiterator_first(dns_dbiterator_t *iterator);
+static isc_result_t
+dbiterator_last(dns_dbiterator_t *iterator);
+static isc_result_t
+dbiterator_seek(dns_dbiterator_t *iterator, const dns_name_t *name);
+static isc_result_t
+dbiterator_prev(dns_dbiterator_t *iterator);
+static isc_result_t
+dbiterator_next(dns_dbiterator_t *iterator);
+static isc_result_t
+dbiterator_current(dns_dbiterator_t *iterator, dns_dbnode_t **nodep,
+		   dns_name_t *name);
+static isc_result_t
+dbiterator_pause(dns_dbiterator_t *iterator);
+static isc_result_t
+dbiterator_origin(dns_dbiterator_t *iterator, dns_name_t *name);
+
+static dns_dbiteratormethods_t dbiterator_methods = {
+	dbiterator_destroy, dbiterator_first, dbiterator_last,
+	dbiterator_seek,    dbiterator_prev,  dbiterator_next,
+	dbiterator_current, dbiterator_pause, dbiterator_origin
+};
+
+/*
+ * The iterator holds a reference to its current node, but doesn't hold
+ * the database lock between calls; it moves by looking up the name of
+ * the current node, so it is not disturbed by changes to the tries.
+ */
+typedef struct qpdb_dbiterator {
+	dns_dbiterator_t common;
+	isc_result_t result;
+	bool nsec3only;
+	bool nonsec3;
+	qpdb_node_t *node;
+	const dns_name_t *origin; /*%< Last origin reported */
+} qpdb_dbiterator_t;
+
+static void
+free_qpdb(qpdb_t *qpdb);
+static void
+detachnode(dns_db_t *db, dns_dbnode_t **targetp);
+static void
+setnsec3parameters(dns_db_t *db, qpdb_version_t *version);
+
+static atomic_uint_fast32_t init_count = 0;
+
+/*
+ * Locking
+ *
+ * The database lock must be held in either mode to look at the tries,
+ * the rdatasets of the nodes, or the versions; it must be held in write
+ * mode to change them.  A node reference may be added under the read
+ * lock (see new_reference()), but the last reference to a node is only
+ * dropped under the write lock, since that may clean up the node.
+ */
+
+/*
+ * Trie methods
+ */
+
+static void
+free_header(qpdb_t *qpdb, qpdb_header_t *header) {
+	unsigned int size;
+
+	if (header->heap_index != 0) {
+		isc_heap_delete(qpdb->heap, header->heap_index);
+	}
+	header->heap_index = 0;
+
+	if (NONEXISTENT(header)) {
+		size = sizeof(*header);
+	} else {
+		size = dns_rdataslab_size((unsigned char *)header,
+					  sizeof(*header));
+	}
+
+	isc_mem_put(qpdb->common.mctx, header, size);
+}
+
+static void
+free_node(void *uctx, void *pval, uint32_t ival) {
+	qpdb_t *qpdb = uctx;
+	qpdb_node_t *node = pval;
+	qpdb_header_t *current, *top_next, *dcurrent, *down_next;
+
+	UNUSED(ival);
+
+	for (current = node->data; current != NULL; current = top_next) {
+		top_next = current->next;
+		for (dcurrent = current->down; dcurrent != NULL;
+		     dcurrent = down_next)
+		{
+			down_next = dcurrent->down;
+			free_header(qpdb, dcurrent);
+		}
+		free_header(qpdb, current);
+	}
+
+	dns_name_free(&node->name, qpdb->common.mctx);
+	isc_refcount_destroy(&node->references);
+	isc_mem_put(qpdb->common.mctx, node, sizeof(*node));
+}
+
+static size_t
+node_makekey(dns_qpkey_t key, void *uctx, void *pval, uint32_t ival) {
+	qpdb_node_t *node = pval;
+
+	UNUSED(uctx);
+	UNUSED(ival);
+
+	return (dns_qpkey_fromname(key, &node->name));
+}
+
+static const dns_qpmethods_t qpmethods = { NULL, free_node, node_makekey };
+
+/*
+ * DB Routines
+ */
+
+static void
+attach(dns_db_t *source, dns_db_t **targetp) {
+	qpdb_t *qpdb = (qpdb_t *)source;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	isc_refcount_increment(&qpdb->references);
+
+	*targetp = source;
+}
+
+static void
+qpdb_unref(qpdb_t *qpdb) {
+	if (isc_refcount_decrement(&qpdb->references) == 1) {
+		free_qpdb(qpdb);
+	}
+}
+
+static void
+detach(dns_db_t **dbp) {
+	qpdb_t *qpdb = (qpdb_t *)(*dbp);
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	*dbp = NULL;
+
+	qpdb_unref(qpdb);
+}
+
+static void
+free_qpdb(qpdb_t *qpdb) {
+	isc_mem_t *mctx = qpdb->common.mctx;
+	unsigned int refs;
+
+	isc_refcount_destroy(&qpdb->references);
+	qpdb->common.magic = 0;
+	qpdb->common.impmagic = 0;
+
+	/*
+	 * Destroying the tries frees the nodes and their rdatasets, which
+	 * takes the rdatasets off the resigning heap first.
+	 */
+	dns_qp_destroy(&qpdb->tree);
+	dns_qp_destroy(&qpdb->nsec3);
+	isc_heap_destroy(&qpdb->heap);
+
+	if (qpdb->current_version != NULL) {
+		refs = isc_refcount_decrement(
+			&qpdb->current_version->references);
+		INSIST(refs == 1);
+		isc_refcount_destroy(&qpdb->current_version->references);
+		UNLINK(qpdb->open_versions, qpdb->current_version, link);
+		isc_mem_put(mctx, qpdb->current_version,
+			    sizeof(*qpdb->current_version));
+	}
+
+	if (dns_name_dynamic(&qpdb->common.origin)) {
+		dns_name_free(&qpdb->common.origin, mctx);
+	}
+	isc_rwlock_destroy(&qpdb->lock);
+
+	INSIST(ISC_LIST_EMPTY(qpdb->common.update_listeners));
+
+	isc_mem_putanddetach(&qpdb->common.mctx, qpdb, sizeof(*qpdb));
+}
+
+/*
+ * Node references
+ */
+
+/*
+ * The caller must hold the database lock, in either mode.  The first
+ * reference to a node holds a reference to the database, so that it
+ * isn't freed while the node is in use.
+ */
+static void
+new_reference(qpdb_t *qpdb, qpdb_node_t *node) {
+	if (isc_refcount_increment0(&node->references) == 0) {
+		isc_refcount_increment(&qpdb->references);
+	}
+}
+
+static bool
+has_children(dns_qp_t *tree, qpdb_node_t *node) {
+	void *pval = NULL;
+	qpdb_node_t *next = NULL;
+
+	if (dns_qp_getname_next(tree, &node->name, &pval, NULL) !=
+	    ISC_R_SUCCESS)
+	{
+		return (false);
+	}
+	next = pval;
+
+	return (dns_name_issubdomain(&next->name, &node->name));
+}
+
+/*
+ * Delete 'node' if nothing refers to it and it has neither data nor
+ * children, and then its ancestors that became empty leaves.
+ *
+ * The caller must hold the database write lock.
+ */
+static void
+maybe_delete_node(qpdb_t *qpdb, qpdb_node_t *node) {
+	dns_qp_t *tree = node->nsec3 ? qpdb->nsec3 : qpdb->tree;
+	dns_fixedname_t fname, fparent;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	dns_name_t *parent = dns_fixedname_initname(&fparent);
+	isc_result_t result;
+
+	while (node != qpdb->origin_node && node != qpdb->nsec3_origin_node &&
+	       isc_refcount_current(&node->references) == 0 &&
+	       node->data == NULL && !has_children(tree, node))
+	{
+		bool up = !node->nsec3 &&
+			  dns_name_issubdomain(&node->name,
+					       &qpdb->common.origin);
+		void *pval = NULL;
+
+		/*
+		 * Deleting the leaf frees the node, so work with a copy of
+		 * its name.
+		 */
+		dns_name_copy(&node->name, name);
+		if (up) {
+			dns_name_split(name, dns_name_countlabels(name) - 1,
+				       NULL, parent);
+		}
+
+		result = dns_qp_deletename(tree, name);
+		INSIST(result == ISC_R_SUCCESS);
+
+		if (!up || dns_qp_getname(tree, parent, &pval, NULL) !=
+				   ISC_R_SUCCESS)
+		{
+			break;
+		}
+		node = pval;
+	}
+}
+
+/*
+ * Caller must be holding the database write lock.
+ */
+static void
+clean_zone_node(qpdb_t *qpdb, qpdb_node_t *node, qpdb_serial_t least_serial) {
+	qpdb_header_t *current, *dcurrent, *down_next, *dparent;
+	qpdb_header_t *top_prev, *top_next;
+	bool still_dirty = false;
+
+	REQUIRE(least_serial != 0);
+
+	top_prev = NULL;
+	for (current = node->data; current != NULL; current = top_next) {
+		top_next = current->next;
+
+		/*
+		 * First, we clean up any instances of multiple rdatasets
+		 * with the same serial number, or that have the IGNORE
+		 * attribute.
+		 */
+		dparent = current;
+		for (dcurrent = current->down; dcurrent != NULL;
+		     dcurrent = down_next)
+		{
+			down_next = dcurrent->down;
+			INSIST(dcurrent->serial <= dparent->serial);
+			if (dcurrent->serial == dparent->serial ||
+			    IGNORE(dcurrent))
+			{
+				if (down_next != NULL) {
+					down_next->next = dparent;
+				}
+				dparent->down = down_next;
+				free_header(qpdb, dcurrent);
+			} else {
+				dparent = dcurrent;
+			}
+		}
+
+		/*
+		 * We've now eliminated all IGNORE datasets with the possible
+		 * exception of current, which we now check.
+		 */
+		if (IGNORE(current)) {
+			down_next = current->down;
+			if (down_next == NULL) {
+				if (top_prev != NULL) {
+					top_prev->next = current->next;
+				} else {
+					node->data = current->next;
+				}
+				free_header(qpdb, current);
+				/*
+				 * current no longer exists, so we can
+				 * just continue with the loop.
+				 */
+				continue;
+			} else {
+				/*
+				 * Pull up current->down, making it the new
+				 * current.
+				 */
+				if (top_prev != NULL) {
+					top_prev->next = down_next;
+				} else {
+					node->data = down_next;
+				}
+				down_next->next = top_next;
+				free_header(qpdb, current);
+				current = down_next;
+			}
+		}
+
+		/*
+		 * We now try to find the first down node less than the
+		 * least serial.
+		 */
+		dparent = current;
+		for (dcurrent = current->down; dcurrent != NULL;
+		     dcurrent = down_next)
+		{
+			down_next = dcurrent->down;
+			if (dcurrent->serial < least_serial) {
+				break;
+			}
+			dparent = dcurrent;
+		}
+
+		/*
+		 * If there is a such an rdataset, delete it and any older
+		 * versions.
+		 */
+		if (dcurrent != NULL) {
+			do {
+				down_next = dcurrent->down;
+				INSIST(dcurrent->serial <= least_serial);
+				free_header(qpdb, dcurrent);
+				dcurrent = down_next;
+			} while (dcurrent != NULL);
+			dparent->down = NULL;
+		}
+
+		/*
+		 * Note.  The serial number of 'current' might be less than
+		 * least_serial too, but we cannot delete it because it is
+		 * the most recent version, unless it is a NONEXISTENT
+		 * rdataset.
+		 */
+		if (current->down != NULL) {
+			still_dirty = true;
+			top_prev = current;
+		} else {
+			/*
+			 * If this is a NONEXISTENT rdataset, we can delete it.
+			 */
+			if (NONEXISTENT(current)) {
+				if (top_prev != NULL) {
+					top_prev->next = current->next;
+				} else {
+					node->data = current->next;
+				}
+				free_header(qpdb, current);
+			} else {
+				top_prev = current;
+			}
+		}
+	}
+	if (!still_dirty) {
+		node->dirty = false;
+	}
+}
+
+/*
+ * Drop a reference to 'node'.  If it was the last one, clean up the old
+ * versions of its rdatasets and delete it if it is no longer needed.
+ * Returns true if the reference the node held on the database must be
+ * released, which the caller must do (with qpdb_unref()) once it has
+ * dropped the lock.
+ *
+ * Caller must be holding the database write lock.
+ */
+static bool
+decrement_reference(qpdb_t *qpdb, qpdb_node_t *node,
+		    qpdb_serial_t least_serial) {
+	if (isc_refcount_decrement(&node->references) > 1) {
+		return (false);
+	}
+
+	if (node->dirty) {
+		if (least_serial == 0) {
+			least_serial = qpdb->least_serial;
+		}
+		clean_zone_node(qpdb, node, least_serial);
+	}
+
+	maybe_delete_node(qpdb, node);
+
+	return (true);
+}
+
+/*
+ * Versions
+ */
+
+static void
+currentversion(dns_db_t *db, dns_dbversion_t **versionp) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	qpdb_version_t *version;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	version = qpdb->current_version;
+	isc_refcount_increment(&version->references);
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	*versionp = (dns_dbversion_t *)version;
+}
+
+static qpdb_version_t *
+allocate_version(isc_mem_t *mctx, qpdb_serial_t serial,
+		 unsigned int references, bool writer) {
+	qpdb_version_t *version;
+
+	version = isc_mem_get(mctx, sizeof(*version));
+	version->serial = serial;
+	version->qpdb = NULL;
+
+	isc_refcount_init(&version->references, references);
+
+	version->writer = writer;
+	version->commit_ok = false;
+	ISC_LIST_INIT(version->changed_list);
+	ISC_LIST_INIT(version->resigned_list);
+	ISC_LINK_INIT(version, link);
+
+	version->secure = dns_db_insecure;
+	version->havensec3 = false;
+	version->hash = 0;
+	version->flags = 0;
+	version->iterations = 0;
+	version->salt_length = 0;
+	memset(version->salt, 0, sizeof(version->salt));
+	version->records = 0;
+	version->xfrsize = 0;
+
+	return (version);
+}
+
+static isc_result_t
+newversion(dns_db_t *db, dns_dbversion_t **versionp) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	qpdb_version_t *version;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE(versionp != NULL && *versionp == NULL);
+	REQUIRE(qpdb->future_version == NULL);
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+	RUNTIME_CHECK(qpdb->next_serial != 0); /* XXX Error? */
+	version = allocate_version(qpdb->common.mctx, qpdb->next_serial, 1,
+				   true);
+	version->qpdb = qpdb;
+	version->commit_ok = true;
+	version->secure = qpdb->current_version->secure;
+	version->havensec3 = qpdb->current_version->havensec3;
+	if (version->havensec3) {
+		version->flags = qpdb->current_version->flags;
+		version->iterations = qpdb->current_version->iterations;
+		version->hash = qpdb->current_version->hash;
+		version->salt_length = qpdb->current_version->salt_length;
+		memmove(version->salt, qpdb->current_version->salt,
+			version->salt_length);
+	}
+	version->records = qpdb->current_version->records;
+	version->xfrsize = qpdb->current_version->xfrsize;
+	qpdb->next_serial++;
+	qpdb->future_version = version;
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
+
+	*versionp = version;
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+attachversion(dns_db_t *db, dns_dbversion_t *source,
+	      dns_dbversion_t **targetp) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	qpdb_version_t *version = source;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	INSIST(version != NULL && version->qpdb == qpdb);
+
+	isc_refcount_increment(&version->references);
+
+	*targetp = version;
+}
+
+/*
+ * Caller must be holding the database write lock.
+ */
+static qpdb_changed_t *
+add_changed(qpdb_t *qpdb, qpdb_version_t *version, qpdb_node_t *node) {
+	qpdb_changed_t *changed;
+
+	REQUIRE(version->writer);
+
+	changed = isc_mem_get(qpdb->common.mctx, sizeof(*changed));
+	isc_refcount_increment(&node->references);
+	changed->node = node;
+	changed->dirty = false;
+	ISC_LINK_INIT(changed, link);
+	ISC_LIST_APPEND(version->changed_list, changed, link);
+
+	return (changed);
+}
+
+static void
+rollback_node(qpdb_node_t *node, qpdb_serial_t serial) {
+	qpdb_header_t *header, *dcurrent;
+	bool make_dirty = false;
+
+	/*
+	 * Caller must hold the database write lock.
+	 */
+
+	/*
+	 * We set the IGNORE attribute on rdatasets with serial number
+	 * 'serial'.  When the reference count goes to zero, these rdatasets
+	 * will be cleaned up; until that time, they will be ignored.
+	 */
+	for (header = node->data; header != NULL; header = header->next) {
+		if (header->serial == serial) {
+			header->attributes |= RDATASET_ATTR_IGNORE;
+			make_dirty = true;
+		}
+		for (dcurrent = header->down; dcurrent != NULL;
+		     dcurrent = dcurrent->down)
+		{
+			if (dcurrent->serial == serial) {
+				dcurrent->attributes |= RDATASET_ATTR_IGNORE;
+				make_dirty = true;
+			}
+		}
+	}
+	if (make_dirty) {
+		node->dirty = true;
+	}
+}
+
+static void
+make_least_version(qpdb_t *qpdb, qpdb_version_t *version,
+		   qpdb_changedlist_t *cleanup_list) {
+	/*
+	 * Caller must be holding the database lock.
+	 */
+
+	qpdb->least_serial = version->serial;
+	*cleanup_list = version->changed_list;
+	ISC_LIST_INIT(version->changed_list);
+}
+
+static void
+cleanup_nondirty(qpdb_version_t *version, qpdb_changedlist_t *cleanup_list) {
+	qpdb_changed_t *changed, *next_changed;
+
+	/*
+	 * If the changed record is dirty, then
+	 * an update created multiple versions of
+	 * a given rdataset.  We keep this list
+	 * until we're the least open version, at
+	 * which point it's safe to get rid of any
+	 * older versions.
+	 *
+	 * If the changed record isn't dirty, then
+	 * we don't need it anymore since we're
+	 * committing and not rolling back.
+	 *
+	 * The caller must be holding the database lock.
+	 */
+	for (changed = HEAD(version->changed_list); changed != NULL;
+	     changed = next_changed)
+	{
+		next_changed = NEXT(changed, link);
+		if (!changed->dirty) {
+			UNLINK(version->changed_list, changed, link);
+			APPEND(*cleanup_list, changed, link);
+		}
+	}
+}
+
+static void
+iszonesecure(dns_db_t *db, qpdb_version_t *version, dns_dbnode_t *origin) {
+	dns_rdataset_t keyset;
+	dns_rdataset_t nsecset, signsecset;
+	bool haszonekey = false;
+	bool hasnsec = false;
+	isc_result_t result;
+
+	dns_rdataset_init(&keyset);
+	result = dns_db_findrdataset(db, origin, version, dns_rdatatype_dnskey,
+				     0, 0, &keyset, NULL);
+	if (result == ISC_R_SUCCESS) {
+		result = dns_rdataset_first(&keyset);
+		while (result == ISC_R_SUCCESS) {
+			dns_rdata_t keyrdata = DNS_RDATA_INIT;
+			dns_rdataset_current(&keyset, &keyrdata);
+			if (dns_zonekey_iszonekey(&keyrdata)) {
+				haszonekey = true;
+				break;
+			}
+			result = dns_rdataset_next(&keyset);
+		}
+		dns_rdataset_disassociate(&keyset);
+	}
+	if (!haszonekey) {
+		version->secure = dns_db_insecure;
+		version->havensec3 = false;
+		return;
+	}
+
+	dns_rdataset_init(&nsecset);
+	dns_rdataset_init(&signsecset);
+	result = dns_db_findrdataset(db, origin, version, dns_rdatatype_nsec, 0,
+				     0, &nsecset, &signsecset);
+	if (result == ISC_R_SUCCESS) {
+		if (dns_rdataset_isassociated(&signsecset)) {
+			hasnsec = true;
+			dns_rdataset_disassociate(&signsecset);
+		}
+		dns_rdataset_disassociate(&nsecset);
+	}
+
+	setnsec3parameters(db, version);
+
+	/*
+	 * Do we have a valid NSEC/NSEC3 chain?
+	 */
+	if (version->havensec3 || hasnsec) {
+		version->secure = dns_db_secure;
+	} else {
+		version->secure = dns_db_insecure;
+	}
+}
+
+/*
+ * Return the header of the rdataset whose top header is 'header' that is
+ * active in the version 'serial', or NULL if the rdataset doesn't exist
+ * in that version.
+ */
+static qpdb_header_t *
+active_header(qpdb_header_t *header, qpdb_serial_t serial) {
+	do {
+		if (header->serial <= serial && !IGNORE(header)) {
+			/*
+			 * Is this a "this rdataset doesn't exist" record?
+			 */
+			if (NONEXISTENT(header)) {
+				header = NULL;
+			}
+			break;
+		}
+		header = header->down;
+	} while (header != NULL);
+
+	return (header);
+}
+
+/*%<
+ * Walk the origin node looking for NSEC3PARAM records.
+ * Cache the nsec3 parameters.
+ */
+static void
+setnsec3parameters(dns_db_t *db, qpdb_version_t *version) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	qpdb_node_t *node;
+	dns_rdata_nsec3param_t nsec3param;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	isc_region_t region;
+	isc_result_t result;
+	qpdb_header_t *header, *header_next;
+	unsigned char *raw; /* RDATASLAB */
+	unsigned int count, length;
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	version->havensec3 = false;
+	node = qpdb->origin_node;
+	for (header = node->data; header != NULL; header = header_next) {
+		header_next = header->next;
+		header = active_header(header, version->serial);
+
+		if (header != NULL &&
+		    (header->type == dns_rdatatype_nsec3param))
+		{
+			/*
+			 * Find A NSEC3PARAM with a supported algorithm.
+			 */
+			raw = (unsigned char *)header + sizeof(*header);
+			count = raw[0] * 256 + raw[1]; /* count */
+			raw += DNS_RDATASET_COUNT + DNS_RDATASET_LENGTH;
+			while (count-- > 0U) {
+				length = raw[0] * 256 + raw[1];
+				raw += DNS_RDATASET_ORDER + DNS_RDATASET_LENGTH;
+				region.base = raw;
+				region.length = length;
+				raw += length;
+				dns_rdata_fromregion(
+					&rdata, qpdb->common.rdclass,
+					dns_rdatatype_nsec3param, &region);
+				result = dns_rdata_tostruct(&rdata, &nsec3param,
+							    NULL);
+				INSIST(result == ISC_R_SUCCESS);
+				dns_rdata_reset(&rdata);
+
+				if (nsec3param.hash != DNS_NSEC3_UNKNOWNALG &&
+				    !dns_nsec3_supportedhash(nsec3param.hash))
+				{
+					continue;
+				}
+
+				if (nsec3param.flags != 0) {
+					continue;
+				}
+
+				memmove(version->salt, nsec3param.salt,
+					nsec3param.salt_length);
+				version->hash = nsec3param.hash;
+				version->salt_length = nsec3param.salt_length;
+				version->iterations = nsec3param.iterations;
+				version->flags = nsec3param.flags;
+				version->havensec3 = true;
+				/*
+				 * Look for a better algorithm than the
+				 * unknown test algorithm.
+				 */
+				if (nsec3param.hash != DNS_NSEC3_UNKNOWNALG) {
+					goto unlock;
+				}
+			}
+		}
+	}
+unlock:
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+}
+
+static bool
+resign_sooner(void *v1, void *v2) {
+	qpdb_header_t *h1 = v1;
+	qpdb_header_t *h2 = v2;
+
+	return (h1->resign < h2->resign ||
+		(h1->resign == h2->resign && h1->resign_lsb < h2->resign_lsb) ||
+		(h1->resign == h2->resign && h1->resign_lsb == h2->resign_lsb &&
+		 h2->type == QPDB_RDATATYPE_SIGSOA));
+}
+
+/*%
+ * This function sets the heap index into the header.
+ */
+static void
+set_index(void *what, unsigned int idx) {
+	qpdb_header_t *h = what;
+
+	h->heap_index = idx;
+}
+
+/*
+ * Caller must be holding the database write lock.
+ */
+static void
+resign_insert(qpdb_t *qpdb, qpdb_header_t *newheader) {
+	INSIST(newheader->heap_index == 0);
+	INSIST(!ISC_LINK_LINKED(newheader, link));
+
+	isc_heap_insert(qpdb->heap, newheader);
+}
+
+/*
+ * Caller must be holding the database write lock.
+ */
+static void
+resign_delete(qpdb_t *qpdb, qpdb_version_t *version, qpdb_header_t *header) {
+	/*
+	 * Remove the old header from the heap
+	 */
+	if (header != NULL && header->heap_index != 0) {
+		isc_heap_delete(qpdb->heap, header->heap_index);
+		header->heap_index = 0;
+		if (version != NULL) {
+			new_reference(qpdb, header->node);
+			ISC_LIST_APPEND(version->resigned_list, header, link);
+		}
+	}
+}
+
+static void
+closeversion(dns_db_t *db, dns_dbversion_t **versionp, bool commit) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	qpdb_version_t *version, *cleanup_version, *least_greater;
+	bool rollback = false;
+	qpdb_changedlist_t cleanup_list;
+	qpdb_headerlist_t resigned_list;
+	qpdb_changed_t *changed, *next_changed;
+	qpdb_serial_t serial, least_serial;
+	qpdb_header_t *header;
+	unsigned int unrefs = 0;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	version = (qpdb_version_t *)*versionp;
+	INSIST(version->qpdb == qpdb);
+
+	cleanup_version = NULL;
+	ISC_LIST_INIT(cleanup_list);
+	ISC_LIST_INIT(resigned_list);
+
+	if (isc_refcount_decrement(&version->references) > 1) {
+		/* typical and easy case first */
+		if (commit) {
+			RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+			INSIST(!version->writer);
+			RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+		}
+		goto end;
+	}
+
+	/*
+	 * Update the zone's secure status in version before making
+	 * it the current version.
+	 */
+	if (version->writer && commit) {
+		iszonesecure(db, version, qpdb->origin_node);
+	}
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+	serial = version->serial;
+	if (version->writer) {
+		if (commit) {
+			unsigned int cur_ref;
+			qpdb_version_t *cur_version;
+
+			INSIST(version->commit_ok);
+			INSIST(version == qpdb->future_version);
+			/*
+			 * The current version is going to be replaced.
+			 * Release the (likely last) reference to it from the
+			 * DB itself and unlink it from the open list.
+			 */
+			cur_version = qpdb->current_version;
+			cur_ref = isc_refcount_decrement(
+				&cur_version->references);
+			if (cur_ref == 1) {
+				if (cur_version->serial == qpdb->least_serial) {
+					INSIST(EMPTY(
+						cur_version->changed_list));
+				}
+				UNLINK(qpdb->open_versions, cur_version, link);
+			}
+			if (EMPTY(qpdb->open_versions)) {
+				/*
+				 * We're going to become the least open
+				 * version.
+				 */
+				make_least_version(qpdb, version,
+						   &cleanup_list);
+			} else {
+				/*
+				 * Some other open version is the
+				 * least version.  We can't cleanup
+				 * records that were changed in this
+				 * version because the older versions
+				 * may still be in use by an open
+				 * version.
+				 *
+				 * We can, however, discard the
+				 * changed records for things that
+				 * we've added that didn't exist in
+				 * prior versions.
+				 */
+				cleanup_nondirty(version, &cleanup_list);
+			}
+			/*
+			 * If the (soon to be former) current version
+			 * isn't being used by anyone, we can clean
+			 * it up.
+			 */
+			if (cur_ref == 1) {
+				cleanup_version = cur_version;
+				APPENDLIST(version->changed_list,
+					   cleanup_version->changed_list, link);
+			}
+			/*
+			 * Become the current version.
+			 */
+			version->writer = false;
+			qpdb->current_version = version;
+			qpdb->current_serial = version->serial;
+			qpdb->future_version = NULL;
+
+			/*
+			 * Keep the current version in the open list, and
+			 * gain a reference for the DB itself (see the DB
+			 * creation function below).  This must be the only
+			 * case where we need to increment the counter from
+			 * zero and need to use isc_refcount_increment0().
+			 */
+			INSIST(isc_refcount_increment0(&version->references) ==
+			       0);
+			PREPEND(qpdb->open_versions, qpdb->current_version,
+				link);
+			resigned_list = version->resigned_list;
+			ISC_LIST_INIT(version->resigned_list);
+		} else {
+			/*
+			 * We're rolling back this transaction.
+			 */
+			cleanup_list = version->changed_list;
+			ISC_LIST_INIT(version->changed_list);
+			resigned_list = version->resigned_list;
+			ISC_LIST_INIT(version->resigned_list);
+			rollback = true;
+			cleanup_version = version;
+			qpdb->future_version = NULL;
+		}
+	} else {
+		if (version != qpdb->current_version) {
+			/*
+			 * There are no external or internal references
+			 * to this version and it can be cleaned up.
+			 */
+			cleanup_version = version;
+
+			/*
+			 * Find the version with the least serial
+			 * number greater than ours.
+			 */
+			least_greater = PREV(version, link);
+			if (least_greater == NULL) {
+				least_greater = qpdb->current_version;
+			}
+
+			INSIST(version->serial < least_greater->serial);
+			/*
+			 * Is this the least open version?
+			 */
+			if (version->serial == qpdb->least_serial) {
+				/*
+				 * Yes.  Install the new least open
+				 * version.
+				 */
+				make_least_version(qpdb, least_greater,
+						   &cleanup_list);
+			} else {
+				/*
+				 * Add any unexecuted cleanups to
+				 * those of the least greater version.
+				 */
+				APPENDLIST(least_greater->changed_list,
+					   version->changed_list, link);
+			}
+		} else if (version->serial == qpdb->least_serial) {
+			INSIST(EMPTY(version->changed_list));
+		}
+		UNLINK(qpdb->open_versions, version, link);
+	}
+	least_serial = qpdb->least_serial;
+
+	/*
+	 * Commit/rollback re-signed headers.
+	 */
+	for (header = HEAD(resigned_list); header != NULL;
+	     header = HEAD(resigned_list))
+	{
+		ISC_LIST_UNLINK(resigned_list, header, link);
+		if (rollback && !IGNORE(header)) {
+			resign_insert(qpdb, header);
+		}
+		if (decrement_reference(qpdb, header->node, least_serial)) {
+			unrefs++;
+		}
+	}
+
+	for (changed = HEAD(cleanup_list); changed != NULL;
+	     changed = next_changed)
+	{
+		next_changed = NEXT(changed, link);
+		if (rollback) {
+			rollback_node(changed->node, serial);
+		}
+		if (decrement_reference(qpdb, changed->node, least_serial)) {
+			unrefs++;
+		}
+		isc_mem_put(qpdb->common.mctx, changed, sizeof(*changed));
+	}
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
+
+	if (cleanup_version != NULL) {
+		INSIST(EMPTY(cleanup_version->changed_list));
+		isc_refcount_destroy(&cleanup_version->references);
+		isc_mem_put(qpdb->common.mctx, cleanup_version,
+			    sizeof(*cleanup_version));
+	}
+
+	while (unrefs-- > 0) {
+		qpdb_unref(qpdb);
+	}
+
+end:
+	*versionp = NULL;
+}
+
+/*
+ * Nodes
+ */
+
+static qpdb_node_t *
+new_node(qpdb_t *qpdb, const dns_name_t *name, bool nsec3) {
+	qpdb_node_t *node = isc_mem_get(qpdb->common.mctx, sizeof(*node));
+
+	*node = (qpdb_node_t){ .nsec3 = nsec3 };
+	dns_name_init(&node->name, NULL);
+	dns_name_dupwithoffsets(name, qpdb->common.mctx, &node->name);
+	isc_refcount_init(&node->references, 0);
+
+	return (node);
+}
+
+/*
+ * Find the node for 'name', adding it if it doesn't exist.  In the main
+ * trie, the ancestors of a name in the zone are added as well, down
+ * from the origin, so that the empty non-terminals exist and the
+ * wildcards can be found from the level that they are at.
+ *
+ * Caller must be holding the database write lock.
+ */
+static qpdb_node_t *
+add_node(qpdb_t *qpdb, const dns_name_t *name, bool nsec3) {
+	dns_qp_t *tree = nsec3 ? qpdb->nsec3 : qpdb->tree;
+	qpdb_node_t *node = NULL, *child = NULL;
+	unsigned int labels, olabels, n;
+	isc_result_t result;
+	void *pval = NULL;
+
+	result = dns_qp_getname(tree, name, &pval, NULL);
+	if (result == ISC_R_SUCCESS) {
+		return (pval);
+	}
+
+	node = new_node(qpdb, name, nsec3);
+	result = dns_qp_insert(tree, node, 0);
+	INSIST(result == ISC_R_SUCCESS);
+
+	if (nsec3 || !dns_name_issubdomain(name, &qpdb->common.origin)) {
+		return (node);
+	}
+
+	labels = dns_name_countlabels(name);
+	olabels = dns_name_countlabels(&qpdb->common.origin);
+	child = node;
+	for (n = labels - 1; n >= olabels; n--) {
+		qpdb_node_t *parent = NULL;
+		dns_name_t suffix;
+
+		dns_name_init(&suffix, NULL);
+		dns_name_split(name, n, NULL, &suffix);
+		result = dns_qp_getname(tree, &suffix, &pval, NULL);
+		if (result == ISC_R_SUCCESS) {
+			parent = pval;
+		} else {
+			parent = new_node(qpdb, &suffix, false);
+			RUNTIME_CHECK(dns_qp_insert(tree, parent, 0) ==
+				      ISC_R_SUCCESS);
+		}
+		if (dns_name_iswildcard(&child->name)) {
+			parent->wild = true;
+		}
+		if (result == ISC_R_SUCCESS) {
+			break;
+		}
+		child = parent;
+	}
+
+	return (node);
+}
+
+static isc_result_t
+findnodeintree(qpdb_t *qpdb, const dns_name_t *name, bool create, bool nsec3,
+	       dns_dbnode_t **nodep) {
+	dns_qp_t *tree = nsec3 ? qpdb->nsec3 : qpdb->tree;
+	qpdb_node_t *node = NULL;
+	isc_result_t result;
+	void *pval = NULL;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	result = dns_qp_getname(tree, name, &pval, NULL);
+	if (result == ISC_R_SUCCESS) {
+		node = pval;
+		new_reference(qpdb, node);
+	}
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	if (result != ISC_R_SUCCESS) {
+		if (!create) {
+			return (ISC_R_NOTFOUND);
+		}
+
+		RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+		node = add_node(qpdb, name, nsec3);
+		new_reference(qpdb, node);
+		RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
+	}
+
+	*nodep = (dns_dbnode_t *)node;
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+findnode(dns_db_t *db, const dns_name_t *name, bool create,
+	 dns_dbnode_t **nodep) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	return (findnodeintree(qpdb, name, create, false, nodep));
+}
+
+static isc_result_t
+findnsec3node(dns_db_t *db, const dns_name_t *name, bool create,
+	      dns_dbnode_t **nodep) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	return (findnodeintree(qpdb, name, create, true, nodep));
+}
+
+static void
+attachnode(dns_db_t *db, dns_dbnode_t *source, dns_dbnode_t **targetp) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	qpdb_node_t *node = (qpdb_node_t *)source;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	isc_refcount_increment(&node->references);
+
+	*targetp = source;
+}
+
+static void
+detachnode(dns_db_t *db, dns_dbnode_t **targetp) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	qpdb_node_t *node;
+	uint_fast32_t refs;
+	bool unref;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE(targetp != NULL && *targetp != NULL);
+
+	node = (qpdb_node_t *)(*targetp);
+	*targetp = NULL;
+
+	/*
+	 * A reference other than the last one can be dropped without
+	 * the lock.
+	 */
+	refs = isc_refcount_current(&node->references);
+	while (refs > 1) {
+		if (atomic_compare_exchange_weak_acq_rel(&node->references,
+							 &refs, refs - 1))
+		{
+			return;
+		}
+	}
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+	unref = decrement_reference(qpdb, node, 0);
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
+
+	if (unref) {
+		qpdb_unref(qpdb);
+	}
+}
+
+/*
+ * Lookups
+ */
+
+static bool
+node_active(qpdb_node_t *node, qpdb_serial_t serial) {
+	qpdb_header_t *header;
+
+	for (header = node->data; header != NULL; header = header->next) {
+		if (active_header(header, serial) != NULL) {
+			return (true);
+		}
+	}
+
+	return (false);
+}
+
+/*
+ * Return true if 'name', or a name beneath it, has data in the version
+ * being searched, i.e. if 'name' exists in that version.
+ *
+ * Caller must be holding the database lock.
+ */
+static bool
+subtree_active(qpdb_search_t *search, const dns_name_t *name) {
+	dns_qp_t *tree = search->qpdb->tree;
+	qpdb_node_t *node = NULL;
+	isc_result_t result;
+	void *pval = NULL;
+
+	result = dns_qp_getname(tree, name, &pval, NULL);
+	if (result == ISC_R_SUCCESS && node_active(pval, search->serial)) {
+		return (true);
+	}
+
+	for (result = dns_qp_getname_next(tree, name, &pval, NULL);
+	     result == ISC_R_SUCCESS;
+	     result = dns_qp_getname_next(tree, &node->name, &pval, NULL))
+	{
+		node = pval;
+		if (!dns_name_issubdomain(&node->name, name)) {
+			break;
+		}
+		if (node_active(node, search->serial)) {
+			return (true);
+		}
+	}
+
+	return (false);
+}
+
+/*
+ * Caller must be holding the database lock.
+ */
+static void
+bind_rdataset(qpdb_t *qpdb, qpdb_node_t *node, qpdb_header_t *header,
+	      dns_rdataset_t *rdataset) {
+	unsigned char *raw; /* RDATASLAB */
+
+	if (rdataset == NULL) {
+		return;
+	}
+
+	new_reference(qpdb, node);
+
+	INSIST(rdataset->methods == NULL); /* We must be disassociated. */
+
+	rdataset->methods = &rdataset_methods;
+	rdataset->rdclass = qpdb->common.rdclass;
+	rdataset->type = QPDB_RDATATYPE_BASE(header->type);
+	rdataset->covers = QPDB_RDATATYPE_EXT(header->type);
+	rdataset->ttl = header->ttl;
+	rdataset->trust = header->trust;
+	rdataset->private1 = qpdb;
+	rdataset->private2 = node;
+	raw = (unsigned char *)header + sizeof(*header);
+	rdataset->private3 = raw;
+	rdataset->count = atomic_fetch_add_relaxed(&header->count, 1);
+	if (rdataset->count == UINT32_MAX) {
+		rdataset->count = 0;
+	}
+
+	/*
+	 * Reset iterator state.
+	 */
+	rdataset->privateuint4 = 0;
+	rdataset->private5 = NULL;
+
+	/*
+	 * Copy out re-signing information.
+	 */
+	if (RESIGN(header)) {
+		rdataset->attributes |= DNS_RDATASETATTR_RESIGN;
+		rdataset->resign = (header->resign << 1) | header->resign_lsb;
+	} else {
+		rdataset->resign = 0;
+	}
+}
+
+/*
+ * Look for an NS or DNAME rdataset at 'node', a proper ancestor of the
+ * name being searched for, and remember it as the zone cut if there is
+ * one.  Returns true if 'node' is a zone cut.
+ */
+static bool
+check_zonecut(qpdb_search_t *search, qpdb_node_t *node) {
+	qpdb_t *qpdb = search->qpdb;
+	qpdb_header_t *header, *header_next;
+	qpdb_header_t *dname_header = NULL, *sigdname_header = NULL;
+	qpdb_header_t *ns_header = NULL, *found = NULL;
+
+	for (header = node->data; header != NULL; header = header_next) {
+		header_next = header->next;
+		if (header->type != dns_rdatatype_ns &&
+		    header->type != dns_rdatatype_dname &&
+		    header->type != QPDB_RDATATYPE_SIGDNAME)
+		{
+			continue;
+		}
+		header = active_header(header, search->serial);
+		if (header == NULL) {
+			continue;
+		}
+		if (header->type == dns_rdatatype_dname) {
+			dname_header = header;
+		} else if (header->type == QPDB_RDATATYPE_SIGDNAME) {
+			sigdname_header = header;
+		} else if (node != qpdb->origin_node || IS_STUB(qpdb)) {
+			/*
+			 * We've found an NS rdataset that isn't at the
+			 * origin node.  We check that they're not at the
+			 * origin node, because otherwise we'd erroneously
+			 * treat the zone top as if it were a delegation.
+			 */
+			ns_header = header;
+		}
+	}
+
+	/*
+	 * Note that NS has precedence over DNAME if both exist in a zone.
+	 * Otherwise DNAME take precedence over NS.
+	 */
+	if (!IS_STUB(qpdb) && ns_header != NULL) {
+		found = ns_header;
+		search->zonecut_sigheader = NULL;
+	} else if (dname_header != NULL) {
+		found = dname_header;
+		search->zonecut_sigheader = sigdname_header;
+	} else if (ns_header != NULL) {
+		found = ns_header;
+		search->zonecut_sigheader = NULL;
+	}
+
+	if (found == NULL) {
+		return (false);
+	}
+
+	/*
+	 * We increment the reference count on node to ensure that
+	 * search->zonecut_header will still be valid later.
+	 */
+	new_reference(qpdb, node);
+	search->zonecut = node;
+	search->zonecut_header = found;
+	search->need_cleanup = true;
+	/*
+	 * Since we've found a zonecut, anything beneath it is glue and is
+	 * not subject to wildcard matching.
+	 */
+	search->wild = false;
+
+	return (true);
+}
+
+/*
+ * Look at the proper ancestors of 'name' down from the origin for the
+ * topmost zone cut, and note whether any of them may have a matching
+ * wildcard.
+ *
+ * Caller must be holding the database lock.
+ */
+static void
+find_zonecut(qpdb_search_t *search, const dns_name_t *name) {
+	qpdb_t *qpdb = search->qpdb;
+	unsigned int labels, n;
+
+	if (!dns_name_issubdomain(name, &qpdb->common.origin)) {
+		return;
+	}
+
+	labels = dns_name_countlabels(name);
+	for (n = dns_name_countlabels(&qpdb->common.origin); n < labels; n++) {
+		qpdb_node_t *node = NULL;
+		dns_name_t suffix;
+		void *pval = NULL;
+
+		dns_name_init(&suffix, NULL);
+		dns_name_split(name, n, NULL, &suffix);
+		if (dns_qp_getname(qpdb->tree, &suffix, &pval, NULL) !=
+		    ISC_R_SUCCESS)
+		{
+			break;
+		}
+		node = pval;
+		if (node->delegating && check_zonecut(search, node)) {
+			break;
+		}
+		if (node->wild && (search->options & DNS_DBFIND_NOWILD) == 0) {
+			search->wild = true;
+		}
+	}
+}
+
+static isc_result_t
+setup_delegation(qpdb_search_t *search, dns_dbnode_t **nodep,
+		 dns_name_t *foundname, dns_rdataset_t *rdataset,
+		 dns_rdataset_t *sigrdataset) {
+	qpdb_node_t *node = search->zonecut;
+	qpdb_rdatatype_t type;
+
+	REQUIRE(search->zonecut != NULL);
+	REQUIRE(search->zonecut_header != NULL);
+
+	type = search->zonecut_header->type;
+
+	dns_name_copy(&node->name, foundname);
+	if (nodep != NULL) {
+		/*
+		 * Note that we don't have to increment the node's reference
+		 * count here because we're going to use the reference we
+		 * already have in the search block.
+		 */
+		*nodep = node;
+		search->need_cleanup = false;
+	}
+	if (rdataset != NULL) {
+		bind_rdataset(search->qpdb, node, search->zonecut_header,
+			      rdataset);
+		if (sigrdataset != NULL && search->zonecut_sigheader != NULL) {
+			bind_rdataset(search->qpdb, node,
+				      search->zonecut_sigheader, sigrdataset);
+		}
+	}
+
+	if (type == dns_rdatatype_dname) {
+		return (DNS_R_DNAME);
+	}
+	return (DNS_R_DELEGATION);
+}
+
+static bool
+valid_glue(qpdb_search_t *search, dns_name_t *name, qpdb_rdatatype_t type,
+	   qpdb_node_t *node) {
+	unsigned char *raw; /* RDATASLAB */
+	unsigned int count, size;
+	dns_name_t ns_name;
+	bool valid = false;
+	dns_offsets_t offsets;
+	isc_region_t region;
+	qpdb_header_t *header;
+
+	/*
+	 * Valid glue types are A, AAAA, A6.  NS is also a valid glue type
+	 * if it occurs at a zone cut, but is not valid below it.
+	 */
+	if (type == dns_rdatatype_ns) {
+		if (node != search->zonecut) {
+			return (false);
+		}
+	} else if (type != dns_rdatatype_a && type != dns_rdatatype_aaaa &&
+		   type != dns_rdatatype_a6)
+	{
+		return (false);
+	}
+
+	header = search->zonecut_header;
+	raw = (unsigned char *)header + sizeof(*header);
+	count = raw[0] * 256 + raw[1];
+	raw += DNS_RDATASET_COUNT + DNS_RDATASET_LENGTH;
+
+	while (count > 0) {
+		count--;
+		size = raw[0] * 256 + raw[1];
+		raw += DNS_RDATASET_ORDER + DNS_RDATASET_LENGTH;
+		region.base = raw;
+		region.length = size;
+		raw += size;
+		/*
+		 * XXX Until we have rdata structures, we have no choice but
+		 * to directly access the rdata format.
+		 */
+		dns_name_init(&ns_name, offsets);
+		dns_name_fromregion(&ns_name, &region);
+		if (dns_name_compare(&ns_name, name) == 0) {
+			valid = true;
+			break;
+		}
+	}
+
+	return (valid);
+}
+
+static bool
+matchparams(qpdb_header_t *header, qpdb_search_t *search) {
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_nsec3_t nsec3;
+	unsigned char *raw; /* RDATASLAB */
+	unsigned int rdlen, count;
+	isc_region_t region;
+	isc_result_t result;
+
+	REQUIRE(header->type == dns_rdatatype_nsec3);
+
+	raw = (unsigned char *)header + sizeof(*header);
+	count = raw[0] * 256 + raw[1]; /* count */
+	raw += DNS_RDATASET_COUNT + DNS_RDATASET_LENGTH;
+
+	while (count-- > 0) {
+		rdlen = raw[0] * 256 + raw[1];
+		raw += DNS_RDATASET_ORDER + DNS_RDATASET_LENGTH;
+		region.base = raw;
+		region.length = rdlen;
+		dns_rdata_fromregion(&rdata, search->qpdb->common.rdclass,
+				     dns_rdatatype_nsec3, &region);
+		raw += rdlen;
+		result = dns_rdata_tostruct(&rdata, &nsec3, NULL);
+		INSIST(result == ISC_R_SUCCESS);
+		if (nsec3.hash == search->version->hash &&
+		    nsec3.iterations == search->version->iterations &&
+		    nsec3.salt_length == search->version->salt_length &&
+		    memcmp(nsec3.salt, search->version->salt,
+			   nsec3.salt_length) == 0)
+		{
+			return (true);
+		}
+		dns_rdata_reset(&rdata);
+	}
+	return (false);
+}
+
+/*
+ * Find the wildcard matching 'qname', which doesn't exist in the
+ * version being searched: that is the wildcard child of the closest
+ * encloser of 'qname', if it exists.
+ *
+ * Caller must be holding the database lock.
+ */
+static isc_result_t
+find_wildcard(qpdb_search_t *search, qpdb_node_t **nodep,
+	      const dns_name_t *qname) {
+	qpdb_t *qpdb = search->qpdb;
+	unsigned int labels, olabels, n;
+	dns_fixedname_t fwname;
+	dns_name_t *wname = NULL;
+	isc_result_t result;
+	void *pval = NULL;
+
+	if (!dns_name_issubdomain(qname, &qpdb->common.origin)) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	labels = dns_name_countlabels(qname);
+	olabels = dns_name_countlabels(&qpdb->common.origin);
+	for (n = labels; n >= olabels; n--) {
+		qpdb_node_t *node = NULL;
+		dns_name_t suffix;
+
+		dns_name_init(&suffix, NULL);
+		dns_name_split(qname, n, NULL, &suffix);
+		if (dns_qp_getname(qpdb->tree, &suffix, &pval, NULL) !=
+			    ISC_R_SUCCESS ||
+		    !subtree_active(search, &suffix))
+		{
+			continue;
+		}
+
+		/*
+		 * 'suffix' is the closest encloser.  If that is 'qname'
+		 * itself, it is an empty non-terminal and wildcards don't
+		 * apply.
+		 */
+		node = pval;
+		if (n == labels || !node->wild) {
+			return (ISC_R_NOTFOUND);
+		}
+
+		wname = dns_fixedname_initname(&fwname);
+		result = dns_name_concatenate(dns_wildcardname, &node->name,
+					      wname, NULL);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+		if (dns_qp_getname(qpdb->tree, wname, &pval, NULL) !=
+			    ISC_R_SUCCESS ||
+		    !subtree_active(search, wname))
+		{
+			return (ISC_R_NOTFOUND);
+		}
+
+		*nodep = pval;
+		return (ISC_R_SUCCESS);
+	}
+
+	return (ISC_R_NOTFOUND);
+}
+
+/*
+ * Find the NSEC/NSEC3 which is at or before 'name'.  For NSEC3 records
+ * only NSEC3 records that match the current NSEC3PARAM record are
+ * considered.
+ *
+ * Caller must be holding the database lock.
+ */
+static isc_result_t
+find_closest_nsec(qpdb_search_t *search, dns_dbnode_t **nodep,
+		  dns_name_t *foundname, dns_rdataset_t *rdataset,
+		  dns_rdataset_t *sigrdataset, const dns_name_t *name,
+		  bool nsec3) {
+	qpdb_t *qpdb = search->qpdb;
+	dns_qp_t *tree = nsec3 ? qpdb->nsec3 : qpdb->tree;
+	qpdb_node_t *node = NULL;
+	qpdb_header_t *header, *header_next, *found, *foundsig;
+	dns_rdatatype_t type;
+	qpdb_rdatatype_t sigtype;
+	bool wraps = nsec3;
+	bool need_sig = (search->version->secure == dns_db_secure);
+	isc_result_t result;
+	void *pval = NULL;
+
+	if (nsec3) {
+		type = dns_rdatatype_nsec3;
+		sigtype = QPDB_RDATATYPE_SIGNSEC3;
+	} else {
+		type = dns_rdatatype_nsec;
+		sigtype = QPDB_RDATATYPE_SIGNSEC;
+	}
+
+	result = dns_qp_getname(tree, name, &pval, NULL);
+	if (result != ISC_R_SUCCESS) {
+		result = dns_qp_getname_prev(tree, name, &pval, NULL);
+	}
+again:
+	while (result == ISC_R_SUCCESS) {
+		bool empty_node = true;
+
+		node = pval;
+		found = NULL;
+		foundsig = NULL;
+		for (header = node->data; header != NULL; header = header_next)
+		{
+			header_next = header->next;
+			/*
+			 * Look for an active, extant NSEC or RRSIG NSEC.
+			 */
+			header = active_header(header, search->serial);
+			if (header == NULL) {
+				continue;
+			}
+			/*
+			 * We now know that there is at least one active
+			 * rdataset at this node.
+			 */
+			empty_node = false;
+			if (header->type == type) {
+				found = header;
+			} else if (header->type == sigtype) {
+				foundsig = header;
+			}
+		}
+		if (!empty_node) {
+			if (found != NULL && search->version->havensec3 &&
+			    found->type == dns_rdatatype_nsec3 &&
+			    !matchparams(found, search))
+			{
+				/*
+				 * Not part of the chain in use; keep
+				 * looking.
+				 */
+			} else if (found != NULL &&
+				   (foundsig != NULL || !need_sig))
+			{
+				/*
+				 * We've found the right NSEC/NSEC3 record.
+				 *
+				 * Note: for this to really be the right
+				 * NSEC record, it's essential that the NSEC
+				 * records of any nodes obscured by a zone
+				 * cut have been removed; we assume this is
+				 * the case.
+				 */
+				dns_name_copy(&node->name, foundname);
+				if (nodep != NULL) {
+					new_reference(qpdb, node);
+					*nodep = node;
+				}
+				bind_rdataset(qpdb, node, found, rdataset);
+				if (foundsig != NULL) {
+					bind_rdataset(qpdb, node, foundsig,
+						      sigrdataset);
+				}
+				return (ISC_R_SUCCESS);
+			} else if (found == NULL && foundsig == NULL) {
+				/*
+				 * This node is active, but has no NSEC or
+				 * RRSIG NSEC.  That means it's glue or
+				 * other obscured zone data that isn't
+				 * relevant for our search.  Treat the
+				 * node as if it were empty and keep looking.
+				 */
+			} else {
+				/*
+				 * We found an active node, but either the
+				 * NSEC or the RRSIG NSEC is missing.  This
+				 * shouldn't happen.
+				 */
+				return (DNS_R_BADDB);
+			}
+		}
+		result = dns_qp_getname_prev(tree, &node->name, &pval, NULL);
+	}
+
+	if (wraps) {
+		wraps = false;
+		result = dns_qp_getlast(tree, &pval, NULL);
+		goto again;
+	}
+
+	/*
+	 * We got to the beginning of the database and didn't find a NSEC
+	 * record.  This shouldn't happen.
+	 */
+	return (DNS_R_BADDB);
+}
+
+static isc_result_t
+find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
+     dns_rdatatype_t type, unsigned int options, isc_stdtime_t now,
+     dns_dbnode_t **nodep, dns_name_t *foundname, dns_rdataset_t *rdataset,
+     dns_rdataset_t *sigrdataset) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	qpdb_node_t *node = NULL;
+	isc_result_t result;
+	qpdb_search_t search;
+	bool cname_ok = true;
+	bool close_version = false;
+	bool maybe_zonecut = false;
+	bool at_zonecut = false;
+	bool wild = false;
+	bool nsec3 = ((options & DNS_DBFIND_FORCENSEC3) != 0);
+	bool empty_node;
+	bool active;
+	qpdb_header_t *header, *header_next, *found, *nsecheader;
+	qpdb_header_t *foundsig, *cnamesig, *nsecsig;
+	qpdb_rdatatype_t sigtype;
+	void *pval = NULL;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	INSIST(version == NULL || ((qpdb_version_t *)version)->qpdb == qpdb);
+
+	/*
+	 * We don't care about 'now'.
+	 */
+	UNUSED(now);
+
+	/*
+	 * If the caller didn't supply a version, attach to the current
+	 * version.
+	 */
+	if (version == NULL) {
+		currentversion(db, &version);
+		close_version = true;
+	}
+
+	search = (qpdb_search_t){
+		.qpdb = qpdb,
+		.version = version,
+		.serial = ((qpdb_version_t *)version)->serial,
+		.options = options,
+	};
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	result = dns_qp_findname_ancestor(nsec3 ? qpdb->nsec3 : qpdb->tree,
+					  name, &pval, NULL);
+	if (result == ISC_R_NOTFOUND) {
+		goto tree_exit;
+	}
+	node = pval;
+	dns_name_copy(&node->name, foundname);
+
+	/*
+	 * Look for a zone cut above the node, which takes precedence over
+	 * anything beneath it unless the caller wants glue.
+	 */
+	if (!nsec3) {
+		find_zonecut(&search, name);
+	}
+
+	if (result == DNS_R_PARTIALMATCH ||
+	    (search.zonecut != NULL && (options & DNS_DBFIND_GLUEOK) == 0))
+	{
+	partial_match:
+		if (search.zonecut != NULL) {
+			result = setup_delegation(&search, nodep, foundname,
+						  rdataset, sigrdataset);
+			goto tree_exit;
+		}
+
+		if (search.wild) {
+			/*
+			 * At least one of the levels in the search chain
+			 * potentially has a wildcard.  See if there's a
+			 * matching wildcard active in the current version.
+			 */
+			result = find_wildcard(&search, &node, name);
+			if (result == ISC_R_SUCCESS) {
+				dns_name_copy(name, foundname);
+				wild = true;
+				goto found;
+			} else if (result != ISC_R_NOTFOUND) {
+				goto tree_exit;
+			}
+		}
+
+		active = false;
+		if (!nsec3) {
+			/*
+			 * The NSEC3 tree won't have empty nodes,
+			 * so it isn't necessary to check for them.
+			 */
+			active = subtree_active(&search, name);
+		}
+
+		/*
+		 * If we're here, then the name does not exist, is not
+		 * beneath a zonecut, and there's no matching wildcard.
+		 */
+		if ((search.version->secure == dns_db_secure &&
+		     !search.version->havensec3) ||
+		    (search.options & DNS_DBFIND_FORCENSEC) != 0 ||
+		    (search.options & DNS_DBFIND_FORCENSEC3) != 0)
+		{
+			result = find_closest_nsec(&search, nodep, foundname,
+						   rdataset, sigrdataset, name,
+						   nsec3);
+			if (result == ISC_R_SUCCESS) {
+				result = active ? DNS_R_EMPTYNAME
+						: DNS_R_NXDOMAIN;
+			}
+		} else {
+			result = active ? DNS_R_EMPTYNAME : DNS_R_NXDOMAIN;
+		}
+		goto tree_exit;
+	}
+
+found:
+	/*
+	 * We have found a node whose name is the desired name, or we
+	 * have matched a wildcard.
+	 */
+
+	if (search.zonecut != NULL) {
+		/*
+		 * If we're beneath a zone cut, we don't want to look for
+		 * CNAMEs because they're not legitimate zone glue.
+		 */
+		cname_ok = false;
+	} else {
+		/*
+		 * The node may be a zone cut itself.  If it might be one,
+		 * make sure we check for it later.
+		 *
+		 * DS records live above the zone cut in ordinary zone so
+		 * we want to ignore any referral.
+		 *
+		 * Stub zones don't have anything "above" the delegation so
+		 * we always return a referral.
+		 */
+		if (node->delegating &&
+		    ((node != qpdb->origin_node &&
+		      !dns_rdatatype_atparent(type)) ||
+		     IS_STUB(qpdb)))
+		{
+			maybe_zonecut = true;
+		}
+	}
+
+	/*
+	 * Certain DNSSEC types are not subject to CNAME matching
+	 * (RFC4035, section 2.5 and RFC3007).
+	 *
+	 * We don't check for RRSIG, because we don't store RRSIG records
+	 * directly.
+	 */
+	if (type == dns_rdatatype_key || type == dns_rdatatype_nsec) {
+		cname_ok = false;
+	}
+
+	/*
+	 * We now go looking for rdata...
+	 */
+
+	found = NULL;
+	foundsig = NULL;
+	sigtype = QPDB_RDATATYPE_VALUE(dns_rdatatype_rrsig, type);
+	nsecheader = NULL;
+	nsecsig = NULL;
+	cnamesig = NULL;
+	empty_node = true;
+	for (header = node->data; header != NULL; header = header_next) {
+		header_next = header->next;
+		/*
+		 * Look for an active, extant rdataset.
+		 */
+		header = active_header(header, search.serial);
+		if (header == NULL) {
+			continue;
+		}
+
+		/*
+		 * We now know that there is at least one active
+		 * rdataset at this node.
+		 */
+		empty_node = false;
+
+		/*
+		 * Do special zone cut handling, if requested.
+		 */
+		if (maybe_zonecut && header->type == dns_rdatatype_ns) {
+			/*
+			 * We increment the reference count on node to
+			 * ensure that search->zonecut_header will
+			 * still be valid later.
+			 */
+			new_reference(qpdb, node);
+			search.zonecut = node;
+			search.zonecut_header = header;
+			search.zonecut_sigheader = NULL;
+			search.need_cleanup = true;
+			maybe_zonecut = false;
+			at_zonecut = true;
+			/*
+			 * It is not clear if KEY should still be
+			 * allowed at the parent side of the zone
+			 * cut or not.  It is needed for RFC3007
+			 * validated updates.
+			 */
+			if ((search.options & DNS_DBFIND_GLUEOK) == 0 &&
+			    type != dns_rdatatype_nsec &&
+			    type != dns_rdatatype_key)
+			{
+				/*
+				 * Glue is not OK, but any answer we
+				 * could return would be glue.  Return
+				 * the delegation.
+				 */
+				found = NULL;
+				break;
+			}
+			if (found != NULL && foundsig != NULL) {
+				break;
+			}
+		}
+
+		/*
+		 * If the NSEC3 record doesn't match the chain
+		 * we are using behave as if it isn't here.
+		 */
+		if (header->type == dns_rdatatype_nsec3 &&
+		    !matchparams(header, &search))
+		{
+			goto partial_match;
+		}
+		/*
+		 * If we found a type we were looking for,
+		 * remember it.
+		 */
+		if (header->type == type || type == dns_rdatatype_any ||
+		    (header->type == dns_rdatatype_cname && cname_ok))
+		{
+			/*
+			 * We've found the answer!
+			 */
+			found = header;
+			if (header->type == dns_rdatatype_cname && cname_ok) {
+				/*
+				 * We may be finding a CNAME instead
+				 * of the desired type.
+				 *
+				 * If we've already got the CNAME RRSIG,
+				 * use it, otherwise change sigtype
+				 * so that we find it.
+				 */
+				if (cnamesig != NULL) {
+					foundsig = cnamesig;
+				} else {
+					sigtype = QPDB_RDATATYPE_SIGCNAME;
+				}
+			}
+			/*
+			 * If we've got all we need, end the search.
+			 */
+			if (!maybe_zonecut && foundsig != NULL) {
+				break;
+			}
+		} else if (header->type == sigtype) {
+			/*
+			 * We've found the RRSIG rdataset for our
+			 * target type.  Remember it.
+			 */
+			foundsig = header;
+			/*
+			 * If we've got all we need, end the search.
+			 */
+			if (!maybe_zonecut && found != NULL) {
+				break;
+			}
+		} else if (header->type == dns_rdatatype_nsec &&
+			   !search.version->havensec3)
+		{
+			/*
+			 * Remember a NSEC rdataset even if we're
+			 * not specifically looking for it, because
+			 * we might need it later.
+			 */
+			nsecheader = header;
+		} else if (header->type == QPDB_RDATATYPE_SIGNSEC &&
+			   !search.version->havensec3)
+		{
+			/*
+			 * If we need the NSEC rdataset, we'll also
+			 * need its signature.
+			 */
+			nsecsig = header;
+		} else if (cname_ok && header->type == QPDB_RDATATYPE_SIGCNAME)
+		{
+			/*
+			 * If we get a CNAME match, we'll also need
+			 * its signature.
+			 */
+			cnamesig = header;
+		}
+	}
+
+	if (empty_node) {
+		/*
+		 * We have an exact match for the name, but there are no
+		 * active rdatasets in the desired version.  That means that
+		 * this node doesn't exist in the desired version, and that
+		 * we really have a partial match.
+		 */
+		if (!wild) {
+			goto partial_match;
+		}
+	}
+
+	/*
+	 * If we didn't find what we were looking for...
+	 */
+	if (found == NULL) {
+		if (search.zonecut != NULL) {
+			/*
+			 * We were trying to find glue at a node beneath a
+			 * zone cut, but didn't.
+			 *
+			 * Return the delegation.
+			 */
+			result = setup_delegation(&search, nodep, foundname,
+						  rdataset, sigrdataset);
+			goto tree_exit;
+		}
+		/*
+		 * The desired type doesn't exist.
+		 */
+		result = DNS_R_NXRRSET;
+		if (search.version->secure == dns_db_secure &&
+		    !search.version->havensec3 &&
+		    (nsecheader == NULL || nsecsig == NULL))
+		{
+			/*
+			 * The zone is secure but there's no NSEC,
+			 * or the NSEC has no signature!
+			 */
+			if (!wild) {
+				result = DNS_R_BADDB;
+				goto tree_exit;
+			}
+
+			result = find_closest_nsec(&search, nodep, foundname,
+						   rdataset, sigrdataset, name,
+						   false);
+			if (result == ISC_R_SUCCESS) {
+				result = DNS_R_EMPTYWILD;
+			}
+			goto tree_exit;
+		}
+		if ((search.options & DNS_DBFIND_FORCENSEC) != 0 &&
+		    nsecheader == NULL)
+		{
+			/*
+			 * There's no NSEC record, and we were told
+			 * to find one.
+			 */
+			result = DNS_R_BADDB;
+			goto tree_exit;
+		}
+		if (nodep != NULL) {
+			new_reference(qpdb, node);
+			*nodep = node;
+		}
+		if ((search.version->secure == dns_db_secure &&
+		     !search.version->havensec3) ||
+		    (search.options & DNS_DBFIND_FORCENSEC) != 0)
+		{
+			bind_rdataset(qpdb, node, nsecheader, rdataset);
+			if (nsecsig != NULL) {
+				bind_rdataset(qpdb, node, nsecsig, sigrdataset);
+			}
+		}
+		if (wild) {
+			foundname->attributes.wildcard = true;
+		}
+		goto tree_exit;
+	}
+
+	/*
+	 * We found what we were looking for, or we found a CNAME.
+	 */
+
+	if (type != found->type && type != dns_rdatatype_any &&
+	    found->type == dns_rdatatype_cname)
+	{
+		/*
+		 * We weren't doing an ANY query and we found a CNAME instead
+		 * of the type we were looking for, so we need to indicate
+		 * that result to the caller.
+		 */
+		result = DNS_R_CNAME;
+	} else if (search.zonecut != NULL) {
+		/*
+		 * If we're beneath a zone cut, we must indicate that the
+		 * result is glue, unless we're actually at the zone cut
+		 * and the type is NSEC or KEY.
+		 */
+		if (search.zonecut == node) {
+			/*
+			 * It is not clear if KEY should still be
+			 * allowed at the parent side of the zone
+			 * cut or not.  It is needed for RFC3007
+			 * validated updates.
+			 */
+			if (type == dns_rdatatype_nsec ||
+			    type == dns_rdatatype_nsec3 ||
+			    type == dns_rdatatype_key)
+			{
+				result = ISC_R_SUCCESS;
+			} else if (type == dns_rdatatype_any) {
+				result = DNS_R_ZONECUT;
+			} else {
+				result = DNS_R_GLUE;
+			}
+		} else {
+			result = DNS_R_GLUE;
+		}
+		/*
+		 * We might have found data that isn't glue, but was occluded
+		 * by a dynamic update.  If the caller cares about this, they
+		 * will have told us to validate glue.
+		 *
+		 * XXX We should cache the glue validity state!
+		 */
+		if (result == DNS_R_GLUE &&
+		    (search.options & DNS_DBFIND_VALIDATEGLUE) != 0 &&
+		    !valid_glue(&search, foundname, type, node))
+		{
+			result = setup_delegation(&search, nodep, foundname,
+						  rdataset, sigrdataset);
+			goto tree_exit;
+		}
+	} else {
+		/*
+		 * An ordinary successful query!
+		 */
+		result = ISC_R_SUCCESS;
+	}
+
+	if (nodep != NULL) {
+		if (!at_zonecut) {
+			new_reference(qpdb, node);
+		} else {
+			search.need_cleanup = false;
+		}
+		*nodep = node;
+	}
+
+	if (type != dns_rdatatype_any) {
+		bind_rdataset(qpdb, node, found, rdataset);
+		if (foundsig != NULL) {
+			bind_rdataset(qpdb, node, foundsig, sigrdataset);
+		}
+	}
+
+	if (wild) {
+		foundname->attributes.wildcard = true;
+	}
+
+tree_exit:
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	/*
+	 * If we found a zonecut but aren't going to use it, we have to
+	 * let go of it.
+	 */
+	if (search.need_cleanup) {
+		dns_dbnode_t *zonecut = search.zonecut;
+		INSIST(zonecut != NULL);
+		detachnode(db, &zonecut);
+	}
+
+	if (close_version) {
+		closeversion(db, &version, false);
+	}
+
+	return (result);
+}
+
+static void
+printnode(dns_db_t *db, dns_dbnode_t *dbnode, FILE *out) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	qpdb_node_t *node = (qpdb_node_t *)dbnode;
+	bool first;
+	uint32_t refs;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	refs = isc_refcount_current(&node->references);
+	fprintf(out, "node %p, %" PRIu32 " references\n", node, refs);
+	if (node->data != NULL) {
+		qpdb_header_t *current, *top_next;
+
+		for (current = node->data; current != NULL;
+		     current = top_next)
+		{
+			top_next = current->next;
+			first = true;
+			fprintf(out, "\ttype %u", current->type);
+			do {
+				if (!first) {
+					fprintf(out, "\t");
+				}
+				first = false;
+				fprintf(out,
+					"\tserial = %lu, ttl = %u, "
+					"trust = %u, attributes = %" PRIuLEAST16
+					", "
+					"resign = %u\n",
+					(unsigned long)current->serial,
+					current->ttl, current->trust,
+					current->attributes,
+					(current->resign << 1) |
+						current->resign_lsb);
+				current = current->down;
+			} while (current != NULL);
+		}
+	} else {
+		fprintf(out, "(empty)\n");
+	}
+
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+}
+
+static isc_result_t
+createiterator(dns_db_t *db, unsigned int options,
+	       dns_dbiterator_t **iteratorp) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	qpdb_dbiterator_t *qpdbiter;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	qpdbiter = isc_mem_get(qpdb->common.mctx, sizeof(*qpdbiter));
+
+	qpdbiter->common.methods = &dbiterator_methods;
+	qpdbiter->common.db = NULL;
+	dns_db_attach(db, &qpdbiter->common.db);
+	qpdbiter->common.relative_names = ((options & DNS_DB_RELATIVENAMES) !=
+					   0);
+	qpdbiter->common.magic = DNS_DBITERATOR_MAGIC;
+	qpdbiter->result = ISC_R_SUCCESS;
+	qpdbiter->node = NULL;
+	qpdbiter->origin = NULL;
+	qpdbiter->nsec3only = ((options & DNS_DB_NSEC3ONLY) != 0);
+	qpdbiter->nonsec3 = ((options & DNS_DB_NONSEC3) != 0);
+
+	*iteratorp = (dns_dbiterator_t *)qpdbiter;
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+findrdataset(dns_db_t *db, dns_dbnode_t *dbnode, dns_dbversion_t *dbversion,
+	     dns_rdatatype_t type, dns_rdatatype_t covers, isc_stdtime_t now,
+	     dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	qpdb_node_t *node = (qpdb_node_t *)dbnode;
+	qpdb_header_t *header, *header_next, *found, *foundsig;
+	qpdb_serial_t serial;
+	qpdb_version_t *version = dbversion;
+	bool close_version = false;
+	qpdb_rdatatype_t matchtype, sigmatchtype;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE(type != dns_rdatatype_any);
+	INSIST(version == NULL || version->qpdb == qpdb);
+
+	UNUSED(now);
+
+	if (version == NULL) {
+		currentversion(db, (dns_dbversion_t **)(void *)(&version));
+		close_version = true;
+	}
+	serial = version->serial;
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	found = NULL;
+	foundsig = NULL;
+	matchtype = QPDB_RDATATYPE_VALUE(type, covers);
+	if (covers == 0) {
+		sigmatchtype = QPDB_RDATATYPE_VALUE(dns_rdatatype_rrsig, type);
+	} else {
+		sigmatchtype = 0;
+	}
+
+	for (header = node->data; header != NULL; header = header_next) {
+		header_next = header->next;
+		header = active_header(header, serial);
+		if (header == NULL) {
+			continue;
+		}
+		/*
+		 * We have an active, extant rdataset.  If it's a
+		 * type we're looking for, remember it.
+		 */
+		if (header->type == matchtype) {
+			found = header;
+			if (foundsig != NULL) {
+				break;
+			}
+		} else if (header->type == sigmatchtype) {
+			foundsig = header;
+			if (found != NULL) {
+				break;
+			}
+		}
+	}
+	if (found != NULL) {
+		bind_rdataset(qpdb, node, found, rdataset);
+		if (foundsig != NULL) {
+			bind_rdataset(qpdb, node, foundsig, sigrdataset);
+		}
+	}
+
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	if (close_version) {
+		closeversion(db, (dns_dbversion_t **)(void *)(&version), false);
+	}
+
+	if (found == NULL) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+allrdatasets(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *dbversion,
+	     unsigned int options, isc_stdtime_t now,
+	     dns_rdatasetiter_t **iteratorp) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	qpdb_version_t *version = dbversion;
+	qpdb_rdatasetiter_t *iterator;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	INSIST(version == NULL || version->qpdb == qpdb);
+
+	UNUSED(now);
+
+	if (version == NULL) {
+		currentversion(db, (dns_dbversion_t **)(void *)(&version));
+	} else {
+		isc_refcount_increment(&version->references);
+	}
+
+	iterator = isc_mem_get(qpdb->common.mctx, sizeof(*iterator));
+	iterator->common.magic = DNS_RDATASETITER_MAGIC;
+	iterator->common.methods = &rdatasetiter_methods;
+	iterator->common.db = db;
+	iterator->common.node = node;
+	iterator->common.version = (dns_dbversion_t *)version;
+	iterator->common.options = options;
+	iterator->common.now = 0;
+
+	isc_refcount_increment(&((qpdb_node_t *)node)->references);
+
+	iterator->current = NULL;
+
+	*iteratorp = (dns_rdatasetiter_t *)iterator;
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Adding and removing rdatasets
+ */
+
+static bool
+cname_and_other_data(qpdb_node_t *node, qpdb_serial_t serial) {
+	qpdb_header_t *header, *header_next;
+	bool cname = false, other_data = false;
+	dns_rdatatype_t rdtype;
+
+	/*
+	 * The caller must hold the database lock.
+	 */
+
+	/*
+	 * Look for CNAME and "other data" rdatasets active in our version.
+	 * "Other data" is any rdataset whose type is not KEY, NSEC, SIG or
+	 * RRSIG.
+	 */
+	for (header = node->data; header != NULL; header = header_next) {
+		header_next = header->next;
+		rdtype = QPDB_RDATATYPE_BASE(header->type);
+		if (header->type != dns_rdatatype_cname &&
+		    (rdtype == dns_rdatatype_key ||
+		     rdtype == dns_rdatatype_sig ||
+		     rdtype == dns_rdatatype_nsec ||
+		     rdtype == dns_rdatatype_rrsig))
+		{
+			continue;
+		}
+		if (active_header(header, serial) == NULL) {
+			continue;
+		}
+		if (header->type == dns_rdatatype_cname) {
+			cname = true;
+		} else {
+			other_data = true;
+		}
+	}
+
+	return (cname && other_data);
+}
+
+static uint64_t
+recordsize(qpdb_header_t *header, unsigned int namelen) {
+	return (dns_rdataslab_rdatasize((unsigned char *)header,
+					sizeof(*header)) +
+		sizeof(dns_ttl_t) + sizeof(dns_rdatatype_t) +
+		sizeof(dns_rdataclass_t) + namelen);
+}
+
+/*
+ * Caller must be holding the database write lock.
+ */
+static void
+update_recordsandxfrsize(bool add, qpdb_version_t *version,
+			 qpdb_header_t *header, unsigned int namelen) {
+	unsigned char *hdr = (unsigned char *)header;
+	size_t hdrsize = sizeof(*header);
+
+	if (add) {
+		version->records += dns_rdataslab_count(hdr, hdrsize);
+		version->xfrsize += recordsize(header, namelen);
+	} else {
+		version->records -= dns_rdataslab_count(hdr, hdrsize);
+		version->xfrsize -= recordsize(header, namelen);
+	}
+}
+
+static void
+init_header(qpdb_header_t *header, qpdb_node_t *node, qpdb_rdatatype_t type,
+	    qpdb_serial_t serial) {
+	header->serial = serial;
+	header->ttl = 0;
+	header->type = type;
+	header->attributes = 0;
+	header->trust = 0;
+	header->resign = 0;
+	header->resign_lsb = 0;
+	header->heap_index = 0;
+	header->next = NULL;
+	header->down = NULL;
+	atomic_init(&header->count, atomic_fetch_add_relaxed(&init_count, 1));
+	header->node = node;
+	ISC_LINK_INIT(header, link);
+}
+
+static void
+set_resign(qpdb_header_t *header, dns_rdataset_t *rdataset) {
+	if ((rdataset->attributes & DNS_RDATASETATTR_RESIGN) != 0) {
+		header->attributes |= RDATASET_ATTR_RESIGN;
+		header->resign =
+			(isc_stdtime_t)(dns_time64_from32(rdataset->resign) >>
+					1);
+		header->resign_lsb = rdataset->resign & 0x1;
+	}
+}
+
+/*
+ * Add 'newheader' to 'node' in 'version'.
+ *
+ * Caller must be holding the database write lock.
+ */
+static isc_result_t
+add_header(qpdb_t *qpdb, qpdb_node_t *node, qpdb_version_t *version,
+	   qpdb_header_t *newheader, unsigned int options, bool loading,
+	   dns_rdataset_t *addedrdataset) {
+	qpdb_changed_t *changed = NULL;
+	qpdb_header_t *topheader = NULL, *topheader_prev = NULL;
+	qpdb_header_t *header = NULL;
+	unsigned char *merged = NULL;
+	unsigned int namelen = node->name.length;
+	isc_result_t result;
+	bool header_nx;
+	bool newheader_nx;
+	bool merge = ((options & DNS_DBADD_MERGE) != 0);
+
+	if (!loading) {
+		/*
+		 * We always add a changed record, even if no changes end up
+		 * being made to this node, because it's harmless and
+		 * simplifies the code.
+		 */
+		changed = add_changed(qpdb, version, node);
+	}
+
+	newheader_nx = NONEXISTENT(newheader);
+	for (topheader = node->data; topheader != NULL;
+	     topheader = topheader->next)
+	{
+		if (topheader->type == newheader->type) {
+			break;
+		}
+		topheader_prev = topheader;
+	}
+
+	/*
+	 * If header isn't NULL, we've found the right type.  There may be
+	 * IGNORE rdatasets between the top of the chain and the first real
+	 * data.  We skip over them.
+	 */
+	header = topheader;
+	while (header != NULL && IGNORE(header)) {
+		header = header->down;
+	}
+	if (header != NULL) {
+		header_nx = NONEXISTENT(header);
+
+		/*
+		 * Deleting an already non-existent rdataset has no effect.
+		 */
+		if (header_nx && newheader_nx) {
+			free_header(qpdb, newheader);
+			return (DNS_R_UNCHANGED);
+		}
+
+		/*
+		 * Don't merge if a nonexistent rdataset is involved.
+		 */
+		if (merge && (header_nx || newheader_nx)) {
+			merge = false;
+		}
+
+		/*
+		 * If 'merge' is true, we'll try to create a new rdataset
+		 * that is the union of 'newheader' and 'header'.
+		 */
+		if (merge) {
+			unsigned int flags = 0;
+			INSIST(version->serial >= header->serial);
+			result = ISC_R_SUCCESS;
+
+			if ((options & DNS_DBADD_EXACT) != 0) {
+				flags |= DNS_RDATASLAB_EXACT;
+			}
+			if ((options & DNS_DBADD_EXACTTTL) != 0 &&
+			    newheader->ttl != header->ttl)
+			{
+				result = DNS_R_NOTEXACT;
+			} else if (newheader->ttl != header->ttl) {
+				flags |= DNS_RDATASLAB_FORCE;
+			}
+			if (result == ISC_R_SUCCESS) {
+				result = dns_rdataslab_merge(
+					(unsigned char *)header,
+					(unsigned char *)newheader,
+					(unsigned int)(sizeof(*newheader)),
+					qpdb->common.mctx,
+					qpdb->common.rdclass,
+					(dns_rdatatype_t)header->type, flags,
+					&merged);
+			}
+			if (result != ISC_R_SUCCESS) {
+				free_header(qpdb, newheader);
+				return (result);
+			}
+
+			/*
+			 * If 'header' has the same serial number as
+			 * we do, we could clean it up now if we knew
+			 * that our caller had no references to it.
+			 * We don't know this, however, so we leave it
+			 * alone.  It will get cleaned up when
+			 * clean_zone_node() runs.
+			 *
+			 * The merged rdataset has a copy of the header
+			 * of 'newheader', which isn't on the heap yet.
+			 */
+			free_header(qpdb, newheader);
+			newheader = (qpdb_header_t *)merged;
+			if (loading && RESIGN(newheader) && RESIGN(header) &&
+			    resign_sooner(header, newheader))
+			{
+				newheader->resign = header->resign;
+				newheader->resign_lsb = header->resign_lsb;
+			}
+		}
+
+		INSIST(version->serial >= topheader->serial);
+		if (loading) {
+			newheader->down = NULL;
+			if (RESIGN(newheader)) {
+				resign_insert(qpdb, newheader);
+				/*
+				 * Don't call resign_delete as we don't need
+				 * to reverse the delete.  The free_header
+				 * call below will clean up the heap entry.
+				 */
+			}
+
+			/*
+			 * There are no other references to 'header' when
+			 * loading, so we MAY clean up 'header' now.
+			 * Since we don't generate changed records when
+			 * loading, we MUST clean up 'header' now.
+			 */
+			if (topheader_prev != NULL) {
+				topheader_prev->next = newheader;
+			} else {
+				node->data = newheader;
+			}
+			newheader->next = topheader->next;
+			if (!header_nx) {
+				update_recordsandxfrsize(false, version, header,
+							 namelen);
+			}
+			free_header(qpdb, header);
+		} else {
+			if (RESIGN(newheader)) {
+				resign_insert(qpdb, newheader);
+				resign_delete(qpdb, version, header);
+			}
+			if (topheader_prev != NULL) {
+				topheader_prev->next = newheader;
+			} else {
+				node->data = newheader;
+			}
+			newheader->next = topheader->next;
+			newheader->down = topheader;
+			topheader->next = newheader;
+			node->dirty = true;
+			changed->dirty = true;
+			if (!header_nx) {
+				update_recordsandxfrsize(false, version, header,
+							 namelen);
+			}
+		}
+	} else {
+		/*
+		 * No non-IGNORED rdatasets of the given type exist at
+		 * this node.
+		 */
+
+		/*
+		 * If we're trying to delete the type, don't bother.
+		 */
+		if (newheader_nx) {
+			free_header(qpdb, newheader);
+			return (DNS_R_UNCHANGED);
+		}
+
+		if (RESIGN(newheader)) {
+			resign_insert(qpdb, newheader);
+		}
+
+		if (topheader != NULL) {
+			/*
+			 * We have an list of rdatasets of the given type,
+			 * but they're all marked IGNORE.  We simply insert
+			 * the new rdataset at the head of the list.
+			 *
+			 * Ignored rdatasets cannot occur during loading, so
+			 * we INSIST on it.
+			 */
+			INSIST(!loading);
+			INSIST(version->serial >= topheader->serial);
+			if (topheader_prev != NULL) {
+				topheader_prev->next = newheader;
+			} else {
+				node->data = newheader;
+			}
+			newheader->next = topheader->next;
+			newheader->down = topheader;
+			topheader->next = newheader;
+			node->dirty = true;
+			changed->dirty = true;
+		} else {
+			/*
+			 * No rdatasets of the given type exist at the node.
+			 */
+			newheader->next = node->data;
+			newheader->down = NULL;
+			node->data = newheader;
+		}
+	}
+
+	if (!newheader_nx) {
+		update_recordsandxfrsize(true, version, newheader, namelen);
+	}
+
+	/*
+	 * Check if the node now contains CNAME and other data.
+	 */
+	if (cname_and_other_data(node, version->serial)) {
+		return (DNS_R_CNAMEANDOTHER);
+	}
+
+	bind_rdataset(qpdb, node, newheader, addedrdataset);
+
+	return (ISC_R_SUCCESS);
+}
+
+static bool
+delegating_type(qpdb_t *qpdb, qpdb_node_t *node, dns_rdatatype_t type) {
+	return (type == dns_rdatatype_dname ||
+		(type == dns_rdatatype_ns &&
+		 (node != qpdb->origin_node || IS_STUB(qpdb))));
+}
+
+static isc_result_t
+addrdataset(dns_db_t *db, dns_dbnode_t *dbnode, dns_dbversion_t *dbversion,
+	    isc_stdtime_t now, dns_rdataset_t *rdataset, unsigned int options,
+	    dns_rdataset_t *addedrdataset) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	qpdb_node_t *node = (qpdb_node_t *)dbnode;
+	qpdb_version_t *version = dbversion;
+	isc_region_t region;
+	qpdb_header_t *newheader;
+	isc_result_t result;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE(version != NULL && version->qpdb == qpdb);
+	REQUIRE(node->nsec3 == (rdataset->type == dns_rdatatype_nsec3 ||
+				rdataset->covers == dns_rdatatype_nsec3));
+
+	UNUSED(now);
+
+	/*
+	 * SOA records are only allowed at top of zone.
+	 */
+	if (rdataset->type == dns_rdatatype_soa && node != qpdb->origin_node) {
+		return (DNS_R_NOTZONETOP);
+	}
+
+	result = dns_rdataslab_fromrdataset(rdataset, qpdb->common.mctx,
+					    &region, sizeof(qpdb_header_t));
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	newheader = (qpdb_header_t *)region.base;
+	init_header(newheader, node,
+		    QPDB_RDATATYPE_VALUE(rdataset->type, rdataset->covers),
+		    version->serial);
+	newheader->ttl = rdataset->ttl;
+	newheader->trust = rdataset->trust;
+	set_resign(newheader, rdataset);
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+	result = add_header(qpdb, node, version, newheader, options, false,
+			    addedrdataset);
+	if (result == ISC_R_SUCCESS &&
+	    delegating_type(qpdb, node, rdataset->type))
+	{
+		node->delegating = true;
+	}
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
+
+	return (result);
+}
+
+static isc_result_t
+subtractrdataset(dns_db_t *db, dns_dbnode_t *dbnode, dns_dbversion_t *dbversion,
+		 dns_rdataset_t *rdataset, unsigned int options,
+		 dns_rdataset_t *newrdataset) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	qpdb_node_t *node = (qpdb_node_t *)dbnode;
+	qpdb_version_t *version = dbversion;
+	qpdb_header_t *topheader, *topheader_prev, *header, *newheader;
+	unsigned int namelen = node->name.length;
+	unsigned char *subresult;
+	isc_region_t region;
+	isc_result_t result;
+	qpdb_changed_t *changed;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE(version != NULL && version->qpdb == qpdb);
+	REQUIRE(node->nsec3 == (rdataset->type == dns_rdatatype_nsec3 ||
+				rdataset->covers == dns_rdatatype_nsec3));
+
+	result = dns_rdataslab_fromrdataset(rdataset, qpdb->common.mctx,
+					    &region, sizeof(qpdb_header_t));
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	newheader = (qpdb_header_t *)region.base;
+	init_header(newheader, node,
+		    QPDB_RDATATYPE_VALUE(rdataset->type, rdataset->covers),
+		    version->serial);
+	newheader->ttl = rdataset->ttl;
+	set_resign(newheader, rdataset);
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+
+	changed = add_changed(qpdb, version, node);
+
+	topheader_prev = NULL;
+	for (topheader = node->data; topheader != NULL;
+	     topheader = topheader->next)
+	{
+		if (topheader->type == newheader->type) {
+			break;
+		}
+		topheader_prev = topheader;
+	}
+	/*
+	 * If header isn't NULL, we've found the right type.  There may be
+	 * IGNORE rdatasets between the top of the chain and the first real
+	 * data.  We skip over them.
+	 */
+	header = topheader;
+	while (header != NULL && IGNORE(header)) {
+		header = header->down;
+	}
+	if (header != NULL && EXISTS(header)) {
+		unsigned int flags = 0;
+		subresult = NULL;
+		result = ISC_R_SUCCESS;
+		if ((options & DNS_DBSUB_EXACT) != 0) {
+			flags |= DNS_RDATASLAB_EXACT;
+			if (newheader->ttl != header->ttl) {
+				result = DNS_R_NOTEXACT;
+			}
+		}
+		if (result == ISC_R_SUCCESS) {
+			result = dns_rdataslab_subtract(
+				(unsigned char *)header,
+				(unsigned char *)newheader,
+				(unsigned int)(sizeof(*newheader)),
+				qpdb->common.mctx, qpdb->common.rdclass,
+				(dns_rdatatype_t)header->type, flags,
+				&subresult);
+		}
+		if (result == ISC_R_SUCCESS) {
+			free_header(qpdb, newheader);
+			newheader = (qpdb_header_t *)subresult;
+			/*
+			 * The rdataslab subtraction routine copies the
+			 * reserved portion of header, not newheader, so
+			 * the fields that belong to the old rdataset must
+			 * be reset.
+			 */
+			newheader->serial = version->serial;
+			newheader->attributes = 0;
+			newheader->heap_index = 0;
+			ISC_LINK_INIT(newheader, link);
+			if (RESIGN(header)) {
+				newheader->attributes |= RDATASET_ATTR_RESIGN;
+				resign_insert(qpdb, newheader);
+			}
+			update_recordsandxfrsize(true, version, newheader,
+						 namelen);
+		} else if (result == DNS_R_NXRRSET) {
+			/*
+			 * This subtraction would remove all of the rdata;
+			 * add a nonexistent header instead.
+			 */
+			free_header(qpdb, newheader);
+			newheader = isc_mem_get(qpdb->common.mctx,
+						sizeof(*newheader));
+			init_header(newheader, node, topheader->type,
+				    version->serial);
+			newheader->attributes = RDATASET_ATTR_NONEXISTENT;
+		} else {
+			free_header(qpdb, newheader);
+			goto unlock;
+		}
+
+		/*
+		 * If we're here, we want to link newheader in front of
+		 * topheader.
+		 */
+		INSIST(version->serial >= topheader->serial);
+		update_recordsandxfrsize(false, version, header, namelen);
+		if (topheader_prev != NULL) {
+			topheader_prev->next = newheader;
+		} else {
+			node->data = newheader;
+		}
+		newheader->next = topheader->next;
+		newheader->down = topheader;
+		topheader->next = newheader;
+		node->dirty = true;
+		changed->dirty = true;
+		resign_delete(qpdb, version, header);
+	} else {
+		/*
+		 * The rdataset doesn't exist, so we don't need to do anything
+		 * to satisfy the deletion request.
+		 */
+		free_header(qpdb, newheader);
+		if ((options & DNS_DBSUB_EXACT) != 0) {
+			result = DNS_R_NOTEXACT;
+		} else {
+			result = DNS_R_UNCHANGED;
+		}
+	}
+
+	if (result == ISC_R_SUCCESS) {
+		bind_rdataset(qpdb, node, newheader, newrdataset);
+	}
+
+	if (result == DNS_R_NXRRSET && (options & DNS_DBSUB_WANTOLD) != 0) {
+		bind_rdataset(qpdb, node, header, newrdataset);
+	}
+
+unlock:
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
+
+	return (result);
+}
+
+static isc_result_t
+deleterdataset(dns_db_t *db, dns_dbnode_t *dbnode, dns_dbversion_t *dbversion,
+	       dns_rdatatype_t type, dns_rdatatype_t covers) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	qpdb_node_t *node = (qpdb_node_t *)dbnode;
+	qpdb_version_t *version = dbversion;
+	isc_result_t result;
+	qpdb_header_t *newheader;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE(version != NULL && version->qpdb == qpdb);
+
+	if (type == dns_rdatatype_any) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+	if (type == dns_rdatatype_rrsig && covers == 0) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	newheader = isc_mem_get(qpdb->common.mctx, sizeof(*newheader));
+	init_header(newheader, node, QPDB_RDATATYPE_VALUE(type, covers),
+		    version->serial);
+	newheader->attributes = RDATASET_ATTR_NONEXISTENT;
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+	result = add_header(qpdb, node, version, newheader, DNS_DBADD_FORCE,
+			    false, NULL);
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
+
+	return (result);
+}
+
+/*
+ * Loading
+ */
+
+static isc_result_t
+loading_addrdataset(void *arg, const dns_name_t *name,
+		    dns_rdataset_t *rdataset) {
+	qpdb_t *qpdb = arg;
+	qpdb_node_t *node;
+	isc_result_t result;
+	isc_region_t region;
+	qpdb_header_t *newheader;
+	bool nsec3;
+
+	REQUIRE(rdataset->rdclass == qpdb->common.rdclass);
+
+	/*
+	 * SOA records are only allowed at top of zone.
+	 */
+	if (rdataset->type == dns_rdatatype_soa &&
+	    !dns_name_equal(name, &qpdb->common.origin))
+	{
+		return (DNS_R_NOTZONETOP);
+	}
+
+	if (dns_name_iswildcard(name)) {
+		/*
+		 * NS record owners cannot legally be wild cards.
+		 */
+		if (rdataset->type == dns_rdatatype_ns) {
+			return (DNS_R_INVALIDNS);
+		}
+		/*
+		 * NSEC3 record owners cannot legally be wild cards.
+		 */
+		if (rdataset->type == dns_rdatatype_nsec3) {
+			return (DNS_R_INVALIDNSEC3);
+		}
+	}
+
+	nsec3 = (rdataset->type == dns_rdatatype_nsec3 ||
+		 rdataset->covers == dns_rdatatype_nsec3);
+
+	result = dns_rdataslab_fromrdataset(rdataset, qpdb->common.mctx,
+					    &region, sizeof(qpdb_header_t));
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+
+	node = add_node(qpdb, name, nsec3);
+
+	newheader = (qpdb_header_t *)region.base;
+	init_header(newheader, node,
+		    QPDB_RDATATYPE_VALUE(rdataset->type, rdataset->covers), 1);
+	newheader->ttl = rdataset->ttl;
+	newheader->trust = rdataset->trust;
+	set_resign(newheader, rdataset);
+
+	result = add_header(qpdb, node, qpdb->current_version, newheader,
+			    DNS_DBADD_MERGE, true, NULL);
+	if (result == ISC_R_SUCCESS &&
+	    delegating_type(qpdb, node, rdataset->type))
+	{
+		node->delegating = true;
+	} else if (result == DNS_R_UNCHANGED) {
+		result = ISC_R_SUCCESS;
+	}
+
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
+
+	return (result);
+}
+
+static isc_result_t
+beginload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+
+	REQUIRE(DNS_CALLBACK_VALID(callbacks));
+	REQUIRE(VALID_QPDB(qpdb));
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+
+	REQUIRE((qpdb->attributes & (QPDB_ATTR_LOADED | QPDB_ATTR_LOADING)) ==
+		0);
+	qpdb->attributes |= QPDB_ATTR_LOADING;
+
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
+
+	callbacks->add = loading_addrdataset;
+	callbacks->add_private = qpdb;
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	qpdb_version_t *version;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE(DNS_CALLBACK_VALID(callbacks));
+	REQUIRE(callbacks->add_private == qpdb);
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+
+	REQUIRE((qpdb->attributes & QPDB_ATTR_LOADING) != 0);
+	REQUIRE((qpdb->attributes & QPDB_ATTR_LOADED) == 0);
+
+	qpdb->attributes &= ~QPDB_ATTR_LOADING;
+	qpdb->attributes |= QPDB_ATTR_LOADED;
+	version = qpdb->current_version;
+
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
+
+	/*
+	 * If there's a KEY rdataset at the zone origin containing a
+	 * zone key, we consider the zone secure.
+	 */
+	iszonesecure(db, version, qpdb->origin_node);
+
+	callbacks->add = NULL;
+	callbacks->add_private = NULL;
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+dump(dns_db_t *db, dns_dbversion_t *dbversion, const char *filename,
+     dns_masterformat_t masterformat) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	qpdb_version_t *version = dbversion;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	INSIST(version == NULL || version->qpdb == qpdb);
+
+	return (dns_master_dump(qpdb->common.mctx, db, dbversion,
+				&dns_master_style_default, filename,
+				masterformat, NULL));
+}
+
+/*
+ * Miscellaneous database methods
+ */
+
+static bool
+issecure(dns_db_t *db) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	bool secure;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	secure = (qpdb->current_version->secure == dns_db_secure);
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	return (secure);
+}
+
+static bool
+isdnssec(dns_db_t *db) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	bool dnssec;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	dnssec = (qpdb->current_version->secure != dns_db_insecure);
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	return (dnssec);
+}
+
+static unsigned int
+nodecount(dns_db_t *db, dns_dbtree_t tree) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	unsigned int count;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	switch (tree) {
+	case dns_dbtree_main:
+		count = dns_qp_count(qpdb->tree);
+		break;
+	case dns_dbtree_nsec:
+		/*
+		 * There is no auxiliary NSEC tree: NSEC records are found
+		 * by walking the main trie backwards.
+		 */
+		count = 0;
+		break;
+	case dns_dbtree_nsec3:
+		count = dns_qp_count(qpdb->nsec3);
+		break;
+	default:
+		UNREACHABLE();
+	}
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	return (count);
+}
+
+static bool
+ispersistent(dns_db_t *db) {
+	UNUSED(db);
+	return (false);
+}
+
+static void
+overmem(dns_db_t *db, bool over) {
+	/* This is an empty callback.  See adb.c:water() */
+
+	UNUSED(db);
+	UNUSED(over);
+
+	return;
+}
+
+static void
+setloop(dns_db_t *db, isc_loop_t *loop) {
+	/* Nothing is done asynchronously. */
+
+	UNUSED(db);
+	UNUSED(loop);
+}
+
+static isc_result_t
+getoriginnode(dns_db_t *db, dns_dbnode_t **nodep) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE(nodep != NULL && *nodep == NULL);
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	new_reference(qpdb, qpdb->origin_node);
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	*nodep = qpdb->origin_node;
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+getnsec3parameters(dns_db_t *db, dns_dbversion_t *dbversion, dns_hash_t *hash,
+		   uint8_t *flags, uint16_t *iterations, unsigned char *salt,
+		   size_t *salt_length) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	qpdb_version_t *version = dbversion;
+	isc_result_t result = ISC_R_NOTFOUND;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	INSIST(version == NULL || version->qpdb == qpdb);
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	if (version == NULL) {
+		version = qpdb->current_version;
+	}
+
+	if (version->havensec3) {
+		if (hash != NULL) {
+			*hash = version->hash;
+		}
+		if (salt != NULL && salt_length != NULL) {
+			REQUIRE(*salt_length >= version->salt_length);
+			memmove(salt, version->salt, version->salt_length);
+		}
+		if (salt_length != NULL) {
+			*salt_length = version->salt_length;
+		}
+		if (iterations != NULL) {
+			*iterations = version->iterations;
+		}
+		if (flags != NULL) {
+			*flags = version->flags;
+		}
+		result = ISC_R_SUCCESS;
+	}
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	return (result);
+}
+
+static isc_result_t
+getsize(dns_db_t *db, dns_dbversion_t *dbversion, uint64_t *records,
+	uint64_t *xfrsize) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	qpdb_version_t *version = dbversion;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	INSIST(version == NULL || version->qpdb == qpdb);
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	if (version == NULL) {
+		version = qpdb->current_version;
+	}
+
+	if (records != NULL) {
+		*records = version->records;
+	}
+
+	if (xfrsize != NULL) {
+		*xfrsize = version->xfrsize;
+	}
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+setsigningtime(dns_db_t *db, dns_rdataset_t *rdataset, isc_stdtime_t resign) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	qpdb_header_t *header, oldheader;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE(rdataset != NULL);
+	REQUIRE(rdataset->methods == &rdataset_methods);
+
+	header = rdataset->private3;
+	header--;
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+
+	oldheader = *header;
+	/*
+	 * Only break the heap invariant (by adjusting resign and resign_lsb)
+	 * if we are going to be restoring it by calling isc_heap_increased
+	 * or isc_heap_decreased.
+	 */
+	if (resign != 0) {
+		header->resign = (isc_stdtime_t)(dns_time64_from32(resign) >>
+						 1);
+		header->resign_lsb = resign & 0x1;
+	}
+	if (header->heap_index != 0) {
+		INSIST(RESIGN(header));
+		if (resign == 0) {
+			isc_heap_delete(qpdb->heap, header->heap_index);
+			header->heap_index = 0;
+		} else if (resign_sooner(header, &oldheader)) {
+			isc_heap_increased(qpdb->heap, header->heap_index);
+		} else if (resign_sooner(&oldheader, header)) {
+			isc_heap_decreased(qpdb->heap, header->heap_index);
+		}
+	} else if (resign != 0) {
+		header->attributes |= RDATASET_ATTR_RESIGN;
+		resign_insert(qpdb, header);
+	}
+
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+getsigningtime(dns_db_t *db, dns_rdataset_t *rdataset, dns_name_t *foundname) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	qpdb_header_t *header;
+	isc_result_t result = ISC_R_NOTFOUND;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	header = isc_heap_element(qpdb->heap, 1);
+	if (header != NULL) {
+		bind_rdataset(qpdb, header->node, header, rdataset);
+		if (foundname != NULL) {
+			dns_name_copy(&header->node->name, foundname);
+		}
+		result = ISC_R_SUCCESS;
+	}
+
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	return (result);
+}
+
+static void
+resigned(dns_db_t *db, dns_rdataset_t *rdataset, dns_dbversion_t *dbversion) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	qpdb_version_t *version = dbversion;
+	qpdb_header_t *header;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE(rdataset != NULL);
+	REQUIRE(rdataset->methods == &rdataset_methods);
+	REQUIRE(qpdb->future_version == version);
+	REQUIRE(version != NULL);
+	REQUIRE(version->writer);
+	REQUIRE(version->qpdb == qpdb);
+
+	header = rdataset->private3;
+	INSIST(header != NULL);
+	header--;
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+	/*
+	 * Delete from heap and save to re-signed list so that it can
+	 * be restored if we backout of this change.
+	 */
+	resign_delete(qpdb, version, header);
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
+}
+
+static isc_result_t
+nodefullname(dns_db_t *db, dns_dbnode_t *dbnode, dns_name_t *name) {
+	qpdb_t *qpdb = (qpdb_t *)db;
+	qpdb_node_t *node = (qpdb_node_t *)dbnode;
+
+	REQUIRE(VALID_QPDB(qpdb));
+	REQUIRE(node != NULL);
+	REQUIRE(name != NULL);
+
+	dns_name_copy(&node->name, name);
+
+	return (ISC_R_SUCCESS);
+}
+
+static dns_dbmethods_t zone_methods = { attach,
+					detach,
+					beginload,
+					endload,
+					dump,
+					currentversion,
+					newversion,
+					attachversion,
+					closeversion,
+					findnode,
+					find,
+					NULL, /* findzonecut */
+					attachnode,
+					detachnode,
+					NULL, /* expirenode */
+					printnode,
+					createiterator,
+					findrdataset,
+					allrdatasets,
+					addrdataset,
+					subtractrdataset,
+					deleterdataset,
+					issecure,
+					nodecount,
+					ispersistent,
+					overmem,
+					setloop,
+					getoriginnode,
+					NULL, /* transfernode */
+					getnsec3parameters,
+					findnsec3node,
+					setsigningtime,
+					getsigningtime,
+					resigned,
+					isdnssec,
+					NULL, /* getrrsetstats */
+					NULL, /* rpz_attach */
+					NULL, /* rpz_ready */
+					NULL, /* findnodeext */
+					NULL, /* findext */
+					NULL, /* setcachestats */
+					NULL, /* hashsize */
+					nodefullname,
+					getsize,
+					NULL, /* setservestalettl */
+					NULL, /* getservestalettl */
+					NULL, /* setservestalerefresh */
+					NULL, /* getservestalerefresh */
+					NULL, /* setgluecachestats */
+					NULL /* serialize */ };
+
+isc_result_t
+dns_qpdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
+		dns_rdataclass_t rdclass, unsigned int argc, char *argv[],
+		void *driverarg, dns_db_t **dbp) {
+	qpdb_t *qpdb;
+
+	/* Keep the compiler happy. */
+	UNUSED(argc);
+	UNUSED(argv);
+	UNUSED(driverarg);
+
+	if (type == dns_dbtype_cache) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	qpdb = isc_mem_getx(mctx, sizeof(*qpdb), ISC_MEM_ZERO);
+
+	dns_name_init(&qpdb->common.origin, NULL);
+	qpdb->common.attributes = 0;
+	if (type == dns_dbtype_stub) {
+		qpdb->common.attributes |= DNS_DBATTR_STUB;
+	}
+	qpdb->common.methods = &zone_methods;
+	qpdb->common.rdclass = rdclass;
+	qpdb->common.mctx = NULL;
+	ISC_LIST_INIT(qpdb->common.update_listeners);
+	isc_mem_attach(mctx, &qpdb->common.mctx);
+	isc_rwlock_init(&qpdb->lock, 0, 0);
+	isc_refcount_init(&qpdb->references, 1);
+
+	isc_heap_create(mctx, resign_sooner, set_index, 0, &qpdb->heap);
+	dns_qp_create(mctx, &qpmethods, qpdb, &qpdb->tree);
+	dns_qp_create(mctx, &qpmethods, qpdb, &qpdb->nsec3);
+
+	dns_name_dupwithoffsets(origin, mctx, &qpdb->common.origin);
+
+	/*
+	 * The origin node is never deleted.  An apex node is also added
+	 * to the NSEC3 trie, so that NSEC3 searches find a partial match
+	 * when there is only a single NSEC3 record in the trie.
+	 */
+	qpdb->origin_node = add_node(qpdb, &qpdb->common.origin, false);
+	qpdb->nsec3_origin_node = add_node(qpdb, &qpdb->common.origin, true);
+
+	/*
+	 * Version Initialization.
+	 */
+	qpdb->current_serial = 1;
+	qpdb->least_serial = 1;
+	qpdb->next_serial = 2;
+	qpdb->current_version = allocate_version(mctx, 1, 1, false);
+	qpdb->current_version->qpdb = qpdb;
+	qpdb->future_version = NULL;
+	ISC_LIST_INIT(qpdb->open_versions);
+	/*
+	 * Keep the current version in the open list so that list operation
+	 * won't happen in normal lookup operations.
+	 */
+	PREPEND(qpdb->open_versions, qpdb->current_version, link);
+
+	qpdb->common.magic = DNS_DB_MAGIC;
+	qpdb->common.impmagic = QPDB_MAGIC;
+
+	*dbp = (dns_db_t *)qpdb;
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Slabbed Rdataset Methods
+ */
+
+static void
+rdataset_settrust(dns_rdataset_t *rdataset, dns_trust_t trust) {
+	qpdb_t *qpdb = rdataset->private1;
+	qpdb_header_t *header = rdataset->private3;
+
+	header--;
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+	header->trust = rdataset->trust = trust;
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
+}
+
+/*
+ * Rdataset Iterator Methods
+ */
+
+static void
+rdatasetiter_destroy(dns_rdatasetiter_t **iteratorp) {
+	qpdb_rdatasetiter_t *qpiterator;
+
+	qpiterator = (qpdb_rdatasetiter_t *)(*iteratorp);
+
+	closeversion(qpiterator->common.db, &qpiterator->common.version,
+		     false);
+	detachnode(qpiterator->common.db, &qpiterator->common.node);
+	isc_mem_put(qpiterator->common.db->mctx, qpiterator,
+		    sizeof(*qpiterator));
+
+	*iteratorp = NULL;
+}
+
+static isc_result_t
+rdatasetiter_first(dns_rdatasetiter_t *iterator) {
+	qpdb_rdatasetiter_t *qpiterator = (qpdb_rdatasetiter_t *)iterator;
+	qpdb_t *qpdb = (qpdb_t *)(qpiterator->common.db);
+	qpdb_node_t *node = qpiterator->common.node;
+	qpdb_version_t *version = qpiterator->common.version;
+	qpdb_header_t *header, *top_next;
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	for (header = node->data; header != NULL; header = top_next) {
+		top_next = header->next;
+		header = active_header(header, version->serial);
+		if (header != NULL) {
+			break;
+		}
+	}
+
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	qpiterator->current = header;
+
+	if (header == NULL) {
+		return (ISC_R_NOMORE);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+rdatasetiter_next(dns_rdatasetiter_t *iterator) {
+	qpdb_rdatasetiter_t *qpiterator = (qpdb_rdatasetiter_t *)iterator;
+	qpdb_t *qpdb = (qpdb_t *)(qpiterator->common.db);
+	qpdb_version_t *version = qpiterator->common.version;
+	qpdb_header_t *header, *top_next;
+	qpdb_rdatatype_t type;
+
+	header = qpiterator->current;
+	if (header == NULL) {
+		return (ISC_R_NOMORE);
+	}
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	/*
+	 * Find the start of the header chain for the next type
+	 * by walking back up the list.
+	 */
+	type = header->type;
+	top_next = header->next;
+	while (top_next != NULL && top_next->type == type) {
+		top_next = top_next->next;
+	}
+	for (header = top_next; header != NULL; header = top_next) {
+		top_next = header->next;
+		header = active_header(header, version->serial);
+		if (header != NULL) {
+			break;
+		}
+	}
+
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	qpiterator->current = header;
+
+	if (header == NULL) {
+		return (ISC_R_NOMORE);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+rdatasetiter_current(dns_rdatasetiter_t *iterator, dns_rdataset_t *rdataset) {
+	qpdb_rdatasetiter_t *qpiterator = (qpdb_rdatasetiter_t *)iterator;
+	qpdb_t *qpdb = (qpdb_t *)(qpiterator->common.db);
+	qpdb_node_t *node = qpiterator->common.node;
+	qpdb_header_t *header;
+
+	header = qpiterator->current;
+	REQUIRE(header != NULL);
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	bind_rdataset(qpdb, node, header, rdataset);
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+}
+
+/*
+ * Database Iterator Methods
+ */
+
+/*
+ * Make 'pval' the current node of the iterator if 'result' is
+ * ISC_R_SUCCESS, and return the node that was current before, which the
+ * caller must detach once it has dropped the database lock.
+ *
+ * Caller must be holding the database lock.
+ */
+static qpdb_node_t *
+reposition(qpdb_dbiterator_t *qpdbiter, isc_result_t result, void *pval) {
+	qpdb_t *qpdb = (qpdb_t *)qpdbiter->common.db;
+	qpdb_node_t *old = qpdbiter->node;
+
+	qpdbiter->node = NULL;
+	if (result == ISC_R_SUCCESS || result == DNS_R_PARTIALMATCH) {
+		qpdbiter->node = pval;
+		new_reference(qpdb, qpdbiter->node);
+	}
+
+	return (old);
+}
+
+static void
+dereference_iter_node(qpdb_dbiterator_t *qpdbiter, qpdb_node_t *node) {
+	dns_dbnode_t *dbnode = node;
+
+	if (dbnode != NULL) {
+		detachnode(qpdbiter->common.db, &dbnode);
+	}
+}
+
+static void
+dbiterator_destroy(dns_dbiterator_t **iteratorp) {
+	qpdb_dbiterator_t *qpdbiter = (qpdb_dbiterator_t *)(*iteratorp);
+	dns_db_t *db = NULL;
+
+	dereference_iter_node(qpdbiter, qpdbiter->node);
+	qpdbiter->node = NULL;
+
+	dns_db_attach(qpdbiter->common.db, &db);
+	dns_db_detach(&qpdbiter->common.db);
+
+	isc_mem_put(db->mctx, qpdbiter, sizeof(*qpdbiter));
+	dns_db_detach(&db);
+
+	*iteratorp = NULL;
+}
+
+static isc_result_t
+dbiterator_first(dns_dbiterator_t *iterator) {
+	qpdb_dbiterator_t *qpdbiter = (qpdb_dbiterator_t *)iterator;
+	qpdb_t *qpdb = (qpdb_t *)iterator->db;
+	qpdb_node_t *old = NULL;
+	isc_result_t result;
+	void *pval = NULL;
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	if (qpdbiter->nsec3only) {
+		result = dns_qp_getfirst(qpdb->nsec3, &pval, NULL);
+	} else {
+		result = dns_qp_getfirst(qpdb->tree, &pval, NULL);
+		if (!qpdbiter->nonsec3 && result == ISC_R_NOTFOUND) {
+			result = dns_qp_getfirst(qpdb->nsec3, &pval, NULL);
+		}
+	}
+	old = reposition(qpdbiter, result, pval);
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	dereference_iter_node(qpdbiter, old);
+
+	if (result == ISC_R_NOTFOUND) {
+		result = ISC_R_NOMORE; /* The tree is empty. */
+	}
+	qpdbiter->result = result;
+	qpdbiter->origin = NULL;
+
+	return (result);
+}
+
+static isc_result_t
+dbiterator_last(dns_dbiterator_t *iterator) {
+	qpdb_dbiterator_t *qpdbiter = (qpdb_dbiterator_t *)iterator;
+	qpdb_t *qpdb = (qpdb_t *)iterator->db;
+	qpdb_node_t *old = NULL;
+	isc_result_t result = ISC_R_NOTFOUND;
+	void *pval = NULL;
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	if (qpdbiter->nsec3only && !qpdbiter->nonsec3) {
+		result = dns_qp_getlast(qpdb->nsec3, &pval, NULL);
+	}
+	if (!qpdbiter->nsec3only && result == ISC_R_NOTFOUND) {
+		result = dns_qp_getlast(qpdb->tree, &pval, NULL);
+	}
+	old = reposition(qpdbiter, result, pval);
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	dereference_iter_node(qpdbiter, old);
+
+	if (result == ISC_R_NOTFOUND) {
+		result = ISC_R_NOMORE; /* The tree is empty. */
+	}
+	qpdbiter->result = result;
+	qpdbiter->origin = NULL;
+
+	return (result);
+}
+
+/*
+ * Find 'name' in 'tree', or failing that the name before it if one of
+ * its ancestors is in the tree.
+ */
+static isc_result_t
+seek_tree(dns_qp_t *tree, const dns_name_t *name, void **pvalp) {
+	isc_result_t result;
+
+	result = dns_qp_findname_ancestor(tree, name, pvalp, NULL);
+	if (result == DNS_R_PARTIALMATCH) {
+		RUNTIME_CHECK(dns_qp_getname_prev(tree, name, pvalp, NULL) ==
+			      ISC_R_SUCCESS);
+	}
+
+	return (result);
+}
+
+static isc_result_t
+dbiterator_seek(dns_dbiterator_t *iterator, const dns_name_t *name) {
+	qpdb_dbiterator_t *qpdbiter = (qpdb_dbiterator_t *)iterator;
+	qpdb_t *qpdb = (qpdb_t *)iterator->db;
+	qpdb_node_t *old = NULL;
+	isc_result_t result;
+	void *pval = NULL;
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	if (qpdbiter->nsec3only) {
+		result = seek_tree(qpdb->nsec3, name, &pval);
+	} else if (qpdbiter->nonsec3) {
+		result = seek_tree(qpdb->tree, name, &pval);
+	} else {
+		/*
+		 * Stay on main chain if not found on either chain.
+		 */
+		result = seek_tree(qpdb->tree, name, &pval);
+		if (result == DNS_R_PARTIALMATCH) {
+			void *nsec3pval = NULL;
+
+			if (dns_qp_getname(qpdb->nsec3, name, &nsec3pval,
+					   NULL) == ISC_R_SUCCESS)
+			{
+				pval = nsec3pval;
+				result = ISC_R_SUCCESS;
+			}
+		}
+	}
+	old = reposition(qpdbiter, result, pval);
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	dereference_iter_node(qpdbiter, old);
+
+	qpdbiter->result = (result == DNS_R_PARTIALMATCH) ? ISC_R_SUCCESS
+							  : result;
+	qpdbiter->origin = NULL;
+
+	return (result);
+}
+
+static isc_result_t
+dbiterator_prev(dns_dbiterator_t *iterator) {
+	qpdb_dbiterator_t *qpdbiter = (qpdb_dbiterator_t *)iterator;
+	qpdb_t *qpdb = (qpdb_t *)iterator->db;
+	qpdb_node_t *node = qpdbiter->node, *old = NULL;
+	isc_result_t result;
+	void *pval = NULL;
+
+	REQUIRE(qpdbiter->node != NULL);
+
+	if (qpdbiter->result != ISC_R_SUCCESS) {
+		return (qpdbiter->result);
+	}
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	result = dns_qp_getname_prev(node->nsec3 ? qpdb->nsec3 : qpdb->tree,
+				     &node->name, &pval, NULL);
+	if (result == ISC_R_NOTFOUND && !qpdbiter->nsec3only &&
+	    !qpdbiter->nonsec3 && node->nsec3)
+	{
+		result = dns_qp_getlast(qpdb->tree, &pval, NULL);
+	}
+	old = reposition(qpdbiter, result, pval);
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	dereference_iter_node(qpdbiter, old);
+
+	if (result == ISC_R_NOTFOUND) {
+		result = ISC_R_NOMORE;
+	}
+	qpdbiter->result = result;
+
+	return (result);
+}
+
+static isc_result_t
+dbiterator_next(dns_dbiterator_t *iterator) {
+	qpdb_dbiterator_t *qpdbiter = (qpdb_dbiterator_t *)iterator;
+	qpdb_t *qpdb = (qpdb_t *)iterator->db;
+	qpdb_node_t *node = qpdbiter->node, *old = NULL;
+	isc_result_t result;
+	void *pval = NULL;
+
+	REQUIRE(qpdbiter->node != NULL);
+
+	if (qpdbiter->result != ISC_R_SUCCESS) {
+		return (qpdbiter->result);
+	}
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	result = dns_qp_getname_next(node->nsec3 ? qpdb->nsec3 : qpdb->tree,
+				     &node->name, &pval, NULL);
+	if (result == ISC_R_NOTFOUND && !qpdbiter->nsec3only &&
+	    !qpdbiter->nonsec3 && !node->nsec3)
+	{
+		result = dns_qp_getfirst(qpdb->nsec3, &pval, NULL);
+	}
+	old = reposition(qpdbiter, result, pval);
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	dereference_iter_node(qpdbiter, old);
+
+	if (result == ISC_R_NOTFOUND) {
+		result = ISC_R_NOMORE;
+	}
+	qpdbiter->result = result;
+
+	return (result);
+}
+
+/*
+ * The names of the nodes beneath the zone's origin are relative to it,
+ * the others to the root.
+ */
+static const dns_name_t *
+iterator_origin(qpdb_dbiterator_t *qpdbiter, qpdb_node_t *node) {
+	const dns_name_t *origin = &qpdbiter->common.db->origin;
+
+	if (dns_name_issubdomain(&node->name, origin) &&
+	    !dns_name_equal(&node->name, origin))
+	{
+		return (origin);
+	}
+
+	return (dns_rootname);
+}
+
+static isc_result_t
+dbiterator_current(dns_dbiterator_t *iterator, dns_dbnode_t **nodep,
+		   dns_name_t *name) {
+	qpdb_dbiterator_t *qpdbiter = (qpdb_dbiterator_t *)iterator;
+	qpdb_node_t *node = qpdbiter->node;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	REQUIRE(qpdbiter->result == ISC_R_SUCCESS);
+	REQUIRE(qpdbiter->node != NULL);
+
+	if (name != NULL) {
+		const dns_name_t *origin = iterator_origin(qpdbiter, node);
+
+		if (qpdbiter->common.relative_names && origin != dns_rootname)
+		{
+			dns_name_t prefix;
+
+			dns_name_init(&prefix, NULL);
+			dns_name_split(&node->name,
+				       dns_name_countlabels(origin), &prefix,
+				       NULL);
+			dns_name_copy(&prefix, name);
+		} else {
+			dns_name_copy(&node->name, name);
+		}
+		if (qpdbiter->common.relative_names &&
+		    origin != qpdbiter->origin)
+		{
+			result = DNS_R_NEWORIGIN;
+		}
+		qpdbiter->origin = origin;
+	}
+
+	isc_refcount_increment(&node->references);
+
+	*nodep = qpdbiter->node;
+
+	return (result);
+}
+
+static isc_result_t
+dbiterator_pause(dns_dbiterator_t *iterator) {
+	qpdb_dbiterator_t *qpdbiter = (qpdb_dbiterator_t *)iterator;
+
+	/*
+	 * The iterator doesn't hold the database lock between calls.
+	 */
+	if (qpdbiter->result != ISC_R_SUCCESS &&
+	    qpdbiter->result != ISC_R_NOTFOUND &&
+	    qpdbiter->result != ISC_R_NOMORE)
+	{
+		return (qpdbiter->result);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+dbiterator_origin(dns_dbiterator_t *iterator, dns_name_t *name) {
+	qpdb_dbiterator_t *qpdbiter = (qpdb_dbiterator_t *)iterator;
+
+	if (qpdbiter->result != ISC_R_SUCCESS) {
+		return (qpdbiter->result);
+	}
+
+	dns_name_copy(iterator_origin(qpdbiter, qpdbiter->node), name);
+	return (ISC_R_SUCCESS);
+}
@@ -19,7 +19,6 @@
 #include <stdbool.h>
 #include <sys/stat.h>
 
-#include <isc/crc64.h>
 #include <isc/file.h>
 #include <isc/hash.h>
 #include <isc/hex.h>
@@ -27,6 +26,7 @@
 #include <isc/once.h>
 #include <isc/print.h>
 #include <isc/refcount.h>
+#include <isc/siphash.h>
 #include <isc/stdio.h>
 #include <isc/string.h>
 #include <isc/util.h>
@@ -63,6 +63,8 @@
 
 #define RBT_HASH_NEXTTABLE(hindex) ((hindex == 0) ? 1 : 0)
 
+#define RBT_HASHKEY_SIZE 16
+
 struct dns_rbt {
 	unsigned int magic;
 	isc_mem_t *mctx;
@@ -74,8 +76,48 @@ struct dns_rbt {
 	dns_rbtnode_t **hashtable[2];
 	uint8_t hindex;
 	uint32_t hiter;
+	uint8_t shard;
+	uint8_t hashkey[RBT_HASHKEY_SIZE];
+	unsigned char *mapbase;
+	size_t mapsize;
 };
 
+/*%
+ * Nodes and hash tables that live in the file mapping of a tree loaded by
+ * dns_rbt_deserialize_tree() are not to be freed.
+ */
+#define MAPPED(rbt, p)                                       \
+	((rbt)->mapbase != NULL &&                           \
+	 (unsigned char *)(p) >= (rbt)->mapbase &&           \
+	 (unsigned char *)(p) < (rbt)->mapbase + (rbt)->mapsize)
+
+/*%
+ * The header of a serialized tree.  Pointers are addresses in the
+ * mapping the tree was written for.
+ */
+typedef struct rbt_file_header {
+	uintptr_t root;
+	uintptr_t hashtable;
+	uint32_t nodecount;
+	uint8_t hashbits;
+	uint8_t hashkey[RBT_HASHKEY_SIZE];
+} rbt_file_header_t;
+
+/*%
+ * Serialization context.
+ */
+typedef struct {
+	FILE *file;
+	uintptr_t base;
+	dns_rbtdatawriter_t datawriter;
+	void *writer_arg;
+	uint8_t hashbits;
+	uintptr_t *hashtable;
+	unsigned int nodecount;
+	unsigned char
+		image[sizeof(dns_rbtnode_t) + 2 * DNS_NAME_MAXWIRE + 1];
+} rbt_serialize_t;
+
 #define IS_EMPTY(node) ((node)->data == NULL)
 
 #define WANTEMPTYDATA_OR_DATA(options, node) \
@@ -181,7 +223,7 @@ dns__rbtnode_getdistance(dns_rbtnode_t *node) {
  * Forward declarations.
  */
 static isc_result_t
-create_node(isc_mem_t *mctx, const dns_name_t *name, dns_rbtnode_t **nodep);
+create_node(dns_rbt_t *rbt, const dns_name_t *name, dns_rbtnode_t **nodep);
 
 static void
 hashtable_new(dns_rbt_t *rbt, uint8_t index, uint8_t bits);
@@ -257,6 +299,26 @@ dns__rbtnode_namelen(dns_rbtnode_t *node) {
 /*
  * Initialize a red/black tree of trees.
  */
+/*
+ * Hash a name the way dns_name_fullhash() does, but with the tree's own
+ * key.  A tree starts out with the process's hash key; a tree loaded from
+ * a map file keeps the key it was written with, so that the hash values
+ * in the mapped nodes and hash table remain valid.
+ */
+static uint32_t
+name_hash(dns_rbt_t *rbt, const dns_name_t *name) {
+	uint32_t hval;
+
+	if (name->labels == 0) {
+		return (0);
+	}
+
+	isc_halfsiphash24(rbt->hashkey, name->ndata, name->length, false,
+			  (uint8_t *)&hval);
+
+	return (hval);
+}
+
 isc_result_t
 dns_rbt_create(isc_mem_t *mctx, dns_rbtdeleter_t deleter, void *deleter_arg,
 	       dns_rbt_t **rbtp) {
@@ -273,6 +335,8 @@ dns_rbt_create(isc_mem_t *mctx, dns_rbtdeleter_t deleter, void *deleter_arg,
 	};
 
 	isc_mem_attach(mctx, &rbt->mctx);
+	memmove(rbt->hashkey, isc_hash_get_initializer(),
+		sizeof(rbt->hashkey));
 
 	hashtable_new(rbt, 0, ISC_HASH_MIN_BITS);
 
@@ -339,6 +403,320 @@ dns_rbt_hashsize(dns_rbt_t *rbt) {
 	return (1 << hashbits);
 }
 
+void
+dns_rbt_setshard(dns_rbt_t *rbt, uint8_t shard) {
+	REQUIRE(VALID_RBT(rbt));
+	REQUIRE(rbt->root == NULL);
+
+	rbt->shard = shard;
+}
+
+/*
+ * Pad 'file' with zeroes to the next 8 byte boundary, so that the next
+ * object written is suitably aligned when the file is mapped.
+ */
+static isc_result_t
+write_padding(FILE *file, off_t *offsetp) {
+	static const unsigned char zeroes[8] = { 0 };
+	isc_result_t result;
+	off_t offset;
+	size_t pad;
+
+	result = isc_stdio_tell(file, &offset);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	pad = (8 - (offset % 8)) % 8;
+	if (pad != 0) {
+		result = isc_stdio_write(zeroes, 1, pad, file, NULL);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+
+	if (offsetp != NULL) {
+		*offsetp = offset + pad;
+	}
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Write 'node' and everything below it, returning the address the node
+ * will have in '*addrp'.  The node is written twice: first as a
+ * placeholder, and then, once the addresses of its children and its data
+ * are known, as the final image.  'parent' and 'upper' are the addresses
+ * of the node's parent and of the node owning its level.
+ */
+static isc_result_t
+serialize_node(rbt_serialize_t *rs, dns_rbtnode_t *node, uintptr_t parent,
+	       dns_rbtnode_t *uppernode, uintptr_t upper, uintptr_t *addrp) {
+	isc_result_t result;
+	dns_rbtnode_t *image = (dns_rbtnode_t *)rs->image;
+	size_t size = NODE_SIZE(node);
+	uintptr_t addr, left = 0, right = 0, down = 0, data = 0;
+	uint32_t hash;
+	off_t offset, end;
+
+	REQUIRE(DNS_RBTNODE_VALID(node));
+	INSIST(node->uppernode == uppernode);
+	INSIST(size <= sizeof(rs->image));
+
+	CHECK(write_padding(rs->file, &offset));
+	addr = rs->base + (uintptr_t)offset;
+	CHECK(isc_stdio_write(node, 1, size, rs->file, NULL));
+
+	if (node->left != NULL) {
+		CHECK(serialize_node(rs, node->left, addr, uppernode, upper,
+				     &left));
+	}
+	if (node->right != NULL) {
+		CHECK(serialize_node(rs, node->right, addr, uppernode, upper,
+				     &right));
+	}
+	if (node->down != NULL) {
+		CHECK(serialize_node(rs, node->down, addr, node, addr, &down));
+	}
+	if (node->data != NULL) {
+		CHECK(write_padding(rs->file, NULL));
+		CHECK(rs->datawriter(rs->file, node, addr, rs->writer_arg,
+				     &data));
+	}
+	CHECK(write_padding(rs->file, &end));
+
+	memmove(image, node, size);
+	image->parent = (dns_rbtnode_t *)parent;
+	image->left = (dns_rbtnode_t *)left;
+	image->right = (dns_rbtnode_t *)right;
+	image->down = (dns_rbtnode_t *)down;
+	image->uppernode = (dns_rbtnode_t *)upper;
+	image->data = (void *)data;
+	image->dirty = 0;
+	ISC_LINK_INIT(image, deadlink);
+	isc_refcount_init(&image->references, 0);
+
+	hash = isc_hash_bits32(node->hashval, rs->hashbits);
+	image->hashnext = (dns_rbtnode_t *)rs->hashtable[hash];
+	rs->hashtable[hash] = addr;
+
+	CHECK(isc_stdio_seek(rs->file, offset, SEEK_SET));
+	CHECK(isc_stdio_write(image, 1, size, rs->file, NULL));
+	CHECK(isc_stdio_seek(rs->file, end, SEEK_SET));
+
+	rs->nodecount++;
+	*addrp = addr;
+
+cleanup:
+	return (result);
+}
+
+isc_result_t
+dns_rbt_serialize_tree(FILE *file, dns_rbt_t *rbt, uintptr_t base,
+		       dns_rbtdatawriter_t datawriter, void *writer_arg,
+		       off_t *offset) {
+	isc_result_t result;
+	rbt_serialize_t rs = {
+		.file = file,
+		.base = base,
+		.datawriter = datawriter,
+		.writer_arg = writer_arg,
+	};
+	rbt_file_header_t header = { 0 };
+	size_t size;
+	off_t where;
+
+	REQUIRE(file != NULL);
+	REQUIRE(VALID_RBT(rbt));
+	REQUIRE(datawriter != NULL);
+	REQUIRE(offset != NULL);
+
+	/*
+	 * The image gets a hash table of the size the tree's table is
+	 * growing to, which it is built into as the nodes are written.
+	 */
+	rs.hashbits = rbt->hashbits[rbt->hindex];
+	size = ISC_HASHSIZE(rs.hashbits) * sizeof(rs.hashtable[0]);
+	rs.hashtable = isc_mem_getx(rbt->mctx, size, ISC_MEM_ZERO);
+
+	if (rbt->root != NULL) {
+		CHECK(serialize_node(&rs, rbt->root, 0, NULL, 0,
+				     &header.root));
+	}
+	INSIST(rs.nodecount == rbt->nodecount);
+
+	CHECK(write_padding(file, &where));
+	header.hashtable = base + (uintptr_t)where;
+	CHECK(isc_stdio_write(rs.hashtable, 1, size, file, NULL));
+
+	header.nodecount = rs.nodecount;
+	header.hashbits = rs.hashbits;
+	memmove(header.hashkey, rbt->hashkey, sizeof(header.hashkey));
+	CHECK(write_padding(file, offset));
+	CHECK(isc_stdio_write(&header, 1, sizeof(header), file, NULL));
+	CHECK(write_padding(file, NULL));
+
+cleanup:
+	isc_mem_put(rbt->mctx, rs.hashtable, size);
+	return (result);
+}
+
+#define RELOCATE(p)                                                     \
+	do {                                                            \
+		if ((p) != NULL) {                                      \
+			(p) = (void *)((uintptr_t)(p) + delta);         \
+			if (!MAPPED(rbt, p)) {                          \
+				return (ISC_R_INVALIDFILE);             \
+			}                                               \
+		}                                                       \
+	} while (0)
+
+/*
+ * The file could not be mapped at the address it was written for:
+ * adjust every pointer in the image by 'delta'.  This touches every page
+ * of the tree.
+ */
+static isc_result_t
+relocate_node(dns_rbt_t *rbt, dns_rbtnode_t *node, intptr_t delta,
+	      dns_rbtdatafixer_t datafixer, void *fixer_arg) {
+	isc_result_t result;
+
+	if (!DNS_RBTNODE_VALID(node)) {
+		return (ISC_R_INVALIDFILE);
+	}
+
+	RELOCATE(node->parent);
+	RELOCATE(node->left);
+	RELOCATE(node->right);
+	RELOCATE(node->down);
+	RELOCATE(node->uppernode);
+	RELOCATE(node->hashnext);
+	RELOCATE(node->data);
+
+	if (node->data != NULL && datafixer != NULL) {
+		result = (datafixer)(node, delta, fixer_arg);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+
+	if (node->left != NULL) {
+		result = relocate_node(rbt, node->left, delta, datafixer,
+				       fixer_arg);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+	if (node->right != NULL) {
+		result = relocate_node(rbt, node->right, delta, datafixer,
+				       fixer_arg);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+	if (node->down != NULL) {
+		result = relocate_node(rbt, node->down, delta, datafixer,
+				       fixer_arg);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+relocate_hashtable(dns_rbt_t *rbt, intptr_t delta) {
+	dns_rbtnode_t **table = rbt->hashtable[0];
+
+	for (size_t i = 0; i < ISC_HASHSIZE(rbt->hashbits[0]); i++) {
+		RELOCATE(table[i]);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+#undef RELOCATE
+
+isc_result_t
+dns_rbt_deserialize_tree(void *map, size_t mapsize, off_t offset,
+			 intptr_t delta, isc_mem_t *mctx,
+			 dns_rbtdeleter_t deleter, void *deleter_arg,
+			 dns_rbtdatafixer_t datafixer, void *fixer_arg,
+			 dns_rbt_t **rbtp) {
+	isc_result_t result;
+	rbt_file_header_t *header = NULL;
+	dns_rbt_t *rbt = NULL;
+	size_t size;
+
+	REQUIRE(map != NULL);
+	REQUIRE(mctx != NULL);
+	REQUIRE(rbtp != NULL && *rbtp == NULL);
+	REQUIRE(deleter == NULL ? deleter_arg == NULL : 1);
+
+	if (offset < 0 || offset % 8 != 0 ||
+	    (size_t)offset + sizeof(*header) > mapsize)
+	{
+		return (ISC_R_INVALIDFILE);
+	}
+	header = (rbt_file_header_t *)((unsigned char *)map + offset);
+
+	if (header->hashbits < ISC_HASH_MIN_BITS ||
+	    header->hashbits >= ISC_HASH_MAX_BITS)
+	{
+		return (ISC_R_INVALIDFILE);
+	}
+
+	rbt = isc_mem_get(mctx, sizeof(*rbt));
+	*rbt = (dns_rbt_t){
+		.data_deleter = deleter,
+		.deleter_arg = deleter_arg,
+		.mapbase = map,
+		.mapsize = mapsize,
+		.root = (dns_rbtnode_t *)(header->root + delta),
+		.nodecount = header->nodecount,
+		.hashbits[0] = header->hashbits,
+		.hashtable[0] = (dns_rbtnode_t **)(header->hashtable + delta),
+	};
+	isc_mem_attach(mctx, &rbt->mctx);
+	memmove(rbt->hashkey, header->hashkey, sizeof(rbt->hashkey));
+	rbt->magic = RBT_MAGIC;
+
+	size = ISC_HASHSIZE(rbt->hashbits[0]) * sizeof(dns_rbtnode_t *);
+	if (!MAPPED(rbt, rbt->hashtable[0]) ||
+	    !MAPPED(rbt, (unsigned char *)rbt->hashtable[0] + size - 1) ||
+	    (header->root != 0 && !MAPPED(rbt, rbt->root)))
+	{
+		CHECK(ISC_R_INVALIDFILE);
+	}
+	if (header->root == 0) {
+		rbt->root = NULL;
+	}
+
+	if (delta != 0) {
+		CHECK(relocate_hashtable(rbt, delta));
+		if (rbt->root != NULL) {
+			CHECK(relocate_node(rbt, rbt->root, delta, datafixer,
+					    fixer_arg));
+		}
+	}
+
+	*rbtp = rbt;
+	return (ISC_R_SUCCESS);
+
+cleanup:
+	/*
+	 * Nothing in the mapping is freed, and the deleter must not be
+	 * called on data that may not have been relocated.
+	 */
+	rbt->root = NULL;
+	rbt->nodecount = 0;
+	rbt->hashtable[0] = NULL;
+	rbt->hashbits[0] = 0;
+	rbt->magic = 0;
+	isc_mem_putanddetach(&rbt->mctx, rbt, sizeof(*rbt));
+	return (result);
+}
+
 static isc_result_t
 chain_name(dns_rbtnodechain_t *chain, dns_name_t *name,
 	   bool include_chain_end) {
@@ -454,7 +832,7 @@ dns_rbt_addnode(dns_rbt_t *rbt, const dns_name_t *name, dns_rbtnode_t **nodep) {
 	dns_name_clone(name, add_name);
 
 	if (rbt->root == NULL) {
-		result = create_node(rbt->mctx, add_name, &new_current);
+		result = create_node(rbt, add_name, &new_current);
 		if (result == ISC_R_SUCCESS) {
 			rbt->nodecount++;
 			new_current->is_root = 1;
@@ -578,8 +956,7 @@ dns_rbt_addnode(dns_rbt_t *rbt, const dns_name_t *name, dns_rbtnode_t **nodep) {
 				 */
 				dns_name_split(&current_name, common_labels,
 					       prefix, suffix);
-				result = create_node(rbt->mctx, suffix,
-						     &new_current);
+				result = create_node(rbt, suffix, &new_current);
 
 				if (result != ISC_R_SUCCESS) {
 					break;
@@ -688,7 +1065,7 @@ dns_rbt_addnode(dns_rbt_t *rbt, const dns_name_t *name, dns_rbtnode_t **nodep) {
 	} while (child != NULL);
 
 	if (result == ISC_R_SUCCESS) {
-		result = create_node(rbt->mctx, add_name, &new_current);
+		result = create_node(rbt, add_name, &new_current);
 	}
 
 	if (result == ISC_R_SUCCESS) {
@@ -874,7 +1251,7 @@ dns_rbt_findnode(dns_rbt_t *rbt, const dns_name_t *name, dns_name_t *foundname,
 			dns_name_getlabelsequence(name, nlabels - tlabels,
 						  hlabels + tlabels,
 						  &hash_name);
-			hashval = dns_name_fullhash(&hash_name, false);
+			hashval = name_hash(rbt, &hash_name);
 
 			dns_name_getlabelsequence(search_name,
 						  nlabels - tlabels, tlabels,
@@ -1491,7 +1868,7 @@ dns_rbt_formatnodename(dns_rbtnode_t *node, char *printname,
 }
 
 static isc_result_t
-create_node(isc_mem_t *mctx, const dns_name_t *name, dns_rbtnode_t **nodep) {
+create_node(dns_rbt_t *rbt, const dns_name_t *name, dns_rbtnode_t **nodep) {
 	dns_rbtnode_t *node;
 	isc_region_t region;
 	unsigned int labels;
@@ -1507,7 +1884,7 @@ create_node(isc_mem_t *mctx, const dns_name_t *name, dns_rbtnode_t **nodep) {
 	 * Allocate space for the node structure, the name, and the offsets.
 	 */
 	nodelen = sizeof(dns_rbtnode_t) + region.length + labels + 1;
-	node = isc_mem_getx(mctx, nodelen, ISC_MEM_ZERO);
+	node = isc_mem_getx(rbt->mctx, nodelen, ISC_MEM_ZERO);
 
 	node->is_root = 0;
 	node->parent = NULL;
@@ -1522,6 +1899,7 @@ create_node(isc_mem_t *mctx, const dns_name_t *name, dns_rbtnode_t **nodep) {
 	ISC_LINK_INIT(node, deadlink);
 
 	node->locknum = 0;
+	node->shard = rbt->shard;
 	node->wild = 0;
 	node->dirty = 0;
 	isc_refcount_init(&node->references, 0);
@@ -1568,7 +1946,7 @@ hash_add_node(dns_rbt_t *rbt, dns_rbtnode_t *node, const dns_name_t *name) {
 
 	REQUIRE(name != NULL);
 
-	node->hashval = dns_name_fullhash(name, false);
+	node->hashval = name_hash(rbt, name);
 
 	hash = isc_hash_bits32(node->hashval, rbt->hashbits[rbt->hindex]);
 	node->hashnext = rbt->hashtable[rbt->hindex][hash];
@@ -1598,7 +1976,9 @@ static void
 hashtable_free(dns_rbt_t *rbt, uint8_t index) {
 	size_t size = ISC_HASHSIZE(rbt->hashbits[index]) *
 		      sizeof(dns_rbtnode_t *);
-	isc_mem_put(rbt->mctx, rbt->hashtable[index], size);
+	if (!MAPPED(rbt, rbt->hashtable[index])) {
+		isc_mem_put(rbt->mctx, rbt->hashtable[index], size);
+	}
 
 	rbt->hashbits[index] = 0U;
 	rbt->hashtable[index] = NULL;
@@ -2181,7 +2561,9 @@ freenode(dns_rbt_t *rbt, dns_rbtnode_t **nodep) {
 	dns_rbtnode_t *node = *nodep;
 	*nodep = NULL;
 
-	isc_mem_put(rbt->mctx, node, NODE_SIZE(node));
+	if (!MAPPED(rbt, node)) {
+		isc_mem_put(rbt->mctx, node, NODE_SIZE(node));
+	}
 
 	rbt->nodecount--;
 }
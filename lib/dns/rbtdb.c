@@ -17,11 +17,14 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <isc/ascii.h>
 #include <isc/async.h>
 #include <isc/atomic.h>
 #include <isc/crc64.h>
+#include <isc/errno.h>
 #include <isc/file.h>
 #include <isc/hash.h>
 #include <isc/heap.h>
@@ -30,6 +33,7 @@
 #include <isc/mem.h>
 #include <isc/mutex.h>
 #include <isc/once.h>
+#include <isc/os.h>
 #include <isc/print.h>
 #include <isc/random.h>
 #include <isc/refcount.h>
@@ -37,9 +41,14 @@
 #include <isc/rwlock.h>
 #include <isc/serial.h>
 #include <isc/stdio.h>
+#include <isc/stdtime.h>
 #include <isc/string.h>
+#include <isc/thread.h>
+#include <isc/tid.h>
 #include <isc/time.h>
 #include <isc/util.h>
+#include <isc/wheel.h>
+#include <isc/work.h>
 
 #include <dns/callbacks.h>
 #include <dns/db.h>
@@ -62,6 +71,7 @@
 #include <dns/zonekey.h>
 
 #include "rbtdb.h"
+#include "rdataslab_p.h"
 
 #define RBTDB_MAGIC ISC_MAGIC('R', 'B', 'D', '4')
 
@@ -109,6 +119,226 @@ typedef uint32_t rbtdb_rdatatype_t;
 #define RBTDB_LOCK(l, t)     RWLOCK((l), (t))
 #define RBTDB_UNLOCK(l, t)   RWUNLOCK((l), (t))
 
+/*%
+ * The tree lock of a zone database is biased towards readers: while no
+ * writer is active, readers that use TREE_RDLOCK_BIASED() don't touch
+ * the shared rwlock, they count themselves in one of the lock's reader
+ * slots instead.  The slot is chosen by the thread ID, so readers on
+ * different threads write to different cache lines.  A writer takes
+ * the rwlock, revokes the bias and waits for the counted readers to
+ * leave, which only means looking at the lock's own TREE_READERS slots;
+ * the bias is then kept off for a little while, so that a burst of
+ * updates (or loading the zone) doesn't pay for a revocation every
+ * time, and is restored by the next reader.
+ *
+ * The slots are only allocated when the bias is first set, once the
+ * rwlock has been read-locked TREE_BIAS_READS times, so that the many
+ * zones that are rarely queried don't pay for them.  Readers that find
+ * the bias off fall back to the rwlock.  Cache databases are written
+ * too often to benefit, so their tree lock is never biased.
+ */
+typedef struct treereader {
+	atomic_uint_fast32_t count;
+	uint8_t __padding[ISC_OS_CACHELINE_SIZE -
+			  sizeof(atomic_uint_fast32_t)];
+} treereader_t;
+
+typedef struct treelock {
+	isc_rwlock_t lock;
+	isc_mem_t *mctx; /*%< NULL if the lock is never biased */
+	atomic_bool bias;
+	atomic_uint_fast32_t inhibit_until;
+	atomic_uint_fast32_t reads;
+	atomic_uintptr_t readers; /*%< treereader_t[TREE_READERS] */
+} treelock_t;
+
+#define TREE_READERS	16
+#define TREE_BIAS_READS 1024
+
+static void
+tree_initlock(treelock_t *tl, isc_mem_t *mctx) {
+	isc_rwlock_init(&tl->lock, 0, 0);
+	tl->mctx = NULL;
+	if (mctx != NULL) {
+		isc_mem_attach(mctx, &tl->mctx);
+	}
+	atomic_init(&tl->bias, false);
+	atomic_init(&tl->inhibit_until, 0);
+	atomic_init(&tl->reads, 0);
+	atomic_init(&tl->readers, 0);
+}
+
+static void
+tree_destroylock(treelock_t *tl) {
+	treereader_t *readers =
+		(treereader_t *)atomic_load_acquire(&tl->readers);
+
+	if (readers != NULL) {
+		isc_mem_put(tl->mctx, readers,
+			    TREE_READERS * sizeof(treereader_t));
+	}
+	if (tl->mctx != NULL) {
+		isc_mem_detach(&tl->mctx);
+	}
+	isc_rwlock_destroy(&tl->lock);
+}
+
+/*
+ * Revoke the bias after the rwlock has been write-locked.  If 'wait' is
+ * false, fail rather than wait for the biased readers to leave.
+ */
+static bool
+tree_revokebias(treelock_t *tl, bool wait) {
+	treereader_t *readers = NULL;
+	isc_stdtime_t now;
+
+	if (!atomic_load_acquire(&tl->bias)) {
+		return (true);
+	}
+
+	readers = (treereader_t *)atomic_load_acquire(&tl->readers);
+	atomic_store(&tl->bias, false);
+	for (size_t i = 0; i < TREE_READERS; i++) {
+		while (atomic_load(&readers[i].count) != 0) {
+			if (!wait) {
+				atomic_store_release(&tl->bias, true);
+				return (false);
+			}
+			isc_thread_yield();
+		}
+	}
+
+	isc_stdtime_get(&now);
+	atomic_store_relaxed(&tl->inhibit_until, now + 1);
+	atomic_store_relaxed(&tl->reads, 0);
+	return (true);
+}
+
+/*
+ * Called by readers that hold the rwlock: restore the bias once the
+ * inhibition period has passed and the lock is still being read.
+ */
+static void
+tree_restorebias(treelock_t *tl) {
+	isc_stdtime_t now;
+
+	if (tl->mctx == NULL || atomic_load_relaxed(&tl->bias)) {
+		return;
+	}
+
+	if (atomic_fetch_add_relaxed(&tl->reads, 1) < TREE_BIAS_READS) {
+		return;
+	}
+
+	isc_stdtime_get(&now);
+	if (now < atomic_load_relaxed(&tl->inhibit_until)) {
+		return;
+	}
+
+	if (atomic_load_acquire(&tl->readers) == 0) {
+		treereader_t *readers = NULL;
+		uintptr_t expected = 0;
+
+		readers = isc_mem_getx(tl->mctx,
+				       TREE_READERS * sizeof(treereader_t),
+				       ISC_MEM_ZERO);
+		if (!atomic_compare_exchange_strong_acq_rel(
+			    &tl->readers, &expected, (uintptr_t)readers))
+		{
+			isc_mem_put(tl->mctx, readers,
+				    TREE_READERS * sizeof(treereader_t));
+		}
+	}
+
+	atomic_store_release(&tl->bias, true);
+}
+
+static void
+tree_lock(treelock_t *tl, isc_rwlocktype_t type) {
+	isc_rwlock_lock(&tl->lock, type);
+	if (type == isc_rwlocktype_write) {
+		(void)tree_revokebias(tl, true);
+	} else {
+		tree_restorebias(tl);
+	}
+}
+
+static void
+tree_unlock(treelock_t *tl, isc_rwlocktype_t type) {
+	isc_rwlock_unlock(&tl->lock, type);
+}
+
+static isc_result_t
+tree_trylock(treelock_t *tl, isc_rwlocktype_t type) {
+	isc_result_t result = isc_rwlock_trylock(&tl->lock, type);
+
+	if (result == ISC_R_SUCCESS && type == isc_rwlocktype_write &&
+	    !tree_revokebias(tl, false))
+	{
+		isc_rwlock_unlock(&tl->lock, type);
+		result = ISC_R_LOCKBUSY;
+	}
+
+	return (result);
+}
+
+static isc_result_t
+tree_tryupgrade(treelock_t *tl) {
+	isc_result_t result;
+
+	/*
+	 * The caller may hold node locks that the biased readers are
+	 * waiting for, so don't wait for them.
+	 */
+	if (atomic_load(&tl->bias)) {
+		return (ISC_R_LOCKBUSY);
+	}
+
+	result = isc_rwlock_tryupgrade(&tl->lock);
+
+	/*
+	 * Another reader may have restored the bias before the upgrade,
+	 * letting biased readers in; revoke it, or go back to reading.
+	 */
+	if (result == ISC_R_SUCCESS && !tree_revokebias(tl, false)) {
+		isc_rwlock_downgrade(&tl->lock);
+		result = ISC_R_LOCKBUSY;
+	}
+
+	return (result);
+}
+
+/*
+ * Read-lock the tree, counting ourselves in a reader slot if the lock
+ * is biased.  Returns the slot, or NULL if the rwlock was locked.
+ */
+static treereader_t *
+tree_rdlock_biased(treelock_t *tl) {
+	if (atomic_load_acquire(&tl->bias)) {
+		treereader_t *readers =
+			(treereader_t *)atomic_load_acquire(&tl->readers);
+		treereader_t *slot = &readers[isc_tid() % TREE_READERS];
+
+		atomic_fetch_add(&slot->count, 1);
+		if (atomic_load(&tl->bias)) {
+			return (slot);
+		}
+		atomic_fetch_sub_release(&slot->count, 1);
+	}
+
+	tree_lock(tl, isc_rwlocktype_read);
+	return (NULL);
+}
+
+static void
+tree_rdunlock_biased(treelock_t *tl, treereader_t *slot) {
+	if (slot != NULL) {
+		atomic_fetch_sub_release(&slot->count, 1);
+	} else {
+		tree_unlock(tl, isc_rwlocktype_read);
+	}
+}
+
 typedef isc_rwlock_t nodelock_t;
 
 #ifdef DNS_RBTDB_STRONG_RWLOCK_CHECK
@@ -151,14 +381,12 @@ typedef isc_rwlock_t nodelock_t;
 		_result;                                         \
 	})
 
-typedef isc_rwlock_t treelock_t;
-
-#define TREE_INITLOCK(l)    isc_rwlock_init(l, 0, 0)
-#define TREE_DESTROYLOCK(l) isc_rwlock_destroy(l)
+#define TREE_INITLOCK(l, b) tree_initlock(l, b)
+#define TREE_DESTROYLOCK(l) tree_destroylock(l)
 #define TREE_LOCK(l, t, tp)                          \
 	{                                            \
 		REQUIRE(*tp == isc_rwlocktype_none); \
-		RWLOCK(l, t);                        \
+		tree_lock(l, t);                     \
 		*tp = t;                             \
 	}
 #define TREE_RDLOCK(l, tp) TREE_LOCK(l, isc_rwlocktype_read, tp);
@@ -166,28 +394,28 @@ typedef isc_rwlock_t treelock_t;
 #define TREE_UNLOCK(l, tp)                           \
 	{                                            \
 		REQUIRE(*tp != isc_rwlocktype_none); \
-		RWUNLOCK(l, *tp);                    \
+		tree_unlock(l, *tp);                 \
 		*tp = isc_rwlocktype_none;           \
 	}
-#define TREE_TRYLOCK(l, t, tp)                                   \
-	({                                                       \
-		REQUIRE(*tp == isc_rwlocktype_none);             \
-		isc_result_t _result = isc_rwlock_trylock(l, t); \
-		if (_result == ISC_R_SUCCESS) {                  \
-			*tp = t;                                 \
-		};                                               \
-		_result;                                         \
+#define TREE_TRYLOCK(l, t, tp)                             \
+	({                                                 \
+		REQUIRE(*tp == isc_rwlocktype_none);       \
+		isc_result_t _result = tree_trylock(l, t); \
+		if (_result == ISC_R_SUCCESS) {            \
+			*tp = t;                           \
+		};                                         \
+		_result;                                   \
 	})
 #define TREE_TRYRDLOCK(l, tp) TREE_TRYLOCK(l, isc_rwlocktype_read, tp)
 #define TREE_TRYWRLOCK(l, tp) TREE_TRYLOCK(l, isc_rwlocktype_write, tp)
-#define TREE_TRYUPGRADE(l, tp)                                   \
-	({                                                       \
-		REQUIRE(*tp == isc_rwlocktype_read);             \
-		isc_result_t _result = isc_rwlock_tryupgrade(l); \
-		if (_result == ISC_R_SUCCESS) {                  \
-			*tp = isc_rwlocktype_write;              \
-		};                                               \
-		_result;                                         \
+#define TREE_TRYUPGRADE(l, tp)                             \
+	({                                                 \
+		REQUIRE(*tp == isc_rwlocktype_read);       \
+		isc_result_t _result = tree_tryupgrade(l); \
+		if (_result == ISC_R_SUCCESS) {            \
+			*tp = isc_rwlocktype_write;        \
+		};                                         \
+		_result;                                   \
 	})
 
 #else /* DNS_RBTDB_STRONG_RWLOCK_CHECK */
@@ -226,14 +454,12 @@ typedef isc_rwlock_t treelock_t;
 		_result;                                         \
 	})
 
-typedef isc_rwlock_t treelock_t;
-
-#define TREE_INITLOCK(l)    isc_rwlock_init(l, 0, 0)
-#define TREE_DESTROYLOCK(l) isc_rwlock_destroy(l)
-#define TREE_LOCK(l, t, tp)   \
-	{                     \
-		RWLOCK(l, t); \
-		*tp = t;      \
+#define TREE_INITLOCK(l, b) tree_initlock(l, b)
+#define TREE_DESTROYLOCK(l) tree_destroylock(l)
+#define TREE_LOCK(l, t, tp)      \
+	{                        \
+		tree_lock(l, t); \
+		*tp = t;         \
 	}
 #define TREE_RDLOCK(l, tp)                             \
 	{                                              \
@@ -245,43 +471,75 @@ typedef isc_rwlock_t treelock_t;
 	}
 #define TREE_UNLOCK(l, tp)                 \
 	{                                  \
-		RWUNLOCK(l, *tp);          \
+		tree_unlock(l, *tp);       \
 		*tp = isc_rwlocktype_none; \
 	}
-#define TREE_TRYLOCK(l, t, tp)                                   \
-	({                                                       \
-		isc_result_t _result = isc_rwlock_trylock(l, t); \
-		if (_result == ISC_R_SUCCESS) {                  \
-			*tp = t;                                 \
-		};                                               \
-		_result;                                         \
+#define TREE_TRYLOCK(l, t, tp)                             \
+	({                                                 \
+		isc_result_t _result = tree_trylock(l, t); \
+		if (_result == ISC_R_SUCCESS) {            \
+			*tp = t;                           \
+		};                                         \
+		_result;                                   \
 	})
 #define TREE_TRYRDLOCK(l, tp) TREE_TRYLOCK(l, isc_rwlocktype_read, tp)
 #define TREE_TRYWRLOCK(l, tp) TREE_TRYLOCK(l, isc_rwlocktype_write, tp)
-#define TREE_TRYUPGRADE(l, tp)                                   \
-	({                                                       \
-		isc_result_t _result = isc_rwlock_tryupgrade(l); \
-		if (_result == ISC_R_SUCCESS) {                  \
-			*tp = isc_rwlocktype_write;              \
-		};                                               \
-		_result;                                         \
+#define TREE_TRYUPGRADE(l, tp)                             \
+	({                                                 \
+		isc_result_t _result = tree_tryupgrade(l); \
+		if (_result == ISC_R_SUCCESS) {            \
+			*tp = isc_rwlocktype_write;        \
+		};                                         \
+		_result;                                   \
 	})
 
 #endif
 
+/*
+ * Read-lock the tree using the reader bias; '*sp' records the reader
+ * slot that was used, and must be passed to TREE_UNLOCK_BIASED().  The
+ * lock must not be upgraded while '*sp' is not NULL.
+ */
+#define TREE_RDLOCK_BIASED(l, tp, sp)          \
+	{                                      \
+		*(sp) = tree_rdlock_biased(l); \
+		*(tp) = isc_rwlocktype_read;   \
+	}
+#define TREE_UNLOCK_BIASED(l, tp, sp)                   \
+	{                                               \
+		if (*(sp) != NULL) {                    \
+			tree_rdunlock_biased(l, *(sp)); \
+			*(sp) = NULL;                   \
+			*(tp) = isc_rwlocktype_none;    \
+		} else {                                \
+			TREE_UNLOCK(l, tp);             \
+		}                                       \
+	}
+
+/*%
+ * The most cache entries overmem_purge() inspects in each bucket while
+ * looking for entries to evict, so that the node lock isn't held for
+ * long when all the entries of the bucket have been used recently.
+ */
+#ifndef DNS_RBTDB_SIEVE_SCAN_MAX
+#define DNS_RBTDB_SIEVE_SCAN_MAX 64
+#endif
+
 /*%
- * Whether to rate-limit updating the LRU to avoid possible thread contention.
- * Updating LRU requires write locking, so we don't do it every time the
- * record is touched - only after some time passes.
+ * The most due cache entries addrdataset() looks at when there is no
+ * background cleaner to leave them to.
  */
-#ifndef DNS_RBTDB_LIMITLRUUPDATE
-#define DNS_RBTDB_LIMITLRUUPDATE 1
+#ifndef DNS_RBTDB_EXPIRE_MAX
+#define DNS_RBTDB_EXPIRE_MAX 8
 #endif
 
-/*% Time after which we update LRU for glue records, 5 minutes */
-#define DNS_RBTDB_LRUUPDATE_GLUE 300
-/*% Time after which we update LRU for all other records, 10 minutes */
-#define DNS_RBTDB_LRUUPDATE_REGULAR 600
+/*%
+ * How long one sweep of the background cache cleaner may run before it
+ * gives the worker thread back, in microseconds.
+ */
+#ifndef DNS_RBTDB_CLEANER_BUDGET
+#define DNS_RBTDB_CLEANER_BUDGET 10000
+#endif
 
 /*
  * Allow clients with a virtual time of up to 5 minutes in the past to see
@@ -336,12 +594,12 @@ typedef struct rdatasetheader {
 	 */
 
 	dns_rbtnode_t *node;
-	isc_stdtime_t last_used;
 	ISC_LINK(struct rdatasetheader) link;
 
 	unsigned int heap_index;
 	/*%<
-	 * Used for TTL-based cache cleaning.
+	 * Index in the TTL wheel of a cache, for TTL-based cache cleaning,
+	 * or in the resigning heap of a zone.
 	 */
 	isc_stdtime_t resign;
 	/*%<
@@ -372,6 +630,8 @@ typedef ISC_LIST(dns_rbtnode_t) rbtnodelist_t;
 /*%< Ancient - awaiting cleanup. */
 #define RDATASET_ATTR_ANCIENT	   0x2000
 #define RDATASET_ATTR_STALE_WINDOW 0x4000
+/*%< Used since the SIEVE hand last passed it (cache only). */
+#define RDATASET_ATTR_VISITED 0x8000
 
 /*
  * XXX
@@ -451,7 +711,7 @@ typedef ISC_LIST(dns_rbtnode_t) rbtnodelist_t;
 	(((rbtiterator)->common.options & DNS_DB_STALEOK) != 0)
 
 /*%
- * Number of buckets for cache DB entries (locks, LRU lists, TTL heaps).
+ * Number of buckets for cache DB entries (locks, LRU lists, TTL wheels).
  * There is a tradeoff issue about configuring this value: if this is too
  * small, it may cause heavier contention between threads; if this is too large,
  * LRU purge algorithm won't work well (entries tend to be purged prematurely).
@@ -590,11 +850,25 @@ struct dns_rbtdb {
 	uint32_t serve_stale_refresh;
 
 	/*
-	 * This is a linked list used to implement the LRU cache.  There will
-	 * be node_lock_count linked lists here.  Nodes in bucket 1 will be
-	 * placed on the linked list rdatasets[1].
+	 * These are the linked lists used to implement SIEVE eviction in
+	 * the cache.  There will be node_lock_count linked lists here.
+	 * Headers in bucket 1 will be placed on the linked list
+	 * rdatasets[1], newest first; sieve_hands[1] is the next header
+	 * in that list overmem_purge() will look at (NULL for the tail).
 	 */
 	rdatasetheaderlist_t *rdatasets;
+	rdatasetheader_t **sieve_hands;
+
+	/*
+	 * The background cleaner of a cache.  'cleaning' is set while a
+	 * sweep is queued or running on 'cleaner_loop'; a sweep starts at
+	 * bucket 'cleaner_bucket', and sets 'cleaner_more' if it has to
+	 * yield before it is done.
+	 */
+	atomic_bool cleaning;
+	isc_loop_t *cleaner_loop;
+	unsigned int cleaner_bucket;
+	bool cleaner_more;
 
 	/*%
 	 * Temporary storage for stale cache nodes and dynamically deleted
@@ -603,12 +877,13 @@ struct dns_rbtdb {
 	rbtnodelist_t *deadnodes;
 
 	/*
-	 * Heaps.  These are used for TTL based expiry in a cache,
-	 * or for zone resigning in a zone DB.  hmctx is the memory
-	 * context to use for the heap (which differs from the main
-	 * database memory context in the case of a cache).
+	 * Timing wheels for TTL based expiry in a cache, or heaps for
+	 * zone resigning in a zone DB.  hmctx is the memory context to
+	 * use for them (which differs from the main database memory
+	 * context in the case of a cache).
 	 */
 	isc_mem_t *hmctx;
+	isc_wheel_t **wheels;
 	isc_heap_t **heaps;
 
 	/* Locked by tree_lock. */
@@ -618,8 +893,24 @@ struct dns_rbtdb {
 
 	/* Unlocked */
 	unsigned int quantum;
+
+	/*
+	 * The file a zone was loaded from in the map format, in which the
+	 * loaded nodes and rdatasets live.
+	 */
+	void *mmap_base;
+	size_t mmap_size;
 };
 
+/*%
+ * Nodes and headers that live in the mapped file are not to be freed.
+ */
+#define MAPPED(rbtdb, p)                                           \
+	((rbtdb)->mmap_base != NULL &&                             \
+	 (unsigned char *)(p) >= (unsigned char *)(rbtdb)->mmap_base && \
+	 (unsigned char *)(p) < (unsigned char *)(rbtdb)->mmap_base +   \
+					(rbtdb)->mmap_size)
+
 #define RBTDB_ATTR_LOADED  0x01
 #define RBTDB_ATTR_LOADING 0x02
 
@@ -662,34 +953,30 @@ typedef struct {
 
 static void
 delete_callback(void *data, void *arg);
-static void
-rdataset_disassociate(dns_rdataset_t *rdataset);
-static isc_result_t
-rdataset_first(dns_rdataset_t *rdataset);
-static isc_result_t
-rdataset_next(dns_rdataset_t *rdataset);
-static void
-rdataset_current(dns_rdataset_t *rdataset, dns_rdata_t *rdata);
-static void
-rdataset_clone(dns_rdataset_t *source, dns_rdataset_t *target);
-static unsigned int
-rdataset_count(dns_rdataset_t *rdataset);
 static isc_result_t
 rdataset_getnoqname(dns_rdataset_t *rdataset, dns_name_t *name,
 		    dns_rdataset_t *neg, dns_rdataset_t *negsig);
 static isc_result_t
 rdataset_getclosest(dns_rdataset_t *rdataset, dns_name_t *name,
 		    dns_rdataset_t *neg, dns_rdataset_t *negsig);
-static bool
-need_headerupdate(rdatasetheader_t *header, isc_stdtime_t now);
 static void
-update_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header, isc_stdtime_t now);
+mark_header_visited(rdatasetheader_t *header);
+static void
+sieve_unlink(dns_rbtdb_t *rbtdb, unsigned int idx, rdatasetheader_t *header);
 static void
 expire_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header,
 	      isc_rwlocktype_t *tlocktypep, expire_t reason);
 static void
 overmem_purge(dns_rbtdb_t *rbtdb, unsigned int locknum_start, isc_stdtime_t now,
 	      isc_rwlocktype_t *tlocktypep);
+static unsigned int
+sieve_purge(dns_rbtdb_t *rbtdb, unsigned int locknum, unsigned int purgecount,
+	    isc_rwlocktype_t *tlocktypep);
+static unsigned int
+expire_ttl_headers(dns_rbtdb_t *rbtdb, unsigned int locknum, isc_stdtime_t now,
+		   unsigned int maxcount, isc_rwlocktype_t *tlocktypep);
+static void
+cleaner_start(dns_rbtdb_t *rbtdb);
 static void
 resign_insert(dns_rbtdb_t *rbtdb, int idx, rdatasetheader_t *newheader);
 static void
@@ -715,30 +1002,32 @@ free_gluetable(rbtdb_version_t *version);
 static isc_result_t
 nodefullname(dns_db_t *db, dns_dbnode_t *node, dns_name_t *name);
 
-static dns_rdatasetmethods_t rdataset_methods = { rdataset_disassociate,
-						  rdataset_first,
-						  rdataset_next,
-						  rdataset_current,
-						  rdataset_clone,
-						  rdataset_count,
-						  NULL, /* addnoqname */
-						  rdataset_getnoqname,
-						  NULL, /* addclosest */
-						  rdataset_getclosest,
-						  rdataset_settrust,
-						  rdataset_expire,
-						  rdataset_clearprefetch,
-						  rdataset_setownercase,
-						  rdataset_getownercase,
-						  rdataset_addglue };
+static dns_rdatasetmethods_t rdataset_methods = {
+	dns__rdataslab_disassociate,
+	dns__rdataslab_first,
+	dns__rdataslab_next,
+	dns__rdataslab_current,
+	dns__rdataslab_clone,
+	dns__rdataslab_count,
+	NULL, /* addnoqname */
+	rdataset_getnoqname,
+	NULL, /* addclosest */
+	rdataset_getclosest,
+	rdataset_settrust,
+	rdataset_expire,
+	rdataset_clearprefetch,
+	rdataset_setownercase,
+	rdataset_getownercase,
+	rdataset_addglue
+};
 
 static dns_rdatasetmethods_t slab_methods = {
-	rdataset_disassociate,
-	rdataset_first,
-	rdataset_next,
-	rdataset_current,
-	rdataset_clone,
-	rdataset_count,
+	dns__rdataslab_disassociate,
+	dns__rdataslab_first,
+	dns__rdataslab_next,
+	dns__rdataslab_current,
+	dns__rdataslab_clone,
+	dns__rdataslab_count,
 	NULL, /* addnoqname */
 	NULL, /* getnoqname */
 	NULL, /* addclosest */
@@ -986,8 +1275,6 @@ update_rrsetstats(dns_rbtdb_t *rbtdb, const rbtdb_rdatatype_t htype,
 
 static void
 set_ttl(dns_rbtdb_t *rbtdb, rdatasetheader_t *header, dns_ttl_t newttl) {
-	int idx;
-	isc_heap_t *heap;
 	dns_ttl_t oldttl;
 
 	if (!IS_CACHE(rbtdb)) {
@@ -999,36 +1286,24 @@ set_ttl(dns_rbtdb_t *rbtdb, rdatasetheader_t *header, dns_ttl_t newttl) {
 	header->rdh_ttl = newttl;
 
 	/*
-	 * It's possible the rbtdb is not a cache.  If this is the case,
-	 * we will not have a heap, and we move on.  If we do, though,
-	 * we might need to adjust things.
+	 * If the header is in the TTL wheel, move it to the slot for
+	 * its new expiry time.
 	 */
 	if (header->heap_index == 0 || newttl == oldttl) {
 		return;
 	}
-	idx = header->node->locknum;
-	if (rbtdb->heaps == NULL || rbtdb->heaps[idx] == NULL) {
-		return;
-	}
-	heap = rbtdb->heaps[idx];
-
-	if (newttl < oldttl) {
-		isc_heap_increased(heap, header->heap_index);
-	} else {
-		isc_heap_decreased(heap, header->heap_index);
-	}
+	isc_wheel_update(rbtdb->wheels[header->node->locknum],
+			 header->heap_index, newttl);
 }
 
 /*%
- * These functions allow the heap code to rank the priority of each
- * element.  It returns true if v1 happens "sooner" than v2.
+ * Return the next header of bucket 'locknum' whose TTL has passed, if any.
+ * Headers are not returned in order of their TTLs, only in the order in
+ * which they became due.
  */
-static bool
-ttl_sooner(void *v1, void *v2) {
-	rdatasetheader_t *h1 = v1;
-	rdatasetheader_t *h2 = v2;
-
-	return (h1->rdh_ttl < h2->rdh_ttl);
+static rdatasetheader_t *
+ttl_due(dns_rbtdb_t *rbtdb, unsigned int locknum, isc_stdtime_t now) {
+	return (isc_wheel_due(rbtdb->wheels[locknum], now - RBTDB_VIRTUAL));
 }
 
 /*%
@@ -1047,7 +1322,7 @@ resign_sooner(void *v1, void *v2) {
 }
 
 /*%
- * This function sets the heap index into the header.
+ * This function sets the heap (or wheel) index into the header.
  */
 static void
 set_index(void *what, unsigned int idx) {
@@ -1119,11 +1394,8 @@ free_rbtdb(dns_rbtdb_t *rbtdb, bool log) {
 	dns_rbt_t **treep;
 	isc_time_t start;
 
-	if (IS_CACHE(rbtdb) && rbtdb->common.rdclass == dns_rdataclass_in) {
-		overmem((dns_db_t *)rbtdb, (bool)-1);
-	}
-
 	REQUIRE(rbtdb->current_version != NULL || EMPTY(rbtdb->open_versions));
+	INSIST(!atomic_load(&rbtdb->cleaning));
 	REQUIRE(rbtdb->future_version == NULL);
 
 	if (rbtdb->current_version != NULL) {
@@ -1184,6 +1456,11 @@ free_rbtdb(dns_rbtdb_t *rbtdb, bool log) {
 		INSIST(result == ISC_R_SUCCESS && *treep == NULL);
 	}
 
+	if (rbtdb->mmap_base != NULL) {
+		RUNTIME_CHECK(munmap(rbtdb->mmap_base, rbtdb->mmap_size) == 0);
+		rbtdb->mmap_base = NULL;
+	}
+
 	if (log) {
 		if (dns_name_dynamic(&rbtdb->common.origin)) {
 			dns_name_format(&rbtdb->common.origin, buf,
@@ -1209,10 +1486,14 @@ free_rbtdb(dns_rbtdb_t *rbtdb, bool log) {
 	if (rbtdb->rdatasets != NULL) {
 		for (i = 0; i < rbtdb->node_lock_count; i++) {
 			INSIST(ISC_LIST_EMPTY(rbtdb->rdatasets[i]));
+			INSIST(rbtdb->sieve_hands[i] == NULL);
 		}
 		isc_mem_put(rbtdb->common.mctx, rbtdb->rdatasets,
 			    rbtdb->node_lock_count *
 				    sizeof(rdatasetheaderlist_t));
+		isc_mem_put(rbtdb->common.mctx, rbtdb->sieve_hands,
+			    rbtdb->node_lock_count *
+				    sizeof(rdatasetheader_t *));
 	}
 	/*
 	 * Clean up dead node buckets.
@@ -1225,8 +1506,15 @@ free_rbtdb(dns_rbtdb_t *rbtdb, bool log) {
 			    rbtdb->node_lock_count * sizeof(rbtnodelist_t));
 	}
 	/*
-	 * Clean up heap objects.
+	 * Clean up wheel and heap objects.
 	 */
+	if (rbtdb->wheels != NULL) {
+		for (i = 0; i < rbtdb->node_lock_count; i++) {
+			isc_wheel_destroy(&rbtdb->wheels[i]);
+		}
+		isc_mem_put(rbtdb->hmctx, rbtdb->wheels,
+			    rbtdb->node_lock_count * sizeof(isc_wheel_t *));
+	}
 	if (rbtdb->heaps != NULL) {
 		for (i = 0; i < rbtdb->node_lock_count; i++) {
 			isc_heap_destroy(&rbtdb->heaps[i]);
@@ -1543,11 +1831,17 @@ free_rdataset(dns_rbtdb_t *rbtdb, isc_mem_t *mctx, rdatasetheader_t *rdataset) {
 	idx = rdataset->node->locknum;
 	if (ISC_LINK_LINKED(rdataset, link)) {
 		INSIST(IS_CACHE(rbtdb));
-		ISC_LIST_UNLINK(rbtdb->rdatasets[idx], rdataset, link);
+		sieve_unlink(rbtdb, idx, rdataset);
 	}
 
 	if (rdataset->heap_index != 0) {
-		isc_heap_delete(rbtdb->heaps[idx], rdataset->heap_index);
+		if (IS_CACHE(rbtdb)) {
+			isc_wheel_delete(rbtdb->wheels[idx],
+					 rdataset->heap_index);
+		} else {
+			isc_heap_delete(rbtdb->heaps[idx],
+					rdataset->heap_index);
+		}
 	}
 	rdataset->heap_index = 0;
 
@@ -1565,7 +1859,9 @@ free_rdataset(dns_rbtdb_t *rbtdb, isc_mem_t *mctx, rdatasetheader_t *rdataset) {
 					  sizeof(*rdataset));
 	}
 
-	isc_mem_put(mctx, rdataset, size);
+	if (!MAPPED(rbtdb, rdataset)) {
+		isc_mem_put(mctx, rdataset, size);
+	}
 }
 
 static void
@@ -2282,7 +2578,7 @@ prune_tree(void *arg) {
 		node = parent;
 	} while (node != NULL);
 	NODE_UNLOCK(&rbtdb->node_locks[locknum].lock, &nlocktype);
-	RWUNLOCK(&rbtdb->tree_lock, tlocktype);
+	TREE_UNLOCK(&rbtdb->tree_lock, &tlocktype);
 
 	detach((dns_db_t **)&rbtdb);
 }
@@ -2854,11 +3150,12 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, const dns_name_t *name,
 	dns_name_t nodename;
 	isc_result_t result;
 	isc_rwlocktype_t tlocktype = isc_rwlocktype_none;
+	treereader_t *treeslot = NULL;
 
 	INSIST(tree == rbtdb->tree || tree == rbtdb->nsec3);
 
 	dns_name_init(&nodename, NULL);
-	TREE_RDLOCK(&rbtdb->tree_lock, &tlocktype);
+	TREE_RDLOCK_BIASED(&rbtdb->tree_lock, &tlocktype, &treeslot);
 	result = dns_rbt_findnode(tree, name, NULL, &node, NULL,
 				  DNS_RBTFIND_EMPTYDATA, NULL, NULL);
 	if (result != ISC_R_SUCCESS) {
@@ -2871,10 +3168,12 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, const dns_name_t *name,
 		/*
 		 * Try to upgrade the lock and if that fails unlock then relock.
 		 */
-		if (TREE_TRYUPGRADE(&rbtdb->tree_lock, &tlocktype) !=
-		    ISC_R_SUCCESS)
+		if (treeslot != NULL ||
+		    TREE_TRYUPGRADE(&rbtdb->tree_lock, &tlocktype) !=
+			    ISC_R_SUCCESS)
 		{
-			TREE_UNLOCK(&rbtdb->tree_lock, &tlocktype);
+			TREE_UNLOCK_BIASED(&rbtdb->tree_lock, &tlocktype,
+					   &treeslot);
 			TREE_WRLOCK(&rbtdb->tree_lock, &tlocktype);
 		}
 		node = NULL;
@@ -2910,7 +3209,7 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, const dns_name_t *name,
 	*nodep = (dns_dbnode_t *)node;
 
 unlock:
-	TREE_UNLOCK(&rbtdb->tree_lock, &tlocktype);
+	TREE_UNLOCK_BIASED(&rbtdb->tree_lock, &tlocktype, &treeslot);
 
 	return (result);
 }
@@ -4041,6 +4340,7 @@ zone_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	dns_rbt_t *tree;
 	isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
 	isc_rwlocktype_t tlocktype = isc_rwlocktype_none;
+	treereader_t *treeslot = NULL;
 
 	search.rbtdb = (dns_rbtdb_t *)db;
 
@@ -4078,7 +4378,7 @@ zone_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	 */
 	wild = false;
 
-	TREE_RDLOCK(&search.rbtdb->tree_lock, &tlocktype);
+	TREE_RDLOCK_BIASED(&search.rbtdb->tree_lock, &tlocktype, &treeslot);
 
 	/*
 	 * Search down from the root of the tree.  If, while going down, we
@@ -4534,7 +4834,7 @@ node_exit:
 	NODE_UNLOCK(lock, &nlocktype);
 
 tree_exit:
-	TREE_UNLOCK(&search.rbtdb->tree_lock, &tlocktype);
+	TREE_UNLOCK_BIASED(&search.rbtdb->tree_lock, &tlocktype, &treeslot);
 
 	/*
 	 * If we found a zonecut but aren't going to use it, we have to
@@ -4866,29 +5166,9 @@ find_deepest_zonecut(rbtdb_search_t *search, dns_rbtnode_t *node,
 					      search->now, nlocktype,
 					      sigrdataset);
 			}
-			if (need_headerupdate(found, search->now) ||
-			    (foundsig != NULL &&
-			     need_headerupdate(foundsig, search->now)))
-			{
-				if (nlocktype != isc_rwlocktype_write) {
-					if (NODE_TRYUPGRADE(lock, &nlocktype) !=
-					    ISC_R_SUCCESS)
-					{
-						NODE_UNLOCK(lock, &nlocktype);
-						NODE_WRLOCK(lock, &nlocktype);
-					}
-					POST(nlocktype);
-				}
-				if (need_headerupdate(found, search->now)) {
-					update_header(search->rbtdb, found,
-						      search->now);
-				}
-				if (foundsig != NULL &&
-				    need_headerupdate(foundsig, search->now))
-				{
-					update_header(search->rbtdb, foundsig,
-						      search->now);
-				}
+			mark_header_visited(found);
+			if (foundsig != NULL) {
+				mark_header_visited(foundsig);
 			}
 		}
 
@@ -5042,7 +5322,6 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	rdatasetheader_t *header, *header_prev, *header_next;
 	rdatasetheader_t *found, *nsheader;
 	rdatasetheader_t *foundsig, *nssig, *cnamesig;
-	rdatasetheader_t *update, *updatesig;
 	rdatasetheader_t *nsecheader, *nsecsig;
 	rbtdb_rdatatype_t sigtype, negtype;
 
@@ -5069,8 +5348,6 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	dns_fixedname_init(&search.zonecut_name);
 	dns_rbtnodechain_init(&search.chain);
 	search.now = now;
-	update = NULL;
-	updatesig = NULL;
 
 	TREE_RDLOCK(&search.rbtdb->tree_lock, &tlocktype);
 
@@ -5272,16 +5549,12 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 			}
 			bind_rdataset(search.rbtdb, node, nsecheader,
 				      search.now, nlocktype, rdataset);
-			if (need_headerupdate(nsecheader, search.now)) {
-				update = nsecheader;
-			}
+			mark_header_visited(nsecheader);
 			if (nsecsig != NULL) {
 				bind_rdataset(search.rbtdb, node, nsecsig,
 					      search.now, nlocktype,
 					      sigrdataset);
-				if (need_headerupdate(nsecsig, search.now)) {
-					updatesig = nsecsig;
-				}
+				mark_header_visited(nsecsig);
 			}
 			result = DNS_R_COVERINGNSEC;
 			goto node_exit;
@@ -5314,16 +5587,12 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 			}
 			bind_rdataset(search.rbtdb, node, nsheader, search.now,
 				      nlocktype, rdataset);
-			if (need_headerupdate(nsheader, search.now)) {
-				update = nsheader;
-			}
+			mark_header_visited(nsheader);
 			if (nssig != NULL) {
 				bind_rdataset(search.rbtdb, node, nssig,
 					      search.now, nlocktype,
 					      sigrdataset);
-				if (need_headerupdate(nssig, search.now)) {
-					updatesig = nssig;
-				}
+				mark_header_visited(nssig);
 			}
 			result = DNS_R_DELEGATION;
 			goto node_exit;
@@ -5375,35 +5644,15 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	{
 		bind_rdataset(search.rbtdb, node, found, search.now, nlocktype,
 			      rdataset);
-		if (need_headerupdate(found, search.now)) {
-			update = found;
-		}
+		mark_header_visited(found);
 		if (!NEGATIVE(found) && foundsig != NULL) {
 			bind_rdataset(search.rbtdb, node, foundsig, search.now,
 				      nlocktype, sigrdataset);
-			if (need_headerupdate(foundsig, search.now)) {
-				updatesig = foundsig;
-			}
+			mark_header_visited(foundsig);
 		}
 	}
 
 node_exit:
-	if ((update != NULL || updatesig != NULL) &&
-	    nlocktype != isc_rwlocktype_write)
-	{
-		if (NODE_TRYUPGRADE(lock, &nlocktype) != ISC_R_SUCCESS) {
-			NODE_UNLOCK(lock, &nlocktype);
-			NODE_WRLOCK(lock, &nlocktype);
-		}
-		POST(nlocktype);
-	}
-	if (update != NULL && need_headerupdate(update, search.now)) {
-		update_header(search.rbtdb, update, search.now);
-	}
-	if (updatesig != NULL && need_headerupdate(updatesig, search.now)) {
-		update_header(search.rbtdb, updatesig, search.now);
-	}
-
 	NODE_UNLOCK(lock, &nlocktype);
 
 tree_exit:
@@ -5570,24 +5819,9 @@ cache_findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
 			      nlocktype, sigrdataset);
 	}
 
-	if (need_headerupdate(found, search.now) ||
-	    (foundsig != NULL && need_headerupdate(foundsig, search.now)))
-	{
-		if (nlocktype != isc_rwlocktype_write) {
-			if (NODE_TRYUPGRADE(lock, &nlocktype) != ISC_R_SUCCESS)
-			{
-				NODE_UNLOCK(lock, &nlocktype);
-				NODE_WRLOCK(lock, &nlocktype);
-			}
-			POST(nlocktype);
-		}
-		if (need_headerupdate(found, search.now)) {
-			update_header(search.rbtdb, found, search.now);
-		}
-		if (foundsig != NULL && need_headerupdate(foundsig, search.now))
-		{
-			update_header(search.rbtdb, foundsig, search.now);
-		}
+	mark_header_visited(found);
+	if (foundsig != NULL) {
+		mark_header_visited(foundsig);
 	}
 
 	NODE_UNLOCK(lock, &nlocktype);
@@ -5770,12 +6004,13 @@ expirenode(dns_db_t *db, dns_dbnode_t *node, isc_stdtime_t now) {
 
 static void
 overmem(dns_db_t *db, bool over) {
-	/* This is an empty callback.  See adb.c:water() */
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
 
-	UNUSED(db);
-	UNUSED(over);
+	REQUIRE(VALID_RBTDB(rbtdb));
 
-	return;
+	if (over && IS_CACHE(rbtdb)) {
+		cleaner_start(rbtdb);
+	}
 }
 
 static void
@@ -6631,8 +6866,8 @@ find_header:
 					ISC_LIST_PREPEND(rbtdb->rdatasets[idx],
 							 newheader, link);
 				}
-				INSIST(rbtdb->heaps != NULL);
-				isc_heap_insert(rbtdb->heaps[idx], newheader);
+				isc_wheel_insert(rbtdb->wheels[idx], newheader,
+						 newheader->rdh_ttl);
 			} else if (RESIGN(newheader)) {
 				resign_insert(rbtdb, idx, newheader);
 				/*
@@ -6663,8 +6898,8 @@ find_header:
 		} else {
 			idx = newheader->node->locknum;
 			if (IS_CACHE(rbtdb)) {
-				INSIST(rbtdb->heaps != NULL);
-				isc_heap_insert(rbtdb->heaps[idx], newheader);
+				isc_wheel_insert(rbtdb->wheels[idx], newheader,
+						 newheader->rdh_ttl);
 				if (ZEROTTL(newheader)) {
 					ISC_LIST_APPEND(rbtdb->rdatasets[idx],
 							newheader, link);
@@ -6718,7 +6953,8 @@ find_header:
 
 		idx = newheader->node->locknum;
 		if (IS_CACHE(rbtdb)) {
-			isc_heap_insert(rbtdb->heaps[idx], newheader);
+			isc_wheel_insert(rbtdb->wheels[idx], newheader,
+					 newheader->rdh_ttl);
 			if (ZEROTTL(newheader)) {
 				ISC_LIST_APPEND(rbtdb->rdatasets[idx],
 						newheader, link);
@@ -6906,7 +7142,6 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	rbtdb_version_t *rbtversion = version;
 	isc_region_t region;
 	rdatasetheader_t *newheader;
-	rdatasetheader_t *header;
 	isc_result_t result;
 	bool delegating;
 	bool newnsec;
@@ -6971,7 +7206,6 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	atomic_init(&newheader->count,
 		    atomic_fetch_add_relaxed(&init_count, 1));
 	newheader->trust = rdataset->trust;
-	newheader->last_used = now;
 	newheader->node = rbtnode;
 	if (rbtversion != NULL) {
 		newheader->serial = rbtversion->serial;
@@ -7056,6 +7290,14 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	if (IS_CACHE(rbtdb) && isc_mem_isovermem(rbtdb->common.mctx)) {
 		cache_is_overmem = true;
 	}
+	if (cache_is_overmem && rbtdb->loop != NULL) {
+		/*
+		 * Leave the cleaning to the background cleaner; this only
+		 * restarts it if it has stopped.
+		 */
+		cleaner_start(rbtdb);
+		cache_is_overmem = false;
+	}
 	if (delegating || newnsec || cache_is_overmem) {
 		TREE_WRLOCK(&rbtdb->tree_lock, &tlocktype);
 	}
@@ -7078,12 +7320,18 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 			cleanup_dead_nodes(rbtdb, rbtnode->locknum);
 		}
 
-		header = isc_heap_element(rbtdb->heaps[rbtnode->locknum], 1);
-		if (header != NULL &&
-		    header->rdh_ttl + STALE_TTL(header, rbtdb) <
-			    now - RBTDB_VIRTUAL)
-		{
-			expire_header(rbtdb, header, &tlocktype, expire_ttl);
+		/*
+		 * Whatever is at the head of the due list, ancient or still
+		 * servable stale, there may be expired headers behind it.
+		 */
+		if (ttl_due(rbtdb, rbtnode->locknum, now) != NULL) {
+			if (rbtdb->loop == NULL) {
+				expire_ttl_headers(rbtdb, rbtnode->locknum, now,
+						   DNS_RBTDB_EXPIRE_MAX,
+						   &tlocktype);
+			} else {
+				cleaner_start(rbtdb);
+			}
 		}
 
 		/*
@@ -7189,7 +7437,6 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	newheader->closest = NULL;
 	atomic_init(&newheader->count,
 		    atomic_fetch_add_relaxed(&init_count, 1));
-	newheader->last_used = 0;
 	newheader->node = rbtnode;
 	if ((rdataset->attributes & DNS_RDATASETATTR_RESIGN) != 0) {
 		RDATASET_ATTR_SET(newheader, RDATASET_ATTR_RESIGN);
@@ -7299,7 +7546,6 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 			newheader->node = rbtnode;
 			newheader->resign = 0;
 			newheader->resign_lsb = 0;
-			newheader->last_used = 0;
 		} else {
 			free_rdataset(rbtdb, rbtdb->common.mctx, newheader);
 			goto unlock;
@@ -7404,7 +7650,6 @@ deleterdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		newheader->serial = 0;
 	}
 	atomic_init(&newheader->count, 0);
-	newheader->last_used = 0;
 	newheader->node = rbtnode;
 
 	nodefullname(db, node, nodename);
@@ -7592,7 +7837,6 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 	newheader->closest = NULL;
 	atomic_init(&newheader->count,
 		    atomic_fetch_add_relaxed(&init_count, 1));
-	newheader->last_used = 0;
 	newheader->node = node;
 	setownercase(newheader, name);
 
@@ -7623,18 +7867,501 @@ loading_addrdataset(void *arg, const dns_name_t *name,
 	return (result);
 }
 
-static isc_result_t
-beginload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
-	rbtdb_load_t *loadctx;
-	dns_rbtdb_t *rbtdb;
-	rbtdb = (dns_rbtdb_t *)db;
-
-	REQUIRE(DNS_CALLBACK_VALID(callbacks));
-	REQUIRE(VALID_RBTDB(rbtdb));
+/*
+ * Map format.
+ *
+ * A zone database can be written out as an image of its trees and
+ * rdatasets, laid out for the address the file will be mapped at, so
+ * that loading it is a matter of mapping the file: the nodes and slabs
+ * are used where they are, pages are read in as lookups reach them, and
+ * the first change to a page (a reference count, or an update) gives the
+ * process its own copy of it.  The file follows the raw format header
+ * written by masterdump.c.
+ */
 
-	loadctx = isc_mem_get(rbtdb->common.mctx, sizeof(*loadctx));
+#define RBTDB_MAP_VERSION "RBTDB Map Version 1"
 
-	loadctx->rbtdb = rbtdb;
+/*%
+ * Where in the address space the image of a zone is laid out for: each
+ * zone is given one of RBTDB_MAP_SLOTS slots of 4 GB, chosen by its
+ * name.  A file that cannot be mapped there (because another mapping
+ * is in the way, or the image is larger than a slot) is relocated when it
+ * is loaded, which touches all of it.
+ */
+#define RBTDB_MAP_BASE	0x200000000000ULL
+#define RBTDB_MAP_SLOTS 4096
+
+#define RBTDB_MAP_BYTEORDER 0x01020304
+
+typedef struct rbtdb_file_header {
+	char version1[32];
+	uint32_t byteorder;
+	uint32_t ptrsize;
+	uint32_t nodesize;
+	uint32_t headersize;
+	uint32_t node_lock_count;
+	uint32_t unused;
+	uint64_t base;	  /* address the file is laid out for */
+	uint64_t size;	  /* size of the whole file */
+	uint64_t tree;	  /* offset of the main tree header */
+	uint64_t nsec;	  /* offset of the auxiliary NSEC tree header */
+	uint64_t nsec3;	  /* offset of the NSEC3 tree header */
+	uint64_t resign;  /* offset of the addresses of re-signed headers */
+	uint64_t nresign; /* and their number */
+	uint64_t records;
+	uint64_t xfrsize;
+	char version2[32];
+} rbtdb_file_header_t;
+
+typedef struct {
+	dns_rbtdb_t *rbtdb;
+	rbtdb_serial_t serial;
+	uintptr_t base;
+	uintptr_t *resign;
+	size_t nresign;
+	size_t resignsize;
+} rbtdb_serialize_t;
+
+static uintptr_t
+map_base(dns_rbtdb_t *rbtdb) {
+#if SIZE_MAX > UINT32_MAX
+	isc_region_t r;
+	uint64_t crc;
+
+	dns_name_toregion(&rbtdb->common.origin, &r);
+	isc_crc64_init(&crc);
+	isc_crc64_update(&crc, r.base, r.length);
+	isc_crc64_final(&crc);
+
+	return ((uintptr_t)(RBTDB_MAP_BASE +
+			    ((crc % RBTDB_MAP_SLOTS) << 32)));
+#else  /* SIZE_MAX > UINT32_MAX */
+	/*
+	 * There is no room to choose from: let the file be relocated.
+	 */
+	UNUSED(rbtdb);
+	return (0);
+#endif /* SIZE_MAX > UINT32_MAX */
+}
+
+static isc_result_t
+write_padding(FILE *file, off_t *offsetp) {
+	static const unsigned char zeroes[8] = { 0 };
+	isc_result_t result;
+	off_t offset;
+	size_t pad;
+
+	result = isc_stdio_tell(file, &offset);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	pad = (8 - (offset % 8)) % 8;
+	if (pad != 0) {
+		result = isc_stdio_write(zeroes, 1, pad, file, NULL);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+
+	if (offsetp != NULL) {
+		*offsetp = offset + pad;
+	}
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Return the header of the rdataset 'header' heads that is visible in
+ * version 'serial', if it exists in that version.
+ */
+static rdatasetheader_t *
+visible_header(rdatasetheader_t *header, rbtdb_serial_t serial) {
+	do {
+		if (header->serial <= serial && !IGNORE(header)) {
+			if (NONEXISTENT(header)) {
+				header = NULL;
+			}
+			break;
+		}
+		header = header->down;
+	} while (header != NULL);
+
+	return (header);
+}
+
+static size_t
+header_size(rdatasetheader_t *header) {
+	size_t size = dns_rdataslab_size((unsigned char *)header,
+					 sizeof(*header));
+
+	return ((size + 7) & ~(size_t)7);
+}
+
+/*
+ * Write the rdatasets of 'node' that are visible in the version being
+ * serialized, one after the other.
+ */
+static isc_result_t
+serialize_data(FILE *file, dns_rbtnode_t *node, uintptr_t nodeaddr, void *arg,
+	       uintptr_t *datap) {
+	rbtdb_serialize_t *rs = arg;
+	dns_rbtdb_t *rbtdb = rs->rbtdb;
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
+	rdatasetheader_t *top = NULL, *header = NULL, *next = NULL;
+	rdatasetheader_t image;
+	off_t offset;
+
+	*datap = 0;
+
+	NODE_RDLOCK(&rbtdb->node_locks[node->locknum].lock, &nlocktype);
+
+	for (top = node->data; top != NULL; top = top->next) {
+		header = visible_header(top, rs->serial);
+		if (header != NULL) {
+			break;
+		}
+	}
+
+	while (header != NULL) {
+		size_t size = dns_rdataslab_size((unsigned char *)header,
+						 sizeof(*header));
+		uintptr_t addr;
+
+		next = NULL;
+		for (top = top->next; top != NULL; top = top->next) {
+			next = visible_header(top, rs->serial);
+			if (next != NULL) {
+				break;
+			}
+		}
+
+		CHECK(write_padding(file, &offset));
+		addr = rs->base + (uintptr_t)offset;
+		if (*datap == 0) {
+			*datap = addr;
+		}
+
+		memmove(&image, header, sizeof(image));
+		image.serial = 1;
+		image.down = NULL;
+		image.next = (next != NULL)
+				     ? (rdatasetheader_t *)(addr +
+							   header_size(header))
+				     : NULL;
+		image.node = (dns_rbtnode_t *)nodeaddr;
+		image.noqname = NULL;
+		image.closest = NULL;
+		image.heap_index = 0;
+		atomic_init(&image.last_refresh_fail_ts, 0);
+		ISC_LINK_INIT(&image, link);
+
+		CHECK(isc_stdio_write(&image, 1, sizeof(image), file, NULL));
+		CHECK(isc_stdio_write(header + 1, 1, size - sizeof(image), file,
+				      NULL));
+
+		if (RESIGN(header)) {
+			if (rs->nresign == rs->resignsize) {
+				size_t newsize = ISC_MAX(rs->resignsize * 2,
+							 1024);
+				rs->resign = isc_mem_reget(
+					rbtdb->common.mctx, rs->resign,
+					rs->resignsize * sizeof(rs->resign[0]),
+					newsize * sizeof(rs->resign[0]));
+				rs->resignsize = newsize;
+			}
+			rs->resign[rs->nresign++] = addr;
+		}
+
+		header = next;
+	}
+
+	CHECK(write_padding(file, NULL));
+
+failure:
+	NODE_UNLOCK(&rbtdb->node_locks[node->locknum].lock, &nlocktype);
+	return (result);
+}
+
+static isc_result_t
+serialize(dns_db_t *db, dns_dbversion_t *version, FILE *file) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+	rbtdb_version_t *rbtversion = version;
+	isc_result_t result;
+	isc_rwlocktype_t tlocktype = isc_rwlocktype_none;
+	rbtdb_file_header_t header = {
+		.version1 = RBTDB_MAP_VERSION,
+		.version2 = RBTDB_MAP_VERSION,
+		.byteorder = RBTDB_MAP_BYTEORDER,
+		.ptrsize = sizeof(void *),
+		.nodesize = sizeof(dns_rbtnode_t),
+		.headersize = sizeof(rdatasetheader_t),
+	};
+	rbtdb_serialize_t rs = { .rbtdb = rbtdb };
+	off_t header_offset, offset;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(!IS_CACHE(rbtdb));
+	REQUIRE(rbtversion != NULL && rbtversion->rbtdb == rbtdb);
+
+	rs.serial = rbtversion->serial;
+	rs.base = map_base(rbtdb);
+	header.base = rs.base;
+	header.node_lock_count = rbtdb->node_lock_count;
+
+	/*
+	 * Write a placeholder header, to be filled in at the end.
+	 */
+	CHECK(write_padding(file, &header_offset));
+	CHECK(isc_stdio_write(&header, 1, sizeof(header), file, NULL));
+
+	TREE_RDLOCK(&rbtdb->tree_lock, &tlocktype);
+	result = dns_rbt_serialize_tree(file, rbtdb->tree, rs.base,
+					serialize_data, &rs, &offset);
+	header.tree = offset;
+	if (result == ISC_R_SUCCESS) {
+		result = dns_rbt_serialize_tree(file, rbtdb->nsec, rs.base,
+						serialize_data, &rs, &offset);
+		header.nsec = offset;
+	}
+	if (result == ISC_R_SUCCESS) {
+		result = dns_rbt_serialize_tree(file, rbtdb->nsec3, rs.base,
+						serialize_data, &rs, &offset);
+		header.nsec3 = offset;
+	}
+	TREE_UNLOCK(&rbtdb->tree_lock, &tlocktype);
+	if (result != ISC_R_SUCCESS) {
+		goto failure;
+	}
+
+	CHECK(write_padding(file, &offset));
+	header.resign = offset;
+	header.nresign = rs.nresign;
+	if (rs.nresign != 0) {
+		CHECK(isc_stdio_write(rs.resign, sizeof(rs.resign[0]),
+				      rs.nresign, file, NULL));
+	}
+	CHECK(write_padding(file, &offset));
+	header.size = offset;
+
+	RWLOCK(&rbtversion->rwlock, isc_rwlocktype_read);
+	header.records = rbtversion->records;
+	header.xfrsize = rbtversion->xfrsize;
+	RWUNLOCK(&rbtversion->rwlock, isc_rwlocktype_read);
+
+	CHECK(isc_stdio_seek(file, header_offset, SEEK_SET));
+	CHECK(isc_stdio_write(&header, 1, sizeof(header), file, NULL));
+	CHECK(isc_stdio_seek(file, offset, SEEK_SET));
+
+failure:
+	if (rs.resign != NULL) {
+		isc_mem_put(rbtdb->common.mctx, rs.resign,
+			    rs.resignsize * sizeof(rs.resign[0]));
+	}
+	return (result);
+}
+
+#define RELOCATE(p)                                                     \
+	do {                                                            \
+		if ((p) != NULL) {                                      \
+			(p) = (void *)((uintptr_t)(p) + delta);         \
+			if (!MAPPED(rbtdb, p)) {                        \
+				return (ISC_R_INVALIDFILE);             \
+			}                                               \
+		}                                                       \
+	} while (0)
+
+/*
+ * The datafixer for dns_rbt_deserialize_tree(): adjust the pointers in
+ * the rdatasets of a node that has been relocated.  The node's own data
+ * pointer has already been adjusted.
+ */
+static isc_result_t
+relocate_data(dns_rbtnode_t *node, intptr_t delta, void *arg) {
+	dns_rbtdb_t *rbtdb = arg;
+	rdatasetheader_t *header = NULL;
+
+	for (header = node->data; header != NULL; header = header->next) {
+		RELOCATE(header->next);
+		RELOCATE(header->node);
+		if (header->node != node) {
+			return (ISC_R_INVALIDFILE);
+		}
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+deserialize(void *arg, FILE *f, off_t offset) {
+	rbtdb_load_t *loadctx = arg;
+	dns_rbtdb_t *rbtdb = loadctx->rbtdb;
+	isc_mem_t *mctx = rbtdb->common.mctx;
+	isc_result_t result;
+	rbtdb_file_header_t header;
+	dns_rbt_t *tree = NULL, *nsec = NULL, *nsec3 = NULL;
+	dns_rbtnode_t *origin_node = NULL, *nsec3_origin_node = NULL;
+	uintptr_t *resign = NULL;
+	struct stat sb;
+	void *base = NULL;
+	size_t size = 0;
+	intptr_t delta;
+	int fd = fileno(f);
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(rbtdb->mmap_base == NULL);
+
+	if (IS_CACHE(rbtdb)) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	if (fstat(fd, &sb) == -1) {
+		return (isc_errno_toresult(errno));
+	}
+	if (offset < 0 || sb.st_size < offset ||
+	    (size_t)(sb.st_size - offset) < sizeof(header) ||
+	    pread(fd, &header, sizeof(header), offset) !=
+		    (ssize_t)sizeof(header))
+	{
+		return (ISC_R_INVALIDFILE);
+	}
+
+	/*
+	 * The image can only be used by a build that lays out nodes and
+	 * headers the same way, with the same number of node locks.
+	 */
+	if (strncmp(header.version1, RBTDB_MAP_VERSION,
+		    sizeof(header.version1)) != 0 ||
+	    strncmp(header.version2, RBTDB_MAP_VERSION,
+		    sizeof(header.version2)) != 0 ||
+	    header.byteorder != RBTDB_MAP_BYTEORDER ||
+	    header.ptrsize != sizeof(void *) ||
+	    header.nodesize != sizeof(dns_rbtnode_t) ||
+	    header.headersize != sizeof(rdatasetheader_t) ||
+	    header.node_lock_count != rbtdb->node_lock_count ||
+	    header.size != (uint64_t)sb.st_size || header.size > SIZE_MAX ||
+	    header.resign > header.size || header.resign % 8 != 0 ||
+	    header.nresign > (header.size - header.resign) / sizeof(*resign))
+	{
+		return (ISC_R_INVALIDFILE);
+	}
+	size = (size_t)header.size;
+
+	base = mmap((void *)(uintptr_t)header.base, size,
+		    PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (base == MAP_FAILED) {
+		return (isc_errno_toresult(errno));
+	}
+	rbtdb->mmap_base = base;
+	rbtdb->mmap_size = size;
+	delta = (intptr_t)((uintptr_t)base - (uintptr_t)header.base);
+
+	if (delta != 0) {
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE,
+			      DNS_LOGMODULE_DB, ISC_LOG_DEBUG(1),
+			      "map file could not be mapped at %p; "
+			      "relocating it",
+			      (void *)(uintptr_t)header.base);
+	}
+
+	CHECK(dns_rbt_deserialize_tree(base, size, header.tree, delta, mctx,
+				       delete_callback, rbtdb, relocate_data,
+				       rbtdb, &tree));
+	CHECK(dns_rbt_deserialize_tree(base, size, header.nsec, delta, mctx,
+				       delete_callback, rbtdb, relocate_data,
+				       rbtdb, &nsec));
+	CHECK(dns_rbt_deserialize_tree(base, size, header.nsec3, delta, mctx,
+				       delete_callback, rbtdb, relocate_data,
+				       rbtdb, &nsec3));
+
+	/*
+	 * The zone's top nodes are always in the image, as
+	 * dns_rbtdb_create() adds them and they are never deleted.
+	 */
+	result = dns_rbt_findnode(tree, &rbtdb->common.origin, NULL,
+				  &origin_node, NULL, DNS_RBTFIND_EMPTYDATA,
+				  NULL, NULL);
+	if (result == ISC_R_SUCCESS) {
+		result = dns_rbt_findnode(nsec3, &rbtdb->common.origin, NULL,
+					  &nsec3_origin_node, NULL,
+					  DNS_RBTFIND_EMPTYDATA, NULL, NULL);
+	}
+	if (result != ISC_R_SUCCESS) {
+		CHECK(ISC_R_INVALIDFILE);
+	}
+
+	resign = (uintptr_t *)((unsigned char *)base + header.resign);
+	for (size_t i = 0; i < header.nresign; i++) {
+		rdatasetheader_t *h = NULL;
+
+		resign[i] += delta;
+		h = (rdatasetheader_t *)resign[i];
+		if (!MAPPED(rbtdb, h) || !MAPPED(rbtdb, h + 1) ||
+		    !MAPPED(rbtdb, h->node) ||
+		    h->node->locknum >= rbtdb->node_lock_count)
+		{
+			CHECK(ISC_R_INVALIDFILE);
+		}
+	}
+
+	/*
+	 * Swap the trees the database was created with for the loaded
+	 * ones, and rebuild the re-signing heaps, which point into them.
+	 */
+	dns_rbt_destroy(&rbtdb->tree);
+	dns_rbt_destroy(&rbtdb->nsec);
+	dns_rbt_destroy(&rbtdb->nsec3);
+	rbtdb->tree = tree;
+	rbtdb->nsec = nsec;
+	rbtdb->nsec3 = nsec3;
+	rbtdb->origin_node = origin_node;
+	rbtdb->nsec3_origin_node = nsec3_origin_node;
+
+	for (size_t i = 0; i < header.nresign; i++) {
+		rdatasetheader_t *h = (rdatasetheader_t *)resign[i];
+
+		isc_heap_insert(rbtdb->heaps[h->node->locknum], h);
+	}
+
+	RWLOCK(&rbtdb->current_version->rwlock, isc_rwlocktype_write);
+	rbtdb->current_version->records = header.records;
+	rbtdb->current_version->xfrsize = header.xfrsize;
+	RWUNLOCK(&rbtdb->current_version->rwlock, isc_rwlocktype_write);
+
+	return (ISC_R_SUCCESS);
+
+failure:
+	if (tree != NULL) {
+		dns_rbt_destroy(&tree);
+	}
+	if (nsec != NULL) {
+		dns_rbt_destroy(&nsec);
+	}
+	if (nsec3 != NULL) {
+		dns_rbt_destroy(&nsec3);
+	}
+	if (rbtdb->mmap_base != NULL) {
+		RUNTIME_CHECK(munmap(rbtdb->mmap_base, rbtdb->mmap_size) == 0);
+		rbtdb->mmap_base = NULL;
+		rbtdb->mmap_size = 0;
+	}
+	return (result);
+}
+
+#undef RELOCATE
+
+static isc_result_t
+beginload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
+	rbtdb_load_t *loadctx;
+	dns_rbtdb_t *rbtdb;
+	rbtdb = (dns_rbtdb_t *)db;
+
+	REQUIRE(DNS_CALLBACK_VALID(callbacks));
+	REQUIRE(VALID_RBTDB(rbtdb));
+
+	loadctx = isc_mem_get(rbtdb->common.mctx, sizeof(*loadctx));
+
+	loadctx->rbtdb = rbtdb;
 	if (IS_CACHE(rbtdb)) {
 		isc_stdtime_get(&loadctx->now);
 	} else {
@@ -7651,6 +8378,8 @@ beginload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 
 	callbacks->add = loading_addrdataset;
 	callbacks->add_private = loadctx;
+	callbacks->deserialize = deserialize;
+	callbacks->deserialize_private = loadctx;
 
 	return (ISC_R_SUCCESS);
 }
@@ -7688,6 +8417,8 @@ endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 
 	callbacks->add = NULL;
 	callbacks->add_private = NULL;
+	callbacks->deserialize = NULL;
+	callbacks->deserialize_private = NULL;
 
 	isc_mem_put(rbtdb->common.mctx, loadctx, sizeof(*loadctx));
 
@@ -8114,6 +8845,22 @@ setgluecachestats(dns_db_t *db, isc_stats_t *stats) {
 	return (ISC_R_SUCCESS);
 }
 
+void
+dns__rbtdb_setshard(dns_db_t *db, uint8_t shard, dns_stats_t *rrsetstats) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(IS_CACHE(rbtdb));
+	REQUIRE(rrsetstats != NULL);
+
+	dns_rbt_setshard(rbtdb->tree, shard);
+	dns_rbt_setshard(rbtdb->nsec, shard);
+	dns_rbt_setshard(rbtdb->nsec3, shard);
+
+	dns_stats_detach(&rbtdb->rrsetstats);
+	dns_stats_attach(rrsetstats, &rbtdb->rrsetstats);
+}
+
 static dns_stats_t *
 getrrsetstats(dns_db_t *db) {
 	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
@@ -8236,7 +8983,8 @@ static dns_dbmethods_t zone_methods = { attach,
 					NULL, /* getservestalettl */
 					NULL, /* setservestalerefresh */
 					NULL, /* getservestalerefresh */
-					setgluecachestats };
+					setgluecachestats,
+					serialize };
 
 static dns_dbmethods_t cache_methods = { attach,
 					 detach,
@@ -8296,7 +9044,6 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 	isc_result_t result;
 	int i;
 	dns_name_t name;
-	bool (*sooner)(void *, void *);
 	isc_mem_t *hmctx = mctx;
 
 	/* Keep the compiler happy. */
@@ -8329,7 +9076,7 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 
 	RBTDB_INITLOCK(&rbtdb->lock);
 
-	TREE_INITLOCK(&rbtdb->tree_lock);
+	TREE_INITLOCK(&rbtdb->tree_lock, IS_CACHE(rbtdb) ? NULL : mctx);
 
 	/*
 	 * Initialize node_lock_count in a generic way to support future
@@ -8363,24 +9110,41 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 		rbtdb->rdatasets = isc_mem_get(
 			mctx,
 			rbtdb->node_lock_count * sizeof(rdatasetheaderlist_t));
+		rbtdb->sieve_hands = isc_mem_get(
+			mctx,
+			rbtdb->node_lock_count * sizeof(rdatasetheader_t *));
 		for (i = 0; i < (int)rbtdb->node_lock_count; i++) {
 			ISC_LIST_INIT(rbtdb->rdatasets[i]);
+			rbtdb->sieve_hands[i] = NULL;
 		}
 	} else {
 		rbtdb->rdatasets = NULL;
+		rbtdb->sieve_hands = NULL;
 	}
 
 	/*
-	 * Create the heaps.
+	 * Create the TTL wheels of a cache, or the resigning heaps of
+	 * a zone.  The wheels run RBTDB_VIRTUAL seconds behind the clock.
 	 */
-	rbtdb->heaps = isc_mem_get(hmctx, rbtdb->node_lock_count *
-						  sizeof(isc_heap_t *));
-	for (i = 0; i < (int)rbtdb->node_lock_count; i++) {
-		rbtdb->heaps[i] = NULL;
-	}
-	sooner = IS_CACHE(rbtdb) ? ttl_sooner : resign_sooner;
-	for (i = 0; i < (int)rbtdb->node_lock_count; i++) {
-		isc_heap_create(hmctx, sooner, set_index, 0, &rbtdb->heaps[i]);
+	if (IS_CACHE(rbtdb)) {
+		isc_stdtime_t now;
+
+		isc_stdtime_get(&now);
+		rbtdb->wheels = isc_mem_get(hmctx, rbtdb->node_lock_count *
+							   sizeof(isc_wheel_t *));
+		for (i = 0; i < (int)rbtdb->node_lock_count; i++) {
+			rbtdb->wheels[i] = NULL;
+			isc_wheel_create(hmctx, now - RBTDB_VIRTUAL, set_index,
+					 &rbtdb->wheels[i]);
+		}
+	} else {
+		rbtdb->heaps = isc_mem_get(hmctx, rbtdb->node_lock_count *
+							  sizeof(isc_heap_t *));
+		for (i = 0; i < (int)rbtdb->node_lock_count; i++) {
+			rbtdb->heaps[i] = NULL;
+			isc_heap_create(hmctx, resign_sooner, set_index, 0,
+					&rbtdb->heaps[i]);
+		}
 	}
 
 	/*
@@ -8550,146 +9314,6 @@ cleanup_tree_lock:
  * Slabbed Rdataset Methods
  */
 
-static void
-rdataset_disassociate(dns_rdataset_t *rdataset) {
-	dns_db_t *db = rdataset->private1;
-	dns_dbnode_t *node = rdataset->private2;
-
-	detachnode(db, &node);
-}
-
-static isc_result_t
-rdataset_first(dns_rdataset_t *rdataset) {
-	unsigned char *raw = rdataset->private3; /* RDATASLAB */
-	unsigned int count;
-
-	count = raw[0] * 256 + raw[1];
-	if (count == 0) {
-		rdataset->private5 = NULL;
-		return (ISC_R_NOMORE);
-	}
-
-	if ((rdataset->attributes & DNS_RDATASETATTR_LOADORDER) == 0) {
-		raw += DNS_RDATASET_COUNT;
-	}
-
-	raw += DNS_RDATASET_LENGTH;
-
-	/*
-	 * The privateuint4 field is the number of rdata beyond the
-	 * cursor position, so we decrement the total count by one
-	 * before storing it.
-	 *
-	 * If DNS_RDATASETATTR_LOADORDER is not set 'raw' points to the
-	 * first record.  If DNS_RDATASETATTR_LOADORDER is set 'raw' points
-	 * to the first entry in the offset table.
-	 */
-	count--;
-	rdataset->privateuint4 = count;
-	rdataset->private5 = raw;
-
-	return (ISC_R_SUCCESS);
-}
-
-static isc_result_t
-rdataset_next(dns_rdataset_t *rdataset) {
-	unsigned int count;
-	unsigned int length;
-	unsigned char *raw; /* RDATASLAB */
-
-	count = rdataset->privateuint4;
-	if (count == 0) {
-		return (ISC_R_NOMORE);
-	}
-	count--;
-	rdataset->privateuint4 = count;
-
-	/*
-	 * Skip forward one record (length + 4) or one offset (4).
-	 */
-	raw = rdataset->private5;
-#if DNS_RDATASET_FIXED
-	if ((rdataset->attributes & DNS_RDATASETATTR_LOADORDER) == 0)
-#endif /* DNS_RDATASET_FIXED */
-	{
-		length = raw[0] * 256 + raw[1];
-		raw += length;
-	}
-
-	rdataset->private5 = raw + DNS_RDATASET_ORDER + DNS_RDATASET_LENGTH;
-
-	return (ISC_R_SUCCESS);
-}
-
-static void
-rdataset_current(dns_rdataset_t *rdataset, dns_rdata_t *rdata) {
-	unsigned char *raw = rdataset->private5; /* RDATASLAB */
-	unsigned int length;
-	isc_region_t r;
-	unsigned int flags = 0;
-
-	REQUIRE(raw != NULL);
-
-	/*
-	 * Find the start of the record if not already in private5
-	 * then skip the length and order fields.
-	 */
-#if DNS_RDATASET_FIXED
-	if ((rdataset->attributes & DNS_RDATASETATTR_LOADORDER) != 0) {
-		unsigned int offset;
-		offset = ((unsigned int)raw[0] << 24) +
-			 ((unsigned int)raw[1] << 16) +
-			 ((unsigned int)raw[2] << 8) + (unsigned int)raw[3];
-		raw = rdataset->private3;
-		raw += offset;
-	}
-#endif /* if DNS_RDATASET_FIXED */
-
-	length = raw[0] * 256 + raw[1];
-
-	raw += DNS_RDATASET_ORDER + DNS_RDATASET_LENGTH;
-
-	if (rdataset->type == dns_rdatatype_rrsig) {
-		if (*raw & DNS_RDATASLAB_OFFLINE) {
-			flags |= DNS_RDATA_OFFLINE;
-		}
-		length--;
-		raw++;
-	}
-	r.length = length;
-	r.base = raw;
-	dns_rdata_fromregion(rdata, rdataset->rdclass, rdataset->type, &r);
-	rdata->flags |= flags;
-}
-
-static void
-rdataset_clone(dns_rdataset_t *source, dns_rdataset_t *target) {
-	dns_db_t *db = source->private1;
-	dns_dbnode_t *node = source->private2;
-	dns_dbnode_t *cloned_node = NULL;
-
-	attachnode(db, node, &cloned_node);
-	INSIST(!ISC_LINK_LINKED(target, link));
-	*target = *source;
-	ISC_LINK_INIT(target, link);
-
-	/*
-	 * Reset iterator state.
-	 */
-	target->privateuint4 = 0;
-	target->private5 = NULL;
-}
-
-static unsigned int
-rdataset_count(dns_rdataset_t *rdataset) {
-	unsigned char *raw = rdataset->private3; /* RDATASLAB */
-	unsigned int count;
-
-	count = raw[0] * 256 + raw[1];
-
-	return (count);
-}
-
 static isc_result_t
 rdataset_getnoqname(dns_rdataset_t *rdataset, dns_name_t *name,
 		    dns_rdataset_t *nsec, dns_rdataset_t *nsecsig) {
@@ -9817,17 +10441,17 @@ glue_nsdname_cb(void *arg, const dns_name_t *name, dns_rdatatype_t qtype,
 	result = ISC_R_SUCCESS;
 
 	if (dns_rdataset_isassociated(&rdataset_a)) {
-		rdataset_disassociate(&rdataset_a);
+		dns__rdataslab_disassociate(&rdataset_a);
 	}
 	if (dns_rdataset_isassociated(&sigrdataset_a)) {
-		rdataset_disassociate(&sigrdataset_a);
+		dns__rdataslab_disassociate(&sigrdataset_a);
 	}
 
 	if (dns_rdataset_isassociated(&rdataset_aaaa)) {
-		rdataset_disassociate(&rdataset_aaaa);
+		dns__rdataslab_disassociate(&rdataset_aaaa);
 	}
 	if (dns_rdataset_isassociated(&sigrdataset_aaaa)) {
-		rdataset_disassociate(&sigrdataset_aaaa);
+		dns__rdataslab_disassociate(&sigrdataset_aaaa);
 	}
 
 	if (node_a != NULL) {
@@ -10076,95 +10700,64 @@ no_glue:
 }
 
 /*%
- * Routines for LRU-based cache management.
+ * Routines for SIEVE-based cache management.
+ *
+ * New entries are added to the head of the list of their bucket.  Using an
+ * entry only sets its VISITED bit, which needs no more than the read lock
+ * that is held anyway.  When the cache is over its memory limit, a "hand"
+ * moves from the tail of each list towards the head, clearing the VISITED
+ * bit of the entries it passes, and evicts the first one it finds without
+ * it; when it reaches the head, it starts over from the tail.  An entry
+ * that has been used since the hand last passed it thus survives for
+ * another round, however long it has been in the cache.
  */
 
 /*%
- * See if a given cache entry that is being reused needs to be updated
- * in the LRU-list.  From the LRU management point of view, this function is
- * expected to return true for almost all cases.  When used with threads,
- * however, this may cause a non-negligible performance penalty because a
- * writer lock will have to be acquired before updating the list.
- * If DNS_RBTDB_LIMITLRUUPDATE is defined to be non 0 at compilation time, this
- * function returns true if the entry has not been updated for some period of
- * time.  We differentiate the NS or glue address case and the others since
- * experiments have shown that the former tends to be accessed relatively
- * infrequently and the cost of cache miss is higher (e.g., a missing NS records
- * may cause external queries at a higher level zone, involving more
- * transactions).
+ * Mark a given cache entry as used.
  *
  * Caller must hold the node (read or write) lock.
  */
-static bool
-need_headerupdate(rdatasetheader_t *header, isc_stdtime_t now) {
-	if (RDATASET_ATTR_GET(header, (RDATASET_ATTR_NONEXISTENT |
-				       RDATASET_ATTR_ANCIENT |
-				       RDATASET_ATTR_ZEROTTL)) != 0)
-	{
-		return (false);
-	}
-
-#if DNS_RBTDB_LIMITLRUUPDATE
-	if (header->type == dns_rdatatype_ns ||
-	    (header->trust == dns_trust_glue &&
-	     (header->type == dns_rdatatype_a ||
-	      header->type == dns_rdatatype_aaaa)))
-	{
-		/*
-		 * Glue records are updated if at least DNS_RBTDB_LRUUPDATE_GLUE
-		 * seconds have passed since the previous update time.
-		 */
-		return (header->last_used + DNS_RBTDB_LRUUPDATE_GLUE <= now);
-	}
-
+static void
+mark_header_visited(rdatasetheader_t *header) {
 	/*
-	 * Other records are updated if DNS_RBTDB_LRUUPDATE_REGULAR seconds
-	 * have passed.
+	 * Don't write the shared cache line if the bit is already set, as
+	 * it is for most entries that are looked up often.
 	 */
-	return (header->last_used + DNS_RBTDB_LRUUPDATE_REGULAR <= now);
-#else
-	UNUSED(now);
-
-	return (true);
-#endif /* if DNS_RBTDB_LIMITLRUUPDATE */
+	if (RDATASET_ATTR_GET(header, RDATASET_ATTR_VISITED) == 0) {
+		RDATASET_ATTR_SET(header, RDATASET_ATTR_VISITED);
+	}
 }
 
 /*%
- * Update the timestamp of a given cache entry and move it to the head
- * of the corresponding LRU list.
+ * Remove a given cache entry from the list of its bucket, moving the hand
+ * past it if it points at it.
  *
  * Caller must hold the node (write) lock.
- *
- * Note that the we do NOT touch the heap here, as the TTL has not changed.
  */
 static void
-update_header(dns_rbtdb_t *rbtdb, rdatasetheader_t *header, isc_stdtime_t now) {
-	INSIST(IS_CACHE(rbtdb));
-
-	/* To be checked: can we really assume this? XXXMLG */
-	INSIST(ISC_LINK_LINKED(header, link));
-
-	ISC_LIST_UNLINK(rbtdb->rdatasets[header->node->locknum], header, link);
-	header->last_used = now;
-	ISC_LIST_PREPEND(rbtdb->rdatasets[header->node->locknum], header, link);
+sieve_unlink(dns_rbtdb_t *rbtdb, unsigned int idx, rdatasetheader_t *header) {
+	if (rbtdb->sieve_hands[idx] == header) {
+		rbtdb->sieve_hands[idx] = ISC_LIST_PREV(header, link);
+	}
+	ISC_LIST_UNLINK(rbtdb->rdatasets[idx], header, link);
 }
 
 /*%
- * Purge some expired and/or stale (i.e. unused for some period) cache entries
- * under an overmem condition.  To recover from this condition quickly, up to
- * 2 entries will be purged.  This process is triggered while adding a new
- * entry, and we specifically avoid purging entries in the same LRU bucket as
- * the one to which the new entry will belong.  Otherwise, we might purge
- * entries of the same name of different RR types while adding RRsets from a
- * single response (consider the case where we're adding A and AAAA glue records
- * of the same NS name).
+ * Purge some expired and/or unused cache entries under an overmem
+ * condition.  To recover from this condition quickly, up to 2 entries will
+ * be purged.  This process is triggered while adding a new entry, and we
+ * specifically avoid purging entries in the same bucket as the one to which
+ * the new entry will belong.  Otherwise, we might purge entries of the same
+ * name of different RR types while adding RRsets from a single response
+ * (consider the case where we're adding A and AAAA glue records of the same
+ * NS name).
  */
 static void
 overmem_purge(dns_rbtdb_t *rbtdb, unsigned int locknum_start, isc_stdtime_t now,
 	      isc_rwlocktype_t *tlocktypep) {
-	rdatasetheader_t *header, *header_prev;
+	rdatasetheader_t *header;
 	unsigned int locknum;
-	int purgecount = 2;
+	unsigned int purgecount = 2;
 
 	for (locknum = (locknum_start + 1) % rbtdb->node_lock_count;
 	     locknum != locknum_start && purgecount > 0;
@@ -10173,31 +10766,291 @@ overmem_purge(dns_rbtdb_t *rbtdb, unsigned int locknum_start, isc_stdtime_t now,
 		isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
 		NODE_WRLOCK(&rbtdb->node_locks[locknum].lock, &nlocktype);
 
-		header = isc_heap_element(rbtdb->heaps[locknum], 1);
-		if (header && header->rdh_ttl < now - RBTDB_VIRTUAL) {
+		header = ttl_due(rbtdb, locknum, now);
+		if (header != NULL && header->rdh_ttl < now - RBTDB_VIRTUAL) {
 			expire_header(rbtdb, header, tlocktypep, expire_ttl);
 			purgecount--;
 		}
 
-		for (header = ISC_LIST_TAIL(rbtdb->rdatasets[locknum]);
-		     header != NULL && purgecount > 0; header = header_prev)
+		purgecount -= sieve_purge(rbtdb, locknum, purgecount,
+					  tlocktypep);
+
+		NODE_UNLOCK(&rbtdb->node_locks[locknum].lock, &nlocktype);
+	}
+}
+
+/*%
+ * Move the hand of bucket 'locknum' over up to DNS_RBTDB_SIEVE_SCAN_MAX
+ * entries, evicting at most 'purgecount' of them.  Returns the number of
+ * evicted entries.
+ *
+ * Caller must hold the node (write) lock of the bucket.
+ */
+static unsigned int
+sieve_purge(dns_rbtdb_t *rbtdb, unsigned int locknum, unsigned int purgecount,
+	    isc_rwlocktype_t *tlocktypep) {
+	rdatasetheader_t *header;
+	unsigned int purged = 0;
+
+	for (unsigned int n = 0;
+	     n < DNS_RBTDB_SIEVE_SCAN_MAX && purged < purgecount; n++)
+	{
+		header = rbtdb->sieve_hands[locknum];
+		if (header == NULL) {
+			header = ISC_LIST_TAIL(rbtdb->rdatasets[locknum]);
+			if (header == NULL) {
+				break;
+			}
+		}
+
+		/*
+		 * Move the hand first: expiring the header may free other
+		 * headers of the node, and with them the one the hand would
+		 * move to, but freeing a header moves the hand past it.
+		 */
+		rbtdb->sieve_hands[locknum] = ISC_LIST_PREV(header, link);
+
+		if (RDATASET_ATTR_GET(header, RDATASET_ATTR_VISITED) != 0) {
+			RDATASET_ATTR_CLR(header, RDATASET_ATTR_VISITED);
+			continue;
+		}
+
+		/*
+		 * Unlink the entry at this point to avoid checking it again
+		 * even if it's currently used someone else and cannot be
+		 * purged at this moment.  This entry won't be referenced any
+		 * more (so unlinking is safe) since the TTL was reset to 0.
+		 */
+		ISC_LIST_UNLINK(rbtdb->rdatasets[locknum], header, link);
+		expire_header(rbtdb, header, tlocktypep, expire_lru);
+		purged++;
+	}
+
+	return (purged);
+}
+
+/*%
+ * Expire up to 'maxcount' entries of bucket 'locknum' whose TTL (and
+ * serve-stale period) ended before 'now'.  Returns the number of expired
+ * entries.
+ *
+ * Caller must hold the node (write) lock of the bucket.
+ */
+static unsigned int
+expire_ttl_headers(dns_rbtdb_t *rbtdb, unsigned int locknum, isc_stdtime_t now,
+		   unsigned int maxcount, isc_rwlocktype_t *tlocktypep) {
+	rdatasetheader_t *header;
+	unsigned int expired = 0;
+
+	for (unsigned int n = 0; n < maxcount; n++) {
+		header = ttl_due(rbtdb, locknum, now);
+		if (header == NULL) {
+			break;
+		}
+
+		/*
+		 * An ancient header is still in use; it will be freed when
+		 * its node is released.  Move it to the back of the queue.
+		 */
+		if (ANCIENT(header)) {
+			isc_wheel_update(rbtdb->wheels[locknum],
+					 header->heap_index, 0);
+			continue;
+		}
+
+		/*
+		 * A header that may still be served stale is put back in the
+		 * wheel until that period is over.
+		 */
+		if (header->rdh_ttl + STALE_TTL(header, rbtdb) >=
+		    now - RBTDB_VIRTUAL)
 		{
-			header_prev = ISC_LIST_PREV(header, link);
-			/*
-			 * Unlink the entry at this point to avoid checking it
-			 * again even if it's currently used someone else and
-			 * cannot be purged at this moment.  This entry won't be
-			 * referenced any more (so unlinking is safe) since the
-			 * TTL was reset to 0.
-			 */
-			ISC_LIST_UNLINK(rbtdb->rdatasets[locknum], header,
-					link);
-			expire_header(rbtdb, header, tlocktypep, expire_lru);
-			purgecount--;
+			isc_wheel_update(rbtdb->wheels[locknum],
+					 header->heap_index,
+					 header->rdh_ttl +
+						 STALE_TTL(header, rbtdb) + 1);
+			continue;
+		}
+
+		expire_header(rbtdb, header, tlocktypep, expire_ttl);
+		expired++;
+	}
+
+	return (expired);
+}
+
+/*%
+ * Routines for the background cache cleaner.
+ *
+ * Instead of having the threads that add data to the cache purge other
+ * entries when the cache is over its memory limit, or expire entries whose
+ * TTL has passed, the cleaner does this in sweeps over the buckets on a
+ * worker thread.  It is started when the cache goes over its memory limit,
+ * or when an expired entry is noticed, and keeps sweeping until a whole
+ * round over the buckets finds nothing more to do.  Each sweep yields after
+ * DNS_RBTDB_CLEANER_BUDGET microseconds, and the next one resumes from the
+ * bucket it stopped at.
+ */
+
+static bool
+cleaner_due(dns_rbtdb_t *rbtdb, unsigned int locknum, isc_stdtime_t now) {
+	isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
+	bool due;
+
+	NODE_RDLOCK(&rbtdb->node_locks[locknum].lock, &nlocktype);
+	due = isc_wheel_pending(rbtdb->wheels[locknum], now - RBTDB_VIRTUAL) ||
+	      !ISC_LIST_EMPTY(rbtdb->deadnodes[locknum]);
+	NODE_UNLOCK(&rbtdb->node_locks[locknum].lock, &nlocktype);
+
+	return (due);
+}
+
+static void
+cleaner_sweep(void *arg) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)arg;
+	bool overmem = isc_mem_isovermem(rbtdb->common.mctx);
+	unsigned int purged = 0;
+	isc_time_t start, finish;
+	isc_stdtime_t now;
+	uint64_t usecs = 0;
+
+	isc_stdtime_get(&now);
+	isc_time_now_hires(&start);
+
+	rbtdb->cleaner_more = false;
+	for (unsigned int n = 0; n < rbtdb->node_lock_count; n++) {
+		unsigned int locknum = rbtdb->cleaner_bucket;
+		isc_rwlocktype_t tlocktype = isc_rwlocktype_none;
+		isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
+		unsigned int count;
+
+		rbtdb->cleaner_bucket = (locknum + 1) % rbtdb->node_lock_count;
+
+		/*
+		 * Unless the cache is over its memory limit, a bucket with
+		 * nothing due and no dead nodes only needs a read lock to
+		 * tell that there is nothing to do.
+		 */
+		if (!overmem && !cleaner_due(rbtdb, locknum, now)) {
+			continue;
+		}
+
+		TREE_WRLOCK(&rbtdb->tree_lock, &tlocktype);
+		NODE_WRLOCK(&rbtdb->node_locks[locknum].lock, &nlocktype);
+
+		count = expire_ttl_headers(rbtdb, locknum, now,
+					   DNS_RBTDB_SIEVE_SCAN_MAX,
+					   &tlocktype);
+		if (count == DNS_RBTDB_SIEVE_SCAN_MAX) {
+			rbtdb->cleaner_more = true;
 		}
 
+		if (overmem) {
+			purged += sieve_purge(rbtdb, locknum,
+					      DNS_RBTDB_SIEVE_SCAN_MAX,
+					      &tlocktype);
+		}
+
+		cleanup_dead_nodes(rbtdb, locknum);
+
 		NODE_UNLOCK(&rbtdb->node_locks[locknum].lock, &nlocktype);
+		TREE_UNLOCK(&rbtdb->tree_lock, &tlocktype);
+
+		isc_time_now_hires(&finish);
+		usecs = isc_time_microdiff(&finish, &start);
+		if (usecs > DNS_RBTDB_CLEANER_BUDGET &&
+		    n + 1 < rbtdb->node_lock_count)
+		{
+			rbtdb->cleaner_more = true;
+			if (rbtdb->cachestats != NULL) {
+				isc_stats_increment(
+					rbtdb->cachestats,
+					dns_cachestatscounter_cleaneryields);
+			}
+			break;
+		}
+	}
+
+	/*
+	 * Stop if nothing could be evicted; adding to the cache while it
+	 * is still over the limit will start the cleaner again.
+	 */
+	if (overmem && purged > 0 && isc_mem_isovermem(rbtdb->common.mctx)) {
+		rbtdb->cleaner_more = true;
+	}
+
+	if (rbtdb->cachestats != NULL) {
+		isc_stats_increment(rbtdb->cachestats,
+				    dns_cachestatscounter_cleanersweeps);
+		isc_stats_update_if_greater(rbtdb->cachestats,
+					    dns_cachestatscounter_cleanermaxtime,
+					    (isc_statscounter_t)usecs);
+	}
+}
+
+static void
+cleaner_sweep_done(void *arg) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)arg;
+	dns_db_t *db = (dns_db_t *)rbtdb;
+
+	/*
+	 * Carry on unless the cleaner holds the last reference to the
+	 * database.
+	 */
+	if (rbtdb->cleaner_more &&
+	    isc_refcount_current(&rbtdb->references) > 1)
+	{
+		isc_work_enqueue(rbtdb->cleaner_loop, cleaner_sweep,
+				 cleaner_sweep_done, rbtdb);
+		return;
 	}
+
+	isc_loop_detach(&rbtdb->cleaner_loop);
+	atomic_store(&rbtdb->cleaning, false);
+	detach(&db);
+}
+
+static void
+cleaner_enqueue(void *arg) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)arg;
+
+	isc_work_enqueue(rbtdb->cleaner_loop, cleaner_sweep,
+			 cleaner_sweep_done, rbtdb);
+}
+
+/*%
+ * Start the background cleaner of a cache database unless it is running,
+ * or there is no loop to run it on.  May be called from any thread.
+ */
+static void
+cleaner_start(dns_rbtdb_t *rbtdb) {
+	isc_loop_t *loop = NULL;
+	dns_db_t *db = NULL;
+
+	INSIST(IS_CACHE(rbtdb));
+
+	if (atomic_load_relaxed(&rbtdb->cleaning) ||
+	    !atomic_compare_exchange_strong(&rbtdb->cleaning, &(bool){ false },
+					    true))
+	{
+		return;
+	}
+
+	RBTDB_LOCK(&rbtdb->lock, isc_rwlocktype_read);
+	if (rbtdb->loop != NULL) {
+		isc_loop_attach(rbtdb->loop, &loop);
+	}
+	RBTDB_UNLOCK(&rbtdb->lock, isc_rwlocktype_read);
+
+	if (loop == NULL) {
+		atomic_store(&rbtdb->cleaning, false);
+		return;
+	}
+
+	/* The work has to be queued from the thread of the loop */
+	attach((dns_db_t *)rbtdb, &db);
+	rbtdb->cleaner_loop = loop;
+	isc_async_run(loop, cleaner_enqueue, rbtdb);
 }
 
 static void
@@ -46,4 +46,18 @@ dns_rbtdb_create(isc_mem_t *mctx, const dns_name_t *base, dns_dbtype_t type,
  * \li argc == 0 or argv[0] is a valid memory context.
  */
 
+void
+dns__rbtdb_setshard(dns_db_t *db, uint8_t shard, dns_stats_t *rrsetstats);
+/*%<
+ * Make the cache database 'db' shard number 'shard' of a sharded cache:
+ * its nodes are tagged with 'shard' (see dns_rbt_setshard()), and the
+ * rdatasets it holds are counted in 'rrsetstats', which is shared by all
+ * the shards, instead of in statistics of its own.
+ *
+ * Requires:
+ *
+ * \li 'db' is a valid, empty cache database.
+ * \li 'rrsetstats' is a valid rdataset statistics set.
+ */
+
 ISC_LANG_ENDDECLS
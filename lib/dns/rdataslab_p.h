@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file */
+
+#include <isc/result.h>
+
+#include <dns/types.h>
+
+/*%
+ * Rdataset methods for rdatasets bound to a slab that is owned by a
+ * database node, shared by the rbtdb and qpdb implementations.
+ *
+ * The rdataset fields are used as follows:
+ *
+ *\li	private1 is the database and private2 the node; a reference to
+ *	the node is held for as long as the rdataset is associated.
+ *
+ *\li	private3 points to the slab, past its header.
+ *
+ *\li	privateuint4 and private5 hold the iterator state.
+ */
+
+ISC_LANG_BEGINDECLS
+
+void
+dns__rdataslab_disassociate(dns_rdataset_t *rdataset);
+
+isc_result_t
+dns__rdataslab_first(dns_rdataset_t *rdataset);
+
+isc_result_t
+dns__rdataslab_next(dns_rdataset_t *rdataset);
+
+void
+dns__rdataslab_current(dns_rdataset_t *rdataset, dns_rdata_t *rdata);
+
+void
+dns__rdataslab_clone(dns_rdataset_t *source, dns_rdataset_t *target);
+
+unsigned int
+dns__rdataslab_count(dns_rdataset_t *rdataset);
+
+ISC_LANG_ENDDECLS
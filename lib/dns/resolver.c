@@ -177,6 +177,13 @@
 #define MAX_SINGLE_QUERY_TIMEOUT    9000U
 #define MAX_SINGLE_QUERY_TIMEOUT_US (MAX_SINGLE_QUERY_TIMEOUT * US_PER_MS)
 
+/*
+ * When query racing is enabled, a query that hasn't been answered
+ * within twice the server's smoothed RTT, but not sooner than
+ * RACE_MIN_US, is raced against the next best server.
+ */
+#define RACE_MIN_US (20 * US_PER_MS)
+
 /*
  * We need to allow a individual query time to complete / timeout.
  */
@@ -226,6 +233,21 @@ STATIC_ASSERT(NS_PROCESSING_LIMIT > NS_RR_LIMIT,
 #define RES_DOMAIN_HASH_BITS 12
 #endif /* ifndef RES_DOMAIN_HASH_BITS */
 
+/*
+ * The fetch context and zone counter tables are split into
+ * 2^RES_HASH_BUCKET_BITS independently locked buckets, so that
+ * fetches for unrelated names don't serialize on a single mutex.
+ * The total initial capacity is still 2^RES_DOMAIN_HASH_BITS.
+ */
+#ifndef RES_HASH_BUCKET_BITS
+#define RES_HASH_BUCKET_BITS 4
+#endif /* ifndef RES_HASH_BUCKET_BITS */
+#define RES_HASH_BUCKETS (1 << RES_HASH_BUCKET_BITS)
+
+STATIC_ASSERT(RES_DOMAIN_HASH_BITS > RES_HASH_BUCKET_BITS,
+	      "RES_HASH_BUCKET_BITS must be smaller than "
+	      "RES_DOMAIN_HASH_BITS");
+
 /*%
  * Maximum EDNS0 input packet size.
  */
@@ -289,9 +311,11 @@ struct tried {
 #define VALID_QUERY(query) ISC_MAGIC_VALID(query, QUERY_MAGIC)
 
 #define RESQUERY_ATTR_CANCELED 0x02
+#define RESQUERY_ATTR_RACE     0x04
 
 #define RESQUERY_CONNECTING(q) ((q)->connects > 0)
 #define RESQUERY_CANCELED(q)   (((q)->attributes & RESQUERY_ATTR_CANCELED) != 0)
+#define RESQUERY_RACE(q)       (((q)->attributes & RESQUERY_ATTR_RACE) != 0)
 #define RESQUERY_SENDING(q)    ((q)->sends > 0)
 
 typedef enum {
@@ -330,6 +354,11 @@ struct fctxcount {
 	atomic_uint_fast32_t logged;
 };
 
+typedef struct resbucket {
+	isc_mutex_t lock;
+	isc_hashmap_t *table;
+} resbucket_t;
+
 struct fetchctx {
 	/*% Not locked. */
 	unsigned int magic;
@@ -366,6 +395,7 @@ struct fetchctx {
 	atomic_uint_fast32_t attributes;
 	isc_loop_t *loop;
 	isc_timer_t *timer;
+	isc_timer_t *racetimer;
 	isc_time_t expires;
 	isc_time_t expires_try_stale;
 	isc_time_t next_timeout;
@@ -432,6 +462,11 @@ struct fetchctx {
 	 */
 	unsigned int timeouts;
 
+	/*%
+	 * The number of queries raced against a slow server.
+	 */
+	unsigned int races;
+
 	/*%
 	 * Look aside state for DS lookups.
 	 */
@@ -555,11 +590,8 @@ struct dns_resolver {
 	isc_dscp_t querydscp4;
 	isc_dscp_t querydscp6;
 
-	isc_hashmap_t *fctxs;
-	isc_mutex_t fctxs_lock;
-
-	isc_hashmap_t *counters;
-	isc_mutex_t counters_lock;
+	resbucket_t fctxs[RES_HASH_BUCKETS];
+	resbucket_t counters[RES_HASH_BUCKETS];
 
 	unsigned int ntasks;
 	isc_task_t **tasks;
@@ -584,6 +616,8 @@ struct dns_resolver {
 	unsigned int retryinterval; /* in milliseconds */
 	unsigned int nonbackofftries;
 
+	unsigned int maxraces; /* per fetch, 0 disables racing */
+
 	/* Atomic */
 	isc_refcount_t references;
 	atomic_uint_fast32_t zspill; /* fetches-per-zone */
@@ -655,6 +689,8 @@ resquery_connected(isc_result_t eresult, isc_region_t *region, void *arg);
 static void
 fctx_try(fetchctx_t *fctx, bool retrying, bool badcache);
 static void
+fctx_startrace(fetchctx_t *fctx, resquery_t *query);
+static void
 fctx_shutdown(fetchctx_t *fctx);
 static isc_result_t
 fctx_minimize_qname(fetchctx_t *fctx);
@@ -1329,6 +1365,14 @@ fctx_cancelquery(resquery_t **queryp, isc_time_t *finish, bool no_response,
 
 	query->attributes |= RESQUERY_ATTR_CANCELED;
 
+	/*
+	 * Whatever happened to the query, it doesn't need to be raced
+	 * anymore.
+	 */
+	if (fctx->racetimer != NULL) {
+		isc_timer_stop(fctx->racetimer);
+	}
+
 	/*
 	 * Should we update the RTT?
 	 */
@@ -1580,6 +1624,41 @@ fctx_cancelqueries(fetchctx_t *fctx, bool no_response, bool age_untried) {
 	}
 }
 
+static void
+res_buckets_init(isc_mem_t *mctx, unsigned int options,
+		 resbucket_t *buckets) {
+	for (size_t i = 0; i < RES_HASH_BUCKETS; i++) {
+		isc_mutex_init(&buckets[i].lock);
+		isc_hashmap_create(mctx,
+				   RES_DOMAIN_HASH_BITS - RES_HASH_BUCKET_BITS,
+				   options, &buckets[i].table);
+	}
+}
+
+static void
+res_buckets_destroy(resbucket_t *buckets) {
+	for (size_t i = 0; i < RES_HASH_BUCKETS; i++) {
+		INSIST(isc_hashmap_count(buckets[i].table) == 0);
+		isc_hashmap_destroy(&buckets[i].table);
+		isc_mutex_destroy(&buckets[i].lock);
+	}
+}
+
+/*
+ * Every bucket has its own hash key, so the hash value is always
+ * computed with the first bucket's table and passed explicitly to
+ * the bucket the value selects.
+ */
+static uint32_t
+res_hash(resbucket_t *buckets, const void *key, uint32_t keysize) {
+	return (isc_hashmap_hash(buckets[0].table, key, keysize));
+}
+
+static resbucket_t *
+res_bucket(resbucket_t *buckets, uint32_t hashval) {
+	return (&buckets[hashval & (RES_HASH_BUCKETS - 1)]);
+}
+
 static void
 fcount_logspill(fetchctx_t *fctx, fctxcount_t *counter, bool final) {
 	char dbuf[DNS_NAME_FORMATSIZE];
@@ -1633,6 +1712,7 @@ fcount_incr(fetchctx_t *fctx, bool force) {
 	isc_result_t result = ISC_R_SUCCESS;
 	dns_resolver_t *res = NULL;
 	fctxcount_t *counter = NULL;
+	resbucket_t *bucket = NULL;
 	uint32_t hashval;
 	uint_fast32_t count;
 	uint_fast32_t spill;
@@ -1642,11 +1722,12 @@ fcount_incr(fetchctx_t *fctx, bool force) {
 	REQUIRE(res != NULL);
 	INSIST(fctx->counter == NULL);
 
-	hashval = isc_hashmap_hash(res->counters, fctx->domain->ndata,
-				   fctx->domain->length);
+	hashval = res_hash(res->counters, fctx->domain->ndata,
+			   fctx->domain->length);
+	bucket = res_bucket(res->counters, hashval);
 
-	LOCK(&res->counters_lock);
-	result = isc_hashmap_find(res->counters, &hashval, fctx->domain->ndata,
+	LOCK(&bucket->lock);
+	result = isc_hashmap_find(bucket->table, &hashval, fctx->domain->ndata,
 				  fctx->domain->length, (void **)&counter);
 	switch (result) {
 	case ISC_R_SUCCESS:
@@ -1660,7 +1741,7 @@ fcount_incr(fetchctx_t *fctx, bool force) {
 		counter->domain = dns_fixedname_initname(&counter->dfname);
 		dns_name_copy(fctx->domain, counter->domain);
 
-		result = isc_hashmap_add(res->counters, &hashval,
+		result = isc_hashmap_add(bucket->table, &hashval,
 					 counter->domain->ndata,
 					 counter->domain->length, counter);
 		INSIST(result == ISC_R_SUCCESS);
@@ -1669,7 +1750,7 @@ fcount_incr(fetchctx_t *fctx, bool force) {
 		UNREACHABLE();
 	}
 	count = atomic_fetch_add_relaxed(&counter->count, 1) + 1;
-	UNLOCK(&res->counters_lock);
+	UNLOCK(&bucket->lock);
 
 	spill = atomic_load_acquire(&res->zspill);
 	if (!force && spill != 0 && count > spill) {
@@ -1698,21 +1779,26 @@ fcount_decr(fetchctx_t *fctx) {
 
 	uint_fast32_t count = atomic_fetch_sub_release(&counter->count, 1) - 1;
 	if (count == 0) {
-		LOCK(&fctx->res->counters_lock);
+		uint32_t hashval = res_hash(fctx->res->counters,
+					    counter->domain->ndata,
+					    counter->domain->length);
+		resbucket_t *bucket = res_bucket(fctx->res->counters, hashval);
+
+		LOCK(&bucket->lock);
 		if (atomic_load_acquire(&counter->count) > 0) {
 			/* Other thread reacquired the counter */
 			goto unlock;
 		}
 
 		isc_result_t result = isc_hashmap_delete(
-			fctx->res->counters, NULL, counter->domain->ndata,
+			bucket->table, &hashval, counter->domain->ndata,
 			counter->domain->length);
 		INSIST(result == ISC_R_SUCCESS);
 
 		fcount_logspill(fctx, counter, true);
 		isc_mem_put(fctx->mctx, counter, sizeof(*counter));
 	unlock:
-		UNLOCK(&fctx->res->counters_lock);
+		UNLOCK(&bucket->lock);
 	}
 }
 
@@ -1917,6 +2003,9 @@ fctx__done(fetchctx_t *fctx, isc_result_t result, const char *func,
 	fctx_cleanup(fctx);
 
 	isc_timer_destroy(&fctx->timer);
+	if (fctx->racetimer != NULL) {
+		isc_timer_destroy(&fctx->racetimer);
+	}
 
 	return (true);
 }
@@ -2345,6 +2434,8 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 
 	RUNTIME_CHECK(result == ISC_R_SUCCESS);
 
+	fctx_startrace(fctx, query);
+
 	return (result);
 
 cleanup_udpfetch:
@@ -4291,6 +4382,112 @@ done:
 	}
 }
 
+/*
+ * Race timer callback: the only query of the fetch hasn't been answered
+ * yet, send the same query to the next best server as well.  The first
+ * usable response wins, and the other query is canceled when the fetch
+ * finishes.  The raced queries count against the max-recursion-queries
+ * limit, like any other query.
+ */
+static void
+fctx_race(void *arg) {
+	fetchctx_t *fctx = (fetchctx_t *)arg;
+	dns_adbaddrinfo_t *addrinfo = NULL;
+	resquery_t *query = NULL;
+	isc_result_t result;
+	bool idle;
+
+	REQUIRE(VALID_FCTX(fctx));
+	REQUIRE(fctx->tid == isc_tid());
+
+	LOCK(&fctx->lock);
+	idle = SHUTTINGDOWN(fctx) || ISC_LIST_EMPTY(fctx->queries) ||
+	       ISC_LIST_EMPTY(fctx->events);
+	UNLOCK(&fctx->lock);
+
+	if (idle || fctx->minimized || fctx->forwarding ||
+	    !ISC_LIST_EMPTY(fctx->validators) ||
+	    isc_counter_used(fctx->qc) >= fctx->res->maxqueries)
+	{
+		return;
+	}
+
+	addrinfo = fctx_nextaddress(fctx);
+	while (addrinfo != NULL && dns_adbentry_overquota(addrinfo->entry)) {
+		addrinfo = fctx_nextaddress(fctx);
+	}
+	if (addrinfo == NULL) {
+		return;
+	}
+
+	result = isc_counter_increment(fctx->qc);
+	if (result != ISC_R_SUCCESS) {
+		return;
+	}
+
+	FCTXTRACE("race");
+
+	/*
+	 * If the query can't be sent, keep waiting for the one that's
+	 * already running.
+	 */
+	result = fctx_query(fctx, addrinfo, fctx->options);
+	if (result != ISC_R_SUCCESS) {
+		return;
+	}
+
+	LOCK(&fctx->lock);
+	query = ISC_LIST_TAIL(fctx->queries);
+	INSIST(query->addrinfo == addrinfo);
+	query->attributes |= RESQUERY_ATTR_RACE;
+	UNLOCK(&fctx->lock);
+
+	fctx->races++;
+	inc_stats(fctx->res, dns_resstatscounter_racesent);
+}
+
+/*
+ * Start the race timer for 'query' if racing is enabled and 'query' is
+ * the only query of the fetch.  The timer fires when the server takes
+ * twice as long as its smoothed RTT, unless the query would time out
+ * before that anyway.
+ */
+static void
+fctx_startrace(fetchctx_t *fctx, resquery_t *query) {
+	isc_interval_t interval;
+	uint64_t us;
+	bool alone;
+
+	if (fctx->races >= fctx->res->maxraces || fctx->forwarding ||
+	    ISFORWARDER(query->addrinfo) ||
+	    (query->options & DNS_FETCHOPT_TCP) != 0)
+	{
+		return;
+	}
+
+	LOCK(&fctx->lock);
+	alone = (ISC_LIST_HEAD(fctx->queries) == query &&
+		 ISC_LIST_TAIL(fctx->queries) == query);
+	UNLOCK(&fctx->lock);
+	if (!alone) {
+		return;
+	}
+
+	us = ISC_MAX(2 * (uint64_t)query->addrinfo->srtt, RACE_MIN_US);
+	if (us >= (uint64_t)isc_interval_ms(&fctx->interval) * US_PER_MS) {
+		return;
+	}
+
+	if (fctx->racetimer == NULL) {
+		isc_timer_create(fctx->loop, fctx_race, fctx,
+				 &fctx->racetimer);
+	}
+
+	isc_interval_set(&interval, us / US_PER_SEC,
+			 (us % US_PER_SEC) * NS_PER_US);
+	isc_timer_start(fctx->racetimer, isc_timertype_once, &interval);
+}
+
 static void
 resume_qmin(isc_task_t *task, isc_event_t *event) {
 	dns_fetchevent_t *fevent = NULL;
@@ -7190,19 +7387,19 @@ static void
 release_fctx(fetchctx_t *fctx) {
 	isc_result_t result;
 	dns_resolver_t *res = fctx->res;
-	uint32_t hashval = isc_hashmap_hash(res->fctxs, fctx->key.key,
-					    fctx->key.size);
+	uint32_t hashval = res_hash(res->fctxs, fctx->key.key, fctx->key.size);
+	resbucket_t *bucket = res_bucket(res->fctxs, hashval);
 
 	if (!fctx->hashed) {
 		return;
 	}
 
-	LOCK(&res->fctxs_lock);
-	result = isc_hashmap_delete(res->fctxs, &hashval, fctx->key.key,
+	LOCK(&bucket->lock);
+	result = isc_hashmap_delete(bucket->table, &hashval, fctx->key.key,
 				    fctx->key.size);
 	INSIST(result == ISC_R_SUCCESS);
 	fctx->hashed = false;
-	UNLOCK(&res->fctxs_lock);
+	UNLOCK(&bucket->lock);
 }
 
 static void
@@ -9620,6 +9817,19 @@ rctx_nextserver(respctx_t *rctx, dns_message_t *message,
 		fctx_cancelqueries(fctx, true, false);
 		fctx_cleanup(fctx);
 		retrying = false;
+	} else {
+		bool waiting;
+
+		/*
+		 * A query raced against this one is still outstanding,
+		 * wait for its response before trying another server.
+		 */
+		LOCK(&fctx->lock);
+		waiting = !ISC_LIST_EMPTY(fctx->queries);
+		UNLOCK(&fctx->lock);
+		if (waiting) {
+			return;
+		}
 	}
 
 	/*
@@ -9718,6 +9928,7 @@ rctx_done(respctx_t *rctx, isc_result_t result) {
 	fetchctx_t *fctx = rctx->fctx;
 	dns_adbaddrinfo_t *addrinfo = query->addrinfo;
 	dns_message_t *message = NULL;
+	bool race = RESQUERY_RACE(query);
 
 	/*
 	 * Need to attach to the message until the scope
@@ -9762,6 +9973,16 @@ rctx_done(respctx_t *rctx, isc_result_t result) {
 		rctx->next_server = false;
 		rctx->resend = false;
 	}
+
+	/*
+	 * A raced query whose response is used while the query it was
+	 * racing against is still outstanding has won the race.
+	 */
+	if (race && !ISC_LIST_EMPTY(fctx->queries) && !rctx->resend &&
+	    (!rctx->next_server || rctx->get_nameservers))
+	{
+		inc_stats(fctx->res, dns_resstatscounter_racewon);
+	}
 	UNLOCK(&fctx->lock);
 
 	if (rctx->next_server) {
@@ -10060,13 +10281,8 @@ dns_resolver__destroy(dns_resolver_t *res) {
 	}
 	isc_mem_put(res->mctx, res->tasks, res->ntasks * sizeof(res->tasks[0]));
 
-	INSIST(isc_hashmap_count(res->fctxs) == 0);
-	isc_hashmap_destroy(&res->fctxs);
-	isc_mutex_destroy(&res->fctxs_lock);
-
-	INSIST(isc_hashmap_count(res->counters) == 0);
-	isc_hashmap_destroy(&res->counters);
-	isc_mutex_destroy(&res->counters_lock);
+	res_buckets_destroy(res->fctxs);
+	res_buckets_destroy(res->counters);
 
 	if (res->dispatches4 != NULL) {
 		dns_dispatchset_destroy(&res->dispatches4);
@@ -10194,13 +10410,9 @@ dns_resolver_create(dns_view_t *view, isc_loopmgr_t *loopmgr,
 	}
 
 	/* This needs to be case sensitive to not lowercase options and type */
-	isc_hashmap_create(view->mctx, RES_DOMAIN_HASH_BITS,
-			   ISC_HASHMAP_CASE_SENSITIVE, &res->fctxs);
-	isc_mutex_init(&res->fctxs_lock);
-
-	isc_hashmap_create(view->mctx, RES_DOMAIN_HASH_BITS,
-			   ISC_HASHMAP_CASE_INSENSITIVE, &res->counters);
-	isc_mutex_init(&res->counters_lock);
+	res_buckets_init(view->mctx, ISC_HASHMAP_CASE_SENSITIVE, res->fctxs);
+	res_buckets_init(view->mctx, ISC_HASHMAP_CASE_INSENSITIVE,
+			 res->counters);
 
 	if (dispatchv4 != NULL) {
 		dns_dispatchset_create(res->mctx, dispatchv4, &res->dispatches4,
@@ -10356,27 +10568,30 @@ dns_resolver_shutdown(dns_resolver_t *res) {
 	RTRACE("shutdown");
 
 	if (atomic_compare_exchange_strong(&res->exiting, &is_false, true)) {
-		isc_hashmap_iter_t *it = NULL;
-
 		RTRACE("exiting");
 
-		LOCK(&res->fctxs_lock);
-		isc_hashmap_iter_create(res->fctxs, &it);
-		for (result = isc_hashmap_iter_first(it);
-		     result == ISC_R_SUCCESS;
-		     result = isc_hashmap_iter_next(it))
-		{
-			fetchctx_t *fctx = NULL;
+		for (size_t i = 0; i < RES_HASH_BUCKETS; i++) {
+			resbucket_t *bucket = &res->fctxs[i];
+			isc_hashmap_iter_t *it = NULL;
 
-			isc_hashmap_iter_current(it, (void **)&fctx);
-			INSIST(fctx != NULL);
+			LOCK(&bucket->lock);
+			isc_hashmap_iter_create(bucket->table, &it);
+			for (result = isc_hashmap_iter_first(it);
+			     result == ISC_R_SUCCESS;
+			     result = isc_hashmap_iter_next(it))
+			{
+				fetchctx_t *fctx = NULL;
 
-			fetchctx_ref(fctx);
-			isc_async_run(fctx->loop, (isc_job_cb)fctx_shutdown,
-				      fctx);
+				isc_hashmap_iter_current(it, (void **)&fctx);
+				INSIST(fctx != NULL);
+
+				fetchctx_ref(fctx);
+				isc_async_run(fctx->loop,
+					      (isc_job_cb)fctx_shutdown, fctx);
+			}
+			isc_hashmap_iter_destroy(&it);
+			UNLOCK(&bucket->lock);
 		}
-		isc_hashmap_iter_destroy(&it);
-		UNLOCK(&res->fctxs_lock);
 
 		LOCK(&res->lock);
 		if (res->spillattimer != NULL) {
@@ -10510,6 +10725,7 @@ get_attached_fctx(dns_resolver_t *res, const dns_name_t *name,
 		  fetchctx_t **fctxp, bool *new_fctx) {
 	isc_result_t result;
 	uint32_t hashval;
+	resbucket_t *bucket = NULL;
 	fctxkey_t key = {
 		.size = sizeof(unsigned int) + sizeof(dns_rdatatype_t) +
 			name->length,
@@ -10525,11 +10741,12 @@ get_attached_fctx(dns_resolver_t *res, const dns_name_t *name,
 	key.type = type;
 	isc_ascii_lowercopy(key.name, name->ndata, name->length);
 
-	hashval = isc_hashmap_hash(res->fctxs, key.key, key.size);
+	hashval = res_hash(res->fctxs, key.key, key.size);
+	bucket = res_bucket(res->fctxs, hashval);
 
 again:
-	LOCK(&res->fctxs_lock);
-	result = isc_hashmap_find(res->fctxs, &hashval, key.key, key.size,
+	LOCK(&bucket->lock);
+	result = isc_hashmap_find(bucket->table, &hashval, key.key, key.size,
 				  (void **)&fctx);
 	switch (result) {
 	case ISC_R_SUCCESS:
@@ -10544,8 +10761,8 @@ again:
 
 		*new_fctx = true;
 
-		result = isc_hashmap_add(res->fctxs, &hashval, fctx->key.key,
-					 fctx->key.size, fctx);
+		result = isc_hashmap_add(bucket->table, &hashval,
+					 fctx->key.key, fctx->key.size, fctx);
 
 		fctx->hashed = true;
 
@@ -10556,7 +10773,7 @@ again:
 	}
 	fetchctx_ref(fctx);
 unlock:
-	UNLOCK(&res->fctxs_lock);
+	UNLOCK(&bucket->lock);
 
 	if (result == ISC_R_SUCCESS) {
 		LOCK(&fctx->lock);
@@ -11351,37 +11568,44 @@ void
 dns_resolver_dumpfetches(dns_resolver_t *res, isc_statsformat_t format,
 			 FILE *fp) {
 	isc_result_t result;
-	isc_hashmap_iter_t *it = NULL;
 
 	REQUIRE(VALID_RESOLVER(res));
 	REQUIRE(fp != NULL);
 	REQUIRE(format == isc_statsformat_file);
 
-	LOCK(&res->counters_lock);
-	isc_hashmap_iter_create(res->counters, &it);
-	for (result = isc_hashmap_iter_first(it); result == ISC_R_SUCCESS;
-	     result = isc_hashmap_iter_next(it))
-	{
-		fctxcount_t *counter = NULL;
-		isc_hashmap_iter_current(it, (void **)&counter);
-		uint_fast32_t count = atomic_load_relaxed(&counter->count);
-		uint_fast32_t dropped = atomic_load_relaxed(&counter->dropped);
-		uint_fast32_t allowed = atomic_load_relaxed(&counter->allowed);
+	for (size_t i = 0; i < RES_HASH_BUCKETS; i++) {
+		resbucket_t *bucket = &res->counters[i];
+		isc_hashmap_iter_t *it = NULL;
 
-		dns_name_print(counter->domain, fp);
-		fprintf(fp,
-			": %" PRIuFAST32 " active (%" PRIuFAST32
-			" spilled, %" PRIuFAST32 " allowed)\n",
-			count, dropped, allowed);
+		LOCK(&bucket->lock);
+		isc_hashmap_iter_create(bucket->table, &it);
+		for (result = isc_hashmap_iter_first(it);
+		     result == ISC_R_SUCCESS;
+		     result = isc_hashmap_iter_next(it))
+		{
+			fctxcount_t *counter = NULL;
+			isc_hashmap_iter_current(it, (void **)&counter);
+			uint_fast32_t count =
+				atomic_load_relaxed(&counter->count);
+			uint_fast32_t dropped =
+				atomic_load_relaxed(&counter->dropped);
+			uint_fast32_t allowed =
+				atomic_load_relaxed(&counter->allowed);
+
+			dns_name_print(counter->domain, fp);
+			fprintf(fp,
+				": %" PRIuFAST32 " active (%" PRIuFAST32
+				" spilled, %" PRIuFAST32 " allowed)\n",
+				count, dropped, allowed);
+		}
+		UNLOCK(&bucket->lock);
+		isc_hashmap_iter_destroy(&it);
 	}
-	UNLOCK(&res->counters_lock);
-	isc_hashmap_iter_destroy(&it);
 }
 
 isc_result_t
 dns_resolver_dumpquota(dns_resolver_t *res, isc_buffer_t **buf) {
-	isc_result_t result;
-	isc_hashmap_iter_t *it = NULL;
+	isc_result_t result = ISC_R_SUCCESS;
 	uint_fast32_t spill;
 
 	REQUIRE(VALID_RESOLVER(res));
@@ -11391,43 +11615,54 @@ dns_resolver_dumpquota(dns_resolver_t *res, isc_buffer_t **buf) {
 		return (ISC_R_SUCCESS);
 	}
 
-	LOCK(&res->counters_lock);
-	isc_hashmap_iter_create(res->counters, &it);
-	for (result = isc_hashmap_iter_first(it); result == ISC_R_SUCCESS;
-	     result = isc_hashmap_iter_next(it))
+	for (size_t i = 0; i < RES_HASH_BUCKETS && result == ISC_R_SUCCESS;
+	     i++)
 	{
-		fctxcount_t *counter = NULL;
-		isc_hashmap_iter_current(it, (void **)&counter);
-		char nb[DNS_NAME_FORMATSIZE],
-			text[DNS_NAME_FORMATSIZE + BUFSIZ];
-
-		uint_fast32_t count = atomic_load_relaxed(&counter->count);
-		uint_fast32_t allowed = atomic_load_relaxed(&counter->allowed);
-		uint_fast32_t dropped = atomic_load_relaxed(&counter->dropped);
+		resbucket_t *bucket = &res->counters[i];
+		isc_hashmap_iter_t *it = NULL;
 
-		if (count < spill) {
-			continue;
-		}
+		LOCK(&bucket->lock);
+		isc_hashmap_iter_create(bucket->table, &it);
+		for (result = isc_hashmap_iter_first(it);
+		     result == ISC_R_SUCCESS;
+		     result = isc_hashmap_iter_next(it))
+		{
+			fctxcount_t *counter = NULL;
+			isc_hashmap_iter_current(it, (void **)&counter);
+			char nb[DNS_NAME_FORMATSIZE],
+				text[DNS_NAME_FORMATSIZE + BUFSIZ];
+
+			uint_fast32_t count =
+				atomic_load_relaxed(&counter->count);
+			uint_fast32_t allowed =
+				atomic_load_relaxed(&counter->allowed);
+			uint_fast32_t dropped =
+				atomic_load_relaxed(&counter->dropped);
+
+			if (count < spill) {
+				continue;
+			}
 
-		dns_name_format(counter->domain, nb, sizeof(nb));
-		snprintf(text, sizeof(text),
-			 "\n- %s: %" PRIuFAST32 " active (allowed %" PRIuFAST32
-			 " spilled %" PRIuFAST32 ")",
-			 nb, count, allowed, dropped);
+			dns_name_format(counter->domain, nb, sizeof(nb));
+			snprintf(text, sizeof(text),
+				 "\n- %s: %" PRIuFAST32
+				 " active (allowed %" PRIuFAST32
+				 " spilled %" PRIuFAST32 ")",
+				 nb, count, allowed, dropped);
 
-		result = isc_buffer_reserve(*buf, strlen(text));
-		if (result != ISC_R_SUCCESS) {
-			goto cleanup;
+			result = isc_buffer_reserve(*buf, strlen(text));
+			if (result != ISC_R_SUCCESS) {
+				break;
+			}
+			isc_buffer_putstr(*buf, text);
 		}
-		isc_buffer_putstr(*buf, text);
-	}
-	if (result == ISC_R_NOMORE) {
-		result = ISC_R_SUCCESS;
+		if (result == ISC_R_NOMORE) {
+			result = ISC_R_SUCCESS;
+		}
+		UNLOCK(&bucket->lock);
+		isc_hashmap_iter_destroy(&it);
 	}
 
-cleanup:
-	UNLOCK(&res->counters_lock);
-	isc_hashmap_iter_destroy(&it);
 	return (result);
 }
 
@@ -11479,6 +11714,20 @@ dns_resolver_setnonbackofftries(dns_resolver_t *resolver, unsigned int tries) {
 	resolver->nonbackofftries = tries;
 }
 
+unsigned int
+dns_resolver_getmaxraces(dns_resolver_t *resolver) {
+	REQUIRE(VALID_RESOLVER(resolver));
+
+	return (resolver->maxraces);
+}
+
+void
+dns_resolver_setmaxraces(dns_resolver_t *resolver, unsigned int races) {
+	REQUIRE(VALID_RESOLVER(resolver));
+
+	resolver->maxraces = races;
+}
+
 void
 dns_resolver_setstats(dns_resolver_t *res, isc_stats_t *stats) {
 	REQUIRE(VALID_RESOLVER(res));
@@ -50,6 +50,7 @@
 #include <dns/masterdump.h>
 #include <dns/nta.h>
 #include <dns/order.h>
+#include <dns/pcache.h>
 #include <dns/peer.h>
 #include <dns/rbt.h>
 #include <dns/rdataset.h>
@@ -474,6 +475,9 @@ destroy(dns_view_t *view) {
 	if (view->failcache != NULL) {
 		dns_badcache_destroy(&view->failcache);
 	}
+	if (view->pcache != NULL) {
+		dns_pcache_destroy(&view->pcache);
+	}
 	isc_mutex_destroy(&view->new_zone_lock);
 	isc_rwlock_destroy(&view->sfd_lock);
 	isc_mutex_destroy(&view->lock);
@@ -291,12 +291,24 @@ failure:
 static isc_result_t
 axfr_makedb(dns_xfrin_ctx_t *xfr, dns_db_t **dbp) {
 	isc_result_t result;
+	char **argv = NULL;
+	unsigned int argc = 0;
 
-	result = dns_db_create(xfr->mctx, /* XXX */
-			       "rbt",	  /* XXX guess */
-			       &xfr->name, dns_dbtype_zone, xfr->rdclass, 0,
-			       NULL, /* XXX guess */
-			       dbp);
+	/*
+	 * The new database has the same type as the zone's own.
+	 */
+	result = dns_zone_getdbtype(xfr->zone, &argv, xfr->mctx);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	while (argv[argc] != NULL) {
+		argc++;
+	}
+	INSIST(argc >= 1);
+
+	result = dns_db_create(xfr->mctx, argv[0], &xfr->name, dns_dbtype_zone,
+			       xfr->rdclass, argc - 1, argv + 1, dbp);
+	isc_mem_free(xfr->mctx, argv);
 	if (result == ISC_R_SUCCESS) {
 		dns_zone_rpz_enable_db(xfr->zone, *dbp);
 		dns_zone_catz_enable_db(xfr->zone, *dbp);
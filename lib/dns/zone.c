@@ -2175,7 +2175,12 @@ zone_load(dns_zone_t *zone, unsigned int flags, bool locked) {
 
 	INSIST(zone->db_argc >= 1);
 
-	rbt = strcmp(zone->db_argv[0], "rbt") == 0;
+	/*
+	 * Both "rbt" and "qp" zone databases are loaded from the zone's
+	 * file.
+	 */
+	rbt = strcmp(zone->db_argv[0], "rbt") == 0 ||
+	      strcmp(zone->db_argv[0], "qp") == 0;
 
 	if (zone->db != NULL && zone->masterfile == NULL && rbt) {
 		/*
@@ -19,6 +19,12 @@
 
 #include <isc/endian.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 /*
  * ASCII case conversion
  */
@@ -63,9 +69,9 @@ isc_ascii_strtolower(char *str) {
  * Convert 8 bytes to lower case, using SWAR tricks (SIMD within a register).
  * Based on "Hacker's Delight" by Henry S. Warren, "searching for a value in a
  * given range", p. 95. Eight bytes is wider than many labels in DNS names, so
- * it does not seem worth dealing with the portability issues of wide vector
- * registers. If there was a vector string load instruction (analogous to
- * memove() below) the balance might be different.
+ * this is the workhorse for label-sized data; isc__ascii_lowerequal16() below
+ * uses the vector registers that every target of a given architecture has
+ * for longer runs of bytes, such as whole names.
  */
 static inline uint64_t
 isc_ascii_tolower8(uint64_t octets) {
@@ -127,12 +133,69 @@ isc__ascii_load8(const uint8_t *ptr) {
 	return (bytes);
 }
 
+#if defined(__SSE2__)
+/*
+ * Convert 16 bytes to lower case. The comparisons are signed, so bytes
+ * from 0x80 upwards are never taken for upper case letters.
+ */
+static inline __m128i
+isc__ascii_tolower16(__m128i octets) {
+	__m128i is_ge_A = _mm_cmpgt_epi8(octets, _mm_set1_epi8('A' - 1));
+	__m128i is_le_Z = _mm_cmplt_epi8(octets, _mm_set1_epi8('Z' + 1));
+	__m128i is_upper = _mm_and_si128(is_ge_A, is_le_Z);
+	__m128i bit = _mm_and_si128(is_upper, _mm_set1_epi8('a' - 'A'));
+	return (_mm_or_si128(octets, bit));
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+static inline uint8x16_t
+isc__ascii_tolower16(uint8x16_t octets) {
+	uint8x16_t is_ge_A = vcgeq_u8(octets, vdupq_n_u8('A'));
+	uint8x16_t is_le_Z = vcleq_u8(octets, vdupq_n_u8('Z'));
+	uint8x16_t is_upper = vandq_u8(is_ge_A, is_le_Z);
+	uint8x16_t bit = vandq_u8(is_upper, vdupq_n_u8('a' - 'A'));
+	return (vorrq_u8(octets, bit));
+}
+#endif
+
+/*
+ * Compare 16 bytes at `a` and `b` for case-insensitive equality. Whole
+ * names are often long enough for a vector register to pay off, so one
+ * is used where the baseline instruction set of the target has it (SSE2
+ * on x86-64, Advanced SIMD on AArch64); otherwise this falls back to two
+ * SWAR comparisons.
+ */
+static inline bool
+isc__ascii_lowerequal16(const uint8_t *a, const uint8_t *b) {
+#if defined(__SSE2__)
+	__m128i a16 = isc__ascii_tolower16(_mm_loadu_si128((const void *)a));
+	__m128i b16 = isc__ascii_tolower16(_mm_loadu_si128((const void *)b));
+	return (_mm_movemask_epi8(_mm_cmpeq_epi8(a16, b16)) == 0xffff);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	uint8x16_t a16 = isc__ascii_tolower16(vld1q_u8(a));
+	uint8x16_t b16 = isc__ascii_tolower16(vld1q_u8(b));
+	return (vminvq_u8(vceqq_u8(a16, b16)) == 0xff);
+#else
+	return (isc_ascii_tolower8(isc__ascii_load8(a)) ==
+			isc_ascii_tolower8(isc__ascii_load8(b)) &&
+		isc_ascii_tolower8(isc__ascii_load8(a + 8)) ==
+			isc_ascii_tolower8(isc__ascii_load8(b + 8)));
+#endif
+}
+
 /*
  * Compare `len` bytes at `a` and `b` for case-insensitive equality
  */
 static inline bool
 isc_ascii_lowerequal(const uint8_t *a, const uint8_t *b, unsigned int len) {
 	uint64_t a8 = 0, b8 = 0;
+	while (len >= 16) {
+		if (!isc__ascii_lowerequal16(a, b)) {
+			return (false);
+		}
+		len -= 16;
+		a += 16;
+		b += 16;
+	}
 	while (len >= 8) {
 		a8 = isc_ascii_tolower8(isc__ascii_load8(a));
 		b8 = isc_ascii_tolower8(isc__ascii_load8(b));
@@ -160,6 +223,15 @@ isc_ascii_lowerequal(const uint8_t *a, const uint8_t *b, unsigned int len) {
 static inline int
 isc_ascii_lowercmp(const uint8_t *a, const uint8_t *b, unsigned int len) {
 	uint64_t a8 = 0, b8 = 0;
+	/*
+	 * Skip the equal prefix quickly, and leave it to the narrower
+	 * loops to find out which way the first difference goes.
+	 */
+	while (len >= 16 && isc__ascii_lowerequal16(a, b)) {
+		len -= 16;
+		a += 16;
+		b += 16;
+	}
 	while (len >= 8) {
 		a8 = isc_ascii_tolower8(htobe64(isc__ascii_load8(a)));
 		b8 = isc_ascii_tolower8(htobe64(isc__ascii_load8(b)));
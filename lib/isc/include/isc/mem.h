@@ -298,6 +298,15 @@ isc_mem_maxmalloced(isc_mem_t *ctx);
  * allocated in 'mctx' at any time.
  */
 
+void
+isc_mem_cachestat(isc_mem_t *ctx, bool hit);
+/*%<
+ * Account a request to an object cache built on top of 'ctx', such as a
+ * free list of preinitialized objects; 'hit' is true when an object was
+ * reused instead of being allocated.  The counts are reported in the
+ * memory statistics together with those of the memory pools in 'ctx'.
+ */
+
 bool
 isc_mem_isovermem(isc_mem_t *mctx);
 /*%<
@@ -44,6 +44,14 @@ typedef enum {
 	isc_socktype_raw = 4
 } isc_socktype_t;
 
+/*
+ * The I/O backend used by the network manager sockets.
+ */
+typedef enum {
+	isc_nm_backend_libuv = 0,
+	isc_nm_backend_uring = 1
+} isc_nm_backend_t;
+
 typedef void (*isc_nm_recv_cb_t)(isc_nmhandle_t *handle, isc_result_t eresult,
 				 isc_region_t *region, void *cbarg);
 /*%<
@@ -266,6 +274,44 @@ isc_nm_udpconnect(isc_nm_t *mgr, isc_sockaddr_t *local, isc_sockaddr_t *peer,
  *
  * The connected socket can only be accessed via the handle passed to
  * 'cb'.
+ *
+ * If a socket bound to 'local' has been reserved on the current loop
+ * with isc_nm_udptakeprebound(), it is used instead of opening a new
+ * one.
+ */
+
+void
+isc_nm_udpprebind(isc_nm_t *mgr, const isc_sockaddr_t *local);
+/*%<
+ * Add a UDP socket bound to 'local' to the current loop's pool of
+ * sockets for isc_nm_udpconnect().  The socket is opened and bound at
+ * the start of the next loop iteration, and dropped if that fails.  It
+ * is closed if it has not been reserved within a second.  Does nothing
+ * outside of the loop threads or while shutting down.
+ *
+ * The datagrams that reach the socket before isc_nm_udpconnect() uses
+ * it are discarded.
+ */
+
+isc_result_t
+isc_nm_udptakeprebound(isc_nm_t *mgr, isc_sockaddr_t *local);
+/*%<
+ * Reserve a socket bound to the address of 'local' from the current
+ * loop's pool, and set the port of 'local' to the port it is bound to.
+ * The next isc_nm_udpconnect() from 'local' on this loop then uses that
+ * socket; if there is none by the next loop iteration, it is closed.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTFOUND	no such socket in the pool
+ */
+
+unsigned int
+isc_nm_udpprebound(isc_nm_t *mgr, const isc_sockaddr_t *local);
+/*%<
+ * Return the number of sockets bound to the address of 'local' in the
+ * current loop's pool, including those still to be opened; the port
+ * of 'local' is ignored.
  */
 
 isc_result_t
@@ -341,6 +387,35 @@ isc_nm_send(isc_nmhandle_t *handle, isc_region_t *region, isc_nm_cb_t cb,
  * in 'cb'.
  */
 
+void
+isc_nm_getsendbuf(isc_nmhandle_t *handle, isc_region_t *region);
+/*%<
+ * Get a buffer for the data to be sent via 'handle' from the pool kept by
+ * the network manager worker that the handle belongs to.  The buffer is
+ * large enough for the largest DNS message any of the transports can
+ * carry; 'region->length' is set to its size.
+ *
+ * The stream transports (TCP, TLS) send the two-byte length prefix from
+ * the send request itself, so a message can be rendered straight into the
+ * buffer and handed to isc_nm_send() without being copied.
+ *
+ * Requires:
+ * \li	'handle' is a valid netmgr handle.
+ * \li	The function is called from the thread the handle belongs to.
+ */
+
+void
+isc_nm_putsendbuf(isc_nmhandle_t *handle, isc_region_t *region);
+/*%<
+ * Return the buffer in 'region', obtained from isc_nm_getsendbuf(), to the
+ * pool it came from.  This must not be done before the send callback has
+ * been called.  'region' is reset.
+ *
+ * Requires:
+ * \li	'handle' is a valid netmgr handle.
+ * \li	The function is called from the thread the handle belongs to.
+ */
+
 isc_result_t
 isc_nm_listentcp(isc_nm_t *mgr, uint32_t workers, isc_sockaddr_t *iface,
 		 isc_nm_accept_cb_t accept_cb, void *accept_cbarg, int backlog,
@@ -452,6 +527,43 @@ isc_nm_setloadbalancesockets(isc_nm_t *mgr, bool enabled);
  * \li	'mgr' is a valid netmgr.
  */
 
+bool
+isc_nm_getudpsendbatch(isc_nm_t *mgr);
+void
+isc_nm_setudpsendbatch(isc_nm_t *mgr, bool enabled);
+/*%<
+ * Get and set whether the UDP responses produced while processing a
+ * single recvmmsg(2) batch are sent together with sendmmsg(2) (and UDP
+ * GSO, where the destination and sizes allow it).  This is enabled by
+ * default on the systems that support it, and has no effect elsewhere.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ */
+
+isc_nm_backend_t
+isc_nm_getbackend(isc_nm_t *mgr);
+isc_result_t
+isc_nm_setbackend(isc_nm_t *mgr, isc_nm_backend_t backend);
+/*%<
+ * Get and set the I/O backend used by the sockets created afterwards.
+ * The default is libuv; with the io_uring backend (Linux only), the
+ * listening UDP sockets receive the queries with multishot io_uring
+ * receives into registered buffer rings, and send the responses with
+ * sendmsg(2) operations submitted in batches.  The outgoing UDP sockets
+ * send their queries the same way, so the queries sent during a single
+ * event loop iteration are submitted together.  Everything else keeps
+ * using libuv.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTIMPLEMENTED	the backend is not compiled in, or the
+ *				running kernel doesn't support it
+ */
+
 void
 isc_nm_gettimeouts(isc_nm_t *mgr, uint32_t *initial, uint32_t *idle,
 		   uint32_t *keepalive, uint32_t *advertised);
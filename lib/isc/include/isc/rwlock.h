@@ -55,6 +55,7 @@ typedef pthread_rwlock_t  isc__rwlock_t;
 #define isc_rwlock_trylock(rwl, type) isc__rwlock_trylock(*rwl, type)
 #define isc_rwlock_unlock(rwl, type)  isc__rwlock_unlock(*rwl, type)
 #define isc_rwlock_tryupgrade(rwl)    isc__rwlock_tryupgrade(*rwl)
+#define isc_rwlock_downgrade(rwl)     isc__rwlock_downgrade(*rwl)
 #define isc_rwlock_destroy(rwl)            \
 	{                                  \
 		isc__rwlock_destroy(*rwl); \
@@ -71,6 +72,7 @@ typedef pthread_rwlock_t isc__rwlock_t;
 #define isc_rwlock_trylock(rwl, type) isc__rwlock_trylock(rwl, type)
 #define isc_rwlock_unlock(rwl, type)  isc__rwlock_unlock(rwl, type)
 #define isc_rwlock_tryupgrade(rwl)    isc__rwlock_tryupgrade(rwl)
+#define isc_rwlock_downgrade(rwl)     isc__rwlock_downgrade(rwl)
 #define isc_rwlock_destroy(rwl)	      isc__rwlock_destroy(rwl)
 
 #endif /* ISC_TRACK_PTHREADS_OBJECTS */
@@ -152,6 +154,13 @@ typedef pthread_rwlock_t isc__rwlock_t;
 		ISC_R_LOCKBUSY;     \
 	})
 
+/* A lock that can't be upgraded is never downgraded */
+#define isc__rwlock_downgrade(rwl) \
+	{                          \
+		UNUSED(rwl);       \
+		UNREACHABLE();     \
+	}
+
 #define isc__rwlock_destroy(rwl)                                      \
 	{                                                             \
 		int _ret = pthread_rwlock_destroy(rwl);               \
@@ -204,6 +213,7 @@ typedef struct isc_rwlock isc__rwlock_t;
 #define isc_rwlock_trylock(rwl, type) isc__rwlock_trylock(rwl, type)
 #define isc_rwlock_unlock(rwl, type)  isc__rwlock_unlock(rwl, type)
 #define isc_rwlock_tryupgrade(rwl)    isc__rwlock_tryupgrade(rwl)
+#define isc_rwlock_downgrade(rwl)     isc__rwlock_downgrade(rwl)
 #define isc_rwlock_destroy(rwl)	      isc__rwlock_destroy(rwl)
 
 void
@@ -222,6 +232,9 @@ isc__rwlock_unlock(isc__rwlock_t *rwl, isc_rwlocktype_t type);
 isc_result_t
 isc__rwlock_tryupgrade(isc__rwlock_t *rwl);
 
+void
+isc__rwlock_downgrade(isc__rwlock_t *rwl);
+
 void
 isc__rwlock_destroy(isc__rwlock_t *rwl);
 
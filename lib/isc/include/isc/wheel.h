@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file isc/wheel.h
+ * \brief Hierarchical timing wheel.
+ *
+ * A timing wheel is an index of elements keyed on an expiry time in
+ * seconds (an isc_stdtime_t).  Unlike a heap it does not keep the
+ * elements in order: it only knows, in constant time, which of them
+ * are due.  Insertion, deletion and rescheduling are O(1); as time
+ * advances, whole slots of elements become due at once.
+ *
+ * The wheel has several levels of slots.  The lowest level has a slot
+ * per second, each higher level a slot per span of the level below it.
+ * Elements far in the future are kept in a coarse slot and cascade
+ * down to finer ones as their time approaches, so each element is
+ * moved at most once per level.
+ *
+ * Like isc_heap, the wheel calls back with an element's index whenever
+ * it changes, and the index is what deletions and updates take.  Index
+ * 0 means the element is not in the wheel.
+ *
+ * The wheel is not locked.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <isc/lang.h>
+#include <isc/stdtime.h>
+#include <isc/types.h>
+
+ISC_LANG_BEGINDECLS
+
+/*%
+ * The index function is called whenever an element's index in the
+ * wheel changes, including when it is removed from the wheel (with
+ * an index of 0).
+ */
+typedef void (*isc_wheelindex_t)(void *, unsigned int);
+
+typedef struct isc_wheel isc_wheel_t;
+
+void
+isc_wheel_create(isc_mem_t *mctx, isc_stdtime_t now, isc_wheelindex_t index,
+		 isc_wheel_t **wheelp);
+/*!<
+ * \brief Create a new timing wheel, with its clock set to 'now'.
+ *
+ * Requires:
+ *\li	"mctx" is valid.
+ *\li	"index" is not NULL.
+ *\li	"wheelp" is not NULL, and "*wheelp" is NULL.
+ */
+
+void
+isc_wheel_destroy(isc_wheel_t **wheelp);
+/*!<
+ * \brief Destroys a timing wheel.  The elements still in it are not
+ * told about it.
+ *
+ * Requires:
+ *\li	"wheelp" is not NULL and "*wheelp" points to a valid isc_wheel_t.
+ */
+
+void
+isc_wheel_insert(isc_wheel_t *wheel, void *elt, isc_stdtime_t when);
+/*!<
+ * \brief Inserts a new element, due at time 'when', into the wheel.
+ * An element whose time has already come is due immediately.
+ *
+ * Requires:
+ *\li	"wheel" is a valid isc_wheel_t.
+ *\li	"elt" is not NULL and is not already in the wheel.
+ */
+
+void
+isc_wheel_delete(isc_wheel_t *wheel, unsigned int index);
+/*!<
+ * \brief Deletes an element from the wheel, by element index.
+ *
+ * Requires:
+ *\li	"wheel" is a valid isc_wheel_t.
+ *\li	"index" is a valid element index, as provided by the "index"
+ *	callback.
+ */
+
+void
+isc_wheel_update(isc_wheel_t *wheel, unsigned int index, isc_stdtime_t when);
+/*!<
+ * \brief Moves an element to the slot for a new time 'when'.
+ *
+ * Requires:
+ *\li	"wheel" is a valid isc_wheel_t.
+ *\li	"index" is a valid element index, as provided by the "index"
+ *	callback.
+ */
+
+void *
+isc_wheel_element(isc_wheel_t *wheel, unsigned int index);
+/*!<
+ * \brief Returns the element for a specific element index.
+ *
+ * Requires:
+ *\li	"wheel" is a valid isc_wheel_t.
+ *\li	"index" is a valid element index, as provided by the "index"
+ *	callback.
+ */
+
+void *
+isc_wheel_due(isc_wheel_t *wheel, isc_stdtime_t now);
+/*!<
+ * \brief Advances the wheel's clock to 'now' and returns an element
+ * that is due, i.e. whose time is no later than 'now', or NULL if
+ * there is none.
+ *
+ * The element is left in the wheel: the caller is expected to delete
+ * or update it before asking for the next one.  Due elements are
+ * returned in the order they became due, not in order of their times;
+ * an element that is updated to a time that has already passed goes
+ * to the back of the queue.
+ *
+ * The clock never runs backwards; if 'now' is earlier than the time
+ * the wheel was last advanced to, elements due between the two times
+ * may be returned as due.
+ *
+ * Requires:
+ *\li	"wheel" is a valid isc_wheel_t.
+ */
+
+bool
+isc_wheel_pending(const isc_wheel_t *wheel, isc_stdtime_t now);
+/*!<
+ * \brief Returns false if isc_wheel_due() would return no element for
+ * time 'now'.
+ *
+ * It may return true even though no element is due yet, if the clock
+ * has not been advanced over an element's slot; it never returns false
+ * while an element is due.
+ *
+ * Unlike isc_wheel_due(), this does not advance the wheel's clock or
+ * change the wheel in any way, so it may be called by a thread that
+ * only holds a read lock on it.
+ *
+ * Requires:
+ *\li	"wheel" is a valid isc_wheel_t.
+ */
+
+size_t
+isc_wheel_count(isc_wheel_t *wheel);
+/*!<
+ * \brief Returns the number of elements in the wheel.
+ *
+ * Requires:
+ *\li	"wheel" is a valid isc_wheel_t.
+ */
+
+ISC_LANG_ENDDECLS
@@ -151,6 +151,9 @@ struct isc_mem {
 	atomic_size_t lo_water;
 	ISC_LIST(isc_mempool_t) pools;
 	unsigned int poolcnt;
+	atomic_uint_fast64_t cachegets;	  /*%< gets from destroyed pools and
+					   * object caches */
+	atomic_uint_fast64_t cachemisses; /*%< gets that had to allocate */
 
 #if ISC_MEM_TRACKLINES
 	debuglist_t *debuglist;
@@ -175,7 +178,8 @@ struct isc_mempool {
 	size_t freemax;		      /*%< # of items allowed on free list */
 	size_t fillcount;	      /*%< # of items to fetch on each fill */
 	/*%< Stats only. */
-	size_t gets; /*%< # of requests to this pool */
+	size_t gets;   /*%< # of requests to this pool */
+	size_t misses; /*%< # of requests that found the free list empty */
 	/*%< Debugging only. */
 	char name[16]; /*%< printed name in stats reports */
 };
@@ -492,6 +496,8 @@ mem_create(isc_mem_t **ctxp, unsigned int debugging, unsigned int flags) {
 	atomic_init(&ctx->maxmalloced, sizeof(*ctx));
 	atomic_init(&ctx->hi_water, 0);
 	atomic_init(&ctx->lo_water, 0);
+	atomic_init(&ctx->cachegets, 0);
+	atomic_init(&ctx->cachemisses, 0);
 	atomic_init(&ctx->hi_called, false);
 	atomic_init(&ctx->is_overmem, false);
 
@@ -842,12 +848,34 @@ print_active(isc_mem_t *mctx, FILE *out) {
 }
 #endif /* if ISC_MEM_TRACKLINES */
 
+/*
+ * Requires ctx->lock to be held by the caller.  The counters of the live
+ * pools are updated without locking by the pool owners, so the result may
+ * be slightly off.
+ */
+static void
+mem_cachestats(isc_mem_t *ctx, uint64_t *getsp, uint64_t *missesp) {
+	uint64_t gets = atomic_load_relaxed(&ctx->cachegets);
+	uint64_t misses = atomic_load_relaxed(&ctx->cachemisses);
+
+	for (isc_mempool_t *pool = ISC_LIST_HEAD(ctx->pools); pool != NULL;
+	     pool = ISC_LIST_NEXT(pool, link))
+	{
+		gets += pool->gets;
+		misses += pool->misses;
+	}
+
+	*getsp = gets;
+	*missesp = misses;
+}
+
 /*
  * Print the stats[] on the stream "out" with suitable formatting.
  */
 void
 isc_mem_stats(isc_mem_t *ctx, FILE *out) {
 	isc_mempool_t *pool = NULL;
+	uint64_t cachegets, cachemisses;
 
 	REQUIRE(VALID_CONTEXT(ctx));
 
@@ -879,19 +907,27 @@ isc_mem_stats(isc_mem_t *ctx, FILE *out) {
 	pool = ISC_LIST_HEAD(ctx->pools);
 	if (pool != NULL) {
 		fprintf(out, "[Pool statistics]\n");
-		fprintf(out, "%15s %10s %10s %10s %10s %10s %10s %1s\n", "name",
-			"size", "allocated", "freecount", "freemax",
-			"fillcount", "gets", "L");
+		fprintf(out, "%15s %10s %10s %10s %10s %10s %10s %10s %1s\n",
+			"name", "size", "allocated", "freecount", "freemax",
+			"fillcount", "gets", "misses", "L");
 	}
 	while (pool != NULL) {
 		fprintf(out,
-			"%15s %10zu %10zu %10zu %10zu %10zu %10zu %10zu %s\n",
+			"%15s %10zu %10zu %10zu %10zu %10zu %10zu %10zu %10zu "
+			"%s\n",
 			pool->name, pool->size, (size_t)0, pool->allocated,
 			pool->freecount, pool->freemax, pool->fillcount,
-			pool->gets, "N");
+			pool->gets, pool->misses, "N");
 		pool = ISC_LIST_NEXT(pool, link);
 	}
 
+	mem_cachestats(ctx, &cachegets, &cachemisses);
+	if (cachegets != 0) {
+		fprintf(out, "[Cache statistics]\n");
+		fprintf(out, "%11" PRIu64 " gets, %11" PRIu64 " hits\n",
+			cachegets, cachegets - cachemisses);
+	}
+
 #if ISC_MEM_TRACKLINES
 	print_active(ctx, out);
 #endif /* if ISC_MEM_TRACKLINES */
@@ -1091,6 +1127,16 @@ isc_mem_maxmalloced(isc_mem_t *ctx) {
 	return (atomic_load_acquire(&ctx->maxmalloced));
 }
 
+void
+isc_mem_cachestat(isc_mem_t *ctx, bool hit) {
+	REQUIRE(VALID_CONTEXT(ctx));
+
+	atomic_fetch_add_relaxed(&ctx->cachegets, 1);
+	if (!hit) {
+		atomic_fetch_add_relaxed(&ctx->cachemisses, 1);
+	}
+}
+
 void
 isc_mem_clearwater(isc_mem_t *mctx) {
 	isc_mem_setwater(mctx, NULL, NULL, 0, 0);
@@ -1273,6 +1319,11 @@ isc__mempool_destroy(isc_mempool_t **restrict mpctxp FLARG) {
 	MCTXLOCK(mctx);
 	ISC_LIST_UNLINK(mctx->pools, mpctx, link);
 	mctx->poolcnt--;
+	/*
+	 * Keep the hit rate statistics of the pool in the memory context.
+	 */
+	atomic_fetch_add_relaxed(&mctx->cachegets, mpctx->gets);
+	atomic_fetch_add_relaxed(&mctx->cachemisses, mpctx->misses);
 	MCTXUNLOCK(mctx);
 
 	mpctx->magic = 0;
@@ -1295,6 +1346,7 @@ isc__mempool_get(isc_mempool_t *restrict mpctx FLARG) {
 #else
 		const size_t fillcount = 1;
 #endif
+		mpctx->misses++;
 		/*
 		 * We need to dip into the well.  Fill up our free list.
 		 */
@@ -1479,6 +1531,7 @@ xml_renderctx(isc_mem_t *ctx, summarystat_t *summary, xmlTextWriterPtr writer) {
 	REQUIRE(VALID_CONTEXT(ctx));
 
 	int xmlrc;
+	uint64_t cachegets, cachemisses;
 
 	MCTXLOCK(ctx);
 
@@ -1541,6 +1594,16 @@ xml_renderctx(isc_mem_t *ctx, summarystat_t *summary, xmlTextWriterPtr writer) {
 	TRY0(xmlTextWriterEndElement(writer)); /* pools */
 	summary->contextsize += ctx->poolcnt * sizeof(isc_mempool_t);
 
+	mem_cachestats(ctx, &cachegets, &cachemisses);
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "cachegets"));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64 "", cachegets));
+	TRY0(xmlTextWriterEndElement(writer)); /* cachegets */
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "cachehits"));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%" PRIu64 "",
+					    cachegets - cachemisses));
+	TRY0(xmlTextWriterEndElement(writer)); /* cachehits */
+
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "hiwater"));
 	TRY0(xmlTextWriterWriteFormatString(
 		writer, "%" PRIu64 "",
@@ -1630,6 +1693,7 @@ json_renderctx(isc_mem_t *ctx, summarystat_t *summary, json_object *array) {
 
 	json_object *ctxobj, *obj;
 	char buf[1024];
+	uint64_t cachegets, cachemisses;
 
 	MCTXLOCK(ctx);
 
@@ -1689,6 +1753,15 @@ json_renderctx(isc_mem_t *ctx, summarystat_t *summary, json_object *array) {
 
 	summary->contextsize += ctx->poolcnt * sizeof(isc_mempool_t);
 
+	mem_cachestats(ctx, &cachegets, &cachemisses);
+	obj = json_object_new_int64(cachegets);
+	CHECKMEM(obj);
+	json_object_object_add(ctxobj, "cachegets", obj);
+
+	obj = json_object_new_int64(cachegets - cachemisses);
+	CHECKMEM(obj);
+	json_object_object_add(ctxobj, "cachehits", obj);
+
 	obj = json_object_new_int64(atomic_load_relaxed(&ctx->hi_water));
 	CHECKMEM(obj);
 	json_object_object_add(ctxobj, "hiwater", obj);
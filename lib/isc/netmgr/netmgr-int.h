@@ -77,6 +77,26 @@
  */
 #define ISC_NETMGR_SENDBUF_SIZE (sizeof(uint16_t) + UINT16_MAX)
 
+/*
+ * The send buffers handed out by isc_nm_getsendbuf() are sized for the
+ * largest DNS message, the stream transports send the length separately.
+ * Only a few of them are kept on the per-worker free list, the rest is
+ * returned to the memory context.
+ */
+#define ISC_NETMGR_DNSBUF_SIZE	  UINT16_MAX
+#define ISC_NETMGR_DNSBUF_FREEMAX 16
+
+/*
+ * Batched UDP sends: the responses produced while a single recvmmsg(2)
+ * batch is being processed are queued on the socket and then sent with a
+ * single sendmmsg(2) call once the batch is over.  The queue size matches
+ * the number of datagrams libuv receives in a single recvmmsg(2) call.
+ */
+#if HAVE_SENDMMSG && HAVE_DECL_UV_UDP_RECVMMSG && HAVE_DECL_UV_UDP_MMSG_FREE
+#define ISC_NETMGR_UDP_SENDBATCH      1
+#define ISC_NETMGR_UDP_SENDBATCH_SIZE 20
+#endif
+
 /*
  * Make sure our RECVBUF size is large enough
  */
@@ -198,6 +218,25 @@ typedef struct isc__netievent isc__netievent_t;
 /*
  * Single network event loop worker.
  */
+typedef struct isc__nm_uring isc__nm_uring_t;
+
+/*
+ * A UDP socket opened and bound ahead of time for isc_nm_udpconnect(),
+ * see isc_nm_udpprebind().  It is closed if it has not been used within
+ * ISC_NETMGR_UDPPREBOUND_LIFETIME milliseconds, so that a port does not
+ * stay bound and unconnected for long.
+ */
+#define ISC_NETMGR_UDPPREBOUND_LIFETIME 1000
+
+typedef struct isc__nm_udpprebound isc__nm_udpprebound_t;
+struct isc__nm_udpprebound {
+	uv_os_sock_t fd; /* -1 until the socket has been opened */
+	isc_sockaddr_t local;
+	bool taken;	  /* see isc_nm_udptakeprebound() */
+	uint64_t expires; /* loop time, in milliseconds */
+	ISC_LINK(isc__nm_udpprebound_t) link;
+};
+
 typedef struct isc__networker {
 	isc_mem_t *mctx;
 	isc_refcount_t references;
@@ -208,6 +247,18 @@ typedef struct isc__networker {
 	char *recvbuf;
 	char *sendbuf;
 	bool recvbuf_inuse;
+
+	isc_mempool_t *dnsbuf_pool; /* see isc_nm_getsendbuf() */
+
+	/* see isc_nm_udpprebind() */
+	ISC_LIST(isc__nm_udpprebound_t) udpprebound;
+	bool udpprebound_job;
+	uv_timer_t udpprebound_timer;
+	bool udpprebound_timer_init;
+
+#if HAVE_LIBURING
+	isc__nm_uring_t *uring; /* created on the first use */
+#endif
 } isc__networker_t;
 
 ISC_REFCOUNT_DECL(isc__networker);
@@ -327,6 +378,9 @@ struct isc__nm_uvreq {
 		uv_connect_t connect;
 		uv_udp_send_t udp_send;
 		uv_fs_t fs;
+#if HAVE_LIBURING
+		struct msghdr msghdr; /* io_uring sendmsg */
+#endif
 	} uv_req;
 	ISC_LINK(isc__nm_uvreq_t) link;
 };
@@ -676,6 +730,8 @@ struct isc_nm {
 	atomic_uint_fast32_t maxudp;
 
 	bool load_balance_sockets;
+	bool udp_send_batch;
+	isc_nm_backend_t backend;
 
 	/*
 	 * Active connections are being closed and new connections are
@@ -999,6 +1055,32 @@ struct isc_nmsocket {
 	isc_astack_t *inactivehandles;
 	isc_astack_t *inactivereqs;
 
+#if ISC_NETMGR_UDP_SENDBATCH
+	/*%
+	 * UDP responses queued while a recvmmsg(2) batch is being
+	 * processed; they are flushed with sendmmsg(2) when the batch
+	 * is over.
+	 */
+	struct {
+		bool active;
+		bool nogso;
+		size_t count;
+		isc__nm_uvreq_t *reqs[ISC_NETMGR_UDP_SENDBATCH_SIZE];
+	} sendbatch;
+#endif
+
+#if HAVE_LIBURING
+	/*%
+	 * The listening UDP socket is read with a multishot io_uring
+	 * receive.  The listening sockets and the outgoing (connected)
+	 * UDP sockets send their datagrams through the worker's ring.
+	 */
+	bool uring;
+	bool uring_recv; /* the multishot receive is armed */
+	bool uring_send; /* the sends are queued on the worker's ring */
+	struct msghdr uring_msg;
+#endif
+
 	/*%
 	 * Used to pass a result back from listen or connect events.
 	 */
@@ -1233,6 +1315,30 @@ isc__nm_udp_read(isc_nmhandle_t *handle, isc_nm_recv_cb_t cb, void *cbarg);
  * Back-end implementation of isc_nm_read() for UDP handles.
  */
 
+void
+isc__nm_udp_recv_datagram(isc_nmsocket_t *sock, ssize_t nrecv,
+			  const uv_buf_t *buf, const struct sockaddr *addr,
+			  unsigned int flags);
+/*%<
+ * Process a single datagram received on 'sock' and pass it to the read
+ * callback; a negative 'nrecv' is a (libuv) error code.  'flags' are the
+ * libuv receive flags, if any.  The buffer stays owned by the caller.
+ */
+
+void
+isc__nm_udp_sendbatch_flush(isc_nmsocket_t *sock, bool async);
+/*%<
+ * Send all the UDP responses queued on 'sock' while processing the
+ * current recvmmsg(2) batch, and stop queueing new ones.  If 'async'
+ * is true, the send callbacks are called asynchronously.
+ */
+
+void
+isc__nm_udp_prebind_shutdown(isc__networker_t *worker);
+/*%<
+ * Close the pre-bound UDP sockets left in the pool of 'worker'.
+ */
+
 void
 isc__nm_udp_close(isc_nmsocket_t *sock);
 /*%<
@@ -1274,6 +1380,54 @@ isc__nm_async_udpcancel(isc__networker_t *worker, isc__netievent_t *ev0);
  * Callback handlers for asynchronous UDP events (listen, stoplisten, send).
  */
 
+#if HAVE_LIBURING
+bool
+isc__nm_uring_supported(void);
+/*%<
+ * Return true if the running kernel provides everything the io_uring
+ * backend needs.
+ */
+
+int
+isc__nm_uring_udp_start(isc_nmsocket_t *sock);
+/*%<
+ * Arm the multishot io_uring receive on the listening UDP socket 'sock',
+ * creating the worker's ring if needed.  Returns 0 or a negative (libuv)
+ * error code, like uv_udp_recv_start().
+ */
+
+void
+isc__nm_uring_udp_stop(isc_nmsocket_t *sock);
+/*%<
+ * Cancel the io_uring receive on 'sock'; the reference held by the
+ * receive is released when the cancellation completes.
+ */
+
+isc_result_t
+isc__nm_uring_udp_send(isc_nmsocket_t *sock, isc__nm_uvreq_t *req);
+/*%<
+ * Queue a sendmsg(2) of 'req' on the worker's ring, creating the ring
+ * if needed; the queued sends are submitted together once per event
+ * loop iteration.  Returns ISC_R_NOMORE if the submission queue is full,
+ * ISC_R_NOTIMPLEMENTED if the ring can't be created, and
+ * ISC_R_SHUTTINGDOWN if the ring is being torn down, so the caller can
+ * fall back to libuv.
+ */
+
+void
+isc__nm_uring_submit(isc__networker_t *worker);
+/*%<
+ * Submit the operations queued on the worker's ring right away instead
+ * of waiting for the end of the event loop iteration.
+ */
+
+void
+isc__nm_uring_shutdown(isc__networker_t *worker);
+/*%<
+ * Close the worker's ring as soon as there are no operations in flight.
+ */
+#endif /* HAVE_LIBURING */
+
 void
 isc__nm_tcp_send(isc_nmhandle_t *handle, const isc_region_t *region,
 		 isc_nm_cb_t cb, void *cbarg);
@@ -1760,6 +1914,13 @@ isc__nm_socket_v6only(uv_os_sock_t fd, sa_family_t sa_family);
  * Restrict the socket to sending and receiving IPv6 packets only
  */
 
+isc_result_t
+isc__nm_socket_recverr(uv_os_sock_t fd, sa_family_t sa_family);
+/*%<
+ * Queue the ICMP errors on the socket's error queue (IP_RECVERR or
+ * IPV6_RECVERR), like libuv does for UV_UDP_LINUX_RECVERR
+ */
+
 isc_result_t
 isc__nm_socket_connectiontimeout(uv_os_sock_t fd, int timeout_ms);
 /*%<
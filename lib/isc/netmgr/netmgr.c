@@ -164,6 +164,12 @@ networker_teardown(void *arg) {
 
 	uv_walk(&loop->loop, shutdown_walk_cb, NULL);
 
+	isc__nm_udp_prebind_shutdown(worker);
+
+#if HAVE_LIBURING
+	isc__nm_uring_shutdown(worker);
+#endif /* HAVE_LIBURING */
+
 	isc__networker_detach(&worker);
 }
 
@@ -222,6 +228,11 @@ isc_netmgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr, isc_nm_t **netmgrp) {
 #else
 	netmgr->load_balance_sockets = false;
 #endif
+#if ISC_NETMGR_UDP_SENDBATCH
+	netmgr->udp_send_batch = true;
+#else
+	netmgr->udp_send_batch = false;
+#endif
 
 #ifdef NETMGR_TRACE
 	ISC_LIST_INIT(netmgr->active_sockets);
@@ -258,6 +269,14 @@ isc_netmgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr, isc_nm_t **netmgrp) {
 
 		isc_mem_attach(loop->mctx, &worker->mctx);
 
+		ISC_LIST_INIT(worker->udpprebound);
+
+		isc_mempool_create(worker->mctx, ISC_NETMGR_DNSBUF_SIZE,
+				   &worker->dnsbuf_pool);
+		isc_mempool_setfreemax(worker->dnsbuf_pool,
+				       ISC_NETMGR_DNSBUF_FREEMAX);
+		isc_mempool_setname(worker->dnsbuf_pool, "netmgr:dnsbuf");
+
 		isc_loop_attach(loop, &worker->loop);
 		isc_loop_teardown(loop, networker_teardown, worker);
 		isc_refcount_init(&worker->references, 1);
@@ -399,6 +418,56 @@ isc_nm_setloadbalancesockets(isc_nm_t *mgr, bool enabled) {
 #endif
 }
 
+bool
+isc_nm_getudpsendbatch(isc_nm_t *mgr) {
+	REQUIRE(VALID_NM(mgr));
+
+	return (mgr->udp_send_batch);
+}
+
+void
+isc_nm_setudpsendbatch(isc_nm_t *mgr, bool enabled) {
+	REQUIRE(VALID_NM(mgr));
+
+#if ISC_NETMGR_UDP_SENDBATCH
+	mgr->udp_send_batch = enabled;
+#else
+	UNUSED(enabled);
+#endif
+}
+
+isc_nm_backend_t
+isc_nm_getbackend(isc_nm_t *mgr) {
+	REQUIRE(VALID_NM(mgr));
+
+	return (mgr->backend);
+}
+
+isc_result_t
+isc_nm_setbackend(isc_nm_t *mgr, isc_nm_backend_t backend) {
+	REQUIRE(VALID_NM(mgr));
+
+	switch (backend) {
+	case isc_nm_backend_libuv:
+		break;
+	case isc_nm_backend_uring:
+#if HAVE_LIBURING
+		if (!isc__nm_uring_supported()) {
+			return (ISC_R_NOTIMPLEMENTED);
+		}
+		break;
+#else
+		return (ISC_R_NOTIMPLEMENTED);
+#endif /* HAVE_LIBURING */
+	default:
+		UNREACHABLE();
+	}
+
+	mgr->backend = backend;
+
+	return (ISC_R_SUCCESS);
+}
+
 void
 isc_nm_gettimeouts(isc_nm_t *mgr, uint32_t *initial, uint32_t *idle,
 		   uint32_t *keepalive, uint32_t *advertised) {
@@ -1605,6 +1674,12 @@ isc__nm_start_reading(isc_nmsocket_t *sock) {
 
 	switch (sock->type) {
 	case isc_nm_udpsocket:
+#if HAVE_LIBURING
+		if (sock->uring) {
+			r = isc__nm_uring_udp_start(sock);
+			break;
+		}
+#endif /* HAVE_LIBURING */
 		r = uv_udp_recv_start(&sock->uv_handle.udp, isc__nm_alloc_cb,
 				      isc__nm_udp_read_cb);
 		break;
@@ -1634,8 +1709,20 @@ isc__nm_stop_reading(isc_nmsocket_t *sock) {
 
 	switch (sock->type) {
 	case isc_nm_udpsocket:
+#if HAVE_LIBURING
+		if (sock->uring) {
+			isc__nm_uring_udp_stop(sock);
+			break;
+		}
+#endif /* HAVE_LIBURING */
 		r = uv_udp_recv_stop(&sock->uv_handle.udp);
 		UV_RUNTIME_CHECK(uv_udp_recv_stop, r);
+		/*
+		 * libuv won't call the read callback that ends the
+		 * current recvmmsg(2) batch anymore, so send the queued
+		 * responses now.
+		 */
+		isc__nm_udp_sendbatch_flush(sock, true);
 		break;
 	case isc_nm_tcpsocket:
 		r = uv_read_stop(&sock->uv_handle.stream);
@@ -1873,6 +1960,38 @@ isc_nm_send(isc_nmhandle_t *handle, isc_region_t *region, isc_nm_cb_t cb,
 	}
 }
 
+void
+isc_nm_getsendbuf(isc_nmhandle_t *handle, isc_region_t *region) {
+	isc__networker_t *worker = NULL;
+
+	REQUIRE(VALID_NMHANDLE(handle));
+	REQUIRE(VALID_NMSOCK(handle->sock));
+	REQUIRE(handle->sock->tid == isc_tid());
+	REQUIRE(region != NULL);
+
+	worker = handle->sock->worker;
+
+	region->base = isc_mempool_get(worker->dnsbuf_pool);
+	region->length = ISC_NETMGR_DNSBUF_SIZE;
+}
+
+void
+isc_nm_putsendbuf(isc_nmhandle_t *handle, isc_region_t *region) {
+	isc__networker_t *worker = NULL;
+
+	REQUIRE(VALID_NMHANDLE(handle));
+	REQUIRE(VALID_NMSOCK(handle->sock));
+	REQUIRE(handle->sock->tid == isc_tid());
+	REQUIRE(region != NULL && region->base != NULL);
+	REQUIRE(region->length == ISC_NETMGR_DNSBUF_SIZE);
+
+	worker = handle->sock->worker;
+
+	isc_mempool_put(worker->dnsbuf_pool, region->base);
+	region->base = NULL;
+	region->length = 0;
+}
+
 void
 isc__nm_senddns(isc_nmhandle_t *handle, isc_region_t *region, isc_nm_cb_t cb,
 		void *cbarg) {
@@ -2654,6 +2773,7 @@ isc__networker_destroy(isc__networker_t *worker) {
 
 	isc_loop_detach(&worker->loop);
 
+	isc_mempool_destroy(&worker->dnsbuf_pool);
 	isc_mem_put(worker->mctx, worker->sendbuf, ISC_NETMGR_SENDBUF_SIZE);
 	isc_mem_putanddetach(&worker->mctx, worker->recvbuf,
 			     ISC_NETMGR_RECVBUF_SIZE);
@@ -302,6 +302,33 @@ isc__nm_socket_v6only(uv_os_sock_t fd, sa_family_t sa_family) {
 	return (ISC_R_NOTIMPLEMENTED);
 }
 
+isc_result_t
+isc__nm_socket_recverr(uv_os_sock_t fd, sa_family_t sa_family) {
+	/*
+	 * Report the ICMP errors for the connected UDP sockets
+	 */
+	if (sa_family == AF_INET6) {
+#if defined(IPV6_RECVERR)
+		if (setsockopt_on(fd, IPPROTO_IPV6, IPV6_RECVERR) == -1) {
+			return (ISC_R_FAILURE);
+		} else {
+			return (ISC_R_SUCCESS);
+		}
+#endif
+	} else if (sa_family == AF_INET) {
+#if defined(IP_RECVERR)
+		if (setsockopt_on(fd, IPPROTO_IP, IP_RECVERR) == -1) {
+			return (ISC_R_FAILURE);
+		} else {
+			return (ISC_R_SUCCESS);
+		}
+#endif
+	}
+
+	UNUSED(fd);
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
 isc_result_t
 isc__nm_socket_connectiontimeout(uv_os_sock_t fd, int timeout_ms) {
 #if defined(TIMEOUT_OPTNAME)
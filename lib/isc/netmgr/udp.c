@@ -13,6 +13,11 @@
 
 #include <unistd.h>
 
+#if HAVE_DECL_UDP_SEGMENT
+#include <netinet/udp.h>
+#endif /* HAVE_DECL_UDP_SEGMENT */
+
+#include <isc/async.h>
 #include <isc/atomic.h>
 #include <isc/barrier.h>
 #include <isc/buffer.h>
@@ -27,6 +32,7 @@
 #include <isc/result.h>
 #include <isc/sockaddr.h>
 #include <isc/thread.h>
+#include <isc/tid.h>
 #include <isc/util.h>
 #include <isc/uv.h>
 
@@ -319,6 +325,27 @@ isc_nm_routeconnect(isc_nm_t *mgr, isc_nm_cb_t cb, void *cbarg) {
 #endif /* USE_ROUTE_SOCKET */
 }
 
+/*
+ * Start reading on the listening socket, with io_uring when the netmgr
+ * is configured to use it and the kernel cooperates, and with libuv
+ * otherwise.
+ */
+static int
+udp_recv_start(isc_nmsocket_t *sock) {
+#if HAVE_LIBURING
+	if (sock->worker->netmgr->backend == isc_nm_backend_uring &&
+	    isc__nm_uring_udp_start(sock) == 0)
+	{
+		sock->uring = true;
+		sock->uring_send = true;
+		return (0);
+	}
+#endif /* HAVE_LIBURING */
+
+	return (uv_udp_recv_start(&sock->uv_handle.udp, isc__nm_alloc_cb,
+				  isc__nm_udp_read_cb));
+}
+
 /*
  * Asynchronous 'udplisten' call handler: start listening on a UDP socket.
  */
@@ -405,8 +432,7 @@ isc__nm_async_udplisten(isc__networker_t *worker, isc__netievent_t *ev0) {
 
 	isc__nm_set_network_buffers(mgr, &sock->uv_handle.handle);
 
-	r = uv_udp_recv_start(&sock->uv_handle.udp, isc__nm_alloc_cb,
-			      isc__nm_udp_read_cb);
+	r = udp_recv_start(sock);
 	if (r != 0) {
 		isc__nm_incstats(sock, STATID_BINDFAIL);
 		goto done;
@@ -500,14 +526,13 @@ isc__nm_async_udpstop(isc__networker_t *worker, isc__netievent_t *ev0) {
 }
 
 /*
- * udp_recv_cb handles incoming UDP packet from uv.  The buffer here is
- * reused for a series of packets, so we need to allocate a new one.
- * This new one can be reused to send the response then.
+ * Process a single datagram (or a receive error) on 'sock'; the buffer
+ * is owned by the caller and it's only valid until we return.
  */
 void
-isc__nm_udp_read_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
-		    const struct sockaddr *addr, unsigned int flags) {
-	isc_nmsocket_t *sock = uv_handle_get_data((uv_handle_t *)handle);
+isc__nm_udp_recv_datagram(isc_nmsocket_t *sock, ssize_t nrecv,
+			  const uv_buf_t *buf, const struct sockaddr *addr,
+			  unsigned int flags) {
 	isc__nm_uvreq_t *req = NULL;
 	uint32_t maxudp;
 	isc_result_t result;
@@ -516,21 +541,6 @@ isc__nm_udp_read_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
 	REQUIRE(VALID_NMSOCK(sock));
 	REQUIRE(sock->tid == isc_tid());
 
-	/*
-	 * When using recvmmsg(2), if no errors occur, there will be a final
-	 * callback with nrecv set to 0, addr set to NULL and the buffer
-	 * pointing at the initially allocated data with the UV_UDP_MMSG_CHUNK
-	 * flag cleared and the UV_UDP_MMSG_FREE flag set.
-	 */
-#if HAVE_DECL_UV_UDP_MMSG_FREE
-	if ((flags & UV_UDP_MMSG_FREE) == UV_UDP_MMSG_FREE) {
-		INSIST(nrecv == 0);
-		INSIST(addr == NULL);
-		goto free;
-	}
-#else
-	UNUSED(flags);
-#endif
 	/*
 	 * Possible reasons to return now without processing:
 	 *
@@ -544,7 +554,7 @@ isc__nm_udp_read_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
 		 * readtimeout_cb can trigger and not crash because of
 		 * missing read_req.
 		 */
-		goto free;
+		return;
 	}
 
 	/*
@@ -552,7 +562,7 @@ isc__nm_udp_read_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
 	 */
 	if (nrecv < 0) {
 		isc__nm_failed_read_cb(sock, isc_uverr2result(nrecv), false);
-		goto free;
+		return;
 	}
 
 	/*
@@ -560,7 +570,7 @@ isc__nm_udp_read_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
 	 */
 	if (isc__nm_closing(sock->worker)) {
 		isc__nm_failed_read_cb(sock, ISC_R_SHUTTINGDOWN, false);
-		goto free;
+		return;
 	}
 
 	/*
@@ -568,18 +578,18 @@ isc__nm_udp_read_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
 	 */
 	if (!isc__nmsocket_active(sock)) {
 		isc__nm_failed_read_cb(sock, ISC_R_CANCELED, false);
-		goto free;
+		return;
 	}
 
 	/*
-	 * End of the current (iteration) datagram stream, just free the buffer.
-	 * The callback with nrecv == 0 and addr == NULL is called for both
-	 * normal UDP sockets and recvmmsg sockets at the end of every event
-	 * loop iteration.
+	 * End of the current (iteration) datagram stream, the caller frees
+	 * the buffer.  The callback with nrecv == 0 and addr == NULL is
+	 * called for both normal UDP sockets and recvmmsg sockets at the end
+	 * of every event loop iteration.
 	 */
 	if (nrecv == 0 && addr == NULL) {
 		INSIST(flags == 0);
-		goto free;
+		return;
 	}
 
 	/*
@@ -615,12 +625,62 @@ isc__nm_udp_read_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
 		isc__nm_stop_reading(sock);
 	}
 
+#if ISC_NETMGR_UDP_SENDBATCH
+	/*
+	 * The datagram is a part of a recvmmsg(2) batch, so libuv is going
+	 * to call us again with UV_UDP_MMSG_FREE when the batch is over;
+	 * queue the responses sent from the listening sockets until then.
+	 */
+	if ((flags & UV_UDP_MMSG_CHUNK) == UV_UDP_MMSG_CHUNK &&
+	    sock->parent != NULL && sock->worker->netmgr->udp_send_batch)
+	{
+		sock->sendbatch.active = true;
+	}
+#endif /* ISC_NETMGR_UDP_SENDBATCH */
+
 	REQUIRE(!sock->processing);
 	sock->processing = true;
 	isc__nm_readcb(sock, req, ISC_R_SUCCESS, false);
 	sock->processing = false;
+}
 
+/*
+ * udp_recv_cb handles incoming UDP packet from uv.  The buffer here is
+ * reused for a series of packets, so we need to allocate a new one.
+ * This new one can be reused to send the response then.
+ */
+void
+isc__nm_udp_read_cb(uv_udp_t *handle, ssize_t nrecv, const uv_buf_t *buf,
+		    const struct sockaddr *addr, unsigned int flags) {
+	isc_nmsocket_t *sock = uv_handle_get_data((uv_handle_t *)handle);
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->tid == isc_tid());
+
+	/*
+	 * When using recvmmsg(2), if no errors occur, there will be a final
+	 * callback with nrecv set to 0, addr set to NULL and the buffer
+	 * pointing at the initially allocated data with the UV_UDP_MMSG_CHUNK
+	 * flag cleared and the UV_UDP_MMSG_FREE flag set.
+	 */
+#if HAVE_DECL_UV_UDP_MMSG_FREE
+	if ((flags & UV_UDP_MMSG_FREE) == UV_UDP_MMSG_FREE) {
+		INSIST(nrecv == 0);
+		INSIST(addr == NULL);
+		/*
+		 * This is the end of the recvmmsg(2) batch, send the
+		 * responses that were queued while processing it.
+		 */
+		isc__nm_udp_sendbatch_flush(sock, false);
+		goto free;
+	}
+#endif
+
+	isc__nm_udp_recv_datagram(sock, nrecv, buf, addr, flags);
+
+#if HAVE_DECL_UV_UDP_MMSG_FREE
 free:
+#endif
 #if HAVE_DECL_UV_UDP_MMSG_CHUNK
 	/*
 	 * When using recvmmsg(2), chunks will have the UV_UDP_MMSG_CHUNK flag
@@ -672,6 +732,237 @@ udp_send_cb(uv_udp_send_t *req, int status) {
 	isc__nm_sendcb(sock, uvreq, result, false);
 }
 
+static void
+udp_send_direct(isc_nmsocket_t *sock, isc__nm_uvreq_t *req, bool async) {
+	const struct sockaddr *sa = &req->peer.type.sa;
+	int r;
+
+#if HAVE_LIBURING
+	/*
+	 * The io_uring submission queue is flushed once per event loop
+	 * iteration, use libuv only when it's full.
+	 */
+	if (sock->uring_send &&
+	    isc__nm_uring_udp_send(sock, req) == ISC_R_SUCCESS)
+	{
+		return;
+	}
+#endif /* HAVE_LIBURING */
+
+	/*
+	 * We used uv_udp_connect(), so the peer address has to be
+	 * set to NULL or else uv_udp_send() could fail or assert,
+	 * depending on the libuv version.
+	 */
+	if (atomic_load(&sock->connected)) {
+		sa = NULL;
+	}
+
+	r = uv_udp_send(&req->uv_req.udp_send, &sock->uv_handle.udp,
+			&req->uvbuf, 1, sa, udp_send_cb);
+	if (r < 0) {
+		isc__nm_incstats(sock, STATID_SENDFAIL);
+		isc__nm_failed_send_cb(sock, req, isc_uverr2result(r), async);
+	}
+}
+
+#if ISC_NETMGR_UDP_SENDBATCH
+#if HAVE_DECL_UDP_SEGMENT
+/*
+ * Limits for coalescing the queued datagrams into a single UDP GSO send:
+ * the kernel refuses to split a send into more than 64 segments, the
+ * whole send has to fit into a single IP datagram (minus the IPv6 and UDP
+ * headers), and every segment has to fit into the path MTU, which we
+ * don't know, so only the datagrams that fit into the IPv6 minimum MTU
+ * are coalesced.
+ */
+#define UDP_GSO_MAXSEGS	 64
+#define UDP_GSO_MAXSIZE	 (UINT16_MAX - 40 - 8)
+#define UDP_GSO_MAXSEGSZ (1280 - 40 - 8)
+
+/*
+ * Return the index of the first queued datagram that cannot be sent
+ * together with reqs[first] in a single UDP GSO send: all the segments
+ * have to go to the same peer and have the same size, except for the
+ * last one, which can be shorter.
+ */
+static size_t
+udp_sendbatch_segments(isc__nm_uvreq_t **reqs, size_t first, size_t count) {
+	size_t segsz = reqs[first]->uvbuf.len;
+	size_t total = segsz;
+	size_t last = first + 1;
+
+	if (segsz == 0 || segsz > UDP_GSO_MAXSEGSZ) {
+		return (last);
+	}
+
+	while (last < count && last - first < UDP_GSO_MAXSEGS) {
+		isc__nm_uvreq_t *req = reqs[last];
+
+		if (req->uvbuf.len == 0 || req->uvbuf.len > segsz ||
+		    total + req->uvbuf.len > UDP_GSO_MAXSIZE ||
+		    !isc_sockaddr_equal(&req->peer, &reqs[first]->peer))
+		{
+			break;
+		}
+
+		total += req->uvbuf.len;
+		last++;
+
+		if (req->uvbuf.len < segsz) {
+			break;
+		}
+	}
+
+	return (last);
+}
+#endif /* HAVE_DECL_UDP_SEGMENT */
+
+static void
+udp_sendbatch_send(isc_nmsocket_t *sock, bool async) {
+	isc__nm_uvreq_t *reqs[ISC_NETMGR_UDP_SENDBATCH_SIZE];
+	struct iovec iovs[ISC_NETMGR_UDP_SENDBATCH_SIZE];
+	struct mmsghdr msgs[ISC_NETMGR_UDP_SENDBATCH_SIZE];
+	size_t firstreq[ISC_NETMGR_UDP_SENDBATCH_SIZE + 1];
+#if HAVE_DECL_UDP_SEGMENT
+	union {
+		char buf[CMSG_SPACE(sizeof(uint16_t))];
+		struct cmsghdr align;
+	} cmsgs[ISC_NETMGR_UDP_SENDBATCH_SIZE];
+#endif /* HAVE_DECL_UDP_SEGMENT */
+	size_t count = sock->sendbatch.count;
+	size_t nmsgs = 0, sent = 0;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	if (count == 0) {
+		return;
+	}
+
+	memmove(reqs, sock->sendbatch.reqs, count * sizeof(reqs[0]));
+	sock->sendbatch.count = 0;
+
+	if (isc__nm_closing(sock->worker)) {
+		result = ISC_R_SHUTTINGDOWN;
+	} else if (isc__nmsocket_closing(sock)) {
+		result = ISC_R_CANCELED;
+	}
+
+	if (result != ISC_R_SUCCESS) {
+		for (size_t i = 0; i < count; i++) {
+			isc__nm_failed_send_cb(sock, reqs[i], result, async);
+		}
+		return;
+	}
+
+	/*
+	 * Don't overtake the datagrams libuv is still waiting to send.
+	 */
+	if (uv_udp_get_send_queue_count(&sock->uv_handle.udp) > 0) {
+		for (size_t i = 0; i < count; i++) {
+			udp_send_direct(sock, reqs[i], async);
+		}
+		return;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		iovs[i] = (struct iovec){ .iov_base = reqs[i]->uvbuf.base,
+					  .iov_len = reqs[i]->uvbuf.len };
+	}
+
+	for (size_t i = 0, next; i < count; i = next) {
+		struct msghdr *hdr = &msgs[nmsgs].msg_hdr;
+
+		next = i + 1;
+#if HAVE_DECL_UDP_SEGMENT
+		if (!sock->sendbatch.nogso) {
+			next = udp_sendbatch_segments(reqs, i, count);
+		}
+#endif /* HAVE_DECL_UDP_SEGMENT */
+
+		msgs[nmsgs] = (struct mmsghdr){ 0 };
+		hdr->msg_name = &reqs[i]->peer.type.sa;
+		hdr->msg_namelen = reqs[i]->peer.length;
+		hdr->msg_iov = &iovs[i];
+		hdr->msg_iovlen = next - i;
+
+#if HAVE_DECL_UDP_SEGMENT
+		if (next - i > 1) {
+			struct cmsghdr *cmsg = NULL;
+			uint16_t segsz = iovs[i].iov_len;
+
+			hdr->msg_control = cmsgs[nmsgs].buf;
+			hdr->msg_controllen = sizeof(cmsgs[nmsgs].buf);
+
+			cmsg = CMSG_FIRSTHDR(hdr);
+			cmsg->cmsg_level = IPPROTO_UDP;
+			cmsg->cmsg_type = UDP_SEGMENT;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(segsz));
+			memmove(CMSG_DATA(cmsg), &segsz, sizeof(segsz));
+		}
+#endif /* HAVE_DECL_UDP_SEGMENT */
+
+		firstreq[nmsgs++] = i;
+	}
+	firstreq[nmsgs] = count;
+
+	while (sent < nmsgs) {
+		int r;
+
+		do {
+			r = sendmmsg(sock->fd, &msgs[sent], nmsgs - sent, 0);
+		} while (r < 0 && errno == EINTR);
+
+		if (r <= 0) {
+			break;
+		}
+
+		for (size_t i = firstreq[sent]; i < firstreq[sent + r]; i++) {
+			isc__nm_sendcb(sock, reqs[i], ISC_R_SUCCESS, async);
+		}
+		sent += r;
+	}
+
+	if (sent == nmsgs) {
+		return;
+	}
+
+#if HAVE_DECL_UDP_SEGMENT
+	/*
+	 * The network device or the kernel can't do the segmentation,
+	 * don't try again on this socket.
+	 */
+	if (msgs[sent].msg_hdr.msg_iovlen > 1 &&
+	    (errno == EIO || errno == EINVAL))
+	{
+		sock->sendbatch.nogso = true;
+	}
+#endif /* HAVE_DECL_UDP_SEGMENT */
+
+	/*
+	 * Let libuv deal with the rest; it either queues the datagrams
+	 * until the socket is writable again or reports the error through
+	 * the send callback.
+	 */
+	for (size_t i = firstreq[sent]; i < count; i++) {
+		udp_send_direct(sock, reqs[i], async);
+	}
+}
+#endif /* ISC_NETMGR_UDP_SENDBATCH */
+
+void
+isc__nm_udp_sendbatch_flush(isc_nmsocket_t *sock, bool async) {
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->type == isc_nm_udpsocket);
+	REQUIRE(sock->tid == isc_tid());
+
+#if ISC_NETMGR_UDP_SENDBATCH
+	sock->sendbatch.active = false;
+	udp_sendbatch_send(sock, async);
+#else
+	UNUSED(async);
+#endif /* ISC_NETMGR_UDP_SENDBATCH */
+}
+
 /*
  * Send the data in 'region' to a peer via a UDP socket. We try to find
  * a proper sibling/child socket so that we won't have to jump to
@@ -681,12 +972,9 @@ void
 isc__nm_udp_send(isc_nmhandle_t *handle, const isc_region_t *region,
 		 isc_nm_cb_t cb, void *cbarg) {
 	isc_nmsocket_t *sock = handle->sock;
-	const isc_sockaddr_t *peer = &handle->peer;
-	const struct sockaddr *sa = &peer->type.sa;
 	isc__nm_uvreq_t *uvreq = NULL;
 	isc__networker_t *worker = NULL;
 	uint32_t maxudp;
-	int r;
 	isc_result_t result;
 
 	REQUIRE(VALID_NMSOCK(sock));
@@ -712,6 +1000,7 @@ isc__nm_udp_send(isc_nmhandle_t *handle, const isc_region_t *region,
 	uvreq = isc__nm_uvreq_get(sock->worker, sock);
 	uvreq->uvbuf.base = (char *)region->base;
 	uvreq->uvbuf.len = region->length;
+	uvreq->peer = handle->peer;
 
 	isc_nmhandle_attach(handle, &uvreq->handle);
 
@@ -728,29 +1017,361 @@ isc__nm_udp_send(isc_nmhandle_t *handle, const isc_region_t *region,
 		goto fail;
 	}
 
-	/*
-	 * We used uv_udp_connect(), so the peer address has to be
-	 * set to NULL or else uv_udp_send() could fail or assert,
-	 * depending on the libuv version.
-	 */
-	if (atomic_load(&sock->connected)) {
-		sa = NULL;
+#if ISC_NETMGR_UDP_SENDBATCH
+	if (sock->sendbatch.active) {
+		if (sock->sendbatch.count == ISC_NETMGR_UDP_SENDBATCH_SIZE) {
+			udp_sendbatch_send(sock, true);
+		}
+		sock->sendbatch.reqs[sock->sendbatch.count++] = uvreq;
+		return;
 	}
+#endif /* ISC_NETMGR_UDP_SENDBATCH */
 
-	r = uv_udp_send(&uvreq->uv_req.udp_send, &sock->uv_handle.udp,
-			&uvreq->uvbuf, 1, sa, udp_send_cb);
-	if (r < 0) {
-		isc__nm_incstats(sock, STATID_SENDFAIL);
-		result = isc_uverr2result(r);
-		goto fail;
-	}
+	udp_send_direct(sock, uvreq, true);
 	return;
 fail:
 	isc__nm_failed_send_cb(sock, uvreq, result, true);
 }
 
+/*
+ * The pool of pre-bound sockets of the current loop, or NULL when not
+ * called from a loop thread or when the loop is shutting down.
+ */
+static isc__networker_t *
+udp_prebind_worker(isc_nm_t *mgr) {
+	isc__networker_t *worker = NULL;
+	uint32_t tid = isc_tid();
+
+	if (tid == ISC_TID_UNKNOWN || tid >= mgr->nloops) {
+		return (NULL);
+	}
+
+	worker = &mgr->workers[tid];
+	if (isc__nm_closing(worker)) {
+		return (NULL);
+	}
+
+	return (worker);
+}
+
+static void
+udp_prebound_free(isc__networker_t *worker, isc__nm_udpprebound_t **pbp) {
+	isc__nm_udpprebound_t *pb = *pbp;
+
+	*pbp = NULL;
+
+	if (pb->fd != -1) {
+		isc__nm_closesocket(pb->fd);
+	}
+	isc_mem_put(worker->mctx, pb, sizeof(*pb));
+}
+
+/*
+ * Open the socket and set the options that uv_udp_bind() would set
+ * for udp_connect_direct() before binding it.
+ */
+static isc_result_t
+udp_prebound_open(isc__nm_udpprebound_t *pb) {
+	sa_family_t sa_family = pb->local.type.sa.sa_family;
+	isc_result_t result;
+	uv_os_sock_t fd = -1;
+
+	result = isc__nm_socket(sa_family, SOCK_DGRAM, 0, &fd);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	result = isc__nm_socket_reuse(fd);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS ||
+		      result == ISC_R_NOTIMPLEMENTED);
+
+	(void)isc__nm_socket_v6only(fd, sa_family);
+
+#if HAVE_DECL_UV_UDP_LINUX_RECVERR
+	(void)isc__nm_socket_recverr(fd, sa_family);
+#endif
+
+	if (bind(fd, &pb->local.type.sa, pb->local.length) != 0) {
+		result = isc_errno_toresult(errno);
+		isc__nm_closesocket(fd);
+		return (result);
+	}
+
+	pb->fd = fd;
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+udp_prebound_expire_cb(uv_timer_t *timer);
+
+static void
+udp_prebound_timer_close_cb(uv_handle_t *handle) {
+	isc__networker_t *worker = uv_handle_get_data(handle);
+
+	isc__networker_detach(&worker);
+}
+
+/*
+ * Arm the timer for the open socket in the pool that expires first,
+ * or stop it if there is none.
+ */
+static void
+udp_prebound_settimer(isc__networker_t *worker) {
+	isc__nm_udpprebound_t *pb = NULL;
+	uint64_t expires = UINT64_MAX;
+	uint64_t now;
+	int r;
+
+	if (worker->shuttingdown) {
+		return;
+	}
+
+	for (pb = ISC_LIST_HEAD(worker->udpprebound); pb != NULL;
+	     pb = ISC_LIST_NEXT(pb, link))
+	{
+		if (!pb->taken && pb->fd != -1 && pb->expires < expires) {
+			expires = pb->expires;
+		}
+	}
+
+	if (expires == UINT64_MAX) {
+		if (worker->udpprebound_timer_init) {
+			r = uv_timer_stop(&worker->udpprebound_timer);
+			UV_RUNTIME_CHECK(uv_timer_stop, r);
+		}
+		return;
+	}
+
+	if (!worker->udpprebound_timer_init) {
+		r = uv_timer_init(&worker->loop->loop,
+				  &worker->udpprebound_timer);
+		UV_RUNTIME_CHECK(uv_timer_init, r);
+		uv_handle_set_data((uv_handle_t *)&worker->udpprebound_timer,
+				   worker);
+		isc__networker_ref(worker);
+		worker->udpprebound_timer_init = true;
+	}
+
+	now = uv_now(&worker->loop->loop);
+	r = uv_timer_start(&worker->udpprebound_timer, udp_prebound_expire_cb,
+			   expires > now ? expires - now : 0, 0);
+	UV_RUNTIME_CHECK(uv_timer_start, r);
+}
+
+/*
+ * Close the open sockets in the pool whose lifetime is over.
+ */
+static void
+udp_prebound_expire_cb(uv_timer_t *timer) {
+	isc__networker_t *worker = uv_handle_get_data((uv_handle_t *)timer);
+	isc__nm_udpprebound_t *pb = NULL, *next = NULL;
+	uint64_t now = uv_now(&worker->loop->loop);
+
+	for (pb = ISC_LIST_HEAD(worker->udpprebound); pb != NULL; pb = next) {
+		next = ISC_LIST_NEXT(pb, link);
+
+		if (!pb->taken && pb->fd != -1 && pb->expires <= now) {
+			ISC_LIST_UNLINK(worker->udpprebound, pb, link);
+			udp_prebound_free(worker, &pb);
+		}
+	}
+
+	udp_prebound_settimer(worker);
+}
+
+/*
+ * Open the sockets added to the pool since the last run, and close
+ * the reserved ones that isc_nm_udpconnect() did not use.
+ */
+static void
+udp_prebind_cb(void *arg) {
+	isc__networker_t *worker = arg;
+	isc__nm_udpprebound_t *pb = NULL, *next = NULL;
+	uint64_t expires = uv_now(&worker->loop->loop) +
+			   ISC_NETMGR_UDPPREBOUND_LIFETIME;
+
+	worker->udpprebound_job = false;
+
+	for (pb = ISC_LIST_HEAD(worker->udpprebound); pb != NULL; pb = next) {
+		next = ISC_LIST_NEXT(pb, link);
+
+		if (pb->taken) {
+			ISC_LIST_UNLINK(worker->udpprebound, pb, link);
+			udp_prebound_free(worker, &pb);
+		} else if (pb->fd == -1) {
+			if (udp_prebound_open(pb) != ISC_R_SUCCESS) {
+				ISC_LIST_UNLINK(worker->udpprebound, pb, link);
+				udp_prebound_free(worker, &pb);
+				continue;
+			}
+			pb->expires = expires;
+		}
+	}
+
+	udp_prebound_settimer(worker);
+
+	isc__networker_detach(&worker);
+}
+
+static void
+udp_prebind_schedule(isc__networker_t *worker) {
+	if (worker->udpprebound_job) {
+		return;
+	}
+
+	worker->udpprebound_job = true;
+	isc__networker_ref(worker);
+	isc_async_run(worker->loop, udp_prebind_cb, worker);
+}
+
+void
+isc_nm_udpprebind(isc_nm_t *mgr, const isc_sockaddr_t *local) {
+	isc__networker_t *worker = NULL;
+	isc__nm_udpprebound_t *pb = NULL;
+
+	REQUIRE(VALID_NM(mgr));
+	REQUIRE(local != NULL);
+
+	worker = udp_prebind_worker(mgr);
+	if (worker == NULL) {
+		return;
+	}
+
+	pb = isc_mem_get(worker->mctx, sizeof(*pb));
+	*pb = (isc__nm_udpprebound_t){
+		.fd = -1,
+		.local = *local,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	ISC_LIST_APPEND(worker->udpprebound, pb, link);
+
+	udp_prebind_schedule(worker);
+}
+
+isc_result_t
+isc_nm_udptakeprebound(isc_nm_t *mgr, isc_sockaddr_t *local) {
+	isc__networker_t *worker = NULL;
+	isc__nm_udpprebound_t *pb = NULL;
+
+	REQUIRE(VALID_NM(mgr));
+	REQUIRE(local != NULL);
+
+	worker = udp_prebind_worker(mgr);
+	if (worker == NULL) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	for (pb = ISC_LIST_HEAD(worker->udpprebound); pb != NULL;
+	     pb = ISC_LIST_NEXT(pb, link))
+	{
+		if (pb->taken || pb->fd == -1 ||
+		    !isc_sockaddr_eqaddr(&pb->local, local))
+		{
+			continue;
+		}
+
+		/* The reserved sockets are kept at the head of the pool */
+		pb->taken = true;
+		ISC_LIST_UNLINK(worker->udpprebound, pb, link);
+		ISC_LIST_PREPEND(worker->udpprebound, pb, link);
+
+		isc_sockaddr_setport(local, isc_sockaddr_getport(&pb->local));
+		udp_prebind_schedule(worker);
+
+		return (ISC_R_SUCCESS);
+	}
+
+	return (ISC_R_NOTFOUND);
+}
+
+unsigned int
+isc_nm_udpprebound(isc_nm_t *mgr, const isc_sockaddr_t *local) {
+	isc__networker_t *worker = NULL;
+	isc__nm_udpprebound_t *pb = NULL;
+	unsigned int count = 0;
+
+	REQUIRE(VALID_NM(mgr));
+	REQUIRE(local != NULL);
+
+	worker = udp_prebind_worker(mgr);
+	if (worker == NULL) {
+		return (0);
+	}
+
+	for (pb = ISC_LIST_HEAD(worker->udpprebound); pb != NULL;
+	     pb = ISC_LIST_NEXT(pb, link))
+	{
+		if (!pb->taken && isc_sockaddr_eqaddr(&pb->local, local)) {
+			count++;
+		}
+	}
+
+	return (count);
+}
+
+/*
+ * Take the socket reserved for 'local' out of the pool, if there is one.
+ */
+static uv_os_sock_t
+udp_prebound_get(isc__networker_t *worker, const isc_sockaddr_t *local) {
+	isc__nm_udpprebound_t *pb = NULL;
+	uv_os_sock_t fd = -1;
+
+	for (pb = ISC_LIST_HEAD(worker->udpprebound);
+	     pb != NULL && pb->taken; pb = ISC_LIST_NEXT(pb, link))
+	{
+		if (isc_sockaddr_equal(&pb->local, local)) {
+			ISC_LIST_UNLINK(worker->udpprebound, pb, link);
+			fd = pb->fd;
+			pb->fd = -1;
+			udp_prebound_free(worker, &pb);
+			break;
+		}
+	}
+
+	return (fd);
+}
+
+void
+isc__nm_udp_prebind_shutdown(isc__networker_t *worker) {
+	isc__nm_udpprebound_t *pb = NULL;
+
+	REQUIRE(worker->shuttingdown);
+
+	while ((pb = ISC_LIST_HEAD(worker->udpprebound)) != NULL) {
+		ISC_LIST_UNLINK(worker->udpprebound, pb, link);
+		udp_prebound_free(worker, &pb);
+	}
+
+	if (worker->udpprebound_timer_init) {
+		worker->udpprebound_timer_init = false;
+		uv_close((uv_handle_t *)&worker->udpprebound_timer,
+			 udp_prebound_timer_close_cb);
+	}
+}
+
+/*
+ * Drop the datagrams queued on a pooled socket before it was connected.
+ * While the socket was bound but not connected, anyone could send to
+ * its port, and those datagrams stay readable after the connect().
+ */
+static void
+udp_prebound_drain(uv_os_sock_t fd) {
+	unsigned char buf[1];
+	ssize_t n;
+
+	do {
+		n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+	} while (n >= 0 || errno == EINTR || errno == ECONNREFUSED);
+}
+
+/*
+ * If 'bound' is true, the socket comes bound from the pool filled by
+ * isc_nm_udpprebind().
+ */
 static isc_result_t
-udp_connect_direct(isc_nmsocket_t *sock, isc__nm_uvreq_t *req) {
+udp_connect_direct(isc_nmsocket_t *sock, isc__nm_uvreq_t *req, bool bound) {
 	int uv_bind_flags = UV_UDP_REUSEADDR;
 	int r;
 	isc__networker_t *worker = sock->worker;
@@ -778,11 +1399,13 @@ udp_connect_direct(isc_nmsocket_t *sock, isc__nm_uvreq_t *req) {
 	uv_bind_flags |= UV_UDP_LINUX_RECVERR;
 #endif
 
-	r = uv_udp_bind(&sock->uv_handle.udp, &sock->iface.type.sa,
-			uv_bind_flags);
-	if (r != 0) {
-		isc__nm_incstats(sock, STATID_BINDFAIL);
-		return (isc_uverr2result(r));
+	if (!bound) {
+		r = uv_udp_bind(&sock->uv_handle.udp, &sock->iface.type.sa,
+				uv_bind_flags);
+		if (r != 0) {
+			isc__nm_incstats(sock, STATID_BINDFAIL);
+			return (isc_uverr2result(r));
+		}
 	}
 
 	isc__nm_set_network_buffers(sock->worker->netmgr,
@@ -802,6 +1425,10 @@ udp_connect_direct(isc_nmsocket_t *sock, isc__nm_uvreq_t *req) {
 	}
 	isc__nm_incstats(sock, STATID_CONNECT);
 
+	if (bound) {
+		udp_prebound_drain(sock->fd);
+	}
+
 	return (ISC_R_SUCCESS);
 }
 
@@ -814,6 +1441,7 @@ isc_nm_udpconnect(isc_nm_t *mgr, isc_sockaddr_t *local, isc_sockaddr_t *peer,
 	sa_family_t sa_family;
 	isc__networker_t *worker = &mgr->workers[isc_tid()];
 	uv_os_sock_t fd = -1;
+	bool bound = false;
 
 	REQUIRE(VALID_NM(mgr));
 	REQUIRE(local != NULL);
@@ -826,10 +1454,15 @@ isc_nm_udpconnect(isc_nm_t *mgr, isc_sockaddr_t *local, isc_sockaddr_t *peer,
 
 	sa_family = peer->type.sa.sa_family;
 
-	result = isc__nm_socket(sa_family, SOCK_DGRAM, 0, &fd);
-	if (result != ISC_R_SUCCESS) {
-		cb(NULL, result, cbarg);
-		return;
+	fd = udp_prebound_get(worker, local);
+	if (fd == -1) {
+		result = isc__nm_socket(sa_family, SOCK_DGRAM, 0, &fd);
+		if (result != ISC_R_SUCCESS) {
+			cb(NULL, result, cbarg);
+			return;
+		}
+	} else {
+		bound = true;
 	}
 
 	/* Initialize the new socket */
@@ -854,6 +1487,15 @@ isc_nm_udpconnect(isc_nm_t *mgr, isc_sockaddr_t *local, isc_sockaddr_t *peer,
 
 	(void)isc__nm_socket_min_mtu(sock->fd, sa_family);
 
+#if HAVE_LIBURING
+	/*
+	 * Send the query through the worker's ring, so the queries sent
+	 * by one loop iteration are handed to the kernel together; the
+	 * response is still read with libuv.
+	 */
+	sock->uring_send = (mgr->backend == isc_nm_backend_uring);
+#endif /* HAVE_LIBURING */
+
 	/* Initialize the request */
 	req = isc__nm_uvreq_get(worker, sock);
 	req->cb.connect = cb;
@@ -865,7 +1507,7 @@ isc_nm_udpconnect(isc_nm_t *mgr, isc_sockaddr_t *local, isc_sockaddr_t *peer,
 	atomic_store(&sock->active, true);
 	atomic_store(&sock->connecting, true);
 
-	result = udp_connect_direct(sock, req);
+	result = udp_connect_direct(sock, req, bound);
 	if (result != ISC_R_SUCCESS) {
 		atomic_store(&sock->active, false);
 		isc__nm_failed_connect_cb(sock, req, result, true);
@@ -1032,6 +1674,16 @@ isc__nm_udp_close(isc_nmsocket_t *sock) {
 	/* 2. close the listening socket */
 	isc__nmsocket_clearcb(sock);
 	isc__nm_stop_reading(sock);
+#if HAVE_LIBURING
+	/*
+	 * The queued sendmsg operations refer to the descriptor by its
+	 * number, so they have to reach the kernel before it is closed
+	 * and the number reused.
+	 */
+	if (sock->uring_send) {
+		isc__nm_uring_submit(sock->worker);
+	}
+#endif /* HAVE_LIBURING */
 	uv_close(&sock->uv_handle.handle, udp_close_cb);
 
 	/* 1. close the read timer */
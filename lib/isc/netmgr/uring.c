@@ -0,0 +1,621 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * The io_uring backend for the UDP sockets.
+ *
+ * Every worker (loop) has its own ring, created when the first socket
+ * starts using it.  The listening sockets keep a multishot recvmsg
+ * operation armed that picks the receive buffers from a buffer ring
+ * registered with the kernel, so a burst of queries needs neither a
+ * readiness notification nor a syscall per datagram.  The responses are
+ * queued as sendmsg operations and submitted together at most once per
+ * event loop iteration, along with the recycled receive buffers.
+ *
+ * The outgoing queries use the same send path: every query has its own
+ * connected socket, so sendmmsg(2) can't batch them, but the sendmsg
+ * operations queued for different sockets during one loop iteration are
+ * still submitted with a single io_uring_enter(2) call.
+ *
+ * The completions are reaped when libuv reports the ring descriptor as
+ * readable, so the ring is driven by the same event loop as the rest of
+ * the netmgr.
+ */
+
+#include <errno.h>
+#include <liburing.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <isc/log.h>
+#include <isc/mem.h>
+#include <isc/netmgr.h>
+#include <isc/result.h>
+#include <isc/util.h>
+#include <isc/uv.h>
+
+#include "../loop_p.h"
+#include "netmgr-int.h"
+
+/*
+ * The number of submission queue entries, the completion queue is twice
+ * as big.
+ */
+#define URING_ENTRIES 256
+
+/*
+ * The receive buffers: every buffer holds the io_uring_recvmsg_out
+ * header, the peer address, and a maximum sized datagram.  The number of
+ * buffers has to be a power of two.
+ */
+#define URING_BUFS    32
+#define URING_BGID    0
+#define URING_NAMELEN sizeof(struct sockaddr_in6)
+#define URING_BUFSIZE                                                   \
+	ISC_ALIGN(sizeof(struct io_uring_recvmsg_out) + URING_NAMELEN + \
+			  UINT16_MAX,                                   \
+		  sizeof(void *))
+
+/*
+ * The operation type is stored in the low bits of the user data, next to
+ * the socket (receive) or the request (send) pointer.
+ */
+#define URING_OP_RECV	0x0
+#define URING_OP_SEND	0x1
+#define URING_OP_CANCEL 0x2
+#define URING_OP_MASK	0x3
+
+#define URING_DATA(ptr, op) ((void *)((uintptr_t)(ptr) | (op)))
+
+STATIC_ASSERT(sizeof(uv_buf_t) == sizeof(struct iovec) &&
+		      offsetof(uv_buf_t, base) ==
+			      offsetof(struct iovec, iov_base) &&
+		      offsetof(uv_buf_t, len) ==
+			      offsetof(struct iovec, iov_len),
+	      "uv_buf_t must be compatible with struct iovec");
+
+struct isc__nm_uring {
+	isc__networker_t *worker;
+	struct io_uring ring;
+	struct io_uring_buf_ring *br;
+	uint8_t *bufs;
+	uv_poll_t poll;
+	uv_prepare_t prepare;
+	size_t inflight; /* operations holding a reference */
+	bool closing;
+};
+
+static void
+uring_poll_cb(uv_poll_t *handle, int status, int events);
+
+static void
+uring_prepare_cb(uv_prepare_t *handle);
+
+/*
+ * The multishot recvmsg (Linux 6.0) is a flag of IORING_OP_RECVMSG, so
+ * it can't be found with the opcode probe; arm one on a scratch socket
+ * that has a datagram waiting, and check that the kernel takes a buffer
+ * from the buffer ring and keeps the receive armed.
+ */
+static bool
+uring_probe_multishot(struct io_uring *ring, struct io_uring_buf_ring *br) {
+	struct sockaddr_in sin = { .sin_family = AF_INET };
+	socklen_t sinlen = sizeof(sin);
+	struct msghdr msg = { 0 };
+	struct io_uring_sqe *sqe = NULL;
+	struct io_uring_cqe *cqe = NULL;
+	uint8_t buf[sizeof(struct io_uring_recvmsg_out) + 16];
+	bool supported = false;
+	int fd;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		return (false);
+	}
+
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(fd, (struct sockaddr *)&sin, sizeof(sin)) != 0 ||
+	    getsockname(fd, (struct sockaddr *)&sin, &sinlen) != 0 ||
+	    connect(fd, (struct sockaddr *)&sin, sinlen) != 0 ||
+	    send(fd, "", 1, 0) != 1)
+	{
+		goto cleanup;
+	}
+
+	io_uring_buf_ring_add(br, buf, sizeof(buf), 0,
+			      io_uring_buf_ring_mask(1), 0);
+	io_uring_buf_ring_advance(br, 1);
+
+	sqe = io_uring_get_sqe(ring);
+	io_uring_prep_recvmsg_multishot(sqe, fd, &msg, 0);
+	sqe->flags |= IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_BGID;
+
+	if (io_uring_submit_and_wait(ring, 1) < 0 ||
+	    io_uring_peek_cqe(ring, &cqe) != 0)
+	{
+		goto cleanup;
+	}
+
+	supported = (cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER) != 0 &&
+		     (cqe->flags & IORING_CQE_F_MORE) != 0);
+	io_uring_cqe_seen(ring, cqe);
+
+cleanup:
+	/* Closing the ring cancels the receive, if it's still armed */
+	close(fd);
+	return (supported);
+}
+
+bool
+isc__nm_uring_supported(void) {
+	struct io_uring ring;
+	struct io_uring_probe *probe = NULL;
+	struct io_uring_buf_ring *br = NULL;
+	bool supported = false;
+	int r;
+
+	if (io_uring_queue_init(2, &ring, 0) != 0) {
+		return (false);
+	}
+
+	probe = io_uring_get_probe_ring(&ring);
+	if (probe != NULL) {
+		supported = io_uring_opcode_supported(probe,
+						      IORING_OP_RECVMSG) &&
+			    io_uring_opcode_supported(probe,
+						      IORING_OP_SENDMSG) &&
+			    io_uring_opcode_supported(probe,
+						      IORING_OP_ASYNC_CANCEL);
+		io_uring_free_probe(probe);
+	}
+
+	/*
+	 * The receive buffers are provided through a buffer ring
+	 * (Linux 5.19).
+	 */
+	if (supported) {
+		br = io_uring_setup_buf_ring(&ring, 1, URING_BGID, 0, &r);
+		supported = (br != NULL);
+	}
+
+	if (supported) {
+		supported = uring_probe_multishot(&ring, br);
+		io_uring_free_buf_ring(&ring, br, 1, URING_BGID);
+	}
+
+	io_uring_queue_exit(&ring);
+
+	return (supported);
+}
+
+static void
+uring_buf_recycle(isc__nm_uring_t *uring, uint16_t bid) {
+	io_uring_buf_ring_add(uring->br, uring->bufs + bid * URING_BUFSIZE,
+			      URING_BUFSIZE, bid,
+			      io_uring_buf_ring_mask(URING_BUFS), 0);
+	io_uring_buf_ring_advance(uring->br, 1);
+}
+
+static isc__nm_uring_t *
+uring_get(isc__networker_t *worker) {
+	isc__nm_uring_t *uring = worker->uring;
+	uv_loop_t *loop = &worker->loop->loop;
+	int r;
+
+	if (uring != NULL) {
+		return (uring);
+	}
+
+	uring = isc_mem_get(worker->mctx, sizeof(*uring));
+	*uring = (isc__nm_uring_t){ 0 };
+
+	r = io_uring_queue_init(URING_ENTRIES, &uring->ring, 0);
+	if (r < 0) {
+		goto fail;
+	}
+
+	uring->br = io_uring_setup_buf_ring(&uring->ring, URING_BUFS,
+					    URING_BGID, 0, &r);
+	if (uring->br == NULL) {
+		io_uring_queue_exit(&uring->ring);
+		goto fail;
+	}
+
+	uring->bufs = isc_mem_get(worker->mctx, URING_BUFS * URING_BUFSIZE);
+	for (uint16_t bid = 0; bid < URING_BUFS; bid++) {
+		uring_buf_recycle(uring, bid);
+	}
+
+	r = uv_poll_init(loop, &uring->poll, uring->ring.ring_fd);
+	UV_RUNTIME_CHECK(uv_poll_init, r);
+	uv_handle_set_data((uv_handle_t *)&uring->poll, uring);
+
+	r = uv_poll_start(&uring->poll, UV_READABLE, uring_poll_cb);
+	UV_RUNTIME_CHECK(uv_poll_start, r);
+
+	r = uv_prepare_init(loop, &uring->prepare);
+	UV_RUNTIME_CHECK(uv_prepare_init, r);
+	uv_handle_set_data((uv_handle_t *)&uring->prepare, uring);
+
+	r = uv_prepare_start(&uring->prepare, uring_prepare_cb);
+	UV_RUNTIME_CHECK(uv_prepare_start, r);
+
+	isc__networker_attach(worker, &uring->worker);
+	worker->uring = uring;
+
+	return (uring);
+
+fail:
+	isc__netmgr_log(worker->netmgr, ISC_LOG_WARNING,
+			"io_uring setup failed: %s, using libuv instead",
+			isc_result_totext(isc_uverr2result(r)));
+	isc_mem_put(worker->mctx, uring, sizeof(*uring));
+	return (NULL);
+}
+
+static void
+uring_close_cb(uv_handle_t *handle) {
+	isc__nm_uring_t *uring = uv_handle_get_data(handle);
+	isc__networker_t *worker = uring->worker;
+
+	INSIST(uring->inflight == 0);
+
+	io_uring_free_buf_ring(&uring->ring, uring->br, URING_BUFS,
+			       URING_BGID);
+	io_uring_queue_exit(&uring->ring);
+
+	isc_mem_put(worker->mctx, uring->bufs, URING_BUFS * URING_BUFSIZE);
+	isc_mem_put(worker->mctx, uring, sizeof(*uring));
+
+	isc__networker_detach(&worker);
+}
+
+static void
+uring_close(isc__nm_uring_t *uring) {
+	uring->worker->uring = NULL;
+
+	/*
+	 * The close callbacks are called in the reverse order, so the
+	 * prepare handle is gone by the time the ring is destroyed.
+	 */
+	uv_close((uv_handle_t *)&uring->poll, uring_close_cb);
+	uv_close((uv_handle_t *)&uring->prepare, NULL);
+}
+
+static void
+uring_submit(isc__nm_uring_t *uring) {
+	if (io_uring_sq_ready(&uring->ring) > 0) {
+		(void)io_uring_submit(&uring->ring);
+	}
+}
+
+static struct io_uring_sqe *
+uring_sqe(isc__nm_uring_t *uring) {
+	struct io_uring_sqe *sqe = io_uring_get_sqe(&uring->ring);
+
+	if (sqe == NULL) {
+		/* The submission queue is full, make some room */
+		(void)io_uring_submit(&uring->ring);
+		sqe = io_uring_get_sqe(&uring->ring);
+	}
+
+	return (sqe);
+}
+
+int
+isc__nm_uring_udp_start(isc_nmsocket_t *sock) {
+	isc__nm_uring_t *uring = NULL;
+	struct io_uring_sqe *sqe = NULL;
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->type == isc_nm_udpsocket);
+	REQUIRE(sock->parent != NULL);
+	REQUIRE(sock->tid == isc_tid());
+
+	if (sock->uring_recv) {
+		/*
+		 * The receive is being canceled, it will be re-armed when
+		 * the cancellation completes.
+		 */
+		return (0);
+	}
+
+	if (isc__nm_closing(sock->worker)) {
+		return (UV_ECANCELED);
+	}
+
+	uring = uring_get(sock->worker);
+	if (uring == NULL) {
+		return (UV_ENOTSUP);
+	}
+
+	sqe = uring_sqe(uring);
+	if (sqe == NULL) {
+		return (UV_ENOBUFS);
+	}
+
+	sock->uring_msg = (struct msghdr){ .msg_namelen = URING_NAMELEN };
+
+	io_uring_prep_recvmsg_multishot(sqe, sock->fd, &sock->uring_msg, 0);
+	sqe->flags |= IOSQE_BUFFER_SELECT;
+	sqe->buf_group = URING_BGID;
+	io_uring_sqe_set_data(sqe, URING_DATA(sock, URING_OP_RECV));
+
+	isc__nmsocket_attach(sock, &(isc_nmsocket_t *){ NULL });
+	sock->uring_recv = true;
+	uring->inflight++;
+
+	return (0);
+}
+
+void
+isc__nm_uring_udp_stop(isc_nmsocket_t *sock) {
+	isc__nm_uring_t *uring = NULL;
+	struct io_uring_sqe *sqe = NULL;
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->tid == isc_tid());
+
+	uring = sock->worker->uring;
+	if (!sock->uring_recv || uring == NULL) {
+		return;
+	}
+
+	sqe = uring_sqe(uring);
+	if (sqe == NULL) {
+		/*
+		 * This only happens when the kernel refuses to take the
+		 * queued operations, there's nothing else left to try.
+		 */
+		return;
+	}
+
+	io_uring_prep_cancel(sqe, URING_DATA(sock, URING_OP_RECV), 0);
+	io_uring_sqe_set_data(sqe, URING_DATA(NULL, URING_OP_CANCEL));
+
+	uring_submit(uring);
+}
+
+isc_result_t
+isc__nm_uring_udp_send(isc_nmsocket_t *sock, isc__nm_uvreq_t *req) {
+	isc__nm_uring_t *uring = NULL;
+	struct io_uring_sqe *sqe = NULL;
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(VALID_UVREQ(req));
+	REQUIRE(sock->tid == isc_tid());
+
+	if (isc__nm_closing(sock->worker)) {
+		return (ISC_R_SHUTTINGDOWN);
+	}
+
+	uring = uring_get(sock->worker);
+	if (uring == NULL) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+	if (uring->closing) {
+		return (ISC_R_SHUTTINGDOWN);
+	}
+
+	sqe = uring_sqe(uring);
+	if (sqe == NULL) {
+		return (ISC_R_NOMORE);
+	}
+
+	req->uv_req.msghdr = (struct msghdr){
+		.msg_iov = (struct iovec *)&req->uvbuf,
+		.msg_iovlen = 1,
+	};
+
+	/* The outgoing sockets are connected, they must not name the peer */
+	if (!atomic_load(&sock->connected)) {
+		req->uv_req.msghdr.msg_name = &req->peer.type.sa;
+		req->uv_req.msghdr.msg_namelen = req->peer.length;
+	}
+
+	io_uring_prep_sendmsg(sqe, sock->fd, &req->uv_req.msghdr, 0);
+	io_uring_sqe_set_data(sqe, URING_DATA(req, URING_OP_SEND));
+
+	uring->inflight++;
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+udp_recv_fallback(isc_nmsocket_t *sock) {
+	int r;
+
+	isc__netmgr_log(sock->worker->netmgr, ISC_LOG_WARNING,
+			"io_uring multishot receive not supported, "
+			"using libuv instead");
+
+	sock->uring = false;
+	if (!sock->reading) {
+		return;
+	}
+
+	r = uv_udp_recv_start(&sock->uv_handle.udp, isc__nm_alloc_cb,
+			      isc__nm_udp_read_cb);
+	if (r != 0) {
+		isc__nm_udp_recv_datagram(sock, r, NULL, NULL, 0);
+	}
+}
+
+static void
+udp_recv_cqe(isc__nm_uring_t *uring, isc_nmsocket_t *sock,
+	     struct io_uring_cqe *cqe) {
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->tid == isc_tid());
+
+	if ((cqe->flags & IORING_CQE_F_BUFFER) != 0) {
+		uint16_t bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+		uint8_t *buf = uring->bufs + bid * URING_BUFSIZE;
+		struct io_uring_recvmsg_out *out = NULL;
+
+		out = io_uring_recvmsg_validate(buf, cqe->res,
+						&sock->uring_msg);
+		if (sock->reading && out != NULL &&
+		    out->namelen <= URING_NAMELEN &&
+		    (out->flags & MSG_TRUNC) == 0)
+		{
+			uv_buf_t region = {
+				.base = io_uring_recvmsg_payload(
+					out, &sock->uring_msg),
+				.len = io_uring_recvmsg_payload_length(
+					out, cqe->res, &sock->uring_msg),
+			};
+
+			isc__nm_udp_recv_datagram(sock, region.len, &region,
+						  io_uring_recvmsg_name(out),
+						  0);
+		}
+
+		uring_buf_recycle(uring, bid);
+	}
+
+	if ((cqe->flags & IORING_CQE_F_MORE) != 0) {
+		return;
+	}
+
+	/*
+	 * The multishot receive is over, either because it was canceled,
+	 * or because the kernel ran out of the buffers or hit an error;
+	 * re-arm it in the latter cases.
+	 */
+	sock->uring_recv = false;
+
+	switch (cqe->res) {
+	case -EINVAL:
+		udp_recv_fallback(sock);
+		break;
+	case -ECANCELED:
+	case -ENOBUFS:
+		break;
+	default:
+		if (cqe->res < 0 && sock->reading) {
+			isc__nm_udp_recv_datagram(sock, cqe->res, NULL, NULL,
+						  0);
+		}
+	}
+
+	if (sock->uring && sock->reading && !isc__nmsocket_closing(sock)) {
+		int r = isc__nm_uring_udp_start(sock);
+		if (r != 0) {
+			isc__nm_udp_recv_datagram(sock, r, NULL, NULL, 0);
+		}
+	}
+
+	uring->inflight--;
+	isc__nmsocket_detach(&sock);
+}
+
+static void
+udp_send_cqe(isc__nm_uring_t *uring, isc__nm_uvreq_t *req,
+	     struct io_uring_cqe *cqe) {
+	isc_nmsocket_t *sock = NULL;
+
+	REQUIRE(VALID_UVREQ(req));
+	REQUIRE(VALID_NMHANDLE(req->handle));
+
+	sock = req->sock;
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->tid == isc_tid());
+
+	uring->inflight--;
+
+	if (cqe->res < 0) {
+		isc__nm_incstats(sock, STATID_SENDFAIL);
+		isc__nm_failed_send_cb(sock, req, isc_uverr2result(cqe->res),
+				       false);
+		return;
+	}
+
+	isc__nm_sendcb(sock, req, ISC_R_SUCCESS, false);
+}
+
+static void
+uring_poll_cb(uv_poll_t *handle, int status, int events) {
+	isc__nm_uring_t *uring = uv_handle_get_data((uv_handle_t *)handle);
+	struct io_uring_cqe *cqe = NULL;
+	unsigned int head, count = 0;
+
+	UNUSED(status);
+	UNUSED(events);
+
+	io_uring_for_each_cqe(&uring->ring, head, cqe) {
+		uintptr_t data = (uintptr_t)io_uring_cqe_get_data(cqe);
+		void *ptr = (void *)(data & ~(uintptr_t)URING_OP_MASK);
+
+		switch (data & URING_OP_MASK) {
+		case URING_OP_RECV:
+			udp_recv_cqe(uring, ptr, cqe);
+			break;
+		case URING_OP_SEND:
+			udp_send_cqe(uring, ptr, cqe);
+			break;
+		case URING_OP_CANCEL:
+			break;
+		default:
+			UNREACHABLE();
+		}
+		count++;
+	}
+	io_uring_cq_advance(&uring->ring, count);
+
+	/*
+	 * Submit the responses sent and the receives re-armed while
+	 * processing the completions in one go.
+	 */
+	uring_submit(uring);
+
+	if (uring->closing && uring->inflight == 0) {
+		uring_close(uring);
+	}
+}
+
+static void
+uring_prepare_cb(uv_prepare_t *handle) {
+	isc__nm_uring_t *uring = uv_handle_get_data((uv_handle_t *)handle);
+
+	uring_submit(uring);
+}
+
+void
+isc__nm_uring_submit(isc__networker_t *worker) {
+	if (worker->uring != NULL) {
+		uring_submit(worker->uring);
+	}
+}
+
+void
+isc__nm_uring_shutdown(isc__networker_t *worker) {
+	isc__nm_uring_t *uring = worker->uring;
+
+	if (uring == NULL) {
+		return;
+	}
+
+	uring->closing = true;
+	uring_submit(uring);
+
+	if (uring->inflight == 0) {
+		uring_close(uring);
+	}
+}
@@ -0,0 +1,401 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file
+ * Hierarchical timing wheel, after:
+ *
+ *	\li "Hashed and Hierarchical Timing Wheels: Data Structures for the
+ *	Efficient Implementation of a Timer Facility," Varghese and Lauck,
+ *	Proceedings of the 11th ACM Symposium on Operating Systems
+ *	Principles, 1987.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/util.h>
+#include <isc/wheel.h>
+
+#define WHEEL_MAGIC    ISC_MAGIC('W', 'H', 'E', 'L')
+#define VALID_WHEEL(w) ISC_MAGIC_VALID(w, WHEEL_MAGIC)
+
+/*@{*/
+/*%
+ * Each level has 64 slots, so that the slots in use at a level fit in
+ * one word, and six levels cover all 32 bits of an isc_stdtime_t.
+ */
+#define WHEEL_BITS   6
+#define WHEEL_SLOTS  (1 << WHEEL_BITS)
+#define WHEEL_MASK   (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 6
+/*@}*/
+
+#define SIZE_INCREMENT 1024
+
+/*@{*/
+/*%
+ * The elements are kept in one array, and the slots are circular
+ * doubly-linked lists through it, threaded by array index.  The first
+ * entries of the array are the list heads: the "due" list, and one
+ * list per slot.  Element indices start after them, and index 0 is
+ * never used.
+ */
+#define DUE		 1
+#define SLOT(level, num) (DUE + 1 + (level) * WHEEL_SLOTS + (num))
+#define NLISTS		 (DUE + WHEEL_LEVELS * WHEEL_SLOTS)
+#define FIRST		 (NLISTS + 1)
+/*@}*/
+
+typedef struct wheelentry {
+	void *elt;
+	isc_stdtime_t when;
+	unsigned int prev;
+	unsigned int next;
+} wheelentry_t;
+
+struct isc_wheel {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_wheelindex_t index;
+	isc_stdtime_t now;
+	size_t count;
+	unsigned int size;
+	unsigned int last;
+	unsigned int freelist;
+	wheelentry_t *entries;
+	uint64_t inuse[WHEEL_LEVELS];
+};
+
+static void
+unlink_entry(isc_wheel_t *wheel, unsigned int idx) {
+	wheelentry_t *e = &wheel->entries[idx];
+	unsigned int prev = e->prev, next = e->next;
+
+	wheel->entries[prev].next = next;
+	wheel->entries[next].prev = prev;
+	if (prev == next && prev != DUE) {
+		/* The slot is now empty */
+		unsigned int slot = prev - SLOT(0, 0);
+		wheel->inuse[slot / WHEEL_SLOTS] &=
+			~((uint64_t)1 << (slot % WHEEL_SLOTS));
+	}
+	e->prev = e->next = 0;
+}
+
+static void
+link_entry(isc_wheel_t *wheel, unsigned int list, unsigned int idx) {
+	wheelentry_t *e = &wheel->entries[idx];
+	unsigned int tail = wheel->entries[list].prev;
+
+	e->prev = tail;
+	e->next = list;
+	wheel->entries[tail].next = idx;
+	wheel->entries[list].prev = idx;
+	if (list != DUE) {
+		unsigned int slot = list - SLOT(0, 0);
+		wheel->inuse[slot / WHEEL_SLOTS] |= (uint64_t)1
+						    << (slot % WHEEL_SLOTS);
+	}
+}
+
+/*
+ * Put an element in the slot for its time: at the level of the highest
+ * bit in which its time differs from the wheel's clock.
+ */
+static void
+place(isc_wheel_t *wheel, unsigned int idx) {
+	isc_stdtime_t when = wheel->entries[idx].when;
+	unsigned int level, num;
+
+	if (when <= wheel->now) {
+		link_entry(wheel, DUE, idx);
+		return;
+	}
+
+	level = (31 - __builtin_clz(when ^ wheel->now)) / WHEEL_BITS;
+	num = (when >> (level * WHEEL_BITS)) & WHEEL_MASK;
+	link_entry(wheel, SLOT(level, num), idx);
+}
+
+/*
+ * Move a whole level 0 slot, all of whose elements are due now, to the
+ * back of the due list.
+ */
+static void
+splice_due(isc_wheel_t *wheel, unsigned int num) {
+	wheelentry_t *entries = wheel->entries;
+	unsigned int list = SLOT(0, num);
+	unsigned int first = entries[list].next;
+	unsigned int last = entries[list].prev;
+	unsigned int tail = entries[DUE].prev;
+
+	if (first == list) {
+		return;
+	}
+
+	entries[tail].next = first;
+	entries[first].prev = tail;
+	entries[last].next = DUE;
+	entries[DUE].prev = last;
+	entries[list].next = entries[list].prev = list;
+	wheel->inuse[0] &= ~((uint64_t)1 << num);
+}
+
+/*
+ * The clock has just reached a multiple of WHEEL_SLOTS; redistribute
+ * the slots of the higher levels that have now come round.
+ */
+static void
+cascade(isc_wheel_t *wheel) {
+	isc_stdtime_t now = wheel->now;
+	unsigned int top = 1;
+
+	while (top < WHEEL_LEVELS - 1 &&
+	       ((now >> (top * WHEEL_BITS)) & WHEEL_MASK) == 0)
+	{
+		top++;
+	}
+
+	for (unsigned int level = top; level > 0; level--) {
+		unsigned int num = (now >> (level * WHEEL_BITS)) & WHEEL_MASK;
+		unsigned int list = SLOT(level, num);
+		unsigned int idx;
+
+		if ((wheel->inuse[level] & ((uint64_t)1 << num)) == 0) {
+			continue;
+		}
+		while ((idx = wheel->entries[list].next) != list) {
+			unlink_entry(wheel, idx);
+			place(wheel, idx);
+		}
+	}
+}
+
+static bool
+idle(isc_wheel_t *wheel) {
+	for (unsigned int level = 0; level < WHEEL_LEVELS; level++) {
+		if (wheel->inuse[level] != 0) {
+			return (false);
+		}
+	}
+	return (true);
+}
+
+static void
+advance(isc_wheel_t *wheel, isc_stdtime_t to) {
+	while (wheel->now < to) {
+		isc_stdtime_t now = wheel->now;
+		unsigned int num = now & WHEEL_MASK;
+		uint64_t later = wheel->inuse[0] & ~((UINT64_C(2) << num) - 1);
+
+		if (idle(wheel)) {
+			wheel->now = to;
+			return;
+		}
+
+		if (later != 0) {
+			/* The next occupied second in this window */
+			isc_stdtime_t next = (now & ~(isc_stdtime_t)WHEEL_MASK) |
+					     __builtin_ctzll(later);
+			if (next > to) {
+				wheel->now = to;
+				return;
+			}
+			wheel->now = next;
+			splice_due(wheel, next & WHEEL_MASK);
+			continue;
+		}
+
+		/* Nothing more in this window; move on to the next one */
+		if ((now | WHEEL_MASK) >= to) {
+			wheel->now = to;
+			return;
+		}
+		wheel->now = (now | WHEEL_MASK) + 1;
+		cascade(wheel);
+		splice_due(wheel, 0);
+	}
+}
+
+static void
+resize(isc_wheel_t *wheel) {
+	unsigned int new_size = wheel->size + ISC_MAX(wheel->size / 2,
+						      SIZE_INCREMENT);
+
+	wheel->entries = isc_mem_reget(wheel->mctx, wheel->entries,
+				       wheel->size * sizeof(wheel->entries[0]),
+				       new_size * sizeof(wheel->entries[0]));
+	wheel->size = new_size;
+}
+
+void
+isc_wheel_create(isc_mem_t *mctx, isc_stdtime_t now, isc_wheelindex_t index,
+		 isc_wheel_t **wheelp) {
+	isc_wheel_t *wheel = NULL;
+
+	REQUIRE(wheelp != NULL && *wheelp == NULL);
+	REQUIRE(index != NULL);
+
+	wheel = isc_mem_get(mctx, sizeof(*wheel));
+	*wheel = (isc_wheel_t){
+		.magic = WHEEL_MAGIC,
+		.index = index,
+		.now = now,
+		.size = FIRST,
+		.last = NLISTS,
+	};
+	isc_mem_attach(mctx, &wheel->mctx);
+
+	wheel->entries = isc_mem_get(mctx,
+				     wheel->size * sizeof(wheel->entries[0]));
+	for (unsigned int i = 0; i <= NLISTS; i++) {
+		wheel->entries[i] = (wheelentry_t){ .prev = i, .next = i };
+	}
+
+	*wheelp = wheel;
+}
+
+void
+isc_wheel_destroy(isc_wheel_t **wheelp) {
+	isc_wheel_t *wheel = NULL;
+
+	REQUIRE(wheelp != NULL);
+	wheel = *wheelp;
+	*wheelp = NULL;
+	REQUIRE(VALID_WHEEL(wheel));
+
+	isc_mem_put(wheel->mctx, wheel->entries,
+		    wheel->size * sizeof(wheel->entries[0]));
+	wheel->magic = 0;
+	isc_mem_putanddetach(&wheel->mctx, wheel, sizeof(*wheel));
+}
+
+void
+isc_wheel_insert(isc_wheel_t *wheel, void *elt, isc_stdtime_t when) {
+	unsigned int idx;
+
+	REQUIRE(VALID_WHEEL(wheel));
+	REQUIRE(elt != NULL);
+
+	if (wheel->freelist != 0) {
+		idx = wheel->freelist;
+		wheel->freelist = wheel->entries[idx].next;
+	} else {
+		if (wheel->last + 1 == wheel->size) {
+			resize(wheel);
+		}
+		idx = ++wheel->last;
+	}
+
+	wheel->entries[idx] = (wheelentry_t){ .elt = elt, .when = when };
+	place(wheel, idx);
+	wheel->count++;
+
+	(wheel->index)(elt, idx);
+}
+
+void
+isc_wheel_delete(isc_wheel_t *wheel, unsigned int idx) {
+	wheelentry_t *e = NULL;
+
+	REQUIRE(VALID_WHEEL(wheel));
+	REQUIRE(idx >= FIRST && idx <= wheel->last);
+
+	e = &wheel->entries[idx];
+	INSIST(e->elt != NULL);
+
+	unlink_entry(wheel, idx);
+	(wheel->index)(e->elt, 0);
+	e->elt = NULL;
+	e->next = wheel->freelist;
+	wheel->freelist = idx;
+	wheel->count--;
+}
+
+void
+isc_wheel_update(isc_wheel_t *wheel, unsigned int idx, isc_stdtime_t when) {
+	REQUIRE(VALID_WHEEL(wheel));
+	REQUIRE(idx >= FIRST && idx <= wheel->last);
+	INSIST(wheel->entries[idx].elt != NULL);
+
+	unlink_entry(wheel, idx);
+	wheel->entries[idx].when = when;
+	place(wheel, idx);
+}
+
+void *
+isc_wheel_element(isc_wheel_t *wheel, unsigned int idx) {
+	REQUIRE(VALID_WHEEL(wheel));
+	REQUIRE(idx >= FIRST && idx <= wheel->last);
+
+	return (wheel->entries[idx].elt);
+}
+
+void *
+isc_wheel_due(isc_wheel_t *wheel, isc_stdtime_t now) {
+	unsigned int first;
+
+	REQUIRE(VALID_WHEEL(wheel));
+
+	advance(wheel, now);
+
+	first = wheel->entries[DUE].next;
+	if (first == DUE) {
+		return (NULL);
+	}
+	return (wheel->entries[first].elt);
+}
+
+bool
+isc_wheel_pending(const isc_wheel_t *wheel, isc_stdtime_t now) {
+	REQUIRE(VALID_WHEEL(wheel));
+
+	if (wheel->entries[DUE].next != DUE) {
+		return (true);
+	}
+
+	/*
+	 * The elements at each level share the bits above that level
+	 * with the clock, so the earliest time in the lowest slot in use
+	 * is the earliest any of them can be due.
+	 */
+	for (unsigned int level = 0; level < WHEEL_LEVELS; level++) {
+		unsigned int shift = level * WHEEL_BITS;
+		uint64_t inuse = wheel->inuse[level];
+		isc_stdtime_t first;
+
+		if (inuse == 0) {
+			continue;
+		}
+		first = (isc_stdtime_t)__builtin_ctzll(inuse) << shift;
+		if (shift + WHEEL_BITS < 32) {
+			first |= wheel->now &
+				 ~((UINT32_C(1) << (shift + WHEEL_BITS)) - 1);
+		}
+		if (first <= now) {
+			return (true);
+		}
+	}
+
+	return (false);
+}
+
+size_t
+isc_wheel_count(isc_wheel_t *wheel) {
+	REQUIRE(VALID_WHEEL(wheel));
+
+	return (wheel->count);
+}
@@ -1276,6 +1276,7 @@ static cfg_clausedef_t options_clauses[] = {
 	{ "host-statistics-max", NULL, CFG_CLAUSEFLAG_ANCIENT },
 	{ "hostname", &cfg_type_qstringornone, 0 },
 	{ "interface-interval", &cfg_type_duration, 0 },
+	{ "io-uring", &cfg_type_boolean, 0 },
 	{ "keep-response-order", &cfg_type_bracketed_aml,
 	  CFG_CLAUSEFLAG_OBSOLETE },
 	{ "listen-on", &cfg_type_listenon, CFG_CLAUSEFLAG_MULTI },
@@ -1440,7 +1441,7 @@ static cfg_type_t cfg_type_mustbesecure = {
 	cfg_doc_tuple,	&cfg_rep_tuple,	 mustbesecure_fields
 };
 
-static const char *masterformat_enums[] = { "raw", "text", NULL };
+static const char *masterformat_enums[] = { "map", "raw", "text", NULL };
 static cfg_type_t cfg_type_masterformat = {
 	"masterformat", cfg_parse_enum,	 cfg_print_ustring,
 	cfg_doc_enum,	&cfg_rep_string, &masterformat_enums
@@ -2034,9 +2035,12 @@ static cfg_clausedef_t view_clauses[] = {
 	{ "allow-recursion", &cfg_type_bracketed_aml, 0 },
 	{ "allow-recursion-on", &cfg_type_bracketed_aml, 0 },
 	{ "allow-v6-synthesis", NULL, CFG_CLAUSEFLAG_ANCIENT },
+	{ "answer-cache-size", &cfg_type_uint32, 0 },
 	{ "attach-cache", &cfg_type_astring, 0 },
 	{ "auth-nxdomain", &cfg_type_boolean, 0 },
 	{ "cache-file", &cfg_type_qstring, CFG_CLAUSEFLAG_ANCIENT },
+	{ "cache-shards", &cfg_type_uint32, 0 },
+	{ "cache-snapshot-file", &cfg_type_qstring, 0 },
 	{ "catalog-zones", &cfg_type_catz, 0 },
 	{ "check-names", &cfg_type_checknames, CFG_CLAUSEFLAG_MULTI },
 	{ "cleaning-interval", NULL, CFG_CLAUSEFLAG_ANCIENT },
@@ -2099,6 +2103,7 @@ static cfg_clausedef_t view_clauses[] = {
 	{ "max-cache-ttl", &cfg_type_duration, 0 },
 	{ "max-clients-per-query", &cfg_type_uint32, 0 },
 	{ "max-ncache-ttl", &cfg_type_duration, 0 },
+	{ "max-query-races", &cfg_type_uint32, 0 },
 	{ "max-recursion-depth", &cfg_type_uint32, 0 },
 	{ "max-recursion-queries", &cfg_type_uint32, 0 },
 	{ "max-stale-ttl", &cfg_type_duration, 0 },
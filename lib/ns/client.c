@@ -48,6 +48,7 @@
 #include <dns/edns.h>
 #include <dns/events.h>
 #include <dns/message.h>
+#include <dns/pcache.h>
 #include <dns/peer.h>
 #include <dns/rcode.h>
 #include <dns/rdata.h>
@@ -111,6 +112,20 @@
 #define MANAGER_MAGIC	 ISC_MAGIC('N', 'S', 'C', 'm')
 #define VALID_MANAGER(m) ISC_MAGIC_VALID(m, MANAGER_MAGIC)
 
+/*
+ * The number of idle clients each client manager keeps for reuse.
+ */
+#define CLIENT_FREELIST_SIZE 64
+
+/*
+ * Client attributes that change the part of a response that is stored
+ * in the answer cache.
+ */
+#define PCACHE_CLIENTATTRS                                          \
+	(NS_CLIENTATTR_WANTDNSSEC | NS_CLIENTATTR_WANTAD |          \
+	 NS_CLIENTATTR_WANTCOOKIE | NS_CLIENTATTR_HAVECOOKIE |      \
+	 NS_CLIENTATTR_WANTOPT)
+
 /*
  * Enable ns_client_dropport() by default.
  */
@@ -310,6 +325,10 @@ client_senddone(isc_nmhandle_t *handle, isc_result_t result, void *cbarg) {
 	 */
 	client->sendhandle = NULL;
 
+	if (client->tcpbuf.base != NULL) {
+		isc_nm_putsendbuf(handle, &client->tcpbuf);
+	}
+
 	if (result != ISC_R_SUCCESS) {
 		if (!TCP_CLIENT(client) && result == ISC_R_MAXSIZE) {
 			ns_client_log(client, DNS_LOGCATEGORY_SECURITY,
@@ -338,11 +357,16 @@ client_allocsendbuf(ns_client_t *client, isc_buffer_t *buffer,
 	REQUIRE(datap != NULL);
 
 	if (TCP_CLIENT(client)) {
-		INSIST(client->tcpbuf == NULL);
-		client->tcpbuf = isc_mem_get(client->manager->mctx,
-					     NS_CLIENT_TCP_BUFFER_SIZE);
-		data = client->tcpbuf;
-		isc_buffer_init(buffer, data, NS_CLIENT_TCP_BUFFER_SIZE);
+		/*
+		 * The response is rendered straight into a buffer owned by
+		 * the network manager; it is returned in client_senddone().
+		 */
+		INSIST(client->tcpbuf.base == NULL);
+		isc_nm_getsendbuf(client->handle, &client->tcpbuf);
+		data = client->tcpbuf.base;
+		bufsize = ISC_MIN(client->tcpbuf.length,
+				  NS_CLIENT_TCP_BUFFER_SIZE);
+		isc_buffer_init(buffer, data, bufsize);
 	} else {
 		data = client->sendbuf;
 		if ((client->attributes & NS_CLIENTATTR_HAVECOOKIE) == 0) {
@@ -385,6 +409,66 @@ client_sendpkg(ns_client_t *client, isc_buffer_t *buffer) {
 	isc_nm_send(client->handle, &r, client_senddone, client);
 }
 
+/*
+ * Build the answer cache key for the current request.  The request
+ * flags are taken from the RD and CD bits, which are the same in the
+ * request and in the response, so that the key can be built both
+ * before and after dns_message_reply().
+ */
+static void
+client_pcachekey(ns_client_t *client, dns_pcachekey_t *key) {
+	uint32_t attributes;
+
+	attributes = client->attributes & PCACHE_CLIENTATTRS;
+	attributes |= (uint32_t)(client->message->flags &
+				 (DNS_MESSAGEFLAG_RD | DNS_MESSAGEFLAG_CD))
+		      << 16;
+	if (isc_sockaddr_pf(&client->peeraddr) == AF_INET6) {
+		attributes |= 0x80000000U;
+	}
+
+	*key = (dns_pcachekey_t){
+		.qname = client->query.origqname,
+		.qtype = client->query.qtype,
+		.qclass = client->message->rdclass,
+		.udpsize = client->udpsize,
+		.attributes = attributes,
+	};
+}
+
+/*
+ * Store the first 'length' octets of the rendered response in
+ * 'buffer', i.e. everything but the OPT record, in the answer cache.
+ */
+static void
+client_pcacheadd(ns_client_t *client, isc_buffer_t *buffer,
+		 unsigned int length) {
+	dns_pcachekey_t key;
+	isc_region_t r;
+	isc_stdtime_t now;
+
+	if (TCP_CLIENT(client) || client->view == NULL ||
+	    client->view->pcache == NULL ||
+	    (client->message->flags & DNS_MESSAGEFLAG_TC) != 0 ||
+	    (client->message->rcode != dns_rcode_noerror &&
+	     client->message->rcode != dns_rcode_nxdomain))
+	{
+		return;
+	}
+
+	client_pcachekey(client, &key);
+
+	isc_buffer_usedregion(buffer, &r);
+	INSIST(length <= r.length);
+	r.length = length;
+
+	isc_stdtime_get(&now);
+	dns_pcache_add(client->view->pcache, &key,
+		       client->query.pcache.generation,
+		       client->query.pcache.serial,
+		       (uint32_t)client->query.pcache.counter, &r, now);
+}
+
 void
 ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 	isc_result_t result;
@@ -442,10 +526,8 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 
 	return;
 done:
-	if (client->tcpbuf != NULL) {
-		isc_mem_put(client->manager->mctx, client->tcpbuf,
-			    NS_CLIENT_TCP_BUFFER_SIZE);
-		client->tcpbuf = NULL;
+	if (client->tcpbuf.base != NULL) {
+		isc_nm_putsendbuf(client->handle, &client->tcpbuf);
 	}
 
 	ns_client_drop(client, result);
@@ -464,6 +546,7 @@ ns_client_send(ns_client_t *client) {
 	unsigned int preferred_glue;
 	bool opt_included = false;
 	size_t respsize;
+	unsigned int cachelen;
 	dns_aclenv_t *env = NULL;
 #ifdef HAVE_DNSTAP
 	unsigned char zone[DNS_NAME_MAXWIRE];
@@ -605,11 +688,16 @@ ns_client_send(ns_client_t *client) {
 		goto cleanup;
 	}
 renderend:
+	cachelen = isc_buffer_usedlength(&buffer);
 	result = dns_message_renderend(client->message);
 	if (result != ISC_R_SUCCESS) {
 		goto cleanup;
 	}
 
+	if ((client->query.attributes & NS_QUERYATTR_PCACHE) != 0) {
+		client_pcacheadd(client, &buffer, cachelen);
+	}
+
 #ifdef HAVE_DNSTAP
 	memset(&zr, 0, sizeof(zr));
 	if (((client->message->flags & DNS_MESSAGEFLAG_AA) != 0) &&
@@ -642,6 +730,9 @@ renderend:
 
 	if (client->sendcb != NULL) {
 		client->sendcb(&buffer);
+		if (client->tcpbuf.base != NULL) {
+			isc_nm_putsendbuf(client->handle, &client->tcpbuf);
+		}
 	} else if (TCP_CLIENT(client)) {
 		isc_buffer_usedregion(&buffer, &r);
 #ifdef HAVE_DNSTAP
@@ -727,10 +818,8 @@ renderend:
 	return;
 
 cleanup:
-	if (client->tcpbuf != NULL) {
-		isc_mem_put(client->manager->mctx, client->tcpbuf,
-			    NS_CLIENT_TCP_BUFFER_SIZE);
-		client->tcpbuf = NULL;
+	if (client->tcpbuf.base != NULL) {
+		isc_nm_putsendbuf(client->handle, &client->tcpbuf);
 	}
 
 	if (cleanup_cctx) {
@@ -738,6 +827,128 @@ cleanup:
 	}
 }
 
+isc_result_t
+ns_client_sendcached(ns_client_t *client, uint64_t generation, uint32_t serial,
+		     isc_statscounter_t *counterp) {
+	isc_result_t result;
+	unsigned char *data = NULL;
+	isc_buffer_t buffer;
+	dns_pcachekey_t key;
+	dns_rdataset_t *opt = NULL;
+	isc_stdtime_t now;
+	uint32_t aux;
+	size_t respsize;
+
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(!TCP_CLIENT(client));
+	REQUIRE(client->view != NULL && client->view->pcache != NULL);
+	REQUIRE(counterp != NULL);
+
+	client_pcachekey(client, &key);
+	client_allocsendbuf(client, &buffer, &data);
+
+	isc_stdtime_get(&now);
+	result = dns_pcache_find(client->view->pcache, &key, generation, serial,
+				 now, &buffer, &aux);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	CTRACE("sendcached");
+
+	data[0] = (client->message->id >> 8) & 0xff;
+	data[1] = client->message->id & 0xff;
+
+	/*
+	 * The OPT record carries per-request data, so it is never cached;
+	 * build a fresh one and append it.  ARCOUNT in the cached header
+	 * already accounts for it.
+	 */
+	if ((client->attributes & NS_CLIENTATTR_WANTOPT) != 0) {
+		dns_compress_t cctx;
+		unsigned int count = 0;
+
+		result = ns_client_addopt(client, client->message, &opt);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+
+		dns_compress_init(&cctx, client->manager->mctx,
+				  DNS_COMPRESS_DISABLED);
+		result = dns_rdataset_towire(opt, dns_rootname, &cctx, &buffer,
+					     0, &count);
+		dns_compress_invalidate(&cctx);
+
+		dns_rdataset_disassociate(opt);
+		dns_message_puttemprdataset(client->message, &opt);
+
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+
+	/*
+	 * Make the response code and flags available to the caller and
+	 * to the statistics code below.
+	 */
+	client->message->flags = ((data[2] << 8) | data[3]) &
+				 (DNS_MESSAGEFLAG_QR | DNS_MESSAGEFLAG_AA |
+				  DNS_MESSAGEFLAG_TC | DNS_MESSAGEFLAG_RD |
+				  DNS_MESSAGEFLAG_RA | DNS_MESSAGEFLAG_AD |
+				  DNS_MESSAGEFLAG_CD);
+	client->message->rcode = data[3] & 0x0f;
+
+#ifdef HAVE_DNSTAP
+	if (client->view != NULL) {
+		dns_dtmsgtype_t dtmsgtype;
+
+		if ((client->message->flags & DNS_MESSAGEFLAG_RD) != 0) {
+			dtmsgtype = DNS_DTTYPE_CR;
+		} else {
+			dtmsgtype = DNS_DTTYPE_AR;
+		}
+		dns_dt_send(client->view, dtmsgtype, &client->peeraddr,
+			    &client->destsockaddr, false, NULL,
+			    &client->requesttime, NULL, &buffer);
+	}
+#endif /* HAVE_DNSTAP */
+
+	respsize = isc_buffer_usedlength(&buffer);
+
+	if (client->sendcb != NULL) {
+		client->sendcb(&buffer);
+	} else {
+		client_sendpkg(client, &buffer);
+	}
+
+	switch (isc_sockaddr_pf(&client->peeraddr)) {
+	case AF_INET:
+		isc_stats_increment(client->manager->sctx->udpoutstats4,
+				    ISC_MIN((int)respsize / 16, 256));
+		break;
+	case AF_INET6:
+		isc_stats_increment(client->manager->sctx->udpoutstats6,
+				    ISC_MIN((int)respsize / 16, 256));
+		break;
+	default:
+		UNREACHABLE();
+	}
+
+	ns_stats_increment(client->manager->sctx->nsstats,
+			   ns_statscounter_response);
+	dns_rcodestats_increment(client->manager->sctx->rcodestats,
+				 client->message->rcode);
+	if ((client->attributes & NS_CLIENTATTR_WANTOPT) != 0) {
+		ns_stats_increment(client->manager->sctx->nsstats,
+				   ns_statscounter_edns0out);
+	}
+
+	client->query.attributes |= NS_QUERYATTR_ANSWERED;
+	*counterp = (isc_statscounter_t)aux;
+
+	return (ISC_R_SUCCESS);
+}
+
 #if NS_CLIENT_DROPPORT
 #define DROPPORT_NO	  0
 #define DROPPORT_REQUEST  1
@@ -1622,10 +1833,12 @@ ns__client_reset_cb(void *client0) {
 	}
 
 	ns_client_endrequest(client);
-	if (client->tcpbuf != NULL) {
-		isc_mem_put(client->manager->mctx, client->tcpbuf,
-			    NS_CLIENT_TCP_BUFFER_SIZE);
-	}
+
+	/*
+	 * The TCP send buffer is returned to the network manager when the
+	 * send completes, the handle is gone by now.
+	 */
+	INSIST(client->tcpbuf.base == NULL);
 
 	if (client->keytag != NULL) {
 		isc_mem_put(client->manager->mctx, client->keytag,
@@ -1640,17 +1853,9 @@ ns__client_reset_cb(void *client0) {
 #endif /* WANT_SINGLETRACE */
 }
 
-void
-ns__client_put_cb(void *client0) {
-	ns_client_t *client = client0;
-	ns_clientmgr_t *manager = NULL;
-
-	REQUIRE(NS_CLIENT_VALID(client));
-
-	manager = client->manager;
-
-	ns_client_log(client, DNS_LOGCATEGORY_SECURITY, NS_LOGMODULE_CLIENT,
-		      ISC_LOG_DEBUG(3), "freeing client");
+static void
+client_free(ns_client_t *client) {
+	ns_clientmgr_t *manager = client->manager;
 
 	/*
 	 * Call this first because it requires a valid client.
@@ -1676,6 +1881,71 @@ ns__client_put_cb(void *client0) {
 	isc_mutex_destroy(&client->query.fetchlock);
 
 	isc_mem_put(manager->mctx, client, sizeof(*client));
+}
+
+/*
+ * Idle clients are kept on a per-loop free list in the client manager
+ * together with their message, send buffer and query state, so that a busy
+ * loop does not have to set up a new client for every TCP connection, or
+ * for every UDP request the netmgr handle cache can't absorb.  The clients
+ * on the free list don't hold a reference to the manager; they are freed
+ * when the manager is destroyed, which happens on the same loop.
+ */
+static ns_client_t *
+clientmgr_getclient(ns_clientmgr_t *manager) {
+	ns_client_t *client = ISC_LIST_HEAD(manager->freeclients);
+
+	isc_mem_cachestat(manager->mctx, client != NULL);
+
+	if (client != NULL) {
+		ISC_LIST_UNLINK(manager->freeclients, client, rlink);
+		manager->nfreeclients--;
+		ns_clientmgr_attach(manager, &client->manager);
+	}
+
+	return (client);
+}
+
+static bool
+clientmgr_putclient(ns_clientmgr_t *manager, ns_client_t *client) {
+	if (manager->nfreeclients >= CLIENT_FREELIST_SIZE) {
+		return (false);
+	}
+
+	client_extendederror_reset(client);
+	if (client->opt != NULL) {
+		INSIST(dns_rdataset_isassociated(client->opt));
+		dns_rdataset_disassociate(client->opt);
+		dns_message_puttemprdataset(client->message, &client->opt);
+	}
+
+	ISC_LIST_APPEND(manager->freeclients, client, rlink);
+	manager->nfreeclients++;
+
+	return (true);
+}
+
+void
+ns__client_put_cb(void *client0) {
+	ns_client_t *client = client0;
+	ns_clientmgr_t *manager = NULL;
+
+	REQUIRE(NS_CLIENT_VALID(client));
+
+	manager = client->manager;
+
+	if (clientmgr_putclient(manager, client)) {
+		ns_client_log(client, DNS_LOGCATEGORY_SECURITY,
+			      NS_LOGMODULE_CLIENT, ISC_LOG_DEBUG(3),
+			      "caching client");
+		ns_clientmgr_detach(&client->manager);
+		return;
+	}
+
+	ns_client_log(client, DNS_LOGCATEGORY_SECURITY, NS_LOGMODULE_CLIENT,
+		      ISC_LOG_DEBUG(3), "freeing client");
+
+	client_free(client);
 
 	ns_clientmgr_detach(&manager);
 }
@@ -1737,16 +2007,24 @@ ns__client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 		INSIST(VALID_MANAGER(clientmgr));
 		INSIST(clientmgr->tid == isc_tid());
 
-		client = isc_mem_get(clientmgr->mctx, sizeof(*client));
+		client = clientmgr_getclient(clientmgr);
+		if (client != NULL) {
+			result = ns__client_setup(client, NULL, false);
+			if (result != ISC_R_SUCCESS) {
+				return;
+			}
+		} else {
+			client = isc_mem_get(clientmgr->mctx, sizeof(*client));
 
-		result = ns__client_setup(client, clientmgr, true);
-		if (result != ISC_R_SUCCESS) {
-			return;
-		}
+			result = ns__client_setup(client, clientmgr, true);
+			if (result != ISC_R_SUCCESS) {
+				return;
+			}
 
-		ns_client_log(client, DNS_LOGCATEGORY_SECURITY,
-			      NS_LOGMODULE_CLIENT, ISC_LOG_DEBUG(3),
-			      "allocate new client");
+			ns_client_log(client, DNS_LOGCATEGORY_SECURITY,
+				      NS_LOGMODULE_CLIENT, ISC_LOG_DEBUG(3),
+				      "allocate new client");
+		}
 	} else {
 		result = ns__client_setup(client, NULL, false);
 		if (result != ISC_R_SUCCESS) {
@@ -1893,9 +2171,12 @@ ns__client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 	}
 
 	/*
-	 * It's a request.  Parse it.
+	 * It's a request.  Parse it.  Records other than the question
+	 * and the OPT, TSIG and SIG(0) records are seldom looked at, so
+	 * leave them to be parsed when they're needed.
 	 */
-	result = dns_message_parse(client->message, buffer, 0);
+	result = dns_message_parse(client->message, buffer,
+				   DNS_MESSAGEPARSE_LAZY);
 	if (result != ISC_R_SUCCESS) {
 		/*
 		 * Parsing the request failed.  Send a response
@@ -2391,9 +2672,21 @@ cleanup:
 static void
 clientmgr_destroy_cb(void *arg) {
 	ns_clientmgr_t *manager = (ns_clientmgr_t *)arg;
+	ns_client_t *client = NULL;
+
 	MTRACE("clientmgr_destroy");
 
 	isc_refcount_destroy(&manager->references);
+
+	while ((client = ISC_LIST_HEAD(manager->freeclients)) != NULL) {
+		ISC_LIST_UNLINK(manager->freeclients, client, rlink);
+		manager->nfreeclients--;
+		/* Not attached, the manager is going away. */
+		client->manager = manager;
+		client_free(client);
+	}
+	INSIST(manager->nfreeclients == 0);
+
 	manager->magic = 0;
 
 	dns_aclenv_detach(&manager->aclenv);
@@ -2446,6 +2739,7 @@ ns_clientmgr_create(ns_server_t *sctx, isc_taskmgr_t *taskmgr,
 	ns_server_attach(sctx, &manager->sctx);
 
 	ISC_LIST_INIT(manager->recursing);
+	ISC_LIST_INIT(manager->freeclients);
 
 	manager->magic = MANAGER_MAGIC;
 
@@ -158,6 +158,10 @@ struct ns_clientmgr {
 	/* Lock covers the recursing list */
 	isc_mutex_t   reclock;
 	client_list_t recursing; /*%< Recursing clients */
+
+	/* Only accessed from the manager's loop */
+	client_list_t freeclients; /*%< Idle clients kept for reuse */
+	unsigned int  nfreeclients;
 };
 
 /*% nameserver client structure */
@@ -174,7 +178,7 @@ struct ns_client {
 	isc_nmhandle_t	*reqhandle;   /* Waiting for request callback
 					 (query, update, notify) */
 	isc_nmhandle_t *updatehandle; /* Waiting for update callback */
-	unsigned char  *tcpbuf;
+	isc_region_t	tcpbuf;	      /* From isc_nm_getsendbuf() */
 	dns_message_t  *message;
 	unsigned char  *sendbuf;
 	dns_rdataset_t *opt;
@@ -213,7 +217,7 @@ struct ns_client {
 	/*% Callback function to send a response when unit testing */
 	void (*sendcb)(isc_buffer_t *buf);
 
-	ISC_LINK(ns_client_t) rlink;
+	ISC_LINK(ns_client_t) rlink; /* recursing or freeclients list */
 	unsigned char  cookie[8];
 	uint32_t       expire;
 	unsigned char *keytag;
@@ -285,6 +289,27 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *msg);
  * send msg as a response using client->message->id for the id.
  */
 
+isc_result_t
+ns_client_sendcached(ns_client_t *client, uint64_t generation, uint32_t serial,
+		     isc_statscounter_t *counterp);
+/*%<
+ * Finish processing the current client request by sending a response
+ * from the view's answer cache, if one built from version 'serial'
+ * of the database with generation 'generation' (see
+ * dns_db_generation()) is available.  '*counterp' is set to the query
+ * statistics counter that applied to the cached response.
+ *
+ * Requires:
+ *\li	'client' is a valid UDP client whose view has an answer cache.
+ *\li	'counterp' is not NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS		the response was sent
+ *\li	#ISC_R_NOTFOUND		no usable response was cached
+ *\li	#ISC_R_NOSPACE		the cached response doesn't fit in the
+ *				client's buffer
+ */
+
 void
 ns_client_error(ns_client_t *client, isc_result_t result);
 /*%<
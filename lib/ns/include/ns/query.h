@@ -158,6 +158,12 @@ struct ns_query {
 
 	ns_query_recparam_t recparam;
 
+	struct {
+		uint64_t	   generation; /* 0: not cacheable */
+		uint32_t	   serial;
+		isc_statscounter_t counter;
+	} pcache;
+
 	dns_keytag_t root_key_sentinel_keyid;
 	bool	     root_key_sentinel_is_ta;
 	bool	     root_key_sentinel_not_ta;
@@ -183,6 +189,7 @@ struct ns_query {
 #define NS_QUERYATTR_ANSWERED	     0x040000
 #define NS_QUERYATTR_STALEOK	     0x080000
 #define NS_QUERYATTR_STALEPENDING    0x100000
+#define NS_QUERYATTR_PCACHE	     0x200000
 
 typedef struct query_ctx query_ctx_t;
 
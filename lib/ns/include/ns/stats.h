@@ -107,7 +107,10 @@ enum {
 
 	ns_statscounter_reclimitdropped = 66,
 
-	ns_statscounter_max = 67,
+	ns_statscounter_answercachehit = 67,
+	ns_statscounter_answercachemiss = 68,
+
+	ns_statscounter_max = 69,
 };
 
 void
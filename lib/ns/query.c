@@ -591,6 +591,28 @@ query_send(ns_client_t *client) {
 	}
 
 	inc_stats(client, counter);
+
+	/*
+	 * Allow the response to be stored in the answer cache if it was
+	 * built entirely from the zone database that was current when
+	 * the cache was consulted.
+	 */
+	if (client->query.pcache.generation != 0 && client->ede == NULL &&
+	    (client->query.attributes & NS_QUERYATTR_REDIRECT) == 0)
+	{
+		ns_dbversion_t *dbversion =
+			ISC_LIST_HEAD(client->query.activeversions);
+
+		if (dbversion != NULL &&
+		    dns_db_generation(dbversion->db) ==
+			    client->query.pcache.generation &&
+		    ISC_LIST_NEXT(dbversion, link) == NULL)
+		{
+			client->query.attributes |= NS_QUERYATTR_PCACHE;
+			client->query.pcache.counter = counter;
+		}
+	}
+
 	ns_client_send(client);
 
 	if (!client->nodetach) {
@@ -792,6 +814,7 @@ query_reset(ns_client_t *client, bool everything) {
 	client->query.root_key_sentinel_keyid = 0;
 	client->query.root_key_sentinel_is_ta = false;
 	client->query.root_key_sentinel_not_ta = false;
+	client->query.pcache.generation = 0;
 }
 
 static void
@@ -11816,6 +11839,92 @@ log_queryerror(ns_client_t *client, isc_result_t result, int line, int level) {
 		      sep2, typep, __FILE__, line);
 }
 
+/*
+ * Try to answer the query from the view's answer cache; return true if
+ * a response was sent.  Otherwise, if the response can be cached once
+ * it has been built, remember which zone database version it is
+ * expected to come from, so that query_send() can store it.
+ */
+static bool
+query_pcache(ns_client_t *client, dns_rdatatype_t qtype) {
+	dns_view_t *view = client->view;
+	dns_message_t *message = client->message;
+	dns_zone_t *zone = NULL;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *version = NULL;
+	isc_statscounter_t counter;
+	isc_result_t result;
+	uint64_t generation;
+	uint32_t serial;
+	bool answered = false;
+
+	if (view->pcache == NULL || TCP(client) || view->recursion ||
+	    view->rrl != NULL || view->rpzs != NULL || view->dns64cnt != 0 ||
+	    view->sortlist != NULL || view->nocasecompress != NULL ||
+	    view->hooktable != NULL || !ISC_LIST_EMPTY(view->dlz_searched) ||
+	    message->tsig != NULL || message->sig0 != NULL ||
+	    client->ede != NULL || dns_rdatatype_atparent(qtype) ||
+	    (client->attributes &
+	     (NS_CLIENTATTR_WANTNSID | NS_CLIENTATTR_WANTEXPIRE |
+	      NS_CLIENTATTR_HAVEECS | NS_CLIENTATTR_WANTPAD)) != 0)
+	{
+		return (false);
+	}
+
+	result = query_getzonedb(client, client->query.qname, qtype,
+				 DNS_GETDB_NOLOG, &zone, &db, &version);
+	if (result != ISC_R_SUCCESS) {
+		return (false);
+	}
+
+	/*
+	 * Databases that weren't created by dns_db_create() have no
+	 * generation to tag the cached responses with.
+	 */
+	generation = dns_db_generation(db);
+	if (generation == 0) {
+		goto cleanup;
+	}
+
+	result = dns_db_getsoaserial(db, version, &serial);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	result = ns_client_sendcached(client, generation, serial, &counter);
+	if (result != ISC_R_SUCCESS) {
+		ns_stats_increment(client->manager->sctx->nsstats,
+				   ns_statscounter_answercachemiss);
+		client->query.pcache.generation = generation;
+		client->query.pcache.serial = serial;
+		goto cleanup;
+	}
+
+	CTRACE(ISC_LOG_DEBUG(3), "query_pcache: answered from cache");
+
+	ns_stats_increment(client->manager->sctx->nsstats,
+			   ns_statscounter_answercachehit);
+	dns_zone_attach(zone, &client->query.authzone);
+	inc_stats(client, ns_statscounter_udp);
+	if ((message->flags & DNS_MESSAGEFLAG_AA) == 0) {
+		inc_stats(client, ns_statscounter_nonauthans);
+	} else {
+		inc_stats(client, ns_statscounter_authans);
+	}
+	inc_stats(client, counter);
+
+	if (!client->nodetach) {
+		isc_nmhandle_detach(&client->reqhandle);
+	}
+	answered = true;
+
+cleanup:
+	dns_db_detach(&db);
+	dns_zone_detach(&zone);
+
+	return (answered);
+}
+
 void
 ns_query_start(ns_client_t *client, isc_nmhandle_t *handle) {
 	isc_result_t result;
@@ -12076,6 +12185,13 @@ ns_query_start(ns_client_t *client, isc_nmhandle_t *handle) {
 		client->attributes |= NS_CLIENTATTR_WANTAD;
 	}
 
+	/*
+	 * Answer from the answer cache if possible.
+	 */
+	if (query_pcache(client, qtype)) {
+		return;
+	}
+
 	/*
 	 * This is an ordinary query.
 	 */
@@ -17,7 +17,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <isc/ascii.h>
 #include <isc/buffer.h>
+#include <isc/endian.h>
+#include <isc/hash.h>
 #include <isc/mem.h>
 #include <isc/result.h>
 #include <isc/time.h>
@@ -35,6 +38,121 @@ CHECKRESULT(isc_result_t result, const char *msg) {
 	}
 }
 
+/*
+ * The byte-at-a-time label hash that dns_compress used before, and
+ * the word-at-a-time hash_label() from lib/dns/compress.c that
+ * replaced it.
+ */
+static uint16_t
+old_hash_label(uint16_t init, const uint8_t *ptr, unsigned int avail) {
+	unsigned int len = ptr[0] + 1;
+	uint32_t hash = init;
+
+	UNUSED(avail);
+
+	while (len-- > 0) {
+		hash = hash * 33 + isc__ascii_tolower1(*ptr++);
+	}
+
+	return (isc_hash_bits32(hash, 16));
+}
+
+static uint16_t
+new_hash_label(uint16_t init, const uint8_t *ptr, unsigned int avail) {
+	unsigned int len = ptr[0] + 1;
+	uint64_t hash = init * 0x9E3779B97F4A7C15ULL;
+	uint64_t word;
+
+	while (len > 0) {
+		unsigned int n = ISC_MIN(len, sizeof(word));
+
+		if (n == sizeof(word)) {
+			memmove(&word, ptr, sizeof(word));
+		} else if (avail >= sizeof(word)) {
+			memmove(&word, ptr, sizeof(word));
+			word = le64toh(word) & (UINT64_MAX >> (64 - n * 8));
+		} else {
+			word = 0;
+			for (unsigned int i = 0; i < n; i++) {
+				word |= (uint64_t)ptr[i] << (i * 8);
+			}
+		}
+		word = isc_ascii_tolower8(word);
+		hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+		len -= n;
+		ptr += n;
+		avail -= n;
+	}
+
+	return (isc_hash_bits32(hash >> 32, 16));
+}
+
+static bool
+old_lowerequal(const uint8_t *a, const uint8_t *b, unsigned int len) {
+	while (len-- > 0) {
+		if (isc_ascii_tolower(*a++) != isc_ascii_tolower(*b++)) {
+			return (false);
+		}
+	}
+	return (true);
+}
+
+typedef uint16_t
+hash_fn(uint16_t init, const uint8_t *ptr, unsigned int avail);
+
+static uint64_t
+time_hash(hash_fn *fn, dns_fixedname_t *fixedname, unsigned int count,
+	  unsigned int repeat, unsigned int *sum) {
+	isc_time_t start, finish;
+
+	*sum = 0;
+	isc_time_now_hires(&start);
+	for (unsigned int n = 0; n < repeat; n++) {
+		for (unsigned int i = 0; i < count; i++) {
+			dns_name_t *name = dns_fixedname_name(&fixedname[i]);
+			uint16_t hash = 5381;
+			for (unsigned int l = 0; l < name->labels; l++) {
+				unsigned int off = name->offsets[l];
+				hash = fn(hash, name->ndata + off,
+					  name->length - off);
+			}
+			*sum += hash;
+		}
+	}
+	isc_time_now_hires(&finish);
+
+	return (isc_time_microdiff(&finish, &start));
+}
+
+typedef bool
+equal_fn(const uint8_t *a, const uint8_t *b, unsigned int len);
+
+static uint64_t
+time_equal(equal_fn *fn, dns_fixedname_t *fixedname, dns_fixedname_t *upper,
+	   unsigned int count, unsigned int repeat, unsigned int *matches) {
+	isc_time_t start, finish;
+
+	*matches = 0;
+	isc_time_now_hires(&start);
+	for (unsigned int n = 0; n < repeat; n++) {
+		for (unsigned int i = 0; i < count; i++) {
+			dns_name_t *a = dns_fixedname_name(&fixedname[i]);
+			dns_name_t *b = dns_fixedname_name(&upper[i]);
+			*matches += fn(a->ndata, b->ndata, a->length);
+		}
+	}
+	isc_time_now_hires(&finish);
+
+	return (isc_time_microdiff(&finish, &start));
+}
+
+static void
+report(const char *what, uint64_t old_us, uint64_t new_us) {
+	printf("%-10s old %f new %f speedup %.2fx\n", what,
+	       (double)old_us / 1000000.0, (double)new_us / 1000000.0,
+	       new_us > 0 ? (double)old_us / (double)new_us : 0.0);
+}
+
 int
 main(void) {
 	isc_result_t result;
@@ -98,6 +216,36 @@ main(void) {
 
 	printf("names %u\n", count);
 
+	/*
+	 * Compare the label hashing and the case-insensitive matching
+	 * with the byte-at-a-time versions.
+	 */
+	static dns_fixedname_t upper[ARRAY_SIZE(fixedname)];
+	for (unsigned int i = 0; i < count; i++) {
+		dns_name_t *name = dns_fixedname_name(&fixedname[i]);
+		dns_name_t *uname = dns_fixedname_initname(&upper[i]);
+		dns_name_copy(name, uname);
+		for (unsigned int j = 0; j < uname->length; j++) {
+			uname->ndata[j] = isc_ascii_toupper(uname->ndata[j]);
+		}
+	}
+
+	unsigned int old_result, new_result;
+	uint64_t old_us, new_us;
+
+	old_us = time_hash(old_hash_label, fixedname, count, repeat,
+			   &old_result);
+	new_us = time_hash(new_hash_label, fixedname, count, repeat,
+			   &new_result);
+	report("hash", old_us, new_us);
+
+	old_us = time_equal(old_lowerequal, fixedname, upper, count, repeat,
+			    &old_result);
+	new_us = time_equal(isc_ascii_lowerequal, fixedname, upper, count,
+			    repeat, &new_result);
+	INSIST(old_result == new_result);
+	report("equal", old_us, new_us);
+
 	isc_mem_destroy(&mctx);
 
 	return (0);
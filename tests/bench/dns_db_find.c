@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure the throughput of dns_db_find() in a zone database with an
+ * increasing number of threads.
+ *
+ * Usage: dns_db_find [-n names] [-l lookups] [-t maxthreads] [-w]
+ *
+ * With -w, another thread updates the zone once a millisecond while the
+ * lookups run.
+ */
+
+#include <err.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <isc/buffer.h>
+#include <isc/mem.h>
+#include <isc/os.h>
+#include <isc/result.h>
+#include <isc/thread.h>
+#include <isc/tid.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+
+static isc_mem_t *mctx = NULL;
+static dns_db_t *db = NULL;
+static dns_fixedname_t *names = NULL;
+static unsigned int nnames = 100000;
+static unsigned int nlookups = 1000000;
+static atomic_bool done;
+
+static void
+makename(dns_fixedname_t *fixed, const char *text) {
+	dns_name_t *name = dns_fixedname_initname(fixed);
+	isc_buffer_t b;
+	isc_result_t result;
+
+	isc_buffer_constinit(&b, text, strlen(text));
+	isc_buffer_add(&b, strlen(text));
+	result = dns_name_fromtext(name, &b, dns_rootname, 0, NULL);
+	INSIST(result == ISC_R_SUCCESS);
+}
+
+static void
+load(void) {
+	char filename[] = "/tmp/dns_db_find.XXXXXX";
+	dns_fixedname_t origin;
+	isc_result_t result;
+	FILE *fp = NULL;
+	int fd;
+
+	fd = mkstemp(filename);
+	if (fd == -1 || (fp = fdopen(fd, "w")) == NULL) {
+		err(1, "%s", filename);
+	}
+	fprintf(fp, "$ORIGIN example.\n$TTL 300\n"
+		    "@ SOA ns hostmaster 1 3600 600 86400 300\n"
+		    "@ NS ns\nns A 192.0.2.1\n");
+	for (unsigned int i = 0; i < nnames; i++) {
+		fprintf(fp, "n%u A 192.0.2.%u\n", i, i % 256);
+	}
+	fclose(fp);
+
+	makename(&origin, "example.");
+	result = dns_db_create(mctx, "rbt", dns_fixedname_name(&origin),
+			       dns_dbtype_zone, dns_rdataclass_in, 0, NULL,
+			       &db);
+	INSIST(result == ISC_R_SUCCESS);
+	result = dns_db_load(db, filename, dns_masterformat_text, 0);
+	unlink(filename);
+	if (result != ISC_R_SUCCESS) {
+		errx(1, "load: %s", isc_result_totext(result));
+	}
+
+	names = malloc(nnames * sizeof(names[0]));
+	INSIST(names != NULL);
+	for (unsigned int i = 0; i < nnames; i++) {
+		char text[64];
+		snprintf(text, sizeof(text), "n%u.example.", i);
+		makename(&names[i], text);
+	}
+}
+
+static isc_threadresult_t
+reader(isc_threadarg_t arg) {
+	uint32_t tid = (uint32_t)(uintptr_t)arg;
+	uint32_t state = tid * 2654435761U + 1;
+	dns_fixedname_t fixed;
+	dns_name_t *foundname = dns_fixedname_initname(&fixed);
+
+	/* Look like a loop thread, so the reader slots are spread out */
+	isc__tid_init(tid);
+
+	for (unsigned int i = 0; i < nlookups; i++) {
+		dns_rdataset_t rdataset;
+		dns_dbnode_t *node = NULL;
+		isc_result_t result;
+
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+
+		dns_rdataset_init(&rdataset);
+		result = dns_db_find(db, dns_fixedname_name(&names[state %
+								 nnames]),
+				     NULL, dns_rdatatype_a, 0, 0, &node,
+				     foundname, &rdataset, NULL);
+		INSIST(result == ISC_R_SUCCESS);
+		dns_rdataset_disassociate(&rdataset);
+		dns_db_detachnode(db, &node);
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+static isc_threadresult_t
+writer(isc_threadarg_t arg) {
+	dns_fixedname_t fixed;
+	dns_name_t *name = NULL;
+	unsigned char data[4] = { 198, 51, 100, 0 };
+	unsigned int updates = 0;
+
+	UNUSED(arg);
+
+	makename(&fixed, "w.example.");
+	name = dns_fixedname_name(&fixed);
+
+	while (!atomic_load(&done)) {
+		dns_dbversion_t *version = NULL;
+		dns_dbnode_t *node = NULL;
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		dns_rdatalist_t rdatalist;
+		dns_rdataset_t rdataset;
+		isc_result_t result;
+
+		data[3] = updates++ % 256;
+		dns_rdata_fromregion(&rdata, dns_rdataclass_in, dns_rdatatype_a,
+				     &(isc_region_t){ data, sizeof(data) });
+		dns_rdatalist_init(&rdatalist);
+		rdatalist.rdclass = dns_rdataclass_in;
+		rdatalist.type = dns_rdatatype_a;
+		rdatalist.ttl = 300;
+		ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+		dns_rdataset_init(&rdataset);
+		dns_rdatalist_tordataset(&rdatalist, &rdataset);
+
+		result = dns_db_newversion(db, &version);
+		INSIST(result == ISC_R_SUCCESS);
+		result = dns_db_findnode(db, name, true, &node);
+		INSIST(result == ISC_R_SUCCESS);
+		result = dns_db_addrdataset(db, node, version, 0, &rdataset, 0,
+					    NULL);
+		INSIST(result == ISC_R_SUCCESS);
+		dns_db_detachnode(db, &node);
+		dns_rdataset_disassociate(&rdataset);
+		dns_db_closeversion(db, &version, true);
+
+		usleep(1000);
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+int
+main(int argc, char **argv) {
+	unsigned int maxthreads = isc_os_ncpus();
+	isc_thread_t *threads = NULL;
+	bool write = false;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "l:n:t:w")) != -1) {
+		switch (ch) {
+		case 'l':
+			nlookups = atoi(optarg);
+			break;
+		case 'n':
+			nnames = atoi(optarg);
+			break;
+		case 't':
+			maxthreads = atoi(optarg);
+			break;
+		case 'w':
+			write = true;
+			break;
+		default:
+			errx(1, "usage: dns_db_find [-n names] [-l lookups] "
+				"[-t maxthreads] [-w]");
+		}
+	}
+	if (nnames == 0 || maxthreads == 0) {
+		errx(1, "invalid arguments");
+	}
+
+	threads = malloc(maxthreads * sizeof(threads[0]));
+	INSIST(threads != NULL);
+
+	isc_mem_create(&mctx);
+	load();
+
+	printf("%u names, %u lookups per thread%s\n", nnames, nlookups,
+	       write ? ", with updates" : "");
+
+	for (unsigned int nthreads = 1; nthreads <= maxthreads;
+	     nthreads = nthreads < maxthreads ? ISC_MIN(nthreads * 2,
+							maxthreads)
+					      : nthreads + 1)
+	{
+		isc_thread_t wthread;
+		isc_time_t start, finish;
+		uint64_t us;
+
+		atomic_store(&done, false);
+		if (write) {
+			isc_thread_create(writer, NULL, &wthread);
+		}
+
+		isc_time_now_hires(&start);
+		for (unsigned int i = 0; i < nthreads; i++) {
+			isc_thread_create(reader, (isc_threadarg_t)(uintptr_t)i,
+					  &threads[i]);
+		}
+		for (unsigned int i = 0; i < nthreads; i++) {
+			isc_thread_join(threads[i], NULL);
+		}
+		isc_time_now_hires(&finish);
+
+		atomic_store(&done, true);
+		if (write) {
+			isc_thread_join(wthread, NULL);
+		}
+
+		us = isc_time_microdiff(&finish, &start);
+		printf("%3u threads: %f lookups/s, %f ns/lookup/thread\n",
+		       nthreads, (double)nthreads * nlookups * 1000000.0 / us,
+		       (double)us * 1000.0 / nlookups);
+	}
+
+	dns_db_detach(&db);
+	free(names);
+	free(threads);
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
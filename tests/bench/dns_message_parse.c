@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Compare full and lazy parsing of the messages in a fuzzing corpus.
+ *
+ * Usage: dns_message_parse [directory|file ...]
+ *
+ * By default the fuzz/dns_message_parse.in corpus is used.
+ */
+
+#include <dirent.h>
+#include <err.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <isc/buffer.h>
+#include <isc/mem.h>
+#include <isc/result.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/message.h>
+
+#define MAXPACKETS 65536
+#define REPEAT	   1000
+
+static struct {
+	uint8_t *data;
+	size_t size;
+} packets[MAXPACKETS];
+static unsigned int npackets = 0;
+
+static void
+load_file(const char *filename) {
+	struct stat st;
+	ssize_t n;
+	int fd;
+
+	if (npackets == MAXPACKETS) {
+		errx(1, "too many packets");
+	}
+
+	fd = open(filename, O_RDONLY);
+	if (fd == -1 || fstat(fd, &st) != 0) {
+		err(1, "%s", filename);
+	}
+	if (!S_ISREG(st.st_mode) || st.st_size == 0) {
+		close(fd);
+		return;
+	}
+
+	packets[npackets].data = malloc(st.st_size);
+	INSIST(packets[npackets].data != NULL);
+	n = read(fd, packets[npackets].data, st.st_size);
+	if (n != st.st_size) {
+		err(1, "%s", filename);
+	}
+	packets[npackets++].size = n;
+	close(fd);
+}
+
+static void
+load(const char *path) {
+	DIR *dirp = opendir(path);
+	struct dirent *dp;
+
+	if (dirp == NULL) {
+		load_file(path);
+		return;
+	}
+
+	while ((dp = readdir(dirp)) != NULL) {
+		char filename[PATH_MAX];
+
+		if (dp->d_name[0] == '.') {
+			continue;
+		}
+		snprintf(filename, sizeof(filename), "%s/%s", path,
+			 dp->d_name);
+		load_file(filename);
+	}
+
+	closedir(dirp);
+}
+
+/*
+ * Parse every packet REPEAT times, optionally walking the additional
+ * section afterwards as a consumer of the records would.
+ */
+static void
+bench(isc_mem_t *mctx, const char *what, unsigned int options, bool walk) {
+	dns_message_t *msg = NULL;
+	unsigned int ok = 0, deferred = 0;
+	isc_time_t start, finish;
+	uint64_t us;
+
+	dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &msg);
+
+	isc_time_now_hires(&start);
+	for (unsigned int n = 0; n < REPEAT; n++) {
+		for (unsigned int i = 0; i < npackets; i++) {
+			isc_buffer_t buf;
+			isc_result_t result;
+
+			isc_buffer_constinit(&buf, packets[i].data,
+					     packets[i].size);
+			isc_buffer_add(&buf, packets[i].size);
+
+			result = dns_message_parse(msg, &buf, options);
+			if (n == 0 && result == ISC_R_SUCCESS) {
+				ok++;
+				deferred += msg->deferred;
+			}
+			if (walk && result == ISC_R_SUCCESS) {
+				(void)dns_message_firstname(
+					msg, DNS_SECTION_ADDITIONAL);
+			}
+			dns_message_reset(msg, DNS_MESSAGE_INTENTPARSE);
+		}
+	}
+	isc_time_now_hires(&finish);
+
+	dns_message_detach(&msg);
+
+	us = isc_time_microdiff(&finish, &start);
+	printf("%-12s %u parsed, %u deferred; %f ms; %f ns / message\n", what,
+	       ok, deferred, (double)us / 1000.0,
+	       (double)us * 1000.0 / ((double)REPEAT * npackets));
+}
+
+int
+main(int argc, char **argv) {
+	isc_mem_t *mctx = NULL;
+
+	if (argc > 1) {
+		for (int i = 1; i < argc; i++) {
+			load(argv[i]);
+		}
+	} else {
+		load(FUZZDIR "/dns_message_parse.in");
+	}
+	if (npackets == 0) {
+		errx(1, "no packets");
+	}
+	printf("%u packets, %u rounds\n", npackets, REPEAT);
+
+	isc_mem_create(&mctx);
+
+	bench(mctx, "full", 0, false);
+	bench(mctx, "lazy", DNS_MESSAGEPARSE_LAZY, false);
+	bench(mctx, "lazy+access", DNS_MESSAGEPARSE_LAZY, true);
+
+	for (unsigned int i = 0; i < npackets; i++) {
+		free(packets[i].data);
+	}
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
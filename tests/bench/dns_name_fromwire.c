@@ -11,8 +11,10 @@
  * information regarding copyright ownership.
  */
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <isc/ascii.h>
@@ -91,6 +93,56 @@ oldnew_bench(const uint8_t *data, size_t size) {
 	printf("  old/new %f or %f\n", t01 / t12, t12 / t01);
 }
 
+/*
+ * Parse and lower-case the names, either in one go or by downcasing
+ * them after they have been parsed.
+ */
+static uint32_t
+downcase_bench(const uint8_t *data, size_t size, bool separate) {
+	isc_result_t result;
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_decompress_t dctx = DNS_DECOMPRESS_PERMITTED;
+	unsigned int options = separate ? 0 : DNS_NAME_DOWNCASE;
+	isc_buffer_t buf;
+	uint32_t count = 0;
+
+	isc_buffer_constinit(&buf, data, size);
+	isc_buffer_add(&buf, size);
+	isc_buffer_setactive(&buf, size);
+
+	while (isc_buffer_consumedlength(&buf) < size) {
+		result = dns_name_fromwire(name, &buf, dctx, options, NULL);
+		if (result != ISC_R_SUCCESS) {
+			isc_buffer_forward(&buf, 1);
+		} else if (separate) {
+			(void)dns_name_downcase(name, name, NULL);
+		}
+		count++;
+	}
+	return (count);
+}
+
+static void
+downcase_compare(const uint8_t *data, size_t size) {
+	isc_time_t t0;
+	isc_time_now_hires(&t0);
+	uint32_t n1 = downcase_bench(data, size, true);
+	isc_time_t t1;
+	isc_time_now_hires(&t1);
+	uint32_t n2 = downcase_bench(data, size, false);
+	isc_time_t t2;
+	isc_time_now_hires(&t2);
+
+	double t01 = (double)isc_time_microdiff(&t1, &t0);
+	double t12 = (double)isc_time_microdiff(&t2, &t1);
+	printf("  downcase after %u / %f ms; %f / us\n", n1, t01 / 1000.0,
+	       n1 / t01);
+	printf("  downcase while %u / %f ms; %f / us\n", n2, t12 / 1000.0,
+	       n2 / t12);
+	printf("  after/while %f or %f\n", t01 / t12, t12 / t01);
+}
+
 #define NAMES 1000
 static uint8_t buf[1024 * NAMES];
 
@@ -142,4 +194,24 @@ main(void) {
 	}
 	printf("4 long sequential labels\n");
 	oldnew_bench(buf, p);
+
+	/*
+	 * What names in a typical response look like: one full name, then
+	 * short prefixes followed by a pointer to it.
+	 */
+	static const uint8_t first[] = "\003Www\007Example\003Com";
+	memmove(buf, first, sizeof(first));
+	p = sizeof(first);
+	for (unsigned int name = 0; name < NAMES * 64; name++) {
+		buf[p++] = 4;
+		buf[p++] = 'M';
+		buf[p++] = 'a';
+		buf[p++] = 'i';
+		buf[p++] = 'l';
+		buf[p++] = 0xC0;
+		buf[p++] = 4;
+	}
+	printf("prefix and compression pointer\n");
+	oldnew_bench(buf, p);
+	downcase_compare(buf, p);
 }
@@ -0,0 +1,252 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Compare the memory use and the speed of insertions, exact lookups and
+ * closest-ancestor lookups in a qp-trie and in a red-black tree.
+ *
+ * Usage: dns_qp [count | file]
+ *
+ * The names are read from 'file', one per line, or 'count' random names
+ * (250000 by default) are generated.
+ */
+
+#include <err.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/buffer.h>
+#include <isc/mem.h>
+#include <isc/random.h>
+#include <isc/result.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/qp.h>
+#include <dns/rbt.h>
+
+typedef struct item {
+	dns_name_t name;
+	dns_name_t child;
+} item_t;
+
+static item_t *items = NULL;
+static size_t nitems = 0;
+
+static size_t
+item_makekey(dns_qpkey_t key, void *uctx, void *pval, uint32_t ival) {
+	item_t *item = pval;
+
+	UNUSED(uctx);
+	UNUSED(ival);
+
+	return (dns_qpkey_fromname(key, &item->name));
+}
+
+static const dns_qpmethods_t methods = {
+	.makekey = item_makekey,
+};
+
+static void
+add_name(isc_mem_t *mctx, const char *text) {
+	dns_fixedname_t fixed, fchild;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_name_t *child = dns_fixedname_initname(&fchild);
+	dns_name_t x = DNS_NAME_INITEMPTY;
+	isc_buffer_t b;
+	isc_result_t result;
+
+	isc_buffer_constinit(&b, text, strlen(text));
+	isc_buffer_add(&b, strlen(text));
+	result = dns_name_fromtext(name, &b, dns_rootname, 0, NULL);
+	if (result != ISC_R_SUCCESS) {
+		warnx("%s: %s", text, isc_result_totext(result));
+		return;
+	}
+
+	/* A name below it, for the ancestor lookups */
+	isc_buffer_constinit(&b, "x", 1);
+	isc_buffer_add(&b, 1);
+	result = dns_name_fromtext(child, &b, name, 0, NULL);
+	if (result != ISC_R_SUCCESS) {
+		dns_name_copy(name, child);
+	}
+
+	items = realloc(items, (nitems + 1) * sizeof(items[0]));
+	INSIST(items != NULL);
+	items[nitems].name = x;
+	items[nitems].child = x;
+	dns_name_dup(name, mctx, &items[nitems].name);
+	dns_name_dup(child, mctx, &items[nitems].child);
+	nitems++;
+}
+
+static void
+load(isc_mem_t *mctx, const char *filename) {
+	char line[1024];
+	FILE *fp = fopen(filename, "r");
+
+	if (fp == NULL) {
+		err(1, "%s", filename);
+	}
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		line[strcspn(line, " \t\r\n")] = '\0';
+		if (line[0] != '\0' && line[0] != ';') {
+			add_name(mctx, line);
+		}
+	}
+	fclose(fp);
+}
+
+static void
+generate(isc_mem_t *mctx, size_t count) {
+	static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789-";
+
+	for (size_t i = 0; i < count; i++) {
+		char text[64];
+		size_t len = 3 + isc_random_uniform(10);
+
+		for (size_t j = 0; j < len; j++) {
+			text[j] = alphabet[isc_random_uniform(
+				sizeof(alphabet) - 2)];
+		}
+		snprintf(text + len, sizeof(text) - len, ".d%u.example.",
+			 isc_random_uniform(1000));
+		add_name(mctx, text);
+	}
+}
+
+static double
+elapsed(isc_time_t *start) {
+	isc_time_t now;
+
+	isc_time_now_hires(&now);
+	return ((double)isc_time_microdiff(&now, start) * 1000.0 / nitems);
+}
+
+int
+main(int argc, char **argv) {
+	isc_mem_t *mctx = NULL, *qpmctx = NULL, *rbtmctx = NULL;
+	dns_qp_t *qp = NULL;
+	dns_rbt_t *rbt = NULL;
+	size_t *order = NULL;
+	isc_time_t start;
+	size_t added = 0, found = 0;
+
+	isc_mem_create(&mctx);
+	isc_mem_create(&qpmctx);
+	isc_mem_create(&rbtmctx);
+
+	if (argc > 1 && strtoul(argv[1], NULL, 10) == 0) {
+		load(mctx, argv[1]);
+	} else {
+		generate(mctx, argc > 1 ? strtoul(argv[1], NULL, 10) : 250000);
+	}
+	if (nitems == 0) {
+		errx(1, "no names");
+	}
+
+	/* Look the names up in a different order than they were added */
+	order = malloc(nitems * sizeof(order[0]));
+	INSIST(order != NULL);
+	for (size_t i = 0; i < nitems; i++) {
+		order[i] = i;
+	}
+	for (size_t i = nitems - 1; i > 0; i--) {
+		size_t j = isc_random_uniform(i + 1);
+		size_t t = order[i];
+		order[i] = order[j];
+		order[j] = t;
+	}
+
+	dns_qp_create(qpmctx, &methods, NULL, &qp);
+	isc_time_now_hires(&start);
+	for (size_t i = 0; i < nitems; i++) {
+		added += dns_qp_insert(qp, &items[i], 0) == ISC_R_SUCCESS;
+	}
+	printf("%-6s %zu names, %zu added; insert %f ns/name\n", "qp", nitems,
+	       added, elapsed(&start));
+
+	dns_rbt_create(rbtmctx, NULL, NULL, &rbt);
+	isc_time_now_hires(&start);
+	added = 0;
+	for (size_t i = 0; i < nitems; i++) {
+		added += dns_rbt_addname(rbt, &items[i].name, &items[i]) ==
+			 ISC_R_SUCCESS;
+	}
+	printf("%-6s %zu names, %zu added; insert %f ns/name\n", "rbt", nitems,
+	       added, elapsed(&start));
+
+	printf("%-6s memory %zu bytes, %f bytes/name (plus the names)\n", "qp",
+	       isc_mem_inuse(qpmctx), (double)isc_mem_inuse(qpmctx) / nitems);
+	printf("%-6s memory %zu bytes, %f bytes/name\n", "rbt",
+	       isc_mem_inuse(rbtmctx), (double)isc_mem_inuse(rbtmctx) / nitems);
+
+	isc_time_now_hires(&start);
+	for (size_t i = 0; i < nitems; i++) {
+		found += dns_qp_getname(qp, &items[order[i]].name, NULL,
+					NULL) == ISC_R_SUCCESS;
+	}
+	printf("%-6s exact lookup %f ns/name, %zu found\n", "qp",
+	       elapsed(&start), found);
+
+	isc_time_now_hires(&start);
+	found = 0;
+	for (size_t i = 0; i < nitems; i++) {
+		void *data = NULL;
+		found += dns_rbt_findname(rbt, &items[order[i]].name, 0, NULL,
+					  &data) == ISC_R_SUCCESS;
+	}
+	printf("%-6s exact lookup %f ns/name, %zu found\n", "rbt",
+	       elapsed(&start), found);
+
+	isc_time_now_hires(&start);
+	found = 0;
+	for (size_t i = 0; i < nitems; i++) {
+		found += dns_qp_findname_ancestor(qp, &items[order[i]].child,
+						  NULL, NULL) != ISC_R_NOTFOUND;
+	}
+	printf("%-6s ancestor lookup %f ns/name, %zu found\n", "qp",
+	       elapsed(&start), found);
+
+	isc_time_now_hires(&start);
+	found = 0;
+	for (size_t i = 0; i < nitems; i++) {
+		void *data = NULL;
+		found += dns_rbt_findname(rbt, &items[order[i]].child, 0, NULL,
+					  &data) != ISC_R_NOTFOUND;
+	}
+	printf("%-6s ancestor lookup %f ns/name, %zu found\n", "rbt",
+	       elapsed(&start), found);
+
+	dns_qp_destroy(&qp);
+	dns_rbt_destroy(&rbt);
+
+	for (size_t i = 0; i < nitems; i++) {
+		dns_name_free(&items[i].name, mctx);
+		dns_name_free(&items[i].child, mctx);
+	}
+	free(items);
+	free(order);
+
+	isc_mem_destroy(&rbtmctx);
+	isc_mem_destroy(&qpmctx);
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Compare a heap and a timing wheel as the TTL expiry index of a cache.
+ *
+ * Usage: ttl_expiry [-n entries] [-s seconds] [-u updates]
+ *
+ * The index is filled with entries whose TTLs are drawn from a mix of
+ * the TTLs commonly seen in the DNS, then the clock is run for a number
+ * of seconds.  Every second, the entries that have expired are removed
+ * and replaced with new ones, as a busy cache would, and some others
+ * have their TTLs changed (when an RRset is refreshed, or made ancient
+ * by a newer one).
+ */
+
+#include <err.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <isc/heap.h>
+#include <isc/mem.h>
+#include <isc/time.h>
+#include <isc/util.h>
+#include <isc/wheel.h>
+
+#define START 1700000000
+
+struct entry {
+	isc_stdtime_t ttl;
+	unsigned int index;
+};
+
+/*
+ * Common TTLs, and roughly how often they are seen in a resolver's cache,
+ * in parts per thousand.
+ */
+static const struct {
+	isc_stdtime_t ttl;
+	unsigned int weight;
+} ttls[] = {
+	{ 0, 10 },     { 5, 20 },	{ 30, 60 },    { 60, 120 },
+	{ 300, 250 },  { 600, 80 },	{ 900, 40 },   { 1800, 40 },
+	{ 3600, 160 }, { 7200, 40 },	{ 14400, 30 }, { 21600, 20 },
+	{ 43200, 30 }, { 86400, 80 },	{ 172800, 20 },
+};
+
+static unsigned int nentries = 1000000;
+static unsigned int nseconds = 3600;
+static unsigned int nupdates = 1000;
+static struct entry *entries = NULL;
+static uint32_t state;
+
+static uint32_t
+next(void) {
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return (state);
+}
+
+/*
+ * Pick a TTL from the mix.  Entries have been in the cache for a while
+ * when the test starts, so their remaining TTLs are spread below that.
+ */
+static isc_stdtime_t
+random_ttl(bool aged) {
+	unsigned int n = next() % 1000;
+	isc_stdtime_t ttl = 0;
+
+	for (size_t i = 0; i < ARRAY_SIZE(ttls); i++) {
+		ttl = ttls[i].ttl;
+		if (n < ttls[i].weight) {
+			break;
+		}
+		n -= ttls[i].weight;
+	}
+
+	if (aged && ttl > 0) {
+		ttl = next() % ttl;
+	}
+	return (ttl);
+}
+
+static bool
+sooner(void *v1, void *v2) {
+	struct entry *e1 = v1, *e2 = v2;
+
+	return (e1->ttl < e2->ttl);
+}
+
+static void
+set_index(void *what, unsigned int idx) {
+	struct entry *e = what;
+
+	e->index = idx;
+}
+
+typedef struct {
+	const char *name;
+	void (*create)(isc_mem_t *mctx, void **indexp);
+	void (*destroy)(void **indexp);
+	void (*insert)(void *index, struct entry *e);
+	void (*update)(void *index, struct entry *e, isc_stdtime_t ttl);
+	void (*delete)(void *index, struct entry *e);
+	struct entry *(*expired)(void *index, isc_stdtime_t now);
+} expiry_index_t;
+
+static void
+heap_create(isc_mem_t *mctx, void **indexp) {
+	isc_heap_create(mctx, sooner, set_index, 0, (isc_heap_t **)indexp);
+}
+
+static void
+heap_destroy(void **indexp) {
+	isc_heap_destroy((isc_heap_t **)indexp);
+}
+
+static void
+heap_insert(void *index, struct entry *e) {
+	isc_heap_insert(index, e);
+}
+
+static void
+heap_update(void *index, struct entry *e, isc_stdtime_t ttl) {
+	isc_stdtime_t oldttl = e->ttl;
+
+	e->ttl = ttl;
+	if (ttl < oldttl) {
+		isc_heap_increased(index, e->index);
+	} else if (ttl > oldttl) {
+		isc_heap_decreased(index, e->index);
+	}
+}
+
+static void
+heap_delete(void *index, struct entry *e) {
+	isc_heap_delete(index, e->index);
+}
+
+static struct entry *
+heap_expired(void *index, isc_stdtime_t now) {
+	struct entry *e = isc_heap_element(index, 1);
+
+	return ((e != NULL && e->ttl <= now) ? e : NULL);
+}
+
+static void
+wheel_create(isc_mem_t *mctx, void **indexp) {
+	isc_wheel_create(mctx, START, set_index, (isc_wheel_t **)indexp);
+}
+
+static void
+wheel_destroy(void **indexp) {
+	isc_wheel_destroy((isc_wheel_t **)indexp);
+}
+
+static void
+wheel_insert(void *index, struct entry *e) {
+	isc_wheel_insert(index, e, e->ttl);
+}
+
+static void
+wheel_update(void *index, struct entry *e, isc_stdtime_t ttl) {
+	e->ttl = ttl;
+	isc_wheel_update(index, e->index, ttl);
+}
+
+static void
+wheel_delete(void *index, struct entry *e) {
+	isc_wheel_delete(index, e->index);
+}
+
+static struct entry *
+wheel_expired(void *index, isc_stdtime_t now) {
+	return (isc_wheel_due(index, now));
+}
+
+static const expiry_index_t indexes[] = {
+	{ "heap", heap_create, heap_destroy, heap_insert, heap_update,
+	  heap_delete, heap_expired },
+	{ "wheel", wheel_create, wheel_destroy, wheel_insert, wheel_update,
+	  wheel_delete, wheel_expired },
+};
+
+static void
+run(const expiry_index_t *ix) {
+	isc_mem_t *mctx = NULL;
+	void *index = NULL;
+	isc_time_t start, finish;
+	uint64_t fill_us, run_us;
+	size_t inuse, expired = 0;
+
+	isc_mem_create(&mctx);
+	state = 2463534242U;
+
+	isc_time_now_hires(&start);
+	ix->create(mctx, &index);
+	for (unsigned int i = 0; i < nentries; i++) {
+		entries[i] = (struct entry){ .ttl = START + random_ttl(true) };
+		ix->insert(index, &entries[i]);
+	}
+	isc_time_now_hires(&finish);
+	fill_us = isc_time_microdiff(&finish, &start);
+	inuse = isc_mem_inuse(mctx);
+
+	isc_time_now_hires(&start);
+	for (isc_stdtime_t now = START; now < START + nseconds; now++) {
+		struct entry *e = NULL;
+
+		while ((e = ix->expired(index, now)) != NULL) {
+			/* Replace it with a fresh entry */
+			ix->delete(index, e);
+			e->ttl = now + random_ttl(false) + 1;
+			ix->insert(index, e);
+			expired++;
+		}
+
+		for (unsigned int i = 0; i < nupdates; i++) {
+			e = &entries[next() % nentries];
+			if (i % 4 == 0) {
+				/* Made ancient */
+				ix->update(index, e, 0);
+			} else {
+				/* Refreshed */
+				ix->update(index, e,
+					   now + random_ttl(false) + 1);
+			}
+		}
+	}
+	isc_time_now_hires(&finish);
+	run_us = isc_time_microdiff(&finish, &start);
+
+	printf("%-6s fill %8.1f ns/entry, %6.1f bytes/entry; "
+	       "run %8.1f ns/op (%zu expired, %u updated)\n",
+	       ix->name, (double)fill_us * 1000.0 / nentries,
+	       (double)inuse / nentries,
+	       (double)run_us * 1000.0 / (2 * expired + (size_t)nupdates *
+								 nseconds),
+	       expired, nupdates * nseconds);
+
+	ix->destroy(&index);
+	isc_mem_destroy(&mctx);
+}
+
+int
+main(int argc, char **argv) {
+	int ch;
+
+	while ((ch = getopt(argc, argv, "n:s:u:")) != -1) {
+		switch (ch) {
+		case 'n':
+			nentries = atoi(optarg);
+			break;
+		case 's':
+			nseconds = atoi(optarg);
+			break;
+		case 'u':
+			nupdates = atoi(optarg);
+			break;
+		default:
+			errx(1, "usage: ttl_expiry [-n entries] [-s seconds] "
+				"[-u updates]");
+		}
+	}
+	if (nentries == 0) {
+		errx(1, "invalid arguments");
+	}
+
+	entries = malloc(nentries * sizeof(entries[0]));
+	INSIST(entries != NULL);
+
+	printf("%u entries, %u seconds, %u updates per second\n", nentries,
+	       nseconds, nupdates);
+
+	for (size_t i = 0; i < ARRAY_SIZE(indexes); i++) {
+		run(&indexes[i]);
+	}
+
+	free(entries);
+
+	return (0);
+}
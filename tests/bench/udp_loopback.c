@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Measure the UDP request/response throughput of the network manager over
+ * the loopback interface, with and without batched UDP sends, and with
+ * the io_uring backend.
+ *
+ * The server side is an echo server running on the netmgr loops, the
+ * client side is a set of plain threads, each of them sending bursts of
+ * datagrams from its own socket and waiting for the responses.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <isc/atomic.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/netmgr.h>
+#include <isc/os.h>
+#include <isc/sockaddr.h>
+#include <isc/thread.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#define PORT	 5300
+#define DURATION 5 /* seconds */
+#define BURST	 32
+#define MSGSIZE	 64
+#define TIMEOUT	 50 /* milliseconds */
+
+static isc_mem_t *mctx = NULL;
+static isc_loopmgr_t *loopmgr = NULL;
+static isc_nm_t *netmgr = NULL;
+static isc_nmsocket_t *listen_sock = NULL;
+static isc_sockaddr_t listen_addr;
+
+static uint32_t nloops;
+static uint32_t nclients;
+static atomic_uint_fast64_t responses;
+
+static void
+send_cb(isc_nmhandle_t *handle, isc_result_t eresult, void *cbarg) {
+	UNUSED(eresult);
+
+	isc_mem_put(mctx, cbarg, MSGSIZE);
+	isc_nmhandle_detach(&handle);
+}
+
+static void
+echo_cb(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
+	void *cbarg) {
+	isc_nmhandle_t *sendhandle = NULL;
+	isc_region_t reply;
+
+	UNUSED(cbarg);
+
+	if (eresult != ISC_R_SUCCESS || region->length != MSGSIZE) {
+		return;
+	}
+
+	/*
+	 * The receive buffer is only valid until we return, so we have to
+	 * copy the data like a real server would.
+	 */
+	reply.base = isc_mem_get(mctx, MSGSIZE);
+	reply.length = MSGSIZE;
+	memmove(reply.base, region->base, MSGSIZE);
+
+	isc_nmhandle_attach(handle, &sendhandle);
+	isc_nm_send(sendhandle, &reply, send_cb, reply.base);
+}
+
+static isc_threadresult_t
+client_thread(isc_threadarg_t arg) {
+	uint8_t msg[MSGSIZE] = { 0 };
+	uint64_t count = 0;
+	isc_time_t start, now;
+	int fd;
+
+	UNUSED(arg);
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	RUNTIME_CHECK(fd >= 0);
+	RUNTIME_CHECK(connect(fd, &listen_addr.type.sa, listen_addr.length) ==
+		      0);
+
+	isc_time_now_hires(&start);
+
+	do {
+		struct pollfd pfd = { .fd = fd, .events = POLLIN };
+		size_t received = 0;
+
+		for (size_t i = 0; i < BURST; i++) {
+			(void)send(fd, msg, sizeof(msg), 0);
+		}
+
+		while (received < BURST && poll(&pfd, 1, TIMEOUT) > 0) {
+			uint8_t buf[MSGSIZE];
+
+			while (recv(fd, buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+				received++;
+			}
+		}
+
+		count += received;
+		isc_time_now_hires(&now);
+	} while (isc_time_microdiff(&now, &start) < DURATION * US_PER_SEC);
+
+	close(fd);
+
+	atomic_fetch_add_relaxed(&responses, count);
+
+	return ((isc_threadresult_t)0);
+}
+
+static isc_threadresult_t
+clients_thread(isc_threadarg_t arg) {
+	isc_thread_t *threads = NULL;
+
+	UNUSED(arg);
+
+	threads = malloc(nclients * sizeof(threads[0]));
+	RUNTIME_CHECK(threads != NULL);
+
+	for (size_t i = 0; i < nclients; i++) {
+		isc_thread_create(client_thread, NULL, &threads[i]);
+	}
+
+	for (size_t i = 0; i < nclients; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+
+	free(threads);
+
+	isc_loopmgr_shutdown(loopmgr);
+
+	return ((isc_threadresult_t)0);
+}
+
+static void
+stop_listening(void *arg) {
+	UNUSED(arg);
+
+	isc_nm_stoplistening(listen_sock);
+	isc_nmsocket_close(&listen_sock);
+}
+
+static void
+start_listening(void *arg) {
+	isc_result_t result;
+
+	UNUSED(arg);
+
+	result = isc_nm_listenudp(netmgr, ISC_NM_LISTEN_ALL, &listen_addr,
+				  echo_cb, NULL, &listen_sock);
+	if (result != ISC_R_SUCCESS) {
+		fprintf(stderr, "isc_nm_listenudp: %s\n",
+			isc_result_totext(result));
+		exit(1);
+	}
+
+	isc_loop_teardown(isc_loop_main(loopmgr), stop_listening, NULL);
+}
+
+static void
+run(const char *name, isc_nm_backend_t backend, bool batch) {
+	isc_thread_t thread;
+	uint64_t total;
+
+	isc_loopmgr_create(mctx, nloops, &loopmgr);
+	isc_netmgr_create(mctx, loopmgr, &netmgr);
+
+	isc_nm_setudpsendbatch(netmgr, batch);
+	if (isc_nm_getudpsendbatch(netmgr) != batch ||
+	    isc_nm_setbackend(netmgr, backend) != ISC_R_SUCCESS)
+	{
+		printf("%-9s: not supported\n", name);
+		isc_netmgr_destroy(&netmgr);
+		isc_loopmgr_destroy(&loopmgr);
+		return;
+	}
+
+	atomic_store(&responses, 0);
+
+	isc_loop_setup(isc_loop_main(loopmgr), start_listening, NULL);
+	isc_thread_create(clients_thread, NULL, &thread);
+
+	isc_loopmgr_run(loopmgr);
+
+	isc_thread_join(thread, NULL);
+
+	isc_netmgr_destroy(&netmgr);
+	isc_loopmgr_destroy(&loopmgr);
+
+	total = atomic_load(&responses);
+	printf("%-9s: %u loops, %u clients, %" PRIu64
+	       " responses, %.0f qps\n",
+	       name, nloops, nclients, total, (double)total / DURATION);
+}
+
+int
+main(int argc, char **argv) {
+	struct in_addr in = { .s_addr = htonl(INADDR_LOOPBACK) };
+
+	nloops = (argc > 1) ? (uint32_t)atoi(argv[1]) : isc_os_ncpus();
+	nclients = (argc > 2) ? (uint32_t)atoi(argv[2]) : 2 * nloops;
+	if (nloops == 0 || nclients == 0) {
+		fprintf(stderr, "usage: %s [loops [clients]]\n", argv[0]);
+		exit(1);
+	}
+
+	isc_sockaddr_fromin(&listen_addr, &in, PORT);
+
+	isc_mem_create(&mctx);
+
+	run("batch off", isc_nm_backend_libuv, false);
+	run("batch on", isc_nm_backend_libuv, true);
+	run("io_uring", isc_nm_backend_uring, false);
+
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/net.h>
+#include <isc/netaddr.h>
+#include <isc/sockaddr.h>
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/adb.h>
+#include <dns/dispatch.h>
+#include <dns/resolver.h>
+#include <dns/view.h>
+
+#include <tests/dns.h>
+
+#define ADDRESSES 1000
+
+static dns_dispatchmgr_t *dispatchmgr = NULL;
+static dns_dispatch_t *dispatch = NULL;
+static dns_view_t *view = NULL;
+
+static int
+setup_test(void **state) {
+	isc_result_t result;
+	isc_sockaddr_t local;
+
+	setup_managers(state);
+
+	result = dns_dispatchmgr_create(mctx, netmgr, &dispatchmgr);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_sockaddr_any(&local);
+	result = dns_dispatch_createudp(dispatchmgr, &local, &dispatch);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	return (0);
+}
+
+static int
+teardown_test(void **state) {
+	dns_dispatch_detach(&dispatch);
+	dns_dispatchmgr_detach(&dispatchmgr);
+	teardown_managers(state);
+
+	return (0);
+}
+
+static void
+mkview(void) {
+	isc_result_t result;
+
+	result = dns_test_makeview("view", true, &view);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_view_createresolver(view, loopmgr, taskmgr, 1, netmgr, 0,
+					 dispatchmgr, dispatch, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+}
+
+static void
+mkaddr(size_t i, isc_sockaddr_t *sa) {
+	struct in_addr ina;
+
+	ina.s_addr = htonl(0x0a000000 + (uint32_t)i);
+	isc_sockaddr_fromin(sa, &ina, 53);
+}
+
+/*
+ * Count the unassociated entries in the ADB dump.
+ */
+static size_t
+countentries(dns_adb_t *adb) {
+	char *text = NULL, *p = NULL;
+	size_t size = 0, count = 0;
+	FILE *fp = open_memstream(&text, &size);
+
+	assert_non_null(fp);
+	dns_adb_dump(adb, fp);
+	fclose(fp);
+
+	for (p = strstr(text, "[srtt "); p != NULL; p = strstr(p + 1, "[srtt "))
+	{
+		count++;
+	}
+	free(text);
+
+	return (count);
+}
+
+/* address state is kept per address, whichever bucket it lands in */
+ISC_LOOP_TEST_IMPL(findaddrinfo) {
+	isc_result_t result;
+	dns_adb_t *adb = NULL;
+	isc_stdtime_t now;
+
+	isc_stdtime_get(&now);
+	mkview();
+	dns_adb_attach(view->adb, &adb);
+
+	for (size_t i = 0; i < ADDRESSES; i++) {
+		dns_adbaddrinfo_t *addr = NULL;
+		isc_sockaddr_t sa;
+
+		mkaddr(i, &sa);
+		result = dns_adb_findaddrinfo(adb, &sa, &addr, now);
+		assert_int_equal(result, ISC_R_SUCCESS);
+
+		dns_adb_adjustsrtt(adb, addr, (i + 1) * 10,
+				   DNS_ADB_RTTADJREPLACE);
+		if (i % 2 == 0) {
+			dns_adb_changeflags(adb, addr, DNS_FETCHOPT_NOEDNS0,
+					    DNS_FETCHOPT_NOEDNS0);
+		}
+		dns_adb_freeaddrinfo(adb, &addr);
+	}
+
+	assert_int_equal(countentries(adb), ADDRESSES);
+
+	for (size_t i = 0; i < ADDRESSES; i++) {
+		dns_adbaddrinfo_t *addr = NULL;
+		isc_sockaddr_t sa;
+
+		mkaddr(i, &sa);
+		result = dns_adb_findaddrinfo(adb, &sa, &addr, now);
+		assert_int_equal(result, ISC_R_SUCCESS);
+
+		assert_true(isc_sockaddr_equal(&addr->sockaddr, &sa));
+		assert_int_equal(addr->srtt, (i + 1) * 10);
+		assert_int_equal((addr->flags & DNS_FETCHOPT_NOEDNS0) != 0,
+				 i % 2 == 0);
+		dns_adb_freeaddrinfo(adb, &addr);
+	}
+
+	/* Flushing removes every unassociated entry */
+	dns_adb_flush(adb);
+	assert_int_equal(countentries(adb), 0);
+
+	dns_adb_detach(&adb);
+	dns_view_detach(&view);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY_CUSTOM(findaddrinfo, setup_test, teardown_test)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
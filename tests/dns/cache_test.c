@@ -0,0 +1,605 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/loop.h>
+#include <isc/stats.h>
+#include <isc/stdtime.h>
+#include <isc/time.h>
+#include <isc/timer.h>
+#include <isc/util.h>
+
+#include <dns/cache.h>
+#include <dns/callbacks.h>
+#include <dns/db.h>
+#include <dns/dbiterator.h>
+#include <dns/fixedname.h>
+#include <dns/master.h>
+#include <dns/masterdump.h>
+#include <dns/name.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/stats.h>
+
+#include <tests/dns.h>
+
+#define NSHARDS 4
+#define NNAMES	64
+
+static void
+addrdataset(dns_db_t *db, const char *owner, dns_rdatatype_t type,
+	    const char *text) {
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	unsigned char buf[256];
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+
+	result = dns_name_fromstring(name, owner, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_test_rdatafromstring(&rdata, dns_rdataclass_in, type, buf,
+					  sizeof(buf), text, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = type;
+	rdatalist.ttl = 300;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+	dns_rdataset_init(&rdataset);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	rdataset.trust = dns_trust_authanswer;
+
+	result = dns_db_findnode(db, name, true, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_addrdataset(db, node, NULL, 0, &rdataset, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+	dns_rdataset_disassociate(&rdataset);
+}
+
+static isc_result_t
+find(dns_db_t *db, const char *owner, dns_rdatatype_t type,
+     dns_name_t *foundname) {
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_rdataset_t rdataset;
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+
+	result = dns_name_fromstring(name, owner, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(db, name, NULL, type, 0, 0, &node, foundname,
+			     &rdataset, NULL);
+	if (dns_rdataset_isassociated(&rdataset)) {
+		dns_rdataset_disassociate(&rdataset);
+	}
+	if (node != NULL) {
+		dns_db_detachnode(db, &node);
+	}
+
+	return (result);
+}
+
+/*
+ * Create a sharded cache and fill it with A records for 'n<i>.example<i>.'
+ * and a delegation for 'com.'.
+ */
+static void
+makecache(dns_cache_t **cachep, dns_db_t **dbp) {
+	isc_result_t result;
+
+	result = dns_cache_create(loopmgr, dns_rdataclass_in, "test", NSHARDS,
+				  cachep);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(dns_cache_getshards(*cachep), NSHARDS);
+
+	dns_cache_attachdb(*cachep, dbp);
+	assert_true(dns_db_iscache(*dbp));
+
+	addrdataset(*dbp, "com", dns_rdatatype_ns, "a.gtld-servers.net.");
+	for (unsigned int i = 0; i < NNAMES; i++) {
+		char owner[64];
+
+		snprintf(owner, sizeof(owner), "n%u.example%u.com", i, i);
+		addrdataset(*dbp, owner, dns_rdatatype_a, "192.0.2.1");
+	}
+}
+
+/* names are found in the shard they were added to */
+ISC_LOOP_TEST_IMPL(find) {
+	dns_cache_t *cache = NULL;
+	dns_db_t *db = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *foundname = dns_fixedname_initname(&fixed);
+	isc_result_t result;
+
+	makecache(&cache, &db);
+
+	for (unsigned int i = 0; i < NNAMES; i++) {
+		char owner[64];
+
+		snprintf(owner, sizeof(owner), "n%u.example%u.com", i, i);
+		result = find(db, owner, dns_rdatatype_a, foundname);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+
+	/* The delegation for 'com.' is found from any shard */
+	for (unsigned int i = 0; i < NNAMES; i++) {
+		dns_fixedname_t cfixed;
+		dns_name_t *com = dns_fixedname_initname(&cfixed);
+		char owner[64];
+
+		snprintf(owner, sizeof(owner), "x.example%u.com", i);
+		result = find(db, owner, dns_rdatatype_a, foundname);
+		assert_int_equal(result, DNS_R_DELEGATION);
+		result = dns_name_fromstring(com, "com", 0, NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_true(dns_name_equal(foundname, com));
+	}
+
+	assert_true(dns_db_nodecount(db, dns_dbtree_main) > NNAMES);
+	assert_non_null(dns_db_getrrsetstats(db));
+
+	dns_db_detach(&db);
+	dns_cache_detach(&cache);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/*
+ * iterating over the cache visits the names of all shards in order; names
+ * that are in more than one shard (like the root) are visited once per shard
+ */
+ISC_LOOP_TEST_IMPL(iterate) {
+	dns_cache_t *cache = NULL;
+	dns_db_t *db = NULL;
+	dns_dbiterator_t *iter = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fixed[2];
+	dns_name_t *name = dns_fixedname_initname(&fixed[0]);
+	dns_name_t *prev = dns_fixedname_initname(&fixed[1]);
+	unsigned int count, hosts;
+	isc_result_t result;
+
+	makecache(&cache, &db);
+
+	result = dns_db_createiterator(db, 0, &iter);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	count = hosts = 0;
+	for (result = dns_dbiterator_first(iter); result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_next(iter))
+	{
+		result = dns_dbiterator_current(iter, &node, name);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		dns_db_detachnode(db, &node);
+		if (count > 0) {
+			assert_true(dns_name_compare(prev, name) <= 0);
+		}
+		dns_name_copy(name, prev);
+		count++;
+		if (dns_name_countlabels(name) == 4) {
+			hosts++;
+		}
+	}
+	assert_int_equal(result, ISC_R_NOMORE);
+	assert_int_equal(hosts, NNAMES);
+
+	count = hosts = 0;
+	for (result = dns_dbiterator_last(iter); result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_prev(iter))
+	{
+		result = dns_dbiterator_current(iter, &node, name);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		dns_db_detachnode(db, &node);
+		if (count > 0) {
+			assert_true(dns_name_compare(prev, name) >= 0);
+		}
+		dns_name_copy(name, prev);
+		count++;
+		if (dns_name_countlabels(name) == 4) {
+			hosts++;
+		}
+	}
+	assert_int_equal(result, ISC_R_NOMORE);
+	assert_int_equal(hosts, NNAMES);
+
+	/* Seeking to a missing name stops at its predecessor */
+	result = dns_name_fromstring(prev, "n10.example10.com", 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_name_fromstring(name, "m.example10.com", 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_dbiterator_seek(iter, name);
+	assert_int_equal(result, DNS_R_PARTIALMATCH);
+	result = dns_dbiterator_next(iter);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_dbiterator_current(iter, &node, name);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+	assert_true(dns_name_equal(name, prev));
+
+	dns_dbiterator_destroy(&iter);
+	dns_db_detach(&db);
+	dns_cache_detach(&cache);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* flushing a tree removes the names below it from every shard */
+ISC_LOOP_TEST_IMPL(flushtree) {
+	dns_cache_t *cache = NULL;
+	dns_db_t *db = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	isc_result_t result;
+
+	makecache(&cache, &db);
+
+	result = dns_name_fromstring(name, "example1.com", 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_cache_flushnode(cache, name, true);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = find(db, "n1.example1.com", dns_rdatatype_a, name);
+	assert_int_equal(result, DNS_R_DELEGATION);
+	result = find(db, "n2.example2.com", dns_rdatatype_a, name);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_name_fromstring(name, "com", 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_cache_flushnode(cache, name, true);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	for (unsigned int i = 0; i < NNAMES; i++) {
+		char owner[64];
+
+		snprintf(owner, sizeof(owner), "n%u.example%u.com", i, i);
+		result = find(db, owner, dns_rdatatype_a, name);
+		assert_int_equal(result, ISC_R_NOTFOUND);
+	}
+
+	dns_db_detach(&db);
+	dns_cache_detach(&cache);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+#define SNAPSHOT "cache_test.snapshot"
+
+static dns_ttl_t count_maxttl = 300;
+
+static isc_result_t
+count_add(void *arg, const dns_name_t *name, dns_rdataset_t *rdataset) {
+	unsigned int *count = arg;
+
+	UNUSED(name);
+
+	assert_int_equal(rdataset->trust, dns_trust_authanswer);
+	assert_true(rdataset->ttl <= count_maxttl);
+	(*count)++;
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Add a negative cache entry saying that 'owner' does not exist, with a
+ * made-up root SOA as the proof.
+ */
+static void
+addnxdomain(dns_db_t *db, const char *owner) {
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	unsigned char ncache[] = {
+		0, 0, dns_rdatatype_soa, dns_trust_authauthority,
+		0, 1, 0, 22, /* one SOA, 22 octets */
+		0, 0,	     /* MNAME and RNAME */
+		0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1,
+	};
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	isc_region_t r = { ncache, sizeof(ncache) };
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+
+	result = dns_name_fromstring(name, owner, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_rdata_fromregion(&rdata, dns_rdataclass_in, 0, &r);
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.covers = dns_rdatatype_any;
+	rdatalist.ttl = 300;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+	dns_rdataset_init(&rdataset);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	rdataset.trust = dns_trust_authanswer;
+	rdataset.attributes |= DNS_RDATASETATTR_NEGATIVE |
+			       DNS_RDATASETATTR_NXDOMAIN;
+
+	result = dns_db_findnode(db, name, true, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_addrdataset(db, node, NULL, 0, &rdataset, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+	dns_rdataset_disassociate(&rdataset);
+}
+
+/*
+ * Overwrite the 'len' octets at 'offset' of a snapshot, and return what
+ * was there in 'old'.
+ */
+static void
+patchsnapshot(long offset, const void *data, void *old, size_t len) {
+	FILE *fp = fopen(SNAPSHOT, "r+");
+
+	assert_non_null(fp);
+	assert_int_equal(fseek(fp, offset, SEEK_SET), 0);
+	assert_int_equal(fread(old, 1, len, fp), len);
+	assert_int_equal(fseek(fp, offset, SEEK_SET), 0);
+	assert_int_equal(fwrite(data, 1, len, fp), len);
+	assert_int_equal(fclose(fp), 0);
+}
+
+/*
+ * Offsets in a snapshot of the expiry time and trust level of the first
+ * RRset, after the 24 octet file header
+ */
+#define EXPIRE_OFFSET (24 + 10)
+#define TRUST_OFFSET  (24 + 18)
+
+/* a cache snapshot is reloaded as it was, less what has expired */
+ISC_LOOP_TEST_IMPL(snapshot) {
+	dns_cache_t *cache = NULL, *cache2 = NULL;
+	dns_db_t *db = NULL, *db2 = NULL;
+	dns_fixedname_t fixed, ffixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_name_t *foundname = dns_fixedname_initname(&ffixed);
+	dns_rdataset_t rdataset;
+	dns_dbnode_t *node = NULL;
+	dns_rdatacallbacks_t callbacks;
+	unsigned int count = 0;
+	isc_stdtime_t now;
+	isc_result_t result;
+
+	makecache(&cache, &db);
+	addnxdomain(db, "nx.example.com");
+
+	result = dns_cache_savesnapshot(cache, SNAPSHOT);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_cache_create(loopmgr, dns_rdataclass_in, "test2", 1,
+				  &cache2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_cache_loadsnapshot(cache2, SNAPSHOT, 0, &count);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(count, NNAMES + 2);
+
+	dns_cache_attachdb(cache2, &db2);
+	for (unsigned int i = 0; i < NNAMES; i++) {
+		char owner[64];
+
+		snprintf(owner, sizeof(owner), "n%u.example%u.com", i, i);
+		result = dns_name_fromstring(name, owner, 0, NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+
+		dns_rdataset_init(&rdataset);
+		result = dns_db_find(db2, name, NULL, dns_rdatatype_a, 0, 0,
+				     &node, foundname, &rdataset, NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_int_equal(rdataset.trust, dns_trust_authanswer);
+		assert_true(rdataset.ttl > 0 && rdataset.ttl <= 300);
+		dns_rdataset_disassociate(&rdataset);
+		dns_db_detachnode(db2, &node);
+	}
+
+	result = find(db2, "nx.example.com", dns_rdatatype_a, foundname);
+	assert_int_equal(result, DNS_R_NCACHENXDOMAIN);
+
+	/* Everything has expired by the time its TTL has run out */
+	isc_stdtime_get(&now);
+	dns_rdatacallbacks_init(&callbacks);
+	callbacks.add = count_add;
+	callbacks.add_private = &count;
+
+	count = 0;
+	result = dns_master_loadcache(SNAPSHOT, dns_rdataclass_in, now, 0,
+				      &callbacks, mctx);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(count, NNAMES + 2);
+
+	count = 0;
+	result = dns_master_loadcache(SNAPSHOT, dns_rdataclass_in, now + 301,
+				      0, &callbacks, mctx);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(count, 0);
+
+	/* The TTLs are capped */
+	count = 0;
+	count_maxttl = 100;
+	result = dns_master_loadcache(SNAPSHOT, dns_rdataclass_in, now, 100,
+				      &callbacks, mctx);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(count, NNAMES + 2);
+	count_maxttl = 300;
+
+	/* A trust level no cache entry can have is rejected */
+	{
+		unsigned char trust[2] = { 0, dns_trust_ultimate };
+		unsigned char old[2];
+
+		patchsnapshot(TRUST_OFFSET, trust, old, sizeof(old));
+		result = dns_master_loadcache(SNAPSHOT, dns_rdataclass_in, now,
+					      0, &callbacks, mctx);
+		assert_int_equal(result, ISC_R_RANGE);
+		patchsnapshot(TRUST_OFFSET, old, trust, sizeof(old));
+	}
+
+	/* So is a TTL longer than RFC 2181 allows */
+	{
+		uint32_t far = now + 0x80000000U;
+		unsigned char expire[4] = { far >> 24, far >> 16, far >> 8,
+					    far };
+		unsigned char old[4];
+
+		patchsnapshot(EXPIRE_OFFSET, expire, old, sizeof(old));
+		result = dns_master_loadcache(SNAPSHOT, dns_rdataclass_in, now,
+					      0, &callbacks, mctx);
+		assert_int_equal(result, ISC_R_RANGE);
+		patchsnapshot(EXPIRE_OFFSET, old, expire, sizeof(old));
+	}
+
+	count = 0;
+	result = dns_master_loadcache(SNAPSHOT, dns_rdataclass_in, now, 0,
+				      &callbacks, mctx);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(count, NNAMES + 2);
+
+	/* There is nothing to load from a missing file */
+	result = dns_cache_loadsnapshot(cache2, "nonexistent.snapshot", 0,
+					NULL);
+	assert_int_equal(result, ISC_R_FILENOTFOUND);
+
+	(void)unlink(SNAPSHOT);
+
+	dns_db_detach(&db2);
+	dns_cache_detach(&cache2);
+	dns_db_detach(&db);
+	dns_cache_detach(&cache);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static dns_cache_t *async_cache = NULL;
+static dns_dumpctx_t *async_dctx = NULL;
+
+static void
+savesnapshot_done(void *arg, isc_result_t result) {
+	dns_rdatacallbacks_t callbacks;
+	unsigned int count = 0;
+	isc_stdtime_t now;
+
+	UNUSED(arg);
+
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_dumpctx_detach(&async_dctx);
+
+	isc_stdtime_get(&now);
+	dns_rdatacallbacks_init(&callbacks);
+	callbacks.add = count_add;
+	callbacks.add_private = &count;
+	result = dns_master_loadcache(SNAPSHOT, dns_rdataclass_in, now, 0,
+				      &callbacks, mctx);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(count, NNAMES + 1);
+
+	(void)unlink(SNAPSHOT);
+
+	dns_cache_detach(&async_cache);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* a cache snapshot can be written in the background */
+ISC_LOOP_TEST_IMPL(snapshotasync) {
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	makecache(&async_cache, &db);
+	dns_db_detach(&db);
+
+	result = dns_cache_savesnapshotasync(async_cache, SNAPSHOT, mainloop,
+					     savesnapshot_done, NULL,
+					     &async_dctx);
+	assert_int_equal(result, ISC_R_SUCCESS);
+}
+
+static dns_cache_t *cleaner_cache = NULL;
+static dns_db_t *cleaner_db = NULL;
+static isc_timer_t *cleaner_timer = NULL;
+static unsigned int cleaner_ticks = 0;
+
+#define CLEANER_NAMES 50000
+
+static void
+cleaner_tick(void *arg) {
+	isc_stats_t *stats = dns_cache_getstats(cleaner_cache);
+
+	UNUSED(arg);
+
+	if (isc_stats_get_counter(stats,
+				  dns_cachestatscounter_cleanersweeps) == 0 ||
+	    dns_db_nodecount(cleaner_db, dns_dbtree_main) >= CLEANER_NAMES)
+	{
+		assert_true(++cleaner_ticks < 1000);
+		return;
+	}
+
+	assert_true(isc_stats_get_counter(stats,
+					  dns_cachestatscounter_deletelru) > 0);
+
+	isc_timer_destroy(&cleaner_timer);
+	dns_db_detach(&cleaner_db);
+	dns_cache_detach(&cleaner_cache);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* the background cleaner evicts entries when the cache is over its limit */
+ISC_LOOP_TEST_IMPL(cleaner) {
+	isc_interval_t interval;
+	isc_result_t result;
+
+	result = dns_cache_create(loopmgr, dns_rdataclass_in, "test", 0,
+				  &cleaner_cache);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	/* The size is raised to the smallest one allowed */
+	dns_cache_setcachesize(cleaner_cache, 1);
+	dns_cache_attachdb(cleaner_cache, &cleaner_db);
+
+	/*
+	 * The cleaner runs on this loop, so nothing is evicted until this
+	 * function returns.
+	 */
+	for (unsigned int i = 0; i < CLEANER_NAMES; i++) {
+		char owner[64];
+
+		snprintf(owner, sizeof(owner), "n%u.example", i);
+		addrdataset(cleaner_db, owner, dns_rdatatype_a, "192.0.2.1");
+	}
+
+	isc_interval_set(&interval, 0, NS_PER_SEC / 100);
+	isc_timer_create(mainloop, cleaner_tick, NULL, &cleaner_timer);
+	isc_timer_start(cleaner_timer, isc_timertype_ticker, &interval);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY_CUSTOM(find, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(iterate, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(flushtree, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(snapshot, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(snapshotasync, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(cleaner, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -291,6 +291,26 @@ ISC_RUN_TEST_IMPL(dbtype) {
 	dns_db_detach(&db);
 }
 
+/* database generations are never reused */
+ISC_RUN_TEST_IMPL(generation) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	uint64_t generation = 0;
+
+	UNUSED(state);
+
+	for (size_t i = 0; i < 10; i++) {
+		result = dns_db_create(mctx, "rbt", dns_rootname,
+				       dns_dbtype_zone, dns_rdataclass_in, 0,
+				       NULL, &db);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_int_not_equal(dns_db_generation(db), 0);
+		assert_true(dns_db_generation(db) > generation);
+		generation = dns_db_generation(db);
+		dns_db_detach(&db);
+	}
+}
+
 /* database versions */
 ISC_RUN_TEST_IMPL(version) {
 	isc_result_t result;
@@ -364,6 +384,7 @@ ISC_TEST_ENTRY(getsetservestalettl)
 ISC_TEST_ENTRY(dns_dbfind_staleok)
 ISC_TEST_ENTRY(class)
 ISC_TEST_ENTRY(dbtype)
+ISC_TEST_ENTRY(generation)
 ISC_TEST_ENTRY(version)
 ISC_TEST_LIST_END
 
@@ -24,8 +24,10 @@
 #define UNIT_TESTING
 #include <cmocka.h>
 
+#include <isc/async.h>
 #include <isc/buffer.h>
 #include <isc/managers.h>
+#include <isc/portset.h>
 #include <isc/refcount.h>
 #include <isc/tls.h>
 #include <isc/util.h>
@@ -471,6 +473,59 @@ ISC_LOOP_TEST_IMPL(dispatch_timeout_tcp_connect) {
 	dns_dispatch_connect(dispentry);
 }
 
+/* IDs handed out by the QID table never collide for the same peer */
+ISC_LOOP_TEST_IMPL(dispatch_add_fixedid) {
+	isc_result_t result;
+	dns_dispentry_t *entries[256] = { NULL };
+	dns_dispentry_t *extra = NULL;
+	uint16_t id;
+
+	tcp_connect_addr = (isc_sockaddr_t){ .length = 0 };
+	isc_sockaddr_fromin6(&tcp_connect_addr, &in6addr_loopback, 0);
+
+	result = dns_dispatchmgr_create(mctx, connect_nm, &dispatchmgr);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_dispatch_createtcp(dispatchmgr, &tcp_connect_addr,
+					&tcp_server_addr, -1, &dispatch);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_dispatchmgr_detach(&dispatchmgr);
+
+	for (size_t i = 0; i < ARRAY_SIZE(entries); i++) {
+		id = (uint16_t)i;
+		result = dns_dispatch_add(dispatch, DNS_DISPATCHOPT_FIXEDID,
+					  T_CLIENT_CONNECT, &tcp_server_addr,
+					  NULL, NULL, connected, client_senddone,
+					  response, NULL, &id, &entries[i]);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_int_equal(id, i);
+	}
+
+	/* A fixed ID that is already in use must be refused */
+	id = 0;
+	result = dns_dispatch_add(dispatch, DNS_DISPATCHOPT_FIXEDID,
+				  T_CLIENT_CONNECT, &tcp_server_addr, NULL, NULL,
+				  connected, client_senddone, response, NULL,
+				  &id, &extra);
+	assert_int_equal(result, ISC_R_NOMORE);
+	assert_null(extra);
+
+	/* A random ID steps over the ones already taken */
+	result = dns_dispatch_add(dispatch, 0, T_CLIENT_CONNECT,
+				  &tcp_server_addr, NULL, NULL, connected,
+				  client_senddone, response, NULL, &id, &extra);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(id >= ARRAY_SIZE(entries));
+
+	dns_dispatch_done(&extra);
+	for (size_t i = 0; i < ARRAY_SIZE(entries); i++) {
+		dns_dispatch_done(&entries[i]);
+	}
+	dns_dispatch_detach(&dispatch);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
 static void
 stop_listening(void *arg) {
 	UNUSED(arg);
@@ -654,15 +709,147 @@ ISC_LOOP_TEST_IMPL(dispatch_getnext) {
 	dns_dispatch_connect(dispentry);
 }
 
+/*
+ * The UDP dispatch entries take their sockets from the loop's pool of
+ * pre-bound sockets, as long as their ports are still in the portset.
+ */
+typedef struct {
+	in_port_t lo, hi;
+	dns_dispentry_t *resp;
+} udppool_entry_t;
+
+static udppool_entry_t udppool_entries[2];
+static unsigned int udppool_connected = 0;
+static unsigned int udppool_size = 0;
+
+static void
+udppool_setports(in_port_t lo, in_port_t hi) {
+	isc_portset_t *v4portset = NULL, *v6portset = NULL;
+	isc_result_t result;
+
+	isc_portset_create(mctx, &v4portset);
+	isc_portset_create(mctx, &v6portset);
+	isc_portset_addrange(v4portset, lo, hi);
+	isc_portset_addrange(v6portset, lo, hi);
+
+	result = dns_dispatchmgr_setavailports(dispatchmgr, v4portset,
+					       v6portset);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_portset_destroy(mctx, &v4portset);
+	isc_portset_destroy(mctx, &v6portset);
+}
+
+static void
+udppool_connected_cb(isc_result_t eresult, isc_region_t *region,
+		     void *cbarg) {
+	udppool_entry_t *entry = cbarg;
+	isc_sockaddr_t local;
+	in_port_t port;
+	isc_result_t result;
+
+	UNUSED(region);
+
+	assert_int_equal(eresult, ISC_R_SUCCESS);
+
+	result = dns_dispentry_getlocaladdress(entry->resp, &local);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	port = isc_sockaddr_getport(&local);
+	assert_in_range(port, entry->lo, entry->hi);
+
+	if (++udppool_connected < ARRAY_SIZE(udppool_entries)) {
+		return;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(udppool_entries); i++) {
+		dns_dispatch_done(&udppool_entries[i].resp);
+	}
+	dns_dispatch_detach(&dispatch);
+	dns_dispatchmgr_detach(&dispatchmgr);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+udppool_add(udppool_entry_t *entry, in_port_t lo, in_port_t hi) {
+	isc_result_t result;
+	uint16_t id;
+
+	*entry = (udppool_entry_t){ .lo = lo, .hi = hi };
+
+	result = dns_dispatch_add(dispatch, 0, T_CLIENT_CONNECT,
+				  &udp_server_addr, NULL, NULL,
+				  udppool_connected_cb, client_senddone,
+				  client_senddone, entry, &id, &entry->resp);
+	assert_int_equal(result, ISC_R_SUCCESS);
+}
+
+static void
+udppool_take(void *arg) {
+	in_port_t lo = isc_sockaddr_getport(&udp_server_addr) + 1;
+
+	UNUSED(arg);
+
+	/* The pooled sockets have been opened by now */
+	assert_int_equal(isc_nm_udpprebound(connect_nm, &udp_connect_addr),
+			 udppool_size);
+
+	udppool_add(&udppool_entries[0], lo, lo + 31);
+	assert_int_equal(isc_nm_udpprebound(connect_nm, &udp_connect_addr),
+			 udppool_size - 1);
+	dns_dispatch_connect(udppool_entries[0].resp);
+
+	/*
+	 * With the portset moved away from the pooled ports, the socket
+	 * taken from the pool is not used.
+	 */
+	udppool_setports(lo + 32, lo + 63);
+	udppool_add(&udppool_entries[1], lo + 32, lo + 63);
+	assert_int_equal(isc_nm_udpprebound(connect_nm, &udp_connect_addr),
+			 udppool_size - 2);
+	dns_dispatch_connect(udppool_entries[1].resp);
+}
+
+ISC_LOOP_TEST_IMPL(dispatch_udp_pool) {
+	in_port_t lo = isc_sockaddr_getport(&udp_server_addr) + 1;
+	dns_dispentry_t *resp = NULL;
+	isc_result_t result;
+	uint16_t id;
+
+	result = dns_dispatchmgr_create(mctx, connect_nm, &dispatchmgr);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	udppool_setports(lo, lo + 31);
+
+	result = dns_dispatch_createudp(dispatchmgr, &udp_connect_addr,
+					&dispatch);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* The first entry finds the pool empty and starts filling it */
+	assert_int_equal(isc_nm_udpprebound(connect_nm, &udp_connect_addr), 0);
+	result = dns_dispatch_add(dispatch, 0, T_CLIENT_CONNECT,
+				  &udp_server_addr, NULL, NULL, connected,
+				  client_senddone, client_senddone, NULL, &id,
+				  &resp);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_dispatch_done(&resp);
+
+	udppool_size = isc_nm_udpprebound(connect_nm, &udp_connect_addr);
+	assert_true(udppool_size > 2);
+
+	udppool_connected = 0;
+	isc_async_run(isc_loop_main(loopmgr), udppool_take, NULL);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(dispatch_timeout_udp_response, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dispatchset_create, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dispatchset_get, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dispatch_timeout_tcp_response, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dispatch_timeout_tcp_connect, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(dispatch_add_fixedid, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dispatch_tcp_response, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dispatch_tls_response, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dispatch_getnext, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(dispatch_udp_pool, setup_test, teardown_test)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
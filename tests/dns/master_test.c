@@ -518,6 +518,488 @@ ISC_RUN_TEST_IMPL(dumpraw) {
 	dns_db_detach(&db);
 }
 
+static void
+check_map_a(dns_db_t *db, dns_dbversion_t *version, const char *owner,
+	    isc_result_t expect) {
+	isc_result_t result;
+	dns_fixedname_t fixed, ffound;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_name_t *found = dns_fixedname_initname(&ffound);
+	dns_rdataset_t rdataset;
+
+	result = dns_name_fromstring(name, owner, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(db, name, version, dns_rdatatype_a, 0, 0, NULL,
+			     found, &rdataset, NULL);
+	assert_int_equal(result, expect);
+	if (dns_rdataset_isassociated(&rdataset)) {
+		assert_int_equal(dns_rdataset_count(&rdataset), 1);
+		dns_rdataset_disassociate(&rdataset);
+	}
+}
+
+/*
+ * Map dump test:
+ * a zone dumped in map format is loaded back by dns_db_load(), and the
+ * loaded zone can be updated
+ */
+ISC_RUN_TEST_IMPL(dumpmap) {
+	isc_result_t result;
+	dns_db_t *db = NULL, *mapdb = NULL, *movedb = NULL;
+	dns_dbversion_t *version = NULL;
+	dns_fixedname_t fixed, fowner;
+	dns_name_t *name = NULL, *owner = NULL;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_dbnode_t *node = NULL;
+	unsigned char addr[4] = { 10, 53, 0, 1 };
+
+	UNUSED(state);
+
+	name = dns_fixedname_initname(&fixed);
+	result = dns_name_fromstring(name, TEST_ORIGIN, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mctx, "rbt", name, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = isc_dir_chdir(SRCDIR);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_db_load(db, TESTS_DIR "/testdata/master/master1.data",
+			     dns_masterformat_text, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = isc_dir_chdir(BUILDDIR);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_db_currentversion(db, &version);
+	result = dns_master_dump(mctx, db, version, &dns_master_style_default,
+				 "test.map", dns_masterformat_map, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &version, false);
+
+	/* A map file can only be loaded into a database */
+	result = test_master(NULL, "test.map", dns_masterformat_map, nullmsg,
+			     nullmsg);
+	assert_int_equal(result, ISC_R_NOTIMPLEMENTED);
+
+	/* ...and is not a raw file */
+	result = test_master(NULL, "test.map", dns_masterformat_raw, nullmsg,
+			     nullmsg);
+	assert_int_not_equal(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mctx, "rbt", name, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &mapdb);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_db_load(mapdb, "test.map", dns_masterformat_map, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	assert_int_equal(dns_db_nodecount(mapdb, dns_dbtree_main),
+			 dns_db_nodecount(db, dns_dbtree_main));
+
+	dns_db_currentversion(mapdb, &version);
+	check_map_a(mapdb, version, "b.test", ISC_R_SUCCESS);
+	check_map_a(mapdb, version, "c.test", DNS_R_NXDOMAIN);
+	dns_db_closeversion(mapdb, &version, false);
+
+	/*
+	 * The preferred address is taken by the first mapping now, so this
+	 * one has to be relocated.
+	 */
+	result = dns_db_create(mctx, "rbt", name, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &movedb);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_db_load(movedb, "test.map", dns_masterformat_map, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_db_currentversion(movedb, &version);
+	check_map_a(movedb, version, "b.test", ISC_R_SUCCESS);
+	check_map_a(movedb, version, "c.test", DNS_R_NXDOMAIN);
+	dns_db_closeversion(movedb, &version, false);
+	dns_db_detach(&movedb);
+
+	/* Add a record to the mapped zone */
+	result = dns_db_newversion(mapdb, &version);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	owner = dns_fixedname_initname(&fowner);
+	result = dns_name_fromstring(owner, "c.test", 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_findnode(mapdb, owner, true, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdata_init(&rdata);
+	rdata.data = addr;
+	rdata.length = sizeof(addr);
+	rdata.rdclass = dns_rdataclass_in;
+	rdata.type = dns_rdatatype_a;
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.ttl = 300;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+	dns_rdataset_init(&rdataset);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+
+	result = dns_db_addrdataset(mapdb, node, version, 0, &rdataset, 0,
+				    NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_rdataset_disassociate(&rdataset);
+	dns_db_detachnode(mapdb, &node);
+	dns_db_closeversion(mapdb, &version, true);
+
+	dns_db_currentversion(mapdb, &version);
+	check_map_a(mapdb, version, "b.test", ISC_R_SUCCESS);
+	check_map_a(mapdb, version, "c.test", ISC_R_SUCCESS);
+	dns_db_closeversion(mapdb, &version, false);
+
+	/* The updated zone can be dumped and mapped again */
+	dns_db_currentversion(mapdb, &version);
+	result = dns_master_dump(mctx, mapdb, version,
+				 &dns_master_style_default, "test.dump",
+				 dns_masterformat_map, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_closeversion(mapdb, &version, false);
+	dns_db_detach(&mapdb);
+
+	result = dns_db_create(mctx, "rbt", name, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &mapdb);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_db_load(mapdb, "test.dump", dns_masterformat_map, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_db_currentversion(mapdb, &version);
+	check_map_a(mapdb, version, "b.test", ISC_R_SUCCESS);
+	check_map_a(mapdb, version, "c.test", ISC_R_SUCCESS);
+	dns_db_closeversion(mapdb, &version, false);
+
+	unlink("test.dump");
+	unlink("test.map");
+	dns_db_detach(&mapdb);
+	dns_db_detach(&db);
+}
+
+/*
+ * Write a zone that exercises the places a text master file can and cannot
+ * be split: $ORIGIN and $TTL changes, records without an owner, and
+ * parentheses, quotes and comments spanning or hiding line ends.  If 'bad'
+ * is not zero, record number 'bad' is broken; the line it is on is
+ * returned.
+ */
+static unsigned long
+write_parallel_zone(const char *filename, unsigned int bad) {
+	unsigned long line = 5, badline = 0;
+	FILE *f = fopen(filename, "w");
+
+	assert_non_null(f);
+	fprintf(f, "$TTL 300\n"
+		   "@ IN SOA ns hostmaster ( 1 ; serial\n"
+		   "\t3600 900 604800 300 )\n"
+		   "\tNS ns\n");
+	for (unsigned int i = 0; i < 4000; i++) {
+		if (i % 500 == 0) {
+			fprintf(f, "$ORIGIN sub%u.test.\n", i / 500);
+			line++;
+		}
+		if (i % 700 == 0) {
+			fprintf(f, "$TTL %u ; ttl (\n", 60 + i);
+			line++;
+		}
+		if (bad != 0 && i == bad) {
+			fprintf(f, "bad%u A 10.0.0\n", i);
+			badline = line++;
+		}
+		fprintf(f,
+			"a%u A 10.0.%u.%u\n"
+			"\tTXT \"semi;colon ( and \\\"quote\" ; comment (\n"
+			"b%u MX ( 10 ; preference )\n"
+			"\tmx%u )\n"
+			"\"c%u\" 3600 AAAA ::%x\n",
+			i, i / 256, i % 256, i, i, i, i);
+		line += 5;
+	}
+	fclose(f);
+
+	return (badline);
+}
+
+static char parallel_error[4096];
+
+static void
+parallel_error_callback(struct dns_rdatacallbacks *mycallbacks,
+			const char *fmt, ...) {
+	va_list ap;
+
+	UNUSED(mycallbacks);
+
+	if (parallel_error[0] == '\0') {
+		va_start(ap, fmt);
+		vsnprintf(parallel_error, sizeof(parallel_error), fmt, ap);
+		va_end(ap);
+	}
+}
+
+static isc_result_t
+collect_callback(void *arg, const dns_name_t *owner,
+		 dns_rdataset_t *dataset) {
+	char buf[BIGBUFLEN];
+	isc_buffer_t target;
+	isc_region_t r;
+	isc_result_t result;
+
+	isc_buffer_init(&target, buf, BIGBUFLEN);
+	result = dns_rdataset_totext(dataset, owner, false, false, &target);
+	if (result == ISC_R_SUCCESS) {
+		isc_buffer_usedregion(&target, &r);
+		isc_buffer_putmem(arg, r.base, r.length);
+	}
+	return (result);
+}
+
+static isc_result_t
+load_parallel(const char *filename, dns_masterformat_t format,
+	      unsigned int nthreads, isc_buffer_t **textp) {
+	isc_result_t result;
+
+	result = setup_master(nullmsg, parallel_error_callback);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	isc_buffer_allocate(mctx, textp, BIGBUFLEN);
+	callbacks.add = collect_callback;
+	callbacks.add_private = *textp;
+	parallel_error[0] = '\0';
+
+	dns_master_setparallel(nthreads, 1024);
+	result = dns_master_loadfile(filename, &dns_origin, &dns_origin,
+				     dns_rdataclass_in, 0, 0, &callbacks, NULL,
+				     NULL, mctx, format, 0);
+	dns_master_setparallel(0, 0);
+
+	return (result);
+}
+
+/*
+ * Parallel load test:
+ * a text master file loaded in chunks by several threads yields the same
+ * RRsets in the same order as when it is loaded by one, and errors are
+ * reported at the same line
+ */
+ISC_RUN_TEST_IMPL(parallel) {
+	isc_result_t result;
+	isc_buffer_t *serial = NULL, *parallel = NULL;
+	char expect[4096], where[100];
+	unsigned long line;
+
+	UNUSED(state);
+
+	result = isc_dir_chdir(SRCDIR);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	write_parallel_zone("parallel.data", 0);
+
+	result = load_parallel("parallel.data", dns_masterformat_text, 1, &serial);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = load_parallel("parallel.data", dns_masterformat_text, 4, &parallel);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	assert_true(isc_buffer_usedlength(serial) > 4000 * 4 * 20);
+	assert_int_equal(isc_buffer_usedlength(serial),
+			 isc_buffer_usedlength(parallel));
+	assert_memory_equal(isc_buffer_base(serial), isc_buffer_base(parallel),
+			    isc_buffer_usedlength(serial));
+	isc_buffer_free(&serial);
+	isc_buffer_free(&parallel);
+
+	line = write_parallel_zone("parallel.data", 3333);
+
+	result = load_parallel("parallel.data", dns_masterformat_text, 1, &serial);
+	assert_int_not_equal(result, ISC_R_SUCCESS);
+	strlcpy(expect, parallel_error, sizeof(expect));
+	snprintf(where, sizeof(where), "parallel.data:%lu:", line);
+	assert_non_null(strstr(expect, where));
+
+	assert_int_equal(load_parallel("parallel.data", dns_masterformat_text, 4, &parallel), result);
+	assert_string_equal(parallel_error, expect);
+
+	/* Some of what came before the error has been added, in order */
+	assert_true(isc_buffer_usedlength(parallel) > 0);
+	assert_true(isc_buffer_usedlength(parallel) <=
+		    isc_buffer_usedlength(serial));
+	assert_memory_equal(isc_buffer_base(serial), isc_buffer_base(parallel),
+			    isc_buffer_usedlength(parallel));
+
+	isc_buffer_free(&serial);
+	isc_buffer_free(&parallel);
+	unlink("parallel.data");
+}
+
+/*
+ * Break the class of RRset number 'n' of a raw file.
+ */
+static void
+break_raw_rrset(const char *filename, unsigned int n) {
+	unsigned char buf[4];
+	long pos = 6 * sizeof(uint32_t);
+	FILE *f = fopen(filename, "r+b");
+
+	assert_non_null(f);
+	for (unsigned int i = 0; i < n; i++) {
+		assert_int_equal(fseek(f, pos, SEEK_SET), 0);
+		assert_int_equal(fread(buf, 1, 4, f), 4);
+		pos += (buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3];
+	}
+	assert_int_equal(fseek(f, pos + 4, SEEK_SET), 0);
+	assert_int_equal(fwrite("\xff\xff", 1, 2, f), 2);
+	fclose(f);
+}
+
+/*
+ * Parallel raw load test:
+ * a raw master file loaded in chunks by several threads yields the same
+ * RRsets in the same order as when it is loaded by one, and fails the same
+ * way when it is malformed
+ */
+ISC_RUN_TEST_IMPL(parallelraw) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *version = NULL;
+	isc_buffer_t *serial = NULL, *parallel = NULL;
+	char expect[4096];
+
+	UNUSED(state);
+
+	result = isc_dir_chdir(SRCDIR);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	write_parallel_zone("parallel.data", 0);
+	result = dns_test_loaddb(&db, dns_dbtype_zone, TEST_ORIGIN,
+				 "parallel.data");
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_currentversion(db, &version);
+	result = dns_master_dump(mctx, db, version, &dns_master_style_default,
+				 "parallel.raw", dns_masterformat_raw, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &version, false);
+	dns_db_detach(&db);
+
+	result = load_parallel("parallel.raw", dns_masterformat_raw, 1,
+			       &serial);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = load_parallel("parallel.raw", dns_masterformat_raw, 4,
+			       &parallel);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	assert_true(isc_buffer_usedlength(serial) > 4000 * 4 * 20);
+	assert_int_equal(isc_buffer_usedlength(serial),
+			 isc_buffer_usedlength(parallel));
+	assert_memory_equal(isc_buffer_base(serial), isc_buffer_base(parallel),
+			    isc_buffer_usedlength(serial));
+	isc_buffer_free(&serial);
+	isc_buffer_free(&parallel);
+
+	break_raw_rrset("parallel.raw", 9000);
+
+	result = load_parallel("parallel.raw", dns_masterformat_raw, 1,
+			       &serial);
+	assert_int_equal(result, DNS_R_BADCLASS);
+	strlcpy(expect, parallel_error, sizeof(expect));
+
+	assert_int_equal(load_parallel("parallel.raw", dns_masterformat_raw, 4,
+				       &parallel),
+			 result);
+	assert_string_equal(parallel_error, expect);
+
+	/* Some of what came before the error has been added, in order */
+	assert_true(isc_buffer_usedlength(parallel) > 0);
+	assert_true(isc_buffer_usedlength(parallel) <=
+		    isc_buffer_usedlength(serial));
+	assert_memory_equal(isc_buffer_base(serial), isc_buffer_base(parallel),
+			    isc_buffer_usedlength(parallel));
+
+	isc_buffer_free(&serial);
+	isc_buffer_free(&parallel);
+	unlink("parallel.raw");
+	unlink("parallel.data");
+}
+
+/*
+ * Dump 'db' to 'filename' with 'nthreads' threads, and load the file
+ * again, collecting its RRsets in '*textp'.
+ */
+static void
+dump_parallel(dns_db_t *db, const char *filename, dns_masterformat_t format,
+	      unsigned int nthreads, isc_buffer_t **textp) {
+	isc_result_t result;
+
+	dns_master_setdumpparallel(nthreads, 64);
+	result = dns_master_dump(mctx, db, NULL, &dns_master_style_default,
+				 filename, format, NULL);
+	dns_master_setdumpparallel(0, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = load_parallel(filename, format, 1, textp);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	unlink(filename);
+}
+
+/*
+ * Parallel dump test:
+ * a database dumped in parts by several threads loads the same RRsets in
+ * the same order as when it is dumped by one, in both text and raw format
+ */
+ISC_RUN_TEST_IMPL(dumpparallel) {
+	static const dns_masterformat_t formats[] = { dns_masterformat_text,
+						      dns_masterformat_raw };
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	isc_buffer_t *serial = NULL, *parallel = NULL;
+	FILE *f = NULL;
+
+	UNUSED(state);
+
+	result = isc_dir_chdir(SRCDIR);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* Some NSEC3 records, which are kept in a tree of their own */
+	write_parallel_zone("parallel.data", 0);
+	f = fopen("parallel.data", "a");
+	assert_non_null(f);
+	fprintf(f, "$ORIGIN test.\n");
+	for (unsigned int i = 0; i < 200; i++) {
+		fprintf(f, "%032x NSEC3 1 0 0 - %032x A\n", i, i + 1);
+	}
+	fclose(f);
+
+	result = dns_test_loaddb(&db, dns_dbtype_zone, TEST_ORIGIN,
+				 "parallel.data");
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(dns_db_nodecount(db, dns_dbtree_nsec3), 201);
+
+	for (size_t i = 0; i < ARRAY_SIZE(formats); i++) {
+		dump_parallel(db, "parallel.dump", formats[i], 1, &serial);
+		dump_parallel(db, "parallel.dump", formats[i], 4, &parallel);
+
+		assert_true(isc_buffer_usedlength(serial) > 4000 * 4 * 20);
+		assert_int_equal(isc_buffer_usedlength(serial),
+				 isc_buffer_usedlength(parallel));
+		assert_memory_equal(isc_buffer_base(serial),
+				    isc_buffer_base(parallel),
+				    isc_buffer_usedlength(serial));
+		isc_buffer_free(&serial);
+		isc_buffer_free(&parallel);
+	}
+
+	dns_db_detach(&db);
+	unlink("parallel.data");
+}
+
 static const char *warn_expect_value;
 static bool warn_expect_result;
 
@@ -572,6 +1054,10 @@ ISC_TEST_ENTRY(leadingzero)
 ISC_TEST_ENTRY(totext)
 ISC_TEST_ENTRY(loadraw)
 ISC_TEST_ENTRY(dumpraw)
+ISC_TEST_ENTRY(dumpmap)
+ISC_TEST_ENTRY(parallel)
+ISC_TEST_ENTRY(parallelraw)
+ISC_TEST_ENTRY(dumpparallel)
 ISC_TEST_ENTRY(toobig)
 ISC_TEST_ENTRY(maxrdata)
 ISC_TEST_ENTRY(neworigin)
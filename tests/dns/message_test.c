@@ -0,0 +1,433 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/buffer.h>
+#include <isc/mem.h>
+#include <isc/util.h>
+
+#include <dns/masterdump.h>
+#include <dns/message.h>
+
+#include <tests/dns.h>
+
+/* www.example/IN/A, RD */
+static const unsigned char query[] = {
+	0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x03, 'w',	'w',  'w',  0x07, 'e',	'x',  'a',
+	'm',  'p',  'l',  'e',	0x00, 0x00, 0x01, 0x00, 0x01,
+};
+
+/*
+ * The same query with an EDNS padding option that makes it larger than
+ * the storage the message keeps for the cloned requests.
+ */
+#define PADDING 1400
+
+static unsigned char *
+bigquery(size_t *lenp) {
+	static const unsigned char opt[] = {
+		0x00,			/* root */
+		0x00, 0x29,		/* OPT */
+		0x10, 0x00,		/* 4096 */
+		0x00, 0x00, 0x00, 0x00, /* TTL */
+		(PADDING + 4) >> 8,	/* RDLEN */
+		(PADDING + 4) & 0xff,
+		0x00, 0x0c,		/* PADDING */
+		PADDING >> 8,
+		PADDING & 0xff,
+	};
+	size_t len = sizeof(query) + sizeof(opt) + PADDING;
+	unsigned char *wire = isc_mem_get(mctx, len);
+
+	memmove(wire, query, sizeof(query));
+	wire[11] = 1; /* ARCOUNT */
+	memmove(wire + sizeof(query), opt, sizeof(opt));
+	memset(wire + sizeof(query) + sizeof(opt), 0, PADDING);
+
+	*lenp = len;
+	return (wire);
+}
+
+static isc_result_t
+parsewire(dns_message_t *msg, unsigned char *wire, size_t len,
+	  unsigned int options) {
+	isc_buffer_t source;
+
+	isc_buffer_init(&source, wire, len);
+	isc_buffer_add(&source, len);
+
+	return (dns_message_parse(msg, &source, options));
+}
+
+/*
+ * The raw request is saved as it was received, and copied into storage
+ * owned by the message only when it has to outlive the receive buffer.
+ */
+ISC_RUN_TEST_IMPL(clonebuffer) {
+	dns_message_t *msg = NULL;
+	unsigned char wire[sizeof(query)];
+	isc_result_t result;
+
+	memmove(wire, query, sizeof(query));
+
+	dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &msg);
+
+	result = parsewire(msg, wire, sizeof(wire), 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_equal(msg->saved.base, wire);
+
+	dns_message_clonebuffer(msg);
+	assert_ptr_not_equal(msg->saved.base, wire);
+	assert_int_equal(msg->saved.length, sizeof(query));
+	assert_true(msg->clone_saved);
+	assert_false(msg->free_saved);
+
+	/* the copy doesn't depend on the receive buffer anymore */
+	memset(wire, 0, sizeof(wire));
+	assert_memory_equal(msg->saved.base, query, sizeof(query));
+
+	/* cloning twice is a no-op */
+	dns_message_clonebuffer(msg);
+	assert_memory_equal(msg->saved.base, query, sizeof(query));
+
+	dns_message_detach(&msg);
+}
+
+/*
+ * The storage is kept across dns_message_reset(), so a message that is
+ * reused for every request doesn't allocate memory to clone them.
+ */
+ISC_RUN_TEST_IMPL(clonebuffer_reuse) {
+	dns_message_t *msg = NULL;
+	unsigned char wire[sizeof(query)];
+	unsigned char *clone = NULL;
+	size_t inuse;
+	isc_result_t result;
+
+	dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &msg);
+
+	memmove(wire, query, sizeof(query));
+	result = parsewire(msg, wire, sizeof(wire), 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_message_clonebuffer(msg);
+	clone = msg->saved.base;
+
+	for (size_t i = 0; i < 10; i++) {
+		dns_message_reset(msg, DNS_MESSAGE_INTENTPARSE);
+		inuse = isc_mem_inuse(mctx);
+
+		memmove(wire, query, sizeof(query));
+		wire[0] = (unsigned char)i;
+		result = parsewire(msg, wire, sizeof(wire), 0);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		dns_message_clonebuffer(msg);
+
+		assert_ptr_equal(msg->saved.base, clone);
+		assert_int_equal(msg->saved.base[0], i);
+		assert_int_equal(isc_mem_inuse(mctx), inuse);
+	}
+
+	/* DNS_MESSAGEPARSE_CLONEBUFFER uses the same storage */
+	dns_message_reset(msg, DNS_MESSAGE_INTENTPARSE);
+	result = parsewire(msg, wire, sizeof(wire),
+			   DNS_MESSAGEPARSE_CLONEBUFFER);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_equal(msg->saved.base, clone);
+	assert_true(msg->clone_saved);
+
+	dns_message_detach(&msg);
+}
+
+/*
+ * dns_message_reply() turns the saved request into the query the
+ * response is rendered for; the clone goes along with it.
+ */
+ISC_RUN_TEST_IMPL(clonebuffer_reply) {
+	dns_message_t *msg = NULL;
+	unsigned char wire[sizeof(query)];
+	unsigned char *clone = NULL;
+	isc_result_t result;
+
+	memmove(wire, query, sizeof(query));
+
+	dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &msg);
+
+	result = parsewire(msg, wire, sizeof(wire), 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_message_clonebuffer(msg);
+	clone = msg->saved.base;
+
+	result = dns_message_reply(msg, true);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_null(msg->saved.base);
+	assert_ptr_equal(msg->query.base, clone);
+	assert_true(msg->clone_query);
+	assert_false(msg->free_query);
+
+	/* the query is already a copy */
+	dns_message_clonebuffer(msg);
+	assert_ptr_equal(msg->query.base, clone);
+
+	dns_message_detach(&msg);
+}
+
+/*
+ * A request larger than the storage is copied into its own allocation,
+ * which is freed with the message.
+ */
+ISC_RUN_TEST_IMPL(clonebuffer_large) {
+	dns_message_t *msg = NULL;
+	unsigned char *wire = NULL;
+	size_t len;
+	isc_result_t result;
+
+	wire = bigquery(&len);
+
+	dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &msg);
+
+	result = parsewire(msg, wire, len, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_message_clonebuffer(msg);
+	assert_ptr_not_equal(msg->saved.base, wire);
+	assert_int_equal(msg->saved.length, len);
+	assert_false(msg->clone_saved);
+	assert_true(msg->free_saved);
+	assert_memory_equal(msg->saved.base, wire, len);
+
+	isc_mem_put(mctx, wire, len);
+	dns_message_detach(&msg);
+}
+
+/*
+ * Queries for www.example/IN/A carrying extra records, to compare lazy
+ * and eager parsing.  RR() is a record owned by the question name.
+ */
+#define QUERY(an, ns, ar)                                                    \
+	0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, an, 0x00, ns, 0x00, ar,    \
+		0x03, 'w', 'w', 'w', 0x07, 'e', 'x', 'a', 'm', 'p', 'l', 'e', \
+		0x00, 0x00, 0x01, 0x00, 0x01
+#define RR(type, class, rdlen) \
+	0xc0, 0x0c, 0x00, type, 0x00, class, 0x00, 0x00, 0x0e, 0x10, 0x00, rdlen
+#define OPT 0x00, 0x00, 0x29, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+
+static const unsigned char q_answer[] = {
+	QUERY(1, 0, 1),
+	RR(1, 1, 4), 10, 0, 0, 1,
+	OPT,
+};
+static const unsigned char q_sections[] = {
+	QUERY(2, 1, 3),
+	RR(1, 1, 4), 10, 0, 0, 1,
+	RR(1, 1, 4), 10, 0, 0, 2,
+	RR(2, 1, 2), 0xc0, 0x0c,
+	RR(16, 1, 4), 3, 'f', 'o', 'o',
+	RR(1, 1, 4), 10, 0, 0, 3,
+	OPT,
+};
+static const unsigned char q_class[] = {
+	QUERY(1, 0, 0),
+	RR(1, 4, 4), 10, 0, 0, 1,
+};
+static const unsigned char q_rdata[] = {
+	QUERY(0, 1, 1),
+	RR(1, 1, 3), 10, 0, 0,
+	OPT,
+};
+static const unsigned char q_pointer[] = {
+	QUERY(1, 0, 0),
+	0xc0, 0xff, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x00, 0x04,
+	10, 0, 0, 1,
+};
+static const unsigned char q_singleton[] = {
+	QUERY(2, 0, 0),
+	RR(5, 1, 2), 0xc0, 0x0c,
+	RR(5, 1, 1), 0x00,
+};
+static const unsigned char q_singleton_ok[] = {
+	QUERY(2, 0, 0),
+	RR(5, 1, 1), 0x00,
+	RR(5, 1, 1), 0x00,
+};
+static const unsigned char q_questiononly[] = {
+	QUERY(0, 0, 1),
+	RR(252, 1, 0),
+};
+static const unsigned char q_truncated[] = {
+	QUERY(1, 0, 0),
+	RR(1, 1, 8), 10, 0, 0, 1,
+};
+static const unsigned char q_afteropt[] = {
+	QUERY(0, 0, 2),
+	OPT,
+	RR(1, 1, 4), 10, 0, 0, 1,
+};
+static const unsigned char q_optanswer[] = {
+	QUERY(1, 0, 0),
+	OPT,
+};
+
+static void
+sectionstotext(dns_message_t *msg, isc_buffer_t *target) {
+	for (dns_section_t section = DNS_SECTION_ANSWER;
+	     section < DNS_SECTION_MAX; section++)
+	{
+		isc_result_t result = dns_message_sectiontotext(
+			msg, section, &dns_master_style_debug, 0, target);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+}
+
+/*
+ * Parse 'wire' eagerly and lazily with 'options', check that both give
+ * 'expect' and, if the message was parsed, the same records; check
+ * whether the lazy parse deferred the records.
+ */
+static void
+parse_lazy_eager(const char *desc, const unsigned char *wire, size_t len,
+		 unsigned int options, isc_result_t expect, bool deferred) {
+	dns_message_t *eager = NULL, *lazy = NULL;
+	unsigned char ebuf[sizeof(q_sections)], lbuf[sizeof(q_sections)];
+	char etext[4096], ltext[4096];
+	isc_buffer_t etarget, ltarget;
+	isc_result_t result;
+
+	INSIST(len <= sizeof(ebuf));
+	memmove(ebuf, wire, len);
+	memmove(lbuf, wire, len);
+
+	dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &eager);
+	dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &lazy);
+
+	result = parsewire(eager, ebuf, len, options);
+	if (result != expect) {
+		fail_msg("# %s: eager parse returned %s, expected %s", desc,
+			 isc_result_totext(result), isc_result_totext(expect));
+	}
+	assert_false(eager->deferred);
+
+	result = parsewire(lazy, lbuf, len, options | DNS_MESSAGEPARSE_LAZY);
+	if (result != expect) {
+		fail_msg("# %s: lazy parse returned %s, expected %s", desc,
+			 isc_result_totext(result), isc_result_totext(expect));
+	}
+	if (lazy->deferred != deferred) {
+		fail_msg("# %s: records %sdeferred", desc,
+			 deferred ? "not " : "");
+	}
+
+	if (result == ISC_R_SUCCESS || result == DNS_R_RECOVERABLE) {
+		assert_int_equal(eager->opt != NULL, lazy->opt != NULL);
+
+		isc_buffer_init(&etarget, etext, sizeof(etext));
+		isc_buffer_init(&ltarget, ltext, sizeof(ltext));
+		sectionstotext(eager, &etarget);
+		sectionstotext(lazy, &ltarget);
+		assert_false(lazy->deferred);
+		if (isc_buffer_usedlength(&etarget) !=
+			    isc_buffer_usedlength(&ltarget) ||
+		    memcmp(etext, ltext, isc_buffer_usedlength(&etarget)) != 0)
+		{
+			fail_msg("# %s: lazy and eager parse differ", desc);
+		}
+	}
+
+	dns_message_detach(&eager);
+	dns_message_detach(&lazy);
+}
+
+/*
+ * A lazy parse returns the same result as an eager one and, once the
+ * sections are accessed, the same records; malformed records are
+ * reported by dns_message_parse() in both cases.
+ */
+ISC_RUN_TEST_IMPL(parse_lazy) {
+	const struct {
+		const char *desc;
+		const unsigned char *wire;
+		size_t len;
+		isc_result_t result;
+		bool deferred;
+	} tests[] = {
+#define TEST(wire, result, deferred) \
+	{ #wire, wire, sizeof(wire), result, deferred }
+		TEST(query, ISC_R_SUCCESS, false),
+		TEST(q_answer, ISC_R_SUCCESS, true),
+		TEST(q_sections, ISC_R_SUCCESS, true),
+		TEST(q_class, DNS_R_FORMERR, false),
+		TEST(q_rdata, ISC_R_UNEXPECTEDEND, false),
+		TEST(q_pointer, DNS_R_BADPOINTER, false),
+		TEST(q_singleton, DNS_R_FORMERR, false),
+		TEST(q_singleton_ok, ISC_R_SUCCESS, false),
+		TEST(q_questiononly, DNS_R_FORMERR, false),
+		TEST(q_truncated, ISC_R_UNEXPECTEDEND, false),
+		TEST(q_afteropt, ISC_R_SUCCESS, false),
+		TEST(q_optanswer, DNS_R_FORMERR, false),
+#undef TEST
+	};
+
+	for (size_t i = 0; i < ARRAY_SIZE(tests); i++) {
+		parse_lazy_eager(tests[i].desc, tests[i].wire, tests[i].len, 0,
+				 tests[i].result, tests[i].deferred);
+	}
+}
+
+/*
+ * With DNS_MESSAGEPARSE_BESTEFFORT, records that would have caused
+ * FORMERR make both parses return DNS_R_RECOVERABLE.
+ */
+ISC_RUN_TEST_IMPL(parse_lazy_besteffort) {
+	const struct {
+		const char *desc;
+		const unsigned char *wire;
+		size_t len;
+		isc_result_t result;
+	} tests[] = {
+#define TEST(wire, result) { #wire, wire, sizeof(wire), result }
+		TEST(q_answer, ISC_R_SUCCESS),
+		TEST(q_class, DNS_R_RECOVERABLE),
+		TEST(q_singleton, DNS_R_RECOVERABLE),
+		TEST(q_questiononly, DNS_R_RECOVERABLE),
+		TEST(q_optanswer, DNS_R_RECOVERABLE),
+#undef TEST
+	};
+
+	for (size_t i = 0; i < ARRAY_SIZE(tests); i++) {
+		parse_lazy_eager(tests[i].desc, tests[i].wire, tests[i].len,
+				 DNS_MESSAGEPARSE_BESTEFFORT, tests[i].result,
+				 tests[i].result == ISC_R_SUCCESS);
+	}
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(clonebuffer)
+ISC_TEST_ENTRY(clonebuffer_reuse)
+ISC_TEST_ENTRY(clonebuffer_reply)
+ISC_TEST_ENTRY(clonebuffer_large)
+ISC_TEST_ENTRY(parse_lazy)
+ISC_TEST_ENTRY(parse_lazy_besteffort)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
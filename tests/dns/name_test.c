@@ -825,6 +825,45 @@ ISC_RUN_TEST_IMPL(getlabelsequence) {
 	}
 }
 
+/* dns_name_fromwire() with DNS_NAME_DOWNCASE */
+ISC_RUN_TEST_IMPL(fromwire_downcase) {
+	/* "WwW.ExAmPlE." followed by "MaIl" and a pointer to "ExAmPlE." */
+	uint8_t data[] = { 3,	'W', 'w', 'W', 7,   'E', 'x', 'A', 'm',
+			   'P', 'l', 'E', 0,   4,	'M', 'a', 'I', 'l',
+			   0xC0, 4 };
+	const uint8_t first[] = "\003www\007example";
+	const uint8_t second[] = "\004mail\007example";
+	unsigned char output[DNS_NAME_MAXWIRE];
+	isc_buffer_t source, target;
+	dns_name_t name;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	isc_buffer_init(&source, data, sizeof(data));
+	isc_buffer_add(&source, sizeof(data));
+	isc_buffer_setactive(&source, sizeof(data));
+	isc_buffer_init(&target, output, sizeof(output));
+
+	dns_name_init(&name, NULL);
+	result = dns_name_fromwire(&name, &source, DNS_DECOMPRESS_ALWAYS,
+				   DNS_NAME_DOWNCASE, &target);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(name.length, sizeof(first));
+	assert_memory_equal(name.ndata, first, sizeof(first));
+
+	dns_name_init(&name, NULL);
+	result = dns_name_fromwire(&name, &source, DNS_DECOMPRESS_ALWAYS,
+				   DNS_NAME_DOWNCASE, &target);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(name.length, sizeof(second));
+	assert_memory_equal(name.ndata, second, sizeof(second));
+	assert_int_equal(isc_buffer_remaininglength(&source), 0);
+
+	/* the source is left untouched */
+	assert_int_equal(data[1], 'W');
+}
+
 #ifdef DNS_BENCHMARK_TESTS
 
 /*
@@ -920,6 +959,7 @@ ISC_TEST_ENTRY(issubdomain)
 ISC_TEST_ENTRY(countlabels)
 ISC_TEST_ENTRY(getlabel)
 ISC_TEST_ENTRY(getlabelsequence)
+ISC_TEST_ENTRY(fromwire_downcase)
 #ifdef DNS_BENCHMARK_TESTS
 ISC_TEST_ENTRY(benchmark)
 #endif /* DNS_BENCHMARK_TESTS */
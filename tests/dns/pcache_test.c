@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/buffer.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/pcache.h>
+
+#include <tests/dns.h>
+
+/* Generations of two distinct databases */
+#define DB1 1
+#define DB2 2
+
+static unsigned char wire[] = { 0x12, 0x34, 0x84, 0x00, 0x00, 0x01,
+				0x00, 0x01, 0x00, 0x00, 0x00, 0x00 };
+
+static void
+setkey(dns_pcachekey_t *key, dns_fixedname_t *fname, const char *name) {
+	dns_test_namefromstring(name, fname);
+
+	*key = (dns_pcachekey_t){
+		.qname = dns_fixedname_name(fname),
+		.qtype = dns_rdatatype_a,
+		.qclass = dns_rdataclass_in,
+		.udpsize = 1232,
+	};
+}
+
+/* add a response and find it again */
+ISC_RUN_TEST_IMPL(pcache_find) {
+	dns_pcache_t *pcache = NULL;
+	dns_fixedname_t fname;
+	dns_pcachekey_t key;
+	isc_region_t r = { .base = wire, .length = sizeof(wire) };
+	unsigned char data[512];
+	isc_buffer_t buffer;
+	isc_result_t result;
+	uint32_t aux = 0;
+
+	dns_pcache_create(mctx, 100, &pcache);
+	setkey(&key, &fname, "www.example.");
+
+	isc_buffer_init(&buffer, data, sizeof(data));
+	result = dns_pcache_find(pcache, &key, DB1, 1, 0, &buffer, &aux);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	dns_pcache_add(pcache, &key, DB1, 1, 42, &r, 0);
+
+	result = dns_pcache_find(pcache, &key, DB1, 1, 0, &buffer, &aux);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(aux, 42);
+	assert_int_equal(isc_buffer_usedlength(&buffer), sizeof(wire));
+	assert_memory_equal(data, wire, sizeof(wire));
+
+	/* The entry stays in the cache */
+	isc_buffer_clear(&buffer);
+	result = dns_pcache_find(pcache, &key, DB1, 1, 0, &buffer, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* ... until it is flushed */
+	dns_pcache_flush(pcache);
+	isc_buffer_clear(&buffer);
+	result = dns_pcache_find(pcache, &key, DB1, 1, 0, &buffer, NULL);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	dns_pcache_destroy(&pcache);
+	assert_null(pcache);
+}
+
+/* keys must match exactly */
+ISC_RUN_TEST_IMPL(pcache_key) {
+	dns_pcache_t *pcache = NULL;
+	dns_fixedname_t fname1, fname2;
+	dns_pcachekey_t key1, key2;
+	isc_region_t r = { .base = wire, .length = sizeof(wire) };
+	unsigned char data[512];
+	isc_buffer_t buffer;
+	isc_result_t result;
+
+	dns_pcache_create(mctx, 100, &pcache);
+	setkey(&key1, &fname1, "www.example.");
+	dns_pcache_add(pcache, &key1, DB1, 1, 0, &r, 0);
+
+	isc_buffer_init(&buffer, data, sizeof(data));
+
+	/* Names are compared case-sensitively */
+	setkey(&key2, &fname2, "WWW.example.");
+	result = dns_pcache_find(pcache, &key2, DB1, 1, 0, &buffer, NULL);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	setkey(&key2, &fname2, "www.example.");
+	key2.qtype = dns_rdatatype_aaaa;
+	result = dns_pcache_find(pcache, &key2, DB1, 1, 0, &buffer, NULL);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	key2 = key1;
+	key2.udpsize = 4096;
+	result = dns_pcache_find(pcache, &key2, DB1, 1, 0, &buffer, NULL);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	key2 = key1;
+	key2.attributes = 1;
+	result = dns_pcache_find(pcache, &key2, DB1, 1, 0, &buffer, NULL);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	result = dns_pcache_find(pcache, &key1, DB1, 1, 0, &buffer, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_pcache_destroy(&pcache);
+}
+
+/* entries from another database version, or too old, are discarded */
+ISC_RUN_TEST_IMPL(pcache_stale) {
+	dns_pcache_t *pcache = NULL;
+	dns_fixedname_t fname;
+	dns_pcachekey_t key;
+	isc_region_t r = { .base = wire, .length = sizeof(wire) };
+	unsigned char data[512];
+	isc_buffer_t buffer;
+	isc_result_t result;
+
+	dns_pcache_create(mctx, 100, &pcache);
+	setkey(&key, &fname, "www.example.");
+	isc_buffer_init(&buffer, data, sizeof(data));
+
+	dns_pcache_add(pcache, &key, DB1, 1, 0, &r, 1000);
+	result = dns_pcache_find(pcache, &key, DB1, 2, 1000, &buffer, NULL);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	/* The mismatching entry has been removed */
+	result = dns_pcache_find(pcache, &key, DB1, 1, 1000, &buffer, NULL);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	dns_pcache_add(pcache, &key, DB1, 1, 0, &r, 1000);
+	result = dns_pcache_find(pcache, &key, DB2, 1, 1000, &buffer, NULL);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	dns_pcache_add(pcache, &key, DB1, 1, 0, &r, 1000);
+	result = dns_pcache_find(pcache, &key, DB1, 1,
+				 1000 + DNS_PCACHE_LIFETIME, &buffer, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	isc_buffer_clear(&buffer);
+	result = dns_pcache_find(pcache, &key, DB1, 1,
+				 1000 + DNS_PCACHE_LIFETIME + 1, &buffer,
+				 NULL);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	dns_pcache_destroy(&pcache);
+}
+
+/* a response that doesn't fit in the target buffer is not copied */
+ISC_RUN_TEST_IMPL(pcache_nospace) {
+	dns_pcache_t *pcache = NULL;
+	dns_fixedname_t fname;
+	dns_pcachekey_t key;
+	isc_region_t r = { .base = wire, .length = sizeof(wire) };
+	unsigned char data[sizeof(wire) - 1];
+	isc_buffer_t buffer;
+	isc_result_t result;
+
+	dns_pcache_create(mctx, 1, &pcache);
+	setkey(&key, &fname, "www.example.");
+	isc_buffer_init(&buffer, data, sizeof(data));
+
+	dns_pcache_add(pcache, &key, DB1, 1, 0, &r, 0);
+	result = dns_pcache_find(pcache, &key, DB1, 1, 0, &buffer, NULL);
+	assert_int_equal(result, ISC_R_NOSPACE);
+	assert_int_equal(isc_buffer_usedlength(&buffer), 0);
+
+	dns_pcache_destroy(&pcache);
+}
+
+ISC_TEST_LIST_START
+
+ISC_TEST_ENTRY(pcache_find)
+ISC_TEST_ENTRY(pcache_key)
+ISC_TEST_ENTRY(pcache_stale)
+ISC_TEST_ENTRY(pcache_nospace)
+
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
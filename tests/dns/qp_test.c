@@ -0,0 +1,458 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/random.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/qp.h>
+
+#include <tests/dns.h>
+
+typedef struct item {
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	int refs;
+} item_t;
+
+static void
+item_attach(void *uctx, void *pval, uint32_t ival) {
+	item_t *item = pval;
+
+	UNUSED(uctx);
+	UNUSED(ival);
+
+	item->refs++;
+}
+
+static void
+item_detach(void *uctx, void *pval, uint32_t ival) {
+	item_t *item = pval;
+
+	UNUSED(uctx);
+	UNUSED(ival);
+
+	assert_true(item->refs > 0);
+	item->refs--;
+}
+
+static size_t
+item_makekey(dns_qpkey_t key, void *uctx, void *pval, uint32_t ival) {
+	item_t *item = pval;
+
+	UNUSED(uctx);
+	UNUSED(ival);
+
+	return (dns_qpkey_fromname(key, item->name));
+}
+
+static const dns_qpmethods_t methods = {
+	item_attach,
+	item_detach,
+	item_makekey,
+};
+
+static void
+item_init(item_t *item, const char *namestr) {
+	item->name = dns_fixedname_initname(&item->fixed);
+	dns_test_namefromstring(namestr, &item->fixed);
+	item->refs = 0;
+}
+
+/* compare two keys, treating the positions past the end as SHIFT_NOBYTE */
+static int
+qpkey_compare(const dns_qpkey_t key1, size_t len1, const dns_qpkey_t key2,
+	      size_t len2) {
+	for (size_t i = 0; i < ISC_MAX(len1, len2); i++) {
+		uint8_t s1 = i < len1 ? key1[i] : 0;
+		uint8_t s2 = i < len2 ? key2[i] : 0;
+		if (s1 != s2) {
+			return (s1 < s2 ? -1 : 1);
+		}
+	}
+	return (0);
+}
+
+static int
+sign(int n) {
+	return (n < 0 ? -1 : n > 0 ? 1 : 0);
+}
+
+static const char *testnames[] = {
+	".",
+	"com.",
+	"\\000.com.",
+	"\\001.com.",
+	"-.com.",
+	"0.com.",
+	"9.com.",
+	"\\@.com.",
+	"\\091.com.",
+	"_.com.",
+	"`.com.",
+	"a.com.",
+	"A\\000.com.",
+	"a-.com.",
+	"a0.com.",
+	"aa.com.",
+	"z.com.",
+	"{.com.",
+	"\\200.com.",
+	"\\255.com.",
+	"example.com.",
+	"*.example.com.",
+	"www.example.com.",
+	"z.www.example.com.",
+	"example0.com.",
+	"exampleA.com.",
+	"examples.com.",
+	"net.",
+};
+
+/* keys sort in the same order as the names they were made from */
+ISC_RUN_TEST_IMPL(qpkey_order) {
+	for (size_t i = 0; i < ARRAY_SIZE(testnames); i++) {
+		dns_fixedname_t f1;
+		dns_qpkey_t key1;
+		size_t len1;
+
+		dns_test_namefromstring(testnames[i], &f1);
+		len1 = dns_qpkey_fromname(key1, dns_fixedname_name(&f1));
+
+		for (size_t j = 0; j < ARRAY_SIZE(testnames); j++) {
+			dns_fixedname_t f2;
+			dns_qpkey_t key2;
+			size_t len2;
+			int order;
+
+			dns_test_namefromstring(testnames[j], &f2);
+			len2 = dns_qpkey_fromname(key2,
+						  dns_fixedname_name(&f2));
+			order = dns_name_compare(dns_fixedname_name(&f1),
+						 dns_fixedname_name(&f2));
+
+			assert_int_equal(sign(order),
+					 qpkey_compare(key1, len1, key2, len2));
+		}
+	}
+}
+
+/* add, find and remove names */
+ISC_RUN_TEST_IMPL(qp_insert_delete) {
+	dns_qp_t *qp = NULL;
+	item_t items[ARRAY_SIZE(testnames)];
+	item_t upper;
+	isc_result_t result;
+	void *pval = NULL;
+	uint32_t ival = 0;
+
+	dns_qp_create(mctx, &methods, NULL, &qp);
+
+	for (size_t i = 0; i < ARRAY_SIZE(items); i++) {
+		item_init(&items[i], testnames[i]);
+		result = dns_qp_insert(qp, &items[i], i);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_int_equal(items[i].refs, 1);
+	}
+	assert_int_equal(dns_qp_count(qp), ARRAY_SIZE(items));
+
+	/* Names that differ only in case are the same key */
+	item_init(&upper, "WWW.Example.COM.");
+	result = dns_qp_insert(qp, &upper, 0);
+	assert_int_equal(result, ISC_R_EXISTS);
+	assert_int_equal(upper.refs, 0);
+
+	result = dns_qp_getname(qp, upper.name, &pval, &ival);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_equal(pval, &items[22]);
+	assert_int_equal(ival, 22);
+
+	for (size_t i = 0; i < ARRAY_SIZE(items); i++) {
+		result = dns_qp_getname(qp, items[i].name, &pval, &ival);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_ptr_equal(pval, &items[i]);
+		assert_int_equal(ival, i);
+	}
+
+	/* Remove every other name */
+	for (size_t i = 0; i < ARRAY_SIZE(items); i += 2) {
+		result = dns_qp_deletename(qp, items[i].name);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_int_equal(items[i].refs, 0);
+		result = dns_qp_deletename(qp, items[i].name);
+		assert_int_equal(result, ISC_R_NOTFOUND);
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(items); i++) {
+		result = dns_qp_getname(qp, items[i].name, NULL, NULL);
+		assert_int_equal(result,
+				 i % 2 == 0 ? ISC_R_NOTFOUND : ISC_R_SUCCESS);
+	}
+
+	dns_qp_destroy(&qp);
+	assert_null(qp);
+
+	for (size_t i = 0; i < ARRAY_SIZE(items); i++) {
+		assert_int_equal(items[i].refs, 0);
+	}
+}
+
+/* find the closest enclosing name */
+ISC_RUN_TEST_IMPL(qp_findname_ancestor) {
+	static const char *names[] = {
+		"example.",	"a.b.example.", "c.example.",
+		"x.c.example.", "org.",		"\\000.org.",
+	};
+	static const struct {
+		const char *query;
+		isc_result_t result;
+		const char *found;
+	} tests[] = {
+		{ "example.", ISC_R_SUCCESS, "example." },
+		{ "EXAMPLE.", ISC_R_SUCCESS, "example." },
+		{ "b.example.", DNS_R_PARTIALMATCH, "example." },
+		{ "a.b.example.", ISC_R_SUCCESS, "a.b.example." },
+		{ "z.a.b.example.", DNS_R_PARTIALMATCH, "a.b.example." },
+		{ "a.c.example.", DNS_R_PARTIALMATCH, "c.example." },
+		{ "x.c.example.", ISC_R_SUCCESS, "x.c.example." },
+		{ "y.x.c.example.", DNS_R_PARTIALMATCH, "x.c.example." },
+		{ "y.c.example.", DNS_R_PARTIALMATCH, "c.example." },
+		{ "d.example.", DNS_R_PARTIALMATCH, "example." },
+		{ "examples.", ISC_R_NOTFOUND, NULL },
+		{ "exampl.", ISC_R_NOTFOUND, NULL },
+		{ "com.", ISC_R_NOTFOUND, NULL },
+		{ ".", ISC_R_NOTFOUND, NULL },
+		{ "\\000.org.", ISC_R_SUCCESS, "\\000.org." },
+		{ "\\001.org.", DNS_R_PARTIALMATCH, "org." },
+		{ "a.\\000.org.", DNS_R_PARTIALMATCH, "\\000.org." },
+	};
+	dns_qp_t *qp = NULL;
+	item_t items[ARRAY_SIZE(names)], root;
+	isc_result_t result;
+
+	dns_qp_create(mctx, &methods, NULL, &qp);
+
+	for (size_t i = 0; i < ARRAY_SIZE(names); i++) {
+		item_init(&items[i], names[i]);
+		result = dns_qp_insert(qp, &items[i], 0);
+		assert_int_equal(result, ISC_R_SUCCESS);
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(tests); i++) {
+		dns_fixedname_t fixed;
+		item_t *item = NULL;
+
+		dns_test_namefromstring(tests[i].query, &fixed);
+		result = dns_qp_findname_ancestor(
+			qp, dns_fixedname_name(&fixed), (void **)&item, NULL);
+		assert_int_equal(result, tests[i].result);
+		if (tests[i].found != NULL) {
+			dns_fixedname_t ffound;
+			dns_test_namefromstring(tests[i].found, &ffound);
+			assert_true(dns_name_equal(
+				item->name, dns_fixedname_name(&ffound)));
+		}
+	}
+
+	/* With the root name present, everything has an ancestor */
+	item_init(&root, ".");
+	result = dns_qp_insert(qp, &root, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	for (size_t i = 0; i < ARRAY_SIZE(tests); i++) {
+		dns_fixedname_t fixed;
+		item_t *item = NULL;
+
+		dns_test_namefromstring(tests[i].query, &fixed);
+		result = dns_qp_findname_ancestor(
+			qp, dns_fixedname_name(&fixed), (void **)&item, NULL);
+		if (tests[i].found != NULL) {
+			assert_int_equal(result, tests[i].result);
+		} else if (strcmp(tests[i].query, ".") == 0) {
+			assert_int_equal(result, ISC_R_SUCCESS);
+			assert_ptr_equal(item, &root);
+		} else {
+			assert_int_equal(result, DNS_R_PARTIALMATCH);
+			assert_ptr_equal(item, &root);
+		}
+	}
+
+	dns_qp_destroy(&qp);
+}
+
+#define NITEMS 2000
+
+/* random additions and removals, checked against a simple table */
+ISC_RUN_TEST_IMPL(qp_random) {
+	dns_qp_t *qp = NULL;
+	item_t *items = NULL;
+	bool *present = NULL;
+	size_t count = 0;
+	dns_qpiter_t qpi;
+	item_t *prev = NULL, *item = NULL;
+	item_t **sorted = NULL;
+	isc_result_t result;
+
+	items = isc_mem_get(mctx, NITEMS * sizeof(items[0]));
+	present = isc_mem_getx(mctx, NITEMS * sizeof(present[0]),
+			       ISC_MEM_ZERO);
+
+	for (size_t i = 0; i < NITEMS; i++) {
+		char namestr[64];
+		uint32_t r = isc_random32();
+
+		/*
+		 * Short labels from a small alphabet share many prefixes,
+		 * and some names are the ancestors of others.
+		 */
+		snprintf(namestr, sizeof(namestr), "%c%u.%s%c.example%s.",
+			 "ab-_0z"[r % 6], (r >> 3) % 50,
+			 (r >> 9) % 4 == 0 ? "\\200" : "", 'a' + (r >> 11) % 3,
+			 (r >> 13) % 2 == 0 ? "" : ".test");
+		if ((r >> 14) % 8 == 0) {
+			item_init(&items[i], strchr(namestr, '.') + 1);
+		} else {
+			item_init(&items[i], namestr);
+		}
+	}
+
+	dns_qp_create(mctx, &methods, NULL, &qp);
+
+	for (size_t n = 0; n < NITEMS * 10; n++) {
+		size_t i = isc_random_uniform(NITEMS);
+		void *pval = NULL;
+
+		if (isc_random_uniform(2) == 0) {
+			result = dns_qp_insert(qp, &items[i], i);
+			if (result == ISC_R_SUCCESS) {
+				present[i] = true;
+				count++;
+			} else {
+				assert_int_equal(result, ISC_R_EXISTS);
+			}
+		} else if (present[i]) {
+			result = dns_qp_deletename(qp, items[i].name);
+			assert_int_equal(result, ISC_R_SUCCESS);
+			present[i] = false;
+			count--;
+		}
+
+		result = dns_qp_getname(qp, items[i].name, &pval, NULL);
+		if (result == ISC_R_SUCCESS) {
+			/* Only one of a set of equal names can be present */
+			assert_true(dns_name_equal(
+				((item_t *)pval)->name, items[i].name));
+		} else {
+			assert_int_equal(result, ISC_R_NOTFOUND);
+			assert_false(present[i]);
+		}
+	}
+	assert_int_equal(dns_qp_count(qp), count);
+
+	/* The iterator returns every leaf once, in canonical order */
+	sorted = isc_mem_get(mctx, NITEMS * sizeof(sorted[0]));
+	dns_qpiter_init(qp, &qpi);
+	for (size_t n = 0; n < count; n++) {
+		result = dns_qpiter_next(&qpi, (void **)&item, NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_int_equal(item->refs, 1);
+		if (prev != NULL) {
+			assert_true(dns_name_compare(prev->name, item->name) <
+				    0);
+		}
+		sorted[n] = prev = item;
+	}
+	result = dns_qpiter_next(&qpi, NULL, NULL);
+	assert_int_equal(result, ISC_R_NOMORE);
+	result = dns_qpiter_next(&qpi, NULL, NULL);
+	assert_int_equal(result, ISC_R_NOMORE);
+
+	/* The neighbours of every name, in the trie or not, are right */
+	for (size_t i = 0; i < NITEMS; i++) {
+		size_t before = 0, after = 0;
+
+		while (before < count &&
+		       dns_name_compare(sorted[before]->name, items[i].name) <
+			       0)
+		{
+			before++;
+		}
+		after = before;
+		if (after < count &&
+		    dns_name_equal(sorted[after]->name, items[i].name))
+		{
+			after++;
+		}
+
+		result = dns_qp_getname_prev(qp, items[i].name,
+					     (void **)&item, NULL);
+		if (before == 0) {
+			assert_int_equal(result, ISC_R_NOTFOUND);
+		} else {
+			assert_int_equal(result, ISC_R_SUCCESS);
+			assert_ptr_equal(item, sorted[before - 1]);
+		}
+
+		result = dns_qp_getname_next(qp, items[i].name,
+					     (void **)&item, NULL);
+		if (after == count) {
+			assert_int_equal(result, ISC_R_NOTFOUND);
+		} else {
+			assert_int_equal(result, ISC_R_SUCCESS);
+			assert_ptr_equal(item, sorted[after]);
+		}
+	}
+	if (count > 0) {
+		result = dns_qp_getfirst(qp, (void **)&item, NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_ptr_equal(item, sorted[0]);
+		result = dns_qp_getlast(qp, (void **)&item, NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_ptr_equal(item, sorted[count - 1]);
+	}
+	isc_mem_put(mctx, sorted, NITEMS * sizeof(sorted[0]));
+
+	dns_qp_destroy(&qp);
+
+	for (size_t i = 0; i < NITEMS; i++) {
+		assert_int_equal(items[i].refs, 0);
+	}
+
+	isc_mem_put(mctx, present, NITEMS * sizeof(present[0]));
+	isc_mem_put(mctx, items, NITEMS * sizeof(items[0]));
+}
+
+ISC_TEST_LIST_START
+
+ISC_TEST_ENTRY(qpkey_order)
+ISC_TEST_ENTRY(qp_insert_delete)
+ISC_TEST_ENTRY(qp_findname_ancestor)
+ISC_TEST_ENTRY(qp_random)
+
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
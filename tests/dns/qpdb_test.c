@@ -0,0 +1,504 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/dbiterator.h>
+#include <dns/diff.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdataset.h>
+#include <dns/rdatasetiter.h>
+
+#include <tests/dns.h>
+
+/*
+ * The "qp" zone database is tested against the "rbt" one: the same zone
+ * is loaded into both, and every lookup must give the same answer.
+ */
+
+#define ZONE_ORIGIN "test"
+
+static const char *zonefile = TESTS_DIR "/testdata/qpdb/zone.data";
+static const char *nsec3file = TESTS_DIR "/testdata/dbiterator/zone2.data";
+
+static const char *qnames[] = {
+	"test.", "a.test.", "b.test.", "c.test.", "x.c.test.", "d.test.",
+	"x.d.test.", "e.f.g.test.", "f.g.test.", "g.test.", "x.e.f.g.test.",
+	"ns.test.", "star.test.", "*.star.test.", "q.star.test.",
+	"a.b.star.test.", "sub.test.", "ns.sub.test.", "deep.sub.test.",
+	"x.deep.sub.test.", "nx.sub.test.", "w.test.", "*.w.test.", "x.w.test.",
+	"y.w.test.", "a.y.w.test.", "a.x.w.test.", "zz.test.", "0.test.",
+	"example.", "a.example.", ".", "ns2.test.", "d.e.f.test.", "f.test.",
+	"k.test.", "e.test.", "h.test.", "f.g.h.test.", "nx.test.",
+};
+
+static const dns_rdatatype_t qtypes[] = {
+	dns_rdatatype_a,     dns_rdatatype_txt,	  dns_rdatatype_ns,
+	dns_rdatatype_soa,   dns_rdatatype_cname, dns_rdatatype_dname,
+	dns_rdatatype_nsec,  dns_rdatatype_ds,	  dns_rdatatype_mx,
+	dns_rdatatype_nsec3, dns_rdatatype_key,	  dns_rdatatype_any,
+};
+
+static const unsigned int qoptions[] = {
+	0,
+	DNS_DBFIND_GLUEOK,
+	DNS_DBFIND_VALIDATEGLUE,
+	DNS_DBFIND_NOWILD,
+	DNS_DBFIND_FORCENSEC,
+	DNS_DBFIND_GLUEOK | DNS_DBFIND_NOWILD,
+};
+
+static void
+loaddb(const char *impl, const char *file, dns_db_t **dbp) {
+	isc_result_t result;
+	dns_fixedname_t fname;
+
+	dns_test_namefromstring(ZONE_ORIGIN, &fname);
+
+	result = dns_db_create(mctx, impl, dns_fixedname_name(&fname),
+			       dns_dbtype_zone, dns_rdataclass_in, 0, NULL,
+			       dbp);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_db_load(*dbp, file, dns_masterformat_text, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+}
+
+static void
+compare_rdataset(dns_rdataset_t *r1, dns_rdataset_t *r2) {
+	assert_int_equal(dns_rdataset_isassociated(r1),
+			 dns_rdataset_isassociated(r2));
+	if (!dns_rdataset_isassociated(r1)) {
+		return;
+	}
+
+	assert_int_equal(r1->type, r2->type);
+	assert_int_equal(r1->covers, r2->covers);
+	assert_int_equal(r1->ttl, r2->ttl);
+	assert_int_equal(r1->trust, r2->trust);
+	assert_int_equal(dns_rdataset_count(r1), dns_rdataset_count(r2));
+
+	dns_rdataset_disassociate(r1);
+	dns_rdataset_disassociate(r2);
+}
+
+/*
+ * Look 'qname' up in both databases and check that the results agree.
+ */
+static void
+compare_find(dns_db_t *db1, dns_dbversion_t *v1, dns_db_t *db2,
+	     dns_dbversion_t *v2, const char *qname, dns_rdatatype_t type,
+	     unsigned int options) {
+	isc_result_t r1, r2;
+	dns_fixedname_t fqname, ff1, ff2, fn1, fn2;
+	dns_name_t *f1 = dns_fixedname_initname(&ff1);
+	dns_name_t *f2 = dns_fixedname_initname(&ff2);
+	dns_name_t *n1 = dns_fixedname_initname(&fn1);
+	dns_name_t *n2 = dns_fixedname_initname(&fn2);
+	dns_rdataset_t rds1, rds2, sig1, sig2;
+	dns_dbnode_t *node1 = NULL, *node2 = NULL;
+
+	dns_test_namefromstring(qname, &fqname);
+	dns_rdataset_init(&rds1);
+	dns_rdataset_init(&rds2);
+	dns_rdataset_init(&sig1);
+	dns_rdataset_init(&sig2);
+
+	r1 = dns_db_find(db1, dns_fixedname_name(&fqname), v1, type, options,
+			 0, &node1, f1, &rds1, &sig1);
+	r2 = dns_db_find(db2, dns_fixedname_name(&fqname), v2, type, options,
+			 0, &node2, f2, &rds2, &sig2);
+
+	if (r1 != r2) {
+		fail_msg("%s/%u/%x: %s != %s", qname, type, options,
+			 isc_result_totext(r1), isc_result_totext(r2));
+	}
+	if (r1 == ISC_R_NOTFOUND || r1 == DNS_R_BADDB) {
+		return;
+	}
+
+	/*
+	 * When there is no such name and no NSEC to prove it, the found
+	 * name is only the closest node that the database happened to
+	 * have, which depends on the shape of its tree.
+	 */
+	if ((r1 == DNS_R_NXDOMAIN || r1 == DNS_R_EMPTYNAME) &&
+	    !dns_rdataset_isassociated(&rds1))
+	{
+		dns_name_copy(f1, f2);
+	}
+	if (!dns_name_equal(f1, f2)) {
+		char t1[DNS_NAME_FORMATSIZE], t2[DNS_NAME_FORMATSIZE];
+
+		dns_name_format(f1, t1, sizeof(t1));
+		dns_name_format(f2, t2, sizeof(t2));
+		fail_msg("%s/%u/%x: %s: found %s != %s", qname, type, options,
+			 isc_result_totext(r1), t1, t2);
+	}
+	assert_int_equal(f1->attributes.wildcard, f2->attributes.wildcard);
+
+	assert_int_equal(node1 == NULL, node2 == NULL);
+	if (node1 != NULL) {
+		assert_int_equal(dns_db_nodefullname(db1, node1, n1),
+				 ISC_R_SUCCESS);
+		assert_int_equal(dns_db_nodefullname(db2, node2, n2),
+				 ISC_R_SUCCESS);
+		assert_true(dns_name_equal(n1, n2));
+		dns_db_detachnode(db1, &node1);
+		dns_db_detachnode(db2, &node2);
+	}
+
+	compare_rdataset(&rds1, &rds2);
+	compare_rdataset(&sig1, &sig2);
+}
+
+static void
+compare_all(dns_db_t *db1, dns_dbversion_t *v1, dns_db_t *db2,
+	    dns_dbversion_t *v2) {
+	for (size_t n = 0; n < ARRAY_SIZE(qnames); n++) {
+		for (size_t t = 0; t < ARRAY_SIZE(qtypes); t++) {
+			for (size_t o = 0; o < ARRAY_SIZE(qoptions); o++) {
+				compare_find(db1, v1, db2, v2, qnames[n],
+					     qtypes[t], qoptions[o]);
+			}
+		}
+	}
+}
+
+/*
+ * Collect the names of the nodes that have data in the current version,
+ * in iterator order.  The "rbt" database also walks the empty nodes it
+ * uses to split its tree, and the "qp" one the empty non-terminals, so
+ * only nodes with data can be compared.
+ */
+static size_t
+walk(dns_db_t *db, unsigned int options, dns_fixedname_t *names,
+     size_t size) {
+	isc_result_t result;
+	dns_dbiterator_t *iter = NULL;
+	size_t count = 0;
+
+	result = dns_db_createiterator(db, options, &iter);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	for (result = dns_dbiterator_first(iter); result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_next(iter))
+	{
+		dns_dbnode_t *node = NULL;
+		dns_rdatasetiter_t *rdsiter = NULL;
+		dns_name_t *name = NULL;
+
+		assert_true(count < size);
+		name = dns_fixedname_initname(&names[count]);
+		result = dns_dbiterator_current(iter, &node, name);
+		if (result == DNS_R_NEWORIGIN) {
+			result = ISC_R_SUCCESS;
+		}
+		assert_int_equal(result, ISC_R_SUCCESS);
+
+		result = dns_db_allrdatasets(db, node, NULL, 0, 0, &rdsiter);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		if (dns_rdatasetiter_first(rdsiter) == ISC_R_SUCCESS) {
+			count++;
+		}
+		dns_rdatasetiter_destroy(&rdsiter);
+		dns_db_detachnode(db, &node);
+	}
+	assert_int_equal(result, ISC_R_NOMORE);
+
+	dns_dbiterator_destroy(&iter);
+
+	return (count);
+}
+
+static void
+compare_walk(dns_db_t *db1, dns_db_t *db2, unsigned int options) {
+	dns_fixedname_t names1[64], names2[64];
+	size_t count1, count2;
+
+	count1 = walk(db1, options, names1, ARRAY_SIZE(names1));
+	count2 = walk(db2, options, names2, ARRAY_SIZE(names2));
+	assert_int_equal(count1, count2);
+	assert_true(count1 > 0);
+
+	for (size_t i = 0; i < count1; i++) {
+		assert_true(dns_name_equal(dns_fixedname_name(&names1[i]),
+					   dns_fixedname_name(&names2[i])));
+	}
+}
+
+static void
+apply(dns_db_t *db, dns_dbversion_t *version, const zonechange_t *changes) {
+	isc_result_t result;
+	dns_diff_t diff;
+
+	result = dns_test_difffromchanges(&diff, changes, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_diff_apply(&diff, db, version);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_diff_clear(&diff);
+}
+
+/* create: a "qp" database can be created, but only for zone data */
+ISC_RUN_TEST_IMPL(create) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+
+	UNUSED(state);
+
+	result = dns_db_create(mctx, "qp", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_NOTIMPLEMENTED);
+	assert_null(db);
+
+	loaddb("qp", zonefile, &db);
+	assert_true(dns_db_iszone(db));
+	assert_false(dns_db_issecure(db));
+	assert_int_equal(dns_db_nodecount(db, dns_dbtree_nsec3), 1);
+	dns_db_detach(&db);
+}
+
+/* find: lookups give the same answers as in an "rbt" database */
+ISC_RUN_TEST_IMPL(find) {
+	dns_db_t *rbt = NULL, *qp = NULL;
+
+	UNUSED(state);
+
+	loaddb("rbt", zonefile, &rbt);
+	loaddb("qp", zonefile, &qp);
+
+	compare_all(rbt, NULL, qp, NULL);
+
+	dns_db_detach(&rbt);
+	dns_db_detach(&qp);
+}
+
+/* find_nsec3: lookups in a signed NSEC3 zone give the same answers */
+ISC_RUN_TEST_IMPL(find_nsec3) {
+	dns_db_t *rbt = NULL, *qp = NULL;
+	dns_fixedname_t names[64];
+	size_t count;
+
+	UNUSED(state);
+
+	loaddb("rbt", nsec3file, &rbt);
+	loaddb("qp", nsec3file, &qp);
+
+	assert_true(dns_db_issecure(qp));
+
+	compare_all(rbt, NULL, qp, NULL);
+
+	/*
+	 * Look up the NSEC3 owner names and some that hash near them.
+	 */
+	count = walk(rbt, DNS_DB_NSEC3ONLY, names, ARRAY_SIZE(names));
+	assert_true(count > 0);
+	for (size_t i = 0; i < count; i++) {
+		char text[DNS_NAME_FORMATSIZE];
+
+		dns_name_format(dns_fixedname_name(&names[i]), text,
+				sizeof(text));
+		compare_find(rbt, NULL, qp, NULL, text, dns_rdatatype_nsec3,
+			     DNS_DBFIND_FORCENSEC3);
+		text[0] = (text[0] == '0') ? 'V' : '0';
+		compare_find(rbt, NULL, qp, NULL, text, dns_rdatatype_nsec3,
+			     DNS_DBFIND_FORCENSEC3);
+	}
+
+	dns_db_detach(&rbt);
+	dns_db_detach(&qp);
+}
+
+/* iterate: the database iterators visit the same names in the same order */
+ISC_RUN_TEST_IMPL(iterate) {
+	dns_db_t *rbt = NULL, *qp = NULL;
+
+	UNUSED(state);
+
+	loaddb("rbt", zonefile, &rbt);
+	loaddb("qp", zonefile, &qp);
+	compare_walk(rbt, qp, 0);
+	dns_db_detach(&rbt);
+	dns_db_detach(&qp);
+
+	loaddb("rbt", nsec3file, &rbt);
+	loaddb("qp", nsec3file, &qp);
+	compare_walk(rbt, qp, 0);
+	compare_walk(rbt, qp, DNS_DB_NONSEC3);
+	compare_walk(rbt, qp, DNS_DB_NSEC3ONLY);
+	dns_db_detach(&rbt);
+	dns_db_detach(&qp);
+}
+
+/* seek: the database iterators find the same names */
+ISC_RUN_TEST_IMPL(seek) {
+	dns_db_t *qp = NULL;
+	dns_dbiterator_t *iter = NULL;
+	dns_fixedname_t fseek, fname;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	loaddb("qp", zonefile, &qp);
+	result = dns_db_createiterator(qp, 0, &iter);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	/* An exact match */
+	dns_test_namefromstring("x.w.test.", &fseek);
+	result = dns_dbiterator_seek(iter, dns_fixedname_name(&fseek));
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_dbiterator_current(iter, &node, name);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(dns_name_equal(name, dns_fixedname_name(&fseek)));
+	dns_db_detachnode(qp, &node);
+
+	/* A partial match leaves the iterator at the previous name */
+	dns_test_namefromstring("b.test.", &fseek);
+	result = dns_dbiterator_seek(iter, dns_fixedname_name(&fseek));
+	assert_int_equal(result, DNS_R_PARTIALMATCH);
+	result = dns_dbiterator_current(iter, &node, name);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_test_namefromstring("a.test.", &fseek);
+	assert_true(dns_name_equal(name, dns_fixedname_name(&fseek)));
+	dns_db_detachnode(qp, &node);
+
+	result = dns_dbiterator_next(iter);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_dbiterator_current(iter, &node, name);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_test_namefromstring("c.test.", &fseek);
+	assert_true(dns_name_equal(name, dns_fixedname_name(&fseek)));
+	dns_db_detachnode(qp, &node);
+
+	/* A name outside the zone */
+	dns_test_namefromstring("example.", &fseek);
+	result = dns_dbiterator_seek(iter, dns_fixedname_name(&fseek));
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	dns_dbiterator_destroy(&iter);
+	dns_db_detach(&qp);
+}
+
+/* versions: updates, commits and rollbacks give the same answers */
+ISC_RUN_TEST_IMPL(versions) {
+	dns_db_t *rbt = NULL, *qp = NULL, *ref = NULL;
+	dns_dbversion_t *orbt = NULL, *oqp = NULL;
+	dns_dbversion_t *vrbt = NULL, *vqp = NULL;
+	unsigned int nodes;
+	zonechange_t update[] = {
+		{ DNS_DIFFOP_ADD, "y.w.test.", 300, "TXT", "\"y\"" },
+		{ DNS_DIFFOP_ADD, "a.b.h.test.", 300, "A", "10.53.0.1" },
+		{ DNS_DIFFOP_ADD, "zz.test.", 300, "NS", "ns.zz.test." },
+		{ DNS_DIFFOP_ADD, "ns.zz.test.", 300, "A", "10.53.0.2" },
+		{ DNS_DIFFOP_ADD, "*.test.", 300, "TXT", "\"top wild\"" },
+		{ DNS_DIFFOP_DEL, "x.w.test.", 600, "TXT", "\"x\"" },
+		{ DNS_DIFFOP_DEL, "x.w.test.", 600, "NSEC", "test. TXT NSEC" },
+		{ DNS_DIFFOP_DEL, "c.test.", 600, "CNAME", "a.test." },
+		{ DNS_DIFFOP_DEL, "c.test.", 600, "NSEC",
+		  "d.test. CNAME NSEC" },
+		{ DNS_DIFFOP_ADD, "ns.test.", 600, "A", "10.0.0.2" },
+		ZONECHANGE_SENTINEL,
+	};
+	zonechange_t rollback[] = {
+		{ DNS_DIFFOP_ADD, "a.b.c.d.e.test.", 300, "TXT", "\"deep\"" },
+		{ DNS_DIFFOP_DEL, "sub.test.", 600, "NS", "ns.sub.test." },
+		{ DNS_DIFFOP_DEL, "ns.test.", 600, "A", "10.0.0.1" },
+		ZONECHANGE_SENTINEL,
+	};
+
+	UNUSED(state);
+
+	loaddb("rbt", zonefile, &rbt);
+	loaddb("qp", zonefile, &qp);
+
+	/*
+	 * The "rbt" database looks only at the newest rdatasets of a node
+	 * when it decides whether a wildcard can match beneath it, so its
+	 * older versions see some of the newer changes; the older versions
+	 * are compared with a copy of the zone that was never changed.
+	 */
+	loaddb("rbt", zonefile, &ref);
+
+	dns_db_currentversion(rbt, &orbt);
+	dns_db_currentversion(qp, &oqp);
+
+	/*
+	 * Make some changes, and check that they are only visible in
+	 * the new version until it is committed.
+	 */
+	assert_int_equal(dns_db_newversion(rbt, &vrbt), ISC_R_SUCCESS);
+	assert_int_equal(dns_db_newversion(qp, &vqp), ISC_R_SUCCESS);
+	apply(rbt, vrbt, update);
+	apply(qp, vqp, update);
+	compare_all(rbt, vrbt, qp, vqp);
+	compare_all(ref, NULL, qp, NULL);
+	dns_db_closeversion(rbt, &vrbt, true);
+	dns_db_closeversion(qp, &vqp, true);
+
+	compare_all(rbt, NULL, qp, NULL);
+	compare_all(ref, NULL, qp, oqp);
+	dns_db_closeversion(rbt, &orbt, false);
+	dns_db_closeversion(qp, &oqp, false);
+	compare_all(rbt, NULL, qp, NULL);
+	compare_walk(rbt, qp, 0);
+
+	/*
+	 * A rolled back version leaves no trace, not even the nodes it
+	 * added.
+	 */
+	nodes = dns_db_nodecount(qp, dns_dbtree_main);
+	assert_int_equal(dns_db_newversion(rbt, &vrbt), ISC_R_SUCCESS);
+	assert_int_equal(dns_db_newversion(qp, &vqp), ISC_R_SUCCESS);
+	apply(rbt, vrbt, rollback);
+	apply(qp, vqp, rollback);
+	assert_true(dns_db_nodecount(qp, dns_dbtree_main) > nodes);
+	compare_all(rbt, vrbt, qp, vqp);
+	compare_all(rbt, NULL, qp, NULL);
+	dns_db_closeversion(rbt, &vrbt, false);
+	dns_db_closeversion(qp, &vqp, false);
+
+	compare_all(rbt, NULL, qp, NULL);
+	compare_walk(rbt, qp, 0);
+	assert_int_equal(dns_db_nodecount(qp, dns_dbtree_main), nodes);
+
+	dns_db_detach(&ref);
+	dns_db_detach(&rbt);
+	dns_db_detach(&qp);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(create)
+ISC_TEST_ENTRY(find)
+ISC_TEST_ENTRY(find_nsec3)
+ISC_TEST_ENTRY(iterate)
+ISC_TEST_ENTRY(seek)
+ISC_TEST_ENTRY(versions)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -24,7 +24,9 @@
 
 #include <isc/util.h>
 
+#include <dns/db.h>
 #include <dns/rbt.h>
+#include <dns/rdatalist.h>
 #include <dns/rdataset.h>
 #include <dns/rdatastruct.h>
 #define KEEP_BEFORE
@@ -203,9 +205,231 @@ ISC_RUN_TEST_IMPL(setownercase) {
 	assert_true(dns_name_caseequal(name1, name2));
 }
 
+#define SIEVE_NAMES 256
+
+static isc_result_t
+sieve_find(dns_db_t *db, unsigned int i) {
+	dns_fixedname_t fixed, ffixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_name_t *foundname = dns_fixedname_initname(&ffixed);
+	dns_rdataset_t rdataset;
+	dns_dbnode_t *node = NULL;
+	char text[64];
+	isc_result_t result;
+
+	snprintf(text, sizeof(text), "n%u.example", i);
+	result = dns_name_fromstring(name, text, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(db, name, NULL, dns_rdatatype_a, 0, 0, &node,
+			     foundname, &rdataset, NULL);
+	if (dns_rdataset_isassociated(&rdataset)) {
+		dns_rdataset_disassociate(&rdataset);
+	}
+	if (node != NULL) {
+		dns_db_detachnode(db, &node);
+	}
+
+	return (result);
+}
+
+/* overmem_purge() evicts the cache entries that haven't been used */
+ISC_RUN_TEST_IMPL(sieve) {
+	dns_db_t *db = NULL;
+	dns_rbtdb_t *rbtdb = NULL;
+	unsigned char data[] = { 192, 0, 2, 1 };
+	unsigned int evicted = 0, missing = 0;
+	isc_stdtime_t now;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	rbtdb = (dns_rbtdb_t *)db;
+
+	for (unsigned int i = 0; i < SIEVE_NAMES; i++) {
+		dns_fixedname_t fixed;
+		dns_name_t *name = dns_fixedname_initname(&fixed);
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		dns_rdatalist_t rdatalist;
+		dns_rdataset_t rdataset;
+		dns_dbnode_t *node = NULL;
+		char text[64];
+
+		snprintf(text, sizeof(text), "n%u.example", i);
+		result = dns_name_fromstring(name, text, 0, NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+
+		dns_rdata_fromregion(&rdata, dns_rdataclass_in, dns_rdatatype_a,
+				     &(isc_region_t){ data, sizeof(data) });
+		dns_rdatalist_init(&rdatalist);
+		rdatalist.rdclass = dns_rdataclass_in;
+		rdatalist.type = dns_rdatatype_a;
+		rdatalist.ttl = 3600;
+		ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+		dns_rdataset_init(&rdataset);
+		dns_rdatalist_tordataset(&rdatalist, &rdataset);
+
+		result = dns_db_findnode(db, name, true, &node);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		result = dns_db_addrdataset(db, node, NULL, 0, &rdataset, 0,
+					    NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		dns_db_detachnode(db, &node);
+		dns_rdataset_disassociate(&rdataset);
+	}
+
+	/* Use the even entries */
+	for (unsigned int i = 0; i < SIEVE_NAMES; i += 2) {
+		assert_int_equal(sieve_find(db, i), ISC_R_SUCCESS);
+	}
+
+	/*
+	 * Purge each bucket that has at least two unused entries; the
+	 * purge starts with the bucket after 'locknum_start'.
+	 */
+	isc_stdtime_get(&now);
+	for (unsigned int b = 0; b < rbtdb->node_lock_count; b++) {
+		isc_rwlocktype_t tlocktype = isc_rwlocktype_none;
+		unsigned int unused = 0;
+
+		for (rdatasetheader_t *header =
+			     ISC_LIST_HEAD(rbtdb->rdatasets[b]);
+		     header != NULL; header = ISC_LIST_NEXT(header, link))
+		{
+			if (RDATASET_ATTR_GET(header, RDATASET_ATTR_VISITED) ==
+			    0)
+			{
+				unused++;
+			}
+		}
+		if (unused < 2) {
+			continue;
+		}
+
+		overmem_purge(rbtdb,
+			      (b + rbtdb->node_lock_count - 1) %
+				      rbtdb->node_lock_count,
+			      now, &tlocktype);
+		assert_int_equal(tlocktype, isc_rwlocktype_none);
+		evicted += 2;
+	}
+	assert_true(evicted > 0);
+
+	for (unsigned int i = 0; i < SIEVE_NAMES; i++) {
+		result = sieve_find(db, i);
+		if (i % 2 == 0) {
+			assert_int_equal(result, ISC_R_SUCCESS);
+		} else if (result != ISC_R_SUCCESS) {
+			assert_int_equal(result, ISC_R_NOTFOUND);
+			missing++;
+		}
+	}
+	assert_int_equal(missing, evicted);
+
+	dns_db_detach(&db);
+}
+
+static dns_dbnode_t *
+expire_add(dns_db_t *db, unsigned int i, isc_stdtime_t now) {
+	unsigned char data[] = { 192, 0, 2, 1 };
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_dbnode_t *node = NULL;
+	char text[64];
+	isc_result_t result;
+
+	snprintf(text, sizeof(text), "n%u.example", i);
+	result = dns_name_fromstring(name, text, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdata_fromregion(&rdata, dns_rdataclass_in, dns_rdatatype_a,
+			     &(isc_region_t){ data, sizeof(data) });
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.ttl = 10;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+	dns_rdataset_init(&rdataset);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+
+	result = dns_db_findnode(db, name, true, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_addrdataset(db, node, NULL, now, &rdataset, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_rdataset_disassociate(&rdataset);
+
+	return (node);
+}
+
+/*
+ * Without a background cleaner, adding to a bucket expires the due
+ * entries of that bucket, not just the first of them
+ */
+ISC_RUN_TEST_IMPL(expire) {
+	dns_db_t *db = NULL;
+	dns_rbtdb_t *rbtdb = NULL;
+	dns_dbnode_t *node = NULL;
+	unsigned int locknum, added = 0;
+	isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
+	isc_stdtime_t now;
+	isc_result_t result;
+
+	UNUSED(state);
+
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	rbtdb = (dns_rbtdb_t *)db;
+
+	isc_stdtime_get(&now);
+
+	node = expire_add(db, 0, now);
+	locknum = ((dns_rbtnode_t *)node)->locknum;
+	dns_db_detachnode(db, &node);
+
+	/* Fill the bucket of the first name with entries that will expire */
+	for (unsigned int i = 1; added < DNS_RBTDB_EXPIRE_MAX - 1; i++) {
+		node = expire_add(db, i, now);
+		if (((dns_rbtnode_t *)node)->locknum == locknum) {
+			added++;
+		}
+		dns_db_detachnode(db, &node);
+	}
+
+	now += 10 + RBTDB_VIRTUAL + 1;
+	NODE_WRLOCK(&rbtdb->node_locks[locknum].lock, &nlocktype);
+	assert_non_null(ttl_due(rbtdb, locknum, now));
+	NODE_UNLOCK(&rbtdb->node_locks[locknum].lock, &nlocktype);
+
+	/* Adding to the bucket again expires them all */
+	for (unsigned int i = 1000;; i++) {
+		node = expire_add(db, i, now);
+		if (((dns_rbtnode_t *)node)->locknum == locknum) {
+			dns_db_detachnode(db, &node);
+			break;
+		}
+		dns_db_detachnode(db, &node);
+	}
+
+	NODE_WRLOCK(&rbtdb->node_locks[locknum].lock, &nlocktype);
+	assert_null(ttl_due(rbtdb, locknum, now));
+	NODE_UNLOCK(&rbtdb->node_locks[locknum].lock, &nlocktype);
+
+	dns_db_detach(&db);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(ownercase)
 ISC_TEST_ENTRY(setownercase)
+ISC_TEST_ENTRY(sieve)
+ISC_TEST_ENTRY(expire)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -11,26 +11,44 @@
  * information regarding copyright ownership.
  */
 
+#include <inttypes.h>
 #include <sched.h> /* IWYU pragma: keep */
 #include <setjmp.h>
 #include <stdarg.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #define UNIT_TESTING
 #include <cmocka.h>
 
+#include <isc/async.h>
+#include <isc/atomic.h>
+#include <isc/barrier.h>
 #include <isc/buffer.h>
+#include <isc/loop.h>
 #include <isc/net.h>
 #include <isc/print.h>
+#include <isc/stats.h>
 #include <isc/task.h>
+#include <isc/tid.h>
+#include <isc/time.h>
 #include <isc/timer.h>
 #include <isc/util.h>
 
+#include <dns/adb.h>
+#include <dns/db.h>
 #include <dns/dispatch.h>
+#include <dns/events.h>
 #include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/rdatastruct.h>
 #include <dns/resolver.h>
+#include <dns/stats.h>
 #include <dns/view.h>
 
 #include <tests/dns.h>
@@ -175,6 +193,692 @@ ISC_LOOP_TEST_IMPL(settimeout_overmax) {
 	isc_loopmgr_shutdown(loopmgr);
 }
 
+/* dns_resolver_setmaxraces */
+ISC_LOOP_TEST_IMPL(setmaxraces) {
+	dns_resolver_t *resolver = NULL;
+
+	mkres(&resolver);
+
+	/* Query racing is off unless configured */
+	assert_int_equal(dns_resolver_getmaxraces(resolver), 0);
+
+	dns_resolver_setmaxraces(resolver, 2);
+	assert_int_equal(dns_resolver_getmaxraces(resolver), 2);
+
+	dns_resolver_setmaxraces(resolver, 0);
+	assert_int_equal(dns_resolver_getmaxraces(resolver), 0);
+
+	destroy_resolver(&resolver);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/*
+ * Fetch contexts and zone counters.
+ */
+
+#define FETCHES 1000
+
+typedef struct fetch {
+	dns_fetch_t *fetch;
+	dns_rdataset_t rdataset;
+} fetch_t;
+
+static dns_view_t *fetchview = NULL;
+static dns_fixedname_t fdomain;
+static dns_name_t *domain = NULL;
+static dns_rdatalist_t nslist;
+static dns_rdata_t nsrdata = DNS_RDATA_INIT;
+static unsigned char nsbuf[DNS_NAME_MAXWIRE];
+static dns_rdataset_t nameservers;
+static fetch_t *fetches = NULL;
+static size_t nfetches = 0;
+static atomic_uint_fast32_t pending;
+
+static void
+mkfetchview(size_t count) {
+	isc_result_t result;
+
+	result = dns_test_makeview("fetch", true, &fetchview);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_view_createresolver(fetchview, loopmgr, taskmgr, 1,
+					 netmgr, 0, dispatchmgr, dispatch,
+					 NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_view_freeze(fetchview);
+
+	/*
+	 * Give every fetch the same delegation, so that they all
+	 * share a single zone counter.  The name server has no
+	 * address, so the fetches fail without sending any queries.
+	 */
+	dns_test_namefromstring("example.", &fdomain);
+	domain = dns_fixedname_name(&fdomain);
+
+	dns_rdata_init(&nsrdata);
+	result = dns_test_rdatafromstring(&nsrdata, dns_rdataclass_in,
+					  dns_rdatatype_ns, nsbuf,
+					  sizeof(nsbuf), "ns.example.net.",
+					  false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdatalist_init(&nslist);
+	nslist.rdclass = dns_rdataclass_in;
+	nslist.type = dns_rdatatype_ns;
+	nslist.ttl = 3600;
+	ISC_LIST_APPEND(nslist.rdata, &nsrdata, link);
+	dns_rdataset_init(&nameservers);
+	dns_rdatalist_tordataset(&nslist, &nameservers);
+
+	nfetches = count;
+	fetches = isc_mem_get(mctx, nfetches * sizeof(fetches[0]));
+	memset(fetches, 0, nfetches * sizeof(fetches[0]));
+	atomic_init(&pending, nfetches);
+}
+
+static void
+fetchdone(isc_task_t *task, isc_event_t *event) {
+	dns_fetchevent_t *fevent = (dns_fetchevent_t *)event;
+	fetch_t *f = event->ev_arg;
+
+	UNUSED(task);
+
+	assert_ptr_equal(fevent->fetch, f->fetch);
+
+	if (fevent->node != NULL) {
+		dns_db_detachnode(fevent->db, &fevent->node);
+	}
+	if (fevent->db != NULL) {
+		dns_db_detach(&fevent->db);
+	}
+	if (dns_rdataset_isassociated(fevent->rdataset)) {
+		dns_rdataset_disassociate(fevent->rdataset);
+	}
+	dns_resolver_destroyfetch(&f->fetch);
+	isc_event_free(&event);
+
+	if (atomic_fetch_sub(&pending, 1) == 1) {
+		dns_rdataset_disassociate(&nameservers);
+		isc_mem_put(mctx, fetches, nfetches * sizeof(fetches[0]));
+		dns_view_detach(&fetchview);
+		isc_loopmgr_shutdown(loopmgr);
+	}
+}
+
+static void
+createfetch(const char *namestr, unsigned int options, isc_task_t *task,
+	    fetch_t *f) {
+	isc_result_t result;
+	dns_fixedname_t fname;
+
+	dns_test_namefromstring(namestr, &fname);
+	dns_rdataset_init(&f->rdataset);
+	result = dns_resolver_createfetch(
+		fetchview->resolver, dns_fixedname_name(&fname),
+		dns_rdatatype_a, domain, &nameservers, NULL, NULL, 0, options,
+		0, NULL, task, fetchdone, f, &f->rdataset, NULL, &f->fetch);
+	assert_int_equal(result, ISC_R_SUCCESS);
+}
+
+static void
+checkfetches(const char *expected) {
+	char *text = NULL;
+	size_t size = 0;
+	FILE *fp = open_memstream(&text, &size);
+
+	assert_non_null(fp);
+	dns_resolver_dumpfetches(fetchview->resolver, isc_statsformat_file,
+				 fp);
+	fclose(fp);
+
+	assert_string_equal(text, expected);
+	free(text);
+}
+
+/* fetches for the same name and type share a fetch context */
+ISC_LOOP_TEST_IMPL(fetch_coalesce) {
+	isc_task_t *task = NULL;
+
+	mkfetchview(4);
+	isc_task_create(taskmgr, &task, 0);
+
+	createfetch("www.example.", 0, task, &fetches[0]);
+	checkfetches("example.: 1 active (0 spilled, 1 allowed)\n");
+
+	/* Matching is case insensitive */
+	createfetch("WWW.example.", 0, task, &fetches[1]);
+	checkfetches("example.: 1 active (0 spilled, 1 allowed)\n");
+
+	createfetch("mail.example.", 0, task, &fetches[2]);
+	checkfetches("example.: 2 active (0 spilled, 2 allowed)\n");
+
+	/* Unshared fetches always get a new fetch context */
+	createfetch("www.example.", DNS_FETCHOPT_UNSHARED, task, &fetches[3]);
+	checkfetches("example.: 3 active (0 spilled, 3 allowed)\n");
+
+	isc_task_detach(&task);
+}
+
+static isc_barrier_t contention_created;
+static isc_barrier_t contention_checked;
+
+static void
+contention_loop(void *arg) {
+	uint32_t tid = isc_tid();
+	fetch_t *f = &fetches[tid * FETCHES];
+	isc_task_t *task = NULL;
+
+	UNUSED(arg);
+
+	isc_task_create(taskmgr, &task, tid);
+
+	/*
+	 * Every loop asks for the same set of names, so the loops
+	 * compete both for new fetch contexts and for joining the
+	 * ones created by the other loops.
+	 */
+	for (size_t i = 0; i < FETCHES; i++) {
+		char namestr[DNS_NAME_FORMATSIZE];
+
+		snprintf(namestr, sizeof(namestr), "n%zu.example.", i);
+		createfetch(namestr, 0, task, &f[i]);
+	}
+
+	/*
+	 * A fetch context runs on the loop that created it, so none of
+	 * them can finish while every loop waits here: each name must
+	 * have exactly one, which all the loops have joined.
+	 */
+	isc_barrier_wait(&contention_created);
+	if (tid == 0) {
+		char expected[64];
+
+		snprintf(expected, sizeof(expected),
+			 "example.: %u active (0 spilled, %u allowed)\n",
+			 FETCHES, FETCHES);
+		checkfetches(expected);
+	}
+	isc_barrier_wait(&contention_checked);
+
+	isc_task_detach(&task);
+}
+
+/* concurrent fetch creation from all loops */
+ISC_LOOP_TEST_IMPL(fetch_contention) {
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+
+	mkfetchview(nloops * FETCHES);
+	isc_barrier_init(&contention_created, nloops);
+	isc_barrier_init(&contention_checked, nloops);
+
+	for (uint32_t i = 0; i < nloops; i++) {
+		isc_async_run(isc_loop_get(loopmgr, i), contention_loop, NULL);
+	}
+}
+
+static int
+teardown_contention(void **state) {
+	isc_barrier_destroy(&contention_created);
+	isc_barrier_destroy(&contention_checked);
+
+	return (teardown_test(state));
+}
+
+/*
+ * Query racing, against two mock authoritative servers for "example."
+ * on 127.0.0.1 and 127.0.0.2.  Whichever server gets the first query
+ * is the slow one, and answers it only after RACE_SLOW_MS.  The other
+ * one answers at once, either with its own address or with REFUSED.
+ */
+#define RACE_SLOW_MS   400
+#define RACE_LINGER_MS 50
+#define RACE_SLACK_US  (10 * US_PER_MS)
+
+typedef struct race_server {
+	int fd;
+	isc_sockaddr_t addr;
+	unsigned int queries;
+	isc_time_t received; /* when the first query arrived */
+	isc_sockaddr_t client;
+	unsigned char query[512];
+	size_t querylen;
+	bool refused; /* the late answer bounced off a closed port */
+} race_server_t;
+
+typedef struct race_scenario {
+	unsigned int srtt;	 /* of both servers, in microseconds */
+	unsigned int maxqueries; /* 0 keeps the default */
+	bool refuse;		 /* the fast server answers REFUSED */
+	void (*check)(void);
+} race_scenario_t;
+
+static race_server_t race_servers[2];
+static race_server_t *race_slow = NULL, *race_fast = NULL;
+static const race_scenario_t *race_scenario = NULL;
+static isc_timer_t *race_timer = NULL;
+static isc_task_t *race_task = NULL;
+static isc_stats_t *race_stats = NULL;
+static fetch_t race_fetch;
+static bool race_fetched = false;
+static isc_result_t race_result;
+static isc_sockaddr_t race_answer;
+static isc_time_t race_answered; /* when the slow server answered */
+static dns_rdata_t race_nsrdata[2];
+static unsigned char race_nsbuf[2][DNS_NAME_MAXWIRE];
+
+static void
+race_reply(race_server_t *server, const unsigned char *query, size_t len,
+	   const isc_sockaddr_t *client, bool refuse) {
+	unsigned char buf[512];
+	size_t qlen = 12;
+	ssize_t n;
+
+	/* The header, and the question up to the end of its class */
+	while (qlen < len && query[qlen] != 0) {
+		qlen += query[qlen] + 1;
+	}
+	qlen += 5;
+	assert_true(qlen <= len && qlen + 16 <= sizeof(buf));
+
+	memmove(buf, query, qlen);
+	buf[2] = 0x84 | (query[2] & 0x01); /* QR, AA, and RD if set */
+	buf[3] = refuse ? dns_rcode_refused : dns_rcode_noerror;
+	memset(buf + 4, 0, 8);
+	buf[5] = 1;		  /* QDCOUNT */
+	buf[7] = refuse ? 0 : 1; /* ANCOUNT */
+
+	if (!refuse) {
+		/* www.example. 3600 IN A <the server's own address> */
+		static const unsigned char rr[] = { 0xc0, 0x0c, 0, 1,	 0,
+						    1,	  0,	0, 0x0e, 0x10,
+						    0,	  4 };
+		memmove(buf + qlen, rr, sizeof(rr));
+		memmove(buf + qlen + sizeof(rr),
+			&server->addr.type.sin.sin_addr, 4);
+		qlen += sizeof(rr) + 4;
+	}
+
+	n = sendto(server->fd, buf, qlen, 0, &client->type.sa,
+		   client->length);
+	assert_int_equal(n, (ssize_t)qlen);
+}
+
+static void
+race_done(void) {
+	race_scenario->check();
+
+	isc_timer_stop(race_timer);
+	isc_timer_destroy(&race_timer);
+
+	for (size_t i = 0; i < ARRAY_SIZE(race_servers); i++) {
+		close(race_servers[i].fd);
+	}
+
+	isc_stats_detach(&race_stats);
+	isc_task_detach(&race_task);
+	dns_rdataset_disassociate(&nameservers);
+	dns_view_detach(&fetchview);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+race_tick(void *arg) {
+	isc_time_t now;
+
+	UNUSED(arg);
+
+	isc_time_now(&now);
+
+	for (size_t i = 0; i < ARRAY_SIZE(race_servers); i++) {
+		race_server_t *server = &race_servers[i];
+		unsigned char buf[512];
+		isc_sockaddr_t client = { .length = 0 };
+		socklen_t len = sizeof(client.type);
+		ssize_t n;
+
+		while ((n = recvfrom(server->fd, buf, sizeof(buf),
+				     MSG_DONTWAIT, &client.type.sa, &len)) >= 0)
+		{
+			client.length = len;
+			len = sizeof(client.type);
+
+			if (server->queries++ == 0) {
+				server->received = now;
+			}
+
+			if (race_slow == NULL) {
+				/* Keep the first query for later */
+				race_slow = server;
+				server->client = client;
+				server->querylen = n;
+				memmove(server->query, buf, n);
+				continue;
+			}
+
+			INSIST(race_fast == NULL || race_fast == server);
+			race_fast = server;
+			race_reply(server, buf, n, &client,
+				   race_scenario->refuse);
+		}
+
+		if (errno == ECONNREFUSED) {
+			server->refused = true;
+		}
+	}
+
+	if (race_slow != NULL && race_slow->querylen != 0 &&
+	    isc_time_microdiff(&now, &race_slow->received) >=
+		    RACE_SLOW_MS * US_PER_MS)
+	{
+		/*
+		 * Connect the socket to the resolver's, so that an ICMP
+		 * port unreachable for the answer is reported on it.
+		 */
+		int r = connect(race_slow->fd, &race_slow->client.type.sa,
+				race_slow->client.length);
+		assert_int_equal(r, 0);
+
+		race_reply(race_slow, race_slow->query, race_slow->querylen,
+			   &race_slow->client, false);
+		race_slow->querylen = 0;
+		race_answered = now;
+	}
+
+	/* Finish once the fetch is done and no late answer is pending */
+	if (race_fetched &&
+	    (race_slow == NULL ||
+	     (!isc_time_isepoch(&race_answered) &&
+	      isc_time_microdiff(&now, &race_answered) >=
+		      RACE_LINGER_MS * US_PER_MS)))
+	{
+		race_done();
+	}
+}
+
+static void
+race_fetchdone(isc_task_t *task, isc_event_t *event) {
+	dns_fetchevent_t *fevent = (dns_fetchevent_t *)event;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_in_a_t a;
+
+	UNUSED(task);
+
+	race_result = fevent->result;
+	if (race_result == ISC_R_SUCCESS) {
+		assert_int_equal(dns_rdataset_first(fevent->rdataset),
+				 ISC_R_SUCCESS);
+		dns_rdataset_current(fevent->rdataset, &rdata);
+		assert_int_equal(dns_rdata_tostruct(&rdata, &a, NULL),
+				 ISC_R_SUCCESS);
+		isc_sockaddr_fromin(&race_answer, &a.in_addr, 0);
+	}
+
+	if (fevent->node != NULL) {
+		dns_db_detachnode(fevent->db, &fevent->node);
+	}
+	if (fevent->db != NULL) {
+		dns_db_detach(&fevent->db);
+	}
+	if (dns_rdataset_isassociated(fevent->rdataset)) {
+		dns_rdataset_disassociate(fevent->rdataset);
+	}
+	dns_resolver_destroyfetch(&race_fetch.fetch);
+	isc_event_free(&event);
+
+	race_fetched = true;
+}
+
+/*
+ * Cache the address of 'server' as the address of 'namestr', so that
+ * the ADB finds it without looking it up.
+ */
+static void
+race_cacheaddress(const char *namestr, race_server_t *server) {
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_fixedname_t fname;
+	dns_dbnode_t *node = NULL;
+	isc_region_t region = { .base = (void *)&server->addr.type.sin.sin_addr,
+				.length = 4 };
+	isc_stdtime_t now;
+	isc_result_t result;
+
+	dns_rdata_fromregion(&rdata, dns_rdataclass_in, dns_rdatatype_a,
+			     &region);
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.ttl = 3600;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+	dns_rdataset_init(&rdataset);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	rdataset.trust = dns_trust_authanswer;
+
+	dns_test_namefromstring(namestr, &fname);
+	result = dns_db_findnode(fetchview->cachedb, dns_fixedname_name(&fname),
+				 true, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_stdtime_get(&now);
+	result = dns_db_addrdataset(fetchview->cachedb, node, NULL, now,
+				    &rdataset, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_db_detachnode(fetchview->cachedb, &node);
+	dns_rdataset_disassociate(&rdataset);
+}
+
+static void
+race_start(const race_scenario_t *scenario) {
+	dns_fixedname_t fname;
+	isc_result_t result;
+	isc_interval_t interval;
+	isc_stdtime_t now;
+	in_port_t port = 0;
+
+	race_scenario = scenario;
+	race_slow = race_fast = NULL;
+	race_fetched = false;
+	isc_time_settoepoch(&race_answered);
+
+	/* The two servers listen on the same port */
+	for (size_t i = 0; i < ARRAY_SIZE(race_servers); i++) {
+		race_server_t *server = &race_servers[i];
+		struct in_addr ina = { .s_addr = htonl(0x7f000001 + i) };
+		socklen_t len = sizeof(server->addr.type);
+		int r;
+
+		*server = (race_server_t){ .fd = -1 };
+		isc_sockaddr_fromin(&server->addr, &ina, port);
+
+		server->fd = socket(AF_INET, SOCK_DGRAM, 0);
+		assert_true(server->fd >= 0);
+		r = bind(server->fd, &server->addr.type.sa,
+			 server->addr.length);
+		assert_int_equal(r, 0);
+		r = getsockname(server->fd, &server->addr.type.sa, &len);
+		assert_int_equal(r, 0);
+		port = isc_sockaddr_getport(&server->addr);
+	}
+
+	result = dns_test_makeview("race", true, &fetchview);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_view_setdstport(fetchview, port);
+	result = dns_view_initsecroots(fetchview, mctx);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_view_createresolver(fetchview, loopmgr, taskmgr, 1,
+					 netmgr, 0, dispatchmgr, dispatch,
+					 NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_view_freeze(fetchview);
+
+	dns_resolver_setmaxraces(fetchview->resolver, 1);
+	if (scenario->maxqueries != 0) {
+		dns_resolver_setmaxqueries(fetchview->resolver,
+					   scenario->maxqueries);
+	}
+	isc_stats_create(mctx, &race_stats, dns_resstatscounter_max);
+	dns_resolver_setstats(fetchview->resolver, race_stats);
+
+	/* Both servers are known to answer within the same SRTT */
+	isc_stdtime_get(&now);
+	for (size_t i = 0; i < ARRAY_SIZE(race_servers); i++) {
+		dns_adbaddrinfo_t *ai = NULL;
+		isc_sockaddr_t sa = race_servers[i].addr;
+
+		/* The ADB knows addresses without the destination port */
+		isc_sockaddr_setport(&sa, 0);
+		result = dns_adb_findaddrinfo(fetchview->adb, &sa, &ai, now);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		dns_adb_adjustsrtt(fetchview->adb, ai, scenario->srtt,
+				   DNS_ADB_RTTADJREPLACE);
+		dns_adb_freeaddrinfo(fetchview->adb, &ai);
+	}
+
+	/* "example." is served by ns1.example. and ns2.example. */
+	dns_test_namefromstring("example.", &fdomain);
+	domain = dns_fixedname_name(&fdomain);
+
+	dns_rdatalist_init(&nslist);
+	nslist.rdclass = dns_rdataclass_in;
+	nslist.type = dns_rdatatype_ns;
+	nslist.ttl = 3600;
+	for (size_t i = 0; i < ARRAY_SIZE(race_nsrdata); i++) {
+		char namestr[DNS_NAME_FORMATSIZE];
+
+		snprintf(namestr, sizeof(namestr), "ns%zu.example.", i + 1);
+		race_cacheaddress(namestr, &race_servers[i]);
+
+		dns_rdata_init(&race_nsrdata[i]);
+		result = dns_test_rdatafromstring(
+			&race_nsrdata[i], dns_rdataclass_in, dns_rdatatype_ns,
+			race_nsbuf[i], sizeof(race_nsbuf[i]), namestr, false);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		ISC_LIST_APPEND(nslist.rdata, &race_nsrdata[i], link);
+	}
+	dns_rdataset_init(&nameservers);
+	dns_rdatalist_tordataset(&nslist, &nameservers);
+
+	isc_timer_create(isc_loop_main(loopmgr), race_tick, NULL,
+			 &race_timer);
+	isc_interval_set(&interval, 0, NS_PER_MS);
+	isc_timer_start(race_timer, isc_timertype_ticker, &interval);
+
+	isc_task_create(taskmgr, &race_task, 0);
+	race_fetch = (fetch_t){ .fetch = NULL };
+	dns_test_namefromstring("www.example.", &fname);
+	dns_rdataset_init(&race_fetch.rdataset);
+	result = dns_resolver_createfetch(
+		fetchview->resolver, dns_fixedname_name(&fname),
+		dns_rdatatype_a, domain, &nameservers, NULL, NULL, 0, 0, 0,
+		NULL, race_task, race_fetchdone, &race_fetch,
+		&race_fetch.rdataset, NULL, &race_fetch.fetch);
+	assert_int_equal(result, ISC_R_SUCCESS);
+}
+
+static uint64_t
+race_counter(isc_statscounter_t counter) {
+	return (isc_stats_get_counter(race_stats, counter));
+}
+
+static void
+race_check_slow_wins(void) {
+	assert_int_equal(race_result, ISC_R_SUCCESS);
+	assert_non_null(race_slow);
+	assert_true(isc_sockaddr_eqaddr(&race_answer, &race_slow->addr));
+	assert_int_equal(race_slow->queries, 1);
+	assert_false(race_slow->refused);
+}
+
+/* the raced query to the next best server answers first and wins */
+static void
+race_check_won(void) {
+	uint64_t elapsed;
+
+	assert_int_equal(race_result, ISC_R_SUCCESS);
+	assert_non_null(race_slow);
+	assert_non_null(race_fast);
+	assert_true(isc_sockaddr_eqaddr(&race_answer, &race_fast->addr));
+	assert_int_equal(race_slow->queries, 1);
+	assert_int_equal(race_fast->queries, 1);
+
+	assert_int_equal(race_counter(dns_resstatscounter_racesent), 1);
+	assert_int_equal(race_counter(dns_resstatscounter_racewon), 1);
+
+	/* The race started once the server took twice its SRTT */
+	elapsed = isc_time_microdiff(&race_fast->received,
+				     &race_slow->received);
+	assert_true(elapsed + RACE_SLACK_US >= 2 * race_scenario->srtt);
+	assert_true(elapsed < RACE_SLOW_MS * US_PER_MS);
+
+	/* The losing query was cancelled, and its port closed */
+	assert_true(race_slow->refused);
+}
+
+ISC_LOOP_TEST_IMPL(race_won) {
+	static const race_scenario_t scenario = {
+		.srtt = 50 * US_PER_MS,
+		.check = race_check_won,
+	};
+
+	race_start(&scenario);
+}
+
+/* without a query left under max-recursion-queries, there is no race */
+static void
+race_check_maxqueries(void) {
+	race_check_slow_wins();
+	assert_null(race_fast);
+	assert_int_equal(race_counter(dns_resstatscounter_racesent), 0);
+	assert_int_equal(race_counter(dns_resstatscounter_racewon), 0);
+}
+
+/* max-recursion-queries 2 allows one query to be sent */
+ISC_LOOP_TEST_IMPL(race_maxqueries) {
+	static const race_scenario_t scenario = {
+		.srtt = 50 * US_PER_MS,
+		.maxqueries = 2,
+		.check = race_check_maxqueries,
+	};
+
+	race_start(&scenario);
+}
+
+/* a server answering within twice its SRTT is not raced */
+ISC_LOOP_TEST_IMPL(race_srtt) {
+	static const race_scenario_t scenario = {
+		.srtt = 300 * US_PER_MS,
+		.check = race_check_maxqueries,
+	};
+
+	race_start(&scenario);
+}
+
+/*
+ * When the raced query fails, the fetch waits for the query it was
+ * racing against instead of trying another server.
+ */
+static void
+race_check_refused(void) {
+	race_check_slow_wins();
+	assert_non_null(race_fast);
+	assert_int_equal(race_fast->queries, 1);
+	assert_int_equal(race_counter(dns_resstatscounter_racesent), 1);
+	assert_int_equal(race_counter(dns_resstatscounter_racewon), 0);
+}
+
+ISC_LOOP_TEST_IMPL(race_refused) {
+	static const race_scenario_t scenario = {
+		.srtt = 50 * US_PER_MS,
+		.refuse = true,
+		.check = race_check_refused,
+	};
+
+	race_start(&scenario);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(create, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(gettimeout, setup_test, teardown_test)
@@ -182,6 +886,13 @@ ISC_TEST_ENTRY_CUSTOM(settimeout, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(settimeout_default, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(settimeout_belowmin, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(settimeout_overmax, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(setmaxraces, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(fetch_coalesce, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(fetch_contention, setup_test, teardown_contention)
+ISC_TEST_ENTRY_CUSTOM(race_won, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(race_maxqueries, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(race_srtt, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(race_refused, setup_test, teardown_test)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
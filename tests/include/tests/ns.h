@@ -104,6 +104,8 @@ typedef struct ns_test_qctx_create_params {
 	dns_rdatatype_t qtype;
 	unsigned int	qflags;
 	bool		with_cache;
+	dns_view_t     *view;
+	void (*sendcb)(isc_buffer_t *buf);
 } ns_test_qctx_create_params_t;
 
 /*%
@@ -111,7 +113,13 @@ typedef struct ns_test_qctx_create_params {
  * with given QNAME, QTYPE and flags was received from a client.  Recursion is
  * assumed to be allowed for this client.  If "with_cache" is set to true,
  * a cache database will be created and associated with the view matching the
- * incoming query.
+ * incoming query.  If "view" is set, the query is matched to that view
+ * instead of a newly created one and "with_cache" is ignored.  "sendcb" is
+ * set as the client's send callback before the query is started.
+ *
+ * If ns_query_start() sends a response before a query context is set up
+ * (e.g. from the view's answer cache), the client is released and
+ * ISC_R_COMPLETE is returned.
  */
 isc_result_t
 ns_test_qctx_create(const ns_test_qctx_create_params_t *params,
@@ -34,7 +34,57 @@
 #include "uv_wrap.h"
 #define KEEP_BEFORE
 
+#if HAVE_SENDMMSG
+#include <sys/socket.h>
+
+/*
+ * Count the sendmmsg(2) calls made by the batched UDP sends, and the
+ * datagrams (including the UDP GSO segments) they have sent.
+ */
+static atomic_uint_fast32_t sendmmsg_calls = 0;
+static atomic_uint_fast32_t sendmmsg_datagrams = 0;
+
+static int
+counting_sendmmsg(int fd, struct mmsghdr *msgs, unsigned int vlen, int flags) {
+	int r = sendmmsg(fd, msgs, vlen, flags);
+
+	atomic_fetch_add(&sendmmsg_calls, 1);
+	for (int i = 0; i < r; i++) {
+		atomic_fetch_add(&sendmmsg_datagrams,
+				 msgs[i].msg_hdr.msg_iovlen);
+	}
+
+	return (r);
+}
+#define sendmmsg counting_sendmmsg
+#endif /* HAVE_SENDMMSG */
+
 #include "netmgr/socket.c"
+
+#if HAVE_LIBURING
+/*
+ * Count the datagrams that the connected UDP sockets have queued on the
+ * worker's io_uring ring.
+ */
+static atomic_uint_fast32_t uring_csends = 0;
+
+static isc_result_t
+counting_uring_udp_send(isc_nmsocket_t *sock, isc__nm_uvreq_t *req) {
+	isc_result_t result = isc__nm_uring_udp_send(sock, req);
+
+	if (result == ISC_R_SUCCESS && atomic_load(&sock->client)) {
+		/* a connected socket must not name the peer */
+		assert_true(atomic_load(&sock->connected));
+		assert_null(req->uv_req.msghdr.msg_name);
+		assert_int_equal(req->uv_req.msghdr.msg_namelen, 0);
+		atomic_fetch_add(&uring_csends, 1);
+	}
+
+	return (result);
+}
+#define isc__nm_uring_udp_send counting_uring_udp_send
+#endif /* HAVE_LIBURING */
+
 #include "netmgr/udp.c"
 #include "netmgr_common.h"
 #include "uv.c"
@@ -189,6 +239,10 @@ ISC_LOOP_TEST_IMPL(mock_listenudp_uv_udp_bind) {
 ISC_LOOP_TEST_IMPL(mock_listenudp_uv_udp_recv_start) {
 	isc_result_t result = ISC_R_SUCCESS;
 
+	/* The io_uring backend doesn't call uv_udp_recv_start() */
+	result = isc_nm_setbackend(netmgr, isc_nm_backend_libuv);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
 	WILL_RETURN(uv_udp_recv_start, UV_EADDRINUSE);
 
 	result = isc_nm_listenudp(netmgr, ISC_NM_LISTEN_ALL, &udp_listen_addr,
@@ -1007,6 +1061,694 @@ ISC_LOOP_TEST_IMPL(udp_recv_send) {
 	}
 }
 
+/*
+ * A plain UDP socket on the other end, and a timer that collects the
+ * datagrams it receives.
+ */
+#define SENDBATCH_DATAGRAMS 8
+#define SENDBATCH_SIZE	    100
+#define SENDBATCH_TICKS	    500
+
+static int sendbatch_fd = -1;
+static size_t sendbatch_expected = 0;
+static size_t sendbatch_received = 0;
+static size_t sendbatch_ticks = 0;
+static isc_timer_t *sendbatch_timer = NULL;
+static uint8_t sendbatch_bufs[SENDBATCH_DATAGRAMS][SENDBATCH_SIZE];
+
+static void
+sendbatch_done(void) {
+	isc_timer_stop(sendbatch_timer);
+	isc_timer_destroy(&sendbatch_timer);
+	close(sendbatch_fd);
+	sendbatch_fd = -1;
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+sendbatch_tick(void *arg) {
+	uint8_t buf[UINT16_MAX];
+	ssize_t n;
+
+	UNUSED(arg);
+
+	while ((n = recv(sendbatch_fd, buf, sizeof(buf), MSG_DONTWAIT)) >= 0) {
+		/* the GSO segments are delivered as separate datagrams */
+		assert_int_equal(n, SENDBATCH_SIZE);
+		assert_int_equal(buf[0], buf[SENDBATCH_SIZE - 1]);
+		sendbatch_received++;
+	}
+
+	if (sendbatch_received == sendbatch_expected ||
+	    ++sendbatch_ticks == SENDBATCH_TICKS)
+	{
+		sendbatch_done();
+	}
+}
+
+static void
+sendbatch_timer_start(size_t expected) {
+	isc_interval_t interval;
+
+	sendbatch_expected = expected;
+	sendbatch_received = 0;
+	sendbatch_ticks = 0;
+
+	isc_timer_create(mainloop, sendbatch_tick, NULL, &sendbatch_timer);
+	isc_interval_set(&interval, 0, 10 * NS_PER_MS);
+	isc_timer_start(sendbatch_timer, isc_timertype_ticker, &interval);
+}
+
+static void
+sendbatch_connect(size_t count) {
+	int r;
+
+	sendbatch_fd = socket(AF_INET6, SOCK_DGRAM, 0);
+	assert_true(sendbatch_fd >= 0);
+	r = connect(sendbatch_fd, &udp_listen_addr.type.sa,
+		    udp_listen_addr.length);
+	assert_int_equal(r, 0);
+
+	for (size_t i = 0; i < count; i++) {
+		uint8_t buf[SENDBATCH_SIZE];
+
+		memset(buf, (int)i, sizeof(buf));
+		assert_int_equal(send(sendbatch_fd, buf, sizeof(buf), 0),
+				 sizeof(buf));
+	}
+}
+
+static void
+sendbatch_bind(void) {
+	int r;
+
+	sendbatch_fd = socket(AF_INET6, SOCK_DGRAM, 0);
+	assert_true(sendbatch_fd >= 0);
+	r = bind(sendbatch_fd, &udp_listen_addr.type.sa,
+		 udp_listen_addr.length);
+	assert_int_equal(r, 0);
+}
+
+/*
+ * Connect a few UDP sockets to the plain socket and send two datagrams
+ * from each of them as soon as they are connected.
+ */
+#define QUERYBATCH_SOCKETS (SENDBATCH_DATAGRAMS / 2)
+
+static void
+querybatch_send_cb(isc_nmhandle_t *handle, isc_result_t eresult,
+		   void *cbarg) {
+	UNUSED(cbarg);
+
+	assert_int_equal(eresult, ISC_R_SUCCESS);
+	atomic_fetch_add(&csends, 1);
+
+	isc_nmhandle_detach(&handle);
+}
+
+static void
+querybatch_connect_cb(isc_nmhandle_t *handle, isc_result_t eresult,
+		      void *cbarg) {
+	uint8_t *buf = cbarg;
+
+	assert_int_equal(eresult, ISC_R_SUCCESS);
+	atomic_fetch_add(&cconnects, 1);
+
+	for (size_t i = 0; i < 2; i++) {
+		isc_nmhandle_t *sendhandle = NULL;
+		isc_region_t region = { .base = buf, .length = SENDBATCH_SIZE };
+
+		isc_nmhandle_attach(handle, &sendhandle);
+		isc_nm_send(sendhandle, &region, querybatch_send_cb, NULL);
+	}
+}
+
+static void
+querybatch_start(void) {
+	sendbatch_bind();
+
+	for (size_t i = 0; i < QUERYBATCH_SOCKETS; i++) {
+		memset(sendbatch_bufs[i], (int)i, SENDBATCH_SIZE);
+		isc_nm_udpconnect(netmgr, &udp_connect_addr, &udp_listen_addr,
+				  querybatch_connect_cb, sendbatch_bufs[i],
+				  T_CONNECT);
+	}
+
+	sendbatch_timer_start(SENDBATCH_DATAGRAMS);
+}
+
+static void
+querybatch_check(void) {
+	assert_int_equal(sendbatch_received, SENDBATCH_DATAGRAMS);
+	atomic_assert_int_eq(cconnects, QUERYBATCH_SOCKETS);
+	atomic_assert_int_eq(csends, SENDBATCH_DATAGRAMS);
+}
+
+/*
+ * A datagram sent on a connected socket that is closed later in the same
+ * loop iteration, like when the read times out, still has to leave before
+ * the descriptor goes away.
+ */
+static void
+close_send_connect_cb(isc_nmhandle_t *handle, isc_result_t eresult,
+		      void *cbarg) {
+	isc_nmhandle_t *sendhandle = NULL;
+	isc_region_t region = { .base = sendbatch_bufs[0],
+				.length = SENDBATCH_SIZE };
+
+	UNUSED(cbarg);
+
+	assert_int_equal(eresult, ISC_R_SUCCESS);
+	atomic_fetch_add(&cconnects, 1);
+
+	isc_nmhandle_attach(handle, &sendhandle);
+	isc_nm_send(sendhandle, &region, querybatch_send_cb, NULL);
+
+	isc__nm_udp_failed_read_cb(handle->sock, ISC_R_TIMEDOUT, false);
+	assert_true(isc__nmsocket_closing(handle->sock));
+}
+
+static void
+close_send_start(void) {
+	sendbatch_bind();
+
+	memset(sendbatch_bufs[0], 0, SENDBATCH_SIZE);
+	isc_nm_udpconnect(netmgr, &udp_connect_addr, &udp_listen_addr,
+			  close_send_connect_cb, NULL, T_CONNECT);
+
+	sendbatch_timer_start(1);
+}
+
+static void
+close_send_check(void) {
+	assert_int_equal(sendbatch_received, 1);
+	atomic_assert_int_eq(cconnects, 1);
+	atomic_assert_int_eq(csends, 1);
+}
+
+ISC_SETUP_TEST_IMPL(udp_close_send) {
+	setup_test(state);
+	return (0);
+}
+
+ISC_TEARDOWN_TEST_IMPL(udp_close_send) {
+	close_send_check();
+	teardown_test(state);
+	return (0);
+}
+
+ISC_LOOP_TEST_IMPL(udp_close_send) {
+	close_send_start();
+}
+
+/*
+ * Put two sockets in the loop's pool, then reserve both of them once
+ * they are open; the first one is used by isc_nm_udpconnect(), and the
+ * second one, left unused, is closed in the next loop iteration.  A
+ * datagram sent from the peer's address to the first socket before it
+ * is connected must not be readable afterwards.
+ */
+static isc_sockaddr_t prebind_addrs[2];
+static uv_os_sock_t prebind_fd = -1;
+
+static void
+prebind_connect_cb(isc_nmhandle_t *handle, isc_result_t eresult,
+		   void *cbarg) {
+	isc_nmhandle_t *sendhandle = NULL;
+	isc_region_t region = { .base = sendbatch_bufs[0],
+				.length = SENDBATCH_SIZE };
+	isc_sockaddr_t local;
+	uint8_t buf[SENDBATCH_SIZE];
+
+	UNUSED(cbarg);
+
+	assert_int_equal(eresult, ISC_R_SUCCESS);
+	atomic_fetch_add(&cconnects, 1);
+
+	/* The pooled socket has been used as it was */
+	assert_int_equal(handle->sock->fd, prebind_fd);
+	local = isc_nmhandle_localaddr(handle);
+	assert_true(isc_sockaddr_equal(&local, &prebind_addrs[0]));
+
+	/* The datagram sent before the connect has been dropped */
+	assert_int_equal(recv(prebind_fd, buf, sizeof(buf), MSG_DONTWAIT), -1);
+	assert_true(errno == EAGAIN || errno == EWOULDBLOCK);
+
+	isc_nmhandle_attach(handle, &sendhandle);
+	isc_nm_send(sendhandle, &region, querybatch_send_cb, NULL);
+}
+
+static void
+prebind_reaped(void *arg) {
+	isc__networker_t *worker = &netmgr->workers[isc_tid()];
+
+	UNUSED(arg);
+
+	assert_true(ISC_LIST_EMPTY(worker->udpprebound));
+	assert_int_equal(isc_nm_udpprebound(netmgr, &udp_connect_addr), 0);
+}
+
+static void
+prebind_take(void *arg) {
+	isc__networker_t *worker = &netmgr->workers[isc_tid()];
+	isc_sockaddr_t local[2] = { udp_connect_addr, udp_connect_addr };
+	isc_sockaddr_t other = udp_connect_addr;
+
+	UNUSED(arg);
+
+	/* Both sockets have been opened by now */
+	assert_int_equal(isc_nm_udpprebound(netmgr, &udp_connect_addr), 2);
+	assert_int_not_equal(ISC_LIST_HEAD(worker->udpprebound)->fd, -1);
+	assert_int_not_equal(ISC_LIST_TAIL(worker->udpprebound)->fd, -1);
+	prebind_fd = ISC_LIST_HEAD(worker->udpprebound)->fd;
+
+	for (size_t i = 0; i < 2; i++) {
+		assert_int_equal(isc_nm_udptakeprebound(netmgr, &local[i]),
+				 ISC_R_SUCCESS);
+		assert_true(isc_sockaddr_equal(&local[i], &prebind_addrs[i]));
+	}
+	assert_int_equal(isc_nm_udptakeprebound(netmgr, &other),
+			 ISC_R_NOTFOUND);
+	assert_int_equal(isc_nm_udpprebound(netmgr, &udp_connect_addr), 0);
+
+	memset(sendbatch_bufs[0], 0, SENDBATCH_SIZE);
+	assert_int_equal(sendto(sendbatch_fd, sendbatch_bufs[0],
+				SENDBATCH_SIZE, 0, &local[0].type.sa,
+				local[0].length),
+			 SENDBATCH_SIZE);
+	isc_nm_udpconnect(netmgr, &local[0], &udp_listen_addr,
+			  prebind_connect_cb, NULL, T_CONNECT);
+
+	isc_async_run(mainloop, prebind_reaped, NULL);
+}
+
+ISC_SETUP_TEST_IMPL(udp_prebind) {
+	setup_test(state);
+	return (0);
+}
+
+ISC_TEARDOWN_TEST_IMPL(udp_prebind) {
+	close_send_check();
+	teardown_test(state);
+	return (0);
+}
+
+ISC_LOOP_TEST_IMPL(udp_prebind) {
+	isc__networker_t *worker = &netmgr->workers[isc_tid()];
+
+	sendbatch_bind();
+
+	for (size_t i = 0; i < 2; i++) {
+		prebind_addrs[i] = udp_connect_addr;
+		isc_sockaddr_setport(&prebind_addrs[i], UDP_TEST_PORT + 1 + i);
+		isc_nm_udpprebind(netmgr, &prebind_addrs[i]);
+	}
+
+	/* The sockets are opened in the next loop iteration */
+	assert_int_equal(isc_nm_udpprebound(netmgr, &udp_connect_addr), 2);
+	assert_int_equal(ISC_LIST_HEAD(worker->udpprebound)->fd, -1);
+	assert_int_equal(isc_nm_udptakeprebound(netmgr, &prebind_addrs[0]),
+			 ISC_R_NOTFOUND);
+
+	isc_async_run(mainloop, prebind_take, NULL);
+
+	sendbatch_timer_start(1);
+}
+
+/*
+ * A pooled socket that is not reserved is closed once its lifetime is
+ * over.
+ */
+static isc_timer_t *prebind_timer = NULL;
+
+static void
+prebind_expired(void *arg) {
+	isc__networker_t *worker = &netmgr->workers[isc_tid()];
+
+	UNUSED(arg);
+
+	assert_true(ISC_LIST_EMPTY(worker->udpprebound));
+	assert_int_equal(isc_nm_udpprebound(netmgr, &udp_connect_addr), 0);
+
+	isc_timer_destroy(&prebind_timer);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+prebind_opened(void *arg) {
+	isc__networker_t *worker = &netmgr->workers[isc_tid()];
+	unsigned int ms = ISC_NETMGR_UDPPREBOUND_LIFETIME + 100;
+	isc_interval_t interval;
+
+	UNUSED(arg);
+
+	assert_int_equal(isc_nm_udpprebound(netmgr, &udp_connect_addr), 1);
+	assert_int_not_equal(ISC_LIST_HEAD(worker->udpprebound)->fd, -1);
+
+	isc_timer_create(mainloop, prebind_expired, NULL, &prebind_timer);
+	isc_interval_set(&interval, ms / MS_PER_SEC,
+			 (ms % MS_PER_SEC) * NS_PER_MS);
+	isc_timer_start(prebind_timer, isc_timertype_once, &interval);
+}
+
+ISC_LOOP_TEST_IMPL(udp_prebind_expire) {
+	isc_sockaddr_t local = udp_connect_addr;
+
+	isc_sockaddr_setport(&local, UDP_TEST_PORT + 1);
+	isc_nm_udpprebind(netmgr, &local);
+
+	isc_async_run(mainloop, prebind_opened, NULL);
+}
+
+#if ISC_NETMGR_UDP_SENDBATCH
+/*
+ * Send a burst of datagrams from a plain socket before the listening
+ * socket gets to read any of them, so that libuv receives them all with
+ * a single recvmmsg(2) call, and check how the echoed responses are sent.
+ */
+static void
+sendbatch_send_cb(isc_nmhandle_t *handle, isc_result_t eresult, void *cbarg) {
+	UNUSED(handle);
+	UNUSED(cbarg);
+
+	assert_int_equal(eresult, ISC_R_SUCCESS);
+	atomic_fetch_add(&ssends, 1);
+}
+
+static void
+sendbatch_recv_cb(isc_nmhandle_t *handle, isc_result_t eresult,
+		  isc_region_t *region, void *cbarg) {
+	isc_region_t response;
+	uint8_t *buf = NULL;
+
+	UNUSED(cbarg);
+
+	if (eresult != ISC_R_SUCCESS) {
+		return;
+	}
+
+	assert_int_equal(region->length, SENDBATCH_SIZE);
+	assert_in_range(region->base[0], 0, SENDBATCH_DATAGRAMS - 1);
+	atomic_fetch_add(&sreads, 1);
+
+	/*
+	 * The batched responses outlive the receive buffer when they are
+	 * handed over to libuv, so echo a copy.
+	 */
+	buf = sendbatch_bufs[region->base[0]];
+	memmove(buf, region->base, region->length);
+	response = (isc_region_t){ .base = buf, .length = region->length };
+
+	isc_nm_send(handle, &response, sendbatch_send_cb, NULL);
+}
+
+static void
+sendbatch_start(void) {
+	atomic_store(&sendmmsg_calls, 0);
+	atomic_store(&sendmmsg_datagrams, 0);
+
+	start_listening(ISC_NM_LISTEN_ONE, sendbatch_recv_cb);
+
+	sendbatch_connect(SENDBATCH_DATAGRAMS);
+	sendbatch_timer_start(SENDBATCH_DATAGRAMS);
+}
+
+static void
+sendbatch_check(bool batch) {
+	assert_int_equal(sendbatch_received, sendbatch_expected);
+	atomic_assert_int_eq(sreads, SENDBATCH_DATAGRAMS);
+	atomic_assert_int_eq(ssends, SENDBATCH_DATAGRAMS);
+
+	if (!batch) {
+		/* every response went through uv_udp_send() */
+		atomic_assert_int_eq(sendmmsg_calls, 0);
+		return;
+	}
+
+	/*
+	 * All the responses were sent by a single sendmmsg(2) call at
+	 * the end of the recvmmsg(2) batch.
+	 */
+	atomic_assert_int_eq(sendmmsg_calls, 1);
+	atomic_assert_int_eq(sendmmsg_datagrams, SENDBATCH_DATAGRAMS);
+}
+
+ISC_SETUP_TEST_IMPL(udp_sendbatch) {
+	setup_test(state);
+	assert_true(isc_nm_getudpsendbatch(netmgr));
+	return (0);
+}
+
+ISC_TEARDOWN_TEST_IMPL(udp_sendbatch) {
+	sendbatch_check(true);
+	teardown_test(state);
+	return (0);
+}
+
+ISC_LOOP_TEST_IMPL(udp_sendbatch) {
+	sendbatch_start();
+}
+
+ISC_SETUP_TEST_IMPL(udp_sendbatch_off) {
+	setup_test(state);
+	isc_nm_setudpsendbatch(netmgr, false);
+	assert_false(isc_nm_getudpsendbatch(netmgr));
+	return (0);
+}
+
+ISC_TEARDOWN_TEST_IMPL(udp_sendbatch_off) {
+	sendbatch_check(false);
+	teardown_test(state);
+	return (0);
+}
+
+ISC_LOOP_TEST_IMPL(udp_sendbatch_off) {
+	sendbatch_start();
+}
+
+#if HAVE_DECL_UDP_SEGMENT
+/*
+ * Queued datagrams are coalesced into a single UDP GSO send only while
+ * they go to the same peer and have the same size; a shorter datagram
+ * ends the send.
+ */
+ISC_RUN_TEST_IMPL(udp_sendbatch_segments) {
+	isc__nm_uvreq_t reqs[UDP_GSO_MAXSEGS + 2];
+	isc__nm_uvreq_t *reqp[UDP_GSO_MAXSEGS + 2];
+	isc_sockaddr_t other;
+	size_t count = ARRAY_SIZE(reqs);
+
+	isc_sockaddr_fromin6(&other, &in6addr_loopback, UDP_TEST_PORT + 1);
+
+	for (size_t i = 0; i < count; i++) {
+		reqs[i] = (isc__nm_uvreq_t){ .uvbuf.len = 512,
+					     .peer = udp_listen_addr };
+		reqp[i] = &reqs[i];
+	}
+
+	/* no more than UDP_GSO_MAXSEGS segments in a single send */
+	assert_int_equal(udp_sendbatch_segments(reqp, 0, count),
+			 UDP_GSO_MAXSEGS);
+
+	/* a shorter datagram is the last segment */
+	reqs[3].uvbuf.len = 100;
+	assert_int_equal(udp_sendbatch_segments(reqp, 0, count), 4);
+
+	/* a longer one starts a new send */
+	reqs[3].uvbuf.len = 513;
+	assert_int_equal(udp_sendbatch_segments(reqp, 0, count), 3);
+	assert_int_equal(udp_sendbatch_segments(reqp, 3, count), 5);
+
+	/* and so does another peer */
+	reqs[3].uvbuf.len = 512;
+	reqs[3].peer = other;
+	assert_int_equal(udp_sendbatch_segments(reqp, 0, count), 3);
+
+	/* segments larger than the IPv6 minimum MTU are sent alone */
+	reqs[0].uvbuf.len = UDP_GSO_MAXSEGSZ + 1;
+	assert_int_equal(udp_sendbatch_segments(reqp, 0, count), 1);
+}
+#endif /* HAVE_DECL_UDP_SEGMENT */
+#endif /* ISC_NETMGR_UDP_SENDBATCH */
+
+/*
+ * The listening sockets receive with the multishot io_uring receive, and
+ * send the responses through the worker's ring.
+ */
+static atomic_uint_fast32_t uring_sreads = 0;
+
+static void
+uring_listen_read_cb(isc_nmhandle_t *handle, isc_result_t eresult,
+		     isc_region_t *region, void *cbarg) {
+	if (eresult == ISC_R_SUCCESS) {
+		assert_true(handle->sock->uring);
+		assert_true(handle->sock->uring_send);
+		assert_non_null(handle->sock->worker->uring);
+		atomic_fetch_add(&uring_sreads, 1);
+	}
+
+	listen_read_cb(handle, eresult, region, cbarg);
+}
+
+ISC_SETUP_TEST_IMPL(udp_recv_send_uring) {
+	isc_result_t result;
+
+#if HAVE_LIBURING
+	if (!isc__nm_uring_supported()) {
+		skip();
+	}
+#else  /* HAVE_LIBURING */
+	skip();
+#endif /* HAVE_LIBURING */
+
+	setup_test(state);
+
+	result = isc_nm_setbackend(netmgr, isc_nm_backend_uring);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(isc_nm_getbackend(netmgr), isc_nm_backend_uring);
+
+	atomic_store(&uring_sreads, 0);
+
+	/* Allow some leeway (+1) as datagram service is unreliable */
+	expected_cconnects = (workers + 1) * NSENDS;
+	cconnects_shutdown = false;
+
+	expected_creads = workers * NSENDS;
+	do_send = true;
+
+	return (0);
+}
+
+ISC_TEARDOWN_TEST_IMPL(udp_recv_send_uring) {
+	if (netmgr == NULL) {
+		/* skipped */
+		return (0);
+	}
+
+	atomic_assert_int_ge(cconnects, expected_creads);
+	atomic_assert_int_ge(csends, expected_creads);
+	atomic_assert_int_ge(sreads, expected_creads);
+	atomic_assert_int_ge(ssends, expected_creads);
+	atomic_assert_int_ge(creads, expected_creads);
+	atomic_assert_int_eq(uring_sreads, atomic_load(&sreads));
+
+	teardown_test(state);
+	return (0);
+}
+
+ISC_LOOP_TEST_IMPL(udp_recv_send_uring) {
+	start_listening(ISC_NM_LISTEN_ALL, uring_listen_read_cb);
+
+	for (size_t i = 0; i < workers; i++) {
+		isc_async_run(isc_loop_get(loopmgr, i), udp__connect, NULL);
+	}
+}
+
+static void
+uring_setup(void **state) {
+#if HAVE_LIBURING
+	if (!isc__nm_uring_supported()) {
+		skip();
+	}
+#else  /* HAVE_LIBURING */
+	skip();
+#endif /* HAVE_LIBURING */
+
+	setup_test(state);
+
+	assert_int_equal(isc_nm_setbackend(netmgr, isc_nm_backend_uring),
+			 ISC_R_SUCCESS);
+}
+
+/*
+ * The connected sockets queue their datagrams on the worker's ring, not
+ * on libuv, and don't name the peer in them.
+ */
+ISC_SETUP_TEST_IMPL(udp_querybatch_uring) {
+	uring_setup(state);
+#if HAVE_LIBURING
+	atomic_store(&uring_csends, 0);
+#endif /* HAVE_LIBURING */
+	return (0);
+}
+
+ISC_TEARDOWN_TEST_IMPL(udp_querybatch_uring) {
+	if (netmgr == NULL) {
+		/* skipped */
+		return (0);
+	}
+
+	RESET_RETURN;
+	querybatch_check();
+#if HAVE_LIBURING
+	atomic_assert_int_eq(uring_csends, SENDBATCH_DATAGRAMS);
+#endif /* HAVE_LIBURING */
+	teardown_test(state);
+	return (0);
+}
+
+ISC_LOOP_TEST_IMPL(udp_querybatch_uring) {
+	WILL_RETURN(uv_udp_send, UV_ENOMEM);
+	querybatch_start();
+}
+
+/*
+ * The datagrams queued on the ring reach the kernel before the socket
+ * is closed.
+ */
+ISC_SETUP_TEST_IMPL(udp_close_send_uring) {
+	uring_setup(state);
+	return (0);
+}
+
+ISC_TEARDOWN_TEST_IMPL(udp_close_send_uring) {
+	if (netmgr == NULL) {
+		/* skipped */
+		return (0);
+	}
+
+	close_send_check();
+	teardown_test(state);
+	return (0);
+}
+
+ISC_LOOP_TEST_IMPL(udp_close_send_uring) {
+	close_send_start();
+}
+
+/*
+ * Without the kernel support, the io_uring backend can't be selected
+ * and the netmgr keeps using libuv.
+ */
+ISC_SETUP_TEST_IMPL(udp_uring_unsupported) {
+#if HAVE_LIBURING
+	if (isc__nm_uring_supported()) {
+		skip();
+	}
+#endif /* HAVE_LIBURING */
+
+	setup_test(state);
+	return (0);
+}
+
+ISC_TEARDOWN_TEST_IMPL(udp_uring_unsupported) {
+	if (netmgr == NULL) {
+		/* skipped */
+		return (0);
+	}
+
+	teardown_test(state);
+	return (0);
+}
+
+ISC_LOOP_TEST_IMPL(udp_uring_unsupported) {
+	assert_int_equal(isc_nm_setbackend(netmgr, isc_nm_backend_uring),
+			 ISC_R_NOTIMPLEMENTED);
+	assert_int_equal(isc_nm_getbackend(netmgr), isc_nm_backend_libuv);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
 static void
 double_read_send_cb(isc_nmhandle_t *handle, isc_result_t eresult, void *cbarg) {
 	assert_non_null(handle);
@@ -1201,6 +1943,20 @@ ISC_TEST_ENTRY_SETUP_TEARDOWN(udp_double_read)
 ISC_TEST_ENTRY_SETUP_TEARDOWN(udp_recv_one)
 ISC_TEST_ENTRY_SETUP_TEARDOWN(udp_recv_two)
 ISC_TEST_ENTRY_SETUP_TEARDOWN(udp_recv_send)
+ISC_TEST_ENTRY_SETUP_TEARDOWN(udp_close_send)
+ISC_TEST_ENTRY_SETUP_TEARDOWN(udp_prebind)
+ISC_TEST_ENTRY_CUSTOM(udp_prebind_expire, setup_test, teardown_test)
+#if ISC_NETMGR_UDP_SENDBATCH
+ISC_TEST_ENTRY_SETUP_TEARDOWN(udp_sendbatch)
+ISC_TEST_ENTRY_SETUP_TEARDOWN(udp_sendbatch_off)
+#if HAVE_DECL_UDP_SEGMENT
+ISC_TEST_ENTRY(udp_sendbatch_segments)
+#endif /* HAVE_DECL_UDP_SEGMENT */
+#endif /* ISC_NETMGR_UDP_SENDBATCH */
+ISC_TEST_ENTRY_SETUP_TEARDOWN(udp_recv_send_uring)
+ISC_TEST_ENTRY_SETUP_TEARDOWN(udp_querybatch_uring)
+ISC_TEST_ENTRY_SETUP_TEARDOWN(udp_close_send_uring)
+ISC_TEST_ENTRY_SETUP_TEARDOWN(udp_uring_unsupported)
 
 ISC_TEST_LIST_END
 
@@ -0,0 +1,185 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/* ! \file */
+
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/mem.h>
+#include <isc/random.h>
+#include <isc/util.h>
+#include <isc/wheel.h>
+
+#include <tests/isc.h>
+
+#define NELTS 10000
+#define START 1700000000
+
+struct e {
+	isc_stdtime_t when;
+	unsigned int index;
+	bool expired;
+};
+
+static void
+idx(void *p, unsigned int i) {
+	struct e *e = p;
+
+	e->index = i;
+}
+
+/* test isc_wheel_insert() and isc_wheel_delete() */
+ISC_RUN_TEST_IMPL(isc_wheel_delete) {
+	isc_wheel_t *wheel = NULL;
+	struct e e1 = { START + 100, 0 }, e2 = { START + 100000, 0 };
+
+	UNUSED(state);
+
+	isc_wheel_create(mctx, START, idx, &wheel);
+	assert_non_null(wheel);
+
+	isc_wheel_insert(wheel, &e1, e1.when);
+	assert_int_not_equal(e1.index, 0);
+	isc_wheel_insert(wheel, &e2, e2.when);
+	assert_int_not_equal(e2.index, 0);
+	assert_int_not_equal(e1.index, e2.index);
+	assert_int_equal(isc_wheel_count(wheel), 2);
+	assert_ptr_equal(isc_wheel_element(wheel, e1.index), &e1);
+
+	assert_null(isc_wheel_due(wheel, START + 99));
+
+	isc_wheel_delete(wheel, e1.index);
+	assert_int_equal(e1.index, 0);
+	assert_int_equal(isc_wheel_count(wheel), 1);
+	assert_null(isc_wheel_due(wheel, START + 100));
+
+	/* The slot is reused */
+	isc_wheel_insert(wheel, &e1, START);
+	assert_ptr_equal(isc_wheel_due(wheel, START + 100), &e1);
+	isc_wheel_delete(wheel, e1.index);
+
+	isc_wheel_destroy(&wheel);
+	assert_null(wheel);
+}
+
+/*
+ * test that isc_wheel_due() returns every element, and only once its time
+ * has come, as the clock advances in steps of various sizes
+ */
+ISC_RUN_TEST_IMPL(isc_wheel_due) {
+	isc_wheel_t *wheel = NULL;
+	struct e *elts = NULL;
+	isc_stdtime_t now = START;
+	size_t expired = 0;
+	unsigned int rounds = 0;
+
+	UNUSED(state);
+
+	elts = isc_mem_get(mctx, NELTS * sizeof(elts[0]));
+	isc_wheel_create(mctx, now, idx, &wheel);
+
+	for (size_t i = 0; i < NELTS; i++) {
+		elts[i] = (struct e){ .when = now + isc_random_uniform(
+							    i % 2 == 0 ? 600
+								       : 172800) };
+		isc_wheel_insert(wheel, &elts[i], elts[i].when);
+	}
+
+	/* Move some of them, forwards and backwards */
+	for (size_t i = 0; i < NELTS; i += 7) {
+		elts[i].when = now + isc_random_uniform(86400);
+		isc_wheel_update(wheel, elts[i].index, elts[i].when);
+	}
+
+	while (expired < NELTS) {
+		struct e *e = NULL;
+
+		now += 1 + isc_random_uniform(rounds++ % 3 == 0 ? 2 : 300);
+
+		/* isc_wheel_pending() does not miss anything either */
+		for (size_t i = 0; i < NELTS; i++) {
+			if (!elts[i].expired && elts[i].when <= now) {
+				assert_true(isc_wheel_pending(wheel, now));
+				break;
+			}
+		}
+
+		while ((e = isc_wheel_due(wheel, now)) != NULL) {
+			assert_true(e->when <= now);
+			assert_false(e->expired);
+			e->expired = true;
+			isc_wheel_delete(wheel, e->index);
+			expired++;
+		}
+
+		assert_false(isc_wheel_pending(wheel, now));
+
+		/* Nothing that is due has been missed */
+		for (size_t i = 0; i < NELTS; i++) {
+			assert_true(elts[i].expired || elts[i].when > now);
+		}
+	}
+
+	assert_int_equal(isc_wheel_count(wheel), 0);
+
+	isc_wheel_destroy(&wheel);
+	isc_mem_put(mctx, elts, NELTS * sizeof(elts[0]));
+}
+
+/* test that an element updated to a time in the past is due at once */
+ISC_RUN_TEST_IMPL(isc_wheel_update) {
+	isc_wheel_t *wheel = NULL;
+	struct e e1 = { START + 3600, 0 }, e2 = { START + 10, 0 };
+
+	UNUSED(state);
+
+	isc_wheel_create(mctx, START, idx, &wheel);
+	isc_wheel_insert(wheel, &e1, e1.when);
+	isc_wheel_insert(wheel, &e2, e2.when);
+
+	assert_false(isc_wheel_pending(wheel, START + 9));
+	assert_true(isc_wheel_pending(wheel, START + 10));
+	assert_ptr_equal(isc_wheel_due(wheel, START + 10), &e2);
+
+	/* Expiring e1 now puts it behind e2 */
+	isc_wheel_update(wheel, e1.index, 0);
+	assert_ptr_equal(isc_wheel_due(wheel, START + 10), &e2);
+	isc_wheel_delete(wheel, e2.index);
+	assert_ptr_equal(isc_wheel_due(wheel, START + 10), &e1);
+
+	/* ...and postponing it takes it out of the due list again */
+	isc_wheel_update(wheel, e1.index, START + 20);
+	assert_null(isc_wheel_due(wheel, START + 19));
+	assert_ptr_equal(isc_wheel_due(wheel, START + 20), &e1);
+	isc_wheel_delete(wheel, e1.index);
+
+	isc_wheel_destroy(&wheel);
+}
+
+ISC_TEST_LIST_START
+
+ISC_TEST_ENTRY(isc_wheel_delete)
+ISC_TEST_ENTRY(isc_wheel_due)
+ISC_TEST_ENTRY(isc_wheel_update)
+
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -24,6 +24,7 @@
 #include <isc/loop.h>
 #include <isc/managers.h>
 #include <isc/mem.h>
+#include <isc/netmgr.h>
 #include <isc/os.h>
 #include <isc/string.h>
 #include <isc/task.h>
@@ -105,10 +106,21 @@ teardown_taskmgr(void **state __attribute__((__unused__))) {
 
 int
 setup_netmgr(void **state __attribute__((__unused__))) {
+	char *env_backend = NULL;
+
 	REQUIRE(loopmgr != NULL);
 
 	isc_netmgr_create(mctx, loopmgr, &netmgr);
 
+	/*
+	 * Run the tests with the io_uring backend if requested and
+	 * available, and with the default (libuv) backend otherwise.
+	 */
+	env_backend = getenv("ISC_NM_BACKEND");
+	if (env_backend != NULL && strcmp(env_backend, "uring") == 0) {
+		(void)isc_nm_setbackend(netmgr, isc_nm_backend_uring);
+	}
+
 	return (0);
 }
 
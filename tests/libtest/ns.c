@@ -31,6 +31,7 @@
 #include <isc/print.h>
 #include <isc/random.h>
 #include <isc/result.h>
+#include <isc/sockaddr.h>
 #include <isc/stdio.h>
 #include <isc/string.h>
 #include <isc/task.h>
@@ -414,6 +415,14 @@ create_qctx_for_client(ns_client_t *client, query_ctx_t **qctxp) {
 	ns__hook_table = saved_hook_table;
 	ns_hooktable_free(mctx, (void **)&query_hooks);
 
+	if (client->reqhandle == NULL) {
+		/*
+		 * The query was answered before query_setup() was reached.
+		 */
+		INSIST(*qctxp == NULL);
+		return (ISC_R_COMPLETE);
+	}
+
 	isc_nmhandle_detach(&client->reqhandle);
 
 	if (*qctxp == NULL) {
@@ -429,6 +438,7 @@ ns_test_qctx_create(const ns_test_qctx_create_params_t *params,
 	ns_client_t *client = NULL;
 	isc_result_t result;
 	isc_nmhandle_t *handle = NULL;
+	struct in_addr loopback = { .s_addr = htonl(INADDR_LOOPBACK) };
 
 	REQUIRE(params != NULL);
 	REQUIRE(params->qname != NULL);
@@ -443,14 +453,21 @@ ns_test_qctx_create(const ns_test_qctx_create_params_t *params,
 		return (result);
 	}
 	TIME_NOW(&client->tnow);
+	client->sendcb = params->sendcb;
 
 	/*
-	 * Every client needs to belong to a view.
+	 * Every client needs to belong to a view and to have a peer address.
 	 */
-	result = dns_test_makeview("view", params->with_cache, &client->view);
-	if (result != ISC_R_SUCCESS) {
-		goto detach_client;
+	if (params->view != NULL) {
+		dns_view_attach(params->view, &client->view);
+	} else {
+		result = dns_test_makeview("view", params->with_cache,
+					   &client->view);
+		if (result != ISC_R_SUCCESS) {
+			goto detach_client;
+		}
 	}
+	isc_sockaddr_fromin(&client->peeraddr, &loopback, 53);
 
 	/*
 	 * Synthesize a DNS query using given QNAME, QTYPE and flags, storing
@@ -474,7 +491,16 @@ ns_test_qctx_create(const ns_test_qctx_create_params_t *params,
 	 * synthesized query.
 	 */
 	result = create_qctx_for_client(client, qctxp);
-	if (result != ISC_R_SUCCESS) {
+	if (result == ISC_R_COMPLETE) {
+		/*
+		 * There's no query context to hand the client over to,
+		 * so drop both references to it here.
+		 */
+		handle = client->handle;
+		isc_nmhandle_detach(&handle);
+		isc_nmhandle_detach(&client->handle);
+		return (result);
+	} else if (result != ISC_R_SUCCESS) {
 		goto detach_query;
 	}
 
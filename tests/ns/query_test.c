@@ -28,6 +28,9 @@
 #include <isc/quota.h>
 
 #include <dns/badcache.h>
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/pcache.h>
 #include <dns/view.h>
 #include <dns/zone.h>
 
@@ -1477,11 +1480,153 @@ ISC_LOOP_TEST_IMPL(ns__query_hookasync_e2e) {
 	isc_loopmgr_shutdown(loopmgr);
 }
 
+/*****
+***** answer cache tests
+*****/
+
+static unsigned char pcache_response[512];
+static unsigned int pcache_responselen;
+
+/* client->sendcb keeping a copy of the response */
+static void
+send_pcache(isc_buffer_t *buffer) {
+	isc_region_t r;
+
+	isc_buffer_usedregion(buffer, &r);
+	INSIST(r.length <= sizeof(pcache_response));
+	memmove(pcache_response, r.base, r.length);
+	pcache_responselen = r.length;
+}
+
+/*%
+ * Send a ns.foo/A query to 'view'; return true if it was answered from
+ * the answer cache by ns_query_start().
+ */
+static bool
+run_pcache_query(dns_view_t *view) {
+	query_ctx_t *qctx = NULL;
+	isc_result_t result;
+	const ns_test_qctx_create_params_t qctx_params = {
+		.qname = "ns.foo",
+		.qtype = dns_rdatatype_a,
+		.view = view,
+		.sendcb = send_pcache,
+	};
+
+	pcache_responselen = 0;
+
+	result = ns_test_qctx_create(&qctx_params, &qctx);
+	if (result == ISC_R_COMPLETE) {
+		assert_int_not_equal(pcache_responselen, 0);
+		return (true);
+	}
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_nmhandle_attach(qctx->client->handle, &qctx->client->reqhandle);
+	qctx->client->state = NS_CLIENTSTATE_WORKING;
+	ns__query_start(qctx);
+	ns_test_qctx_destroy(&qctx);
+
+	assert_int_not_equal(pcache_responselen, 0);
+	return (false);
+}
+
+/* test the answer cache lookup in ns_query_start() */
+ISC_LOOP_TEST_IMPL(ns__query_pcache) {
+	dns_view_t *view = NULL;
+	dns_zone_t *zone = NULL;
+	dns_db_t *db = NULL;
+	dns_fixedname_t fname;
+	unsigned char response[sizeof(pcache_response)];
+	unsigned int responselen;
+	uint64_t hits, misses;
+	isc_result_t result;
+
+	ns__hook_table = NULL;
+	ns_hooktable_create(mctx, &ns__hook_table);
+
+	result = dns_test_makeview("view", true, &view);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	view->recursion = false;
+	dns_pcache_create(mctx, 16, &view->pcache);
+
+	result = ns_test_serve_zone("foo", TESTS_DIR "/testdata/query/foo.db",
+				    view);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	hits = ns_stats_get_counter(sctx->nsstats,
+				    ns_statscounter_answercachehit);
+	misses = ns_stats_get_counter(sctx->nsstats,
+				      ns_statscounter_answercachemiss);
+
+	/*
+	 * The first query is answered from the zone, and its response
+	 * is cached; the second one gets the same response, but for the
+	 * message ID, from the cache.
+	 */
+	assert_false(run_pcache_query(view));
+	memmove(response, pcache_response, pcache_responselen);
+	responselen = pcache_responselen;
+	assert_int_equal(ns_stats_get_counter(sctx->nsstats,
+					      ns_statscounter_answercachemiss),
+			 misses + 1);
+
+	assert_true(run_pcache_query(view));
+	assert_int_equal(pcache_responselen, responselen);
+	assert_memory_equal(pcache_response + 2, response + 2, responselen - 2);
+	assert_int_equal(ns_stats_get_counter(sctx->nsstats,
+					      ns_statscounter_answercachehit),
+			 hits + 1);
+
+	/*
+	 * Replace the zone database with a new one loaded from the same
+	 * file, as a reload would.  It has the same contents and SOA
+	 * serial, but the responses built from the old database must
+	 * not be used anymore.
+	 */
+	result = dns_name_fromstring(dns_fixedname_initname(&fname), "foo", 0,
+				     NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_view_findzone(view, dns_fixedname_name(&fname), &zone);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mctx, "rbt", dns_fixedname_name(&fname),
+			       dns_dbtype_zone, dns_rdataclass_in, 0, NULL,
+			       &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_load(db, TESTS_DIR "/testdata/query/foo.db",
+			     dns_masterformat_text, 0);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_zone_replacedb(zone, db, false);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_detach(&db);
+	dns_zone_detach(&zone);
+
+	assert_false(run_pcache_query(view));
+	assert_int_equal(pcache_responselen, responselen);
+	assert_int_equal(ns_stats_get_counter(sctx->nsstats,
+					      ns_statscounter_answercachemiss),
+			 misses + 2);
+
+	assert_true(run_pcache_query(view));
+	assert_int_equal(ns_stats_get_counter(sctx->nsstats,
+					      ns_statscounter_answercachehit),
+			 hits + 2);
+
+	ns_test_cleanup_zone();
+	dns_view_detach(&view);
+	ns_hooktable_free(mctx, (void **)&ns__hook_table);
+
+	isc_loop_teardown(mainloop, shutdown_interfacemgr, NULL);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(ns__query_sfcache, setup_server, teardown_server)
 ISC_TEST_ENTRY_CUSTOM(ns__query_start, setup_server, teardown_server)
 ISC_TEST_ENTRY_CUSTOM(ns__query_hookasync, setup_server, teardown_server)
 ISC_TEST_ENTRY_CUSTOM(ns__query_hookasync_e2e, setup_server, teardown_server)
+ISC_TEST_ENTRY_CUSTOM(ns__query_pcache, setup_server, teardown_server)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN